@@ -0,0 +1,101 @@
+// batch_journal.h - Append-only journal of finished conversions for resumable batches
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#ifndef BATCH_JOURNAL_H
+#define BATCH_JOURNAL_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Outcome of one conversion
+enum class eJournalStatus : uint8_t
+{
+    Done = 1,
+    Failed = 2
+}; // End enum eJournalStatus
+
+// Latest record for one input file
+struct sJournalEntry
+{
+    std::string sInputPath;           // Absolute, normalised
+    uint64_t ullInputSize = 0;
+    int64_t llInputMtimeNs = 0;
+    uint64_t ullOptionsHash = 0;      // fn_hashJournalOptions of everything that shapes the output
+    std::string sOutputPath;
+    uint64_t ullOutputSize = 0;
+    eJournalStatus eStatus = eJournalStatus::Done;
+}; // End struct sJournalEntry
+
+// Journal key for a path: absolute and lexically normalised, so "./a.heic"
+// and "/work/a.heic" hit the same record
+std::string fn_normalizeJournalPath(const std::string& sPath);
+
+// 64-bit FNV-1a of a canonical options string
+uint64_t fn_hashJournalOptions(const std::string& sOptionsKey);
+
+// Journal file: an 8-byte header ("HCJ1" and a version) followed by records
+// of [payload length][CRC-32 of payload][payload]. A record is written with
+// one write() to an O_APPEND descriptor, so a crash can only leave a torn
+// last record; loading stops at the first record whose length or CRC does
+// not check out and cuts the file back to the good prefix. Lookups are one
+// hash probe plus a stat of the input and of the recorded output. When
+// superseded records outnumber live ones the file is rewritten with one
+// record per input (temporary file, fsync, rename).
+class BatchJournal
+{
+public:
+    BatchJournal();                                                         // Local Function
+    ~BatchJournal();                                                        // Local Function
+
+    BatchJournal(const BatchJournal&) = delete;
+    BatchJournal& operator=(const BatchJournal&) = delete;
+
+    // Load (or create) the journal at sPath
+    bool fn_open(const std::string& sPath, std::string& sError);            // Local Function
+    bool fn_isOpen() const;                                                 // Local Function
+
+    // True when the last record for sInputPath is a success with the same
+    // input size, mtime and options, and its output still has the recorded size
+    bool fn_isUpToDate(const std::string& sInputPath, uint64_t ullOptionsHash) const;  // Local Function
+
+    // Output path recorded for sInputPath (normalised), so a rerun rewrites
+    // it in place instead of picking a new name
+    bool fn_findOutput(const std::string& sInputPath, std::string& sOutputPath) const;  // Local Function
+
+    // Append the outcome of one conversion (thread-safe)
+    bool fn_record(const std::string& sInputPath, const std::string& sOutputPath,
+                   uint64_t ullOptionsHash, bool bSuccess);                 // Local Function
+
+    // fsync the records written so far, compacting first when worthwhile
+    bool fn_checkpoint();                                                   // Local Function
+
+    // Checkpoint and close
+    void fn_close();                                                        // Local Function
+
+    size_t fn_getEntryCount() const;                                        // Local Function
+    size_t fn_getRecordCount() const;                                       // Local Function
+
+private:
+    bool fn_load(std::string& sError);
+    bool fn_appendLocked(const sJournalEntry& oEntry);
+    bool fn_compactLocked();
+    bool fn_shouldCompactLocked() const;
+
+    std::string m_sPath;
+    int m_iFd;                                                  // O_APPEND descriptor (-1 = closed)
+    mutable std::mutex m_oMutex;
+    std::unordered_map<std::string, sJournalEntry> m_mEntries;  // Latest record per input path
+    size_t m_stRecords;                                         // Records in the file, live or superseded
+}; // End class BatchJournal
+
+// SIGINT / SIGTERM handling for a running batch: the first signal asks the
+// batch to stop taking new files so it can checkpoint, a second one ends
+// the process with the default action
+void fn_installStopHandlers();
+void fn_restoreStopHandlers();
+bool fn_isStopRequested();
+
+#endif // BATCH_JOURNAL_H
@@ -7,7 +7,21 @@
 
 #include <vector>
 #include <string>
+#include <mutex>
+#include <set>
+#include <ostream>
+#include <memory>
 #include "config.h"
+#include "conversion_pipeline.h"
+#include "image_resizer.h"
+#include "exif_editor.h"
+#include "output_file.h"
+#include "rendition.h"
+#include "image_processor.h"
+#include "memory_budget.h"
+#include "batch_journal.h"
+#include "dedup_index.h"
+#include <ctime>
 
 class Converter; // Forward declaration
 
@@ -41,6 +55,14 @@ public:
         bool bVerbose
     );
     
+    // Header-only probe (--probe): one JSON line per file, in input order
+    bool fn_probeFiles(const std::vector<std::string>& vsInputFiles, std::ostream& oOutput);
+    bool fn_probeDirectory(
+        const std::string& sInputDirectory,
+        bool bRecursive,
+        std::ostream& oOutput
+    );
+    
     // Get processed file count
     int fn_getProcessedCount() const;
     
@@ -50,6 +72,9 @@ public:
     // Get list of failed files
     std::vector<std::string> fn_getFailedFiles() const;
     
+    // Files left alone because the journal shows them converted
+    int fn_getSkippedCount() const;
+    
     // Clear statistics
     void fn_clearStatistics();
     
@@ -61,7 +86,61 @@ public:
     void fn_setParallelProcessing(bool bEnable);
     bool fn_isParallelProcessing() const;
     
+    // Worker thread management (from -t/--threads)
+    void fn_setThreadCount(int iThreadCount);
+    int fn_getThreadCount() const;
+    
+    // Staged read/decode/encode/write pipeline (--pipeline)
+    void fn_setPipelineMode(bool bEnable);
+    bool fn_isPipelineMode() const;
+    void fn_setPipelineOptions(const sPipelineOptions& oOptions);
+    
+    // Preview size limit (--max-dimension, 0 = full size)
+    void fn_setMaxDimension(int iMaxDimension);
+    
+    // Resize between decode and encode (--scale, --fit, --filter)
+    void fn_setResizeOptions(const sResizeOptions& oOptions);
+    
+    // EXIF edits for the output (--no-gps, --no-makernote)
+    void fn_setExifEditOptions(const sExifEditOptions& oOptions);
+    
+    // Output durability (--sync); batch outputs never replace existing files
+    void fn_setOutputOptions(const sOutputOptions& oOptions);
+
+    // WebP encoder settings for every file
+    void fn_setWebPOptions(const sWebPOptions& oOptions);
+
+    // PNG encoder settings for every file
+    void fn_setPngOptions(const sPngOptions& oOptions);
+
+    // Strip-parallel JPEG encoding, used when a file gets several threads
+    void fn_setJpegOptions(const sJpegOptions& oOptions);
+
+    // TIFF compression and deflate level for every file
+    void fn_setTiffOptions(const sTiffOptions& oOptions);
+
+    // Write these renditions from one decode of each file (empty = one output)
+    void fn_setRenditions(const std::vector<sRendition>& vRenditions);
+
+    // Bytes of decoded images allowed in flight across workers (0 = no limit)
+    void fn_setMemoryLimit(uint64_t ullLimit);
+
+    // Resume journal (--journal, "" = off): files converted by an earlier run
+    // with the same options are skipped, and SIGINT / SIGTERM stop the batch
+    // after the files in progress
+    void fn_setJournalPath(const std::string& sPath);
+
+    // Convert byte-identical inputs once; the other copies get their outputs
+    // by hard link, reflink or copy (--dedup, Off = convert every file)
+    void fn_setDedupMode(eDedupMode eMode);
+    
 private:
+    // Hands one file to fn_runParallel (callable from any thread); a file
+    // source calls it for every file and returns when there are no more
+    typedef std::function<void(const std::string& sInputFile, const std::string& sOutputFile,
+                               const sConversionCost& oCost)> fnAddFile;
+    typedef std::function<void(const fnAddFile& fnAdd)> fnFileSource;
+    
     // Internal batch processing function - UPDATED to match implementation
     bool fn_internalBatchProcess(
         const std::vector<std::string>& vsFiles,
@@ -72,21 +151,81 @@ private:
         bool bVerbose
     );
     
+    // Convert files from fnSource on the worker threads, largest queued file
+    // first, starting as soon as the first one arrives (stKnownTotal = 0 when
+    // the source is still discovering files); returns the number of files
+    size_t fn_runParallel(
+        const fnFileSource& fnSource,
+        size_t stKnownTotal,
+        int iQuality,
+        bool bPreserveMetadata,
+        bool bVerbose
+    );
+    
+    // Sync the outputs if asked, log the summary; true when nothing failed
+    bool fn_finishBatch(const std::string& sOutputDirectory);
+    
     // Process single file in batch - UPDATED to match implementation
     bool fn_processSingleFile(
         const std::string& sInputFile,
-        const std::string& sOutputFormat,
-        const std::string& sOutputDirectory,
+        const std::string& sOutputFile,
         int iQuality,
-        bool bPreserveMetadata
+        bool bPreserveMetadata,
+        const fnThreadShare& fnThreads
     );
     
+    // Record the outcome of one file (thread-safe)
+    void fn_recordResult(const std::string& sInputFile, bool bSuccess);
+    
+    // Open the journal for a batch with these options; false when it cannot be used
+    bool fn_openJournal(const std::string& sOutputFormat, int iQuality, bool bPreserveMetadata, bool bVerbose);
+    void fn_closeJournal();
+    
+    // Every setting that changes the bytes written, as one string
+    std::string fn_makeJournalOptionsKey(const std::string& sOutputFormat, int iQuality, bool bPreserveMetadata) const;
+    
+    // True (and counted as skipped) when the journal shows the file converted
+    bool fn_isJournaledUpToDate(const std::string& sInputFile);
+    
+    // Append a file's outcome to the journal (thread-safe)
+    void fn_journalResult(const std::string& sInputFile, const std::string& sOutputFile, bool bSuccess);
+    
+    // The file whose size the journal checks: the output, or its first rendition
+    std::string fn_getJournalOutput(const std::string& sOutputFile) const;
+    
+    // A stop signal arrived during a journaled batch
+    bool fn_isStopping() const;
+    
+    // Output name given back to its input by the journal, to be overwritten
+    bool fn_isReplacingOutput(const std::string& sOutputFile);
+    
+    // Start a batch's duplicate index and CPU clock (no-op with dedup off)
+    void fn_startDedup();
+    
+    // Hash an input and decide whether it needs converting: true for the
+    // first file with its content; a duplicate is finished here or left for
+    // the worker converting its content (thread-safe)
+    bool fn_claimContent(const std::string& sInputFile, const std::string& sOutputFile,
+                         const unsigned char* pData, size_t stSize);
+    
+    // fn_claimContent on the file's mapped bytes; the decoder then reads them from cache
+    bool fn_claimFile(const std::string& sInputFile, const std::string& sOutputFile);
+    
+    // A converted file is done: produce the outputs of duplicates that waited for it
+    void fn_finishContent(const std::string& sInputFile, const std::string& sOutputFile, bool bSuccess);
+    
+    // Give one duplicate its outputs from sLeaderOutput and record the result
+    void fn_resolveDuplicate(const sDedupFollower& oFollower, const std::string& sLeaderOutput, bool bLeaderSucceeded);
+    
+    // Every file written for sOutputFile: itself, or one path per rendition
+    std::vector<std::string> fn_getOutputFiles(const std::string& sOutputFile) const;
+    
     // Helper functions - ADD THESE
     std::string fn_generateOutputFilename(
         const std::string& sInputFile,
         const std::string& sOutputFormat,
         const std::string& sOutputDirectory
-    ) const;
+    );
     
     // FIXED: Changed from fn_validateOutputDirectory to fn_directoryExists
     bool fn_directoryExists(const std::string& sDirectory) const;
@@ -103,8 +242,32 @@ private:
     int iProcessedCount;
     int iFailedCount;
     std::vector<std::string> vsFailedFiles;
-    int iBatchSize;  // ADD THIS
+    int iBatchSize;  // Progress report interval (files)
     bool bParallelProcessing;  // ADD THIS
+    int iThreadCount;  // Requested worker count (0 = all cores)
+    std::mutex oStatsMutex;  // Guards counters and failed file list
+    bool bPipelineMode;  // Use ConversionPipeline instead of per-file tasks
+    sPipelineOptions oPipelineOptions;  // Stage thread counts and queue depth
+    int iMaxDimension;  // Longest output side (0 = full size)
+    sResizeOptions oResizeOptions;  // Output size and filter
+    sExifEditOptions oExifEditOptions;  // GPS / MakerNote stripping
+    sOutputOptions oOutputOptions;  // Sync mode for written files
+    sWebPOptions oWebPOptions;  // Effort, lossless and alpha for WebP output
+    sPngOptions oPngOptions;  // Compression level and fast mode for PNG output
+    sJpegOptions oJpegOptions;  // Strip-parallel encoding for JPEG output
+    sTiffOptions oTiffOptions;  // Compression and deflate level for TIFF output
+    std::vector<sRendition> vRenditions;  // Outputs per input file, named from its output path
+    uint64_t ullMemoryLimit;  // Admission budget for parallel files (0 = unlimited)
+    std::set<std::string> oClaimedOutputs;  // Output names handed out in this batch
+    std::set<std::string> oReplacedOutputs;  // Claimed names the journal gave back to their input
+    std::mutex oClaimMutex;  // Guards oClaimedOutputs and oReplacedOutputs
+    int iSkippedCount;  // Files the journal showed as up to date
+    std::string sJournalPath;  // Resume journal ("" = off)
+    std::unique_ptr<BatchJournal> pJournal;  // Open during a journaled batch
+    uint64_t ullJournalOptionsHash;  // fn_hashJournalOptions of this batch's settings
+    eDedupMode eDedup;  // How duplicate inputs get their outputs
+    std::unique_ptr<DedupIndex> pDedup;  // Contents seen in the running batch
+    std::clock_t tBatchCpuStart;  // Process CPU time when the batch started
     
 };
 
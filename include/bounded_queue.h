@@ -0,0 +1,181 @@
+// bounded_queue.h - Lock-free bounded MPMC queue used between pipeline stages
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+// Fixed-capacity ring buffer where every slot carries a sequence number
+// (D. Vyukov's bounded MPMC design). Push and pop never take a lock; the
+// blocking variants back off when the queue is full or empty, which is what
+// throttles a fast producer stage to the speed of its consumer.
+template <typename T>
+class BoundedQueue
+{
+public:
+    // Capacity is rounded up to a power of two (minimum 2)
+    explicit BoundedQueue(size_t stCapacity)
+        : m_stMask(fn_roundUpPow2(stCapacity) - 1),
+          m_pCells(new oCell[m_stMask + 1]),
+          m_stEnqueuePos(0),
+          m_stDequeuePos(0),
+          m_bClosed(false)
+    {
+        for (size_t i = 0; i <= m_stMask; i++)
+        {
+            m_pCells[i].stSequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // Non-blocking push; returns false when the queue is full
+    bool fn_tryPush(T& oValue)
+    {
+        size_t stPos = m_stEnqueuePos.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            oCell& oSlot = m_pCells[stPos & m_stMask];
+            size_t stSeq = oSlot.stSequence.load(std::memory_order_acquire);
+            intptr_t iDiff = static_cast<intptr_t>(stSeq) - static_cast<intptr_t>(stPos);
+
+            if (iDiff == 0)
+            {
+                if (m_stEnqueuePos.compare_exchange_weak(stPos, stPos + 1, std::memory_order_relaxed))
+                {
+                    oSlot.oValue = std::move(oValue);
+                    oSlot.stSequence.store(stPos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (iDiff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                stPos = m_stEnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Non-blocking pop; returns false when the queue is empty
+    bool fn_tryPop(T& oValue)
+    {
+        size_t stPos = m_stDequeuePos.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            oCell& oSlot = m_pCells[stPos & m_stMask];
+            size_t stSeq = oSlot.stSequence.load(std::memory_order_acquire);
+            intptr_t iDiff = static_cast<intptr_t>(stSeq) - static_cast<intptr_t>(stPos + 1);
+
+            if (iDiff == 0)
+            {
+                if (m_stDequeuePos.compare_exchange_weak(stPos, stPos + 1, std::memory_order_relaxed))
+                {
+                    oValue = std::move(oSlot.oValue);
+                    oSlot.stSequence.store(stPos + m_stMask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (iDiff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                stPos = m_stDequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Blocking push; waits while the queue is full (back-pressure)
+    void fn_push(T oValue)
+    {
+        for (int iAttempt = 0; !fn_tryPush(oValue); iAttempt++)
+        {
+            fn_backoff(iAttempt);
+        }
+    }
+
+    // Blocking pop; returns false once the queue is closed and drained
+    bool fn_pop(T& oValue)
+    {
+        for (int iAttempt = 0; ; iAttempt++)
+        {
+            if (fn_tryPop(oValue))
+            {
+                return true;
+            }
+
+            if (m_bClosed.load(std::memory_order_acquire))
+            {
+                // Re-check: an item may have landed between the pop and the flag
+                return fn_tryPop(oValue);
+            }
+
+            fn_backoff(iAttempt);
+        }
+    }
+
+    // Signal that no more items will be pushed
+    void fn_close()
+    {
+        m_bClosed.store(true, std::memory_order_release);
+    }
+
+    size_t fn_getCapacity() const
+    {
+        return m_stMask + 1;
+    }
+
+private:
+    struct oCell
+    {
+        std::atomic<size_t> stSequence;
+        T oValue;
+    };
+
+    static size_t fn_roundUpPow2(size_t stValue)
+    {
+        size_t stResult = 2;
+        while (stResult < stValue)
+        {
+            stResult <<= 1;
+        }
+        return stResult;
+    }
+
+    // Spin briefly, then yield, then sleep so idle stages do not burn a core
+    static void fn_backoff(int iAttempt)
+    {
+        if (iAttempt < 64)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            int iMicros = (iAttempt < 256) ? 50 : 500;
+            std::this_thread::sleep_for(std::chrono::microseconds(iMicros));
+        }
+    }
+
+    const size_t m_stMask;
+    std::unique_ptr<oCell[]> m_pCells;
+    alignas(64) std::atomic<size_t> m_stEnqueuePos;
+    alignas(64) std::atomic<size_t> m_stDequeuePos;
+    std::atomic<bool> m_bClosed;
+};
+
+#endif // BOUNDED_QUEUE_H
@@ -22,6 +22,7 @@ const std::string sBUILD_TYPE = "generic";
 // Default Settings
 const int iDEFAULT_JPEG_QUALITY = 85;
 const int iDEFAULT_PNG_COMPRESSION = 6;
+const int iDEFAULT_WEBP_EFFORT = 4;              // libwebp method 0-6
 const int iDEFAULT_THREAD_COUNT = 4;
 const int iMAX_THREAD_COUNT = 16;
 const float fDEFAULT_SCALE_FACTOR = 1.0f;
@@ -34,6 +35,9 @@ const bool bDEFAULT_PRESERVE_EXIF = true;          // NEW: Default preserve EXIF
 const bool bDEFAULT_PRESERVE_XMP = true;           // NEW: Default preserve XMP
 const bool bDEFAULT_PRESERVE_IPTC = true;          // NEW: Default preserve IPTC
 const bool bDEFAULT_PRESERVE_GPS = true;           // NEW: Default preserve GPS
+const bool bDEFAULT_PRESERVE_MAKERNOTE = true;     // Default preserve EXIF MakerNote
+const bool bDEFAULT_USE_PIPELINE = false;          // Staged batch pipeline
+const int iDEFAULT_QUEUE_DEPTH = 4;                // Images buffered between pipeline stages
 
 // Supported Input Formats
 const std::vector<std::string> vsSUPPORTED_INPUT_FORMATS = {
@@ -104,6 +108,30 @@ struct oConfig {
     bool bPreserveXMP;            // NEW: Preserve XMP metadata
     bool bPreserveIPTC;           // NEW: Preserve IPTC metadata
     bool bPreserveGPS;            // NEW: Preserve GPS data
+    bool bPreserveMakerNote;      // Keep the EXIF MakerNote (camera private data)
+    bool bUsePipeline;            // Staged read/decode/encode/write batch pipeline
+    int iReadThreads;             // Pipeline read stage threads (0 = auto)
+    int iDecodeThreads;           // Pipeline decode stage threads (0 = auto)
+    int iEncodeThreads;           // Pipeline encode stage threads (0 = auto)
+    int iWriteThreads;            // Pipeline write stage threads (0 = auto)
+    int iQueueDepth;              // Pipeline queue depth between stages
+    bool bProbeOnly;              // Print container facts as JSON lines, convert nothing
+    int iMaxDimension;            // Preview mode: longest output side (0 = full size)
+    int iFitWidth;                // Shrink output to fit this box (0 = no limit)
+    int iFitHeight;
+    std::string sResizeFilter;    // box, bilinear or lanczos
+    std::string sSyncMode;        // Output durability: none, file or batch
+    bool bWebPLossless;           // Lossless WebP
+    int iWebPEffort;              // WebP method: 0 (fastest) to 6 (smallest)
+    int iWebPNearLossless;        // Lossless WebP preprocessing (100 = off)
+    int iWebPAlphaQuality;        // Lossy WebP alpha quality
+    bool bPngFast;                // Fixed PNG filter and quick deflate
+    bool bJpegParallel;           // Encode large JPEGs as parallel restart strips
+    std::string sTiffCompression; // none, lzw or deflate
+    std::vector<std::string> vsRenditions;  // FORMAT[:SIZE[:SUFFIX]] outputs from one decode
+    std::string sMemoryLimit;     // Batch memory budget: a size, auto or off
+    std::string sJournalPath;     // Resume journal for batches ("" = off)
+    std::string sDedupMode;       // Duplicate inputs: off, link, clone or copy
 };
 
 // Function Declarations - KEEP THESE
@@ -0,0 +1,168 @@
+// conversion_pipeline.h - Staged read/decode/encode/write batch pipeline
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#ifndef CONVERSION_PIPELINE_H
+#define CONVERSION_PIPELINE_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "bounded_queue.h"
+#include "heic_decoder.h"
+#include "image_resizer.h"
+#include "exif_editor.h"
+#include "output_file.h"
+#include "format_encoder.h"
+#include "mapped_file.h"
+#include "memory_budget.h"
+
+// Per-stage worker counts and queue depth (0 = derive from total threads)
+struct sPipelineOptions
+{
+    int iReadThreads = 0;    // I/O bound: file reads
+    int iDecodeThreads = 0;  // CPU bound: HEVC decode + EXIF extraction
+    int iEncodeThreads = 0;  // CPU bound: JPEG/PNG/WebP/BMP/TIFF encode
+    int iWriteThreads = 0;   // I/O bound: output write + metadata/timestamps
+    int iQueueDepth = 4;     // Images buffered between two stages
+};
+
+// How a job left the pipeline
+enum class ePipelineResult
+{
+    Converted,
+    Failed,
+    Filtered   // The read filter took the job over; the caller records it
+};
+
+// One file to convert
+struct sPipelineJob
+{
+    std::string sInputFile;
+    std::string sOutputFile;
+    bool bReplace = false;   // Overwrite the output (rewriting a journaled file in place)
+};
+
+class ConversionPipeline
+{
+public:
+    // Called once per job when it leaves the pipeline (any worker thread)
+    typedef std::function<void(const std::string& sInputFile, ePipelineResult eResult)> fnResultCallback;
+
+    // Polled before each file is read; true stops reading new files and
+    // lets the ones already in the stages finish
+    typedef std::function<bool()> fnStopCheck;
+
+    // Sees each input once it is read, before it is decoded; false means the
+    // caller has dealt with the job and it is reported as Filtered
+    typedef std::function<bool(const std::string& sInputFile, const std::string& sOutputFile,
+                               const unsigned char* pData, size_t stSize)> fnReadFilter;
+
+    ConversionPipeline(const sPipelineOptions& oOptions, int iTotalThreads);
+    ~ConversionPipeline();
+
+    // Run all jobs through the stages; returns true when every job succeeded
+    bool fn_run(
+        const std::vector<sPipelineJob>& vJobs,
+        const std::string& sOutputFormat,
+        int iQuality,
+        bool bPreserveMetadata,
+        const fnResultCallback& fnOnResult
+    );
+
+    // Fill in automatic stage counts from the total thread budget
+    static sPipelineOptions fn_resolveOptions(const sPipelineOptions& oRequested, int iTotalThreads);
+
+    sPipelineOptions fn_getOptions() const;
+
+    // Preview size limit for the decode stage (0 = full size)
+    void fn_setMaxDimension(int iMaxDimension);
+
+    // Resize applied in the decode stage (--scale / --fit)
+    void fn_setResizeOptions(const sResizeOptions& oOptions);
+
+    // EXIF edits applied in the encode stage, once the output size is known
+    void fn_setExifEditOptions(const sExifEditOptions& oOptions);
+
+    // How outputs are published; source timestamps are added per file
+    void fn_setOutputOptions(const sOutputOptions& oOptions);
+
+    // WebP encoder settings for the encode stage
+    void fn_setWebPOptions(const sWebPOptions& oOptions);
+
+    // PNG encoder settings for the encode stage
+    void fn_setPngOptions(const sPngOptions& oOptions);
+
+    // JPEG strip and restart settings for the encode stage
+    void fn_setJpegOptions(const sJpegOptions& oOptions);
+
+    // TIFF encoder settings for the encode stage
+    void fn_setTiffOptions(const sTiffOptions& oOptions);
+
+    // Bytes of decoded images allowed in flight (0 = bounded by queue depth only)
+    void fn_setMemoryLimit(uint64_t ullLimit);
+
+    // Stop condition for the read stage (empty = run every job)
+    void fn_setStopCheck(const fnStopCheck& fnShouldStop);
+
+    // Filter applied in the read stage (empty = decode every input)
+    void fn_setReadFilter(const fnReadFilter& fnFilter);
+
+private:
+    // Work item handed from stage to stage; buffers are released as soon as
+    // the stage that needs them is done
+    struct oPipelineItem
+    {
+        std::string sInputFile;
+        std::string sOutputFile;
+        bool bReplace = false;                  // From sPipelineJob
+        MappedFile oInput;                      // Read -> Decode
+        oDecodedImage oImage;                   // Decode -> Encode
+        sPlanarImage oPlanar;                   // Decode -> Encode, instead of oImage pixels
+        std::vector<unsigned char> vExifData;   // Decode -> Encode (JPEG APP segments)
+        std::vector<unsigned char> vXmpData;    // Decode -> Encode
+        std::vector<unsigned char> vIccProfile; // Decode -> Encode
+        std::vector<unsigned char> vEncoded;    // Encode -> Write
+        bool bWrittenByEncoder = false;         // Formats that need a seekable file
+        uint64_t ullReserved = 0;               // Memory budget held from decode to finish
+        bool bFailed = false;
+    };
+
+    typedef std::unique_ptr<oPipelineItem> tItemPtr;
+    typedef BoundedQueue<tItemPtr> tItemQueue;
+
+    void fn_readStage(const std::vector<sPipelineJob>& vJobs, std::atomic<size_t>& stNextJob,
+                      tItemQueue& oOut);
+    void fn_decodeStage(tItemQueue& oIn, tItemQueue& oOut);
+    void fn_encodeStage(tItemQueue& oIn, tItemQueue& oOut);
+    void fn_writeStage(tItemQueue& oIn);
+
+    void fn_finishItem(oPipelineItem& oItem, bool bSuccess);
+    void fn_reportJob(const std::string& sInputFile, ePipelineResult eResult);
+    sEncodeOptions fn_makeItemOptions(const oPipelineItem& oItem) const;
+    int fn_getItemThreads() const;
+
+    sPipelineOptions m_oOptions;
+    std::string m_sOutputFormat;
+    int m_iQuality;
+    bool m_bPreserveMetadata;
+    int m_iMaxDimension;
+    sResizeOptions m_oResize;
+    sExifEditOptions m_oExifEdit;
+    sOutputOptions m_oOutput;
+    sWebPOptions m_oWebP;
+    sPngOptions m_oPng;
+    sJpegOptions m_oJpeg;
+    sTiffOptions m_oTiff;
+    int m_iTotalThreads;                   // Resolved thread budget of the batch
+    std::atomic<int> m_iUnfinished;        // Jobs not yet out of the pipeline
+    std::unique_ptr<MemoryBudget> m_pMemoryBudget;
+    fnResultCallback m_fnOnResult;
+    fnStopCheck m_fnShouldStop;
+    fnReadFilter m_fnReadFilter;
+    std::atomic<int> m_iFailedCount;
+};
+
+#endif // CONVERSION_PIPELINE_H
@@ -13,6 +13,11 @@
 #include "batch_processor.h"
 #include "file_utils.h"
 #include "config.h"      // Add this for oConfig
+#include "image_resizer.h"
+#include "exif_editor.h"
+#include "output_file.h"
+#include "rendition.h"
+#include "dedup_index.h"
 
 // Simplified ConversionOptions
 struct ConversionOptions
@@ -28,6 +33,36 @@ struct ConversionOptions
     bool bPreserveTimestamps; // Simple timestamp flag
 };
 
+// Resize settings (--scale, --fit, --filter) from the configuration
+sResizeOptions fn_makeResizeOptions(const oConfig& oCurrentConfig);
+
+// EXIF edits (--no-gps, --no-makernote) from the configuration
+sExifEditOptions fn_makeExifEditOptions(const oConfig& oCurrentConfig);
+
+// Output publishing (--sync) from the configuration
+sOutputOptions fn_makeOutputOptions(const oConfig& oCurrentConfig);
+
+// WebP encoder settings (--lossless, --webp-effort, ...) from the configuration
+sWebPOptions fn_makeWebPOptions(const oConfig& oCurrentConfig);
+
+// PNG encoder settings (-c, --png-fast) from the configuration
+sPngOptions fn_makePngOptions(const oConfig& oCurrentConfig);
+
+// JPEG encoder settings (--parallel-jpeg) from the configuration
+sJpegOptions fn_makeJpegOptions(const oConfig& oCurrentConfig);
+
+// TIFF encoder settings (--tiff-compression, -c) from the configuration
+sTiffOptions fn_makeTiffOptions(const oConfig& oCurrentConfig);
+
+// Output renditions (--rendition, --renditions) from the configuration
+std::vector<sRendition> fn_makeRenditions(const oConfig& oCurrentConfig);
+
+// Batch memory budget in bytes (--memory-limit) from the configuration
+uint64_t fn_makeMemoryLimit(const oConfig& oCurrentConfig);
+
+// Duplicate input handling for batches (--dedup) from the configuration
+eDedupMode fn_makeDedupMode(const oConfig& oCurrentConfig);
+
 class Converter
 {
 public:
@@ -67,6 +102,17 @@ public:
     std::shared_ptr<oLogger> fn_getLogger() const;
     
     void fn_setImageProcessor(std::shared_ptr<ImageProcessor> pProcessor);
+    void fn_setTileThreads(int iThreads);  // Grid tile decode workers per image
+    void fn_setThreadShare(const fnThreadShare& fnShare);  // Live per-image thread count from a batch
+    void fn_setMaxDimension(int iMaxDimension);  // Preview size limit (0 = full size)
+    void fn_setResizeOptions(const sResizeOptions& oOptions);  // Resize between decode and encode
+    void fn_setExifEditOptions(const sExifEditOptions& oOptions);  // EXIF edits for the output
+    void fn_setOutputOptions(const sOutputOptions& oOptions);  // Sync and replace for the output file
+    void fn_setWebPOptions(const sWebPOptions& oOptions);  // Effort, lossless and alpha for WebP output
+    void fn_setPngOptions(const sPngOptions& oOptions);  // Compression level and fast mode for PNG output
+    void fn_setJpegOptions(const sJpegOptions& oOptions);  // Strip-parallel encoding for JPEG output
+    void fn_setTiffOptions(const sTiffOptions& oOptions);  // Compression and deflate level for TIFF output
+    void fn_setRenditions(const std::vector<sRendition>& vRenditions);  // Decode once, write each rendition
     void fn_setBatchProcessor(std::shared_ptr<BatchProcessor> pProcessor);
 
 private:
@@ -74,6 +120,8 @@ private:
     std::shared_ptr<ImageProcessor> m_pImageProcessor;
     std::shared_ptr<BatchProcessor> m_pBatchProcessor;
     std::shared_ptr<oLogger> m_pLogger;
+    sOutputOptions m_oOutput;   // Source timestamps are added per file
+    std::vector<sRendition> m_vRenditions;  // Replace the single output when not empty
     
     // Private helper functions
     bool fn_initializeCodecs();
@@ -0,0 +1,124 @@
+// dedup_index.h - Content hashing and duplicate-input tracking for batches
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#ifndef DEDUP_INDEX_H
+#define DEDUP_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "output_file.h"
+
+// How the outputs of duplicate inputs are produced from the first one
+enum class eDedupMode
+{
+    Off,     // Convert every file
+    Link,    // Hard link; reflink or copy where links are not possible
+    Clone,   // Reflink (FICLONE); copy where the filesystem cannot share extents
+    Copy     // Independent copy (copy_file_range)
+}; // End enum eDedupMode
+
+// off, link, clone or copy
+bool fn_parseDedupMode(const std::string& sName, eDedupMode& eMode);
+std::string fn_getDedupModeName(eDedupMode eMode);
+
+// 64-bit XXH64 of a buffer: one pass at memory speed, far from
+// cryptographic but with collisions vanishingly rare across a photo library
+uint64_t fn_hashContent(const void* pData, size_t stSize, uint64_t ullSeed = 0);
+
+// Write sDestination with the bytes of sSource, an output already written.
+// The copy is published like any output (temporary file, times and sync
+// from oOptions, then linked into place); a hard link shares the source's
+// inode and times. eUsed reports the method that worked.
+bool fn_materializeDuplicate(const std::string& sSource, const std::string& sDestination, eDedupMode eMode,
+                             const sOutputOptions& oOptions, eDedupMode& eUsed, std::string& sError);
+
+// What a worker does with a file after hashing it
+enum class eDedupRole
+{
+    Convert,   // First file with this content: convert it
+    Follow,    // Content already converted: materialize from sLeaderOutput now
+    Wait       // Content being converted: the converting worker materializes it later
+}; // End enum eDedupRole
+
+// A duplicate waiting for its content to finish converting
+struct sDedupFollower
+{
+    std::string sInputFile;
+    std::string sOutputFile;
+    uint64_t ullSize = 0;
+}; // End struct sDedupFollower
+
+// Totals for the batch summary
+struct sDedupSummary
+{
+    int iFiles = 0;          // Inputs not converted because an identical one was
+    uint64_t ullBytes = 0;   // Their input bytes
+    int iLinked = 0;
+    int iCloned = 0;
+    int iCopied = 0;
+    int iCollisions = 0;     // Hash matches whose bytes differed
+}; // End struct sDedupSummary
+
+// Contents seen in one batch, keyed by (size, XXH64). The first file with a
+// given content is converted; later ones either take its output at once or,
+// while it is still converting, wait in its group and are handed back to
+// the converting worker by fn_finish. Thread-safe.
+class DedupIndex
+{
+public:
+    DedupIndex();                                                           // Local Function
+
+    DedupIndex(const DedupIndex&) = delete;
+    DedupIndex& operator=(const DedupIndex&) = delete;
+
+    // Classify one input by its content (pData, stSize) and its hash;
+    // sLeaderOutput is set for Follow. A hash match only counts once the
+    // bytes equal the converting file's input; otherwise it is converted.
+    eDedupRole fn_claim(uint64_t ullHash, const unsigned char* pData, size_t stSize,
+                        const std::string& sInputFile, const std::string& sOutputFile,
+                        std::string& sLeaderOutput);                        // Local Function
+
+    // The converting file of a group is done; returns the files that waited
+    // for it (empty for inputs that were not converting a group). After a
+    // failure the waiting files share its fate, having the same bytes, and
+    // later duplicates are converted on their own.
+    std::vector<sDedupFollower> fn_finish(const std::string& sInputFile, bool bSuccess);  // Local Function
+
+    // Count a duplicate whose output was produced with eUsed
+    void fn_noteDuplicate(uint64_t ullSize, eDedupMode eUsed);              // Local Function
+
+    sDedupSummary fn_getSummary() const;                                    // Local Function
+
+private:
+    enum class eGroupState
+    {
+        Converting,
+        Done
+    };
+
+    struct sGroup
+    {
+        eGroupState eState = eGroupState::Converting;
+        std::string sLeaderInput;
+        std::string sLeaderOutput;
+        std::vector<sDedupFollower> vWaiting;
+    };
+
+    typedef std::pair<uint64_t, uint64_t> tContentKey;    // (size, hash)
+
+    static bool fn_isSameContent(const std::string& sLeaderInput, const unsigned char* pData, size_t stSize);  // Local Function
+
+    mutable std::mutex m_oMutex;
+    std::map<tContentKey, sGroup> m_mGroups;
+    std::unordered_map<std::string, tContentKey> m_mConverting;  // Leader input -> its group
+    sDedupSummary m_oSummary;
+}; // End class DedupIndex
+
+#endif // DEDUP_INDEX_H
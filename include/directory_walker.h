@@ -0,0 +1,30 @@
+// directory_walker.h - Parallel single-pass directory tree walker
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#ifndef DIRECTORY_WALKER_H
+#define DIRECTORY_WALKER_H
+
+#include <functional>
+#include <string>
+
+// Decides from the entry name alone whether a regular file is wanted, so
+// no path is built for files that will be skipped (empty = every file)
+typedef std::function<bool(const char* pName)> fnWalkFilter;
+
+// Receives each wanted file as soon as its directory is read. Called from
+// the walker threads, possibly at the same time.
+typedef std::function<void(const std::string& sPath)> fnWalkCallback;
+
+// Walk sRoot and hand every regular file passing fnFilter to fnOnFile.
+// Each directory is read once (getdents64 on Linux) and entry types come
+// from d_type; only symlinks and filesystems that report DT_UNKNOWN cost
+// an fstatat relative to the open directory. Symlinks are followed, and a
+// directory already visited (same device and inode) is not entered again,
+// which stops symlink loops and bind-mount repeats. With iThreads > 1
+// subdirectories are read in parallel. Returns false when sRoot cannot be
+// opened; unreadable subdirectories are logged and skipped.
+bool fn_walkDirectory(const std::string& sRoot, bool bRecursive, int iThreads,
+                      const fnWalkFilter& fnFilter, const fnWalkCallback& fnOnFile);
+
+#endif // DIRECTORY_WALKER_H
@@ -0,0 +1,62 @@
+// exif_editor.h - In-place EXIF (TIFF IFD) editing for converted images
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#ifndef EXIF_EDITOR_H
+#define EXIF_EDITOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Edits applied to the EXIF block before it is written to the output. The
+// block keeps its size and byte order; only the touched entries and the
+// bytes they owned change, so no IFD is re-serialised.
+struct sExifEditOptions
+{
+    bool bStripGps = false;            // Drop the GPS IFD pointer and wipe the GPS IFD
+    bool bStripMakerNote = false;      // Drop the MakerNote tag and wipe its bytes
+    bool bResetOrientation = true;     // Orientation = 1; the decoder applies irot/imir
+    int iPixelWidth = 0;               // PixelXDimension to write (0 = leave as is)
+    int iPixelHeight = 0;              // PixelYDimension to write (0 = leave as is)
+}; // End struct sExifEditOptions
+
+// Offset of the TIFF header in an EXIF block: bare, after "Exif\0\0" or
+// after the 4-byte HEIF offset field. False when there is none.
+bool fn_findTiffHeader(const unsigned char* pData, size_t stSize, size_t& stTiff);
+
+// Whether any edit is requested
+bool fn_isExifEditRequested(const sExifEditOptions& oOptions);
+
+// Edit a TIFF/EXIF block in place. pData may start with the TIFF header, an
+// "Exif\0\0" prefix or the 4-byte HEIF offset. Returns false, with nothing
+// changed, when the IFD0 / Exif IFD structure cannot be parsed.
+bool fn_editExif(unsigned char* pData, size_t stSize, const sExifEditOptions& oOptions);
+
+// As above; a block that cannot be parsed is cleared when GPS stripping was
+// requested, since its location data could not be removed
+bool fn_editExif(std::vector<unsigned char>& vExif, const sExifEditOptions& oOptions);
+
+// One IFD entry with its values in host byte order
+struct sExifEntry
+{
+    uint16_t uTag = 0;
+    uint16_t uType = 0;                  // TIFF field type (2 ASCII, 3 SHORT, 5 RATIONAL, ...)
+    uint32_t uCount = 0;
+    std::vector<unsigned char> vValue;   // uCount values; RATIONALs as two 32-bit words
+}; // End struct sExifEntry
+
+// The entries of IFD0 and of the Exif and GPS IFDs it points to
+struct sExifDirectories
+{
+    std::vector<sExifEntry> vIfd0;
+    std::vector<sExifEntry> vExif;
+    std::vector<sExifEntry> vGps;
+}; // End struct sExifDirectories
+
+// Read the directories of an EXIF block so they can be re-serialised as a
+// TIFF output's own IFDs. Sub-IFD pointers and entries of unknown type or
+// with values outside the block are left out. False when IFD0 is unusable.
+bool fn_readExifDirectories(const unsigned char* pData, size_t stSize, sExifDirectories& oDirectories);
+
+#endif // EXIF_EDITOR_H
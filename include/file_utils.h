@@ -36,7 +36,7 @@ std::vector<unsigned char> fn_readBinaryFile(const std::string& sFilePath);
 std::string fn_getDirectory(const std::string& sPath);
 bool fn_directoryExists(const std::string& sPath);
 bool fn_createDirectoryIfNeeded(const std::string& sPath);
-std::vector<std::string> fn_collectDirectoryFiles(const std::string& sDirectory, bool bRecursive);
+std::vector<std::string> fn_collectDirectoryFiles(const std::string& sDirectory, bool bRecursive, int iThreads = 1);
 
 // NEW: Timestamp functions
 FileTimestamps fn_getFileTimestamps(const std::string& sFilePath);
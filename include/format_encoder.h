@@ -8,6 +8,11 @@
 #include <vector>
 #include <string>
 #include <ctime>
+#include <cstdio>
+#include <cstddef>
+#include <functional>
+#include "image_buffer.h"
+#include "output_file.h"
 
 // Structure to hold raw image data
 struct sImageData {
@@ -16,22 +21,89 @@ struct sImageData {
     int iHeight;
     int iChannels;
     int iBitDepth;
+    size_t stStride = 0; // Bytes between rows; 0 means tightly packed
 };
 
+// Describe an ImageBuffer for the encoders without copying its pixels
+sImageData fn_makeImageData(const ImageBuffer& oBuffer);
+
+// Bytes between the starts of two rows of oImageData
+size_t fn_getImageStride(const sImageData& oImageData);
+
+// Present a whole frame as a single-band stream
+sImageStream fn_makeImageStream(const sImageData& oImageData);
+
+// WebP encoder settings beyond quality
+struct sWebPOptions {
+    bool bLossless = false;
+    int iEffort = 4;           // libwebp method: 0 (fastest) to 6 (smallest)
+    int iNearLossless = 100;   // Lossless preprocessing, 0 (most) to 100 (off)
+    int iAlphaQuality = 100;   // Lossy alpha plane quality (0-100)
+    bool bMultithread = true;  // Let libwebp use a second thread per image
+};
+
+// JPEG encoder settings
+struct sJpegOptions {
+    bool bParallelStrips = false; // Encode iMCU-row strips on iThreads workers and splice them
+    int iRestartRows = 0;         // Restart marker every N iMCU rows (0 = none)
+};
+
+// PNG encoder settings
+struct sPngOptions {
+    int iCompressionLevel = 6; // zlib level 0-9
+    bool bFast = false;        // Up filter on every row and run-length deflate
+};
+
+// TIFF compression schemes
+enum class eTiffCompression {
+    None,
+    Lzw,
+    Deflate
+};
+
+// TIFF encoder settings
+struct sTiffOptions {
+    eTiffCompression eCompression = eTiffCompression::Deflate;
+    int iLevel = 6;            // Deflate level 0-9
+    bool bPredictor = true;    // Horizontal differencing before LZW or Deflate
+};
+
+// Parse "none", "lzw" or "deflate"; false for anything else
+bool fn_parseTiffCompression(const std::string& sName, eTiffCompression& eCompression);
+
+// Name of a TIFF compression scheme
+std::string fn_getTiffCompressionName(eTiffCompression eCompression);
+
 // Structure for encoding options
 struct sEncodeOptions {
     std::string sFormat;
-    int iQuality; // For JPEG, WebP
-    int iCompressionLevel; // For PNG, TIFF
-    bool bProgressive; // For JPEG
-    bool bInterlace; // For PNG
-    bool bLossless; // For WebP
+    int iQuality = 85; // For JPEG, WebP
+    int iCompressionLevel = 6; // For PNG
+    bool bProgressive = false; // For JPEG
+    bool bInterlace = false; // For PNG
+    bool bFastFilter = false; // For PNG: fixed Up filter, quick deflate
+    int iThreads = 1; // Workers for one image (PNG deflate bands, JPEG and TIFF strips)
+    sJpegOptions oJpeg; // For JPEG
+    sWebPOptions oWebP; // For WebP
+    sTiffOptions oTiff; // For TIFF
     std::vector<unsigned char> vExifData; // NEW: EXIF metadata
     std::vector<unsigned char> vXmpData;  // NEW: XMP metadata
     std::vector<unsigned char> vIptcData; // NEW: IPTC metadata
-    bool bPreserveMetadata;               // NEW: Preserve metadata flag
+    std::vector<unsigned char> vIccProfile; // ICC colour profile
+    bool bPreserveMetadata = false;       // NEW: Preserve metadata flag
+    sOutputOptions oOutput;               // Timestamps, sync and replace for file outputs
 };
 
+// Encoder options for sFormat from the settings shared by every conversion
+// path (per-file and pipeline); metadata is added by the caller
+sEncodeOptions fn_makeEncodeOptions(const std::string& sFormat, int iQuality, int iThreads,
+                                    const sOutputOptions& oOutput, const sWebPOptions& oWebP,
+                                    const sPngOptions& oPng, const sJpegOptions& oJpeg,
+                                    const sTiffOptions& oTiff);
+
+// JPEG, WebP, PNG and TIFF carry the source metadata
+bool fn_formatCarriesMetadata(const std::string& sFormat);
+
 class FormatEncoder {
 public:
     // Constructor and Destructor
@@ -45,6 +117,44 @@ public:
         const sEncodeOptions& oOptions
     );
 
+    // Encode into a memory buffer instead of a file (all formats except TIFF,
+    // which needs a seekable file)
+    bool fn_encodeToMemory(
+        const sImageData& oImageData,
+        const sEncodeOptions& oOptions,
+        std::vector<unsigned char>& vOutput
+    );
+
+    // Whether fn_encodeToMemory can produce the given format
+    bool fn_supportsMemoryOutput(const std::string& sFormat);
+
+    // Encode band by band; JPEG, PNG and TIFF never hold more than one band,
+    // other formats collect the bands into a full frame first
+    bool fn_encodeStream(
+        const sImageStream& oStream,
+        const std::string& sOutputPath,
+        const sEncodeOptions& oOptions
+    );
+
+    // Whether fn_encodeStream writes the format without a full frame
+    bool fn_supportsStreaming(const std::string& sFormat);
+
+    // Encode YCbCr 4:2:0 planes directly (JPEG raw data, lossy WebP YUV),
+    // skipping the RGB round trip and the encoder's chroma downsampling
+    bool fn_encodePlanar(
+        const sPlanarImage& oPlanar,
+        const std::string& sOutputPath,
+        const sEncodeOptions& oOptions
+    );
+    bool fn_encodePlanarToMemory(
+        const sPlanarImage& oPlanar,
+        const sEncodeOptions& oOptions,
+        std::vector<unsigned char>& vOutput
+    );
+
+    // Whether fn_encodePlanar can produce the format with these options
+    bool fn_supportsPlanar(const sEncodeOptions& oOptions);
+
     // Get supported formats
     std::vector<std::string> fn_getSupportedFormats();
 
@@ -52,6 +162,37 @@ public:
     bool fn_validateFormat(const std::string& sFormat);
 
 private:
+    // Validate image data and options before encoding
+    bool fn_validateInput(const sImageData& oImageData, const sEncodeOptions& oOptions);
+
+    // Route a stream-capable format to its encoder
+    bool fn_encodeToStream(
+        const sImageData& oImageData,
+        FILE* fp,
+        const sEncodeOptions& oOptions,
+        const std::string& sFormatLower
+    );
+
+    // Stream encoders shared by the file and memory paths
+    bool fn_encodeJPEGToStream(const sImageData& oImageData, FILE* fp, const sEncodeOptions& oOptions);
+    bool fn_encodePNGToStream(const sImageData& oImageData, FILE* fp, const sEncodeOptions& oOptions);
+    bool fn_encodeWebPToStream(const sImageData& oImageData, FILE* fp, const sEncodeOptions& oOptions);
+    bool fn_encodeBMPToStream(const sImageData& oImageData, FILE* fp, const sEncodeOptions& oOptions);
+
+    // Row-streaming cores behind the JPEG, PNG and TIFF encoders
+    bool fn_encodeJPEGRows(const sImageStream& oStream, FILE* fp, const sEncodeOptions& oOptions);
+    bool fn_encodePNGRows(const sImageStream& oStream, FILE* fp, const sEncodeOptions& oOptions);
+    bool fn_encodePNGDirect(const sImageStream& oStream, FILE* fp, const sEncodeOptions& oOptions);
+    bool fn_encodeTIFFRows(const sImageStream& oStream, const std::string& sOutputPath, const sEncodeOptions& oOptions);
+
+    // YCbCr plane encoders behind fn_encodePlanar
+    bool fn_encodePlanarToStream(const sPlanarImage& oPlanar, FILE* fp, const sEncodeOptions& oOptions);
+    bool fn_encodeJPEGPlanar(const sPlanarImage& oPlanar, FILE* fp, const sEncodeOptions& oOptions);
+    bool fn_encodeWebPPlanar(const sPlanarImage& oPlanar, FILE* fp, const sEncodeOptions& oOptions);
+
+    // Gather every band of a stream into one frame (no copy for one band)
+    bool fn_collectStream(const sImageStream& oStream, ImageBuffer& oFrame);
+
     // PNG encoding function
     bool fn_encodePNG(
         const sImageData& oImageData,
@@ -94,7 +235,8 @@ private:
     bool fn_checkBMPSupport();
     bool fn_checkTIFFSupport();
 
-    // NEW: Metadata helper functions
+    // NEW: Metadata helper functions (JPEG markers are written by the
+    // regular encoder; this is kept as an alias)
     bool fn_writeJpegWithMetadata(
         const sImageData& oImageData,
         const std::string& sOutputPath,
@@ -4,15 +4,18 @@
 
 #include <string>
 #include <vector>
+#include "image_buffer.h"
 
 #ifdef HAVE_LIBHEIF
 #include <libheif/heif.h>
 #endif
 
+class HeifContainer;
+
 // Object to store decoded image data
 struct oDecodedImage
 {
-    std::vector<unsigned char> vData; // Raw pixel data
+    ImageBuffer oPixels;              // Interleaved pixels (may borrow the decoder plane)
     int iWidth;                       // Image width in pixels
     int iHeight;                      // Image height in pixels
     int iChannels;                    // Number of color channels (3 for RGB, 4 for RGBA)
@@ -44,6 +47,17 @@ public:
     // Main decoding functions
     oDecodedImage fn_decodeFile(const std::string& sFilePath);               // Local Function
     oDecodedImage fn_decodeMemory(const std::vector<unsigned char>& vData);  // Local Function
+    oDecodedImage fn_decodeContainer(const HeifContainer& oContainer);       // Local Function, no re-parse
+    
+    // Stream a grid image one row of tiles at a time (false when the image
+    // is not a grid or libheif lacks tile decoding). oContainer and this
+    // decoder must outlive the stream.
+    bool fn_openTileRowStream(const HeifContainer& oContainer, sImageStream& oStream);  // Local Function
+    
+    // Decode the primary image to 8-bit YCbCr 4:2:0 planes, skipping the RGB
+    // conversion (false when it is not 4:2:0 or has alpha, more than 8 bits
+    // or a non-BT.601 matrix; decode to RGB instead)
+    bool fn_decodePlanar(const HeifContainer& oContainer, sPlanarImage& oPlanar);  // Local Function
     
     // Information functions
     oHeicInfo fn_getImageInfo(const std::string& sFilePath);                // Local Function
@@ -64,6 +78,15 @@ public:
     // NEW: Set logger for debugging
     void fn_setLogger(class oLogger* pLogger) { m_pLogger = pLogger; }    // Local Function
     
+    // Threads used to decode the tiles of one grid image (1 = serial)
+    void fn_setTileThreads(int iThreads);                                   // Local Function
+    int fn_getTileThreads() const { return m_iTileThreads; }                // Local Function
+    
+    // Preview mode: longest output side in pixels (0 = full size). A stored
+    // thumbnail at least this large is decoded instead of the primary image.
+    void fn_setMaxDimension(int iMaxDimension);                             // Local Function
+    int fn_getMaxDimension() const { return m_iMaxDimension; }              // Local Function
+    
 private:
     // Private variables
     std::string sLastError;                      // Last error message
@@ -71,17 +94,24 @@ private:
     std::string sEmbeddedCodecPath;              // Path to embedded codec data (if needed)
     std::vector<std::string> vsSupportedFormats; // List of supported formats
     class oLogger* m_pLogger;                    // NEW: Logger pointer
+    int m_iTileThreads;                          // Tile decode workers per image
+    int m_iMaxDimension;                         // Preview size limit (0 = none)
     
     #ifdef HAVE_LIBHEIF
-    // Libheif context and handle
-    struct heif_context* pHeifContext;
-    struct heif_image_handle* pHeifHandle;
+    // Decoded libheif image (context and handle belong to HeifContainer)
     struct heif_image* pHeifImage;
     
     // Private functions for libheif
-    bool fn_decodeWithLibHeif(const std::vector<unsigned char>& vData, oDecodedImage& oResult);
+    bool fn_decodeWithLibHeif(const HeifContainer& oContainer, oDecodedImage& oResult);
     void fn_cleanupLibHeif();
     
+    // Decode grid tiles concurrently into one buffer (false = not a grid
+    // image, tiled decoding unavailable, or a tile failed)
+    bool fn_decodeTiled(struct heif_image_handle* pHandle, oDecodedImage& oResult);
+    
+    // Smallest thumbnail covering m_iMaxDimension (caller releases; nullptr = none)
+    struct heif_image_handle* fn_selectThumbnail(struct heif_image_handle* pPrimary);
+    
     // NEW: Panorama handling
     bool fn_handlePanoramaImage(struct heif_image_handle* handle, oDecodedImage& oResult);
     #else
@@ -95,7 +125,10 @@ private:
     #endif
     
     // Fallback dummy decoder
-    oDecodedImage fn_decodeDummy(const std::vector<unsigned char>& vData);
+    oDecodedImage fn_decodeDummy();
+    
+    // Shrink a decoded image to m_iMaxDimension
+    bool fn_fitToMaxDimension(oDecodedImage& oResult);
 }; // End class HeicDecoder
 
 #endif // HEIC_DECODER_H
\ No newline at end of file
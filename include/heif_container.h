@@ -0,0 +1,75 @@
+// heif_container.h - Parsed HEIF/HEIC container shared by decode and metadata
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#ifndef HEIF_CONTAINER_H
+#define HEIF_CONTAINER_H
+
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+
+#ifdef HAVE_LIBHEIF
+#include <libheif/heif.h>
+#endif
+
+// One parsed HEIF file: the box structure is read once and the same context
+// and primary image handle serve decoding and EXIF/XMP/ICC extraction
+class HeifContainer
+{
+public:
+    // Constructor and destructor
+    HeifContainer();                                                         // Local Function
+    ~HeifContainer();                                                        // Local Function
+
+    HeifContainer(const HeifContainer&) = delete;
+    HeifContainer& operator=(const HeifContainer&) = delete;
+
+    // Open functions (any previously opened file is closed first)
+    bool fn_openFile(const std::string& sFilePath,
+                     eMapAccess eAccess = eMapAccess::Normal);               // Local Function, mmap()s the file
+    bool fn_openMemory(const unsigned char* pData, size_t stSize);           // Local Function, caller keeps pData alive
+    void fn_close();                                                         // Local Function
+
+    // State
+    bool fn_isOpen() const;                                                  // Local Function
+    std::string fn_getLastError() const;                                     // Local Function
+    const unsigned char* fn_getFileData() const;                             // Local Function, kept even if parsing failed
+    size_t fn_getFileSize() const;                                           // Local Function
+
+    // Primary image properties
+    int fn_getWidth() const;                                                 // Local Function
+    int fn_getHeight() const;                                                // Local Function
+    bool fn_hasAlpha() const;                                                // Local Function
+
+    // Metadata blocks of the primary image (raw bytes as stored in the file)
+    std::vector<unsigned char> fn_getExifBlock() const;                      // Local Function
+    std::vector<unsigned char> fn_getXmpBlock() const;                       // Local Function
+    std::vector<unsigned char> fn_getIccProfile() const;                     // Local Function
+
+    #ifdef HAVE_LIBHEIF
+    // Raw libheif access for the decoder
+    struct heif_context* fn_getContext() const { return pHeifContext; }               // Local Function
+    struct heif_image_handle* fn_getPrimaryHandle() const { return pPrimaryHandle; } // Local Function
+    #endif
+
+private:
+    std::string sLastError;                      // Last error message
+    MappedFile oInput;                           // Mapped bytes when opened from a file
+    const unsigned char* pFileData;              // Bytes libheif reads from (mapped or borrowed)
+    size_t stFileSize;                           // Size of pFileData
+
+    bool fn_parse(const unsigned char* pData, size_t stSize);
+    void fn_releaseContext();
+
+    #ifdef HAVE_LIBHEIF
+    struct heif_context* pHeifContext;
+    struct heif_image_handle* pPrimaryHandle;
+
+    std::vector<unsigned char> fn_getMetadata(const char* pType, const char* pContentType) const;
+    #else
+    bool bOpen;
+    #endif
+}; // End class HeifContainer
+
+#endif // HEIF_CONTAINER_H
@@ -0,0 +1,62 @@
+// heif_probe.h - HEIF/HEIC container probe (no HEVC decoding)
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#ifndef HEIF_PROBE_H
+#define HEIF_PROBE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Primary image facts read from the ftyp and meta boxes only. Item data is
+// touched just for the grid descriptor and the EXIF orientation tag, so a
+// probe costs a few small reads no matter how large the file is.
+struct sHeifProbe
+{
+    std::string sBrand;                // Major brand from ftyp (heic, mif1, avif, ...)
+    std::string sCodec;                // Primary item type (hvc1, av01, grid, ...)
+    int iWidth = 0;                    // Coded width (ispe, or grid output size)
+    int iHeight = 0;                   // Coded height
+    int iDisplayWidth = 0;             // Width after irot
+    int iDisplayHeight = 0;            // Height after irot
+    int iBitDepth = 8;                 // Bits per channel (pixi, else hvcC)
+    int iChromaFormat = 1;             // 0 = mono, 1 = 4:2:0, 2 = 4:2:2, 3 = 4:4:4
+    bool bHasAlpha = false;            // An auxl alpha plane belongs to the primary
+    std::string sColorType;            // colr type: nclx, prof, rICC or empty
+    int iColourPrimaries = 2;          // nclx values (2 = unspecified)
+    int iTransferCharacteristics = 2;
+    int iMatrixCoefficients = 2;
+    bool bFullRange = false;
+    int iRotation = 0;                 // irot, degrees anti-clockwise
+    int iMirrorAxis = -1;              // imir: -1 none, 0 vertical, 1 horizontal
+    int iExifOrientation = 0;          // EXIF 0x0112 (0 when absent)
+    bool bIsGrid = false;              // Primary is a grid of tiles
+    int iGridRows = 0;
+    int iGridColumns = 0;
+    int iTileWidth = 0;                // ispe of the first tile
+    int iTileHeight = 0;
+    int iImageCount = 0;               // Top-level images (tiles, thumbnails, aux excluded)
+    int iThumbnailCount = 0;           // thmb items attached to the primary
+    int iThumbnailWidth = 0;           // Largest thumbnail
+    int iThumbnailHeight = 0;
+    bool bHasExif = false;
+    bool bHasXmp = false;
+    uint64_t ullFileSize = 0;          // Bytes in the file (or memory block)
+}; // End struct sHeifProbe
+
+// Probe functions (false with sError set when the file is not a usable HEIF)
+bool fn_probeHeifFile(const std::string& sFilePath, sHeifProbe& oProbe, std::string& sError);
+bool fn_probeHeifMemory(const unsigned char* pData, size_t stSize, sHeifProbe& oProbe, std::string& sError);
+
+// Bytes of the interleaved 8/16-bit frame a full decode will produce
+uint64_t fn_getProbeDecodeBytes(const sHeifProbe& oProbe);
+
+// Human readable colour space for the probed colr box
+std::string fn_getProbeColorSpace(const sHeifProbe& oProbe);
+
+// One JSON object, no trailing newline (for --probe output)
+std::string fn_probeToJson(const std::string& sFilePath, const sHeifProbe& oProbe);
+std::string fn_probeErrorToJson(const std::string& sFilePath, const std::string& sError);
+
+#endif // HEIF_PROBE_H
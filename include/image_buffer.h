@@ -0,0 +1,93 @@
+// image_buffer.h - Ref-counted, stride-aware pixel buffer
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#ifndef IMAGE_BUFFER_H
+#define IMAGE_BUFFER_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+// View over interleaved pixels plus a shared reference to whatever owns the
+// memory (a heap block or a decoder plane such as heif_image). Copies share
+// the pixels; moves transfer them. Rows may be padded, so always step by
+// fn_getStride() rather than width * channels.
+class ImageBuffer
+{
+public:
+    // Constructor and destructor
+    ImageBuffer();                                                           // Local Function
+    ~ImageBuffer();                                                          // Local Function
+
+    ImageBuffer(const ImageBuffer&) = default;
+    ImageBuffer& operator=(const ImageBuffer&) = default;
+    ImageBuffer(ImageBuffer&& oOther) noexcept;                              // Local Function
+    ImageBuffer& operator=(ImageBuffer&& oOther) noexcept;                   // Local Function
+
+    // Allocate a tightly packed buffer owned by this object (uninitialised)
+    static ImageBuffer fn_allocate(int iWidth, int iHeight, int iChannels, int iBitDepth = 8);  // Local Function
+
+    // Borrow memory kept alive by pOwner (released when the last copy goes)
+    static ImageBuffer fn_wrap(unsigned char* pData, int iWidth, int iHeight, size_t stStride,
+                               int iChannels, int iBitDepth, std::shared_ptr<void> pOwner);  // Local Function
+
+    // Drop this reference
+    void fn_reset();                                                         // Local Function
+
+    // Geometry
+    int fn_getWidth() const { return m_iWidth; }                             // Local Function
+    int fn_getHeight() const { return m_iHeight; }                           // Local Function
+    int fn_getChannels() const { return m_iChannels; }                       // Local Function
+    int fn_getBitDepth() const { return m_iBitDepth; }                       // Local Function
+    size_t fn_getStride() const { return m_stStride; }                       // Local Function, bytes per row
+    size_t fn_getRowBytes() const;                                           // Local Function, pixel bytes per row
+    bool fn_isEmpty() const { return m_pData == nullptr; }                   // Local Function
+    bool fn_isContiguous() const { return m_stStride == fn_getRowBytes(); }  // Local Function
+
+    // Pixel access
+    unsigned char* fn_getData() const { return m_pData; }                    // Local Function
+    unsigned char* fn_getRow(int iRow) const { return m_pData + static_cast<size_t>(iRow) * m_stStride; }  // Local Function
+
+private:
+    std::shared_ptr<void> m_pOwner;              // Keeps the pixels alive
+    unsigned char* m_pData;                      // First pixel of row 0
+    int m_iWidth;                                // Width in pixels
+    int m_iHeight;                               // Height in pixels
+    int m_iChannels;                             // Interleaved channels (1-4)
+    int m_iBitDepth;                             // Bits per channel (8 or 16)
+    size_t m_stStride;                           // Bytes between row starts
+}; // End class ImageBuffer
+
+// Shrink an 8-bit image so its longer side is at most iMaxDimension, by
+// averaging whole source boxes. Images that already fit are returned as-is
+// (shared, not copied); an empty buffer means the allocation failed.
+ImageBuffer fn_shrinkToFit(const ImageBuffer& oSource, int iMaxDimension);
+
+// An image delivered as successive bands of full-width rows, top to bottom,
+// so an encoder can write scanlines before the whole frame exists
+struct sImageStream
+{
+    int iWidth = 0;                              // Width in pixels
+    int iHeight = 0;                             // Height in pixels
+    int iChannels = 0;                           // Interleaved channels (1-4)
+    int iBitDepth = 8;                           // Bits per channel
+    std::function<bool(ImageBuffer& oBand)> fnNextBand;  // Next rows; band valid until the next call
+}; // End struct sImageStream
+
+// 8-bit YCbCr 4:2:0 planes as the HEVC decoder produced them, for encoders
+// that take YCbCr themselves. Chroma planes are (iWidth + 1) / 2 by
+// (iHeight + 1) / 2. The matrix is always BT.601 (JPEG's and WebP's own).
+struct sPlanarImage
+{
+    int iWidth = 0;                              // Luma width in pixels
+    int iHeight = 0;                             // Luma height in pixels
+    const unsigned char* apPlane[3] = {nullptr, nullptr, nullptr};  // Y, Cb, Cr
+    size_t astStride[3] = {0, 0, 0};             // Bytes between rows of each plane
+    bool bFullRange = true;                      // false: Y 16-235, Cb/Cr 16-240
+    std::shared_ptr<void> pOwner;                // Keeps the planes alive
+    
+    bool fn_isEmpty() const { return apPlane[0] == nullptr; }  // Local Function
+}; // End struct sPlanarImage
+
+#endif // IMAGE_BUFFER_H
@@ -2,9 +2,22 @@
 #ifndef IMAGE_PROCESSOR_H
 #define IMAGE_PROCESSOR_H
 
+#include <functional>
 #include <string>
 #include <vector>
 #include "logger.h"
+#include "image_buffer.h"
+#include "format_encoder.h"
+#include "image_resizer.h"
+#include "exif_editor.h"
+#include "rendition.h"
+
+class HeifContainer;
+
+// Threads one image may use right now. Asked again before the decode, the
+// resize and the encode, so a file still running when the rest of a batch
+// has finished picks up the freed workers for its remaining steps.
+typedef std::function<int()> fnThreadShare;
 
 class ImageProcessor 
 {
@@ -19,6 +32,20 @@ class ImageProcessor
                              const std::string& sOutputFormat = "",
                              int iQuality = 85);
         
+        // Convert from an already parsed container (file is not read again)
+        bool fn_convertImage(const HeifContainer& oContainer,
+                             const std::string& sInputPath, 
+                             const std::string& sOutputPath,
+                             const std::string& sOutputFormat = "",
+                             int iQuality = 85);
+        
+        // Decode once and write every rendition (vsOutputPaths matches vRenditions)
+        bool fn_convertRenditions(const HeifContainer& oContainer,
+                                  const std::string& sInputPath,
+                                  const std::vector<sRendition>& vRenditions,
+                                  const std::vector<std::string>& vsOutputPaths,
+                                  int iQuality = 85);
+        
         // NEW: Convert image with metadata preservation
         bool fn_convertImageWithMetadata(
             const std::string& sInputPath, 
@@ -35,6 +62,27 @@ class ImageProcessor
         std::vector<std::string> fn_getSupportedOutputFormats();
         bool fn_setOutputQuality(int iQuality);
         int fn_getOutputQuality();
+        void fn_setTileThreads(int iThreads);
+        void fn_setThreadShare(const fnThreadShare& fnShare);  // Overrides fn_setTileThreads while set
+        void fn_setMaxDimension(int iMaxDimension);  // Preview size limit (0 = full size)
+        void fn_setResizeOptions(const sResizeOptions& oOptions);  // --scale / --fit
+        // Metadata embedded by following conversions to JPEG, WebP and PNG (empty clears it)
+        void fn_setMetadata(const std::vector<unsigned char>& vExifData,
+                            const std::vector<unsigned char>& vXmpData,
+                            const std::vector<unsigned char>& vIccProfile,
+                            const std::vector<unsigned char>& vIptcData = {});
+        // GPS / MakerNote stripping and orientation / size fixes for that EXIF
+        void fn_setExifEditOptions(const sExifEditOptions& oOptions);
+        // Timestamps, sync and replace for the files written
+        void fn_setOutputOptions(const sOutputOptions& oOptions);
+        // Effort, lossless and alpha settings for WebP output
+        void fn_setWebPOptions(const sWebPOptions& oOptions);
+        // Compression level and fast mode for PNG output
+        void fn_setPngOptions(const sPngOptions& oOptions);
+        // Strip-parallel encoding for JPEG output
+        void fn_setJpegOptions(const sJpegOptions& oOptions);
+        // Compression and deflate level for TIFF output
+        void fn_setTiffOptions(const sTiffOptions& oOptions);
         std::string fn_getLastError();
         
     private:
@@ -42,6 +90,20 @@ class ImageProcessor
         oLogger* m_pLogger;
         std::string m_sLastError;
         int m_iOutputQuality;
+        int m_iTileThreads;          // Grid tile decode workers per image
+        fnThreadShare m_fnThreadShare;  // Live thread count from the batch (empty = m_iTileThreads)
+        int m_iMaxDimension;         // Longest output side (0 = full size)
+        sResizeOptions m_oResize;    // Resize between decode and encode
+        std::vector<unsigned char> m_vExifData;    // Written as JPEG APP segments
+        std::vector<unsigned char> m_vXmpData;
+        std::vector<unsigned char> m_vIccProfile;
+        std::vector<unsigned char> m_vIptcData;
+        sExifEditOptions m_oExifEdit;              // Applied per output size
+        sOutputOptions m_oOutput;                  // Passed to every file encode
+        sWebPOptions m_oWebP;                      // Passed to every WebP encode
+        sPngOptions m_oPng;                        // Passed to every PNG encode
+        sJpegOptions m_oJpeg;                      // Passed to every JPEG encode
+        sTiffOptions m_oTiff;                      // Passed to every TIFF encode
         bool m_bCodecsInitialized;
         void* m_pHeifContext;
         void* m_pHeifImage;
@@ -49,18 +111,21 @@ class ImageProcessor
         // Private Methods
         bool fn_initializeCodecs();
         bool fn_cleanupResources();
-        bool fn_decodeHEIC(const std::string& sInputPath, 
-                          unsigned char** ppImageData, 
-                          int& iWidth, 
-                          int& iHeight, 
-                          int& iChannels);
-        bool fn_encodeImage(const unsigned char* pImageData, 
-                           int iWidth, 
-                           int iHeight, 
-                           int iChannels, 
+        bool fn_decodeHEIC(const HeifContainer& oContainer, 
+                          ImageBuffer& oPixels,
+                          int iMaxDimension);
+        bool fn_applyResize(ImageBuffer& oPixels);
+        int fn_getWorkThreads() const;
+        bool fn_encodeImage(const ImageBuffer& oPixels, 
                            const std::string& sOutputPath, 
                            const std::string& sOutputFormat, 
                            int iQuality);
+        bool fn_encodeStream(const sImageStream& oStream, 
+                            const std::string& sOutputPath, 
+                            const std::string& sOutputFormat, 
+                            int iQuality);
+        sEncodeOptions fn_makeEncodeOptions(const std::string& sOutputFormat, int iQuality,
+                                            int iWidth = 0, int iHeight = 0);
         
         // NEW: Encode with metadata
         bool fn_encodeImageWithMetadata(
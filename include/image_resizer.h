@@ -0,0 +1,57 @@
+// image_resizer.h - Separable image resampling for HEIC/HEIF converter
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#ifndef IMAGE_RESIZER_H
+#define IMAGE_RESIZER_H
+
+#include <string>
+#include "image_buffer.h"
+
+// Resampling filter (each pass uses the same kernel)
+enum class eResizeFilter
+{
+    Box,        // Area average, fastest, softest on upscale
+    Bilinear,   // Triangle filter
+    Lanczos3    // Windowed sinc, 3 lobes (default)
+}; // End enum eResizeFilter
+
+// Requested output geometry. The scale factor is applied first, then the
+// result is shrunk (never enlarged) to fit the box; aspect ratio is kept.
+struct sResizeOptions
+{
+    float fScale = 1.0f;                       // Uniform scale (1 = unchanged)
+    int iFitWidth = 0;                         // Fit-within box (0 = no limit)
+    int iFitHeight = 0;
+    eResizeFilter eFilter = eResizeFilter::Lanczos3;
+}; // End struct sResizeOptions
+
+// Output size for an image (false when the options leave it unchanged)
+bool fn_getResizeTarget(int iSrcWidth, int iSrcHeight, const sResizeOptions& oOptions,
+                        int& iDstWidth, int& iDstHeight);
+
+// True when the options can change an image's size
+bool fn_isResizeRequested(const sResizeOptions& oOptions);
+
+// Resample an 8 or 16-bit image (horizontal pass, then vertical). Rows are
+// split across up to iThreads threads through a TaskGroup.
+// Returns an empty buffer on bad arguments or allocation failure, and the
+// source itself (shared) when the size does not change.
+ImageBuffer fn_resizeImage(const ImageBuffer& oSource, int iDstWidth, int iDstHeight,
+                           eResizeFilter eFilter, int iThreads = 1);
+
+// fn_getResizeTarget + fn_resizeImage
+ImageBuffer fn_resizeForOptions(const ImageBuffer& oSource, const sResizeOptions& oOptions,
+                                int iThreads = 1);
+
+// Filter names: box, bilinear, lanczos (or lanczos3)
+bool fn_parseResizeFilter(const std::string& sName, eResizeFilter& eFilter);
+std::string fn_getResizeFilterName(eResizeFilter eFilter);
+
+// 8-bit kernel set in use: avx2, sse4.1, neon or scalar. The best one the
+// CPU supports is picked on first use; fn_setResizeKernel overrides it and
+// fails for a kernel this build or CPU cannot run.
+std::string fn_getResizeKernel();
+bool fn_setResizeKernel(const std::string& sKernel);
+
+#endif // IMAGE_RESIZER_H
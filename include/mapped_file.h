@@ -0,0 +1,56 @@
+// mapped_file.h - Read-only memory-mapped input file with read() fallback
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// Access pattern hint passed to madvise()
+enum class eMapAccess
+{
+    Normal,      // No hint beyond WILLNEED
+    Sequential,  // Read front to back once (aggressive readahead, early drop)
+    Prefault     // Fault the whole file in now (for a dedicated read stage)
+}; // End enum eMapAccess
+
+// A whole input file viewed as one contiguous byte range. Regular files are
+// mmap()ed read-only so no heap copy is made; pipes, devices and files on
+// filesystems that refuse mmap are read into an owned, uninitialised buffer.
+class MappedFile
+{
+public:
+    // Constructor and destructor
+    MappedFile();                                                            // Local Function
+    ~MappedFile();                                                           // Local Function
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& oOther) noexcept;                                // Local Function
+    MappedFile& operator=(MappedFile&& oOther) noexcept;                     // Local Function
+
+    // Open functions (any previously opened file is closed first)
+    bool fn_open(const std::string& sFilePath, eMapAccess eAccess = eMapAccess::Normal);  // Local Function
+    void fn_close();                                                         // Local Function
+
+    // State
+    const unsigned char* fn_getData() const { return m_pData; }              // Local Function
+    size_t fn_getSize() const { return m_stSize; }                           // Local Function
+    bool fn_isOpen() const { return m_pData != nullptr; }                    // Local Function
+    bool fn_isMapped() const { return m_bMapped; }                           // Local Function
+    std::string fn_getLastError() const { return m_sLastError; }             // Local Function
+
+private:
+    const unsigned char* m_pData;                // Start of the file bytes
+    size_t m_stSize;                             // File size in bytes
+    bool m_bMapped;                              // true when m_pData is an mmap
+    std::unique_ptr<unsigned char[]> m_pBuffer;  // Owned bytes for the fallback
+    std::string m_sLastError;                    // Last error message
+
+    bool fn_readFallback(int iFd, const std::string& sFilePath, size_t stSizeHint);  // Local Function
+}; // End class MappedFile
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,86 @@
+// memory_budget.h - Per-file cost estimates and memory admission control
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "heif_probe.h"
+
+// Memory the process may use: the cgroup v2 memory.max of this process (or
+// the v1 limit) capped by physical RAM; 0 when nothing is known
+uint64_t fn_getSystemMemoryLimit();
+
+// memory.max of a cgroup v2 directory or memory.limit_in_bytes of a v1 one
+// (0 for "max", absent files and the v1 "unlimited" sentinel)
+uint64_t fn_readCgroupMemoryLimit(const std::string& sCgroupDirectory);
+
+// Byte counts with an optional K, M, G or T suffix (powers of 1024),
+// e.g. "1073741824", "512M", "1.5G", "8GiB"
+bool fn_parseMemorySize(const std::string& sText, uint64_t& ullBytes);
+std::string fn_formatMemorySize(uint64_t ullBytes);
+
+// --memory-limit value: "auto" takes 80% of fn_getSystemMemoryLimit(),
+// "off" or "0" disables admission control, anything else is a size
+bool fn_resolveMemoryLimit(const std::string& sSetting, uint64_t& ullBytes);
+
+// Peak bytes converting one file: the decoded frame times the copies alive
+// at once (decoder planes, the RGB frame, a resize or encoder working copy)
+// plus the compressed input
+uint64_t fn_estimateConversionBytes(const sHeifProbe& oProbe);
+
+// fn_estimateConversionBytes from a header probe of the file (or a buffer
+// holding it), or a multiple of its size when it cannot be probed
+uint64_t fn_estimateFileConversionBytes(const std::string& sFilePath);
+uint64_t fn_estimateMemoryConversionBytes(const unsigned char* pData, size_t stSize);
+
+// Work and peak memory of one file from a single header probe
+struct sConversionCost
+{
+    uint64_t ullWork = 0;        // Pixels to decode; file size scaled to pixels when unprobed
+    uint64_t ullPeakBytes = 0;   // As fn_estimateFileConversionBytes
+}; // End struct sConversionCost
+
+sConversionCost fn_estimateFileCost(const std::string& sFilePath);
+
+// Indices of vCosts by descending work (longest processing time first);
+// equal costs keep their input order
+std::vector<size_t> fn_orderByCost(const std::vector<sConversionCost>& vCosts);
+
+// Byte budget shared by concurrent conversions. Requests are admitted in
+// arrival order while the sum in flight fits the limit; a request larger
+// than the whole limit waits until nothing else is in flight and then runs
+// alone. A limit of 0 admits everything at once.
+class MemoryBudget
+{
+public:
+    explicit MemoryBudget(uint64_t ullLimit = 0);                           // Local Function
+
+    MemoryBudget(const MemoryBudget&) = delete;
+    MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+    // Block until ullBytes may be used; returns the bytes to release later
+    uint64_t fn_acquire(uint64_t ullBytes);                                 // Local Function
+
+    // Give back what fn_acquire returned
+    void fn_release(uint64_t ullBytes);                                     // Local Function
+
+    uint64_t fn_getLimit() const { return m_ullLimit; }                     // Local Function
+    uint64_t fn_getInFlight() const;                                        // Local Function
+
+private:
+    const uint64_t m_ullLimit;                   // 0 = unlimited
+    mutable std::mutex m_oMutex;
+    std::condition_variable m_oChanged;
+    uint64_t m_ullInFlight;                      // Bytes admitted and not released
+    int m_iActive;                               // Requests admitted and not released
+    uint64_t m_ullNextTicket;                    // Arrival order of the next request
+    uint64_t m_ullServing;                       // Ticket allowed to be admitted next
+}; // End class MemoryBudget
+
+#endif // MEMORY_BUDGET_H
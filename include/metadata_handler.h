@@ -10,6 +10,8 @@
 #include <libheif/heif.h>
 #endif
 
+class HeifContainer;
+
 class MetadataHandler {
 public:
     MetadataHandler();
@@ -22,6 +24,11 @@ public:
     std::vector<unsigned char> extractExifFromHeicData(const std::vector<unsigned char>& data);
     std::vector<unsigned char> extractXmpFromHeic(const std::string& filepath);
     
+    // Extract metadata from an already parsed container (no re-read)
+    std::vector<unsigned char> extractExif(const HeifContainer& container);
+    std::vector<unsigned char> extractXmp(const HeifContainer& container);
+    std::vector<unsigned char> extractIccProfile(const HeifContainer& container);
+    
     // Write EXIF to JPEG file
     bool writeExifToJpeg(const std::string& jpegFile, const std::vector<unsigned char>& exifData);
     
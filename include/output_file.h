@@ -0,0 +1,95 @@
+// output_file.h - Atomic output file: temporary file, one buffered stream, link into place
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#ifndef OUTPUT_FILE_H
+#define OUTPUT_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <string>
+
+// When written outputs are forced to stable storage
+enum class eSyncMode
+{
+    None,   // Leave it to the kernel's writeback
+    File,   // fsync() each file and its directory before reporting success
+    Batch   // One syncfs() after the whole batch
+}; // End enum eSyncMode
+
+// How a finished output is published
+struct sOutputOptions
+{
+    eSyncMode eSync = eSyncMode::None;
+    bool bReplace = true;              // Replace an existing file; false fails with EEXIST
+    bool bSetTimes = false;            // Apply aTimes (atime, mtime) before the file appears
+    struct timespec aTimes[2] = {};
+}; // End struct sOutputOptions
+
+// none, file or batch
+bool fn_parseSyncMode(const std::string& sName, eSyncMode& eMode);
+std::string fn_getSyncModeName(eSyncMode eMode);
+
+// Take the access and modification times of sSourcePath for the output
+bool fn_setOutputTimesFrom(const std::string& sSourcePath, sOutputOptions& oOptions);
+
+// One output file. Data goes to an unnamed O_TMPFILE (or a hidden temporary
+// name where the filesystem lacks it) in the destination directory, through
+// one large stdio buffer. fn_commit sets the timestamps on the descriptor,
+// syncs as requested and links the file into place, so the final path only
+// ever holds a complete image. An output that is not committed is discarded.
+class OutputFile
+{
+public:
+    // Constructor and destructor
+    OutputFile();                                                            // Local Function
+    ~OutputFile();                                                           // Local Function
+
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+
+    // Start an output; ullSizeHint bytes are preallocated (0 = no hint)
+    bool fn_open(const std::string& sFilePath, uint64_t ullSizeHint = 0);    // Local Function
+
+    // Buffered stream on the file (nullptr when not open)
+    FILE* fn_getStream();                                                    // Local Function
+
+    // Descriptor for libraries that write by fd (dup() it if they close it)
+    int fn_getFd() const { return m_iFd; }                                   // Local Function
+
+    bool fn_write(const void* pData, size_t stSize);                         // Local Function
+
+    // Flush, apply times, sync and move into place
+    bool fn_commit(const sOutputOptions& oOptions);                          // Local Function
+
+    // Drop the output; the final path is left untouched
+    void fn_discard();                                                       // Local Function
+
+    bool fn_isOpen() const { return m_iFd >= 0; }                            // Local Function
+    std::string fn_getLastError() const { return m_sLastError; }             // Local Function
+
+private:
+    std::string m_sFilePath;                     // Final path
+    std::string m_sTempPath;                     // Named temporary (empty with O_TMPFILE)
+    int m_iFd;                                   // Temporary file descriptor
+    FILE* m_pStream;                             // Owns m_iFd once created
+    std::unique_ptr<char[]> m_pBuffer;           // stdio buffer for m_pStream
+    uint64_t m_ullReserved;                      // Bytes preallocated by fn_open
+    std::string m_sLastError;                    // Last error message
+
+    bool fn_publish(bool bReplace);                                          // Local Function
+    bool fn_fail(const std::string& sWhat);                                  // Local Function
+    void fn_closeFd();                                                       // Local Function
+}; // End class OutputFile
+
+// Write a whole encoded buffer as one atomic output
+bool fn_writeOutputFile(const std::string& sFilePath, const void* pData, size_t stSize,
+                        const sOutputOptions& oOptions, std::string& sError);
+
+// One syncfs() for the filesystem holding sPath (eSyncMode::Batch)
+bool fn_syncOutputFilesystem(const std::string& sPath);
+
+#endif // OUTPUT_FILE_H
@@ -0,0 +1,43 @@
+// pixel_kernels.h - SIMD row kernels for pixel layout conversions
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#ifndef PIXEL_KERNELS_H
+#define PIXEL_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// All kernels work on one row (or a run of rows) of 8-bit samples unless
+// noted, give identical bytes on every kernel set, and accept pSrc == pDst
+// when the output has the same layout as the input.
+
+// RGB <-> BGR, RGBA <-> BGRA (1 and 2 channel rows are copied)
+void fn_swapRedBlue(const uint8_t* pSrc, uint8_t* pDst, int iPixels, int iChannels);
+
+// RGBA -> RGB composited over an opaque background colour
+void fn_blendOverBackground(const uint8_t* pSrc, uint8_t* pDst, int iPixels, const uint8_t aBackground[3]);
+
+// Colour multiplied by alpha (associated alpha) for 2 or 4 channel rows
+void fn_premultiplyAlpha(const uint8_t* pSrc, uint8_t* pDst, int iPixels, int iChannels);
+void fn_premultiplyAlpha16(const uint16_t* pSrc, uint16_t* pDst, int iPixels, int iChannels, int iBitDepth);
+
+// 9-16 bit samples (native endian) -> 8-bit, rounded and saturated
+void fn_narrowTo8(const uint16_t* pSrc, uint8_t* pDst, size_t stSamples, int iBitDepth);
+
+// Grey from RGB(A) with BT.601 weights; 1 and 2 channel rows keep channel 0
+void fn_extractGrey(const uint8_t* pSrc, uint8_t* pDst, int iPixels, int iChannels);
+
+// Copy iRows rows bottom-up into pDst, zeroing each row past stRowBytes up
+// to stDstStride (BMP-style padding)
+void fn_copyRowsFlipped(const uint8_t* pSrc, size_t stSrcStride, uint8_t* pDst, size_t stDstStride,
+                        size_t stRowBytes, int iRows);
+
+// Kernel set in use: avx512, avx2, sse4.1, neon or scalar. The best one the
+// CPU supports is picked on first use; fn_setPixelKernel overrides it and
+// fails for a kernel this build or CPU cannot run.
+std::string fn_getPixelKernel();
+bool fn_setPixelKernel(const std::string& sKernel);
+
+#endif // PIXEL_KERNELS_H
@@ -0,0 +1,32 @@
+// png_writer.h - Direct PNG writer: row filtering and banded parallel deflate
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#ifndef PNG_WRITER_H
+#define PNG_WRITER_H
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+// Raw bytes of the row band one deflate task takes (rows are never split)
+const size_t stPNG_BAND_BYTES = 1024 * 1024;
+
+// How rows are filtered and deflated
+struct sPngWriterOptions
+{
+    int iCompressionLevel = 6;               // zlib level 0-9
+    bool bFastFilter = false;                // Up filter on every row and run-length deflate
+    const unsigned char* pExif = nullptr;    // EXIF block for an eXIf chunk (optional)
+    size_t stExifSize = 0;
+}; // End struct sPngWriterOptions
+
+// Write an 8-bit, non-interlaced PNG with 1 to 4 channels. Rows are filtered
+// with libpng's minimum-sum heuristic (or Up in fast mode) and deflated in
+// bands of about stPNG_BAND_BYTES. With iThreads > 1 the bands are filtered
+// and deflated on a TaskGroup, each primed with the 32 KiB window before it
+// and ended on a byte boundary, and joined into one zlib stream as pigz does.
+bool fn_writePng(FILE* fp, const unsigned char* pPixels, size_t stStride, int iWidth, int iHeight,
+                 int iChannels, const sPngWriterOptions& oOptions, int iThreads, std::string& sError);
+
+#endif // PNG_WRITER_H
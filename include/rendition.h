@@ -0,0 +1,46 @@
+// rendition.h - Several output formats and sizes from one decoded image
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#ifndef RENDITION_H
+#define RENDITION_H
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "image_buffer.h"
+#include "image_resizer.h"
+#include "format_encoder.h"
+
+// One output of a multi-rendition conversion. Written next to the regular
+// output path as <stem><suffix>.<format>.
+struct sRendition
+{
+    std::string sFormat;       // jpg, jpeg, png, webp, tiff, tif or bmp
+    int iMaxDimension = 0;     // Longest side in pixels (0 = decoded size, never enlarged)
+    std::string sSuffix;       // Appended to the file stem ("" or "_<size>" by default)
+}; // End struct sRendition
+
+// Parse FORMAT[:SIZE[:SUFFIX]], e.g. "jpg", "webp:2048", "jpg:320:_thumb"
+bool fn_parseRendition(const std::string& sSpec, sRendition& oRendition);
+
+// Read one spec per line; blank lines and lines starting with '#' are skipped
+bool fn_loadRenditionFile(const std::string& sPath, std::vector<std::string>& vsSpecs, std::string& sError);
+
+// <directory of sOutputPath>/<stem of sOutputPath><suffix>.<format>
+std::string fn_getRenditionPath(const std::string& sOutputPath, const sRendition& oRendition);
+
+// Encoder options for one rendition at its final size
+typedef std::function<sEncodeOptions(const sRendition& oRendition, int iWidth, int iHeight)> fnRenditionOptions;
+
+// Write every rendition of oSource. Sizes are produced largest first, each
+// resampled from the one before it rather than from the full image, and
+// each is handed to an encode worker as soon as it exists, so encodes of
+// the big outputs overlap the resizes of the small ones. iThreads is split
+// between the concurrent encodes. vbWritten reports each rendition; the
+// result is true when all of them were written.
+bool fn_encodeRenditions(const ImageBuffer& oSource, const std::vector<sRendition>& vRenditions,
+                         const std::vector<std::string>& vsOutputPaths, const fnRenditionOptions& fnMakeOptions,
+                         eResizeFilter eFilter, int iThreads, std::vector<bool>& vbWritten);
+
+#endif // RENDITION_H
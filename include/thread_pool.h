@@ -0,0 +1,116 @@
+// thread_pool.h - Work-stealing thread pool for HEIC/HEIF converter
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    // Constructor - starts the workers (count is resolved by fn_resolveThreadCount)
+    explicit ThreadPool(int iThreadCount = 0);
+
+    // Destructor - drains pending tasks and joins all workers
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queue a task. Called from a worker it goes to that worker's own deque,
+    // otherwise tasks are distributed round-robin across the workers.
+    void fn_submit(std::function<void()> fnTask);
+
+    // Block until every submitted task has finished
+    void fn_waitIdle();
+
+    // Number of worker threads
+    int fn_getThreadCount() const;
+
+    // The pool whose worker is running the calling thread (nullptr elsewhere)
+    static ThreadPool* fn_getCurrent();
+
+    // Clamp a requested thread count to [1, min(iMAX_THREAD_COUNT, cores)].
+    // A request of 0 or less selects the machine's core count.
+    static int fn_resolveThreadCount(int iRequested);
+
+private:
+    // Per-worker task deque. The owner pops from the front so files keep their
+    // submission order; thieves take from the back.
+    struct oWorkerQueue
+    {
+        std::mutex oMutex;
+        std::deque<std::function<void()>> dqTasks;
+    };
+
+    void fn_workerLoop(int iWorkerIndex);
+    bool fn_popLocal(int iWorkerIndex, std::function<void()>& fnTask);
+    bool fn_stealTask(int iWorkerIndex, std::function<void()>& fnTask);
+    void fn_runTask(std::function<void()>& fnTask);
+
+    // Member variables
+    std::vector<std::unique_ptr<oWorkerQueue>> m_vpQueues;
+    std::vector<std::thread> m_vWorkers;
+    std::mutex m_oSleepMutex;
+    std::condition_variable m_oWakeCondition;
+    std::condition_variable m_oIdleCondition;
+    std::atomic<size_t> m_stQueuedTasks;     // Tasks sitting in a deque
+    std::atomic<size_t> m_stUnfinishedTasks; // Tasks queued or running
+    std::atomic<unsigned int> m_uNextQueue;
+    std::atomic<bool> m_bStopping;
+};
+
+// Tasks that split one image's work (tiles, bands, strips, renditions)
+// across up to iThreads threads. On a pool worker, such as a batch worker,
+// the tasks go to that same pool, where only idle workers steal them;
+// elsewhere a private pool is started. fn_wait runs every task no worker
+// has started on the calling thread, so it never waits for queued work.
+class TaskGroup
+{
+public:
+    explicit TaskGroup(int iThreads);
+
+    // Destructor - waits for the group's tasks
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    // Queue a task of this group
+    void fn_submit(std::function<void()> fnTask);
+
+    // Run and wait for every task submitted so far
+    void fn_wait();
+
+    // Threads that may work on the group, the caller included
+    int fn_getThreadCount() const;
+
+private:
+    // Shared with helper tasks, which may start after the group is gone
+    struct sState
+    {
+        std::mutex oMutex;
+        std::condition_variable oDone;
+        std::deque<std::function<void()>> dqTasks;
+        int iRunning = 0;
+    };
+
+    static void fn_drain(const std::shared_ptr<sState>& pState);
+
+    std::shared_ptr<sState> m_pState;
+    std::unique_ptr<ThreadPool> m_pOwnedPool;  // Only off a pool worker
+    ThreadPool* m_pPool;
+    int m_iThreads;
+    int m_iHelpers;                            // Drain tasks submitted to m_pPool
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,568 @@
+// batch_journal.cpp - Append-only journal of finished conversions for resumable batches
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "batch_journal.h"
+#include "logger.h"
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include <zlib.h>
+
+namespace
+{
+
+const char aJOURNAL_MAGIC[4] = {'H', 'C', 'J', '1'};
+const uint32_t uJOURNAL_VERSION = 1;
+const size_t stHEADER_BYTES = 8;                 // Magic and version
+const size_t stRECORD_PREFIX_BYTES = 8;          // Payload length and CRC-32
+const uint32_t uMAX_PAYLOAD_BYTES = 1u << 20;    // Larger lengths can only be a torn or foreign tail
+const size_t stCOMPACT_SLACK_RECORDS = 1024;     // Superseded records tolerated before rewriting
+
+volatile std::sig_atomic_t iStopSignal = 0;
+struct sigaction oPreviousInt;
+struct sigaction oPreviousTerm;
+bool bHandlersInstalled = false;
+
+// Little-endian field writers and readers
+void fn_putU32(std::string& sOut, uint32_t uValue)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        sOut.push_back(static_cast<char>((uValue >> (8 * i)) & 0xFF));
+    }
+} // End Function fn_putU32
+
+void fn_putU64(std::string& sOut, uint64_t ullValue)
+{
+    for (int i = 0; i < 8; ++i)
+    {
+        sOut.push_back(static_cast<char>((ullValue >> (8 * i)) & 0xFF));
+    }
+} // End Function fn_putU64
+
+uint64_t fn_getLE(const unsigned char* pData, int iBytes)
+{
+    uint64_t ullValue = 0;
+    for (int i = iBytes - 1; i >= 0; --i)
+    {
+        ullValue = (ullValue << 8) | pData[i];
+    }
+    return ullValue;
+} // End Function fn_getLE
+
+uint32_t fn_crc(const unsigned char* pData, size_t stSize)
+{
+    return static_cast<uint32_t>(crc32(crc32(0, nullptr, 0), pData, static_cast<uInt>(stSize)));
+} // End Function fn_crc
+
+// Size and modification time in nanoseconds of a regular file
+bool fn_statFile(const std::string& sPath, uint64_t& ullSize, int64_t& llMtimeNs)
+{
+    struct stat oStat;
+    if (stat(sPath.c_str(), &oStat) != 0 || !S_ISREG(oStat.st_mode))
+    {
+        return false;
+    }
+    ullSize = static_cast<uint64_t>(oStat.st_size);
+#ifdef __APPLE__
+    llMtimeNs = static_cast<int64_t>(oStat.st_mtimespec.tv_sec) * 1000000000LL + oStat.st_mtimespec.tv_nsec;
+#else
+    llMtimeNs = static_cast<int64_t>(oStat.st_mtim.tv_sec) * 1000000000LL + oStat.st_mtim.tv_nsec;
+#endif
+    return true;
+} // End Function fn_statFile
+
+// Prefixed, checksummed record for one entry
+std::string fn_encodeRecord(const sJournalEntry& oEntry)
+{
+    std::string sPayload;
+    sPayload.reserve(48 + oEntry.sInputPath.size() + oEntry.sOutputPath.size());
+    sPayload.push_back(static_cast<char>(oEntry.eStatus));
+    fn_putU64(sPayload, oEntry.ullInputSize);
+    fn_putU64(sPayload, static_cast<uint64_t>(oEntry.llInputMtimeNs));
+    fn_putU64(sPayload, oEntry.ullOptionsHash);
+    fn_putU64(sPayload, oEntry.ullOutputSize);
+    fn_putU32(sPayload, static_cast<uint32_t>(oEntry.sInputPath.size()));
+    sPayload += oEntry.sInputPath;
+    fn_putU32(sPayload, static_cast<uint32_t>(oEntry.sOutputPath.size()));
+    sPayload += oEntry.sOutputPath;
+
+    std::string sRecord;
+    sRecord.reserve(stRECORD_PREFIX_BYTES + sPayload.size());
+    fn_putU32(sRecord, static_cast<uint32_t>(sPayload.size()));
+    fn_putU32(sRecord, fn_crc(reinterpret_cast<const unsigned char*>(sPayload.data()), sPayload.size()));
+    sRecord += sPayload;
+    return sRecord;
+} // End Function fn_encodeRecord
+
+// Parse a payload whose CRC already matched
+bool fn_decodePayload(const unsigned char* pData, size_t stSize, sJournalEntry& oEntry)
+{
+    const size_t stFixed = 1 + 8 * 4;
+    if (stSize < stFixed + 4)
+    {
+        return false;
+    }
+    uint8_t uStatus = pData[0];
+    if (uStatus != static_cast<uint8_t>(eJournalStatus::Done) && uStatus != static_cast<uint8_t>(eJournalStatus::Failed))
+    {
+        return false;
+    }
+    oEntry.eStatus = static_cast<eJournalStatus>(uStatus);
+    oEntry.ullInputSize = fn_getLE(pData + 1, 8);
+    oEntry.llInputMtimeNs = static_cast<int64_t>(fn_getLE(pData + 9, 8));
+    oEntry.ullOptionsHash = fn_getLE(pData + 17, 8);
+    oEntry.ullOutputSize = fn_getLE(pData + 25, 8);
+
+    size_t stOffset = stFixed;
+    size_t stInput = static_cast<size_t>(fn_getLE(pData + stOffset, 4));
+    stOffset += 4;
+    if (stInput > stSize - stOffset || stSize - stOffset - stInput < 4)
+    {
+        return false;
+    }
+    oEntry.sInputPath.assign(reinterpret_cast<const char*>(pData + stOffset), stInput);
+    stOffset += stInput;
+    size_t stOutput = static_cast<size_t>(fn_getLE(pData + stOffset, 4));
+    stOffset += 4;
+    if (stOutput != stSize - stOffset)
+    {
+        return false;
+    }
+    oEntry.sOutputPath.assign(reinterpret_cast<const char*>(pData + stOffset), stOutput);
+    return !oEntry.sInputPath.empty();
+} // End Function fn_decodePayload
+
+// write() all of sData, retrying short writes and EINTR
+bool fn_writeAll(int iFd, const std::string& sData)
+{
+    size_t stDone = 0;
+    while (stDone < sData.size())
+    {
+        ssize_t lWritten = write(iFd, sData.data() + stDone, sData.size() - stDone);
+        if (lWritten < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        stDone += static_cast<size_t>(lWritten);
+    }
+    return true;
+} // End Function fn_writeAll
+
+std::string fn_makeHeader()
+{
+    std::string sHeader(aJOURNAL_MAGIC, sizeof(aJOURNAL_MAGIC));
+    fn_putU32(sHeader, uJOURNAL_VERSION);
+    return sHeader;
+} // End Function fn_makeHeader
+
+// fsync the directory holding sPath so a rename survives a crash
+void fn_syncParentDirectory(const std::string& sPath)
+{
+    std::string sParent = std::filesystem::path(sPath).parent_path().string();
+    int iFd = open(sParent.empty() ? "." : sParent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (iFd >= 0)
+    {
+        fsync(iFd);
+        close(iFd);
+    }
+} // End Function fn_syncParentDirectory
+
+void fn_onStopSignal(int iSignal)
+{
+    if (iStopSignal != 0)
+    {
+        // Second signal: stop waiting for the checkpoint
+        std::signal(iSignal, SIG_DFL);
+        std::raise(iSignal);
+        return;
+    }
+    iStopSignal = iSignal;
+} // End Function fn_onStopSignal
+
+} // End anonymous namespace
+
+// Absolute, normalised form of a path
+std::string fn_normalizeJournalPath(const std::string& sPath)
+{
+    std::error_code oError;
+    std::filesystem::path oAbsolute = std::filesystem::absolute(sPath, oError);
+    if (oError)
+    {
+        return sPath;
+    }
+    return oAbsolute.lexically_normal().string();
+} // End Function fn_normalizeJournalPath
+
+// Hash a canonical options string
+uint64_t fn_hashJournalOptions(const std::string& sOptionsKey)
+{
+    uint64_t ullHash = 0xcbf29ce484222325ull;
+    for (unsigned char cByte : sOptionsKey)
+    {
+        ullHash ^= cByte;
+        ullHash *= 0x100000001b3ull;
+    }
+    return ullHash;
+} // End Function fn_hashJournalOptions
+
+// Constructor
+BatchJournal::BatchJournal()
+    : m_iFd(-1), m_stRecords(0)
+{
+} // End Constructor
+
+// Destructor
+BatchJournal::~BatchJournal()
+{
+    fn_close();
+} // End Destructor
+
+// Open a journal
+bool BatchJournal::fn_open(const std::string& sPath, std::string& sError)
+{
+    fn_close();
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+    m_sPath = sPath;
+    m_mEntries.clear();
+    m_stRecords = 0;
+
+    m_iFd = open(sPath.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (m_iFd < 0)
+    {
+        sError = "Cannot open journal " + sPath + ": " + std::strerror(errno);
+        return false;
+    }
+    if (!fn_load(sError))
+    {
+        close(m_iFd);
+        m_iFd = -1;
+        return false;
+    }
+    if (fn_shouldCompactLocked())
+    {
+        fn_compactLocked();
+    }
+    return true;
+} // End Function BatchJournal::fn_open
+
+// Read the records, dropping a damaged tail
+bool BatchJournal::fn_load(std::string& sError)
+{
+    struct stat oStat;
+    if (fstat(m_iFd, &oStat) != 0)
+    {
+        sError = "Cannot stat journal " + m_sPath;
+        return false;
+    }
+
+    if (oStat.st_size == 0)
+    {
+        if (!fn_writeAll(m_iFd, fn_makeHeader()) || fsync(m_iFd) != 0)
+        {
+            sError = "Cannot write journal " + m_sPath;
+            return false;
+        }
+        return true;
+    }
+
+    std::vector<unsigned char> vData(static_cast<size_t>(oStat.st_size));
+    size_t stRead = 0;
+    while (stRead < vData.size())
+    {
+        ssize_t lBytes = pread(m_iFd, vData.data() + stRead, vData.size() - stRead, static_cast<off_t>(stRead));
+        if (lBytes < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (lBytes <= 0)
+        {
+            break;
+        }
+        stRead += static_cast<size_t>(lBytes);
+    }
+    vData.resize(stRead);
+
+    if (vData.size() < stHEADER_BYTES || std::memcmp(vData.data(), aJOURNAL_MAGIC, sizeof(aJOURNAL_MAGIC)) != 0)
+    {
+        sError = "Not a conversion journal: " + m_sPath;
+        return false;
+    }
+    uint32_t uVersion = static_cast<uint32_t>(fn_getLE(vData.data() + 4, 4));
+    if (uVersion != uJOURNAL_VERSION)
+    {
+        sError = "Unsupported journal version " + std::to_string(uVersion) + ": " + m_sPath;
+        return false;
+    }
+
+    size_t stOffset = stHEADER_BYTES;
+    while (vData.size() - stOffset >= stRECORD_PREFIX_BYTES)
+    {
+        uint32_t uLength = static_cast<uint32_t>(fn_getLE(vData.data() + stOffset, 4));
+        uint32_t uCrc = static_cast<uint32_t>(fn_getLE(vData.data() + stOffset + 4, 4));
+        if (uLength > uMAX_PAYLOAD_BYTES || uLength > vData.size() - stOffset - stRECORD_PREFIX_BYTES)
+        {
+            break;
+        }
+        const unsigned char* pPayload = vData.data() + stOffset + stRECORD_PREFIX_BYTES;
+        sJournalEntry oEntry;
+        if (fn_crc(pPayload, uLength) != uCrc || !fn_decodePayload(pPayload, uLength, oEntry))
+        {
+            break;
+        }
+        std::string sKey = oEntry.sInputPath;
+        m_mEntries[sKey] = std::move(oEntry);
+        ++m_stRecords;
+        stOffset += stRECORD_PREFIX_BYTES + uLength;
+    }
+
+    if (stOffset < vData.size())
+    {
+        // Interrupted append or damage: keep the records before it
+        fn_logWarning("Journal " + m_sPath + ": dropping " + std::to_string(vData.size() - stOffset) +
+                      " unreadable bytes after " + std::to_string(m_stRecords) + " records");
+        if (ftruncate(m_iFd, static_cast<off_t>(stOffset)) != 0 || fsync(m_iFd) != 0)
+        {
+            sError = "Cannot repair journal " + m_sPath;
+            return false;
+        }
+    }
+    return true;
+} // End Function BatchJournal::fn_load
+
+// Is the journal open
+bool BatchJournal::fn_isOpen() const
+{
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+    return m_iFd >= 0;
+} // End Function BatchJournal::fn_isOpen
+
+// Check whether a file needs converting again
+bool BatchJournal::fn_isUpToDate(const std::string& sInputPath, uint64_t ullOptionsHash) const
+{
+    sJournalEntry oEntry;
+    {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        auto itEntry = m_mEntries.find(fn_normalizeJournalPath(sInputPath));
+        if (itEntry == m_mEntries.end())
+        {
+            return false;
+        }
+        oEntry = itEntry->second;
+    }
+
+    if (oEntry.eStatus != eJournalStatus::Done || oEntry.ullOptionsHash != ullOptionsHash)
+    {
+        return false;
+    }
+
+    uint64_t ullSize = 0;
+    int64_t llMtimeNs = 0;
+    if (!fn_statFile(sInputPath, ullSize, llMtimeNs) ||
+        ullSize != oEntry.ullInputSize || llMtimeNs != oEntry.llInputMtimeNs)
+    {
+        return false;
+    }
+
+    // The output must still be the one written
+    int64_t llOutputMtimeNs = 0;
+    return fn_statFile(oEntry.sOutputPath, ullSize, llOutputMtimeNs) && ullSize == oEntry.ullOutputSize;
+} // End Function BatchJournal::fn_isUpToDate
+
+// Look up the recorded output of an input
+bool BatchJournal::fn_findOutput(const std::string& sInputPath, std::string& sOutputPath) const
+{
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+    auto itEntry = m_mEntries.find(fn_normalizeJournalPath(sInputPath));
+    if (itEntry == m_mEntries.end() || itEntry->second.sOutputPath.empty())
+    {
+        return false;
+    }
+    sOutputPath = itEntry->second.sOutputPath;
+    return true;
+} // End Function BatchJournal::fn_findOutput
+
+// Append one outcome
+bool BatchJournal::fn_record(const std::string& sInputPath, const std::string& sOutputPath,
+                             uint64_t ullOptionsHash, bool bSuccess)
+{
+    sJournalEntry oEntry;
+    oEntry.sInputPath = fn_normalizeJournalPath(sInputPath);
+    oEntry.sOutputPath = sOutputPath.empty() ? std::string() : fn_normalizeJournalPath(sOutputPath);
+    oEntry.ullOptionsHash = ullOptionsHash;
+    oEntry.eStatus = bSuccess ? eJournalStatus::Done : eJournalStatus::Failed;
+    fn_statFile(sInputPath, oEntry.ullInputSize, oEntry.llInputMtimeNs);
+    if (bSuccess)
+    {
+        int64_t llOutputMtimeNs = 0;
+        if (!fn_statFile(sOutputPath, oEntry.ullOutputSize, llOutputMtimeNs))
+        {
+            oEntry.eStatus = eJournalStatus::Failed;  // Nothing on disk to trust next time
+        }
+    }
+
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+    if (m_iFd < 0 || !fn_appendLocked(oEntry))
+    {
+        return false;
+    }
+    if (fn_shouldCompactLocked())
+    {
+        fn_compactLocked();
+    }
+    return true;
+} // End Function BatchJournal::fn_record
+
+// Write one record at the end of the file
+bool BatchJournal::fn_appendLocked(const sJournalEntry& oEntry)
+{
+    if (!fn_writeAll(m_iFd, fn_encodeRecord(oEntry)))
+    {
+        fn_logWarning("Cannot append to journal " + m_sPath + ": " + std::strerror(errno));
+        return false;
+    }
+    std::string sKey = oEntry.sInputPath;
+    m_mEntries[sKey] = oEntry;
+    ++m_stRecords;
+    return true;
+} // End Function BatchJournal::fn_appendLocked
+
+// Superseded records outweigh live ones
+bool BatchJournal::fn_shouldCompactLocked() const
+{
+    return m_stRecords > 2 * m_mEntries.size() + stCOMPACT_SLACK_RECORDS;
+} // End Function BatchJournal::fn_shouldCompactLocked
+
+// Rewrite the journal with one record per input
+bool BatchJournal::fn_compactLocked()
+{
+    std::string sTemporary = m_sPath + ".compact";
+    int iFd = open(sTemporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (iFd < 0)
+    {
+        fn_logWarning("Cannot compact journal " + m_sPath + ": " + std::strerror(errno));
+        return false;
+    }
+
+    std::string sData = fn_makeHeader();
+    for (const auto& oItem : m_mEntries)
+    {
+        sData += fn_encodeRecord(oItem.second);
+    }
+    if (!fn_writeAll(iFd, sData) || fsync(iFd) != 0)
+    {
+        fn_logWarning("Cannot compact journal " + m_sPath + ": " + std::strerror(errno));
+        close(iFd);
+        std::remove(sTemporary.c_str());
+        return false;
+    }
+    close(iFd);
+
+    if (std::rename(sTemporary.c_str(), m_sPath.c_str()) != 0)
+    {
+        fn_logWarning("Cannot compact journal " + m_sPath + ": " + std::strerror(errno));
+        std::remove(sTemporary.c_str());
+        return false;
+    }
+    fn_syncParentDirectory(m_sPath);
+
+    // Later appends go to the new file
+    int iNewFd = open(m_sPath.c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+    if (iNewFd < 0)
+    {
+        fn_logWarning("Cannot reopen journal " + m_sPath + ": " + std::strerror(errno));
+        return false;
+    }
+    close(m_iFd);
+    m_iFd = iNewFd;
+    m_stRecords = m_mEntries.size();
+    return true;
+} // End Function BatchJournal::fn_compactLocked
+
+// Make the records so far durable
+bool BatchJournal::fn_checkpoint()
+{
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+    if (m_iFd < 0)
+    {
+        return false;
+    }
+    if (fn_shouldCompactLocked() && fn_compactLocked())
+    {
+        return true;  // Already synced
+    }
+    return fsync(m_iFd) == 0;
+} // End Function BatchJournal::fn_checkpoint
+
+// Checkpoint and close
+void BatchJournal::fn_close()
+{
+    fn_checkpoint();
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+    if (m_iFd >= 0)
+    {
+        close(m_iFd);
+        m_iFd = -1;
+    }
+} // End Function BatchJournal::fn_close
+
+// Number of inputs with a record
+size_t BatchJournal::fn_getEntryCount() const
+{
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+    return m_mEntries.size();
+} // End Function BatchJournal::fn_getEntryCount
+
+// Number of records in the file
+size_t BatchJournal::fn_getRecordCount() const
+{
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+    return m_stRecords;
+} // End Function BatchJournal::fn_getRecordCount
+
+// Catch SIGINT and SIGTERM
+void fn_installStopHandlers()
+{
+    if (bHandlersInstalled)
+    {
+        return;
+    }
+    iStopSignal = 0;
+    struct sigaction oAction;
+    std::memset(&oAction, 0, sizeof(oAction));
+    oAction.sa_handler = fn_onStopSignal;
+    oAction.sa_flags = SA_RESTART;  // In-flight reads and writes resume instead of failing with EINTR
+    sigemptyset(&oAction.sa_mask);
+    sigaction(SIGINT, &oAction, &oPreviousInt);
+    sigaction(SIGTERM, &oAction, &oPreviousTerm);
+    bHandlersInstalled = true;
+} // End Function fn_installStopHandlers
+
+// Put the previous handlers back
+void fn_restoreStopHandlers()
+{
+    if (!bHandlersInstalled)
+    {
+        return;
+    }
+    sigaction(SIGINT, &oPreviousInt, nullptr);
+    sigaction(SIGTERM, &oPreviousTerm, nullptr);
+    bHandlersInstalled = false;
+} // End Function fn_restoreStopHandlers
+
+// Has a stop been asked for
+bool fn_isStopRequested()
+{
+    return iStopSignal != 0;
+} // End Function fn_isStopRequested
@@ -4,13 +4,97 @@
 
 #include "batch_processor.h"
 #include "converter.h"
+#include "directory_walker.h"
 #include "file_utils.h"
+#include "heif_probe.h"
 #include "logger.h"
+#include "mapped_file.h"
+#include "memory_budget.h"
+#include "thread_pool.h"
 #include <iostream>
 #include <filesystem>
+#include <fstream>
 #include <thread>
-#include <future>
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <queue>
+#include <sstream>
+#include <unordered_map>
+
+namespace
+{
+    // A file waiting for a worker
+    struct sQueuedFile
+    {
+        std::string sInputFile;
+        std::string sOutputFile;
+        sConversionCost oCost;
+        size_t stSequence = 0;  // Arrival order, breaks ties
+    };
+    
+    // Files handed out largest estimated work first. Producers push from any
+    // thread; fn_pop waits for a file until the queue is closed and empty.
+    class CostQueue
+    {
+    public:
+        void fn_push(const std::string& sInputFile, const std::string& sOutputFile, const sConversionCost& oCost)
+        {
+            {
+                std::lock_guard<std::mutex> oLock(m_oMutex);
+                sQueuedFile oFile;
+                oFile.sInputFile = sInputFile;
+                oFile.sOutputFile = sOutputFile;
+                oFile.oCost = oCost;
+                oFile.stSequence = m_stPushed++;
+                m_pqFiles.push(std::move(oFile));
+            }
+            m_oChanged.notify_one();
+        }  // End Function fn_push
+        
+        void fn_close()
+        {
+            {
+                std::lock_guard<std::mutex> oLock(m_oMutex);
+                m_bClosed = true;
+            }
+            m_oChanged.notify_all();
+        }  // End Function fn_close
+        
+        bool fn_pop(sQueuedFile& oFile)
+        {
+            std::unique_lock<std::mutex> oLock(m_oMutex);
+            m_oChanged.wait(oLock, [this]() { return m_bClosed || !m_pqFiles.empty(); });
+            if (m_pqFiles.empty())
+            {
+                return false;
+            }
+            oFile = m_pqFiles.top();
+            m_pqFiles.pop();
+            return true;
+        }  // End Function fn_pop
+        
+    private:
+        struct oSmallerWork
+        {
+            bool operator()(const sQueuedFile& a, const sQueuedFile& b) const
+            {
+                if (a.oCost.ullWork != b.oCost.ullWork)
+                {
+                    return a.oCost.ullWork < b.oCost.ullWork;
+                }
+                return a.stSequence > b.stSequence;
+            }
+        };
+        
+        std::mutex m_oMutex;
+        std::condition_variable m_oChanged;
+        std::priority_queue<sQueuedFile, std::vector<sQueuedFile>, oSmallerWork> m_pqFiles;
+        size_t m_stPushed = 0;
+        bool m_bClosed = false;
+    };
+}
 
 // Constructor - FIXED: Initialize all member variables
 BatchProcessor::BatchProcessor()
@@ -20,6 +104,15 @@ BatchProcessor::BatchProcessor()
     iFailedCount = 0;
     iBatchSize = 10;  // Default batch size
     bParallelProcessing = true;  // Enable parallel by default
+    iThreadCount = iDEFAULT_THREAD_COUNT;
+    bPipelineMode = false;
+    iMaxDimension = 0;
+    ullMemoryLimit = 0;
+    iSkippedCount = 0;
+    ullJournalOptionsHash = 0;
+    eDedup = eDedupMode::Off;
+    tBatchCpuStart = 0;
+    oOutputOptions.bReplace = false;  // Names are chosen to be new
 }  // End Constructor
 
 // Destructor
@@ -27,6 +120,7 @@ BatchProcessor::~BatchProcessor()
 {
     // Clear failed files vector
     vsFailedFiles.clear();
+    fn_closeJournal();
 }  // End Destructor
 
 // Process batch conversion - FIXED: Match function signature from header
@@ -53,6 +147,12 @@ bool BatchProcessor::fn_processBatch(
         }
     }
     
+    if (!fn_openJournal(sOutputFormat, iQuality, bPreserveMetadata, bVerbose))
+    {
+        return false;
+    }
+    fn_startDedup();
+    
     // Process batch
     return fn_internalBatchProcess(
         vsInputFiles,
@@ -96,10 +196,56 @@ bool BatchProcessor::fn_processDirectory(
         }
     }
     
+    if (!fn_openJournal(sOutputFormat, iQuality, bPreserveMetadata, bVerbose))
+    {
+        return false;
+    }
+    fn_startDedup();
+    
+    // Per-file workers start converting while the tree is still being
+    // read; the pipeline and sequential modes take the finished list. Names
+    // are claimed as files are found, so inputs sharing a stem get their
+    // _N suffixes in walk order, which can differ between runs (a journal
+    // hands each input its recorded name again)
+    if (bParallelProcessing && !bPipelineMode)
+    {
+        std::atomic<size_t> stWalked(0);
+        size_t stFound = fn_runParallel([&](const fnAddFile& fnAdd)
+        {
+            fn_walkDirectory(sInputDirectory, bRecursive, ThreadPool::fn_resolveThreadCount(iThreadCount),
+                [](const char* pName) { return fn_isHeicFile(pName); },
+                [&](const std::string& sFile)
+                {
+                    if (fn_isStopping() || fn_isJournaledUpToDate(sFile))
+                    {
+                        return;
+                    }
+                    fnAdd(sFile, fn_generateOutputFilename(sFile, sOutputFormat, sOutputDirectory),
+                          fn_estimateFileCost(sFile));
+                    stWalked++;
+                });
+            
+            if (bVerbose)
+            {
+                fn_logInfo("Found " + std::to_string(stWalked.load()) + " HEIC/HEIF files to process");
+            }
+        }, 0, iQuality, bPreserveMetadata, bVerbose);
+        
+        if (stFound == 0 && iSkippedCount == 0)
+        {
+            fn_logWarning("No HEIC/HEIF files found in directory: " + sInputDirectory);
+            fn_closeJournal();
+            return true;  // Nothing to process, not an error
+        }
+        
+        return fn_finishBatch(sOutputDirectory);
+    }
+    
     // Collect files from directory
     std::vector<std::string> vsFiles = fn_collectDirectoryFiles(
         sInputDirectory,
-        bRecursive
+        bRecursive,
+        ThreadPool::fn_resolveThreadCount(iThreadCount)
     );
     
     // Filter for HEIC/HEIF files
@@ -116,6 +262,7 @@ bool BatchProcessor::fn_processDirectory(
     if (vsHeicFiles.empty())
     {
         fn_logWarning("No HEIC/HEIF files found in directory: " + sInputDirectory);
+        fn_closeJournal();
         return true;  // Nothing to process, not an error
     }
     
@@ -135,6 +282,90 @@ bool BatchProcessor::fn_processDirectory(
     );
 }  // End Function fn_processDirectory
 
+// Probe files without decoding and write one JSON line each
+bool BatchProcessor::fn_probeFiles(const std::vector<std::string>& vsInputFiles, std::ostream& oOutput)
+{
+    fn_clearStatistics();
+    
+    // A probe is a few small reads, so files go to workers in blocks and
+    // each block is formatted into one string before it is written
+    const size_t stBlockSize = 256;
+    size_t stTotalFiles = vsInputFiles.size();
+    size_t stBlocks = (stTotalFiles + stBlockSize - 1) / stBlockSize;
+    std::vector<std::string> vsBlocks(stBlocks);
+    std::vector<bool> vbDone(stBlocks, false);
+    size_t stNextBlock = 0;
+    std::mutex oOutputMutex;
+    
+    // Blocks finish out of order; whoever completes the next one in line
+    // writes every finished block after it so output keeps input order
+    auto fn_probeBlock = [&](size_t stBlock)
+    {
+        size_t stBegin = stBlock * stBlockSize;
+        size_t stEnd = std::min(stTotalFiles, stBegin + stBlockSize);
+        std::string sLines;
+        
+        for (size_t stIdx = stBegin; stIdx < stEnd; stIdx++)
+        {
+            sHeifProbe oProbe;
+            std::string sError;
+            bool bSuccess = fn_probeHeifFile(vsInputFiles[stIdx], oProbe, sError);
+            sLines += bSuccess ? fn_probeToJson(vsInputFiles[stIdx], oProbe)
+                               : fn_probeErrorToJson(vsInputFiles[stIdx], sError);
+            sLines += '\n';
+            fn_recordResult(vsInputFiles[stIdx], bSuccess);
+        }
+        
+        std::lock_guard<std::mutex> oLock(oOutputMutex);
+        vsBlocks[stBlock].swap(sLines);
+        vbDone[stBlock] = true;
+        while (stNextBlock < stBlocks && vbDone[stNextBlock])
+        {
+            oOutput << vsBlocks[stNextBlock];
+            std::string().swap(vsBlocks[stNextBlock]);
+            stNextBlock++;
+        }
+    };
+    
+    if (stBlocks > 1)
+    {
+        ThreadPool oPool(std::min<int>(ThreadPool::fn_resolveThreadCount(iThreadCount), static_cast<int>(stBlocks)));
+        for (size_t stBlock = 0; stBlock < stBlocks; stBlock++)
+        {
+            oPool.fn_submit([&fn_probeBlock, stBlock]() { fn_probeBlock(stBlock); });
+        }
+        oPool.fn_waitIdle();
+    }
+    else if (stBlocks == 1)
+    {
+        fn_probeBlock(0);
+    }
+    
+    oOutput.flush();
+    return iFailedCount == 0;
+}  // End Function fn_probeFiles
+
+// Probe every HEIC/HEIF file in a directory
+bool BatchProcessor::fn_probeDirectory(
+    const std::string& sInputDirectory,
+    bool bRecursive,
+    std::ostream& oOutput
+)
+{
+    std::vector<std::string> vsHeicFiles;
+    
+    for (const auto& sFile : fn_collectDirectoryFiles(sInputDirectory, bRecursive,
+                                                      ThreadPool::fn_resolveThreadCount(iThreadCount)))
+    {
+        if (fn_isHeicFile(sFile))
+        {
+            vsHeicFiles.push_back(sFile);
+        }
+    }
+    
+    return fn_probeFiles(vsHeicFiles, oOutput);
+}  // End Function fn_probeDirectory
+
 // Get processed file count
 int BatchProcessor::fn_getProcessedCount() const
 {
@@ -153,11 +384,18 @@ std::vector<std::string> BatchProcessor::fn_getFailedFiles() const
     return vsFailedFiles;
 }  // End Function fn_getFailedFiles
 
+// Get the number of files skipped as up to date
+int BatchProcessor::fn_getSkippedCount() const
+{
+    return iSkippedCount;
+}  // End Function fn_getSkippedCount
+
 // Clear statistics
 void BatchProcessor::fn_clearStatistics()
 {
     iProcessedCount = 0;
     iFailedCount = 0;
+    iSkippedCount = 0;
     vsFailedFiles.clear();
 }  // End Function fn_clearStatistics
 
@@ -192,9 +430,128 @@ bool BatchProcessor::fn_isParallelProcessing() const
     return bParallelProcessing;
 }  // End Function fn_isParallelProcessing
 
+// Set worker thread count
+void BatchProcessor::fn_setThreadCount(int iNewThreadCount)
+{
+    iThreadCount = iNewThreadCount;
+}  // End Function fn_setThreadCount
+
+// Get requested worker thread count
+int BatchProcessor::fn_getThreadCount() const
+{
+    return iThreadCount;
+}  // End Function fn_getThreadCount
+
+// Enable/disable the staged pipeline
+void BatchProcessor::fn_setPipelineMode(bool bEnable)
+{
+    bPipelineMode = bEnable;
+}  // End Function fn_setPipelineMode
+
+// Check if the staged pipeline is enabled
+bool BatchProcessor::fn_isPipelineMode() const
+{
+    return bPipelineMode;
+}  // End Function fn_isPipelineMode
+
+// Set pipeline stage thread counts and queue depth
+void BatchProcessor::fn_setPipelineOptions(const sPipelineOptions& oOptions)
+{
+    oPipelineOptions = oOptions;
+}  // End Function fn_setPipelineOptions
+
+// Set the preview size limit
+void BatchProcessor::fn_setMaxDimension(int iNewMaxDimension)
+{
+    iMaxDimension = iNewMaxDimension > 0 ? iNewMaxDimension : 0;
+}  // End Function fn_setMaxDimension
+
+// Set the resize stage options
+void BatchProcessor::fn_setResizeOptions(const sResizeOptions& oOptions)
+{
+    oResizeOptions = oOptions;
+}  // End Function fn_setResizeOptions
+
+// Set the EXIF edits applied before the metadata is written
+void BatchProcessor::fn_setExifEditOptions(const sExifEditOptions& oOptions)
+{
+    oExifEditOptions = oOptions;
+}  // End Function fn_setExifEditOptions
+
+// Set the output durability
+void BatchProcessor::fn_setOutputOptions(const sOutputOptions& oOptions)
+{
+    oOutputOptions = oOptions;
+    oOutputOptions.bReplace = false;
+}  // End Function fn_setOutputOptions
+
+// Set the WebP encoder settings
+void BatchProcessor::fn_setWebPOptions(const sWebPOptions& oOptions)
+{
+    oWebPOptions = oOptions;
+}  // End Function fn_setWebPOptions
+
+// Set the PNG encoder settings
+void BatchProcessor::fn_setPngOptions(const sPngOptions& oOptions)
+{
+    oPngOptions = oOptions;
+}  // End Function fn_setPngOptions
+
+// Set the JPEG encoder settings
+void BatchProcessor::fn_setJpegOptions(const sJpegOptions& oOptions)
+{
+    oJpegOptions = oOptions;
+}  // End Function fn_setJpegOptions
+
+// Set the TIFF encoder settings
+void BatchProcessor::fn_setTiffOptions(const sTiffOptions& oOptions)
+{
+    oTiffOptions = oOptions;
+}  // End Function fn_setTiffOptions
+
+// Set the renditions written for each file
+void BatchProcessor::fn_setRenditions(const std::vector<sRendition>& vNewRenditions)
+{
+    vRenditions = vNewRenditions;
+}  // End Function fn_setRenditions
+
+// Set the memory budget shared by concurrent files
+void BatchProcessor::fn_setMemoryLimit(uint64_t ullLimit)
+{
+    ullMemoryLimit = ullLimit;
+}  // End Function fn_setMemoryLimit
+
+// Set the resume journal file
+void BatchProcessor::fn_setJournalPath(const std::string& sPath)
+{
+    sJournalPath = sPath;
+}  // End Function fn_setJournalPath
+
+// Set how duplicate inputs are handled
+void BatchProcessor::fn_setDedupMode(eDedupMode eMode)
+{
+    eDedup = eMode;
+}  // End Function fn_setDedupMode
+
+// Record the outcome of one file
+void BatchProcessor::fn_recordResult(const std::string& sInputFile, bool bSuccess)
+{
+    std::lock_guard<std::mutex> oLock(oStatsMutex);
+    
+    if (bSuccess)
+    {
+        iProcessedCount++;
+    }
+    else
+    {
+        iFailedCount++;
+        vsFailedFiles.push_back(sInputFile);
+    }
+}  // End Function fn_recordResult
+
 // Internal batch processing function - FIXED: Match function signature from header
 bool BatchProcessor::fn_internalBatchProcess(
-    const std::vector<std::string>& vsFiles,
+    const std::vector<std::string>& vsRequestedFiles,
     const std::string& sOutputFormat,
     const std::string& sOutputDirectory,
     int iQuality,
@@ -203,131 +560,592 @@ bool BatchProcessor::fn_internalBatchProcess(
 )
 {
     // Check if we have files to process
-    if (vsFiles.empty())
+    if (vsRequestedFiles.empty())
     {
         fn_logWarning("No files to process");
+        fn_closeJournal();
         return true;  // Nothing to process, not an error
     }
     
+    // Files the journal shows as converted with these options are left as they are
+    std::vector<std::string> vsPending;
+    if (pJournal)
+    {
+        for (const auto& sFile : vsRequestedFiles)
+        {
+            if (!fn_isJournaledUpToDate(sFile))
+            {
+                vsPending.push_back(sFile);
+            }
+        }
+    }
+    const std::vector<std::string>& vsFiles = pJournal ? vsPending : vsRequestedFiles;
+    
+    if (vsFiles.empty())
+    {
+        return fn_finishBatch(sOutputDirectory);
+    }
+    
     if (bVerbose)
     {
         fn_logInfo("Starting batch processing of " + std::to_string(vsFiles.size()) + " files");
     }
     
-    // Process in batches
     size_t stTotalFiles = vsFiles.size();
-    size_t stBatches = (stTotalFiles + iBatchSize - 1) / iBatchSize;
     
-    for (size_t stBatch = 0; stBatch < stBatches; stBatch++)
+    // The pipeline encodes one output per item; renditions take the
+    // per-file path where a single decode feeds several encoders
+    if (bPipelineMode && !vRenditions.empty() && bVerbose)
+    {
+        fn_logInfo("Renditions requested; using per-file conversion instead of the pipeline");
+    }
+    
+    if (bPipelineMode && stTotalFiles > 1 && vRenditions.empty())
     {
-        // Calculate batch range
-        size_t stStart = stBatch * iBatchSize;
-        size_t stEnd = std::min(stStart + iBatchSize, stTotalFiles);
+        // Each stage runs on its own threads so disk reads and writes overlap
+        // with decoding and encoding of other files
+        ConversionPipeline oPipeline(oPipelineOptions, iThreadCount);
+        oPipeline.fn_setMaxDimension(iMaxDimension);
+        oPipeline.fn_setResizeOptions(oResizeOptions);
+        oPipeline.fn_setExifEditOptions(oExifEditOptions);
+        oPipeline.fn_setOutputOptions(oOutputOptions);
+        oPipeline.fn_setWebPOptions(oWebPOptions);
+        oPipeline.fn_setPngOptions(oPngOptions);
+        oPipeline.fn_setJpegOptions(oJpegOptions);
+        oPipeline.fn_setTiffOptions(oTiffOptions);
+        oPipeline.fn_setMemoryLimit(ullMemoryLimit);
+        oPipeline.fn_setStopCheck([this]() { return fn_isStopping(); });
+        if (pDedup)
+        {
+            // Hashed from the read stage's mapping, before anything is decoded
+            oPipeline.fn_setReadFilter([this](const std::string& sInputFile, const std::string& sOutputFile,
+                                              const unsigned char* pData, size_t stSize)
+            {
+                return fn_claimContent(sInputFile, sOutputFile, pData, stSize);
+            });
+        }
+        sPipelineOptions oStages = oPipeline.fn_getOptions();
+        std::atomic<size_t> stCompleted(0);
         
         if (bVerbose)
         {
-            fn_logInfo("Processing batch " + std::to_string(stBatch + 1) + "/" + 
-                       std::to_string(stBatches) + " (files " + 
-                       std::to_string(stStart + 1) + "-" + 
-                       std::to_string(stEnd) + ")");
+            fn_logInfo("Pipeline threads: read " + std::to_string(oStages.iReadThreads) +
+                       ", decode " + std::to_string(oStages.iDecodeThreads) +
+                       ", encode " + std::to_string(oStages.iEncodeThreads) +
+                       ", write " + std::to_string(oStages.iWriteThreads) +
+                       " (queue depth " + std::to_string(oStages.iQueueDepth) + ")");
         }
         
-        // Process current batch
-        if (bParallelProcessing)
+        std::vector<sPipelineJob> vJobs;
+        vJobs.reserve(stTotalFiles);
+        std::unordered_map<std::string, std::string> mOutputFiles;  // For the journal
+        
+        for (const auto& sFile : vsFiles)
         {
-            // Parallel processing
-            std::vector<std::future<bool>> vfResults;
-            
-            for (size_t stIdx = stStart; stIdx < stEnd; stIdx++)
-            {
-                vfResults.push_back(std::async(
-                    std::launch::async,
-                    [this, &vsFiles, stIdx, &sOutputFormat, &sOutputDirectory, iQuality, bPreserveMetadata]()
-                    {
-                        return fn_processSingleFile(
-                            vsFiles[stIdx],
-                            sOutputFormat,
-                            sOutputDirectory,
-                            iQuality,
-                            bPreserveMetadata
-                        );
-                    }
-                ));
-            }
-            
-            // Collect results
-            for (size_t stIdx = stStart; stIdx < stEnd; stIdx++)
+            sPipelineJob oJob;
+            oJob.sInputFile = sFile;
+            oJob.sOutputFile = fn_generateOutputFilename(sFile, sOutputFormat, sOutputDirectory);
+            oJob.bReplace = fn_isReplacingOutput(oJob.sOutputFile);
+            mOutputFiles[sFile] = oJob.sOutputFile;
+            vJobs.push_back(oJob);
+        }
+        
+        oPipeline.fn_run(vJobs, sOutputFormat, iQuality, bPreserveMetadata,
+            [this, &stCompleted, &mOutputFiles, stTotalFiles, bVerbose](const std::string& sInputFile,
+                                                                        ePipelineResult eResult)
             {
-                bool bSuccess = vfResults[stIdx - stStart].get();
+                // A duplicate the read filter took is recorded when its content is resolved
+                if (eResult != ePipelineResult::Filtered)
+                {
+                    bool bSuccess = eResult == ePipelineResult::Converted;
+                    fn_recordResult(sInputFile, bSuccess);
+                    fn_journalResult(sInputFile, mOutputFiles.at(sInputFile), bSuccess);
+                    fn_finishContent(sInputFile, mOutputFiles.at(sInputFile), bSuccess);
+                }
                 
-                if (bSuccess)
+                size_t stDone = ++stCompleted;
+                if (bVerbose && (stDone % iBatchSize == 0 || stDone == stTotalFiles))
                 {
-                    iProcessedCount++;
+                    fn_logInfo("Progress: " + std::to_string(stDone) + "/" + 
+                               std::to_string(stTotalFiles) + " files");
                 }
-                else
+            });
+    }
+    else if (bParallelProcessing && stTotalFiles > 1)
+    {
+        // Output names are claimed in input order so duplicates are numbered
+        // the same way whatever order the files finish in
+        std::vector<std::string> vsOutputFiles;
+        vsOutputFiles.reserve(stTotalFiles);
+        for (const auto& sFile : vsFiles)
+        {
+            vsOutputFiles.push_back(fn_generateOutputFilename(sFile, sOutputFormat, sOutputDirectory));
+        }
+        
+        fn_runParallel([this, &vsFiles, &vsOutputFiles, stTotalFiles](const fnAddFile& fnAdd)
+        {
+            // Probe every header first, then queue largest first, so the
+            // first file a worker takes is the biggest of the whole list
+            std::vector<sConversionCost> vCosts(stTotalFiles);
+            std::atomic<size_t> stNextProbe(0);
+            {
+                ThreadPool oProbePool(std::min<int>(ThreadPool::fn_resolveThreadCount(iThreadCount),
+                                                    static_cast<int>(stTotalFiles)));
+                for (int i = 0; i < oProbePool.fn_getThreadCount(); i++)
                 {
-                    iFailedCount++;
-                    vsFailedFiles.push_back(vsFiles[stIdx]);
+                    oProbePool.fn_submit([&vsFiles, &vCosts, &stNextProbe, stTotalFiles]()
+                    {
+                        size_t stIdx;
+                        while ((stIdx = stNextProbe.fetch_add(1)) < stTotalFiles)
+                        {
+                            vCosts[stIdx] = fn_estimateFileCost(vsFiles[stIdx]);
+                        }
+                    });
                 }
+                oProbePool.fn_waitIdle();
             }
-        }
-        else
+            
+            for (size_t stIdx : fn_orderByCost(vCosts))
+            {
+                fnAdd(vsFiles[stIdx], vsOutputFiles[stIdx], vCosts[stIdx]);
+            }
+        }, stTotalFiles, iQuality, bPreserveMetadata, bVerbose);
+    }
+    else
+    {
+        // Sequential processing; each file may use every thread for its tiles
+        int iFileThreads = ThreadPool::fn_resolveThreadCount(iThreadCount);
+        fnThreadShare fnShare = [iFileThreads]() { return iFileThreads; };
+        
+        for (size_t stIdx = 0; stIdx < stTotalFiles && !fn_isStopping(); stIdx++)
         {
-            // Sequential processing
-            for (size_t stIdx = stStart; stIdx < stEnd; stIdx++)
+            std::string sOutputFile = fn_generateOutputFilename(vsFiles[stIdx], sOutputFormat, sOutputDirectory);
+            if (!pDedup || fn_claimFile(vsFiles[stIdx], sOutputFile))
             {
                 bool bSuccess = fn_processSingleFile(
                     vsFiles[stIdx],
-                    sOutputFormat,
-                    sOutputDirectory,
+                    sOutputFile,
                     iQuality,
-                    bPreserveMetadata
+                    bPreserveMetadata,
+                    fnShare
                 );
                 
-                if (bSuccess)
+                fn_recordResult(vsFiles[stIdx], bSuccess);
+                fn_journalResult(vsFiles[stIdx], sOutputFile, bSuccess);
+                fn_finishContent(vsFiles[stIdx], sOutputFile, bSuccess);
+            }
+            
+            if (bVerbose && ((stIdx + 1) % iBatchSize == 0 || stIdx + 1 == stTotalFiles))
+            {
+                fn_logInfo("Progress: " + std::to_string(stIdx + 1) + "/" + 
+                           std::to_string(stTotalFiles) + " files");
+            }
+        }
+    }
+    
+    return fn_finishBatch(sOutputDirectory);
+}  // End Function fn_internalBatchProcess
+
+// Run files from fnSource on the workers, largest queued file first
+size_t BatchProcessor::fn_runParallel(
+    const fnFileSource& fnSource,
+    size_t stKnownTotal,
+    int iQuality,
+    bool bPreserveMetadata,
+    bool bVerbose
+)
+{
+    int iWorkers = ThreadPool::fn_resolveThreadCount(iThreadCount);
+    int iPoolThreads = stKnownTotal > 0 ? std::min<int>(iWorkers, static_cast<int>(stKnownTotal)) : iWorkers;
+    CostQueue oQueue;
+    std::atomic<size_t> stFound(0);
+    std::atomic<size_t> stCompleted(0);
+    std::atomic<bool> bAllQueued(false);
+    
+    // Files not yet finished share the workers; once fewer remain than
+    // there are threads, each file's next decode, resize or encode step
+    // is split across the idle ones. While a walk may still add files
+    // every file keeps to one thread.
+    std::atomic<int> iUnfinished(static_cast<int>(stKnownTotal));
+    fnThreadShare fnShare = [iWorkers, stKnownTotal, &iUnfinished, &bAllQueued]()
+    {
+        if (stKnownTotal == 0 && !bAllQueued.load())
+        {
+            return 1;
+        }
+        return std::max(1, iWorkers / std::max(1, iUnfinished.load()));
+    };
+    
+    // A worker starts its file only when the estimated peak fits beside
+    // the files already converting; a file bigger than the whole budget
+    // waits for the others to drain and runs alone
+    MemoryBudget oBudget(ullMemoryLimit);
+    
+    if (bVerbose)
+    {
+        fn_logInfo("Using " + std::to_string(iPoolThreads) + " worker threads, largest files first");
+        if (ullMemoryLimit > 0)
+        {
+            fn_logInfo("Memory budget: " + fn_formatMemorySize(ullMemoryLimit));
+        }
+    }
+    
+    ThreadPool oPool(iPoolThreads);
+    for (int i = 0; i < iPoolThreads; i++)
+    {
+        oPool.fn_submit([this, &oQueue, &oBudget, &fnShare, &iUnfinished, &stFound, &stCompleted, &bAllQueued,
+                         iQuality, bPreserveMetadata, bVerbose]()
+        {
+            sQueuedFile oFile;
+            while (!fn_isStopping() && oQueue.fn_pop(oFile))
+            {
+                // A duplicate of content already seen is not decoded at all
+                if (!pDedup || fn_claimFile(oFile.sInputFile, oFile.sOutputFile))
                 {
-                    iProcessedCount++;
+                    uint64_t ullReserved = oBudget.fn_acquire(oFile.oCost.ullPeakBytes);
+                    
+                    bool bSuccess = fn_processSingleFile(
+                        oFile.sInputFile,
+                        oFile.sOutputFile,
+                        iQuality,
+                        bPreserveMetadata,
+                        fnShare
+                    );
+                    
+                    oBudget.fn_release(ullReserved);
+                    
+                    fn_recordResult(oFile.sInputFile, bSuccess);
+                    fn_journalResult(oFile.sInputFile, oFile.sOutputFile, bSuccess);
+                    fn_finishContent(oFile.sInputFile, oFile.sOutputFile, bSuccess);
                 }
-                else
+                iUnfinished--;
+                
+                size_t stDone = ++stCompleted;
+                size_t stTotal = stFound.load();
+                if (bVerbose && (stDone % iBatchSize == 0 || (bAllQueued.load() && stDone == stTotal)))
                 {
-                    iFailedCount++;
-                    vsFailedFiles.push_back(vsFiles[stIdx]);
+                    fn_logInfo("Progress: " + std::to_string(stDone) + "/" + 
+                               std::to_string(stTotal) + " files");
                 }
             }
+        });
+    }
+    
+    // Workers start on the first file while the source is still producing
+    fnSource([&oQueue, &stFound, &iUnfinished, stKnownTotal](const std::string& sInputFile,
+                                                               const std::string& sOutputFile,
+                                                               const sConversionCost& oCost)
+    {
+        if (stKnownTotal == 0)
+        {
+            iUnfinished++;
+        }
+        stFound++;
+        oQueue.fn_push(sInputFile, sOutputFile, oCost);
+    });
+    bAllQueued = true;
+    oQueue.fn_close();
+    oPool.fn_waitIdle();
+    
+    return stFound.load();
+}  // End Function fn_runParallel
+
+// Flush the outputs and report the batch
+bool BatchProcessor::fn_finishBatch(const std::string& sOutputDirectory)
+{
+    // One filesystem-wide flush instead of an fsync per file
+    if (oOutputOptions.eSync == eSyncMode::Batch && !fn_syncOutputFilesystem(sOutputDirectory))
+    {
+        fn_logWarning("Failed to sync outputs in " + sOutputDirectory);
+    }
+    
+    // Files in progress when the signal came are recorded by now
+    bool bStopped = fn_isStopping();
+    if (bStopped)
+    {
+        fn_logWarning("Batch interrupted; journal " + sJournalPath + " is checkpointed, run again to resume");
+    }
+    fn_closeJournal();
+    
+    if (pDedup)
+    {
+        // CPU per conversion in this batch stands in for what each duplicate would have cost
+        sDedupSummary oDedup = pDedup->fn_getSummary();
+        if (oDedup.iFiles > 0)
+        {
+            double dCpuSeconds = static_cast<double>(std::clock() - tBatchCpuStart) / CLOCKS_PER_SEC;
+            int iConverted = std::max(1, iProcessedCount + iFailedCount - oDedup.iFiles);
+            char aSaved[32];
+            std::snprintf(aSaved, sizeof(aSaved), "%.1f", dCpuSeconds / iConverted * oDedup.iFiles);
+            fn_logInfo("Duplicates: " + std::to_string(oDedup.iFiles) + " files (" +
+                       fn_formatMemorySize(oDedup.ullBytes) + ") taken from identical inputs: " +
+                       std::to_string(oDedup.iLinked) + " linked, " + std::to_string(oDedup.iCloned) +
+                       " cloned, " + std::to_string(oDedup.iCopied) + " copied; about " + aSaved +
+                       " s CPU saved");
         }
+        if (oDedup.iCollisions > 0)
+        {
+            fn_logWarning("Duplicates: " + std::to_string(oDedup.iCollisions) +
+                          " files matched another's hash but not its bytes and were converted separately");
+        }
+        pDedup.reset();
     }
     
     // Log summary
     fn_logInfo("Batch processing complete: " + 
                std::to_string(iProcessedCount) + " successful, " + 
-               std::to_string(iFailedCount) + " failed");
+               std::to_string(iFailedCount) + " failed" +
+               (iSkippedCount > 0 ? ", " + std::to_string(iSkippedCount) + " already up to date" : ""));
     
-    return iFailedCount == 0;  // Return true if no failures, false otherwise
-}  // End Function fn_internalBatchProcess
+    return iFailedCount == 0 && !bStopped;  // Return true if no failures, false otherwise
+}  // End Function fn_finishBatch
+
+// Open the resume journal for this batch
+bool BatchProcessor::fn_openJournal(const std::string& sOutputFormat, int iQuality, bool bPreserveMetadata, bool bVerbose)
+{
+    fn_closeJournal();
+    if (sJournalPath.empty())
+    {
+        return true;
+    }
+    
+    std::unique_ptr<BatchJournal> pNewJournal(new BatchJournal());
+    std::string sError;
+    if (!pNewJournal->fn_open(sJournalPath, sError))
+    {
+        fn_logError(sError);
+        return false;
+    }
+    
+    if (bVerbose)
+    {
+        fn_logInfo("Journal " + sJournalPath + ": " + std::to_string(pNewJournal->fn_getEntryCount()) +
+                   " files recorded");
+    }
+    
+    ullJournalOptionsHash = fn_hashJournalOptions(fn_makeJournalOptionsKey(sOutputFormat, iQuality, bPreserveMetadata));
+    pJournal = std::move(pNewJournal);
+    
+    // A signal now stops the batch between files instead of killing it
+    fn_installStopHandlers();
+    return true;
+}  // End Function fn_openJournal
+
+// Checkpoint and close the resume journal
+void BatchProcessor::fn_closeJournal()
+{
+    if (pJournal)
+    {
+        pJournal->fn_close();
+        pJournal.reset();
+        fn_restoreStopHandlers();
+    }
+}  // End Function fn_closeJournal
+
+// Describe the output settings for the journal's options hash
+std::string BatchProcessor::fn_makeJournalOptionsKey(const std::string& sOutputFormat, int iQuality,
+                                                     bool bPreserveMetadata) const
+{
+    std::ostringstream oKey;
+    oKey << "format=" << sOutputFormat << ";quality=" << iQuality << ";metadata=" << bPreserveMetadata
+         << ";max=" << iMaxDimension
+         << ";resize=" << oResizeOptions.fScale << "," << oResizeOptions.iFitWidth << "," << oResizeOptions.iFitHeight
+         << "," << static_cast<int>(oResizeOptions.eFilter)
+         << ";exif=" << oExifEditOptions.bStripGps << oExifEditOptions.bStripMakerNote << oExifEditOptions.bResetOrientation
+         << ";webp=" << oWebPOptions.bLossless << "," << oWebPOptions.iEffort << "," << oWebPOptions.iNearLossless
+         << "," << oWebPOptions.iAlphaQuality
+         << ";png=" << oPngOptions.iCompressionLevel << "," << oPngOptions.bFast
+         << ";jpeg=" << oJpegOptions.bParallelStrips << "," << oJpegOptions.iRestartRows
+         << ";tiff=" << static_cast<int>(oTiffOptions.eCompression) << "," << oTiffOptions.iLevel
+         << "," << oTiffOptions.bPredictor;
+    for (const sRendition& oRendition : vRenditions)
+    {
+        oKey << ";rendition=" << oRendition.sFormat << ":" << oRendition.iMaxDimension << ":" << oRendition.sSuffix;
+    }
+    return oKey.str();
+}  // End Function fn_makeJournalOptionsKey
+
+// Check the journal for a file converted by an earlier run
+bool BatchProcessor::fn_isJournaledUpToDate(const std::string& sInputFile)
+{
+    if (!pJournal || !pJournal->fn_isUpToDate(sInputFile, ullJournalOptionsHash))
+    {
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> oLock(oStatsMutex);
+    iSkippedCount++;
+    return true;
+}  // End Function fn_isJournaledUpToDate
+
+// Append one outcome to the journal
+void BatchProcessor::fn_journalResult(const std::string& sInputFile, const std::string& sOutputFile, bool bSuccess)
+{
+    if (pJournal)
+    {
+        pJournal->fn_record(sInputFile, fn_getJournalOutput(sOutputFile), ullJournalOptionsHash, bSuccess);
+    }
+}  // End Function fn_journalResult
+
+// Output whose size the journal records
+std::string BatchProcessor::fn_getJournalOutput(const std::string& sOutputFile) const
+{
+    return vRenditions.empty() ? sOutputFile : fn_getRenditionPath(sOutputFile, vRenditions[0]);
+}  // End Function fn_getJournalOutput
+
+// Check for a stop signal during a journaled batch
+bool BatchProcessor::fn_isStopping() const
+{
+    return pJournal && fn_isStopRequested();
+}  // End Function fn_isStopping
+
+// Start the duplicate index for a batch
+void BatchProcessor::fn_startDedup()
+{
+    pDedup.reset(eDedup != eDedupMode::Off ? new DedupIndex() : nullptr);
+    tBatchCpuStart = std::clock();
+}  // End Function fn_startDedup
+
+// Hash an input and find out whether its content needs converting
+bool BatchProcessor::fn_claimContent(const std::string& sInputFile, const std::string& sOutputFile,
+                                     const unsigned char* pData, size_t stSize)
+{
+    if (!pDedup || pData == nullptr || stSize == 0)
+    {
+        return true;
+    }
+    
+    std::string sLeaderOutput;
+    sDedupFollower oFollower;
+    oFollower.sInputFile = sInputFile;
+    oFollower.sOutputFile = sOutputFile;
+    oFollower.ullSize = stSize;
+    
+    switch (pDedup->fn_claim(fn_hashContent(pData, stSize), pData, stSize, sInputFile, sOutputFile, sLeaderOutput))
+    {
+        case eDedupRole::Follow:
+            fn_resolveDuplicate(oFollower, sLeaderOutput, true);
+            return false;
+        case eDedupRole::Wait:
+            return false;  // fn_finishContent of the converting file resolves it
+        default:
+            return true;
+    }
+}  // End Function fn_claimContent
+
+// Hash a file on disk and find out whether it needs converting
+bool BatchProcessor::fn_claimFile(const std::string& sInputFile, const std::string& sOutputFile)
+{
+    // The pages hashed here stay cached for the decoder's own mapping
+    MappedFile oInput;
+    if (!oInput.fn_open(sInputFile))
+    {
+        return true;  // The conversion reports the read error
+    }
+    return fn_claimContent(sInputFile, sOutputFile, oInput.fn_getData(), oInput.fn_getSize());
+}  // End Function fn_claimFile
+
+// Resolve the duplicates that waited for a converted file
+void BatchProcessor::fn_finishContent(const std::string& sInputFile, const std::string& sOutputFile, bool bSuccess)
+{
+    if (!pDedup)
+    {
+        return;
+    }
+    for (const sDedupFollower& oFollower : pDedup->fn_finish(sInputFile, bSuccess))
+    {
+        fn_resolveDuplicate(oFollower, sOutputFile, bSuccess);
+    }
+}  // End Function fn_finishContent
+
+// Produce a duplicate's outputs from its twin's
+void BatchProcessor::fn_resolveDuplicate(const sDedupFollower& oFollower, const std::string& sLeaderOutput,
+                                         bool bLeaderSucceeded)
+{
+    bool bSuccess = bLeaderSucceeded;
+    if (!bLeaderSucceeded)
+    {
+        fn_logError("Failed to process file " + oFollower.sInputFile + ": identical to a file that failed");
+    }
+    else
+    {
+        // Copies and clones carry this input's own timestamps; a hard link shares its twin's
+        sOutputOptions oOptions = oOutputOptions;
+        oOptions.bReplace = fn_isReplacingOutput(oFollower.sOutputFile);
+        fn_setOutputTimesFrom(oFollower.sInputFile, oOptions);
+        
+        std::vector<std::string> vsSources = fn_getOutputFiles(sLeaderOutput);
+        std::vector<std::string> vsTargets = fn_getOutputFiles(oFollower.sOutputFile);
+        eDedupMode eUsed = eDedup;
+        for (size_t stIdx = 0; stIdx < vsSources.size() && bSuccess; stIdx++)
+        {
+            std::string sError;
+            if (!fn_materializeDuplicate(vsSources[stIdx], vsTargets[stIdx], eDedup, oOptions, eUsed, sError))
+            {
+                fn_logError("Failed to process file " + oFollower.sInputFile + ": " + sError);
+                bSuccess = false;
+            }
+        }
+        
+        if (bSuccess)
+        {
+            pDedup->fn_noteDuplicate(oFollower.ullSize, eUsed);
+        }
+    }
+    
+    fn_recordResult(oFollower.sInputFile, bSuccess);
+    fn_journalResult(oFollower.sInputFile, oFollower.sOutputFile, bSuccess);
+}  // End Function fn_resolveDuplicate
+
+// List the files written for one output path
+std::vector<std::string> BatchProcessor::fn_getOutputFiles(const std::string& sOutputFile) const
+{
+    if (vRenditions.empty())
+    {
+        return std::vector<std::string>(1, sOutputFile);
+    }
+    
+    std::vector<std::string> vsFiles;
+    for (const sRendition& oRendition : vRenditions)
+    {
+        vsFiles.push_back(fn_getRenditionPath(sOutputFile, oRendition));
+    }
+    return vsFiles;
+}  // End Function fn_getOutputFiles
+
+// Check whether an output name was handed back by the journal
+bool BatchProcessor::fn_isReplacingOutput(const std::string& sOutputFile)
+{
+    std::lock_guard<std::mutex> oLock(oClaimMutex);
+    return oReplacedOutputs.count(sOutputFile) > 0;
+}  // End Function fn_isReplacingOutput
 
 // Process single file in batch - FIXED: Match function signature from header
 bool BatchProcessor::fn_processSingleFile(
     const std::string& sInputFile,
-    const std::string& sOutputFormat,
-    const std::string& sOutputDirectory,
+    const std::string& sOutputFile,
     int iQuality,
-    bool bPreserveMetadata
+    bool bPreserveMetadata,
+    const fnThreadShare& fnThreads
 )
 {
     try
     {
-        // Generate output filename
-        std::string sOutputFile = fn_generateOutputFilename(
-            sInputFile,
-            sOutputFormat,
-            sOutputDirectory
-        );
-        
         // Create converter instance
         Converter oConverter;
+        oConverter.fn_setThreadShare(fnThreads);
+        oConverter.fn_setMaxDimension(iMaxDimension);
+        oConverter.fn_setResizeOptions(oResizeOptions);
+        oConverter.fn_setExifEditOptions(oExifEditOptions);
+        sOutputOptions oFileOutput = oOutputOptions;
+        oFileOutput.bReplace = fn_isReplacingOutput(sOutputFile);
+        oConverter.fn_setOutputOptions(oFileOutput);
+        oConverter.fn_setWebPOptions(oWebPOptions);
+        oConverter.fn_setPngOptions(oPngOptions);
+        oConverter.fn_setJpegOptions(oJpegOptions);
+        oConverter.fn_setTiffOptions(oTiffOptions);
+        oConverter.fn_setRenditions(vRenditions);
         
-        // Configure converter - NOTE: These methods need to exist in Converter class
-        // For now, we'll just try to convert
         int result = oConverter.fn_convertFile(sInputFile, sOutputFile);
         
         return (result == 0);  // Assuming 0 means success
@@ -350,7 +1168,7 @@ std::string BatchProcessor::fn_generateOutputFilename(
     const std::string& sInputFile,
     const std::string& sOutputFormat,
     const std::string& sOutputDirectory
-) const
+)
 {
     // Get input filename without path
     std::filesystem::path oInputPath(sInputFile);
@@ -363,17 +1181,40 @@ std::string BatchProcessor::fn_generateOutputFilename(
     std::filesystem::path oOutputPath(sOutputDirectory);
     oOutputPath /= sOutputFilename;
     
-    // Handle duplicate filenames
+    // A rerun rewrites the output the journal recorded for this input
+    std::string sRecordedOutput;
+    bool bJournaled = pJournal && pJournal->fn_findOutput(sInputFile, sRecordedOutput);
+    
+    // Handle duplicate filenames; names handed to other workers count as
+    // taken even before their files exist
     int iCounter = 1;
+    std::lock_guard<std::mutex> oLock(oClaimMutex);
     
-    while (std::filesystem::exists(oOutputPath))
+    while (true)
     {
+        if (!oClaimedOutputs.count(oOutputPath.string()))
+        {
+            if (bJournaled && fn_normalizeJournalPath(fn_getJournalOutput(oOutputPath.string())) == sRecordedOutput)
+            {
+                oReplacedOutputs.insert(oOutputPath.string());
+                break;
+            }
+            // With renditions every derived file must be free, not just the base name
+            std::vector<std::string> vsOutputs = fn_getOutputFiles(oOutputPath.string());
+            if (std::none_of(vsOutputs.begin(), vsOutputs.end(),
+                             [](const std::string& sPath) { return std::filesystem::exists(sPath); }))
+            {
+                break;
+            }
+        }
+        
         // Append counter to filename
         sOutputFilename = sFilename + "_" + std::to_string(iCounter) + "." + sOutputFormat;
         oOutputPath = std::filesystem::path(sOutputDirectory) / sOutputFilename;
         iCounter++;
     }
     
+    oClaimedOutputs.insert(oOutputPath.string());
     return oOutputPath.string();
 }  // End Function fn_generateOutputFilename
 
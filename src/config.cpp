@@ -159,6 +159,29 @@ oConfig fn_getDefaultConfig()
     oDefaultConfig.bPreserveXMP = bDEFAULT_PRESERVE_XMP;                // NEW
     oDefaultConfig.bPreserveIPTC = bDEFAULT_PRESERVE_IPTC;              // NEW
     oDefaultConfig.bPreserveGPS = bDEFAULT_PRESERVE_GPS;                // NEW
+    oDefaultConfig.bPreserveMakerNote = bDEFAULT_PRESERVE_MAKERNOTE;
+    oDefaultConfig.bUsePipeline = bDEFAULT_USE_PIPELINE;
+    oDefaultConfig.iReadThreads = 0;
+    oDefaultConfig.iDecodeThreads = 0;
+    oDefaultConfig.iEncodeThreads = 0;
+    oDefaultConfig.iWriteThreads = 0;
+    oDefaultConfig.iQueueDepth = iDEFAULT_QUEUE_DEPTH;
+    oDefaultConfig.bProbeOnly = false;
+    oDefaultConfig.iMaxDimension = 0;
+    oDefaultConfig.iFitWidth = 0;
+    oDefaultConfig.iFitHeight = 0;
+    oDefaultConfig.sResizeFilter = "lanczos";
+    oDefaultConfig.sSyncMode = "none";
+    oDefaultConfig.bWebPLossless = false;
+    oDefaultConfig.iWebPEffort = iDEFAULT_WEBP_EFFORT;
+    oDefaultConfig.iWebPNearLossless = 100;
+    oDefaultConfig.iWebPAlphaQuality = 100;
+    oDefaultConfig.bPngFast = false;
+    oDefaultConfig.bJpegParallel = false;
+    oDefaultConfig.sTiffCompression = "deflate";
+    oDefaultConfig.sMemoryLimit = "auto";
+    oDefaultConfig.sJournalPath = "";
+    oDefaultConfig.sDedupMode = "off";
     
     return oDefaultConfig;
 } // End Function fn_getDefaultConfig
@@ -184,4 +207,40 @@ void fn_printConfig(const oConfig& oCurrentConfig)
     std::cout << "  Preserve XMP: " << (oCurrentConfig.bPreserveXMP ? "true" : "false") << std::endl;                // NEW
     std::cout << "  Preserve IPTC: " << (oCurrentConfig.bPreserveIPTC ? "true" : "false") << std::endl;              // NEW
     std::cout << "  Preserve GPS: " << (oCurrentConfig.bPreserveGPS ? "true" : "false") << std::endl;                // NEW
+    std::cout << "  Preserve MakerNote: " << (oCurrentConfig.bPreserveMakerNote ? "true" : "false") << std::endl;
+    if (oCurrentConfig.iFitWidth > 0 || oCurrentConfig.iFitHeight > 0) 
+    { // Begin if
+        std::cout << "  Fit Within: " << oCurrentConfig.iFitWidth << "x" << oCurrentConfig.iFitHeight << std::endl;
+    } // End if(oCurrentConfig.iFitWidth > 0 || oCurrentConfig.iFitHeight > 0)
+    std::cout << "  Resize Filter: " << oCurrentConfig.sResizeFilter << std::endl;
+    std::cout << "  Sync Mode: " << oCurrentConfig.sSyncMode << std::endl;
+    std::cout << "  WebP Lossless: " << (oCurrentConfig.bWebPLossless ? "true" : "false") << std::endl;
+    std::cout << "  WebP Effort: " << oCurrentConfig.iWebPEffort << std::endl;
+    std::cout << "  WebP Near Lossless: " << oCurrentConfig.iWebPNearLossless << std::endl;
+    std::cout << "  WebP Alpha Quality: " << oCurrentConfig.iWebPAlphaQuality << std::endl;
+    std::cout << "  PNG Fast: " << (oCurrentConfig.bPngFast ? "true" : "false") << std::endl;
+    std::cout << "  JPEG Parallel: " << (oCurrentConfig.bJpegParallel ? "true" : "false") << std::endl;
+    std::cout << "  TIFF Compression: " << oCurrentConfig.sTiffCompression << std::endl;
+    for (const std::string& sRendition : oCurrentConfig.vsRenditions) 
+    { // Begin for
+        std::cout << "  Rendition: " << sRendition << std::endl;
+    } // End for(const std::string& sRendition : oCurrentConfig.vsRenditions)
+    std::cout << "  Memory Limit: " << oCurrentConfig.sMemoryLimit << std::endl;
+    if (!oCurrentConfig.sJournalPath.empty()) 
+    { // Begin if
+        std::cout << "  Journal: " << oCurrentConfig.sJournalPath << std::endl;
+    } // End if(!oCurrentConfig.sJournalPath.empty())
+    std::cout << "  Dedup: " << oCurrentConfig.sDedupMode << std::endl;
+    if (oCurrentConfig.iMaxDimension > 0) 
+    { // Begin if
+        std::cout << "  Max Dimension: " << oCurrentConfig.iMaxDimension << std::endl;
+    } // End if(oCurrentConfig.iMaxDimension > 0)
+    std::cout << "  Pipeline: " << (oCurrentConfig.bUsePipeline ? "true" : "false") << std::endl;
+    if (oCurrentConfig.bUsePipeline) 
+    { // Begin if
+        std::cout << "  Pipeline Threads (R,D,E,W): " << oCurrentConfig.iReadThreads << "," 
+                  << oCurrentConfig.iDecodeThreads << "," << oCurrentConfig.iEncodeThreads << "," 
+                  << oCurrentConfig.iWriteThreads << std::endl;
+        std::cout << "  Queue Depth: " << oCurrentConfig.iQueueDepth << std::endl;
+    } // End if(oCurrentConfig.bUsePipeline)
 } // End Function fn_printConfig
\ No newline at end of file
@@ -0,0 +1,513 @@
+// conversion_pipeline.cpp - Staged read/decode/encode/write batch pipeline
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "conversion_pipeline.h"
+#include "config.h"
+#include "format_encoder.h"
+#include "heif_container.h"
+#include "metadata_handler.h"
+#include "thread_pool.h"
+#include "logger.h"
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <thread>
+
+namespace
+{
+    // Run one stage on iWorkers threads; the last worker to finish closes the
+    // downstream queue so the next stage drains and stops
+    template <typename tQueue, typename tBody>
+    void fn_startStage(std::vector<std::thread>& vThreads, int iWorkers,
+                       std::shared_ptr<std::atomic<int>> pRemaining, tQueue* pOut, tBody fnBody)
+    {
+        pRemaining->store(iWorkers);
+
+        for (int i = 0; i < iWorkers; i++)
+        {
+            vThreads.emplace_back([pRemaining, pOut, fnBody]()
+            {
+                fnBody();
+
+                if (pRemaining->fetch_sub(1) == 1 && pOut)
+                {
+                    pOut->fn_close();
+                }
+            });
+        }
+    }  // End Function fn_startStage
+
+    std::string fn_toLower(std::string sValue)
+    {
+        std::transform(sValue.begin(), sValue.end(), sValue.begin(), ::tolower);
+        return sValue;
+    }  // End Function fn_toLower
+}
+
+// Constructor
+ConversionPipeline::ConversionPipeline(const sPipelineOptions& oOptions, int iTotalThreads)
+    : m_oOptions(fn_resolveOptions(oOptions, iTotalThreads)),
+      m_iQuality(85),
+      m_bPreserveMetadata(false),
+      m_iMaxDimension(0),
+      m_iTotalThreads(ThreadPool::fn_resolveThreadCount(iTotalThreads)),
+      m_iUnfinished(0),
+      m_iFailedCount(0)
+{
+}  // End Constructor
+
+// Destructor
+ConversionPipeline::~ConversionPipeline()
+{
+}  // End Destructor
+
+// Fill in automatic stage counts
+sPipelineOptions ConversionPipeline::fn_resolveOptions(const sPipelineOptions& oRequested, int iTotalThreads)
+{
+    sPipelineOptions oResolved = oRequested;
+    int iBudget = ThreadPool::fn_resolveThreadCount(iTotalThreads);
+
+    // I/O stages are cheap; one thread each is enough unless asked otherwise
+    if (oResolved.iReadThreads <= 0)
+    {
+        oResolved.iReadThreads = 1;
+    }
+
+    if (oResolved.iWriteThreads <= 0)
+    {
+        oResolved.iWriteThreads = 1;
+    }
+
+    // Split the remaining budget between the CPU stages, favouring decode
+    int iCpuBudget = std::max(2, iBudget);
+    int iFixedCpu = std::max(0, oResolved.iDecodeThreads) + std::max(0, oResolved.iEncodeThreads);
+
+    if (oResolved.iDecodeThreads <= 0 && oResolved.iEncodeThreads <= 0)
+    {
+        oResolved.iDecodeThreads = (iCpuBudget + 1) / 2;
+        oResolved.iEncodeThreads = iCpuBudget - oResolved.iDecodeThreads;
+    }
+    else if (oResolved.iDecodeThreads <= 0)
+    {
+        oResolved.iDecodeThreads = std::max(1, iCpuBudget - iFixedCpu);
+    }
+    else if (oResolved.iEncodeThreads <= 0)
+    {
+        oResolved.iEncodeThreads = std::max(1, iCpuBudget - iFixedCpu);
+    }
+
+    oResolved.iReadThreads = std::min(oResolved.iReadThreads, iMAX_THREAD_COUNT);
+    oResolved.iDecodeThreads = std::min(oResolved.iDecodeThreads, iMAX_THREAD_COUNT);
+    oResolved.iEncodeThreads = std::min(oResolved.iEncodeThreads, iMAX_THREAD_COUNT);
+    oResolved.iWriteThreads = std::min(oResolved.iWriteThreads, iMAX_THREAD_COUNT);
+    oResolved.iQueueDepth = std::max(1, oResolved.iQueueDepth);
+
+    return oResolved;
+}  // End Function fn_resolveOptions
+
+// Get resolved options
+sPipelineOptions ConversionPipeline::fn_getOptions() const
+{
+    return m_oOptions;
+}  // End Function fn_getOptions
+
+// Set the preview size limit
+void ConversionPipeline::fn_setMaxDimension(int iMaxDimension)
+{
+    m_iMaxDimension = std::max(0, iMaxDimension);
+}  // End Function fn_setMaxDimension
+
+// Set the decode stage resize
+void ConversionPipeline::fn_setResizeOptions(const sResizeOptions& oOptions)
+{
+    m_oResize = oOptions;
+}  // End Function fn_setResizeOptions
+
+// Set the encode stage EXIF edits
+void ConversionPipeline::fn_setExifEditOptions(const sExifEditOptions& oOptions)
+{
+    m_oExifEdit = oOptions;
+}  // End Function fn_setExifEditOptions
+
+// Set how outputs are published
+void ConversionPipeline::fn_setOutputOptions(const sOutputOptions& oOptions)
+{
+    m_oOutput = oOptions;
+}  // End Function fn_setOutputOptions
+
+// Set the encode stage WebP settings
+void ConversionPipeline::fn_setWebPOptions(const sWebPOptions& oOptions)
+{
+    m_oWebP = oOptions;
+}  // End Function fn_setWebPOptions
+
+// Set the encode stage PNG settings
+void ConversionPipeline::fn_setPngOptions(const sPngOptions& oOptions)
+{
+    m_oPng = oOptions;
+}  // End Function fn_setPngOptions
+
+// Set the encode stage JPEG settings
+void ConversionPipeline::fn_setJpegOptions(const sJpegOptions& oOptions)
+{
+    m_oJpeg = oOptions;
+}  // End Function fn_setJpegOptions
+
+// Set the encode stage TIFF settings
+void ConversionPipeline::fn_setTiffOptions(const sTiffOptions& oOptions)
+{
+    m_oTiff = oOptions;
+}  // End Function fn_setTiffOptions
+
+// Set the decoded image memory budget
+void ConversionPipeline::fn_setMemoryLimit(uint64_t ullLimit)
+{
+    m_pMemoryBudget.reset(ullLimit > 0 ? new MemoryBudget(ullLimit) : nullptr);
+}  // End Function fn_setMemoryLimit
+
+// Set the read stage stop condition
+void ConversionPipeline::fn_setStopCheck(const fnStopCheck& fnShouldStop)
+{
+    m_fnShouldStop = fnShouldStop;
+}  // End Function fn_setStopCheck
+
+// Set the read stage filter
+void ConversionPipeline::fn_setReadFilter(const fnReadFilter& fnFilter)
+{
+    m_fnReadFilter = fnFilter;
+}  // End Function fn_setReadFilter
+
+// Run all jobs through the pipeline
+bool ConversionPipeline::fn_run(
+    const std::vector<sPipelineJob>& vJobs,
+    const std::string& sOutputFormat,
+    int iQuality,
+    bool bPreserveMetadata,
+    const fnResultCallback& fnOnResult
+)
+{
+    if (vJobs.empty())
+    {
+        return true;
+    }
+
+    m_sOutputFormat = fn_toLower(sOutputFormat);
+    m_iQuality = iQuality;
+    m_bPreserveMetadata = bPreserveMetadata;
+    m_fnOnResult = fnOnResult;
+    m_iFailedCount = 0;
+    m_iUnfinished = static_cast<int>(vJobs.size());
+
+    // Queue depth bounds how many decoded images can be in flight, which
+    // keeps memory flat when one stage is slower than its neighbours
+    size_t stDepth = static_cast<size_t>(m_oOptions.iQueueDepth);
+    tItemQueue oReadQueue(stDepth);
+    tItemQueue oDecodeQueue(stDepth);
+    tItemQueue oEncodeQueue(stDepth);
+
+    std::atomic<size_t> stNextJob(0);
+    std::vector<std::thread> vThreads;
+
+    fn_startStage(vThreads, m_oOptions.iReadThreads, std::make_shared<std::atomic<int>>(0), &oReadQueue,
+                  [this, &vJobs, &stNextJob, &oReadQueue]() { fn_readStage(vJobs, stNextJob, oReadQueue); });
+    fn_startStage(vThreads, m_oOptions.iDecodeThreads, std::make_shared<std::atomic<int>>(0), &oDecodeQueue,
+                  [this, &oReadQueue, &oDecodeQueue]() { fn_decodeStage(oReadQueue, oDecodeQueue); });
+    fn_startStage(vThreads, m_oOptions.iEncodeThreads, std::make_shared<std::atomic<int>>(0), &oEncodeQueue,
+                  [this, &oDecodeQueue, &oEncodeQueue]() { fn_encodeStage(oDecodeQueue, oEncodeQueue); });
+    fn_startStage(vThreads, m_oOptions.iWriteThreads, std::make_shared<std::atomic<int>>(0),
+                  static_cast<tItemQueue*>(nullptr),
+                  [this, &oEncodeQueue]() { fn_writeStage(oEncodeQueue); });
+
+    for (auto& oThread : vThreads)
+    {
+        oThread.join();
+    }
+
+    return m_iFailedCount.load() == 0;
+}  // End Function fn_run
+
+// Release an item's memory and report its outcome
+void ConversionPipeline::fn_finishItem(oPipelineItem& oItem, bool bSuccess)
+{
+    if (m_pMemoryBudget && oItem.ullReserved > 0)
+    {
+        m_pMemoryBudget->fn_release(oItem.ullReserved);
+        oItem.ullReserved = 0;
+    }
+
+    fn_reportJob(oItem.sInputFile, bSuccess ? ePipelineResult::Converted : ePipelineResult::Failed);
+}  // End Function fn_finishItem
+
+// Report a job's outcome (also for a job whose item was lost to an exception)
+void ConversionPipeline::fn_reportJob(const std::string& sInputFile, ePipelineResult eResult)
+{
+    m_iUnfinished--;
+    if (eResult == ePipelineResult::Failed)
+    {
+        m_iFailedCount++;
+    }
+
+    if (m_fnOnResult)
+    {
+        m_fnOnResult(sInputFile, eResult);
+    }
+}  // End Function fn_reportJob
+
+// Encoder options for one item, built like the per-file path's
+sEncodeOptions ConversionPipeline::fn_makeItemOptions(const oPipelineItem& oItem) const
+{
+    sOutputOptions oOutput = m_oOutput;
+    oOutput.bReplace = m_oOutput.bReplace || oItem.bReplace;
+    fn_setOutputTimesFrom(oItem.sInputFile, oOutput);
+    return fn_makeEncodeOptions(m_sOutputFormat, m_iQuality, fn_getItemThreads(), oOutput,
+                                m_oWebP, m_oPng, m_oJpeg, m_oTiff);
+}  // End Function fn_makeItemOptions
+
+// Every stage worker is busy while the jobs outnumber the threads; once
+// fewer remain, each encode may split its strips across the idle share
+int ConversionPipeline::fn_getItemThreads() const
+{
+    return std::max(1, m_iTotalThreads / std::max(1, m_iUnfinished.load()));
+}  // End Function fn_getItemThreads
+
+// Stage 1: map input files and fault them into memory
+void ConversionPipeline::fn_readStage(const std::vector<sPipelineJob>& vJobs, std::atomic<size_t>& stNextJob,
+                                      tItemQueue& oOut)
+{
+    while (!(m_fnShouldStop && m_fnShouldStop()))
+    {
+        size_t stIdx = stNextJob.fetch_add(1);
+        if (stIdx >= vJobs.size())
+        {
+            break;
+        }
+
+        tItemPtr pItem;
+        try
+        {
+            pItem.reset(new oPipelineItem());
+            pItem->sInputFile = vJobs[stIdx].sInputFile;
+            pItem->sOutputFile = vJobs[stIdx].sOutputFile;
+            pItem->bReplace = vJobs[stIdx].bReplace;
+
+            // Fault the mapping in here so the decode stage does not stall on I/O
+            if (!pItem->oInput.fn_open(pItem->sInputFile, eMapAccess::Prefault))
+            {
+                fn_logError("Failed to read input file: " + pItem->oInput.fn_getLastError());
+                fn_finishItem(*pItem, false);
+                continue;
+            }
+
+            // The filter sees the bytes while they are still in cache
+            if (m_fnReadFilter && !m_fnReadFilter(pItem->sInputFile, pItem->sOutputFile,
+                                                  pItem->oInput.fn_getData(), pItem->oInput.fn_getSize()))
+            {
+                fn_reportJob(pItem->sInputFile, ePipelineResult::Filtered);
+                continue;
+            }
+
+            oOut.fn_push(std::move(pItem));
+        }
+        catch (const std::exception& e)
+        {
+            fn_logError("Failed to read " + vJobs[stIdx].sInputFile + ": " + e.what());
+            fn_reportJob(vJobs[stIdx].sInputFile, ePipelineResult::Failed);
+        }
+    }
+}  // End Function fn_readStage
+
+// Stage 2: decode HEIF and pull EXIF out of the same buffer
+void ConversionPipeline::fn_decodeStage(tItemQueue& oIn, tItemQueue& oOut)
+{
+    HeicDecoder oDecoder;
+    oDecoder.fn_setMaxDimension(m_iMaxDimension);
+    MetadataHandler oMetadata;
+    FormatEncoder oEncoder;
+    sEncodeOptions oEncodeOptions = fn_makeEncodeOptions(m_sOutputFormat, m_iQuality, 1, m_oOutput,
+                                                         m_oWebP, m_oPng, m_oJpeg, m_oTiff);
+    // Untouched frames go to JPEG / lossy WebP as the decoder's YCbCr planes
+    bool bTryPlanar = m_iMaxDimension <= 0 && !fn_isResizeRequested(m_oResize) &&
+                      oEncoder.fn_supportsPlanar(oEncodeOptions);
+    HeifContainer oContainer;
+    tItemPtr pItem;
+
+    while (oIn.fn_pop(pItem))
+    {
+        // Wait until this image's decoded size fits beside those still
+        // queued for encode and write; held until the item finishes
+        if (m_pMemoryBudget)
+        {
+            uint64_t ullEstimate = fn_estimateMemoryConversionBytes(pItem->oInput.fn_getData(),
+                                                                    pItem->oInput.fn_getSize());
+            pItem->ullReserved = m_pMemoryBudget->fn_acquire(ullEstimate);
+        }
+
+        try
+        {
+            // One parse serves both the pixel decode and EXIF extraction
+            if (!oContainer.fn_openMemory(pItem->oInput.fn_getData(), pItem->oInput.fn_getSize()))
+            {
+                fn_logError("Decode error for " + pItem->sInputFile + ": " + oContainer.fn_getLastError());
+                oContainer.fn_close();
+                fn_finishItem(*pItem, false);
+                pItem.reset();
+                continue;
+            }
+            if (!bTryPlanar || !oDecoder.fn_decodePlanar(oContainer, pItem->oPlanar))
+            {
+                pItem->oImage = oDecoder.fn_decodeContainer(oContainer);
+
+                if (!pItem->oImage.sError.empty())
+                {
+                    fn_logError("Decode error for " + pItem->sInputFile + ": " + pItem->oImage.sError);
+                    fn_finishItem(*pItem, false);
+                    pItem.reset();
+                    continue;
+                }
+
+                // Files already run in parallel here, so each resize is serial
+                ImageBuffer oResized = fn_resizeForOptions(pItem->oImage.oPixels, m_oResize);
+                if (oResized.fn_isEmpty())
+                {
+                    fn_logError("Failed to resize " + pItem->sInputFile);
+                    fn_finishItem(*pItem, false);
+                    pItem.reset();
+                    continue;
+                }
+                pItem->oImage.iWidth = oResized.fn_getWidth();
+                pItem->oImage.iHeight = oResized.fn_getHeight();
+                pItem->oImage.oPixels = std::move(oResized);
+            }
+
+            if (m_bPreserveMetadata)
+            {
+                pItem->vExifData = oMetadata.extractExif(oContainer);
+                pItem->vXmpData = oMetadata.extractXmp(oContainer);
+                pItem->vIccProfile = oMetadata.extractIccProfile(oContainer);
+            }
+        }
+        catch (const std::exception& e)
+        {
+            fn_logError("Failed to decode " + pItem->sInputFile + ": " + e.what());
+            fn_finishItem(*pItem, false);
+            pItem.reset();
+            continue;
+        }
+
+        // Compressed input is no longer needed
+        oContainer.fn_close();
+        pItem->oInput.fn_close();
+        oOut.fn_push(std::move(pItem));
+    }
+}  // End Function fn_decodeStage
+
+// Stage 3: encode to the output format in memory
+void ConversionPipeline::fn_encodeStage(tItemQueue& oIn, tItemQueue& oOut)
+{
+    FormatEncoder oEncoder;
+    bool bMemoryOutput = oEncoder.fn_supportsMemoryOutput(m_sOutputFormat);
+    tItemPtr pItem;
+
+    while (oIn.fn_pop(pItem))
+    {
+        bool bEncoded = false;
+        try
+        {
+            sEncodeOptions oOptions = fn_makeItemOptions(*pItem);
+            if (fn_formatCarriesMetadata(m_sOutputFormat))
+            {
+                // Written as APP segments, mux chunks, eXIf or TIFF IFDs during the encode
+                sExifEditOptions oExifEdit = m_oExifEdit;
+                oExifEdit.iPixelWidth = pItem->oPlanar.fn_isEmpty() ? pItem->oImage.oPixels.fn_getWidth() : pItem->oPlanar.iWidth;
+                oExifEdit.iPixelHeight = pItem->oPlanar.fn_isEmpty() ? pItem->oImage.oPixels.fn_getHeight() : pItem->oPlanar.iHeight;
+                if (!fn_editExif(pItem->vExifData, oExifEdit))
+                {
+                    fn_logWarning("Could not parse EXIF block of " + pItem->sInputFile);
+                }
+                oOptions.vExifData = std::move(pItem->vExifData);
+                oOptions.vXmpData = std::move(pItem->vXmpData);
+                oOptions.vIccProfile = std::move(pItem->vIccProfile);
+                oOptions.bPreserveMetadata = !oOptions.vExifData.empty() || !oOptions.vXmpData.empty() ||
+                                             !oOptions.vIccProfile.empty();
+            }
+
+            if (!pItem->oPlanar.fn_isEmpty())
+            {
+                bEncoded = bMemoryOutput
+                    ? oEncoder.fn_encodePlanarToMemory(pItem->oPlanar, oOptions, pItem->vEncoded)
+                    : oEncoder.fn_encodePlanar(pItem->oPlanar, pItem->sOutputFile, oOptions);
+                pItem->bWrittenByEncoder = !bMemoryOutput;
+            }
+            else if (bMemoryOutput)
+            {
+                sImageData oImageData = fn_makeImageData(pItem->oImage.oPixels);
+                bEncoded = oEncoder.fn_encodeToMemory(oImageData, oOptions, pItem->vEncoded);
+            }
+            else
+            {
+                // TIFF needs a seekable file, so it is written from this stage
+                sImageData oImageData = fn_makeImageData(pItem->oImage.oPixels);
+                bEncoded = oEncoder.fn_encodeImage(oImageData, pItem->sOutputFile, oOptions);
+                pItem->bWrittenByEncoder = true;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            fn_logError("Failed to encode " + pItem->sInputFile + ": " + e.what());
+            fn_finishItem(*pItem, false);
+            pItem.reset();
+            continue;
+        }
+
+        // Pixels are no longer needed
+        pItem->oImage.oPixels.fn_reset();
+        pItem->oPlanar = sPlanarImage();
+
+        if (!bEncoded)
+        {
+            fn_logError("Failed to encode image: " + pItem->sOutputFile);
+            fn_finishItem(*pItem, false);
+            pItem.reset();
+            continue;
+        }
+
+        oOut.fn_push(std::move(pItem));
+    }
+}  // End Function fn_encodeStage
+
+// Stage 4: write output with the source timestamps, published atomically
+void ConversionPipeline::fn_writeStage(tItemQueue& oIn)
+{
+    tItemPtr pItem;
+
+    while (oIn.fn_pop(pItem))
+    {
+        bool bSuccess = true;
+
+        try
+        {
+            if (!pItem->bWrittenByEncoder)
+            {
+                sOutputOptions oOutput = m_oOutput;
+                oOutput.bReplace = m_oOutput.bReplace || pItem->bReplace;
+                fn_setOutputTimesFrom(pItem->sInputFile, oOutput);
+                std::string sError;
+                if (!fn_writeOutputFile(pItem->sOutputFile, pItem->vEncoded.data(), pItem->vEncoded.size(), oOutput, sError))
+                {
+                    fn_logError("Failed to write output file: " + sError);
+                    bSuccess = false;
+                }
+            }
+        }
+        catch (const std::exception& e)
+        {
+            fn_logError("Failed to write " + pItem->sOutputFile + ": " + e.what());
+            bSuccess = false;
+        }
+        std::vector<unsigned char>().swap(pItem->vEncoded);
+
+        fn_finishItem(*pItem, bSuccess);
+        pItem.reset();
+    }
+}  // End Function fn_writeStage
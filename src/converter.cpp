@@ -2,7 +2,10 @@
 #include "image_processor.h"
 #include "format_encoder.h"
 #include "metadata_handler.h"
+#include "heif_container.h"
 #include "logger.h"
+#include "memory_budget.h"
+#include "thread_pool.h"
 #include <iostream>
 #include <filesystem>
 #include <fstream>
@@ -35,6 +38,18 @@ Converter::~Converter()
 // Function: fn_initialize
 int Converter::fn_initialize(const oConfig& oCurrentConfig)
 {
+    // A single image gets every configured thread for its grid tiles
+    fn_setTileThreads(ThreadPool::fn_resolveThreadCount(oCurrentConfig.iThreadCount));
+    fn_setMaxDimension(oCurrentConfig.iMaxDimension);
+    fn_setResizeOptions(fn_makeResizeOptions(oCurrentConfig));
+    fn_setExifEditOptions(fn_makeExifEditOptions(oCurrentConfig));
+    fn_setOutputOptions(fn_makeOutputOptions(oCurrentConfig));
+    fn_setWebPOptions(fn_makeWebPOptions(oCurrentConfig));
+    fn_setPngOptions(fn_makePngOptions(oCurrentConfig));
+    fn_setJpegOptions(fn_makeJpegOptions(oCurrentConfig));
+    fn_setTiffOptions(fn_makeTiffOptions(oCurrentConfig));
+    fn_setRenditions(fn_makeRenditions(oCurrentConfig));
+    
     // Simple initialization
     m_pLogger->fn_logInfo("Converter initialized");
     return ERROR_SUCCESS;
@@ -81,13 +96,24 @@ int Converter::fn_convertFile(const std::string& sInputPath,
         formatWithoutDot = formatWithoutDot.substr(1);
     }
     
-    // Extract EXIF metadata from HEIC file
+    // Read and parse the input once; decode and metadata share it
+    HeifContainer container;
+    if (!container.fn_openFile(sInputPath) && container.fn_getFileSize() == 0) {
+        m_pLogger->fn_logError("Failed to read input file: " + sInputPath);
+        return ERROR_READ_PERMISSION;
+    }
+    
+    // Extract EXIF, XMP and ICC metadata from HEIC file
     std::vector<unsigned char> exifData;
+    std::vector<unsigned char> xmpData;
+    std::vector<unsigned char> iccProfile;
     MetadataHandler metadataHandler;
     
-    if (fn_isHeicFormat(sInputPath)) {
+    if (fn_isHeicFormat(sInputPath) && container.fn_isOpen()) {
         m_pLogger->fn_logInfo("Extracting metadata from HEIC file...");
-        exifData = metadataHandler.extractExifFromHeic(sInputPath);
+        exifData = metadataHandler.extractExif(container);
+        xmpData = metadataHandler.extractXmp(container);
+        iccProfile = metadataHandler.extractIccProfile(container);
         
         if (!exifData.empty()) {
             m_pLogger->fn_logInfo("Extracted " + std::to_string(exifData.size()) + " bytes of EXIF data");
@@ -96,24 +122,56 @@ int Converter::fn_convertFile(const std::string& sInputPath,
         }
     }
     
-    // Use ImageProcessor to convert the file
+    // The encoder sets the source timestamps on the output before it is
+    // linked into place, so the path is not reopened afterwards
+    sOutputOptions oOutput = m_oOutput;
+    fn_setOutputTimesFrom(sInputPath, oOutput);
+    m_pImageProcessor->fn_setOutputOptions(oOutput);
+    
+    // Use ImageProcessor to convert the file; JPEG, WebP and PNG output get
+    // the metadata (APP segments, mux chunks, eXIf) in the same encode pass
+    m_pImageProcessor->fn_setMetadata(exifData, xmpData, iccProfile);
+    
+    // Renditions share one decode; each is named after the output path
+    if (!m_vRenditions.empty()) {
+        std::vector<std::string> vsRenditionPaths;
+        for (const sRendition& oRendition : m_vRenditions) {
+            vsRenditionPaths.push_back(fn_getRenditionPath(sOutputPath, oRendition));
+        }
+        bool bWritten = m_pImageProcessor->fn_convertRenditions(container, sInputPath, m_vRenditions, vsRenditionPaths);
+        m_pImageProcessor->fn_setMetadata({}, {}, {});
+        if (!bWritten) {
+            m_pLogger->fn_logError("Rendition conversion failed: " + sInputPath);
+            return ERROR_ENCODING_FAILED;
+        }
+        return ERROR_SUCCESS;
+    }
+    
     bool success = m_pImageProcessor->fn_convertImage(
+        container,
         sInputPath,
         sOutputPath,
         formatWithoutDot,
         85 // Default quality
     );
+    m_pImageProcessor->fn_setMetadata({}, {}, {});
     
+    bool fallbackUsed = false;
     if (!success) {
         m_pLogger->fn_logError("Conversion failed: " + sInputPath);
         success = fn_fallbackSystemConversion(sInputPath, sOutputPath);
+        fallbackUsed = true;
+    }
+    
+    if (!success) {
+        return ERROR_ENCODING_FAILED;
     }
     
-    // Write EXIF metadata to output file if it's a JPEG
+    // A fallback JPEG was written without our encoder, so add EXIF to it
     std::string outputExt = outputPath.extension().string();
     std::transform(outputExt.begin(), outputExt.end(), outputExt.begin(), ::tolower);
     
-    if ((outputExt == ".jpg" || outputExt == ".jpeg") && !exifData.empty()) {
+    if (fallbackUsed && (outputExt == ".jpg" || outputExt == ".jpeg") && !exifData.empty()) {
         m_pLogger->fn_logInfo("Writing EXIF metadata to JPEG file...");
         bool metadataWritten = metadataHandler.writeExifToJpeg(sOutputPath, exifData);
         
@@ -124,14 +182,16 @@ int Converter::fn_convertFile(const std::string& sInputPath,
         }
     }
     
-    // Copy timestamps from source to destination
-    m_pLogger->fn_logInfo("Copying file timestamps...");
-    bool timestampsCopied = metadataHandler.copyTimestamps(sInputPath, sOutputPath);
-    
-    if (!timestampsCopied) {
-        m_pLogger->fn_logWarning("Failed to copy file timestamps");
-    } else {
-        m_pLogger->fn_logInfo("File timestamps successfully copied");
+    // Copy timestamps from source to a file the fallback wrote
+    if (fallbackUsed) {
+        m_pLogger->fn_logInfo("Copying file timestamps...");
+        bool timestampsCopied = metadataHandler.copyTimestamps(sInputPath, sOutputPath);
+        
+        if (!timestampsCopied) {
+            m_pLogger->fn_logWarning("Failed to copy file timestamps");
+        } else {
+            m_pLogger->fn_logInfo("File timestamps successfully copied");
+        }
     }
     
     m_pLogger->fn_logSuccess("Successfully converted: " + sInputPath + " to " + sOutputPath);
@@ -156,6 +216,168 @@ void Converter::fn_setImageProcessor(std::shared_ptr<ImageProcessor> pProcessor)
     m_pImageProcessor = pProcessor;
 } // End Function fn_setImageProcessor
 
+// Set grid tile decode workers per image
+void Converter::fn_setTileThreads(int iThreads)
+{
+    m_pImageProcessor->fn_setTileThreads(iThreads);
+} // End Function fn_setTileThreads
+
+// Take the per-image thread count from the batch at each step
+void Converter::fn_setThreadShare(const fnThreadShare& fnShare)
+{
+    m_pImageProcessor->fn_setThreadShare(fnShare);
+} // End Function fn_setThreadShare
+
+// Set the preview size limit
+void Converter::fn_setMaxDimension(int iMaxDimension)
+{
+    m_pImageProcessor->fn_setMaxDimension(iMaxDimension);
+} // End Function fn_setMaxDimension
+
+// Set the resize stage options
+void Converter::fn_setResizeOptions(const sResizeOptions& oOptions)
+{
+    m_pImageProcessor->fn_setResizeOptions(oOptions);
+} // End Function fn_setResizeOptions
+
+// Function: fn_makeResizeOptions
+sResizeOptions fn_makeResizeOptions(const oConfig& oCurrentConfig)
+{
+    sResizeOptions oOptions;
+    oOptions.fScale = oCurrentConfig.fScaleFactor;
+    oOptions.iFitWidth = oCurrentConfig.iFitWidth;
+    oOptions.iFitHeight = oCurrentConfig.iFitHeight;
+    fn_parseResizeFilter(oCurrentConfig.sResizeFilter, oOptions.eFilter);
+    return oOptions;
+} // End Function fn_makeResizeOptions
+
+// Set the EXIF edits applied before the metadata is written
+void Converter::fn_setExifEditOptions(const sExifEditOptions& oOptions)
+{
+    m_pImageProcessor->fn_setExifEditOptions(oOptions);
+} // End Function fn_setExifEditOptions
+
+// Function: fn_makeExifEditOptions
+sExifEditOptions fn_makeExifEditOptions(const oConfig& oCurrentConfig)
+{
+    sExifEditOptions oOptions;
+    oOptions.bStripGps = !oCurrentConfig.bPreserveGPS;
+    oOptions.bStripMakerNote = !oCurrentConfig.bPreserveMakerNote;
+    return oOptions;
+} // End Function fn_makeExifEditOptions
+
+// Set how output files are published
+void Converter::fn_setOutputOptions(const sOutputOptions& oOptions)
+{
+    m_oOutput = oOptions;
+} // End Function fn_setOutputOptions
+
+// Function: fn_makeOutputOptions
+sOutputOptions fn_makeOutputOptions(const oConfig& oCurrentConfig)
+{
+    sOutputOptions oOptions;
+    fn_parseSyncMode(oCurrentConfig.sSyncMode, oOptions.eSync);
+    return oOptions;
+} // End Function fn_makeOutputOptions
+
+// Set the WebP encoder settings
+void Converter::fn_setWebPOptions(const sWebPOptions& oOptions)
+{
+    m_pImageProcessor->fn_setWebPOptions(oOptions);
+} // End Function fn_setWebPOptions
+
+// Function: fn_makeWebPOptions
+sWebPOptions fn_makeWebPOptions(const oConfig& oCurrentConfig)
+{
+    sWebPOptions oOptions;
+    oOptions.bLossless = oCurrentConfig.bWebPLossless;
+    oOptions.iEffort = oCurrentConfig.iWebPEffort;
+    oOptions.iNearLossless = oCurrentConfig.iWebPNearLossless;
+    oOptions.iAlphaQuality = oCurrentConfig.iWebPAlphaQuality;
+    return oOptions;
+} // End Function fn_makeWebPOptions
+
+// Set the PNG encoder settings
+void Converter::fn_setPngOptions(const sPngOptions& oOptions)
+{
+    m_pImageProcessor->fn_setPngOptions(oOptions);
+} // End Function fn_setPngOptions
+
+// Function: fn_makePngOptions
+sPngOptions fn_makePngOptions(const oConfig& oCurrentConfig)
+{
+    sPngOptions oOptions;
+    oOptions.iCompressionLevel = oCurrentConfig.iPngCompression;
+    oOptions.bFast = oCurrentConfig.bPngFast;
+    return oOptions;
+} // End Function fn_makePngOptions
+
+// Set the JPEG encoder settings
+void Converter::fn_setJpegOptions(const sJpegOptions& oOptions)
+{
+    m_pImageProcessor->fn_setJpegOptions(oOptions);
+} // End Function fn_setJpegOptions
+
+// Function: fn_makeJpegOptions
+sJpegOptions fn_makeJpegOptions(const oConfig& oCurrentConfig)
+{
+    sJpegOptions oOptions;
+    oOptions.bParallelStrips = oCurrentConfig.bJpegParallel;
+    return oOptions;
+} // End Function fn_makeJpegOptions
+
+// Set the TIFF encoder settings
+void Converter::fn_setTiffOptions(const sTiffOptions& oOptions)
+{
+    m_pImageProcessor->fn_setTiffOptions(oOptions);
+} // End Function fn_setTiffOptions
+
+// Function: fn_makeTiffOptions
+sTiffOptions fn_makeTiffOptions(const oConfig& oCurrentConfig)
+{
+    sTiffOptions oOptions;
+    fn_parseTiffCompression(oCurrentConfig.sTiffCompression, oOptions.eCompression);
+    oOptions.iLevel = oCurrentConfig.iPngCompression;
+    return oOptions;
+} // End Function fn_makeTiffOptions
+
+// Set the renditions written for each input
+void Converter::fn_setRenditions(const std::vector<sRendition>& vRenditions)
+{
+    m_vRenditions = vRenditions;
+} // End Function fn_setRenditions
+
+// Function: fn_makeRenditions
+std::vector<sRendition> fn_makeRenditions(const oConfig& oCurrentConfig)
+{
+    std::vector<sRendition> vRenditions;
+    for (const std::string& sSpec : oCurrentConfig.vsRenditions) {
+        sRendition oRendition;
+        if (fn_parseRendition(sSpec, oRendition)) {
+            vRenditions.push_back(oRendition);
+        }
+    }
+    return vRenditions;
+} // End Function fn_makeRenditions
+
+// Function: fn_makeMemoryLimit
+uint64_t fn_makeMemoryLimit(const oConfig& oCurrentConfig)
+{
+    uint64_t ullLimit = 0;
+    if (!fn_resolveMemoryLimit(oCurrentConfig.sMemoryLimit, ullLimit)) {
+        return 0;
+    }
+    return ullLimit;
+} // End Function fn_makeMemoryLimit
+
+// Function: fn_makeDedupMode
+eDedupMode fn_makeDedupMode(const oConfig& oCurrentConfig)
+{
+    eDedupMode eMode = eDedupMode::Off;
+    fn_parseDedupMode(oCurrentConfig.sDedupMode, eMode);
+    return eMode;
+} // End Function fn_makeDedupMode
+
 // Set batch processor
 void Converter::fn_setBatchProcessor(std::shared_ptr<BatchProcessor> pProcessor)
 {
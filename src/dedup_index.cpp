@@ -0,0 +1,464 @@
+// dedup_index.cpp - Content hashing and duplicate-input tracking for batches
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "dedup_index.h"
+#include "mapped_file.h"
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+namespace
+{
+
+const uint64_t ullPRIME64_1 = 0x9E3779B185EBCA87ull;
+const uint64_t ullPRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+const uint64_t ullPRIME64_3 = 0x165667B19E3779F9ull;
+const uint64_t ullPRIME64_4 = 0x85EBCA77C2B2AE63ull;
+const uint64_t ullPRIME64_5 = 0x27D4EB2F165667C5ull;
+const size_t stCOPY_CHUNK_BYTES = 1 << 20;
+
+inline uint64_t fn_rotl64(uint64_t ullValue, int iBits)
+{
+    return (ullValue << iBits) | (ullValue >> (64 - iBits));
+} // End Function fn_rotl64
+
+// Little-endian loads, whatever the host order
+inline uint64_t fn_read64(const unsigned char* pData)
+{
+    uint64_t ullValue;
+    std::memcpy(&ullValue, pData, sizeof(ullValue));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    ullValue = __builtin_bswap64(ullValue);
+#endif
+    return ullValue;
+} // End Function fn_read64
+
+inline uint32_t fn_read32(const unsigned char* pData)
+{
+    uint32_t uValue;
+    std::memcpy(&uValue, pData, sizeof(uValue));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    uValue = __builtin_bswap32(uValue);
+#endif
+    return uValue;
+} // End Function fn_read32
+
+inline uint64_t fn_round(uint64_t ullAcc, uint64_t ullInput)
+{
+    ullAcc += ullInput * ullPRIME64_2;
+    ullAcc = fn_rotl64(ullAcc, 31);
+    return ullAcc * ullPRIME64_1;
+} // End Function fn_round
+
+inline uint64_t fn_mergeRound(uint64_t ullAcc, uint64_t ullValue)
+{
+    ullAcc ^= fn_round(0, ullValue);
+    return ullAcc * ullPRIME64_1 + ullPRIME64_4;
+} // End Function fn_mergeRound
+
+// Hidden name next to sPath for a link that is renamed over it
+std::string fn_makeLinkTempPath(const std::string& sPath)
+{
+    static std::atomic<unsigned int> uCounter(0);
+    size_t stSlash = sPath.find_last_of('/');
+    std::string sName = stSlash == std::string::npos ? sPath : sPath.substr(stSlash + 1);
+    std::string sDirectory = stSlash == std::string::npos ? std::string() : sPath.substr(0, stSlash + 1);
+    return sDirectory + "." + sName + "." + std::to_string(getpid()) + ".dup" + std::to_string(++uCounter) + ".tmp";
+} // End Function fn_makeLinkTempPath
+
+// Hard link sSource as sDestination; false with errno set on failure
+bool fn_linkDuplicate(const std::string& sSource, const std::string& sDestination, bool bReplace)
+{
+    if (link(sSource.c_str(), sDestination.c_str()) == 0)
+    {
+        return true;
+    }
+    if (errno != EEXIST || !bReplace)
+    {
+        return false;
+    }
+
+    // link() never replaces: link under a temporary name, rename over
+    std::string sTemporary = fn_makeLinkTempPath(sDestination);
+    if (link(sSource.c_str(), sTemporary.c_str()) != 0)
+    {
+        return false;
+    }
+    if (std::rename(sTemporary.c_str(), sDestination.c_str()) != 0)
+    {
+        int iError = errno;
+        unlink(sTemporary.c_str());
+        errno = iError;
+        return false;
+    }
+    return true;
+} // End Function fn_linkDuplicate
+
+// Fill iOutFd with the bytes of iInFd: reflink when allowed, else copy
+bool fn_cloneOrCopy(int iInFd, int iOutFd, uint64_t ullSize, bool bTryClone, eDedupMode& eUsed)
+{
+#if defined(__linux__) && defined(FICLONE)
+    if (bTryClone && ioctl(iOutFd, FICLONE, iInFd) == 0)
+    {
+        eUsed = eDedupMode::Clone;
+        return true;
+    }
+#else
+    (void)bTryClone;
+#endif
+    eUsed = eDedupMode::Copy;
+
+    uint64_t ullDone = 0;
+#ifdef __linux__
+    // In-kernel copy; some filesystems share extents here on their own
+    while (ullDone < ullSize)
+    {
+        ssize_t lCopied = copy_file_range(iInFd, nullptr, iOutFd, nullptr, static_cast<size_t>(ullSize - ullDone), 0);
+        if (lCopied <= 0)
+        {
+            if (lCopied < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (ullDone == 0 && lCopied < 0)
+            {
+                break;  // Not supported here: fall back to read/write
+            }
+            return false;
+        }
+        ullDone += static_cast<uint64_t>(lCopied);
+    }
+    if (ullDone == ullSize)
+    {
+        return true;
+    }
+#endif
+
+    std::vector<unsigned char> vBuffer(stCOPY_CHUNK_BYTES);
+    while (ullDone < ullSize)
+    {
+        ssize_t lRead = pread(iInFd, vBuffer.data(), vBuffer.size(), static_cast<off_t>(ullDone));
+        if (lRead < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (lRead <= 0)
+        {
+            return false;
+        }
+        size_t stWritten = 0;
+        while (stWritten < static_cast<size_t>(lRead))
+        {
+            ssize_t lBytes = write(iOutFd, vBuffer.data() + stWritten, static_cast<size_t>(lRead) - stWritten);
+            if (lBytes < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (lBytes <= 0)
+            {
+                return false;
+            }
+            stWritten += static_cast<size_t>(lBytes);
+        }
+        ullDone += static_cast<uint64_t>(lRead);
+    }
+    return true;
+} // End Function fn_cloneOrCopy
+
+} // End anonymous namespace
+
+// Parse a --dedup mode
+bool fn_parseDedupMode(const std::string& sName, eDedupMode& eMode)
+{
+    if (sName == "off")
+    {
+        eMode = eDedupMode::Off;
+    }
+    else if (sName == "link")
+    {
+        eMode = eDedupMode::Link;
+    }
+    else if (sName == "clone")
+    {
+        eMode = eDedupMode::Clone;
+    }
+    else if (sName == "copy")
+    {
+        eMode = eDedupMode::Copy;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+} // End Function fn_parseDedupMode
+
+// Name of a dedup mode
+std::string fn_getDedupModeName(eDedupMode eMode)
+{
+    switch (eMode)
+    {
+        case eDedupMode::Link:
+            return "link";
+        case eDedupMode::Clone:
+            return "clone";
+        case eDedupMode::Copy:
+            return "copy";
+        default:
+            return "off";
+    }
+} // End Function fn_getDedupModeName
+
+// XXH64 of a buffer
+uint64_t fn_hashContent(const void* pData, size_t stSize, uint64_t ullSeed)
+{
+    const unsigned char* pBytes = static_cast<const unsigned char*>(pData);
+    const unsigned char* pEnd = pBytes + stSize;
+    uint64_t ullHash;
+
+    if (stSize >= 32)
+    {
+        // Four independent lanes keep the multipliers busy
+        uint64_t ullV1 = ullSeed + ullPRIME64_1 + ullPRIME64_2;
+        uint64_t ullV2 = ullSeed + ullPRIME64_2;
+        uint64_t ullV3 = ullSeed;
+        uint64_t ullV4 = ullSeed - ullPRIME64_1;
+        const unsigned char* pLimit = pEnd - 32;
+        do
+        {
+            ullV1 = fn_round(ullV1, fn_read64(pBytes));
+            ullV2 = fn_round(ullV2, fn_read64(pBytes + 8));
+            ullV3 = fn_round(ullV3, fn_read64(pBytes + 16));
+            ullV4 = fn_round(ullV4, fn_read64(pBytes + 24));
+            pBytes += 32;
+        } while (pBytes <= pLimit);
+
+        ullHash = fn_rotl64(ullV1, 1) + fn_rotl64(ullV2, 7) + fn_rotl64(ullV3, 12) + fn_rotl64(ullV4, 18);
+        ullHash = fn_mergeRound(ullHash, ullV1);
+        ullHash = fn_mergeRound(ullHash, ullV2);
+        ullHash = fn_mergeRound(ullHash, ullV3);
+        ullHash = fn_mergeRound(ullHash, ullV4);
+    }
+    else
+    {
+        ullHash = ullSeed + ullPRIME64_5;
+    }
+
+    ullHash += static_cast<uint64_t>(stSize);
+
+    while (pBytes + 8 <= pEnd)
+    {
+        ullHash ^= fn_round(0, fn_read64(pBytes));
+        ullHash = fn_rotl64(ullHash, 27) * ullPRIME64_1 + ullPRIME64_4;
+        pBytes += 8;
+    }
+    if (pBytes + 4 <= pEnd)
+    {
+        ullHash ^= static_cast<uint64_t>(fn_read32(pBytes)) * ullPRIME64_1;
+        ullHash = fn_rotl64(ullHash, 23) * ullPRIME64_2 + ullPRIME64_3;
+        pBytes += 4;
+    }
+    while (pBytes < pEnd)
+    {
+        ullHash ^= (*pBytes) * ullPRIME64_5;
+        ullHash = fn_rotl64(ullHash, 11) * ullPRIME64_1;
+        pBytes++;
+    }
+
+    ullHash ^= ullHash >> 33;
+    ullHash *= ullPRIME64_2;
+    ullHash ^= ullHash >> 29;
+    ullHash *= ullPRIME64_3;
+    ullHash ^= ullHash >> 32;
+    return ullHash;
+} // End Function fn_hashContent
+
+// Produce a duplicate's output from the first copy's output
+bool fn_materializeDuplicate(const std::string& sSource, const std::string& sDestination, eDedupMode eMode,
+                             const sOutputOptions& oOptions, eDedupMode& eUsed, std::string& sError)
+{
+    if (eMode == eDedupMode::Link)
+    {
+        if (fn_linkDuplicate(sSource, sDestination, oOptions.bReplace))
+        {
+            eUsed = eDedupMode::Link;
+            return true;
+        }
+        if (errno == EEXIST)
+        {
+            sError = "Output already exists: " + sDestination;
+            return false;
+        }
+        // Other filesystem, link limit or no hard links: fall through
+    }
+
+    int iInFd = open(sSource.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat oStat;
+    if (iInFd < 0 || fstat(iInFd, &oStat) != 0)
+    {
+        sError = "Cannot read " + sSource + ": " + std::strerror(errno);
+        if (iInFd >= 0)
+        {
+            close(iInFd);
+        }
+        return false;
+    }
+
+    OutputFile oOutput;
+    bool bSuccess = oOutput.fn_open(sDestination) &&
+                    fn_cloneOrCopy(iInFd, oOutput.fn_getFd(), static_cast<uint64_t>(oStat.st_size),
+                                   eMode != eDedupMode::Copy, eUsed);
+    if (!bSuccess && oOutput.fn_getLastError().empty())
+    {
+        sError = "Failed to copy " + sSource + " to " + sDestination + ": " + std::strerror(errno);
+    }
+    close(iInFd);
+
+    if (bSuccess && !oOutput.fn_commit(oOptions))
+    {
+        bSuccess = false;
+    }
+    if (!bSuccess && sError.empty())
+    {
+        sError = oOutput.fn_getLastError();
+    }
+    return bSuccess;
+} // End Function fn_materializeDuplicate
+
+// Constructor
+DedupIndex::DedupIndex()
+{
+} // End Constructor
+
+// Classify an input by content
+eDedupRole DedupIndex::fn_claim(uint64_t ullHash, const unsigned char* pData, size_t stSize,
+                                const std::string& sInputFile, const std::string& sOutputFile,
+                                std::string& sLeaderOutput)
+{
+    tContentKey oKey(stSize, ullHash);
+    std::string sVerifiedLeader;
+
+    std::unique_lock<std::mutex> oLock(m_oMutex);
+    for (;;)
+    {
+        auto itGroup = m_mGroups.find(oKey);
+        if (itGroup == m_mGroups.end())
+        {
+            sGroup& oGroup = m_mGroups[oKey];
+            oGroup.sLeaderInput = sInputFile;
+            oGroup.sLeaderOutput = sOutputFile;
+            m_mConverting[sInputFile] = oKey;
+            return eDedupRole::Convert;
+        }
+
+        sGroup& oGroup = itGroup->second;
+        if (oGroup.sLeaderInput != sVerifiedLeader)
+        {
+            // A matching hash is only a candidate: compare the bytes against
+            // the leader's input, outside the lock, before sharing its output.
+            // The group may change meanwhile, hence the loop.
+            std::string sLeaderInput = oGroup.sLeaderInput;
+            oLock.unlock();
+            bool bSame = fn_isSameContent(sLeaderInput, pData, stSize);
+            oLock.lock();
+            if (!bSame)
+            {
+                m_oSummary.iCollisions++;
+                return eDedupRole::Convert;
+            }
+            sVerifiedLeader = sLeaderInput;
+            continue;
+        }
+
+        if (oGroup.eState == eGroupState::Done)
+        {
+            sLeaderOutput = oGroup.sLeaderOutput;
+            return eDedupRole::Follow;
+        }
+
+        sDedupFollower oFollower;
+        oFollower.sInputFile = sInputFile;
+        oFollower.sOutputFile = sOutputFile;
+        oFollower.ullSize = stSize;
+        oGroup.vWaiting.push_back(oFollower);
+        return eDedupRole::Wait;
+    }
+} // End Function DedupIndex::fn_claim
+
+// Byte-for-byte check of a candidate duplicate
+bool DedupIndex::fn_isSameContent(const std::string& sLeaderInput, const unsigned char* pData, size_t stSize)
+{
+    MappedFile oLeader;
+    if (!oLeader.fn_open(sLeaderInput, eMapAccess::Sequential))
+    {
+        return false;
+    }
+    return oLeader.fn_getSize() == stSize && (stSize == 0 || std::memcmp(oLeader.fn_getData(), pData, stSize) == 0);
+} // End Function DedupIndex::fn_isSameContent
+
+// Close a group's conversion
+std::vector<sDedupFollower> DedupIndex::fn_finish(const std::string& sInputFile, bool bSuccess)
+{
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+    std::vector<sDedupFollower> vWaiting;
+    auto itConverting = m_mConverting.find(sInputFile);
+    if (itConverting == m_mConverting.end())
+    {
+        return vWaiting;
+    }
+
+    auto itGroup = m_mGroups.find(itConverting->second);
+    m_mConverting.erase(itConverting);
+    if (itGroup == m_mGroups.end())
+    {
+        return vWaiting;
+    }
+
+    vWaiting.swap(itGroup->second.vWaiting);
+    if (bSuccess)
+    {
+        itGroup->second.eState = eGroupState::Done;
+    }
+    else
+    {
+        m_mGroups.erase(itGroup);
+    }
+    return vWaiting;
+} // End Function DedupIndex::fn_finish
+
+// Count one duplicate
+void DedupIndex::fn_noteDuplicate(uint64_t ullSize, eDedupMode eUsed)
+{
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+    m_oSummary.iFiles++;
+    m_oSummary.ullBytes += ullSize;
+    if (eUsed == eDedupMode::Link)
+    {
+        m_oSummary.iLinked++;
+    }
+    else if (eUsed == eDedupMode::Clone)
+    {
+        m_oSummary.iCloned++;
+    }
+    else
+    {
+        m_oSummary.iCopied++;
+    }
+} // End Function DedupIndex::fn_noteDuplicate
+
+// Totals so far
+sDedupSummary DedupIndex::fn_getSummary() const
+{
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+    return m_oSummary;
+} // End Function DedupIndex::fn_getSummary
@@ -0,0 +1,219 @@
+// directory_walker.cpp - Parallel single-pass directory tree walker
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "directory_walker.h"
+#include "thread_pool.h"
+#include "logger.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+namespace
+{
+
+#ifdef __linux__
+const size_t stDIRENT_BUFFER_BYTES = 64 * 1024;   // Entries returned per getdents64 call
+#endif
+
+class TreeWalker
+{
+public:
+    TreeWalker(bool bRecursive, const fnWalkFilter& fnFilter, const fnWalkCallback& fnOnFile, ThreadPool* pPool)
+        : m_bRecursive(bRecursive), m_fnFilter(fnFilter), m_fnOnFile(fnOnFile), m_pPool(pPool)
+    {
+    } // End Constructor
+
+    // Read an open directory; false when it was already visited
+    bool fn_readOpenDirectory(const std::string& sPath, int iFd)
+    {
+        struct stat oStat;
+        if (fstat(iFd, &oStat) != 0 || !fn_markVisited(oStat.st_dev, oStat.st_ino))
+        {
+            return false;
+        }
+        fn_readEntries(sPath, iFd);
+        return true;
+    } // End Function fn_readOpenDirectory
+
+    // Directories queued when running without a pool
+    bool fn_popPending(std::string& sPath)
+    {
+        if (m_vsPending.empty())
+        {
+            return false;
+        }
+        sPath = std::move(m_vsPending.back());
+        m_vsPending.pop_back();
+        return true;
+    } // End Function fn_popPending
+
+    // Open and read one subdirectory
+    void fn_visit(const std::string& sPath)
+    {
+        int iFd = open(sPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (iFd < 0)
+        {
+            fn_logWarning("Cannot open directory: " + sPath);
+            return;
+        }
+        fn_readOpenDirectory(sPath, iFd);
+        close(iFd);
+    } // End Function fn_visit
+
+private:
+    // First visit of a (device, inode) pair
+    bool fn_markVisited(dev_t uDevice, ino_t uInode)
+    {
+        std::lock_guard<std::mutex> oLock(m_oVisitedMutex);
+        return m_oVisited.insert(std::make_pair(static_cast<uint64_t>(uDevice), static_cast<uint64_t>(uInode))).second;
+    } // End Function fn_markVisited
+
+    // Queue a subdirectory on the pool, or for the caller's loop
+    void fn_schedule(std::string sPath)
+    {
+        if (m_pPool)
+        {
+            m_pPool->fn_submit([this, sPath]() { fn_visit(sPath); });
+        }
+        else
+        {
+            m_vsPending.push_back(std::move(sPath));
+        }
+    } // End Function fn_schedule
+
+    // Act on one entry; d_type is trusted, links and unknown types are resolved
+    void fn_handleEntry(const std::string& sPath, int iFd, const char* pName, unsigned char uType)
+    {
+        if (pName[0] == '.' && (pName[1] == '\0' || (pName[1] == '.' && pName[2] == '\0')))
+        {
+            return;
+        }
+
+        if (uType == DT_LNK || uType == DT_UNKNOWN)
+        {
+            struct stat oStat;
+            if (fstatat(iFd, pName, &oStat, 0) != 0)
+            {
+                return;  // Dangling link or entry removed meanwhile
+            }
+            uType = S_ISREG(oStat.st_mode) ? DT_REG : (S_ISDIR(oStat.st_mode) ? DT_DIR : DT_UNKNOWN);
+        }
+
+        if (uType == DT_REG)
+        {
+            if (!m_fnFilter || m_fnFilter(pName))
+            {
+                m_fnOnFile(sPath + "/" + pName);
+            }
+        }
+        else if (uType == DT_DIR && m_bRecursive)
+        {
+            fn_schedule(sPath + "/" + pName);
+        }
+    } // End Function fn_handleEntry
+
+    // One pass over the entries of an open directory
+    void fn_readEntries(const std::string& sPath, int iFd)
+    {
+#ifdef __linux__
+        std::unique_ptr<char[]> pBuffer(new char[stDIRENT_BUFFER_BYTES]);
+        while (true)
+        {
+            long lBytes = syscall(SYS_getdents64, iFd, pBuffer.get(), stDIRENT_BUFFER_BYTES);
+            if (lBytes <= 0)
+            {
+                if (lBytes < 0)
+                {
+                    fn_logWarning("Cannot read directory: " + sPath);
+                }
+                break;
+            }
+            // The kernel's linux_dirent64 has the layout of glibc's dirent64
+            for (long lOffset = 0; lOffset < lBytes;)
+            {
+                const struct dirent64* pEntry = reinterpret_cast<const struct dirent64*>(pBuffer.get() + lOffset);
+                fn_handleEntry(sPath, iFd, pEntry->d_name, pEntry->d_type);
+                lOffset += pEntry->d_reclen;
+            }
+        }
+#else
+        // readdir owns a duplicate so the caller can still close iFd
+        DIR* pDir = fdopendir(dup(iFd));
+        if (pDir == nullptr)
+        {
+            fn_logWarning("Cannot read directory: " + sPath);
+            return;
+        }
+        struct dirent* pEntry;
+        while ((pEntry = readdir(pDir)) != nullptr)
+        {
+            fn_handleEntry(sPath, iFd, pEntry->d_name, pEntry->d_type);
+        }
+        closedir(pDir);
+#endif
+    } // End Function fn_readEntries
+
+    bool m_bRecursive;
+    const fnWalkFilter& m_fnFilter;
+    const fnWalkCallback& m_fnOnFile;
+    ThreadPool* m_pPool;                                  // nullptr = walk on the caller
+    std::vector<std::string> m_vsPending;                 // Subdirectories left (no pool)
+    std::mutex m_oVisitedMutex;
+    std::set<std::pair<uint64_t, uint64_t>> m_oVisited;   // (device, inode) of entered directories
+}; // End class TreeWalker
+
+} // End anonymous namespace
+
+// Walk a directory tree
+bool fn_walkDirectory(const std::string& sRoot, bool bRecursive, int iThreads,
+                      const fnWalkFilter& fnFilter, const fnWalkCallback& fnOnFile)
+{
+    // Paths are built as <dir>/<name>; a trailing slash would double up
+    std::string sPath = sRoot;
+    while (sPath.size() > 1 && sPath.back() == '/')
+    {
+        sPath.pop_back();
+    }
+
+    int iFd = open(sPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (iFd < 0)
+    {
+        fn_logError("Cannot open directory: " + sRoot);
+        return false;
+    }
+
+    std::unique_ptr<ThreadPool> pPool;
+    if (bRecursive && iThreads > 1)
+    {
+        pPool.reset(new ThreadPool(iThreads));
+    }
+
+    TreeWalker oWalker(bRecursive, fnFilter, fnOnFile, pPool.get());
+    oWalker.fn_readOpenDirectory(sPath == "/" ? std::string() : sPath, iFd);
+    close(iFd);
+
+    if (pPool)
+    {
+        pPool->fn_waitIdle();
+    }
+    else
+    {
+        std::string sNext;
+        while (oWalker.fn_popPending(sNext))
+        {
+            oWalker.fn_visit(sNext);
+        }
+    }
+    return true;
+} // End Function fn_walkDirectory
@@ -0,0 +1,368 @@
+// exif_editor.cpp - In-place EXIF (TIFF IFD) editing implementation
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "exif_editor.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+const uint16_t uTAG_ORIENTATION = 0x0112;
+const uint16_t uTAG_EXIF_IFD = 0x8769;
+const uint16_t uTAG_GPS_IFD = 0x8825;
+const uint16_t uTAG_INTEROP_IFD = 0xA005;
+const uint16_t uTAG_MAKER_NOTE = 0x927C;
+const uint16_t uTAG_PIXEL_X = 0xA002;
+const uint16_t uTAG_PIXEL_Y = 0xA003;
+const uint16_t uTYPE_SHORT = 3;
+const uint16_t uTYPE_LONG = 4;
+const size_t stENTRY_BYTES = 12;
+
+// Byte-order aware access to the TIFF structure; every offset is relative
+// to the TIFF header and checked against the block size
+struct sTiffView
+{
+    unsigned char* pTiff = nullptr;
+    size_t stSize = 0;
+    bool bLittle = false;
+
+    bool fn_fits(size_t stAt, size_t stLength) const
+    {
+        return stAt <= stSize && stLength <= stSize - stAt;
+    }
+
+    uint32_t fn_get16(size_t stAt) const
+    {
+        return bLittle ? (pTiff[stAt] | (pTiff[stAt + 1] << 8)) : ((pTiff[stAt] << 8) | pTiff[stAt + 1]);
+    }
+
+    uint32_t fn_get32(size_t stAt) const
+    {
+        return bLittle ? (fn_get16(stAt) | (fn_get16(stAt + 2) << 16)) : ((fn_get16(stAt) << 16) | fn_get16(stAt + 2));
+    }
+
+    void fn_put16(size_t stAt, uint32_t uValue)
+    {
+        pTiff[stAt + (bLittle ? 0 : 1)] = static_cast<unsigned char>(uValue);
+        pTiff[stAt + (bLittle ? 1 : 0)] = static_cast<unsigned char>(uValue >> 8);
+    }
+
+    void fn_put32(size_t stAt, uint32_t uValue)
+    {
+        fn_put16(stAt + (bLittle ? 0 : 2), uValue & 0xFFFF);
+        fn_put16(stAt + (bLittle ? 2 : 0), uValue >> 16);
+    }
+}; // End struct sTiffView
+
+// Byte size of one value of a TIFF field type (0 for unknown types)
+size_t fn_getTypeSize(uint32_t uType)
+{
+    switch (uType)
+    {
+        case 1: case 2: case 6: case 7:
+            return 1;
+        case 3: case 8:
+            return 2;
+        case 4: case 9: case 11: case 13:
+            return 4;
+        case 5: case 10: case 12:
+            return 8;
+        default:
+            return 0;
+    }
+} // End Function fn_getTypeSize
+
+// An IFD whose entry table and next-IFD offset lie inside the block
+bool fn_isValidIfd(const sTiffView& oView, size_t stIfd)
+{
+    return stIfd >= 8 && oView.fn_fits(stIfd, 2) &&
+           oView.fn_fits(stIfd + 2, oView.fn_get16(stIfd) * stENTRY_BYTES + 4);
+} // End Function fn_isValidIfd
+
+// Offset of the entry for uTag in an IFD (0 when absent)
+size_t fn_findEntry(const sTiffView& oView, size_t stIfd, uint16_t uTag)
+{
+    uint32_t uEntries = oView.fn_get16(stIfd);
+    for (uint32_t i = 0; i < uEntries; i++)
+    {
+        size_t stEntry = stIfd + 2 + i * stENTRY_BYTES;
+        if (oView.fn_get16(stEntry) == uTag)
+        {
+            return stEntry;
+        }
+    }
+    return 0;
+} // End Function fn_findEntry
+
+// Zero the out-of-line value of an entry (inline values live in the entry)
+void fn_wipeValue(sTiffView& oView, size_t stEntry)
+{
+    size_t stBytes = fn_getTypeSize(oView.fn_get16(stEntry + 2)) * static_cast<size_t>(oView.fn_get32(stEntry + 4));
+    if (stBytes <= 4)
+    {
+        return;
+    }
+    size_t stValue = oView.fn_get32(stEntry + 8);
+    if (stValue >= 8 && oView.fn_fits(stValue, stBytes))
+    {
+        std::memset(oView.pTiff + stValue, 0, stBytes);
+    }
+} // End Function fn_wipeValue
+
+// Remove one entry: later entries and the next-IFD offset move up and the
+// freed 12 bytes are zeroed. Tag order, and every other offset, is kept.
+void fn_removeEntry(sTiffView& oView, size_t stIfd, size_t stEntry)
+{
+    uint32_t uEntries = oView.fn_get16(stIfd);
+    size_t stTableEnd = stIfd + 2 + uEntries * stENTRY_BYTES + 4;
+    std::memmove(oView.pTiff + stEntry, oView.pTiff + stEntry + stENTRY_BYTES, stTableEnd - stEntry - stENTRY_BYTES);
+    std::memset(oView.pTiff + stTableEnd - stENTRY_BYTES, 0, stENTRY_BYTES);
+    oView.fn_put16(stIfd, uEntries - 1);
+} // End Function fn_removeEntry
+
+// Wipe a whole sub-IFD: entry values first, then the table itself
+void fn_wipeIfd(sTiffView& oView, size_t stIfd)
+{
+    if (!fn_isValidIfd(oView, stIfd))
+    {
+        return;
+    }
+    uint32_t uEntries = oView.fn_get16(stIfd);
+    for (uint32_t i = 0; i < uEntries; i++)
+    {
+        fn_wipeValue(oView, stIfd + 2 + i * stENTRY_BYTES);
+    }
+    std::memset(oView.pTiff + stIfd, 0, 2 + uEntries * stENTRY_BYTES + 4);
+} // End Function fn_wipeIfd
+
+// Write a SHORT or LONG dimension, widening SHORT to LONG when it must
+void fn_setDimension(sTiffView& oView, size_t stEntry, uint32_t uValue)
+{
+    if (oView.fn_get32(stEntry + 4) != 1)
+    {
+        return;
+    }
+    if (oView.fn_get16(stEntry + 2) == uTYPE_SHORT && uValue <= 0xFFFF)
+    {
+        oView.fn_put16(stEntry + 8, uValue);
+        oView.fn_put16(stEntry + 10, 0);
+    }
+    else
+    {
+        oView.fn_put16(stEntry + 2, uTYPE_LONG);
+        oView.fn_put32(stEntry + 8, uValue);
+    }
+} // End Function fn_setDimension
+
+// Copy the entries of an IFD, swapping multi-byte values to host order
+void fn_readIfd(const sTiffView& oView, size_t stIfd, std::vector<sExifEntry>& vEntries)
+{
+    static const uint16_t uHOST_ORDER_TEST = 1;
+    bool bHostLittle = *reinterpret_cast<const unsigned char*>(&uHOST_ORDER_TEST) == 1;
+
+    uint32_t uEntries = oView.fn_get16(stIfd);
+    for (uint32_t i = 0; i < uEntries; i++)
+    {
+        size_t stEntry = stIfd + 2 + i * stENTRY_BYTES;
+        sExifEntry oEntry;
+        oEntry.uTag = static_cast<uint16_t>(oView.fn_get16(stEntry));
+        oEntry.uType = static_cast<uint16_t>(oView.fn_get16(stEntry + 2));
+        oEntry.uCount = oView.fn_get32(stEntry + 4);
+        size_t stTypeSize = fn_getTypeSize(oEntry.uType);
+        if (stTypeSize == 0 || oEntry.uTag == uTAG_EXIF_IFD || oEntry.uTag == uTAG_GPS_IFD ||
+            oEntry.uTag == uTAG_INTEROP_IFD || oEntry.uCount > oView.stSize / stTypeSize)
+        {
+            continue;
+        }
+
+        size_t stBytes = stTypeSize * oEntry.uCount;
+        size_t stValue = stBytes <= 4 ? stEntry + 8 : oView.fn_get32(stEntry + 8);
+        if (!oView.fn_fits(stValue, stBytes))
+        {
+            continue;
+        }
+        oEntry.vValue.assign(oView.pTiff + stValue, oView.pTiff + stValue + stBytes);
+
+        // RATIONALs are pairs of 32-bit words; DOUBLE is one 8-byte value
+        size_t stWord = (oEntry.uType == 5 || oEntry.uType == 10) ? 4 : stTypeSize;
+        if (stWord > 1 && oView.bLittle != bHostLittle)
+        {
+            for (size_t stAt = 0; stAt < stBytes; stAt += stWord)
+            {
+                std::reverse(oEntry.vValue.begin() + stAt, oEntry.vValue.begin() + stAt + stWord);
+            }
+        }
+        vEntries.push_back(oEntry);
+    }
+} // End Function fn_readIfd
+} // namespace
+
+// Offset of the TIFF header: bare, after "Exif\0\0", after the HEIF offset
+// field, or (for writers that get the offset wrong) within the first bytes
+bool fn_findTiffHeader(const unsigned char* pData, size_t stSize, size_t& stTiff)
+{
+    auto fn_isTiffHeader = [&](size_t stAt)
+    {
+        return stAt + 8 <= stSize &&
+               ((pData[stAt] == 'I' && pData[stAt + 1] == 'I' && pData[stAt + 2] == 42 && pData[stAt + 3] == 0) ||
+                (pData[stAt] == 'M' && pData[stAt + 1] == 'M' && pData[stAt + 2] == 0 && pData[stAt + 3] == 42));
+    };
+
+    if (stSize >= 4)
+    {
+        size_t stHeif = 4 + ((static_cast<size_t>(pData[0]) << 24) | (pData[1] << 16) | (pData[2] << 8) | pData[3]);
+        if (fn_isTiffHeader(stHeif))
+        {
+            stTiff = stHeif;
+            return true;
+        }
+    }
+    for (stTiff = 0; stTiff < 64; stTiff++)
+    {
+        if (fn_isTiffHeader(stTiff))
+        {
+            return true;
+        }
+    }
+    return false;
+} // End Function fn_findTiffHeader
+
+// Whether any edit is requested
+bool fn_isExifEditRequested(const sExifEditOptions& oOptions)
+{
+    return oOptions.bStripGps || oOptions.bStripMakerNote || oOptions.bResetOrientation ||
+           oOptions.iPixelWidth > 0 || oOptions.iPixelHeight > 0;
+} // End Function fn_isExifEditRequested
+
+// Edit a TIFF/EXIF block in place
+bool fn_editExif(unsigned char* pData, size_t stSize, const sExifEditOptions& oOptions)
+{
+    size_t stTiff = 0;
+    if (!pData || !fn_findTiffHeader(pData, stSize, stTiff))
+    {
+        return false;
+    }
+
+    sTiffView oView;
+    oView.pTiff = pData + stTiff;
+    oView.stSize = stSize - stTiff;
+    oView.bLittle = oView.pTiff[0] == 'I';
+
+    // Validate everything that will be edited before the first write
+    size_t stIfd0 = oView.fn_get32(4);
+    if (!fn_isValidIfd(oView, stIfd0))
+    {
+        return false;
+    }
+    size_t stExifIfd = 0;
+    size_t stExifEntry = fn_findEntry(oView, stIfd0, uTAG_EXIF_IFD);
+    if (stExifEntry)
+    {
+        stExifIfd = oView.fn_get32(stExifEntry + 8);
+        if (!fn_isValidIfd(oView, stExifIfd))
+        {
+            return false;
+        }
+    }
+
+    if (oOptions.bResetOrientation)
+    {
+        size_t stEntry = fn_findEntry(oView, stIfd0, uTAG_ORIENTATION);
+        if (stEntry && oView.fn_get16(stEntry + 2) == uTYPE_SHORT && oView.fn_get32(stEntry + 4) == 1)
+        {
+            oView.fn_put16(stEntry + 8, 1);
+        }
+    }
+
+    if (stExifIfd && (oOptions.iPixelWidth > 0 || oOptions.iPixelHeight > 0))
+    {
+        size_t stEntry = fn_findEntry(oView, stExifIfd, uTAG_PIXEL_X);
+        if (stEntry && oOptions.iPixelWidth > 0)
+        {
+            fn_setDimension(oView, stEntry, static_cast<uint32_t>(oOptions.iPixelWidth));
+        }
+        stEntry = fn_findEntry(oView, stExifIfd, uTAG_PIXEL_Y);
+        if (stEntry && oOptions.iPixelHeight > 0)
+        {
+            fn_setDimension(oView, stEntry, static_cast<uint32_t>(oOptions.iPixelHeight));
+        }
+    }
+
+    if (stExifIfd && oOptions.bStripMakerNote)
+    {
+        size_t stEntry = fn_findEntry(oView, stExifIfd, uTAG_MAKER_NOTE);
+        if (stEntry)
+        {
+            fn_wipeValue(oView, stEntry);
+            fn_removeEntry(oView, stExifIfd, stEntry);
+        }
+    }
+
+    if (oOptions.bStripGps)
+    {
+        size_t stEntry = fn_findEntry(oView, stIfd0, uTAG_GPS_IFD);
+        if (stEntry)
+        {
+            fn_wipeIfd(oView, oView.fn_get32(stEntry + 8));
+            fn_removeEntry(oView, stIfd0, stEntry);
+        }
+    }
+
+    return true;
+} // End Function fn_editExif
+
+// Edit a TIFF/EXIF block held in a vector
+bool fn_editExif(std::vector<unsigned char>& vExif, const sExifEditOptions& oOptions)
+{
+    if (vExif.empty() || !fn_isExifEditRequested(oOptions))
+    {
+        return true;
+    }
+    if (fn_editExif(vExif.data(), vExif.size(), oOptions))
+    {
+        return true;
+    }
+    if (oOptions.bStripGps)
+    {
+        vExif.clear();
+    }
+    return false;
+} // End Function fn_editExif
+
+// Read IFD0 and its Exif and GPS IFDs
+bool fn_readExifDirectories(const unsigned char* pData, size_t stSize, sExifDirectories& oDirectories)
+{
+    oDirectories = sExifDirectories();
+    size_t stTiff = 0;
+    if (!pData || !fn_findTiffHeader(pData, stSize, stTiff))
+    {
+        return false;
+    }
+
+    // The view is only read here
+    sTiffView oView;
+    oView.pTiff = const_cast<unsigned char*>(pData) + stTiff;
+    oView.stSize = stSize - stTiff;
+    oView.bLittle = oView.pTiff[0] == 'I';
+
+    size_t stIfd0 = oView.fn_get32(4);
+    if (!fn_isValidIfd(oView, stIfd0))
+    {
+        return false;
+    }
+    fn_readIfd(oView, stIfd0, oDirectories.vIfd0);
+
+    size_t stEntry = fn_findEntry(oView, stIfd0, uTAG_EXIF_IFD);
+    if (stEntry && fn_isValidIfd(oView, oView.fn_get32(stEntry + 8)))
+    {
+        fn_readIfd(oView, oView.fn_get32(stEntry + 8), oDirectories.vExif);
+    }
+    stEntry = fn_findEntry(oView, stIfd0, uTAG_GPS_IFD);
+    if (stEntry && fn_isValidIfd(oView, oView.fn_get32(stEntry + 8)))
+    {
+        fn_readIfd(oView, oView.fn_get32(stEntry + 8), oDirectories.vGps);
+    }
+    return true;
+} // End Function fn_readExifDirectories
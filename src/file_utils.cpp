@@ -12,6 +12,8 @@
 #include <fstream>
 #include <utime.h>
 #include "logger.h"
+#include "directory_walker.h"
+#include <mutex>
 
 bool fn_fileExists(const std::string& sPath) // Local Function
  { // Start Function fn_fileExists
@@ -363,61 +365,21 @@ bool fn_isHeicFile(const std::string& sFilePath)
 } // End Function fn_isHeicFile
 
 // Function: fn_collectDirectoryFiles
-std::vector<std::string> fn_collectDirectoryFiles(const std::string& sDirectory, bool bRecursive)
+std::vector<std::string> fn_collectDirectoryFiles(const std::string& sDirectory, bool bRecursive, int iThreads)
 {
     std::vector<std::string> vsFiles;
+    std::mutex oFilesMutex;
     
-    if (!fn_isDirectory(sDirectory))
-    {
-        fn_logError("Directory does not exist: " + sDirectory);
-        return vsFiles;
-    }
-    
-    if (!bRecursive)
-    {
-        // Non-recursive: just get files in this directory
-        vsFiles = fn_getFilesInDirectory(sDirectory);
-    }
-    else
-    {
-        // Recursive: walk through directory tree
-        // We need to implement this manually since we're using dirent
-        std::vector<std::string> vsDirectories;
-        vsDirectories.push_back(sDirectory);
-        
-        for (size_t i = 0; i < vsDirectories.size(); ++i)
+    // One read per directory, subdirectories in parallel
+    fn_walkDirectory(sDirectory, bRecursive, iThreads, fnWalkFilter(),
+        [&vsFiles, &oFilesMutex](const std::string& sPath)
         {
-            std::string sCurrentDir = vsDirectories[i];
-            
-            // Get files in current directory
-            std::vector<std::string> vsCurrentFiles = fn_getFilesInDirectory(sCurrentDir);
-            vsFiles.insert(vsFiles.end(), vsCurrentFiles.begin(), vsCurrentFiles.end());
-            
-            // Get subdirectories
-            DIR* pDir = opendir(sCurrentDir.c_str());
-            if (pDir)
-            {
-                struct dirent* pEntry;
-                while ((pEntry = readdir(pDir)) != nullptr)
-                {
-                    if (pEntry->d_type == DT_DIR)
-                    {
-                        std::string sName = pEntry->d_name;
-                        if (sName != "." && sName != "..")
-                        {
-                            std::string sSubDir = sCurrentDir + "/" + sName;
-                            if (fn_isDirectory(sSubDir))
-                            {
-                                vsDirectories.push_back(sSubDir);
-                            }
-                        }
-                    }
-                }
-                closedir(pDir);
-            }
-        }
-    }
+            std::lock_guard<std::mutex> oLock(oFilesMutex);
+            vsFiles.push_back(sPath);
+        });
     
+    // Walker threads finish in any order; callers expect a stable list
+    std::sort(vsFiles.begin(), vsFiles.end());
     return vsFiles;
 } // End Function fn_collectDirectoryFiles
 
@@ -1,13 +1,23 @@
 // format_encoder.cpp - Updated for metadata writing
 #include "format_encoder.h"
 #include "logger.h"
+#include "image_buffer.h"
+#include "pixel_kernels.h"
+#include "output_file.h"
+#include "exif_editor.h"
+#include "png_writer.h"
+#include "thread_pool.h"
 #include <vector>
 #include <string>
 #include <cstring>
 #include <fstream>
 #include <cstdio>
+#include <algorithm>
+#include <unistd.h>
 
 // External libraries (system installed)
+#include <zlib.h>
+
 #ifdef HAVE_PNG
 #include <png.h>
 #endif
@@ -19,6 +29,9 @@
 
 #ifdef HAVE_WEBP
 #include <webp/encode.h>
+#ifdef HAVE_WEBPMUX
+#include <webp/mux.h>
+#endif
 #endif
 
 #ifdef HAVE_TIFF
@@ -42,10 +55,507 @@ FormatEncoder::~FormatEncoder() {
 }
 // End Destructor
 
-// Main encoding function
-bool FormatEncoder::fn_encodeImage(
+// Describe an ImageBuffer for the encoders
+sImageData fn_makeImageData(const ImageBuffer& oBuffer) {
+    sImageData oImageData;
+    oImageData.pData = oBuffer.fn_getData();
+    oImageData.iWidth = oBuffer.fn_getWidth();
+    oImageData.iHeight = oBuffer.fn_getHeight();
+    oImageData.iChannels = oBuffer.fn_getChannels();
+    oImageData.iBitDepth = oBuffer.fn_getBitDepth();
+    oImageData.stStride = oBuffer.fn_getStride();
+    return oImageData;
+}
+// End Function fn_makeImageData
+
+// Row stride of an image, defaulting to tightly packed rows
+size_t fn_getImageStride(const sImageData& oImageData) {
+    if (oImageData.stStride > 0) {
+        return oImageData.stStride;
+    }
+    int iBytesPerSample = oImageData.iBitDepth > 8 ? 2 : 1;
+    return static_cast<size_t>(oImageData.iWidth) * oImageData.iChannels * iBytesPerSample;
+}
+// End Function fn_getImageStride
+
+// Present a whole frame as a single-band stream
+sImageStream fn_makeImageStream(const sImageData& oImageData) {
+    sImageStream oStream;
+    oStream.iWidth = oImageData.iWidth;
+    oStream.iHeight = oImageData.iHeight;
+    oStream.iChannels = oImageData.iChannels;
+    oStream.iBitDepth = oImageData.iBitDepth;
+    
+    ImageBuffer oFrame = ImageBuffer::fn_wrap(oImageData.pData, oImageData.iWidth, oImageData.iHeight,
+                                              fn_getImageStride(oImageData), oImageData.iChannels,
+                                              oImageData.iBitDepth, nullptr);
+    oStream.fnNextBand = [oFrame](ImageBuffer& oBand) {
+        oBand = oFrame;
+        return !oBand.fn_isEmpty();
+    };
+    return oStream;
+}
+// End Function fn_makeImageStream
+
+// Parse a TIFF compression name
+bool fn_parseTiffCompression(const std::string& sName, eTiffCompression& eCompression) {
+    if (sName == "none") {
+        eCompression = eTiffCompression::None;
+    }
+    else if (sName == "lzw") {
+        eCompression = eTiffCompression::Lzw;
+    }
+    else if (sName == "deflate" || sName == "zip") {
+        eCompression = eTiffCompression::Deflate;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+// End Function fn_parseTiffCompression
+
+// Name of a TIFF compression scheme
+std::string fn_getTiffCompressionName(eTiffCompression eCompression) {
+    switch (eCompression) {
+        case eTiffCompression::None:
+            return "none";
+        case eTiffCompression::Lzw:
+            return "lzw";
+        default:
+            return "deflate";
+    }
+}
+// End Function fn_getTiffCompressionName
+
+// Encoder options from the per-format settings every conversion path shares
+sEncodeOptions fn_makeEncodeOptions(const std::string& sFormat, int iQuality, int iThreads,
+                                    const sOutputOptions& oOutput, const sWebPOptions& oWebP,
+                                    const sPngOptions& oPng, const sJpegOptions& oJpeg,
+                                    const sTiffOptions& oTiff) {
+    sEncodeOptions oOptions;
+    oOptions.sFormat = sFormat;
+    oOptions.iQuality = iQuality;
+    oOptions.iThreads = std::max(1, iThreads);
+    oOptions.oOutput = oOutput;
+    oOptions.oWebP = oWebP;
+    oOptions.oJpeg = oJpeg;
+    oOptions.oTiff = oTiff;
+    
+    std::string sLowerFormat = sFormat;
+    std::transform(sLowerFormat.begin(), sLowerFormat.end(), sLowerFormat.begin(), ::tolower);
+    if (sLowerFormat == "png") {
+        oOptions.iCompressionLevel = oPng.iCompressionLevel;
+        oOptions.bFastFilter = oPng.bFast;
+        oOptions.bInterlace = false;
+    } else if (sLowerFormat == "jpg" || sLowerFormat == "jpeg") {
+        oOptions.bProgressive = false;
+    }
+    
+    return oOptions;
+}
+// End Function fn_makeEncodeOptions
+
+// Whether an output format carries EXIF, XMP and ICC data
+bool fn_formatCarriesMetadata(const std::string& sFormat) {
+    std::string sLowerFormat = sFormat;
+    std::transform(sLowerFormat.begin(), sLowerFormat.end(), sLowerFormat.begin(), ::tolower);
+    return sLowerFormat == "jpg" || sLowerFormat == "jpeg" || sLowerFormat == "webp" ||
+           sLowerFormat == "png" || sLowerFormat == "tiff" || sLowerFormat == "tif";
+}
+// End Function fn_formatCarriesMetadata
+
+namespace {
+    // Pull bands from a stream and hand each row to fnWriteRow in order
+    bool fn_forEachStreamRow(const sImageStream& oStream,
+                             const std::function<bool(const unsigned char*)>& fnWriteRow) {
+        ImageBuffer oBand;
+        int iRow = 0;
+        
+        while (iRow < oStream.iHeight) {
+            if (!oStream.fnNextBand || !oStream.fnNextBand(oBand) || oBand.fn_isEmpty() ||
+                oBand.fn_getWidth() != oStream.iWidth || oBand.fn_getChannels() != oStream.iChannels) {
+                fn_logError("Image stream ended early at row " + std::to_string(iRow));
+                return false;
+            }
+            
+            int iRows = std::min(oBand.fn_getHeight(), oStream.iHeight - iRow);
+            for (int r = 0; r < iRows; r++) {
+                if (!fnWriteRow(oBand.fn_getRow(r))) {
+                    return false;
+                }
+            }
+            iRow += iRows;
+        }
+        
+        return true;
+    }
+    // End Function fn_forEachStreamRow
+    
+    #ifdef HAVE_JPEG
+    // Reduce a row to 8-bit grey or RGB for formats without alpha: high bit
+    // depths are narrowed and alpha is composited over white. Rows that need
+    // neither are returned as they are.
+    const unsigned char* fn_flattenRow(const unsigned char* pRow, int iWidth, int iChannels, int iBitDepth,
+                                       std::vector<unsigned char>& vScratch) {
+        static const uint8_t aWHITE[3] = {255, 255, 255};
+        bool bAlpha = iChannels == 2 || iChannels == 4;
+        if (iBitDepth <= 8 && !bAlpha) {
+            return pRow;
+        }
+        
+        size_t stSamples = static_cast<size_t>(iWidth) * iChannels;
+        vScratch.resize(stSamples * 2);
+        const unsigned char* pSamples = pRow;
+        if (iBitDepth > 8) {
+            fn_narrowTo8(reinterpret_cast<const uint16_t*>(pRow), vScratch.data(), stSamples, iBitDepth);
+            pSamples = vScratch.data();
+        }
+        if (iChannels == 4) {
+            fn_blendOverBackground(pSamples, vScratch.data() + stSamples, iWidth, aWHITE);
+            return vScratch.data() + stSamples;
+        }
+        if (iChannels == 2) {
+            // Grey over white: premultiplied grey plus the uncovered part
+            unsigned char* pPremultiplied = vScratch.data() + stSamples;
+            unsigned char* pGrey = vScratch.data();
+            fn_premultiplyAlpha(pSamples, pPremultiplied, iWidth, 2);
+            fn_extractGrey(pPremultiplied, pGrey, iWidth, 2);
+            for (int x = 0; x < iWidth; x++) {
+                pGrey[x] = static_cast<unsigned char>(pGrey[x] + (255 - pPremultiplied[x * 2 + 1]));
+            }
+            return pGrey;
+        }
+        return pSamples;
+    }
+    // End Function fn_flattenRow
+    #endif
+    
+    // Rough encoded size, only used to preallocate the output file
+    uint64_t fn_estimateEncodedBytes(int iWidth, int iHeight, int iChannels, int iBitDepth,
+                                     const std::string& sFormat) {
+        uint64_t ullRaw = static_cast<uint64_t>(iWidth) * iHeight * iChannels * (iBitDepth > 8 ? 2 : 1);
+        if (sFormat == "bmp") {
+            return 54 + static_cast<uint64_t>((iWidth * iChannels + 3) / 4 * 4) * iHeight;
+        }
+        if (sFormat == "tiff" || sFormat == "tif") {
+            return ullRaw;
+        }
+        if (sFormat == "png") {
+            return ullRaw / 2;
+        }
+        return ullRaw / 8;
+    }
+    // End Function fn_estimateEncodedBytes
+    
+    // Run fnEncode on the buffered stream of a temporary output file; the
+    // file appears at sOutputPath only once the encode has succeeded
+    bool fn_encodeToOutputFile(const std::string& sOutputPath, uint64_t ullSizeHint, const sOutputOptions& oOutput,
+                               const std::function<bool(FILE*)>& fnEncode) {
+        OutputFile oFile;
+        if (!oFile.fn_open(sOutputPath, ullSizeHint) || !oFile.fn_getStream()) {
+            fn_logError("Cannot open file for writing: " + oFile.fn_getLastError());
+            return false;
+        }
+        
+        if (!fnEncode(oFile.fn_getStream())) {
+            return false;
+        }
+        
+        if (!oFile.fn_commit(oOutput)) {
+            fn_logError("Failed to finish writing: " + oFile.fn_getLastError());
+            return false;
+        }
+        return true;
+    }
+    // End Function fn_encodeToOutputFile
+    
+    #ifdef HAVE_JPEG
+    const unsigned int uMAX_MARKER_BYTES = 65533;
+    
+    bool fn_startsWith(const std::vector<unsigned char>& vData, const char* pPrefix, size_t stLength) {
+        return vData.size() >= stLength && memcmp(vData.data(), pPrefix, stLength) == 0;
+    }
+    // End Function fn_startsWith
+    
+    void fn_writeMarker(j_compress_ptr pCInfo, int iMarker, const unsigned char* pHeader, size_t stHeader,
+                        const unsigned char* pData, size_t stData) {
+        jpeg_write_m_header(pCInfo, iMarker, static_cast<unsigned int>(stHeader + stData));
+        for (size_t i = 0; i < stHeader; i++) {
+            jpeg_write_m_byte(pCInfo, pHeader[i]);
+        }
+        for (size_t i = 0; i < stData; i++) {
+            jpeg_write_m_byte(pCInfo, pData[i]);
+        }
+    }
+    // End Function fn_writeMarker
+    
+    // Start compression and write the metadata APP segments straight after
+    // SOI, so the file is complete in one pass (no re-read or rewrite)
+    void fn_startJpegWithMetadata(j_compress_ptr pCInfo, const sEncodeOptions& oOptions) {
+        bool bMetadata = oOptions.bPreserveMetadata;
+        bool bExif = bMetadata && !oOptions.vExifData.empty();
+        
+        // Exif files carry APP1 first, without a JFIF APP0
+        if (bExif) {
+            pCInfo->write_JFIF_header = FALSE;
+        }
+        jpeg_start_compress(pCInfo, TRUE);
+        if (!bMetadata) {
+            return;
+        }
+        
+        // APP1 Exif
+        if (bExif) {
+            static const unsigned char aEXIF_HEADER[6] = {'E', 'x', 'i', 'f', 0, 0};
+            size_t stHeader = fn_startsWith(oOptions.vExifData, "Exif\0\0", 6) ? 0 : 6;
+            if (stHeader + oOptions.vExifData.size() <= uMAX_MARKER_BYTES) {
+                fn_writeMarker(pCInfo, JPEG_APP0 + 1, aEXIF_HEADER, stHeader,
+                               oOptions.vExifData.data(), oOptions.vExifData.size());
+            } else {
+                fn_logWarning("EXIF block too large for one APP1 segment, skipped");
+            }
+        }
+        
+        // APP1 XMP (standard packet only; extended XMP is not split)
+        if (!oOptions.vXmpData.empty()) {
+            static const char aXMP_HEADER[] = "http://ns.adobe.com/xap/1.0/";
+            size_t stHeader = sizeof(aXMP_HEADER);  // Includes the terminating NUL
+            if (stHeader + oOptions.vXmpData.size() <= uMAX_MARKER_BYTES) {
+                fn_writeMarker(pCInfo, JPEG_APP0 + 1, reinterpret_cast<const unsigned char*>(aXMP_HEADER), stHeader,
+                               oOptions.vXmpData.data(), oOptions.vXmpData.size());
+            } else {
+                fn_logWarning("XMP packet too large for one APP1 segment, skipped");
+            }
+        }
+        
+        // APP2 ICC, split into numbered chunks
+        if (!oOptions.vIccProfile.empty()) {
+            const size_t stChunk = uMAX_MARKER_BYTES - 14;
+            size_t stCount = (oOptions.vIccProfile.size() + stChunk - 1) / stChunk;
+            if (stCount <= 255) {
+                for (size_t i = 0; i < stCount; i++) {
+                    unsigned char aHeader[14] = {'I', 'C', 'C', '_', 'P', 'R', 'O', 'F', 'I', 'L', 'E', 0,
+                                                 static_cast<unsigned char>(i + 1), static_cast<unsigned char>(stCount)};
+                    size_t stOffset = i * stChunk;
+                    fn_writeMarker(pCInfo, JPEG_APP0 + 2, aHeader, sizeof(aHeader), oOptions.vIccProfile.data() + stOffset,
+                                   std::min(stChunk, oOptions.vIccProfile.size() - stOffset));
+                }
+            } else {
+                fn_logWarning("ICC profile too large for APP2 segments, skipped");
+            }
+        }
+        
+        // APP13 IPTC inside a Photoshop IPTC-NAA resource (0x0404), unless
+        // the block is already a Photoshop resource
+        if (!oOptions.vIptcData.empty()) {
+            const std::vector<unsigned char>& vIptc = oOptions.vIptcData;
+            std::vector<unsigned char> vSegment;
+            if (!fn_startsWith(vIptc, "Photoshop 3.0", 13)) {
+                static const char aPHOTOSHOP[] = "Photoshop 3.0";
+                vSegment.assign(aPHOTOSHOP, aPHOTOSHOP + sizeof(aPHOTOSHOP));
+            }
+            if (!fn_startsWith(vIptc, "Photoshop 3.0", 13) && !fn_startsWith(vIptc, "8BIM", 4)) {
+                uint32_t uSize = static_cast<uint32_t>(vIptc.size());
+                const unsigned char aResource[] = {'8', 'B', 'I', 'M', 0x04, 0x04, 0, 0,
+                                                   static_cast<unsigned char>(uSize >> 24), static_cast<unsigned char>(uSize >> 16),
+                                                   static_cast<unsigned char>(uSize >> 8), static_cast<unsigned char>(uSize)};
+                vSegment.insert(vSegment.end(), aResource, aResource + sizeof(aResource));
+                vSegment.insert(vSegment.end(), vIptc.begin(), vIptc.end());
+                if (uSize % 2) {
+                    vSegment.push_back(0);  // Resources are padded to even length
+                }
+            } else {
+                vSegment.insert(vSegment.end(), vIptc.begin(), vIptc.end());
+            }
+            
+            if (vSegment.size() <= uMAX_MARKER_BYTES) {
+                fn_writeMarker(pCInfo, JPEG_APP0 + 13, nullptr, 0, vSegment.data(), vSegment.size());
+            } else {
+                fn_logWarning("IPTC block too large for one APP13 segment, skipped");
+            }
+        }
+    }
+    // End Function fn_startJpegWithMetadata
+    
+    // Scanlines handed to libjpeg per call: one iMCU row of 4:2:0
+    const int iJPEG_SCANLINE_BATCH = 2 * DCTSIZE;
+    
+    // Feed a stream to libjpeg an iMCU row per call. Rows that are already
+    // 8-bit grey or RGB are passed in place, the rest are flattened into
+    // one scratch buffer per batch slot.
+    bool fn_writeJpegScanlines(j_compress_ptr pCInfo, const sImageStream& oStream) {
+        std::vector<unsigned char> avScratch[iJPEG_SCANLINE_BATCH];
+        JSAMPROW apRows[iJPEG_SCANLINE_BATCH];
+        ImageBuffer oBand;
+        int iRow = 0;
+        
+        while (iRow < oStream.iHeight) {
+            if (!oStream.fnNextBand || !oStream.fnNextBand(oBand) || oBand.fn_isEmpty() ||
+                oBand.fn_getWidth() != oStream.iWidth || oBand.fn_getChannels() != oStream.iChannels) {
+                fn_logError("Image stream ended early at row " + std::to_string(iRow));
+                return false;
+            }
+            
+            int iRows = std::min(oBand.fn_getHeight(), oStream.iHeight - iRow);
+            for (int r = 0; r < iRows; r += iJPEG_SCANLINE_BATCH) {
+                int iCount = std::min(iJPEG_SCANLINE_BATCH, iRows - r);
+                for (int i = 0; i < iCount; i++) {
+                    apRows[i] = const_cast<JSAMPROW>(fn_flattenRow(oBand.fn_getRow(r + i), oStream.iWidth,
+                                                                   oStream.iChannels, oStream.iBitDepth, avScratch[i]));
+                }
+                if (jpeg_write_scanlines(pCInfo, apRows, iCount) != static_cast<JDIMENSION>(iCount)) {
+                    fn_logError("Failed to write JPEG scanlines at row " + std::to_string(iRow + r));
+                    return false;
+                }
+            }
+            iRow += iRows;
+        }
+        return true;
+    }
+    // End Function fn_writeJpegScanlines
+    
+    // Strips pay off only with workers to spare and a baseline scan
+    bool fn_useJpegStrips(const sEncodeOptions& oOptions, int iHeight, int iMcuHeight) {
+        return oOptions.oJpeg.bParallelStrips && oOptions.iThreads > 1 && !oOptions.bProgressive &&
+               iHeight >= 2 * iMcuHeight;
+    }
+    // End Function fn_useJpegStrips
+    
+    // Options for one strip: a restart marker every iMCU row, and the
+    // metadata only in the strip whose headers are kept
+    sEncodeOptions fn_makeJpegStripOptions(const sEncodeOptions& oOptions, bool bFirst) {
+        sEncodeOptions oStripOptions = oOptions;
+        oStripOptions.oJpeg.bParallelStrips = false;
+        oStripOptions.oJpeg.iRestartRows = 1;
+        oStripOptions.iThreads = 1;
+        oStripOptions.bPreserveMetadata = bFirst && oOptions.bPreserveMetadata;
+        return oStripOptions;
+    }
+    // End Function fn_makeJpegStripOptions
+    
+    // One strip encoded as a complete JPEG
+    struct sJpegStrip {
+        std::vector<unsigned char> vData;
+        size_t stSofHeight = 0;   // Offset of the frame height in SOF0/SOF1
+        size_t stScanStart = 0;   // First entropy-coded byte after the SOS header
+        bool bOk = false;
+    };
+    
+    // Locate the frame height and the scan data of a strip
+    bool fn_parseJpegStrip(sJpegStrip& oStrip) {
+        const std::vector<unsigned char>& vData = oStrip.vData;
+        if (vData.size() < 4 || vData[0] != 0xFF || vData[1] != 0xD8 ||
+            vData[vData.size() - 2] != 0xFF || vData[vData.size() - 1] != 0xD9) {
+            return false;
+        }
+        
+        size_t stPos = 2;
+        while (stPos + 4 <= vData.size() && vData[stPos] == 0xFF) {
+            unsigned char uMarker = vData[stPos + 1];
+            size_t stLength = (static_cast<size_t>(vData[stPos + 2]) << 8) | vData[stPos + 3];
+            if (uMarker == 0xC0 || uMarker == 0xC1) {
+                oStrip.stSofHeight = stPos + 5;
+            }
+            stPos += 2 + stLength;
+            if (uMarker == 0xDA) {
+                oStrip.stScanStart = stPos;
+                return oStrip.stSofHeight > 0 && stPos + 2 <= vData.size();
+            }
+        }
+        return false;
+    }
+    // End Function fn_parseJpegStrip
+    
+    // Write a strip's scan data with its restart markers renumbered to
+    // follow on from the strips before it (0xFF in entropy data is always
+    // stuffed, so FF D0-D7 can only be a marker)
+    bool fn_writeJpegScan(sJpegStrip& oStrip, size_t stFrom, int& iRestart, FILE* fp) {
+        unsigned char* pData = oStrip.vData.data();
+        size_t stEnd = oStrip.vData.size() - 2;
+        for (size_t i = oStrip.stScanStart; i + 1 < stEnd; i++) {
+            if (pData[i] == 0xFF && pData[i + 1] >= 0xD0 && pData[i + 1] <= 0xD7) {
+                pData[i + 1] = static_cast<unsigned char>(0xD0 + (iRestart++ & 7));
+                i++;
+            }
+        }
+        return fwrite(pData + stFrom, 1, stEnd - stFrom, fp) == stEnd - stFrom;
+    }
+    // End Function fn_writeJpegScan
+    
+    // Encode iHeight rows as strips of whole iMCU rows, one per worker, and
+    // splice them into one baseline JPEG: strip 0 supplies the headers with
+    // the full height patched in, later strips only their scan data, and a
+    // restart marker joins each pair. The DC predictors reset at every
+    // restart, so each strip's entropy-coded segments are valid as they
+    // stand. fnEncodeStrip writes rows [iBegin, iEnd) as a complete JPEG
+    // with a restart marker every iMCU row (fn_makeJpegStripOptions).
+    bool fn_encodeJpegStrips(FILE* fp, int iHeight, int iMcuHeight, int iThreads,
+                             const std::function<bool(int, int, FILE*)>& fnEncodeStrip) {
+        int iMcuRows = (iHeight + iMcuHeight - 1) / iMcuHeight;
+        int iStripRows = (iMcuRows + iThreads - 1) / iThreads * iMcuHeight;
+        int iStrips = (iHeight + iStripRows - 1) / iStripRows;
+        if (iHeight > 0xFFFF) {
+            fn_logError("JPEG height exceeds 65535 rows");
+            return false;
+        }
+        
+        std::vector<sJpegStrip> vStrips(iStrips);
+        TaskGroup oStrips(iStrips);
+        for (int k = 0; k < iStrips; k++) {
+            sJpegStrip* pStrip = &vStrips[k];
+            int iBegin = k * iStripRows;
+            int iEnd = std::min(iHeight, iBegin + iStripRows);
+            oStrips.fn_submit([pStrip, iBegin, iEnd, &fnEncodeStrip]() {
+                char* pBuffer = nullptr;
+                size_t stSize = 0;
+                FILE* pMemory = open_memstream(&pBuffer, &stSize);
+                bool bOk = pMemory && fnEncodeStrip(iBegin, iEnd, pMemory);
+                if (pMemory) {
+                    fclose(pMemory);
+                }
+                if (bOk && pBuffer) {
+                    pStrip->vData.assign(reinterpret_cast<unsigned char*>(pBuffer),
+                                         reinterpret_cast<unsigned char*>(pBuffer) + stSize);
+                }
+                free(pBuffer);
+                pStrip->bOk = bOk && fn_parseJpegStrip(*pStrip);
+            });
+        }
+        oStrips.fn_wait();
+        
+        for (int k = 0; k < iStrips; k++) {
+            if (!vStrips[k].bOk) {
+                fn_logError("Failed to encode JPEG strip " + std::to_string(k + 1) + " of " + std::to_string(iStrips));
+                return false;
+            }
+        }
+        
+        sJpegStrip& oFirst = vStrips[0];
+        oFirst.vData[oFirst.stSofHeight] = static_cast<unsigned char>(iHeight >> 8);
+        oFirst.vData[oFirst.stSofHeight + 1] = static_cast<unsigned char>(iHeight & 0xFF);
+        
+        int iRestart = 0;
+        bool bOk = fn_writeJpegScan(oFirst, 0, iRestart, fp);
+        for (int k = 1; k < iStrips && bOk; k++) {
+            const unsigned char aRestart[2] = {0xFF, static_cast<unsigned char>(0xD0 + (iRestart++ & 7))};
+            bOk = fwrite(aRestart, 1, 2, fp) == 2 &&
+                  fn_writeJpegScan(vStrips[k], vStrips[k].stScanStart, iRestart, fp);
+        }
+        static const unsigned char aEOI[2] = {0xFF, 0xD9};
+        bOk = bOk && fwrite(aEOI, 1, 2, fp) == 2;
+        if (!bOk) {
+            fn_logError("Failed to write JPEG strips");
+        }
+        return bOk;
+    }
+    // End Function fn_encodeJpegStrips
+    #endif
+}
+
+// Validate image data and options
+bool FormatEncoder::fn_validateInput(
     const sImageData& oImageData,
-    const std::string& sOutputPath,
     const sEncodeOptions& oOptions
 ) {
     // Validate input
@@ -70,6 +580,20 @@ bool FormatEncoder::fn_encodeImage(
         return false;
     }
     
+    return true;
+}
+// End Function fn_validateInput
+
+// Main encoding function
+bool FormatEncoder::fn_encodeImage(
+    const sImageData& oImageData,
+    const std::string& sOutputPath,
+    const sEncodeOptions& oOptions
+) {
+    if (!fn_validateInput(oImageData, oOptions)) {
+        return false;
+    }
+    
     // Route to appropriate encoder
     std::string sFormatLower = oOptions.sFormat;
     for (char& c : sFormatLower) {
@@ -86,11 +610,7 @@ bool FormatEncoder::fn_encodeImage(
         }
     }
     else if (sFormatLower == "jpg" || sFormatLower == "jpeg") {
-        if (oOptions.bPreserveMetadata && !oOptions.vExifData.empty()) {
-            bSuccess = fn_writeJpegWithMetadata(oImageData, sOutputPath, oOptions);
-        } else {
-            bSuccess = fn_encodeJPEG(oImageData, sOutputPath, oOptions);
-        }
+        bSuccess = fn_encodeJPEG(oImageData, sOutputPath, oOptions);
     }
     else if (sFormatLower == "webp") {
         bSuccess = fn_encodeWebP(oImageData, sOutputPath, oOptions);
@@ -117,155 +637,305 @@ bool FormatEncoder::fn_encodeImage(
 }
 // End Function fn_encodeImage
 
-// Get supported formats
-std::vector<std::string> FormatEncoder::fn_getSupportedFormats() {
-    std::vector<std::string> vsFormats;
+// Check whether a format can be encoded to memory
+bool FormatEncoder::fn_supportsMemoryOutput(const std::string& sFormat) {
+    std::string sFormatLower = sFormat;
+    for (char& c : sFormatLower) {
+        c = std::tolower(c);
+    }
     
-    if (bPNGSupported) {
-        vsFormats.push_back("png");
+    if (!fn_validateFormat(sFormatLower)) {
+        return false;
     }
     
-    if (bJPEGSupported) {
-        vsFormats.push_back("jpg");
-        vsFormats.push_back("jpeg");
+    return sFormatLower != "tiff" && sFormatLower != "tif";
+}
+// End Function fn_supportsMemoryOutput
+
+// Encode into a memory buffer
+bool FormatEncoder::fn_encodeToMemory(
+    const sImageData& oImageData,
+    const sEncodeOptions& oOptions,
+    std::vector<unsigned char>& vOutput
+) {
+    vOutput.clear();
+    
+    if (!fn_validateInput(oImageData, oOptions)) {
+        return false;
     }
     
-    if (bWebPSupported) {
-        vsFormats.push_back("webp");
+    std::string sFormatLower = oOptions.sFormat;
+    for (char& c : sFormatLower) {
+        c = std::tolower(c);
     }
     
-    if (bBMPSupported) {
-        vsFormats.push_back("bmp");
+    if (!fn_supportsMemoryOutput(sFormatLower)) {
+        fn_logError("Format cannot be encoded to memory: " + oOptions.sFormat);
+        return false;
     }
     
-    if (bTIFFSupported) {
-        vsFormats.push_back("tiff");
-        vsFormats.push_back("tif");
+    // open_memstream lets the stdio-based encoders write into a growing buffer
+    char* pBuffer = nullptr;
+    size_t stSize = 0;
+    FILE* fp = open_memstream(&pBuffer, &stSize);
+    if (!fp) {
+        fn_logError("Failed to open memory stream for encoding");
+        return false;
     }
     
-    return vsFormats;
+    bool bSuccess = fn_encodeToStream(oImageData, fp, oOptions, sFormatLower);
+    fclose(fp);
+    
+    if (bSuccess && pBuffer) {
+        vOutput.assign(reinterpret_cast<unsigned char*>(pBuffer),
+                       reinterpret_cast<unsigned char*>(pBuffer) + stSize);
+    }
+    
+    free(pBuffer);
+    return bSuccess && !vOutput.empty();
 }
-// End Function fn_getSupportedFormats
+// End Function fn_encodeToMemory
 
-// Validate output format
-bool FormatEncoder::fn_validateFormat(const std::string& sFormat) {
+// Route a stream-capable format to its encoder
+bool FormatEncoder::fn_encodeToStream(
+    const sImageData& oImageData,
+    FILE* fp,
+    const sEncodeOptions& oOptions,
+    const std::string& sFormatLower
+) {
+    if (sFormatLower == "png") {
+        return fn_encodePNGToStream(oImageData, fp, oOptions);
+    }
+    else if (sFormatLower == "jpg" || sFormatLower == "jpeg") {
+        return fn_encodeJPEGToStream(oImageData, fp, oOptions);
+    }
+    else if (sFormatLower == "webp") {
+        return fn_encodeWebPToStream(oImageData, fp, oOptions);
+    }
+    else if (sFormatLower == "bmp") {
+        return fn_encodeBMPToStream(oImageData, fp, oOptions);
+    }
+    
+    fn_logError("Format has no stream encoder: " + sFormatLower);
+    return false;
+}
+// End Function fn_encodeToStream
+
+// Check whether a format is written without a full frame
+bool FormatEncoder::fn_supportsStreaming(const std::string& sFormat) {
     std::string sFormatLower = sFormat;
     for (char& c : sFormatLower) {
         c = std::tolower(c);
     }
     
-    if (sFormatLower == "png" && bPNGSupported) {
-        return true;
+    if (!fn_validateFormat(sFormatLower)) {
+        return false;
     }
-    else if ((sFormatLower == "jpg" || sFormatLower == "jpeg") && bJPEGSupported) {
-        return true;
+    
+    return sFormatLower == "jpg" || sFormatLower == "jpeg" || sFormatLower == "png" ||
+           sFormatLower == "tiff" || sFormatLower == "tif";
+}
+// End Function fn_supportsStreaming
+
+// Gather the bands of a stream into one frame
+bool FormatEncoder::fn_collectStream(const sImageStream& oStream, ImageBuffer& oFrame) {
+    ImageBuffer oBand;
+    if (!oStream.fnNextBand || !oStream.fnNextBand(oBand) || oBand.fn_isEmpty()) {
+        fn_logError("Image stream is empty");
+        return false;
     }
-    else if (sFormatLower == "webp" && bWebPSupported) {
+    
+    // Whole frame in one band: use it as is
+    if (oBand.fn_getHeight() >= oStream.iHeight) {
+        oFrame = oBand;
         return true;
     }
-    else if (sFormatLower == "bmp" && bBMPSupported) {
-        return true;
+    
+    oFrame = ImageBuffer::fn_allocate(oStream.iWidth, oStream.iHeight, oStream.iChannels, oStream.iBitDepth);
+    if (oFrame.fn_isEmpty()) {
+        fn_logError("Failed to allocate frame for stream");
+        return false;
     }
-    else if ((sFormatLower == "tiff" || sFormatLower == "tif") && bTIFFSupported) {
-        return true;
+    
+    size_t stRowBytes = oFrame.fn_getRowBytes();
+    int iRow = 0;
+    for (int r = 0; r < oBand.fn_getHeight(); r++) {
+        memcpy(oFrame.fn_getRow(iRow++), oBand.fn_getRow(r), stRowBytes);
     }
     
-    return false;
+    ImageBuffer* pFrame = &oFrame;
+    sImageStream oRest = oStream;
+    oRest.iHeight = oStream.iHeight - iRow;
+    return fn_forEachStreamRow(oRest, [pFrame, &iRow, stRowBytes](const unsigned char* pRow) {
+        memcpy(pFrame->fn_getRow(iRow++), pRow, stRowBytes);
+        return true;
+    });
 }
-// End Function fn_validateFormat
+// End Function fn_collectStream
 
-// JPEG encoding function with metadata support
-bool FormatEncoder::fn_encodeJPEG(
-    const sImageData& oImageData,
+// Encode an image that arrives band by band
+bool FormatEncoder::fn_encodeStream(
+    const sImageStream& oStream,
     const std::string& sOutputPath,
     const sEncodeOptions& oOptions
 ) {
-    #ifdef HAVE_JPEG
-    FILE* fp = fopen(sOutputPath.c_str(), "wb");
-    if (!fp) {
-        fn_logError("Cannot open file for writing: " + sOutputPath);
+    if (oStream.iWidth <= 0 || oStream.iHeight <= 0 || oStream.iChannels < 1 || oStream.iChannels > 4) {
+        fn_logError("Invalid image stream");
         return false;
     }
     
-    struct jpeg_compress_struct sCInfo;
-    struct jpeg_error_mgr sJErr;
+    if (!fn_validateFormat(oOptions.sFormat)) {
+        fn_logError("Unsupported format: " + oOptions.sFormat);
+        return false;
+    }
     
-    sCInfo.err = jpeg_std_error(&sJErr);
-    jpeg_create_compress(&sCInfo);
-    jpeg_stdio_dest(&sCInfo, fp);
+    std::string sFormatLower = oOptions.sFormat;
+    for (char& c : sFormatLower) {
+        c = std::tolower(c);
+    }
     
-    sCInfo.image_width = oImageData.iWidth;
-    sCInfo.image_height = oImageData.iHeight;
+    bool bSuccess = false;
     
-    if (oImageData.iChannels == 1) {
-        sCInfo.input_components = 1;
-        sCInfo.in_color_space = JCS_GRAYSCALE;
+    if (sFormatLower == "tiff" || sFormatLower == "tif") {
+        bSuccess = fn_encodeTIFFRows(oStream, sOutputPath, oOptions);
     }
-    else if (oImageData.iChannels == 3) {
-        sCInfo.input_components = 3;
-        sCInfo.in_color_space = JCS_RGB;
+    else if (sFormatLower == "jpg" || sFormatLower == "jpeg" || sFormatLower == "png") {
+        uint64_t ullSizeHint = fn_estimateEncodedBytes(oStream.iWidth, oStream.iHeight, oStream.iChannels,
+                                                       oStream.iBitDepth, sFormatLower);
+        bSuccess = fn_encodeToOutputFile(sOutputPath, ullSizeHint, oOptions.oOutput, [&](FILE* fp) {
+            return (sFormatLower == "png") ? fn_encodePNGRows(oStream, fp, oOptions)
+                                           : fn_encodeJPEGRows(oStream, fp, oOptions);
+        });
     }
     else {
-        jpeg_destroy_compress(&sCInfo);
-        fclose(fp);
-        fn_logError("JPEG only supports 1 (grayscale) or 3 (RGB) channels");
-        return false;
+        // WebP and BMP need the whole frame
+        ImageBuffer oFrame;
+        if (!fn_collectStream(oStream, oFrame)) {
+            return false;
+        }
+        return fn_encodeImage(fn_makeImageData(oFrame), sOutputPath, oOptions);
     }
     
-    jpeg_set_defaults(&sCInfo);
+    if (bSuccess) {
+        fn_logInfo("Successfully encoded image to: " + sOutputPath);
+    }
     
-    // Set quality
-    int iQuality = oOptions.iQuality;
-    if (iQuality < 1) iQuality = 1;
-    if (iQuality > 100) iQuality = 100;
-    jpeg_set_quality(&sCInfo, iQuality, TRUE);
+    return bSuccess;
+}
+// End Function fn_encodeStream
+
+// Get supported formats
+std::vector<std::string> FormatEncoder::fn_getSupportedFormats() {
+    std::vector<std::string> vsFormats;
     
-    // Set progressive if requested
-    if (oOptions.bProgressive) {
-        jpeg_simple_progression(&sCInfo);
+    if (bPNGSupported) {
+        vsFormats.push_back("png");
     }
     
-    jpeg_start_compress(&sCInfo, TRUE);
+    if (bJPEGSupported) {
+        vsFormats.push_back("jpg");
+        vsFormats.push_back("jpeg");
+    }
     
-    // Write EXIF metadata if present (for basic JPEG encoding)
-    if (!oOptions.vExifData.empty() && oOptions.bPreserveMetadata) {
-        // Note: This is a simplified approach
-        // For proper EXIF writing, we should use fn_writeJpegWithMetadata
-        fn_logInfo("EXIF data present, but using basic JPEG encoding");
+    if (bWebPSupported) {
+        vsFormats.push_back("webp");
     }
     
-    // Write scanlines
-    JSAMPROW pRowPointer[1];
-    int iRowStride = oImageData.iWidth * oImageData.iChannels;
+    if (bBMPSupported) {
+        vsFormats.push_back("bmp");
+    }
     
-    while (sCInfo.next_scanline < sCInfo.image_height) {
-        pRowPointer[0] = &oImageData.pData[sCInfo.next_scanline * iRowStride];
-        jpeg_write_scanlines(&sCInfo, pRowPointer, 1);
+    if (bTIFFSupported) {
+        vsFormats.push_back("tiff");
+        vsFormats.push_back("tif");
     }
     
-    jpeg_finish_compress(&sCInfo);
-    jpeg_destroy_compress(&sCInfo);
-    fclose(fp);
+    return vsFormats;
+}
+// End Function fn_getSupportedFormats
+
+// Validate output format
+bool FormatEncoder::fn_validateFormat(const std::string& sFormat) {
+    std::string sFormatLower = sFormat;
+    for (char& c : sFormatLower) {
+        c = std::tolower(c);
+    }
     
-    return true;
+    if (sFormatLower == "png" && bPNGSupported) {
+        return true;
+    }
+    else if ((sFormatLower == "jpg" || sFormatLower == "jpeg") && bJPEGSupported) {
+        return true;
+    }
+    else if (sFormatLower == "webp" && bWebPSupported) {
+        return true;
+    }
+    else if (sFormatLower == "bmp" && bBMPSupported) {
+        return true;
+    }
+    else if ((sFormatLower == "tiff" || sFormatLower == "tif") && bTIFFSupported) {
+        return true;
+    }
+    
+    return false;
+}
+// End Function fn_validateFormat
+
+// JPEG encoding function with metadata support
+bool FormatEncoder::fn_encodeJPEG(
+    const sImageData& oImageData,
+    const std::string& sOutputPath,
+    const sEncodeOptions& oOptions
+) {
+    #ifdef HAVE_JPEG
+    uint64_t ullSizeHint = fn_estimateEncodedBytes(oImageData.iWidth, oImageData.iHeight, oImageData.iChannels,
+                                                   oImageData.iBitDepth, "jpg");
+    return fn_encodeToOutputFile(sOutputPath, ullSizeHint, oOptions.oOutput, [&](FILE* fp) {
+        return fn_encodeJPEGToStream(oImageData, fp, oOptions);
+    });
     #else
+    (void)oImageData;
+    (void)sOutputPath;
+    (void)oOptions;
     fn_logError("JPEG support not compiled in");
     return false;
     #endif
 }
 // End Function fn_encodeJPEG
 
-// Add to format_encoder.cpp - Enhanced JPEG metadata writing
-bool FormatEncoder::fn_writeJpegWithMetadata(
+// JPEG stream encoder
+bool FormatEncoder::fn_encodeJPEGToStream(
     const sImageData& oImageData,
-    const std::string& sOutputPath,
+    FILE* fp,
+    const sEncodeOptions& oOptions
+) {
+    return fn_encodeJPEGRows(fn_makeImageStream(oImageData), fp, oOptions);
+}
+// End Function fn_encodeJPEGToStream
+
+// JPEG row encoder: scanlines are written as each band arrives
+bool FormatEncoder::fn_encodeJPEGRows(
+    const sImageStream& oImageData,
+    FILE* fp,
     const sEncodeOptions& oOptions
 ) {
     #ifdef HAVE_JPEG
-    FILE* fp = fopen(sOutputPath.c_str(), "wb");
-    if (!fp) {
-        fn_logError("Cannot open file for writing: " + sOutputPath);
-        return false;
+    // Opt-in: strips of the full frame on iThreads workers (grey has 8-row
+    // iMCUs, colour is 4:2:0 with 16)
+    int iMcuHeight = oImageData.iChannels <= 2 ? DCTSIZE : 2 * DCTSIZE;
+    if (fn_useJpegStrips(oOptions, oImageData.iHeight, iMcuHeight)) {
+        ImageBuffer oFrame;
+        if (!fn_collectStream(oImageData, oFrame)) {
+            return false;
+        }
+        return fn_encodeJpegStrips(fp, oImageData.iHeight, iMcuHeight, oOptions.iThreads,
+                                   [this, &oFrame, &oOptions](int iBegin, int iEnd, FILE* pStrip) {
+            sImageData oStripData = fn_makeImageData(oFrame);
+            oStripData.pData = oFrame.fn_getRow(iBegin);
+            oStripData.iHeight = iEnd - iBegin;
+            return fn_encodeJPEGRows(fn_makeImageStream(oStripData), pStrip,
+                                     fn_makeJpegStripOptions(oOptions, iBegin == 0));
+        });
     }
     
     struct jpeg_compress_struct sCInfo;
@@ -275,54 +945,69 @@ bool FormatEncoder::fn_writeJpegWithMetadata(
     jpeg_create_compress(&sCInfo);
     jpeg_stdio_dest(&sCInfo, fp);
     
-    // ... [rest of JPEG setup] ...
-    
-    jpeg_start_compress(&sCInfo, TRUE);
+    sCInfo.image_width = oImageData.iWidth;
+    sCInfo.image_height = oImageData.iHeight;
     
-    // Write EXIF metadata (APP1)
-    if (!oOptions.vExifData.empty() && oOptions.bPreserveMetadata) {
-        jpeg_write_marker(&sCInfo, JPEG_APP0 + 1, 
-                         oOptions.vExifData.data(), 
-                         static_cast<unsigned int>(oOptions.vExifData.size()));
+    // Alpha is composited over white and deep samples narrowed per row
+    if (oImageData.iChannels == 1 || oImageData.iChannels == 2) {
+        sCInfo.input_components = 1;
+        sCInfo.in_color_space = JCS_GRAYSCALE;
+    }
+    else if (oImageData.iChannels == 3 || oImageData.iChannels == 4) {
+        sCInfo.input_components = 3;
+        sCInfo.in_color_space = JCS_RGB;
+    }
+    else {
+        jpeg_destroy_compress(&sCInfo);
+        fn_logError("JPEG only supports 1 to 4 channels");
+        return false;
     }
     
-    // Write XMP metadata (APP1 with XMP identifier)
-    if (!oOptions.vXmpData.empty() && oOptions.bPreserveMetadata) {
-        // XMP requires special header
-        std::vector<unsigned char> xmpMarker;
-        std::string xmpHeader = "http://ns.adobe.com/xap/1.0/\0";
-        
-        xmpMarker.insert(xmpMarker.end(), 
-                         xmpHeader.begin(), xmpHeader.end());
-        xmpMarker.insert(xmpMarker.end(), 
-                         oOptions.vXmpData.begin(), oOptions.vXmpData.end());
-        
-        jpeg_write_marker(&sCInfo, JPEG_APP0 + 1, 
-                         xmpMarker.data(), 
-                         static_cast<unsigned int>(xmpMarker.size()));
+    jpeg_set_defaults(&sCInfo);
+    
+    // Set quality
+    int iQuality = oOptions.iQuality;
+    if (iQuality < 1) iQuality = 1;
+    if (iQuality > 100) iQuality = 100;
+    jpeg_set_quality(&sCInfo, iQuality, TRUE);
+    sCInfo.restart_in_rows = oOptions.oJpeg.iRestartRows;
+    
+    // Set progressive if requested
+    if (oOptions.bProgressive) {
+        jpeg_simple_progression(&sCInfo);
     }
     
-    // Write IPTC metadata (APP13)
-    if (!oOptions.vIptcData.empty() && oOptions.bPreserveMetadata) {
-        // IPTC requires Photoshop Application Record marker
-        std::vector<unsigned char> iptcMarker;
-        unsigned char photoshopHeader[] = "Photoshop 3.0\0";
-        
-        iptcMarker.insert(iptcMarker.end(), 
-                         photoshopHeader, photoshopHeader + sizeof(photoshopHeader));
-        iptcMarker.insert(iptcMarker.end(), 
-                         oOptions.vIptcData.begin(), oOptions.vIptcData.end());
-        
-        jpeg_write_marker(&sCInfo, JPEG_APP0 + 13, 
-                         iptcMarker.data(), 
-                         static_cast<unsigned int>(iptcMarker.size()));
+    fn_startJpegWithMetadata(&sCInfo, oOptions);
+    
+    if (!fn_writeJpegScanlines(&sCInfo, oImageData)) {
+        jpeg_abort_compress(&sCInfo);
+        jpeg_destroy_compress(&sCInfo);
+        return false;
     }
     
-    // Write image data...
+    jpeg_finish_compress(&sCInfo);
+    jpeg_destroy_compress(&sCInfo);
     
-    #endif
     return true;
+    #else
+    (void)oImageData;
+    (void)fp;
+    (void)oOptions;
+    fn_logError("JPEG support not compiled in");
+    return false;
+    #endif
 }
+// End Function fn_encodeJPEGRows
+
+// JPEG with metadata: the APP segments are part of every JPEG encode now
+bool FormatEncoder::fn_writeJpegWithMetadata(
+    const sImageData& oImageData,
+    const std::string& sOutputPath,
+    const sEncodeOptions& oOptions
+) {
+    return fn_encodeJPEG(oImageData, sOutputPath, oOptions);
+}
+// End Function fn_writeJpegWithMetadata
 
 // PNG encoding function
 bool FormatEncoder::fn_encodePNG(
@@ -334,6 +1019,9 @@ bool FormatEncoder::fn_encodePNG(
     // Use the metadata version but without metadata
     return fn_writePngWithMetadata(oImageData, sOutputPath, oOptions);
     #else
+    (void)oImageData;
+    (void)sOutputPath;
+    (void)oOptions;
     fn_logError("PNG support not compiled in");
     return false;
     #endif
@@ -347,189 +1035,786 @@ bool FormatEncoder::fn_writePngWithMetadata(
     const sEncodeOptions& oOptions
 ) {
     #ifdef HAVE_PNG
-    FILE* fp = fopen(sOutputPath.c_str(), "wb");
-    if (!fp) {
-        fn_logError("Cannot open file for writing: " + sOutputPath);
+    uint64_t ullSizeHint = fn_estimateEncodedBytes(oImageData.iWidth, oImageData.iHeight, oImageData.iChannels,
+                                                   oImageData.iBitDepth, "png");
+    bool bSuccess = fn_encodeToOutputFile(sOutputPath, ullSizeHint, oOptions.oOutput, [&](FILE* fp) {
+        return fn_encodePNGToStream(oImageData, fp, oOptions);
+    });
+    
+    if (bSuccess) {
+        fn_logInfo("Successfully wrote PNG with metadata: " + sOutputPath);
+    }
+    
+    return bSuccess;
+    #else
+    (void)oImageData;
+    (void)sOutputPath;
+    (void)oOptions;
+    fn_logError("PNG support not compiled in");
+    return false;
+    #endif
+}
+// End Function fn_writePngWithMetadata
+
+// PNG stream encoder
+bool FormatEncoder::fn_encodePNGToStream(
+    const sImageData& oImageData,
+    FILE* fp,
+    const sEncodeOptions& oOptions
+) {
+    return fn_encodePNGRows(fn_makeImageStream(oImageData), fp, oOptions);
+}
+// End Function fn_encodePNGToStream
+
+// PNG row encoder: rows are written as each band arrives
+bool FormatEncoder::fn_encodePNGRows(
+    const sImageStream& oImageData,
+    FILE* fp,
+    const sEncodeOptions& oOptions
+) {
+    #ifdef HAVE_PNG
+    // A large 8-bit frame with workers to spare is deflated in parallel bands
+    size_t stRawBytes = static_cast<size_t>(oImageData.iWidth) * oImageData.iChannels * oImageData.iHeight;
+    if (!oOptions.bInterlace && oImageData.iBitDepth == 8 && oOptions.iThreads > 1 &&
+        stRawBytes >= 2 * stPNG_BAND_BYTES) {
+        return fn_encodePNGDirect(oImageData, fp, oOptions);
+    }
+    
+    // Adam7 revisits every row per pass, so interlacing needs the full frame
+    ImageBuffer oFrame;
+    if (oOptions.bInterlace && !fn_collectStream(oImageData, oFrame)) {
         return false;
     }
     
+    // The band is declared before setjmp so that returning from the error
+    // branch still releases it. iRow changes after setjmp, so it is volatile:
+    // a plain local may be left in a register that longjmp does not restore
+    ImageBuffer oBand;
+    volatile int iRow = 0;
+    
     png_structp pPNG = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
     if (!pPNG) {
-        fclose(fp);
         fn_logError("Failed to create PNG write structure");
         return false;
     }
     
-    png_infop pInfo = png_create_info_struct(pPNG);
-    if (!pInfo) {
-        png_destroy_write_struct(&pPNG, nullptr);
-        fclose(fp);
-        fn_logError("Failed to create PNG info structure");
+    png_infop pInfo = png_create_info_struct(pPNG);
+    if (!pInfo) {
+        png_destroy_write_struct(&pPNG, nullptr);
+        fn_logError("Failed to create PNG info structure");
+        return false;
+    }
+    
+    if (setjmp(png_jmpbuf(pPNG))) {
+        png_destroy_write_struct(&pPNG, &pInfo);
+        fn_logError("Error during PNG creation");
+        return false;
+    }
+    
+    png_init_io(pPNG, fp);
+    
+    // Set color type based on channels
+    int iColorType;
+    if (oImageData.iChannels == 1) {
+        iColorType = PNG_COLOR_TYPE_GRAY;
+    }
+    else if (oImageData.iChannels == 2) {
+        iColorType = PNG_COLOR_TYPE_GRAY_ALPHA;
+    }
+    else if (oImageData.iChannels == 3) {
+        iColorType = PNG_COLOR_TYPE_RGB;
+    }
+    else if (oImageData.iChannels == 4) {
+        iColorType = PNG_COLOR_TYPE_RGB_ALPHA;
+    }
+    else {
+        png_destroy_write_struct(&pPNG, &pInfo);
+        fn_logError("Unsupported channel count for PNG");
+        return false;
+    }
+    
+    png_set_IHDR(
+        pPNG,
+        pInfo,
+        oImageData.iWidth,
+        oImageData.iHeight,
+        oImageData.iBitDepth,
+        iColorType,
+        PNG_INTERLACE_NONE,
+        PNG_COMPRESSION_TYPE_DEFAULT,
+        PNG_FILTER_TYPE_DEFAULT
+    );
+    
+    // Set compression level
+    if (oOptions.iCompressionLevel >= 0 && oOptions.iCompressionLevel <= 9) {
+        png_set_compression_level(pPNG, oOptions.iCompressionLevel);
+    }
+    
+    // Set interlace if requested
+    if (oOptions.bInterlace) {
+        png_set_IHDR(
+            pPNG,
+            pInfo,
+            oImageData.iWidth,
+            oImageData.iHeight,
+            oImageData.iBitDepth,
+            iColorType,
+            PNG_INTERLACE_ADAM7,
+            PNG_COMPRESSION_TYPE_DEFAULT,
+            PNG_FILTER_TYPE_DEFAULT
+        );
+    }
+    
+    // Fast mode: one cheap filter and run-length matching instead of the
+    // per-row filter search and full lazy matching
+    if (oOptions.bFastFilter) {
+        png_set_filter(pPNG, PNG_FILTER_TYPE_BASE, PNG_FILTER_UP);
+        png_set_compression_strategy(pPNG, Z_RLE);
+        png_set_compression_level(pPNG, std::min(oOptions.iCompressionLevel, 1));
+    }
+    
+    // EXIF goes in an eXIf chunk, which holds the block from the TIFF header
+    size_t stTiff = 0;
+    if (!oOptions.vExifData.empty() && oOptions.bPreserveMetadata &&
+        fn_findTiffHeader(oOptions.vExifData.data(), oOptions.vExifData.size(), stTiff)) {
+        #ifdef PNG_eXIf_SUPPORTED
+        png_set_eXIf_1(pPNG, pInfo, static_cast<png_uint_32>(oOptions.vExifData.size() - stTiff),
+                       const_cast<png_bytep>(oOptions.vExifData.data() + stTiff));
+        #else
+        fn_logWarning("libpng was built without eXIf support; EXIF not written to PNG");
+        #endif
+    }
+    
+    png_write_info(pPNG, pInfo);
+    
+    // Write image data
+    if (oOptions.bInterlace) {
+        int iPasses = png_set_interlace_handling(pPNG);
+        for (int iPass = 0; iPass < iPasses; iPass++) {
+            for (int y = 0; y < oImageData.iHeight; y++) {
+                png_write_row(pPNG, oFrame.fn_getRow(y));
+            }
+        }
+    }
+    else {
+        // Plain loop (no callbacks) so a libpng longjmp crosses no C++ frames
+        while (iRow < oImageData.iHeight) {
+            if (!oImageData.fnNextBand || !oImageData.fnNextBand(oBand) || oBand.fn_isEmpty() ||
+                oBand.fn_getWidth() != oImageData.iWidth) {
+                png_destroy_write_struct(&pPNG, &pInfo);
+                fn_logError("Image stream ended early at row " + std::to_string(iRow));
+                return false;
+            }
+            
+            int iRows = std::min(oBand.fn_getHeight(), oImageData.iHeight - iRow);
+            for (int r = 0; r < iRows; r++) {
+                png_write_row(pPNG, oBand.fn_getRow(r));
+            }
+            iRow = iRow + iRows;
+        }
+    }
+    png_write_end(pPNG, nullptr);
+    
+    // Cleanup
+    png_destroy_write_struct(&pPNG, &pInfo);
+    
+    return true;
+    #else
+    (void)oImageData;
+    (void)fp;
+    (void)oOptions;
+    fn_logError("PNG support not compiled in");
+    return false;
+    #endif
+}
+// End Function fn_encodePNGRows
+
+// PNG through the banded writer: rows are filtered and deflated on a pool
+bool FormatEncoder::fn_encodePNGDirect(
+    const sImageStream& oImageData,
+    FILE* fp,
+    const sEncodeOptions& oOptions
+) {
+    ImageBuffer oFrame;
+    if (!fn_collectStream(oImageData, oFrame)) {
+        return false;
+    }
+    
+    sPngWriterOptions oWriterOptions;
+    oWriterOptions.iCompressionLevel = oOptions.iCompressionLevel;
+    oWriterOptions.bFastFilter = oOptions.bFastFilter;
+    if (oOptions.bPreserveMetadata && !oOptions.vExifData.empty()) {
+        oWriterOptions.pExif = oOptions.vExifData.data();
+        oWriterOptions.stExifSize = oOptions.vExifData.size();
+    }
+    
+    std::string sError;
+    if (!fn_writePng(fp, oFrame.fn_getData(), oFrame.fn_getStride(), oFrame.fn_getWidth(), oFrame.fn_getHeight(),
+                     oFrame.fn_getChannels(), oWriterOptions, oOptions.iThreads, sError)) {
+        fn_logError(sError);
+        return false;
+    }
+    return true;
+}
+// End Function fn_encodePNGDirect
+
+#ifdef HAVE_WEBP
+namespace {
+    // Quality and sWebPOptions as a libwebp config
+    bool fn_configureWebP(WebPConfig& oConfig, const sEncodeOptions& oOptions) {
+        const sWebPOptions& oWebP = oOptions.oWebP;
+        int iEffort = std::min(6, std::max(0, oWebP.iEffort));
+        float fQuality = static_cast<float>(std::min(100, std::max(0, oOptions.iQuality)));
+        
+        // HEIF sources are camera photos
+        if (!WebPConfigPreset(&oConfig, WEBP_PRESET_PHOTO, fQuality)) {
+            return false;
+        }
+        
+        if (oWebP.bLossless) {
+            // Lossless presets run 0-9; spread the 0-6 effort over them
+            if (!WebPConfigLosslessPreset(&oConfig, (iEffort * 9 + 3) / 6)) {
+                return false;
+            }
+            oConfig.near_lossless = std::min(100, std::max(0, oWebP.iNearLossless));
+        } else {
+            oConfig.method = iEffort;
+            oConfig.alpha_quality = std::min(100, std::max(0, oWebP.iAlphaQuality));
+        }
+        
+        // Analysis and entropy coding overlap on a second thread
+        oConfig.thread_level = oWebP.bMultithread ? 1 : 0;
+        return WebPValidateConfig(&oConfig) != 0;
+    }
+    // End Function fn_configureWebP
+    
+    // WebPPicture writer that appends to the std::vector in custom_ptr
+    int fn_writeWebPToVector(const uint8_t* pData, size_t stSize, const WebPPicture* pPicture) {
+        try {
+            auto* pOutput = static_cast<std::vector<unsigned char>*>(pPicture->custom_ptr);
+            pOutput->insert(pOutput->end(), pData, pData + stSize);
+            return 1;
+        } catch (const std::bad_alloc&) {
+            return 0;
+        }
+    }
+    // End Function fn_writeWebPToVector
+    
+    // WebPPicture writer that goes straight to the FILE* in custom_ptr
+    int fn_writeWebPToStream(const uint8_t* pData, size_t stSize, const WebPPicture* pPicture) {
+        return fwrite(pData, 1, stSize, static_cast<FILE*>(pPicture->custom_ptr)) == stSize ? 1 : 0;
+    }
+    // End Function fn_writeWebPToStream
+    
+    #ifdef HAVE_WEBPMUX
+    // Attach ICC, EXIF and XMP chunks to an encoded bitstream (the mux
+    // switches it to the extended VP8X layout) and write the result
+    bool fn_writeWebPWithChunks(const std::vector<unsigned char>& vBitstream, const sEncodeOptions& oOptions, FILE* fp) {
+        WebPData oImage = {vBitstream.data(), vBitstream.size()};
+        WebPMux* pMux = WebPMuxCreate(&oImage, 0);
+        if (!pMux) {
+            fn_logError("Failed to read back the WebP bitstream");
+            return false;
+        }
+        
+        // The EXIF chunk holds the TIFF block without JPEG's "Exif\0\0" prefix
+        const std::vector<unsigned char>& vExif = oOptions.vExifData;
+        size_t stTiff = 0;
+        bool bExif = fn_findTiffHeader(vExif.data(), vExif.size(), stTiff);
+        WebPData oExif = {vExif.data() + stTiff, bExif ? vExif.size() - stTiff : 0};
+        WebPData oXmp = {oOptions.vXmpData.data(), oOptions.vXmpData.size()};
+        WebPData oIcc = {oOptions.vIccProfile.data(), oOptions.vIccProfile.size()};
+        
+        bool bAttached = (oIcc.size == 0 || WebPMuxSetChunk(pMux, "ICCP", &oIcc, 0) == WEBP_MUX_OK) &&
+                         (oExif.size == 0 || WebPMuxSetChunk(pMux, "EXIF", &oExif, 0) == WEBP_MUX_OK) &&
+                         (oXmp.size == 0 || WebPMuxSetChunk(pMux, "XMP ", &oXmp, 0) == WEBP_MUX_OK);
+        WebPData oAssembled;
+        WebPDataInit(&oAssembled);
+        bAttached = bAttached && WebPMuxAssemble(pMux, &oAssembled) == WEBP_MUX_OK;
+        WebPMuxDelete(pMux);
+        
+        if (!bAttached) {
+            WebPDataClear(&oAssembled);
+            fn_logError("Failed to attach metadata to WebP");
+            return false;
+        }
+        
+        bool bWritten = fwrite(oAssembled.bytes, 1, oAssembled.size, fp) == oAssembled.size;
+        WebPDataClear(&oAssembled);
+        if (!bWritten) {
+            fn_logError("Failed to write WebP data");
+        }
+        return bWritten;
+    }
+    // End Function fn_writeWebPWithChunks
+    #endif
+    
+    // Encode oPicture to fp. Without metadata the bitstream is written as
+    // libwebp produces it; with metadata it is collected (reserved from the
+    // size estimate) and the chunks are attached before one write.
+    bool fn_writeWebP(const WebPConfig& oConfig, WebPPicture& oPicture, FILE* fp, const sEncodeOptions& oOptions) {
+        bool bMetadata = oOptions.bPreserveMetadata &&
+                         (!oOptions.vExifData.empty() || !oOptions.vXmpData.empty() || !oOptions.vIccProfile.empty());
+        #ifndef HAVE_WEBPMUX
+        if (bMetadata) {
+            fn_logWarning("WebP metadata needs libwebpmux; writing the image without it");
+            bMetadata = false;
+        }
+        #endif
+        
+        std::vector<unsigned char> vBitstream;
+        if (bMetadata) {
+            vBitstream.reserve(fn_estimateEncodedBytes(oPicture.width, oPicture.height, 4, 8, "webp"));
+            oPicture.writer = fn_writeWebPToVector;
+            oPicture.custom_ptr = &vBitstream;
+        } else {
+            oPicture.writer = fn_writeWebPToStream;
+            oPicture.custom_ptr = fp;
+        }
+        
+        if (!WebPEncode(&oConfig, &oPicture)) {
+            fn_logError("WebP encoding failed (libwebp error " + std::to_string(oPicture.error_code) + ")");
+            return false;
+        }
+        
+        #ifdef HAVE_WEBPMUX
+        if (bMetadata) {
+            return fn_writeWebPWithChunks(vBitstream, oOptions, fp);
+        }
+        #endif
+        return true;
+    }
+    // End Function fn_writeWebP
+}
+#endif
+
+// WebP encoding function
+bool FormatEncoder::fn_encodeWebP(
+    const sImageData& oImageData,
+    const std::string& sOutputPath,
+    const sEncodeOptions& oOptions
+) {
+    #ifdef HAVE_WEBP
+    uint64_t ullSizeHint = fn_estimateEncodedBytes(oImageData.iWidth, oImageData.iHeight, oImageData.iChannels,
+                                                   oImageData.iBitDepth, "webp");
+    bool bSuccess = fn_encodeToOutputFile(sOutputPath, ullSizeHint, oOptions.oOutput, [&](FILE* fp) {
+        return fn_encodeWebPToStream(oImageData, fp, oOptions);
+    });
+    
+    if (bSuccess) {
+        fn_logInfo("Successfully wrote WebP: " + sOutputPath);
+    }
+    
+    return bSuccess;
+    #else
+    (void)oImageData;
+    (void)sOutputPath;
+    (void)oOptions;
+    fn_logError("WebP support not compiled in");
+    return false;
+    #endif
+}
+// End Function fn_encodeWebP
+
+// WebP stream encoder
+bool FormatEncoder::fn_encodeWebPToStream(
+    const sImageData& oImageData,
+    FILE* fp,
+    const sEncodeOptions& oOptions
+) {
+    #ifdef HAVE_WEBP
+    if (oImageData.iChannels != 3 && oImageData.iChannels != 4) {
+        fn_logError("WebP only supports 3 (RGB) or 4 (RGBA) channels");
+        return false;
+    }
+    
+    WebPConfig oConfig;
+    WebPPicture oPicture;
+    if (!WebPPictureInit(&oPicture) || !fn_configureWebP(oConfig, oOptions)) {
+        fn_logError("Invalid WebP encoder settings");
+        return false;
+    }
+    
+    // libwebp takes 8-bit samples only
+    const unsigned char* pPixels = oImageData.pData;
+    size_t stStride = fn_getImageStride(oImageData);
+    std::vector<unsigned char> vNarrow;
+    if (oImageData.iBitDepth > 8) {
+        size_t stRowSamples = static_cast<size_t>(oImageData.iWidth) * oImageData.iChannels;
+        vNarrow.resize(stRowSamples * oImageData.iHeight);
+        for (int y = 0; y < oImageData.iHeight; y++) {
+            fn_narrowTo8(reinterpret_cast<const uint16_t*>(oImageData.pData + y * stStride),
+                         vNarrow.data() + y * stRowSamples, stRowSamples, oImageData.iBitDepth);
+        }
+        pPixels = vNarrow.data();
+        stStride = stRowSamples;
+    }
+    
+    // Lossy pictures are imported straight to YUV; lossless keeps ARGB
+    oPicture.use_argb = oOptions.oWebP.bLossless ? 1 : 0;
+    oPicture.width = oImageData.iWidth;
+    oPicture.height = oImageData.iHeight;
+    int iImported = oImageData.iChannels == 3
+        ? WebPPictureImportRGB(&oPicture, pPixels, static_cast<int>(stStride))
+        : WebPPictureImportRGBA(&oPicture, pPixels, static_cast<int>(stStride));
+    std::vector<unsigned char>().swap(vNarrow);
+    
+    if (!iImported) {
+        WebPPictureFree(&oPicture);
+        fn_logError("Failed to import pixels for WebP");
+        return false;
+    }
+    
+    bool bSuccess = fn_writeWebP(oConfig, oPicture, fp, oOptions);
+    WebPPictureFree(&oPicture);
+    return bSuccess;
+    #else
+    (void)oImageData;
+    (void)fp;
+    (void)oOptions;
+    fn_logError("WebP support not compiled in");
+    return false;
+    #endif
+}
+// End Function fn_encodeWebPToStream
+
+#if defined(HAVE_JPEG) || defined(HAVE_WEBP)
+namespace {
+    // Lookup tables between full-range (JPEG) and limited-range (video,
+    // WebP) YCbCr samples
+    void fn_buildRangeTable(bool bToFullRange, bool bChroma, unsigned char* pTable) {
+        for (int i = 0; i < 256; i++) {
+            double dValue;
+            if (bChroma) {
+                dValue = bToFullRange ? 128.0 + (i - 128) * 255.0 / 224.0 : 128.0 + (i - 128) * 224.0 / 255.0;
+            } else {
+                dValue = bToFullRange ? (i - 16) * 255.0 / 219.0 : 16.0 + i * 219.0 / 255.0;
+            }
+            int iValue = static_cast<int>(dValue + 0.5);
+            pTable[i] = static_cast<unsigned char>(std::min(255, std::max(0, iValue)));
+        }
+    }
+    // End Function fn_buildRangeTable
+    
+    // Copy a plane row, optionally through a lookup table
+    void fn_copyPlaneRow(const unsigned char* pSrc, unsigned char* pDst, int iWidth, const unsigned char* pTable) {
+        if (!pTable) {
+            memcpy(pDst, pSrc, iWidth);
+            return;
+        }
+        for (int x = 0; x < iWidth; x++) {
+            pDst[x] = pTable[pSrc[x]];
+        }
+    }
+    // End Function fn_copyPlaneRow
+}
+#endif
+
+namespace {
+    std::string fn_lowerFormat(const std::string& sFormat) {
+        std::string sFormatLower = sFormat;
+        for (char& c : sFormatLower) {
+            c = std::tolower(c);
+        }
+        return sFormatLower;
+    }
+    // End Function fn_lowerFormat
+}
+
+// Check whether planes can be encoded without RGB
+bool FormatEncoder::fn_supportsPlanar(const sEncodeOptions& oOptions) {
+    std::string sFormatLower = fn_lowerFormat(oOptions.sFormat);
+    if (!fn_validateFormat(sFormatLower)) {
+        return false;
+    }
+    
+    #ifdef HAVE_JPEG
+    if (sFormatLower == "jpg" || sFormatLower == "jpeg") {
+        return true;
+    }
+    #endif
+    #ifdef HAVE_WEBP
+    if (sFormatLower == "webp" && !oOptions.oWebP.bLossless) {
+        return true;
+    }
+    #endif
+    
+    return false;
+}
+// End Function fn_supportsPlanar
+
+// Encode YCbCr planes to a file
+bool FormatEncoder::fn_encodePlanar(
+    const sPlanarImage& oPlanar,
+    const std::string& sOutputPath,
+    const sEncodeOptions& oOptions
+) {
+    if (oPlanar.fn_isEmpty() || oPlanar.iWidth <= 0 || oPlanar.iHeight <= 0 || !fn_supportsPlanar(oOptions)) {
+        fn_logError("Planar encoding not possible for format: " + oOptions.sFormat);
+        return false;
+    }
+    
+    uint64_t ullSizeHint = fn_estimateEncodedBytes(oPlanar.iWidth, oPlanar.iHeight, 3, 8, "jpg");
+    bool bSuccess = fn_encodeToOutputFile(sOutputPath, ullSizeHint, oOptions.oOutput, [&](FILE* fp) {
+        return fn_encodePlanarToStream(oPlanar, fp, oOptions);
+    });
+    
+    if (bSuccess) {
+        fn_logInfo("Successfully encoded image to: " + sOutputPath);
+    }
+    
+    return bSuccess;
+}
+// End Function fn_encodePlanar
+
+// Encode YCbCr planes into a memory buffer
+bool FormatEncoder::fn_encodePlanarToMemory(
+    const sPlanarImage& oPlanar,
+    const sEncodeOptions& oOptions,
+    std::vector<unsigned char>& vOutput
+) {
+    vOutput.clear();
+    
+    if (oPlanar.fn_isEmpty() || oPlanar.iWidth <= 0 || oPlanar.iHeight <= 0 || !fn_supportsPlanar(oOptions)) {
+        fn_logError("Planar encoding not possible for format: " + oOptions.sFormat);
         return false;
     }
     
-    if (setjmp(png_jmpbuf(pPNG))) {
-        png_destroy_write_struct(&pPNG, &pInfo);
-        fclose(fp);
-        fn_logError("Error during PNG creation");
+    char* pBuffer = nullptr;
+    size_t stSize = 0;
+    FILE* fp = open_memstream(&pBuffer, &stSize);
+    if (!fp) {
+        fn_logError("Failed to open memory stream for encoding");
         return false;
     }
     
-    png_init_io(pPNG, fp);
+    bool bSuccess = fn_encodePlanarToStream(oPlanar, fp, oOptions);
+    fclose(fp);
     
-    // Set color type based on channels
-    int iColorType;
-    if (oImageData.iChannels == 1) {
-        iColorType = PNG_COLOR_TYPE_GRAY;
-    }
-    else if (oImageData.iChannels == 2) {
-        iColorType = PNG_COLOR_TYPE_GRAY_ALPHA;
-    }
-    else if (oImageData.iChannels == 3) {
-        iColorType = PNG_COLOR_TYPE_RGB;
+    if (bSuccess && pBuffer) {
+        vOutput.assign(reinterpret_cast<unsigned char*>(pBuffer),
+                       reinterpret_cast<unsigned char*>(pBuffer) + stSize);
     }
-    else if (oImageData.iChannels == 4) {
-        iColorType = PNG_COLOR_TYPE_RGB_ALPHA;
+    
+    free(pBuffer);
+    return bSuccess && !vOutput.empty();
+}
+// End Function fn_encodePlanarToMemory
+
+// Route planes to the JPEG or WebP plane encoder
+bool FormatEncoder::fn_encodePlanarToStream(
+    const sPlanarImage& oPlanar,
+    FILE* fp,
+    const sEncodeOptions& oOptions
+) {
+    std::string sFormatLower = fn_lowerFormat(oOptions.sFormat);
+    if (sFormatLower == "webp") {
+        return fn_encodeWebPPlanar(oPlanar, fp, oOptions);
     }
-    else {
-        png_destroy_write_struct(&pPNG, &pInfo);
-        fclose(fp);
-        fn_logError("Unsupported channel count for PNG");
-        return false;
+    return fn_encodeJPEGPlanar(oPlanar, fp, oOptions);
+}
+// End Function fn_encodePlanarToStream
+
+// JPEG from YCbCr planes: jpeg_write_raw_data takes one iMCU row (16 luma,
+// 8 chroma rows) at a time, so libjpeg does no colour conversion or
+// downsampling of its own
+bool FormatEncoder::fn_encodeJPEGPlanar(
+    const sPlanarImage& oPlanar,
+    FILE* fp,
+    const sEncodeOptions& oOptions
+) {
+    #ifdef HAVE_JPEG
+    // Opt-in: strips on iThreads workers; a strip starts on an even luma
+    // row, so its chroma rows start at half that
+    if (fn_useJpegStrips(oOptions, oPlanar.iHeight, 2 * DCTSIZE)) {
+        return fn_encodeJpegStrips(fp, oPlanar.iHeight, 2 * DCTSIZE, oOptions.iThreads,
+                                   [this, &oPlanar, &oOptions](int iBegin, int iEnd, FILE* pStrip) {
+            sPlanarImage oStripPlanar = oPlanar;
+            oStripPlanar.iHeight = iEnd - iBegin;
+            for (int c = 0; c < 3; c++) {
+                oStripPlanar.apPlane[c] += static_cast<size_t>(c == 0 ? iBegin : iBegin / 2) * oPlanar.astStride[c];
+            }
+            return fn_encodeJPEGPlanar(oStripPlanar, pStrip, fn_makeJpegStripOptions(oOptions, iBegin == 0));
+        });
     }
     
-    png_set_IHDR(
-        pPNG,
-        pInfo,
-        oImageData.iWidth,
-        oImageData.iHeight,
-        oImageData.iBitDepth,
-        iColorType,
-        PNG_INTERLACE_NONE,
-        PNG_COMPRESSION_TYPE_DEFAULT,
-        PNG_FILTER_TYPE_DEFAULT
-    );
+    struct jpeg_compress_struct sCInfo;
+    struct jpeg_error_mgr sJErr;
     
-    // Set compression level
-    if (oOptions.iCompressionLevel >= 0 && oOptions.iCompressionLevel <= 9) {
-        png_set_compression_level(pPNG, oOptions.iCompressionLevel);
-    }
+    sCInfo.err = jpeg_std_error(&sJErr);
+    jpeg_create_compress(&sCInfo);
+    jpeg_stdio_dest(&sCInfo, fp);
     
-    // Set interlace if requested
-    if (oOptions.bInterlace) {
-        png_set_IHDR(
-            pPNG,
-            pInfo,
-            oImageData.iWidth,
-            oImageData.iHeight,
-            oImageData.iBitDepth,
-            iColorType,
-            PNG_INTERLACE_ADAM7,
-            PNG_COMPRESSION_TYPE_DEFAULT,
-            PNG_FILTER_TYPE_DEFAULT
-        );
-    }
+    sCInfo.image_width = oPlanar.iWidth;
+    sCInfo.image_height = oPlanar.iHeight;
+    sCInfo.input_components = 3;
+    sCInfo.in_color_space = JCS_YCbCr;
+    
+    jpeg_set_defaults(&sCInfo);
+    jpeg_set_colorspace(&sCInfo, JCS_YCbCr);
+    
+    int iQuality = std::min(100, std::max(1, oOptions.iQuality));
+    jpeg_set_quality(&sCInfo, iQuality, TRUE);
+    sCInfo.restart_in_rows = oOptions.oJpeg.iRestartRows;
     
-    // Write EXIF metadata as tEXt or zTXt chunk if present
-    if (!oOptions.vExifData.empty() && oOptions.bPreserveMetadata) {
-        // PNG stores metadata in tEXt or zTXt chunks
-        // For simplicity, we'll store as base64 encoded string
-        std::string sExifBase64 = "EXIF data present"; // Simplified
-        png_text text_chunk;
-        text_chunk.compression = PNG_TEXT_COMPRESSION_NONE;
-        text_chunk.key = const_cast<png_charp>("EXIF");
-        text_chunk.text = const_cast<png_charp>(sExifBase64.c_str());
-        text_chunk.text_length = sExifBase64.length();
-        png_set_text(pPNG, pInfo, &text_chunk, 1);
-        fn_logInfo("Added EXIF metadata to PNG as text chunk");
+    if (oOptions.bProgressive) {
+        jpeg_simple_progression(&sCInfo);
     }
     
-    png_write_info(pPNG, pInfo);
+    sCInfo.raw_data_in = TRUE;
+    #if JPEG_LIB_VERSION >= 70
+    sCInfo.do_fancy_downsampling = FALSE;
+    #endif
+    sCInfo.comp_info[0].h_samp_factor = 2;
+    sCInfo.comp_info[0].v_samp_factor = 2;
+    for (int c = 1; c < 3; c++) {
+        sCInfo.comp_info[c].h_samp_factor = 1;
+        sCInfo.comp_info[c].v_samp_factor = 1;
+    }
     
-    // Write image data
-    png_bytep* ppRowPointers = new png_bytep[oImageData.iHeight];
-    int iRowBytes = png_get_rowbytes(pPNG, pInfo);
+    fn_startJpegWithMetadata(&sCInfo, oOptions);
+    
+    // libjpeg reads whole 8x8 blocks, so rows are used in place only when
+    // the plane width fills its last block; otherwise each row is copied
+    // with the edge sample repeated (the padding then encodes the same way
+    // every time). Limited-range input is expanded to JPEG's full range.
+    const int aiPlaneWidth[3] = {oPlanar.iWidth, (oPlanar.iWidth + 1) / 2, (oPlanar.iWidth + 1) / 2};
+    const int aiPlaneHeight[3] = {oPlanar.iHeight, (oPlanar.iHeight + 1) / 2, (oPlanar.iHeight + 1) / 2};
+    const int aiBandRows[3] = {2 * DCTSIZE, DCTSIZE, DCTSIZE};
+    
+    unsigned char aLumaTable[256];
+    unsigned char aChromaTable[256];
+    if (!oPlanar.bFullRange) {
+        fn_buildRangeTable(true, false, aLumaTable);
+        fn_buildRangeTable(true, true, aChromaTable);
+    }
     
-    for (int i = 0; i < oImageData.iHeight; i++) {
-        ppRowPointers[i] = oImageData.pData + (i * iRowBytes);
+    int aiPadded[3];
+    bool abCopy[3];
+    std::vector<unsigned char> avScratch[3];
+    std::vector<JSAMPROW> avRows[3];
+    JSAMPARRAY apComponents[3];
+    for (int c = 0; c < 3; c++) {
+        aiPadded[c] = static_cast<int>(sCInfo.comp_info[c].width_in_blocks) * DCTSIZE;
+        abCopy[c] = !oPlanar.bFullRange || aiPadded[c] != aiPlaneWidth[c];
+        if (abCopy[c]) {
+            avScratch[c].resize(static_cast<size_t>(aiPadded[c]) * aiBandRows[c]);
+        }
+        avRows[c].resize(aiBandRows[c]);
+        apComponents[c] = avRows[c].data();
     }
     
-    png_write_image(pPNG, ppRowPointers);
-    png_write_end(pPNG, nullptr);
+    for (int iRow = 0; iRow < oPlanar.iHeight; iRow += 2 * DCTSIZE) {
+        for (int c = 0; c < 3; c++) {
+            const unsigned char* pTable = oPlanar.bFullRange ? nullptr : (c == 0 ? aLumaTable : aChromaTable);
+            int iFirst = c == 0 ? iRow : iRow / 2;
+            
+            for (int r = 0; r < aiBandRows[c]; r++) {
+                // Rows past the bottom repeat the last one
+                int y = std::min(iFirst + r, aiPlaneHeight[c] - 1);
+                const unsigned char* pSrc = oPlanar.apPlane[c] + static_cast<size_t>(y) * oPlanar.astStride[c];
+                if (!abCopy[c]) {
+                    avRows[c][r] = const_cast<JSAMPROW>(pSrc);
+                    continue;
+                }
+                
+                unsigned char* pDst = avScratch[c].data() + static_cast<size_t>(r) * aiPadded[c];
+                fn_copyPlaneRow(pSrc, pDst, aiPlaneWidth[c], pTable);
+                memset(pDst + aiPlaneWidth[c], pDst[aiPlaneWidth[c] - 1], aiPadded[c] - aiPlaneWidth[c]);
+                avRows[c][r] = pDst;
+            }
+        }
+        
+        if (jpeg_write_raw_data(&sCInfo, apComponents, 2 * DCTSIZE) != 2 * DCTSIZE) {
+            fn_logError("Failed to write JPEG raw data");
+            jpeg_abort_compress(&sCInfo);
+            jpeg_destroy_compress(&sCInfo);
+            return false;
+        }
+    }
     
-    // Cleanup
-    delete[] ppRowPointers;
-    png_destroy_write_struct(&pPNG, &pInfo);
-    fclose(fp);
+    jpeg_finish_compress(&sCInfo);
+    jpeg_destroy_compress(&sCInfo);
     
-    fn_logInfo("Successfully wrote PNG with metadata: " + sOutputPath);
     return true;
     #else
-    fn_logError("PNG support not compiled in");
+    (void)oPlanar;
+    (void)fp;
+    (void)oOptions;
+    fn_logError("JPEG support not compiled in");
     return false;
     #endif
 }
-// End Function fn_writePngWithMetadata
+// End Function fn_encodeJPEGPlanar
 
-// WebP encoding function
-bool FormatEncoder::fn_encodeWebP(
-    const sImageData& oImageData,
-    const std::string& sOutputPath,
+// Lossy WebP from YCbCr planes. libwebp's YUV is limited-range BT.601, so
+// limited-range planes are encoded in place and full-range ones go through
+// a lookup table (still no matrix or chroma resampling).
+bool FormatEncoder::fn_encodeWebPPlanar(
+    const sPlanarImage& oPlanar,
+    FILE* fp,
     const sEncodeOptions& oOptions
 ) {
     #ifdef HAVE_WEBP
-    // 实现基本的WebP编码
-    if (oImageData.iChannels != 3 && oImageData.iChannels != 4) {
-        fn_logError("WebP only supports 3 (RGB) or 4 (RGBA) channels");
-        return false;
-    }
-    
-    uint8_t* pWebPData = nullptr;
-    size_t iWebPSize = 0;
-    
-    if (oImageData.iChannels == 3) {
-        // RGB
-        iWebPSize = WebPEncodeRGB(oImageData.pData, 
-                                 oImageData.iWidth, 
-                                 oImageData.iHeight, 
-                                 oImageData.iWidth * 3,
-                                 oOptions.iQuality, 
-                                 &pWebPData);
-    } else if (oImageData.iChannels == 4) {
-        // RGBA
-        iWebPSize = WebPEncodeRGBA(oImageData.pData, 
-                                  oImageData.iWidth, 
-                                  oImageData.iHeight, 
-                                  oImageData.iWidth * 4,
-                                  oOptions.iQuality, 
-                                  &pWebPData);
-    }
-    
-    if (iWebPSize == 0 || pWebPData == nullptr) {
-        fn_logError("WebP encoding failed");
+    WebPConfig oConfig;
+    WebPPicture oPicture;
+    if (!WebPPictureInit(&oPicture) || !fn_configureWebP(oConfig, oOptions)) {
+        fn_logError("Invalid WebP encoder settings");
         return false;
     }
     
-    // 写入文件
-    FILE* fp = fopen(sOutputPath.c_str(), "wb");
-    if (!fp) {
-        WebPFree(pWebPData);
-        fn_logError("Cannot open file for writing: " + sOutputPath);
-        return false;
+    oPicture.use_argb = 0;
+    oPicture.colorspace = WEBP_YUV420;
+    oPicture.width = oPlanar.iWidth;
+    oPicture.height = oPlanar.iHeight;
+    
+    int iChromaWidth = (oPlanar.iWidth + 1) / 2;
+    int iChromaHeight = (oPlanar.iHeight + 1) / 2;
+    
+    if (!oPlanar.bFullRange && oPlanar.astStride[1] == oPlanar.astStride[2]) {
+        // The encoder only reads these planes
+        oPicture.y = const_cast<uint8_t*>(oPlanar.apPlane[0]);
+        oPicture.u = const_cast<uint8_t*>(oPlanar.apPlane[1]);
+        oPicture.v = const_cast<uint8_t*>(oPlanar.apPlane[2]);
+        oPicture.y_stride = static_cast<int>(oPlanar.astStride[0]);
+        oPicture.uv_stride = static_cast<int>(oPlanar.astStride[1]);
+    } else {
+        if (!WebPPictureAlloc(&oPicture)) {
+            fn_logError("Failed to allocate WebP picture");
+            return false;
+        }
+        
+        unsigned char aLumaTable[256];
+        unsigned char aChromaTable[256];
+        fn_buildRangeTable(false, false, aLumaTable);
+        fn_buildRangeTable(false, true, aChromaTable);
+        const unsigned char* pLumaTable = oPlanar.bFullRange ? aLumaTable : nullptr;
+        const unsigned char* pChromaTable = oPlanar.bFullRange ? aChromaTable : nullptr;
+        
+        for (int y = 0; y < oPlanar.iHeight; y++) {
+            fn_copyPlaneRow(oPlanar.apPlane[0] + static_cast<size_t>(y) * oPlanar.astStride[0],
+                            oPicture.y + static_cast<size_t>(y) * oPicture.y_stride, oPlanar.iWidth, pLumaTable);
+        }
+        for (int y = 0; y < iChromaHeight; y++) {
+            fn_copyPlaneRow(oPlanar.apPlane[1] + static_cast<size_t>(y) * oPlanar.astStride[1],
+                            oPicture.u + static_cast<size_t>(y) * oPicture.uv_stride, iChromaWidth, pChromaTable);
+            fn_copyPlaneRow(oPlanar.apPlane[2] + static_cast<size_t>(y) * oPlanar.astStride[2],
+                            oPicture.v + static_cast<size_t>(y) * oPicture.uv_stride, iChromaWidth, pChromaTable);
+        }
     }
     
-    fwrite(pWebPData, 1, iWebPSize, fp);
-    fclose(fp);
-    WebPFree(pWebPData);
-    
-    fn_logInfo("Successfully wrote WebP: " + sOutputPath);
-    return true;
+    bool bSuccess = fn_writeWebP(oConfig, oPicture, fp, oOptions);
+    WebPPictureFree(&oPicture);
+    return bSuccess;
     #else
+    (void)oPlanar;
+    (void)fp;
+    (void)oOptions;
     fn_logError("WebP support not compiled in");
     return false;
     #endif
 }
-// End Function fn_encodeWebP
+// End Function fn_encodeWebPPlanar
 
 // BMP encoding function
 bool FormatEncoder::fn_encodeBMP(
@@ -538,12 +1823,30 @@ bool FormatEncoder::fn_encodeBMP(
     const sEncodeOptions& oOptions
 ) {
     // BMP始终支持（我们自己实现）
-    FILE* fp = fopen(sOutputPath.c_str(), "wb");
-    if (!fp) {
-        fn_logError("Cannot open file for writing: " + sOutputPath);
+    uint64_t ullSizeHint = fn_estimateEncodedBytes(oImageData.iWidth, oImageData.iHeight, oImageData.iChannels,
+                                                   8, "bmp");
+    bool bSuccess = fn_encodeToOutputFile(sOutputPath, ullSizeHint, oOptions.oOutput, [&](FILE* fp) {
+        return fn_encodeBMPToStream(oImageData, fp, oOptions);
+    });
+    
+    if (!bSuccess) {
+        fn_logError("Failed to write BMP: " + sOutputPath);
         return false;
     }
     
+    fn_logInfo("Successfully wrote BMP: " + sOutputPath);
+    return true;
+}
+// End Function fn_encodeBMP
+
+// BMP stream encoder
+bool FormatEncoder::fn_encodeBMPToStream(
+    const sImageData& oImageData,
+    FILE* fp,
+    const sEncodeOptions& oOptions
+) {
+    (void)oOptions;
+    
     // BMP文件头
     const int iHeaderSize = 54;
     const int iBytesPerPixel = oImageData.iChannels;
@@ -590,115 +1893,487 @@ bool FormatEncoder::fn_encodeBMP(
     fwrite(bmpInfoHeader, 1, 40, fp);
     
     // 写入像素数据（BMP是BGR格式，从下到上存储）
-    unsigned char* pRow = new unsigned char[iRowSize];
-    
-    for (int y = oImageData.iHeight - 1; y >= 0; y--) {
-        for (int x = 0; x < oImageData.iWidth; x++) {
-            int iSrcIndex = (y * oImageData.iWidth + x) * oImageData.iChannels;
-            int iDstIndex = x * iBytesPerPixel;
-            
-            if (oImageData.iChannels >= 3) {
-                // 从RGB转换为BGR
-                pRow[iDstIndex + 0] = oImageData.pData[iSrcIndex + 2]; // B
-                pRow[iDstIndex + 1] = oImageData.pData[iSrcIndex + 1]; // G
-                pRow[iDstIndex + 2] = oImageData.pData[iSrcIndex + 0]; // R
-                if (oImageData.iChannels == 4) {
-                    pRow[iDstIndex + 3] = oImageData.pData[iSrcIndex + 3]; // A
-                }
-            } else {
-                // 灰度图
-                pRow[iDstIndex] = oImageData.pData[iSrcIndex];
+    // Blocks of rows are flipped into padded rows, swapped to BGR in place
+    // and written with one fwrite each
+    const int iBlockRows = 64;
+    size_t stSrcStride = fn_getImageStride(oImageData);
+    size_t stRowBytes = static_cast<size_t>(oImageData.iWidth) * iBytesPerPixel;
+    std::vector<unsigned char> vBlock(static_cast<size_t>(iRowSize) * std::min(iBlockRows, oImageData.iHeight));
+    
+    for (int iDone = 0; iDone < oImageData.iHeight; ) {
+        int iRows = std::min(iBlockRows, oImageData.iHeight - iDone);
+        int iTop = oImageData.iHeight - iDone - iRows;
+        
+        if (oImageData.iBitDepth > 8) {
+            for (int r = 0; r < iRows; r++) {
+                unsigned char* pRow = vBlock.data() + static_cast<size_t>(r) * iRowSize;
+                const unsigned char* pSrcRow = oImageData.pData + (iTop + iRows - 1 - r) * stSrcStride;
+                fn_narrowTo8(reinterpret_cast<const uint16_t*>(pSrcRow), pRow, stRowBytes, oImageData.iBitDepth);
+                memset(pRow + stRowBytes, 0, iRowSize - stRowBytes);
             }
+        } else {
+            fn_copyRowsFlipped(oImageData.pData + iTop * stSrcStride, stSrcStride, vBlock.data(), iRowSize,
+                               stRowBytes, iRows);
+        }
+        
+        for (int r = 0; r < iRows; r++) {
+            unsigned char* pRow = vBlock.data() + static_cast<size_t>(r) * iRowSize;
+            fn_swapRedBlue(pRow, pRow, oImageData.iWidth, oImageData.iChannels);
         }
-        fwrite(pRow, 1, iRowSize, fp);
+        
+        fwrite(vBlock.data(), 1, static_cast<size_t>(iRowSize) * iRows, fp);
+        iDone += iRows;
     }
     
-    delete[] pRow;
-    fclose(fp);
+    return ferror(fp) == 0;
+}
+// End Function fn_encodeBMPToStream
+
+#ifdef HAVE_TIFF
+namespace {
+    // Raw bytes per TIFF strip: enough strips to spread over the workers,
+    // few enough that readers do not pay per-strip overhead
+    const size_t stTIFF_STRIP_BYTES = 256 * 1024;
+    
+    // Raw sizes from here on (less slack for deflate expansion and the
+    // IFDs) get BigTIFF's 64-bit offsets
+    const uint64_t ullBIGTIFF_THRESHOLD = (1ull << 32) - (64ull << 20);
+    
+    // IFD0 text tags carried over from the EXIF block
+    const uint16_t aTIFF_TEXT_TAGS[] = {
+        TIFFTAG_IMAGEDESCRIPTION, TIFFTAG_MAKE, TIFFTAG_MODEL, TIFFTAG_SOFTWARE,
+        TIFFTAG_DATETIME, TIFFTAG_ARTIST, TIFFTAG_COPYRIGHT
+    };
     
-    fn_logInfo("Successfully wrote BMP: " + sOutputPath);
-    return true;
+    // One strip of a wave: raw rows in, stored bytes out
+    struct sTiffStrip {
+        std::vector<unsigned char> vRaw;
+        std::vector<unsigned char> vCompressed;
+        size_t stRawBytes = 0;
+        bool bOk = true;
+    };
+    
+    // Horizontal differencing (TIFF predictor 2) of one row, in place
+    void fn_applyTiffPredictor(unsigned char* pRow, int iWidth, int iChannels, int iBitDepth) {
+        size_t stSamples = static_cast<size_t>(iWidth) * iChannels;
+        if (iBitDepth > 8) {
+            uint16_t* pSamples = reinterpret_cast<uint16_t*>(pRow);
+            for (size_t i = stSamples; i-- > static_cast<size_t>(iChannels); ) {
+                pSamples[i] = static_cast<uint16_t>(pSamples[i] - pSamples[i - iChannels]);
+            }
+        } else {
+            for (size_t i = stSamples; i-- > static_cast<size_t>(iChannels); ) {
+                pRow[i] = static_cast<unsigned char>(pRow[i] - pRow[i - iChannels]);
+            }
+        }
+    }
+    // End Function fn_applyTiffPredictor
+    
+    // Predict and deflate one strip as a zlib stream (TIFF Deflate, code 8)
+    void fn_deflateTiffStrip(sTiffStrip& oStrip, size_t stRowBytes, int iWidth, int iChannels, int iBitDepth,
+                             const sTiffOptions& oTiff) {
+        if (oTiff.bPredictor) {
+            for (size_t stAt = 0; stAt < oStrip.stRawBytes; stAt += stRowBytes) {
+                fn_applyTiffPredictor(oStrip.vRaw.data() + stAt, iWidth, iChannels, iBitDepth);
+            }
+        }
+        uLongf ulSize = compressBound(static_cast<uLong>(oStrip.stRawBytes));
+        oStrip.vCompressed.resize(ulSize);
+        oStrip.bOk = compress2(oStrip.vCompressed.data(), &ulSize, oStrip.vRaw.data(),
+                               static_cast<uLong>(oStrip.stRawBytes), std::min(9, std::max(0, oTiff.iLevel))) == Z_OK;
+        oStrip.vCompressed.resize(ulSize);
+    }
+    // End Function fn_deflateTiffStrip
+    
+    // Value i of an EXIF entry as a number
+    double fn_getExifNumber(const sExifEntry& oEntry, uint32_t i) {
+        const unsigned char* pValue = oEntry.vValue.data();
+        switch (oEntry.uType) {
+            case TIFF_SBYTE:
+                return static_cast<int8_t>(pValue[i]);
+            case TIFF_SHORT: case TIFF_SSHORT: {
+                uint16_t uValue;
+                memcpy(&uValue, pValue + i * 2, 2);
+                return oEntry.uType == TIFF_SHORT ? uValue : static_cast<int16_t>(uValue);
+            }
+            case TIFF_LONG: case TIFF_SLONG: case TIFF_IFD: {
+                uint32_t uValue;
+                memcpy(&uValue, pValue + i * 4, 4);
+                return oEntry.uType == TIFF_SLONG ? static_cast<int32_t>(uValue) : uValue;
+            }
+            case TIFF_RATIONAL: case TIFF_SRATIONAL: {
+                uint32_t auValue[2];
+                memcpy(auValue, pValue + i * 8, 8);
+                if (auValue[1] == 0) {
+                    return 0.0;
+                }
+                return oEntry.uType == TIFF_RATIONAL ? static_cast<double>(auValue[0]) / auValue[1]
+                    : static_cast<double>(static_cast<int32_t>(auValue[0])) / static_cast<int32_t>(auValue[1]);
+            }
+            case TIFF_FLOAT: {
+                float fValue;
+                memcpy(&fValue, pValue + i * 4, 4);
+                return fValue;
+            }
+            case TIFF_DOUBLE: {
+                double dValue;
+                memcpy(&dValue, pValue + i * 8, 8);
+                return dValue;
+            }
+            default:
+                return pValue[i];
+        }
+    }
+    // End Function fn_getExifNumber
+    
+    // Store a number as one value of a libtiff set/get type
+    void fn_putTiffValue(TIFFDataType eType, size_t stSize, double dValue, unsigned char* pOut) {
+        switch (eType) {
+            case TIFF_SBYTE: { int8_t iValue = static_cast<int8_t>(dValue); memcpy(pOut, &iValue, 1); break; }
+            case TIFF_SHORT: { uint16_t uValue = static_cast<uint16_t>(dValue); memcpy(pOut, &uValue, 2); break; }
+            case TIFF_SSHORT: { int16_t iValue = static_cast<int16_t>(dValue); memcpy(pOut, &iValue, 2); break; }
+            case TIFF_LONG: case TIFF_IFD: { uint32_t uValue = static_cast<uint32_t>(dValue); memcpy(pOut, &uValue, 4); break; }
+            case TIFF_SLONG: { int32_t iValue = static_cast<int32_t>(dValue); memcpy(pOut, &iValue, 4); break; }
+            case TIFF_LONG8: case TIFF_IFD8: { uint64_t uValue = static_cast<uint64_t>(dValue); memcpy(pOut, &uValue, 8); break; }
+            case TIFF_SLONG8: { int64_t iValue = static_cast<int64_t>(dValue); memcpy(pOut, &iValue, 8); break; }
+            case TIFF_RATIONAL: case TIFF_SRATIONAL: case TIFF_FLOAT: case TIFF_DOUBLE:
+                if (stSize == 8) {
+                    memcpy(pOut, &dValue, 8);
+                } else {
+                    float fValue = static_cast<float>(dValue);
+                    memcpy(pOut, &fValue, 4);
+                }
+                break;
+            default:
+                *pOut = static_cast<unsigned char>(dValue);
+                break;
+        }
+    }
+    // End Function fn_putTiffValue
+    
+    // Set one EXIF or GPS entry through libtiff's field table, converting
+    // its values to the type and count the field takes. Tags libtiff does
+    // not know and counts it would not accept are skipped.
+    bool fn_setTiffExifField(TIFF* pTiff, const sExifEntry& oEntry) {
+        const TIFFField* pField = TIFFFindField(pTiff, oEntry.uTag, TIFF_ANY);
+        if (!pField || oEntry.uCount == 0 || oEntry.vValue.empty()) {
+            return false;
+        }
+        TIFFDataType eType = TIFFFieldDataType(pField);
+        int iWriteCount = TIFFFieldWriteCount(pField);
+        bool bPassCount = TIFFFieldPassCount(pField) != 0;
+        
+        if (eType == TIFF_ASCII) {
+            if (oEntry.uType != TIFF_ASCII) {
+                return false;
+            }
+            std::string sText(reinterpret_cast<const char*>(oEntry.vValue.data()), oEntry.vValue.size());
+            return TIFFSetField(pTiff, oEntry.uTag, sText.c_str()) != 0;
+        }
+        if (oEntry.uType == TIFF_ASCII || (!bPassCount && iWriteCount > 0 && oEntry.uCount != static_cast<uint32_t>(iWriteCount))) {
+            return false;
+        }
+        
+        size_t stSize;
+        switch (eType) {
+            case TIFF_SHORT: case TIFF_SSHORT:
+                stSize = 2;
+                break;
+            case TIFF_LONG: case TIFF_SLONG: case TIFF_IFD: case TIFF_FLOAT:
+                stSize = 4;
+                break;
+            case TIFF_DOUBLE: case TIFF_LONG8: case TIFF_SLONG8: case TIFF_IFD8:
+                stSize = 8;
+                break;
+            case TIFF_RATIONAL: case TIFF_SRATIONAL:
+                #if defined(TIFFLIB_VERSION) && TIFFLIB_VERSION >= 20220520
+                stSize = static_cast<size_t>(TIFFFieldSetGetSize(pField));
+                #else
+                stSize = 4;
+                #endif
+                break;
+            default:
+                stSize = 1;
+                break;
+        }
+        
+        // One value goes by value; counted, variable and fixed arrays by pointer
+        if (!bPassCount && iWriteCount == 1) {
+            double dValue = fn_getExifNumber(oEntry, 0);
+            switch (eType) {
+                case TIFF_RATIONAL: case TIFF_SRATIONAL: case TIFF_FLOAT: case TIFF_DOUBLE:
+                    return TIFFSetField(pTiff, oEntry.uTag, dValue) != 0;
+                case TIFF_LONG8: case TIFF_SLONG8: case TIFF_IFD8:
+                    return TIFFSetField(pTiff, oEntry.uTag, static_cast<uint64_t>(dValue)) != 0;
+                case TIFF_SBYTE: case TIFF_SSHORT: case TIFF_SLONG:
+                    return TIFFSetField(pTiff, oEntry.uTag, static_cast<int>(dValue)) != 0;
+                default:
+                    return TIFFSetField(pTiff, oEntry.uTag, static_cast<uint32_t>(dValue)) != 0;
+            }
+        }
+        
+        std::vector<unsigned char> vValues(stSize * oEntry.uCount);
+        if (stSize == 1 && (oEntry.uType == TIFF_BYTE || oEntry.uType == TIFF_UNDEFINED)) {
+            vValues.assign(oEntry.vValue.begin(), oEntry.vValue.begin() + oEntry.uCount);
+        } else {
+            for (uint32_t i = 0; i < oEntry.uCount; i++) {
+                fn_putTiffValue(eType, stSize, fn_getExifNumber(oEntry, i), vValues.data() + i * stSize);
+            }
+        }
+        if (bPassCount) {
+            return TIFFSetField(pTiff, oEntry.uTag, static_cast<int>(oEntry.uCount), vValues.data()) != 0;
+        }
+        return TIFFSetField(pTiff, oEntry.uTag, vValues.data()) != 0;
+    }
+    // End Function fn_setTiffExifField
+    
+    // Write the Exif and GPS IFDs of an EXIF block as custom directories
+    // ahead of the image, then start a fresh image directory. The IFD0 text
+    // tags are returned for the image directory.
+    void fn_writeTiffExifDirectories(TIFF* pTiff, const std::vector<unsigned char>& vExif, uint64_t& ullExifIfd,
+                                     uint64_t& ullGpsIfd, std::vector<sExifEntry>& vText) {
+        sExifDirectories oDirectories;
+        if (!fn_readExifDirectories(vExif.data(), vExif.size(), oDirectories)) {
+            fn_logWarning("EXIF block could not be parsed; not written to TIFF");
+            return;
+        }
+        
+        if (!oDirectories.vExif.empty() && TIFFCreateEXIFDirectory(pTiff) == 0) {
+            for (const sExifEntry& oEntry : oDirectories.vExif) {
+                fn_setTiffExifField(pTiff, oEntry);
+            }
+            if (!TIFFWriteCustomDirectory(pTiff, &ullExifIfd)) {
+                ullExifIfd = 0;
+            }
+        }
+        if (!oDirectories.vGps.empty() && TIFFCreateGPSDirectory(pTiff) == 0) {
+            for (const sExifEntry& oEntry : oDirectories.vGps) {
+                fn_setTiffExifField(pTiff, oEntry);
+            }
+            if (!TIFFWriteCustomDirectory(pTiff, &ullGpsIfd)) {
+                ullGpsIfd = 0;
+            }
+        }
+        if (ullExifIfd || ullGpsIfd) {
+            TIFFFreeDirectory(pTiff);
+            TIFFCreateDirectory(pTiff);
+        }
+        
+        for (const sExifEntry& oEntry : oDirectories.vIfd0) {
+            if (oEntry.uType == TIFF_ASCII &&
+                std::find(std::begin(aTIFF_TEXT_TAGS), std::end(aTIFF_TEXT_TAGS), oEntry.uTag) != std::end(aTIFF_TEXT_TAGS)) {
+                vText.push_back(oEntry);
+            }
+        }
+    }
+    // End Function fn_writeTiffExifDirectories
 }
-// End Function fn_encodeBMP
+#endif
 
 // TIFF encoding function
 bool FormatEncoder::fn_encodeTIFF(
     const sImageData& oImageData,
     const std::string& sOutputPath,
     const sEncodeOptions& oOptions
+) {
+    return fn_encodeTIFFRows(fn_makeImageStream(oImageData), sOutputPath, oOptions);
+}
+// End Function fn_encodeTIFF
+
+// TIFF row encoder: scanlines are written as each band arrives
+bool FormatEncoder::fn_encodeTIFFRows(
+    const sImageStream& oImageData,
+    const std::string& sOutputPath,
+    const sEncodeOptions& oOptions
 ) {
     #ifdef HAVE_TIFF
-    TIFF* pTiff = TIFFOpen(sOutputPath.c_str(), "w");
+    // BigTIFF once the raw pixels approach the 4 GB offset limit
+    size_t stRowBytes = static_cast<size_t>(oImageData.iWidth) * oImageData.iChannels * (oImageData.iBitDepth > 8 ? 2 : 1);
+    uint64_t ullRawBytes = static_cast<uint64_t>(stRowBytes) * oImageData.iHeight;
+    bool bBigTiff = ullRawBytes >= ullBIGTIFF_THRESHOLD;
+    
+    // libtiff seeks while writing, so it gets its own descriptor on the
+    // temporary file instead of the buffered stream
+    OutputFile oFile;
+    TIFF* pTiff = nullptr;
+    if (oFile.fn_open(sOutputPath, fn_estimateEncodedBytes(oImageData.iWidth, oImageData.iHeight,
+                                                           oImageData.iChannels, oImageData.iBitDepth, "tiff"))) {
+        int iTiffFd = dup(oFile.fn_getFd());
+        pTiff = iTiffFd >= 0 ? TIFFFdOpen(iTiffFd, sOutputPath.c_str(), bBigTiff ? "w8" : "w") : nullptr;
+        if (!pTiff && iTiffFd >= 0) {
+            close(iTiffFd);
+        }
+    }
     if (!pTiff) {
         fn_logError("Cannot open TIFF file for writing: " + sOutputPath);
         return false;
     }
     
+    // The Exif and GPS IFDs go first, as custom directories the image
+    // directory then points to
+    uint64_t ullExifIfd = 0;
+    uint64_t ullGpsIfd = 0;
+    std::vector<sExifEntry> vText;
+    if (oOptions.bPreserveMetadata && !oOptions.vExifData.empty()) {
+        fn_writeTiffExifDirectories(pTiff, oOptions.vExifData, ullExifIfd, ullGpsIfd, vText);
+    }
+    
     // Set basic tags
+    const sTiffOptions& oTiff = oOptions.oTiff;
+    uint32_t uRowsPerStrip = static_cast<uint32_t>(std::min<size_t>(oImageData.iHeight,
+                                                                    std::max<size_t>(1, stTIFF_STRIP_BYTES / stRowBytes)));
     TIFFSetField(pTiff, TIFFTAG_IMAGEWIDTH, oImageData.iWidth);
     TIFFSetField(pTiff, TIFFTAG_IMAGELENGTH, oImageData.iHeight);
-    TIFFSetField(pTiff, TIFFTAG_BITSPERSAMPLE, oImageData.iBitDepth);
+    TIFFSetField(pTiff, TIFFTAG_BITSPERSAMPLE, oImageData.iBitDepth > 8 ? 16 : 8);
     TIFFSetField(pTiff, TIFFTAG_SAMPLESPERPIXEL, oImageData.iChannels);
+    TIFFSetField(pTiff, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_UINT);
     TIFFSetField(pTiff, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
     TIFFSetField(pTiff, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
-    TIFFSetField(pTiff, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
-    TIFFSetField(pTiff, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
-    
-    // Set compression if specified
-    if (oOptions.iCompressionLevel > 0) {
-        if (oOptions.iCompressionLevel <= 3) {
-            TIFFSetField(pTiff, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
-        }
-        else if (oOptions.iCompressionLevel <= 6) {
-            TIFFSetField(pTiff, TIFFTAG_COMPRESSION, COMPRESSION_DEFLATE);
-        }
-        else {
-            TIFFSetField(pTiff, TIFFTAG_COMPRESSION, COMPRESSION_JPEG);
-        }
-    }
-    
-    // Set photometric based on channels
-    if (oImageData.iChannels == 1) {
-        TIFFSetField(pTiff, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
-    }
-    else if (oImageData.iChannels == 3 || oImageData.iChannels == 4) {
-        TIFFSetField(pTiff, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+    TIFFSetField(pTiff, TIFFTAG_PHOTOMETRIC, oImageData.iChannels <= 2 ? PHOTOMETRIC_MINISBLACK : PHOTOMETRIC_RGB);
+    TIFFSetField(pTiff, TIFFTAG_ROWSPERSTRIP, uRowsPerStrip);
+    
+    // The level now matters: Deflate strips are compressed here at oTiff.iLevel
+    int iCompression = oTiff.eCompression == eTiffCompression::Lzw ? COMPRESSION_LZW :
+                       oTiff.eCompression == eTiffCompression::Deflate ? COMPRESSION_ADOBE_DEFLATE : COMPRESSION_NONE;
+    bool bPredictor = oTiff.bPredictor && iCompression != COMPRESSION_NONE;
+    TIFFSetField(pTiff, TIFFTAG_COMPRESSION, iCompression);
+    if (bPredictor) {
+        TIFFSetField(pTiff, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
     }
     
     // Set extra samples for alpha
-    if (oImageData.iChannels == 4) {
+    if (oImageData.iChannels == 2 || oImageData.iChannels == 4) {
         uint16_t vExtraSamples = EXTRASAMPLE_ASSOCALPHA;
         TIFFSetField(pTiff, TIFFTAG_EXTRASAMPLES, 1, &vExtraSamples);
     }
     
-    // Write EXIF metadata if present
-    if (!oOptions.vExifData.empty() && oOptions.bPreserveMetadata) {
-        // TIFF can store EXIF data in tags
-        // For simplicity, we'll just note that we have it
-        fn_logInfo("EXIF metadata available for TIFF, but requires special handling");
+    // Metadata: text tags from the EXIF IFD0, sub-IFD pointers, ICC and XMP
+    for (const sExifEntry& oEntry : vText) {
+        std::string sText(reinterpret_cast<const char*>(oEntry.vValue.data()), oEntry.vValue.size());
+        TIFFSetField(pTiff, oEntry.uTag, sText.c_str());
+    }
+    if (ullExifIfd) {
+        TIFFSetField(pTiff, TIFFTAG_EXIFIFD, ullExifIfd);
+    }
+    if (ullGpsIfd) {
+        TIFFSetField(pTiff, TIFFTAG_GPSIFD, ullGpsIfd);
+    }
+    if (oOptions.bPreserveMetadata && !oOptions.vIccProfile.empty()) {
+        TIFFSetField(pTiff, TIFFTAG_ICCPROFILE, static_cast<uint32_t>(oOptions.vIccProfile.size()), oOptions.vIccProfile.data());
+    }
+    if (oOptions.bPreserveMetadata && !oOptions.vXmpData.empty()) {
+        TIFFSetField(pTiff, TIFFTAG_XMLPACKET, static_cast<uint32_t>(oOptions.vXmpData.size()), oOptions.vXmpData.data());
     }
     
-    // Write image data
-    int iRowSize = oImageData.iWidth * oImageData.iChannels * (oImageData.iBitDepth / 8);
-    for (int iRow = 0; iRow < oImageData.iHeight; iRow++) {
-        if (TIFFWriteScanline(pTiff, 
-            oImageData.pData + (iRow * iRowSize), 
-            iRow, 0) < 0) {
-            TIFFClose(pTiff);
-            fn_logError("Failed to write TIFF scanline");
-            return false;
+    // Rows are gathered into strips, a wave of strips at a time. Deflate
+    // and uncompressed strips are finished on the workers and written raw in
+    // order; LZW strips go through libtiff's codec. Associated alpha needs
+    // premultiplied colour.
+    bool bRawStrips = iCompression != COMPRESSION_LZW;
+    int iWave = bRawStrips && oOptions.iThreads > 1 ? oOptions.iThreads * 2 : 1;
+    TaskGroup oDeflate(iWave > 1 ? oOptions.iThreads : 1);
+    std::vector<sTiffStrip> vWave(iWave);
+    int iFilled = 0;
+    uint32_t uStrip = 0;
+    
+    auto fnWriteWave = [&]() {
+        for (int k = 0; k < iFilled; k++) {
+            sTiffStrip* pStrip = &vWave[k];
+            if (iCompression != COMPRESSION_ADOBE_DEFLATE) {
+                continue;
+            }
+            oDeflate.fn_submit([pStrip, stRowBytes, &oImageData, &oTiff]() {
+                fn_deflateTiffStrip(*pStrip, stRowBytes, oImageData.iWidth, oImageData.iChannels,
+                                    oImageData.iBitDepth, oTiff);
+            });
         }
-    }
+        oDeflate.fn_wait();
+        
+        for (int k = 0; k < iFilled; k++) {
+            sTiffStrip& oStrip = vWave[k];
+            tmsize_t iWritten = -1;
+            if (!oStrip.bOk) {
+                fn_logError("Failed to compress TIFF strip " + std::to_string(uStrip));
+                return false;
+            }
+            if (iCompression == COMPRESSION_ADOBE_DEFLATE) {
+                iWritten = TIFFWriteRawStrip(pTiff, uStrip, oStrip.vCompressed.data(),
+                                             static_cast<tmsize_t>(oStrip.vCompressed.size()));
+            } else if (bRawStrips) {
+                iWritten = TIFFWriteRawStrip(pTiff, uStrip, oStrip.vRaw.data(), static_cast<tmsize_t>(oStrip.stRawBytes));
+            } else {
+                iWritten = TIFFWriteEncodedStrip(pTiff, uStrip, oStrip.vRaw.data(), static_cast<tmsize_t>(oStrip.stRawBytes));
+            }
+            if (iWritten < 0) {
+                fn_logError("Failed to write TIFF strip " + std::to_string(uStrip));
+                return false;
+            }
+            uStrip++;
+            oStrip.stRawBytes = 0;
+        }
+        iFilled = 0;
+        return true;
+    };
     
+    uint32_t uRow = 0;
+    bool bRowsWritten = fn_forEachStreamRow(oImageData, [&](const unsigned char* pRow) {
+        sTiffStrip& oStrip = vWave[iFilled];
+        if (oStrip.vRaw.size() < stRowBytes * uRowsPerStrip) {
+            oStrip.vRaw.resize(stRowBytes * uRowsPerStrip);
+        }
+        unsigned char* pDst = oStrip.vRaw.data() + oStrip.stRawBytes;
+        bool bAlpha = oImageData.iChannels == 2 || oImageData.iChannels == 4;
+        if (bAlpha && oImageData.iBitDepth > 8) {
+            fn_premultiplyAlpha16(reinterpret_cast<const uint16_t*>(pRow), reinterpret_cast<uint16_t*>(pDst),
+                                  oImageData.iWidth, oImageData.iChannels, oImageData.iBitDepth);
+        } else if (bAlpha) {
+            fn_premultiplyAlpha(pRow, pDst, oImageData.iWidth, oImageData.iChannels);
+        } else {
+            memcpy(pDst, pRow, stRowBytes);
+        }
+        if (oImageData.iBitDepth > 8 && oImageData.iBitDepth < 16) {
+            // 10/12-bit samples widened to the full 16-bit range the tag declares
+            uint16_t* pSamples = reinterpret_cast<uint16_t*>(pDst);
+            int iShift = 16 - oImageData.iBitDepth;
+            for (size_t i = 0; i < stRowBytes / 2; i++) {
+                pSamples[i] = static_cast<uint16_t>((pSamples[i] << iShift) | (pSamples[i] >> (oImageData.iBitDepth - iShift)));
+            }
+        }
+        oStrip.stRawBytes += stRowBytes;
+        oStrip.bOk = true;
+        uRow++;
+        
+        // A strip is complete at its row count or the last row
+        if (oStrip.stRawBytes == stRowBytes * uRowsPerStrip || uRow == static_cast<uint32_t>(oImageData.iHeight)) {
+            iFilled++;
+            if (iFilled == iWave || uRow == static_cast<uint32_t>(oImageData.iHeight)) {
+                return fnWriteWave();
+            }
+        }
+        return true;
+    });
+    
+    bool bFlushed = bRowsWritten && TIFFFlush(pTiff) != 0;
     TIFFClose(pTiff);
+    if (!bFlushed) {
+        return false;
+    }
+    
+    if (!oFile.fn_commit(oOptions.oOutput)) {
+        fn_logError("Failed to finish writing: " + oFile.fn_getLastError());
+        return false;
+    }
     fn_logInfo("Successfully wrote TIFF: " + sOutputPath);
     return true;
     #else
+    (void)oImageData;
+    (void)sOutputPath;
+    (void)oOptions;
     fn_logError("TIFF support not compiled in");
     return false;
     #endif
 }
-// End Function fn_encodeTIFF
+// End Function fn_encodeTIFFRows
 
 // Check for PNG support
 bool FormatEncoder::fn_checkPNGSupport() {
@@ -2,7 +2,12 @@
 #include "heic_decoder.h"
 #include "logger.h"
 #include "file_utils.h"
+#include "heif_container.h"
+#include "heif_probe.h"
+#include "thread_pool.h"
+#include <atomic>
 #include <iostream>
+#include <mutex>
 #include <fstream>
 #include <cstring>
 #include <memory>
@@ -10,6 +15,96 @@
 
 #ifdef HAVE_LIBHEIF
 #include <libheif/heif.h>
+
+// Per-tile decoding of grid images arrived in libheif 1.19
+#if defined(LIBHEIF_NUMERIC_VERSION) && LIBHEIF_NUMERIC_VERSION >= LIBHEIF_MAKE_VERSION(1, 19, 0)
+#define HEIC_DECODER_TILE_API 1
+#endif
+
+#ifdef HEIC_DECODER_TILE_API
+namespace
+{
+    // Grid layout of the primary image, if it is a multi-tile grid
+    bool fn_queryGrid(struct heif_image_handle* pHandle, int iWidth, int iHeight, struct heif_image_tiling& oTiling)
+    {
+        struct heif_error err = heif_image_handle_get_image_tiling(pHandle, 1, &oTiling);
+        return err.code == heif_error_Ok && oTiling.num_columns * oTiling.num_rows > 1 &&
+               static_cast<int>(oTiling.image_width) == iWidth &&
+               static_cast<int>(oTiling.image_height) == iHeight;
+    } // End Function fn_queryGrid
+
+    // Decode tile rows [uFirstRow, uEndRow) into oDest, whose row 0 is image
+    // row iDestY0. Tiles are spread over iThreads threads (TaskGroup).
+    bool fn_decodeTileRows(struct heif_image_handle* pHandle, const struct heif_image_tiling& oTiling,
+                           uint32_t uFirstRow, uint32_t uEndRow, enum heif_chroma eChroma,
+                           int iThreads, ImageBuffer& oDest, int iDestY0, std::string& sError)
+    {
+        int iWidth = static_cast<int>(oTiling.image_width);
+        int iHeight = static_cast<int>(oTiling.image_height);
+        size_t stPixelBytes = static_cast<size_t>(oDest.fn_getChannels());
+        std::atomic<bool> bFailed(false);
+        std::mutex oErrorMutex;
+        
+        auto fnDecodeTile = [&](uint32_t tx, uint32_t ty)
+        {
+            if (bFailed.load(std::memory_order_relaxed))
+            {
+                return;
+            }
+            
+            struct heif_image* pTile = nullptr;
+            struct heif_error tileErr = heif_image_handle_decode_image_tile(pHandle, &pTile,
+                                            heif_colorspace_RGB, eChroma, nullptr, tx, ty);
+            int iTileStride = 0;
+            const uint8_t* pTileData = (tileErr.code == heif_error_Ok)
+                ? heif_image_get_plane_readonly(pTile, heif_channel_interleaved, &iTileStride)
+                : nullptr;
+            
+            if (!pTileData)
+            {
+                std::lock_guard<std::mutex> oLock(oErrorMutex);
+                if (!bFailed.exchange(true))
+                {
+                    sError = "Failed to decode tile " + std::to_string(tx) + "," + std::to_string(ty) +
+                             (tileErr.code != heif_error_Ok ? ": " + std::string(tileErr.message) : "");
+                }
+                if (pTile)
+                {
+                    heif_image_release(pTile);
+                }
+                return;
+            }
+            
+            // Edge tiles overhang the image; copy only the visible part
+            int iX0 = static_cast<int>(tx * oTiling.tile_width);
+            int iY0 = static_cast<int>(ty * oTiling.tile_height);
+            int iCopyW = std::min(heif_image_get_width(pTile, heif_channel_interleaved), iWidth - iX0);
+            int iCopyH = std::min(heif_image_get_height(pTile, heif_channel_interleaved), iHeight - iY0);
+            
+            for (int row = 0; row < iCopyH; row++)
+            {
+                memcpy(oDest.fn_getRow(iY0 - iDestY0 + row) + iX0 * stPixelBytes,
+                       pTileData + static_cast<size_t>(row) * iTileStride,
+                       iCopyW * stPixelBytes);
+            }
+            
+            heif_image_release(pTile);
+        };
+        
+        TaskGroup oTiles(iThreads);
+        for (uint32_t ty = uFirstRow; ty < uEndRow; ty++)
+        {
+            for (uint32_t tx = 0; tx < oTiling.num_columns; tx++)
+            {
+                oTiles.fn_submit([&fnDecodeTile, tx, ty]() { fnDecodeTile(tx, ty); });
+            }
+        }
+        oTiles.fn_wait();
+        
+        return !bFailed.load();
+    } // End Function fn_decodeTileRows
+}
+#endif
 #endif
 
 // Constructor
@@ -24,8 +119,6 @@ HeicDecoder::HeicDecoder()
     
     #ifdef HAVE_LIBHEIF
     // Initialize libheif members
-    pHeifContext = nullptr;
-    pHeifHandle = nullptr;
     pHeifImage = nullptr;
     
     // Libheif doesn't require explicit initialization
@@ -37,6 +130,8 @@ HeicDecoder::HeicDecoder()
     #endif
     
     m_pLogger = nullptr;  // Initialize logger pointer
+    m_iTileThreads = 1;
+    m_iMaxDimension = 0;
 } // End Function HeicDecoder::HeicDecoder
 
 // Destructor
@@ -54,54 +149,67 @@ HeicDecoder::~HeicDecoder()
     #endif
 } // End Function HeicDecoder::~HeicDecoder
 
-#ifdef HAVE_LIBHEIF
-// Cleanup libheif resources
-void HeicDecoder::fn_cleanupLibHeif()
+// Set the number of tile decode workers
+void HeicDecoder::fn_setTileThreads(int iThreads)
 {
-    if (pHeifImage)
+    m_iTileThreads = std::max(1, iThreads);
+} // End Function HeicDecoder::fn_setTileThreads
+
+// Set the preview size limit
+void HeicDecoder::fn_setMaxDimension(int iMaxDimension)
+{
+    m_iMaxDimension = std::max(0, iMaxDimension);
+} // End Function HeicDecoder::fn_setMaxDimension
+
+// Shrink a decoded image so its longer side fits m_iMaxDimension
+bool HeicDecoder::fn_fitToMaxDimension(oDecodedImage& oResult)
+{
+    if (m_iMaxDimension <= 0 || std::max(oResult.iWidth, oResult.iHeight) <= m_iMaxDimension)
     {
-        heif_image_release(pHeifImage);
-        pHeifImage = nullptr;
+        return true;
     }
     
-    if (pHeifHandle)
+    ImageBuffer oShrunk = fn_shrinkToFit(oResult.oPixels, m_iMaxDimension);
+    if (oShrunk.fn_isEmpty())
     {
-        heif_image_handle_release(pHeifHandle);
-        pHeifHandle = nullptr;
+        oResult.sError = "Failed to allocate preview buffer";
+        return false;
     }
     
-    if (pHeifContext)
+    oResult.oPixels = std::move(oShrunk);
+    oResult.iWidth = oResult.oPixels.fn_getWidth();
+    oResult.iHeight = oResult.oPixels.fn_getHeight();
+    return true;
+} // End Function HeicDecoder::fn_fitToMaxDimension
+
+#ifdef HAVE_LIBHEIF
+// Cleanup libheif resources
+void HeicDecoder::fn_cleanupLibHeif()
+{
+    if (pHeifImage)
     {
-        heif_context_free(pHeifContext);
-        pHeifContext = nullptr;
+        heif_image_release(pHeifImage);
+        pHeifImage = nullptr;
     }
 }
 
 // Decode with libheif - SIMPLIFIED VERSION FOR DEBIAN 12
-bool HeicDecoder::fn_decodeWithLibHeif(const std::vector<unsigned char>& vData, oDecodedImage& oResult)
+bool HeicDecoder::fn_decodeWithLibHeif(const HeifContainer& oContainer, oDecodedImage& oResult)
 {
     fn_cleanupLibHeif();
     
-    pHeifContext = heif_context_alloc();
-    if (!pHeifContext)
+    struct heif_image_handle* pPrimaryHandle = oContainer.fn_getPrimaryHandle();
+    if (!pPrimaryHandle)
     {
-        oResult.sError = "Failed to allocate HEIF context";
+        oResult.sError = "No primary image handle: " + oContainer.fn_getLastError();
         return false;
     }
     
-    struct heif_error err = heif_context_read_from_memory(pHeifContext, vData.data(), vData.size(), nullptr);
-    if (err.code != heif_error_Ok)
-    {
-        oResult.sError = "Failed to read HEIF data: " + std::string(err.message);
-        return false;
-    }
-    
-    err = heif_context_get_primary_image_handle(pHeifContext, &pHeifHandle);
-    if (err.code != heif_error_Ok)
-    {
-        oResult.sError = "Failed to get primary image handle: " + std::string(err.message);
-        return false;
-    }
+    // Preview mode: decode a stored thumbnail when one is big enough
+    struct heif_image_handle* pThumbnail = m_iMaxDimension > 0 ? fn_selectThumbnail(pPrimaryHandle) : nullptr;
+    std::unique_ptr<struct heif_image_handle, void (*)(struct heif_image_handle*)>
+        pThumbnailOwner(pThumbnail, [](struct heif_image_handle* p) { if (p) heif_image_handle_release(p); });
+    struct heif_image_handle* pHeifHandle = pThumbnail ? pThumbnail : pPrimaryHandle;
     
     oResult.iWidth = heif_image_handle_get_width(pHeifHandle);
     oResult.iHeight = heif_image_handle_get_height(pHeifHandle);
@@ -117,8 +225,18 @@ bool HeicDecoder::fn_decodeWithLibHeif(const std::vector<unsigned char>& vData,
         // Note: We can't log without logger, so we'll just note it
     }
     
+    // Grid images (every iPhone HEIC) decode tile by tile across the pool
+    if (!pThumbnail && m_iTileThreads > 1 && fn_decodeTiled(pHeifHandle, oResult))
+    {
+        return true;
+    }
+    
+    // Whole-image decode (also the retry if a tile failed); libheif may
+    // still split grid tiles across its own threads
+    heif_context_set_max_decoding_threads(oContainer.fn_getContext(), m_iTileThreads);
+    
     // Try to decode with default options
-    err = heif_decode_image(pHeifHandle, &pHeifImage,
+    struct heif_error err = heif_decode_image(pHeifHandle, &pHeifImage,
                            heif_colorspace_RGB,
                            oResult.bHasAlpha ? heif_chroma_interleaved_RGBA : heif_chroma_interleaved_RGB,
                            nullptr);
@@ -130,29 +248,266 @@ bool HeicDecoder::fn_decodeWithLibHeif(const std::vector<unsigned char>& vData,
     }
     
     int stride;
-    const uint8_t* pData = heif_image_get_plane_readonly(pHeifImage, heif_channel_interleaved, &stride);
+    uint8_t* pData = heif_image_get_plane(pHeifImage, heif_channel_interleaved, &stride);
     if (!pData)
     {
         oResult.sError = "Failed to get image plane";
         return false;
     }
     
-    // For panoramas, we need to handle the stride properly
-    size_t dataSize = oResult.iHeight * stride;
-    oResult.vData.resize(dataSize);
+    // Borrow the plane instead of copying it; the buffer now owns the
+    // heif_image and releases it when the last reference goes away
+    std::shared_ptr<void> pOwner(pHeifImage, [](void* p) { heif_image_release(static_cast<struct heif_image*>(p)); });
+    pHeifImage = nullptr;
+    
+    oResult.oPixels = ImageBuffer::fn_wrap(pData, oResult.iWidth, oResult.iHeight, static_cast<size_t>(stride),
+                                           oResult.iChannels, 8, std::move(pOwner));
+    
+    return true;
+}
+
+// Decode the tiles of a grid image concurrently into one buffer
+bool HeicDecoder::fn_decodeTiled(struct heif_image_handle* pHandle, oDecodedImage& oResult)
+{
+    #ifdef HEIC_DECODER_TILE_API
+    struct heif_image_tiling oTiling;
+    if (!fn_queryGrid(pHandle, oResult.iWidth, oResult.iHeight, oTiling))
+    {
+        return false;
+    }
+    
+    ImageBuffer oPixels = ImageBuffer::fn_allocate(oResult.iWidth, oResult.iHeight, oResult.iChannels);
+    if (oPixels.fn_isEmpty())
+    {
+        sLastError = "Failed to allocate image buffer";
+        return false;
+    }
     
-    // Copy data row by row to handle stride
-    for (int row = 0; row < oResult.iHeight; row++)
+    enum heif_chroma eChroma = oResult.bHasAlpha ? heif_chroma_interleaved_RGBA : heif_chroma_interleaved_RGB;
+    if (!fn_decodeTileRows(pHandle, oTiling, 0, oTiling.num_rows, eChroma, m_iTileThreads, oPixels, 0, sLastError))
     {
-        const uint8_t* src_row = pData + (row * stride);
-        uint8_t* dst_row = oResult.vData.data() + (row * oResult.iWidth * oResult.iChannels);
-        memcpy(dst_row, src_row, oResult.iWidth * oResult.iChannels);
+        return false;
     }
     
+    oResult.oPixels = std::move(oPixels);
     return true;
-}
+    #else
+    (void)pHandle;
+    (void)oResult;
+    return false;
+    #endif
+} // End Function HeicDecoder::fn_decodeTiled
+
+// Pick the smallest thumbnail whose longer side still reaches m_iMaxDimension
+struct heif_image_handle* HeicDecoder::fn_selectThumbnail(struct heif_image_handle* pPrimary)
+{
+    int iCount = heif_image_handle_get_number_of_thumbnails(pPrimary);
+    if (iCount <= 0)
+    {
+        return nullptr;
+    }
+    
+    std::vector<heif_item_id> vIds(static_cast<size_t>(iCount));
+    iCount = heif_image_handle_get_list_of_thumbnail_IDs(pPrimary, vIds.data(), iCount);
+    
+    struct heif_image_handle* pBest = nullptr;
+    int iBestSide = 0;
+    for (int i = 0; i < iCount; i++)
+    {
+        struct heif_image_handle* pThumbnail = nullptr;
+        struct heif_error err = heif_image_handle_get_thumbnail(pPrimary, vIds[i], &pThumbnail);
+        if (err.code != heif_error_Ok || !pThumbnail)
+        {
+            continue;
+        }
+        
+        int iSide = std::max(heif_image_handle_get_width(pThumbnail), heif_image_handle_get_height(pThumbnail));
+        if (iSide >= m_iMaxDimension && (!pBest || iSide < iBestSide))
+        {
+            if (pBest)
+            {
+                heif_image_handle_release(pBest);
+            }
+            pBest = pThumbnail;
+            iBestSide = iSide;
+        }
+        else
+        {
+            heif_image_handle_release(pThumbnail);
+        }
+    }
+    
+    if (pBest && m_pLogger)
+    {
+        m_pLogger->fn_logInfo("Using " + std::to_string(iBestSide) + " px thumbnail for preview");
+    }
+    
+    return pBest;
+} // End Function HeicDecoder::fn_selectThumbnail
+
+#endif
+
+// Expose a grid image as a stream of tile rows for scanline encoders
+bool HeicDecoder::fn_openTileRowStream(const HeifContainer& oContainer, sImageStream& oStream)
+{
+    #ifdef HEIC_DECODER_TILE_API
+    struct heif_image_handle* pHandle = oContainer.fn_getPrimaryHandle();
+    if (!pHandle)
+    {
+        return false;
+    }
+    
+    int iWidth = heif_image_handle_get_width(pHandle);
+    int iHeight = heif_image_handle_get_height(pHandle);
+    bool bHasAlpha = heif_image_handle_has_alpha_channel(pHandle);
+    
+    struct heif_image_tiling oTiling;
+    if (!fn_queryGrid(pHandle, iWidth, iHeight, oTiling))
+    {
+        return false;
+    }
+    
+    // One band of tile_height rows is reused for every tile row
+    ImageBuffer oBand = ImageBuffer::fn_allocate(iWidth, static_cast<int>(oTiling.tile_height), bHasAlpha ? 4 : 3);
+    if (oBand.fn_isEmpty())
+    {
+        sLastError = "Failed to allocate tile row buffer";
+        return false;
+    }
+    
+    int iThreads = m_iTileThreads;
+    enum heif_chroma eChroma = bHasAlpha ? heif_chroma_interleaved_RGBA : heif_chroma_interleaved_RGB;
+    std::shared_ptr<uint32_t> pNextRow = std::make_shared<uint32_t>(0);
+    std::string* pError = &sLastError;
+    
+    oStream.iWidth = iWidth;
+    oStream.iHeight = iHeight;
+    oStream.iChannels = oBand.fn_getChannels();
+    oStream.iBitDepth = 8;
+    oStream.fnNextBand = [pHandle, oTiling, eChroma, iThreads, oBand, pNextRow, pError](ImageBuffer& oOut) mutable
+    {
+        uint32_t uRow = *pNextRow;
+        if (uRow >= oTiling.num_rows)
+        {
+            return false;
+        }
+        
+        if (!fn_decodeTileRows(pHandle, oTiling, uRow, uRow + 1, eChroma, iThreads, oBand,
+                               static_cast<int>(uRow * oTiling.tile_height), *pError))
+        {
+            return false;
+        }
+        
+        (*pNextRow)++;
+        oOut = oBand;
+        return true;
+    };
+    
+    return true;
+    #else
+    (void)oContainer;
+    (void)oStream;
+    return false;
+    #endif
+} // End Function HeicDecoder::fn_openTileRowStream
+
+#ifdef HAVE_LIBHEIF
+// JPEG and WebP both use the BT.601 matrix for YCbCr
+static bool fn_isBt601(const struct heif_color_profile_nclx* pNclx)
+{
+    return pNclx->matrix_coefficients == heif_matrix_coefficients_ITU_R_BT_601_6 ||
+           pNclx->matrix_coefficients == heif_matrix_coefficients_ITU_R_BT_470_6_System_B_G;
+} // End Function fn_isBt601
 #endif
 
+// Decode straight to YCbCr 4:2:0 planes for JPEG/WebP
+bool HeicDecoder::fn_decodePlanar(const HeifContainer& oContainer, sPlanarImage& oPlanar)
+{
+    #ifdef HAVE_LIBHEIF
+    struct heif_image_handle* pHandle = oContainer.fn_getPrimaryHandle();
+    if (!pHandle || heif_image_handle_has_alpha_channel(pHandle) ||
+        heif_image_handle_get_luma_bits_per_pixel(pHandle) != 8)
+    {
+        return false;
+    }
+    
+    // A colr box with another matrix needs libheif's RGB conversion
+    struct heif_color_profile_nclx* pNclx = nullptr;
+    if (heif_image_handle_get_nclx_color_profile(pHandle, &pNclx).code == heif_error_Ok && pNclx)
+    {
+        bool bBt601 = fn_isBt601(pNclx);
+        heif_nclx_color_profile_free(pNclx);
+        if (!bBt601)
+        {
+            return false;
+        }
+    }
+    
+    heif_context_set_max_decoding_threads(oContainer.fn_getContext(), m_iTileThreads);
+    
+    // Decode in the bitstream's own layout: asking for 4:2:0 would have
+    // libheif subsample 4:4:4 and 4:2:2 sources without a word
+    struct heif_image* pImage = nullptr;
+    struct heif_error err = heif_decode_image(pHandle, &pImage, heif_colorspace_undefined, heif_chroma_undefined, nullptr);
+    if (err.code != heif_error_Ok || !pImage)
+    {
+        sLastError = "Failed to decode YCbCr planes: " + std::string(err.message ? err.message : "");
+        return false;
+    }
+    
+    std::shared_ptr<void> pOwner(pImage, [](void* p) { heif_image_release(static_cast<struct heif_image*>(p)); });
+    
+    if (heif_image_get_colorspace(pImage) != heif_colorspace_YCbCr ||
+        heif_image_get_chroma_format(pImage) != heif_chroma_420)
+    {
+        return false;
+    }
+    
+    // The decoded image carries the bitstream's own colour description;
+    // without one libheif assumes full-range BT.601
+    bool bFullRange = true;
+    struct heif_color_profile_nclx* pImageNclx = nullptr;
+    if (heif_image_get_nclx_color_profile(pImage, &pImageNclx).code == heif_error_Ok && pImageNclx)
+    {
+        bool bBt601 = fn_isBt601(pImageNclx);
+        bFullRange = pImageNclx->full_range_flag != 0;
+        heif_nclx_color_profile_free(pImageNclx);
+        if (!bBt601)
+        {
+            return false;
+        }
+    }
+    
+    if (heif_image_get_bits_per_pixel_range(pImage, heif_channel_Y) != 8)
+    {
+        return false;
+    }
+    
+    const enum heif_channel aeChannels[3] = {heif_channel_Y, heif_channel_Cb, heif_channel_Cr};
+    for (int c = 0; c < 3; c++)
+    {
+        int iStride = 0;
+        oPlanar.apPlane[c] = heif_image_get_plane_readonly(pImage, aeChannels[c], &iStride);
+        oPlanar.astStride[c] = static_cast<size_t>(iStride);
+        if (!oPlanar.apPlane[c])
+        {
+            oPlanar = sPlanarImage();
+            return false;
+        }
+    }
+    
+    oPlanar.iWidth = heif_image_get_width(pImage, heif_channel_Y);
+    oPlanar.iHeight = heif_image_get_height(pImage, heif_channel_Y);
+    oPlanar.bFullRange = bFullRange;
+    oPlanar.pOwner = std::move(pOwner);
+    return true;
+    #else
+    (void)oContainer;
+    (void)oPlanar;
+    return false;
+    #endif
+} // End Function HeicDecoder::fn_decodePlanar
+
 #ifndef HAVE_LIBHEIF
 // Initialize embedded codecs (only if libheif not available)
 bool HeicDecoder::fn_initializeEmbeddedCodecs()
@@ -165,7 +520,7 @@ bool HeicDecoder::fn_initializeEmbeddedCodecs()
 #endif
 
 // Fallback dummy decoder
-oDecodedImage HeicDecoder::fn_decodeDummy(const std::vector<unsigned char>& vData)
+oDecodedImage HeicDecoder::fn_decodeDummy()
 {
     oDecodedImage oResult;
     
@@ -176,15 +531,21 @@ oDecodedImage HeicDecoder::fn_decodeDummy(const std::vector<unsigned char>& vDat
     oResult.sColorSpace = "sRGB";
     oResult.bHasAlpha = false;
     
-    oResult.vData.resize(oResult.iWidth * oResult.iHeight * oResult.iChannels);
+    oResult.oPixels = ImageBuffer::fn_allocate(oResult.iWidth, oResult.iHeight, oResult.iChannels);
+    if (oResult.oPixels.fn_isEmpty())
+    {
+        oResult.sError = "Failed to allocate image buffer";
+        return oResult;
+    }
+    
     for (int y = 0; y < oResult.iHeight; y++)
     {
+        unsigned char* pRow = oResult.oPixels.fn_getRow(y);
         for (int x = 0; x < oResult.iWidth; x++)
         {
-            int iIndex = (y * oResult.iWidth + x) * 3;
-            oResult.vData[iIndex] = static_cast<unsigned char>((x * 255) / oResult.iWidth);
-            oResult.vData[iIndex + 1] = static_cast<unsigned char>((y * 255) / oResult.iHeight);
-            oResult.vData[iIndex + 2] = 128;
+            pRow[x * 3] = static_cast<unsigned char>((x * 255) / oResult.iWidth);
+            pRow[x * 3 + 1] = static_cast<unsigned char>((y * 255) / oResult.iHeight);
+            pRow[x * 3 + 2] = 128;
         }
     }
     
@@ -216,17 +577,17 @@ oDecodedImage HeicDecoder::fn_decodeFile(const std::string& sFilePath)
         return oResult;
     }
     
-    // Read file into memory
-    std::vector<unsigned char> vFileData = fn_readBinaryFile(sFilePath);
-    if (vFileData.empty())
+    // Read and parse the file once
+    HeifContainer oContainer;
+    if (!oContainer.fn_openFile(sFilePath) && oContainer.fn_getFileSize() == 0)
     {
         oResult.sError = "Failed to read file: " + sFilePath;
         sLastError = oResult.sError;
         return oResult;
     }
     
-    // Decode from memory
-    oResult = fn_decodeMemory(vFileData);
+    // Decode from the parsed container
+    oResult = fn_decodeContainer(oContainer);
     if (!oResult.sError.empty())
     {
         sLastError = oResult.sError;
@@ -249,9 +610,22 @@ oDecodedImage HeicDecoder::fn_decodeMemory(const std::vector<unsigned char>& vDa
         return oResult;
     }
     
+    // Parse in place; vData outlives the container
+    HeifContainer oContainer;
+    oContainer.fn_openMemory(vData.data(), vData.size());
+    
+    return fn_decodeContainer(oContainer);
+} // End Function HeicDecoder::fn_decodeMemory
+
+// Decode the primary image of an already parsed container
+oDecodedImage HeicDecoder::fn_decodeContainer(const HeifContainer& oContainer)
+{
+    oDecodedImage oResult;
+    oResult.sError = "";
+    
     #ifdef HAVE_LIBHEIF
     // Use libheif for decoding
-    if (fn_decodeWithLibHeif(vData, oResult))
+    if (fn_decodeWithLibHeif(oContainer, oResult) && fn_fitToMaxDimension(oResult))
     {
         return oResult;
     }
@@ -271,58 +645,78 @@ oDecodedImage HeicDecoder::fn_decodeMemory(const std::vector<unsigned char>& vDa
     #endif
     
     // Fallback to dummy decoder
-    return fn_decodeDummy(vData);
-} // End Function HeicDecoder::fn_decodeMemory
+    return fn_decodeDummy();
+} // End Function HeicDecoder::fn_decodeContainer
 
-// Get image information
-oHeicInfo HeicDecoder::fn_getImageInfo(const std::string& sFilePath)
+// Map a container probe onto the public info struct
+static oHeicInfo fn_makeHeicInfo(const sHeifProbe& oProbe)
 {
-    oHeicInfo oInfo;
+    oHeicInfo oInfo = oHeicInfo();
     
-    // Simple implementation for now
-    if (!fn_fileExists(sFilePath))
+    const std::string& sBrand = oProbe.sBrand;
+    if (sBrand == "avif" || sBrand == "avis")
+    {
+        oInfo.sFormat = "AVIF";
+    }
+    else if (sBrand.compare(0, 3, "hei") == 0 || sBrand.compare(0, 3, "hev") == 0)
+    {
+        oInfo.sFormat = "HEIC";
+    }
+    else
     {
-        sLastError = "File does not exist: " + sFilePath;
-        return oInfo;
+        oInfo.sFormat = "HEIF";
     }
     
-    // Get basic info from filename
-    std::string ext = fn_getFileExtension(sFilePath);
-    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-    oInfo.sFormat = (ext == "heic") ? "HEIC" : "HEIF";
+    // Report the size a decode produces (libheif applies irot)
+    oInfo.iWidth = oProbe.iDisplayWidth;
+    oInfo.iHeight = oProbe.iDisplayHeight;
+    oInfo.iBitDepth = oProbe.iBitDepth;
+    oInfo.sColorSpace = fn_getProbeColorSpace(oProbe);
+    oInfo.bHasAlpha = oProbe.bHasAlpha;
+    oInfo.iOrientation = oProbe.iExifOrientation > 0 ? oProbe.iExifOrientation : 1;
     
-    // Default values
-    oInfo.iWidth = 1920;
-    oInfo.iHeight = 1080;
-    oInfo.iBitDepth = 8;
-    oInfo.sColorSpace = "sRGB";
-    oInfo.bHasAlpha = false;
-    oInfo.iOrientation = 1;
+    if (oProbe.bHasExif)
+    {
+        oInfo.vsMetadata.push_back("EXIF");
+    }
+    if (oProbe.bHasXmp)
+    {
+        oInfo.vsMetadata.push_back("XMP");
+    }
+    if (oProbe.sColorType == "prof" || oProbe.sColorType == "rICC")
+    {
+        oInfo.vsMetadata.push_back("ICC");
+    }
     
     return oInfo;
+} // End Function fn_makeHeicInfo
+
+// Get image information from the container boxes (no pixel decoding)
+oHeicInfo HeicDecoder::fn_getImageInfo(const std::string& sFilePath)
+{
+    sHeifProbe oProbe;
+    std::string sError;
+    if (!fn_probeHeifFile(sFilePath, oProbe, sError))
+    {
+        sLastError = sError;
+        return oHeicInfo();
+    }
+    
+    return fn_makeHeicInfo(oProbe);
 } // End Function HeicDecoder::fn_getImageInfo
 
-// Get image info from memory
+// Get image info from memory (no pixel decoding)
 oHeicInfo HeicDecoder::fn_getImageInfoFromMemory(const std::vector<unsigned char>& vData)
 {
-    oHeicInfo oInfo;
-    
-    if (vData.empty())
+    sHeifProbe oProbe;
+    std::string sError;
+    if (!fn_probeHeifMemory(vData.data(), vData.size(), oProbe, sError))
     {
-        sLastError = "Input data is empty";
-        return oInfo;
+        sLastError = sError;
+        return oHeicInfo();
     }
     
-    // Simple implementation
-    oInfo.sFormat = "HEIF";
-    oInfo.iWidth = 800;
-    oInfo.iHeight = 600;
-    oInfo.iBitDepth = 8;
-    oInfo.sColorSpace = "sRGB";
-    oInfo.bHasAlpha = false;
-    oInfo.iOrientation = 1;
-    
-    return oInfo;
+    return fn_makeHeicInfo(oProbe);
 } // End Function HeicDecoder::fn_getImageInfoFromMemory
 
 // Check if format is supported
@@ -0,0 +1,286 @@
+// heif_container.cpp - Parsed HEIF/HEIC container implementation
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "heif_container.h"
+#include "logger.h"
+#include <cstring>
+
+// Constructor
+HeifContainer::HeifContainer()
+    : pFileData(nullptr),
+      stFileSize(0)
+{
+    #ifdef HAVE_LIBHEIF
+    pHeifContext = nullptr;
+    pPrimaryHandle = nullptr;
+    #else
+    bOpen = false;
+    #endif
+} // End Function HeifContainer::HeifContainer
+
+// Destructor
+HeifContainer::~HeifContainer()
+{
+    fn_close();
+} // End Function HeifContainer::~HeifContainer
+
+// Release the parsed context and any mapped bytes
+void HeifContainer::fn_close()
+{
+    fn_releaseContext();
+    oInput.fn_close();
+    pFileData = nullptr;
+    stFileSize = 0;
+} // End Function HeifContainer::fn_close
+
+// Release the parsed context only (file bytes stay for the caller)
+void HeifContainer::fn_releaseContext()
+{
+    #ifdef HAVE_LIBHEIF
+    if (pPrimaryHandle)
+    {
+        heif_image_handle_release(pPrimaryHandle);
+        pPrimaryHandle = nullptr;
+    }
+
+    if (pHeifContext)
+    {
+        heif_context_free(pHeifContext);
+        pHeifContext = nullptr;
+    }
+    #else
+    bOpen = false;
+    #endif
+} // End Function HeifContainer::fn_releaseContext
+
+// Map a file once and parse it in place
+bool HeifContainer::fn_openFile(const std::string& sFilePath, eMapAccess eAccess)
+{
+    fn_close();
+
+    if (!oInput.fn_open(sFilePath, eAccess))
+    {
+        sLastError = "Failed to read file: " + oInput.fn_getLastError();
+        return false;
+    }
+
+    // libheif reads straight from the mapping; nothing is copied to the heap
+    pFileData = oInput.fn_getData();
+    stFileSize = oInput.fn_getSize();
+
+    return fn_parse(pFileData, stFileSize);
+} // End Function HeifContainer::fn_openFile
+
+// Parse an in-memory HEIF file without copying it
+bool HeifContainer::fn_openMemory(const unsigned char* pData, size_t stSize)
+{
+    fn_close();
+    pFileData = pData;
+    stFileSize = stSize;
+    return fn_parse(pData, stSize);
+} // End Function HeifContainer::fn_openMemory
+
+// Parse the box structure and locate the primary image
+bool HeifContainer::fn_parse(const unsigned char* pData, size_t stSize)
+{
+    #ifdef HAVE_LIBHEIF
+    if (!pData || stSize == 0)
+    {
+        sLastError = "Input data is empty";
+        return false;
+    }
+
+    pHeifContext = heif_context_alloc();
+    if (!pHeifContext)
+    {
+        sLastError = "Failed to allocate HEIF context";
+        return false;
+    }
+
+    struct heif_error err = heif_context_read_from_memory_without_copy(pHeifContext, pData, stSize, nullptr);
+    if (err.code != heif_error_Ok)
+    {
+        sLastError = "Failed to read HEIF data: " + std::string(err.message);
+        fn_releaseContext();
+        return false;
+    }
+
+    err = heif_context_get_primary_image_handle(pHeifContext, &pPrimaryHandle);
+    if (err.code != heif_error_Ok)
+    {
+        sLastError = "Failed to get primary image handle: " + std::string(err.message);
+        pPrimaryHandle = nullptr;
+        fn_releaseContext();
+        return false;
+    }
+
+    sLastError = "";
+    return true;
+    #else
+    if (!pData || stSize == 0)
+    {
+        sLastError = "Input data is empty";
+        return false;
+    }
+
+    bOpen = true;
+    sLastError = "";
+    return true;
+    #endif
+} // End Function HeifContainer::fn_parse
+
+// Check if a file is open
+bool HeifContainer::fn_isOpen() const
+{
+    #ifdef HAVE_LIBHEIF
+    return pPrimaryHandle != nullptr;
+    #else
+    return bOpen;
+    #endif
+} // End Function HeifContainer::fn_isOpen
+
+// Get last error
+std::string HeifContainer::fn_getLastError() const
+{
+    return sLastError;
+} // End Function HeifContainer::fn_getLastError
+
+// Get the raw file bytes
+const unsigned char* HeifContainer::fn_getFileData() const
+{
+    return pFileData;
+} // End Function HeifContainer::fn_getFileData
+
+// Get the raw file size
+size_t HeifContainer::fn_getFileSize() const
+{
+    return stFileSize;
+} // End Function HeifContainer::fn_getFileSize
+
+// Get primary image width
+int HeifContainer::fn_getWidth() const
+{
+    #ifdef HAVE_LIBHEIF
+    return pPrimaryHandle ? heif_image_handle_get_width(pPrimaryHandle) : 0;
+    #else
+    return 0;
+    #endif
+} // End Function HeifContainer::fn_getWidth
+
+// Get primary image height
+int HeifContainer::fn_getHeight() const
+{
+    #ifdef HAVE_LIBHEIF
+    return pPrimaryHandle ? heif_image_handle_get_height(pPrimaryHandle) : 0;
+    #else
+    return 0;
+    #endif
+} // End Function HeifContainer::fn_getHeight
+
+// Check if primary image has alpha
+bool HeifContainer::fn_hasAlpha() const
+{
+    #ifdef HAVE_LIBHEIF
+    return pPrimaryHandle && heif_image_handle_has_alpha_channel(pPrimaryHandle);
+    #else
+    return false;
+    #endif
+} // End Function HeifContainer::fn_hasAlpha
+
+#ifdef HAVE_LIBHEIF
+// Read the first metadata block of a type (and optional content type)
+std::vector<unsigned char> HeifContainer::fn_getMetadata(const char* pType, const char* pContentType) const
+{
+    std::vector<unsigned char> vBlock;
+
+    if (!pPrimaryHandle)
+    {
+        return vBlock;
+    }
+
+    int iCount = heif_image_handle_get_number_of_metadata_blocks(pPrimaryHandle, pType);
+    if (iCount <= 0)
+    {
+        return vBlock;
+    }
+
+    std::vector<heif_item_id> vIds(iCount);
+    heif_image_handle_get_list_of_metadata_block_IDs(pPrimaryHandle, pType, vIds.data(), iCount);
+
+    for (heif_item_id iId : vIds)
+    {
+        if (pContentType)
+        {
+            const char* pItemContent = heif_image_handle_get_metadata_content_type(pPrimaryHandle, iId);
+            if (!pItemContent || !strstr(pItemContent, pContentType))
+            {
+                continue;
+            }
+        }
+
+        vBlock.resize(heif_image_handle_get_metadata_size(pPrimaryHandle, iId));
+        struct heif_error err = heif_image_handle_get_metadata(pPrimaryHandle, iId, vBlock.data());
+        if (err.code != heif_error_Ok)
+        {
+            vBlock.clear();
+        }
+        break;
+    }
+
+    return vBlock;
+} // End Function HeifContainer::fn_getMetadata
+#endif
+
+// Get raw EXIF block (4-byte TIFF header offset followed by the payload)
+std::vector<unsigned char> HeifContainer::fn_getExifBlock() const
+{
+    #ifdef HAVE_LIBHEIF
+    return fn_getMetadata("Exif", nullptr);
+    #else
+    return std::vector<unsigned char>();
+    #endif
+} // End Function HeifContainer::fn_getExifBlock
+
+// Get XMP packet
+std::vector<unsigned char> HeifContainer::fn_getXmpBlock() const
+{
+    #ifdef HAVE_LIBHEIF
+    return fn_getMetadata("mime", "application/rdf+xml");
+    #else
+    return std::vector<unsigned char>();
+    #endif
+} // End Function HeifContainer::fn_getXmpBlock
+
+// Get embedded ICC profile (empty when the file uses an nclx colour box)
+std::vector<unsigned char> HeifContainer::fn_getIccProfile() const
+{
+    std::vector<unsigned char> vProfile;
+
+    #ifdef HAVE_LIBHEIF
+    if (!pPrimaryHandle)
+    {
+        return vProfile;
+    }
+
+    enum heif_color_profile_type eType = heif_image_handle_get_color_profile_type(pPrimaryHandle);
+    if (eType != heif_color_profile_type_prof && eType != heif_color_profile_type_rICC)
+    {
+        return vProfile;
+    }
+
+    vProfile.resize(heif_image_handle_get_raw_color_profile_size(pPrimaryHandle));
+    if (vProfile.empty())
+    {
+        return vProfile;
+    }
+
+    struct heif_error err = heif_image_handle_get_raw_color_profile(pPrimaryHandle, vProfile.data());
+    if (err.code != heif_error_Ok)
+    {
+        vProfile.clear();
+    }
+    #endif
+
+    return vProfile;
+} // End Function HeifContainer::fn_getIccProfile
@@ -0,0 +1,1057 @@
+// heif_probe.cpp - Header-only HEIF/HEIC image probe implementation
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "heif_probe.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <set>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+const size_t stHEAD_BYTES = 64 * 1024;            // First read; holds ftyp and meta in practice
+const size_t stMAX_META_BYTES = 16 * 1024 * 1024; // Refuse absurd meta boxes
+const size_t stMAX_ITEM_BYTES = 64 * 1024;        // EXIF orientation lives in IFD0
+
+// Where probe bytes come from: a caller's memory block or a descriptor
+struct sProbeSource
+{
+    const unsigned char* pData = nullptr;         // Whole file when probing memory
+    int iFd = -1;                                 // Read with pread() otherwise
+    uint64_t ullSize = 0;
+}; // End struct sProbeSource
+
+// Bounds-checked big-endian reader over one box body
+struct sByteCursor
+{
+    const unsigned char* pData;
+    size_t stSize;
+    size_t stPos = 0;
+    bool bOk = true;
+
+    sByteCursor(const unsigned char* pBytes, size_t stLength) : pData(pBytes), stSize(stLength) {}
+
+    bool fn_has(size_t stCount) const { return bOk && stSize - stPos >= stCount; }
+
+    uint64_t fn_readN(int iBytes)
+    {
+        if (iBytes == 0)
+        {
+            return 0;
+        }
+        if (!fn_has(static_cast<size_t>(iBytes)))
+        {
+            bOk = false;
+            return 0;
+        }
+        uint64_t ullValue = 0;
+        for (int i = 0; i < iBytes; i++)
+        {
+            ullValue = (ullValue << 8) | pData[stPos++];
+        }
+        return ullValue;
+    }
+
+    uint8_t fn_u8() { return static_cast<uint8_t>(fn_readN(1)); }
+    uint16_t fn_u16() { return static_cast<uint16_t>(fn_readN(2)); }
+    uint32_t fn_u32() { return static_cast<uint32_t>(fn_readN(4)); }
+
+    std::string fn_fourcc()
+    {
+        if (!fn_has(4))
+        {
+            bOk = false;
+            return "";
+        }
+        std::string sType(reinterpret_cast<const char*>(pData + stPos), 4);
+        stPos += 4;
+        return sType;
+    }
+
+    std::string fn_cstring()
+    {
+        size_t stEnd = stPos;
+        while (stEnd < stSize && pData[stEnd] != 0)
+        {
+            stEnd++;
+        }
+        std::string sValue(reinterpret_cast<const char*>(pData + stPos), stEnd - stPos);
+        stPos = stEnd < stSize ? stEnd + 1 : stEnd;
+        return sValue;
+    }
+}; // End struct sByteCursor
+
+// One child box inside a parent body
+struct sBox
+{
+    std::string sType;
+    const unsigned char* pBody = nullptr;
+    size_t stBodySize = 0;
+}; // End struct sBox
+
+struct sItemInfo
+{
+    std::string sType;                            // hvc1, grid, Exif, mime, ...
+    std::string sContentType;                     // For mime items
+    bool bHidden = false;
+    std::vector<int> viProperties;                // 1-based ipco indices
+}; // End struct sItemInfo
+
+struct sItemLocation
+{
+    int iMethod = 0;                              // 0 = file offset, 1 = idat
+    uint64_t ullBaseOffset = 0;
+    std::vector<std::pair<uint64_t, uint64_t>> vExtents;  // Offset, length (0 = to end)
+}; // End struct sItemLocation
+
+struct sItemReference
+{
+    std::string sType;                            // dimg, thmb, auxl, cdsc, ...
+    uint32_t uFrom = 0;
+    std::vector<uint32_t> vuTo;
+}; // End struct sItemReference
+
+// Everything the probe needs from the meta box
+struct sMetaInfo
+{
+    uint32_t uPrimary = 0;
+    std::map<uint32_t, sItemInfo> mItems;
+    std::map<uint32_t, sItemLocation> mLocations;
+    std::vector<sItemReference> vReferences;
+    std::vector<sBox> vProperties;
+    const unsigned char* pIdat = nullptr;
+    size_t stIdatSize = 0;
+}; // End struct sMetaInfo
+
+// Read a box header at the cursor (false at the end or on a bad size)
+bool fn_nextBox(sByteCursor& oCursor, sBox& oBox)
+{
+    if (!oCursor.fn_has(8))
+    {
+        return false;
+    }
+
+    size_t stStart = oCursor.stPos;
+    uint64_t ullSize = oCursor.fn_u32();
+    oBox.sType = oCursor.fn_fourcc();
+    if (ullSize == 1)
+    {
+        ullSize = oCursor.fn_readN(8);
+    }
+    else if (ullSize == 0)
+    {
+        ullSize = oCursor.stSize - stStart;
+    }
+
+    size_t stHeader = oCursor.stPos - stStart;
+    if (!oCursor.bOk || ullSize < stHeader || ullSize > oCursor.stSize - stStart)
+    {
+        oCursor.bOk = false;
+        return false;
+    }
+
+    oBox.pBody = oCursor.pData + oCursor.stPos;
+    oBox.stBodySize = static_cast<size_t>(ullSize) - stHeader;
+    oCursor.stPos = stStart + static_cast<size_t>(ullSize);
+    return true;
+} // End Function fn_nextBox
+
+// Fetch bytes from the source; memory is returned in place, files via pread()
+const unsigned char* fn_fetch(const sProbeSource& oSource, uint64_t ullOffset, size_t stLength,
+                              std::vector<unsigned char>& vScratch)
+{
+    if (ullOffset > oSource.ullSize || stLength > oSource.ullSize - ullOffset)
+    {
+        return nullptr;
+    }
+
+    if (oSource.pData)
+    {
+        return oSource.pData + ullOffset;
+    }
+
+    vScratch.resize(stLength);
+    size_t stDone = 0;
+    while (stDone < stLength)
+    {
+        ssize_t iRead = pread(oSource.iFd, vScratch.data() + stDone, stLength - stDone,
+                              static_cast<off_t>(ullOffset + stDone));
+        if (iRead < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (iRead <= 0)
+        {
+            return nullptr;
+        }
+        stDone += static_cast<size_t>(iRead);
+    }
+
+    return vScratch.data();
+} // End Function fn_fetch
+
+// Parse iloc into per-item extents
+void fn_parseIloc(const sBox& oBox, sMetaInfo& oMeta)
+{
+    sByteCursor oCursor(oBox.pBody, oBox.stBodySize);
+    int iVersion = oCursor.fn_u8();
+    oCursor.fn_readN(3);
+
+    uint8_t uSizes = oCursor.fn_u8();
+    int iOffsetSize = uSizes >> 4;
+    int iLengthSize = uSizes & 0x0F;
+    uSizes = oCursor.fn_u8();
+    int iBaseOffsetSize = uSizes >> 4;
+    int iIndexSize = (iVersion == 1 || iVersion == 2) ? (uSizes & 0x0F) : 0;
+
+    uint32_t uCount = iVersion < 2 ? oCursor.fn_u16() : oCursor.fn_u32();
+    for (uint32_t i = 0; i < uCount && oCursor.bOk; i++)
+    {
+        uint32_t uId = iVersion < 2 ? oCursor.fn_u16() : oCursor.fn_u32();
+        sItemLocation oLocation;
+        if (iVersion == 1 || iVersion == 2)
+        {
+            oLocation.iMethod = oCursor.fn_u16() & 0x0F;
+        }
+        oCursor.fn_u16();  // data_reference_index
+        oLocation.ullBaseOffset = oCursor.fn_readN(iBaseOffsetSize);
+
+        uint16_t uExtents = oCursor.fn_u16();
+        for (uint16_t e = 0; e < uExtents && oCursor.bOk; e++)
+        {
+            oCursor.fn_readN(iIndexSize);
+            uint64_t ullOffset = oCursor.fn_readN(iOffsetSize);
+            uint64_t ullLength = oCursor.fn_readN(iLengthSize);
+            oLocation.vExtents.emplace_back(ullOffset, ullLength);
+        }
+
+        if (oCursor.bOk)
+        {
+            oMeta.mLocations[uId] = oLocation;
+        }
+    }
+} // End Function fn_parseIloc
+
+// Parse iinf/infe entries (version 2+ infe carries the item type)
+void fn_parseIinf(const sBox& oBox, sMetaInfo& oMeta)
+{
+    sByteCursor oCursor(oBox.pBody, oBox.stBodySize);
+    int iVersion = oCursor.fn_u8();
+    oCursor.fn_readN(3);
+    oCursor.fn_readN(iVersion == 0 ? 2 : 4);
+
+    sBox oEntry;
+    while (fn_nextBox(oCursor, oEntry))
+    {
+        if (oEntry.sType != "infe")
+        {
+            continue;
+        }
+
+        sByteCursor oInfe(oEntry.pBody, oEntry.stBodySize);
+        int iInfeVersion = oInfe.fn_u8();
+        uint32_t uFlags = static_cast<uint32_t>(oInfe.fn_readN(3));
+        if (iInfeVersion < 2)
+        {
+            continue;
+        }
+
+        uint32_t uId = iInfeVersion == 2 ? oInfe.fn_u16() : oInfe.fn_u32();
+        oInfe.fn_u16();  // item_protection_index
+        sItemInfo& oItem = oMeta.mItems[uId];
+        oItem.sType = oInfe.fn_fourcc();
+        oItem.bHidden = (uFlags & 1) != 0;
+        oInfe.fn_cstring();  // item_name
+        if (oItem.sType == "mime")
+        {
+            oItem.sContentType = oInfe.fn_cstring();
+        }
+    }
+} // End Function fn_parseIinf
+
+// Parse iref into typed from -> to lists
+void fn_parseIref(const sBox& oBox, sMetaInfo& oMeta)
+{
+    sByteCursor oCursor(oBox.pBody, oBox.stBodySize);
+    int iVersion = oCursor.fn_u8();
+    oCursor.fn_readN(3);
+    int iIdBytes = iVersion == 0 ? 2 : 4;
+
+    sBox oChild;
+    while (fn_nextBox(oCursor, oChild))
+    {
+        sByteCursor oRef(oChild.pBody, oChild.stBodySize);
+        sItemReference oReference;
+        oReference.sType = oChild.sType;
+        oReference.uFrom = static_cast<uint32_t>(oRef.fn_readN(iIdBytes));
+        uint16_t uCount = oRef.fn_u16();
+        for (uint16_t i = 0; i < uCount && oRef.bOk; i++)
+        {
+            oReference.vuTo.push_back(static_cast<uint32_t>(oRef.fn_readN(iIdBytes)));
+        }
+        if (oRef.bOk)
+        {
+            oMeta.vReferences.push_back(oReference);
+        }
+    }
+} // End Function fn_parseIref
+
+// Parse iprp: the ipco property list and the ipma item associations
+void fn_parseIprp(const sBox& oBox, sMetaInfo& oMeta)
+{
+    sByteCursor oCursor(oBox.pBody, oBox.stBodySize);
+    sBox oChild;
+    while (fn_nextBox(oCursor, oChild))
+    {
+        if (oChild.sType == "ipco")
+        {
+            sByteCursor oProps(oChild.pBody, oChild.stBodySize);
+            sBox oProperty;
+            while (fn_nextBox(oProps, oProperty))
+            {
+                oMeta.vProperties.push_back(oProperty);
+            }
+        }
+        else if (oChild.sType == "ipma")
+        {
+            sByteCursor oMap(oChild.pBody, oChild.stBodySize);
+            int iVersion = oMap.fn_u8();
+            uint32_t uFlags = static_cast<uint32_t>(oMap.fn_readN(3));
+            uint32_t uEntries = oMap.fn_u32();
+            for (uint32_t i = 0; i < uEntries && oMap.bOk; i++)
+            {
+                uint32_t uId = iVersion < 1 ? oMap.fn_u16() : oMap.fn_u32();
+                uint8_t uAssociations = oMap.fn_u8();
+                std::vector<int>& viProperties = oMeta.mItems[uId].viProperties;
+                for (uint8_t a = 0; a < uAssociations && oMap.bOk; a++)
+                {
+                    int iIndex = (uFlags & 1) ? (oMap.fn_u16() & 0x7FFF) : (oMap.fn_u8() & 0x7F);
+                    if (iIndex > 0)
+                    {
+                        viProperties.push_back(iIndex);
+                    }
+                }
+            }
+        }
+    }
+} // End Function fn_parseIprp
+
+// Parse the meta box body (FullBox header included)
+bool fn_parseMeta(const unsigned char* pBody, size_t stSize, sMetaInfo& oMeta, std::string& sError)
+{
+    sByteCursor oCursor(pBody, stSize);
+    oCursor.fn_u32();  // version and flags
+
+    bool bPictHandler = false;
+    sBox oChild;
+    while (fn_nextBox(oCursor, oChild))
+    {
+        if (oChild.sType == "hdlr")
+        {
+            sByteCursor oHdlr(oChild.pBody, oChild.stBodySize);
+            oHdlr.fn_u32();
+            oHdlr.fn_u32();
+            bPictHandler = oHdlr.fn_fourcc() == "pict";
+        }
+        else if (oChild.sType == "pitm")
+        {
+            sByteCursor oPitm(oChild.pBody, oChild.stBodySize);
+            int iVersion = oPitm.fn_u8();
+            oPitm.fn_readN(3);
+            oMeta.uPrimary = iVersion == 0 ? oPitm.fn_u16() : oPitm.fn_u32();
+        }
+        else if (oChild.sType == "iinf")
+        {
+            fn_parseIinf(oChild, oMeta);
+        }
+        else if (oChild.sType == "iref")
+        {
+            fn_parseIref(oChild, oMeta);
+        }
+        else if (oChild.sType == "iprp")
+        {
+            fn_parseIprp(oChild, oMeta);
+        }
+        else if (oChild.sType == "iloc")
+        {
+            fn_parseIloc(oChild, oMeta);
+        }
+        else if (oChild.sType == "idat")
+        {
+            oMeta.pIdat = oChild.pBody;
+            oMeta.stIdatSize = oChild.stBodySize;
+        }
+    }
+
+    if (!bPictHandler)
+    {
+        sError = "meta box has no 'pict' handler";
+        return false;
+    }
+    if (oMeta.mItems.find(oMeta.uPrimary) == oMeta.mItems.end())
+    {
+        sError = "Primary item " + std::to_string(oMeta.uPrimary) + " is not described";
+        return false;
+    }
+
+    return true;
+} // End Function fn_parseMeta
+
+// Copy up to stMaxBytes of an item's payload (iloc extents, file or idat)
+bool fn_readItemData(const sProbeSource& oSource, const sMetaInfo& oMeta, uint32_t uId,
+                     size_t stMaxBytes, std::vector<unsigned char>& vData)
+{
+    auto itLocation = oMeta.mLocations.find(uId);
+    if (itLocation == oMeta.mLocations.end())
+    {
+        return false;
+    }
+
+    const sItemLocation& oLocation = itLocation->second;
+    vData.clear();
+    std::vector<unsigned char> vScratch;
+    for (const auto& oExtent : oLocation.vExtents)
+    {
+        if (vData.size() >= stMaxBytes)
+        {
+            break;
+        }
+
+        uint64_t ullOffset = oLocation.ullBaseOffset + oExtent.first;
+        uint64_t ullLimit = oLocation.iMethod == 1 ? oMeta.stIdatSize : oSource.ullSize;
+        if (ullOffset > ullLimit)
+        {
+            return false;
+        }
+        uint64_t ullLength = oExtent.second == 0 ? ullLimit - ullOffset : oExtent.second;
+        size_t stTake = static_cast<size_t>(std::min<uint64_t>(ullLength, stMaxBytes - vData.size()));
+        if (stTake > ullLimit - ullOffset)
+        {
+            return false;
+        }
+
+        const unsigned char* pBytes = nullptr;
+        if (oLocation.iMethod == 0)
+        {
+            pBytes = fn_fetch(oSource, ullOffset, stTake, vScratch);
+        }
+        else if (oLocation.iMethod == 1 && oMeta.pIdat)
+        {
+            pBytes = oMeta.pIdat + ullOffset;
+        }
+        if (!pBytes)
+        {
+            return false;
+        }
+
+        vData.insert(vData.end(), pBytes, pBytes + stTake);
+    }
+
+    return !vData.empty();
+} // End Function fn_readItemData
+
+// Look up a property of an item by type
+const sBox* fn_findProperty(const sMetaInfo& oMeta, uint32_t uId, const char* pType)
+{
+    auto itItem = oMeta.mItems.find(uId);
+    if (itItem == oMeta.mItems.end())
+    {
+        return nullptr;
+    }
+
+    for (int iIndex : itItem->second.viProperties)
+    {
+        if (static_cast<size_t>(iIndex) <= oMeta.vProperties.size() &&
+            oMeta.vProperties[iIndex - 1].sType == pType)
+        {
+            return &oMeta.vProperties[iIndex - 1];
+        }
+    }
+
+    return nullptr;
+} // End Function fn_findProperty
+
+// ispe -> width/height (false when absent)
+bool fn_getSpatialExtent(const sMetaInfo& oMeta, uint32_t uId, int& iWidth, int& iHeight)
+{
+    const sBox* pIspe = fn_findProperty(oMeta, uId, "ispe");
+    if (!pIspe)
+    {
+        return false;
+    }
+
+    sByteCursor oCursor(pIspe->pBody, pIspe->stBodySize);
+    oCursor.fn_u32();
+    uint32_t uWidth = oCursor.fn_u32();
+    uint32_t uHeight = oCursor.fn_u32();
+    if (!oCursor.bOk)
+    {
+        return false;
+    }
+
+    iWidth = static_cast<int>(std::min<uint32_t>(uWidth, 0x7FFFFFFF));
+    iHeight = static_cast<int>(std::min<uint32_t>(uHeight, 0x7FFFFFFF));
+    return true;
+} // End Function fn_getSpatialExtent
+
+// Bit depth and chroma format from pixi or the codec configuration box
+void fn_getPixelFormat(const sMetaInfo& oMeta, uint32_t uId, sHeifProbe& oProbe)
+{
+    if (const sBox* pHvcc = fn_findProperty(oMeta, uId, "hvcC"))
+    {
+        if (pHvcc->stBodySize > 17)
+        {
+            oProbe.iChromaFormat = pHvcc->pBody[16] & 0x03;
+            oProbe.iBitDepth = 8 + (pHvcc->pBody[17] & 0x07);
+        }
+    }
+    else if (const sBox* pAv1c = fn_findProperty(oMeta, uId, "av1C"))
+    {
+        if (pAv1c->stBodySize > 2)
+        {
+            uint8_t uFlags = pAv1c->pBody[2];
+            bool bHighDepth = (uFlags & 0x40) != 0;
+            oProbe.iBitDepth = bHighDepth ? ((uFlags & 0x20) ? 12 : 10) : 8;
+            bool bSubX = (uFlags & 0x08) != 0;
+            bool bSubY = (uFlags & 0x04) != 0;
+            oProbe.iChromaFormat = (uFlags & 0x10) ? 0 : (bSubX ? (bSubY ? 1 : 2) : 3);
+        }
+    }
+
+    // pixi is authoritative when present
+    if (const sBox* pPixi = fn_findProperty(oMeta, uId, "pixi"))
+    {
+        if (pPixi->stBodySize > 5 && pPixi->pBody[4] > 0)
+        {
+            oProbe.iBitDepth = pPixi->pBody[5];
+        }
+    }
+} // End Function fn_getPixelFormat
+
+// EXIF item payload -> orientation tag from IFD0 (0 when not found)
+int fn_parseExifOrientation(const std::vector<unsigned char>& vExif)
+{
+    if (vExif.size() < 4)
+    {
+        return 0;
+    }
+
+    // HEIF prefixes the TIFF header with its offset; fall back to a search
+    // for writers that get the offset wrong
+    size_t stTiff = 4 + ((static_cast<size_t>(vExif[0]) << 24) | (vExif[1] << 16) | (vExif[2] << 8) | vExif[3]);
+    auto fn_isTiffHeader = [&](size_t stAt)
+    {
+        return stAt + 8 <= vExif.size() &&
+               ((vExif[stAt] == 'I' && vExif[stAt + 1] == 'I' && vExif[stAt + 2] == 42 && vExif[stAt + 3] == 0) ||
+                (vExif[stAt] == 'M' && vExif[stAt + 1] == 'M' && vExif[stAt + 2] == 0 && vExif[stAt + 3] == 42));
+    };
+    if (!fn_isTiffHeader(stTiff))
+    {
+        stTiff = 0;
+        while (stTiff < 64 && !fn_isTiffHeader(stTiff))
+        {
+            stTiff++;
+        }
+        if (stTiff == 64)
+        {
+            return 0;
+        }
+    }
+
+    const unsigned char* pTiff = vExif.data() + stTiff;
+    size_t stTiffSize = vExif.size() - stTiff;
+    bool bLittle = pTiff[0] == 'I';
+    auto fn_get16 = [&](size_t stAt) -> uint32_t
+    {
+        return bLittle ? (pTiff[stAt] | (pTiff[stAt + 1] << 8)) : ((pTiff[stAt] << 8) | pTiff[stAt + 1]);
+    };
+    auto fn_get32 = [&](size_t stAt) -> uint32_t
+    {
+        return bLittle ? (fn_get16(stAt) | (fn_get16(stAt + 2) << 16)) : ((fn_get16(stAt) << 16) | fn_get16(stAt + 2));
+    };
+
+    uint32_t uIfd = fn_get32(4);
+    if (uIfd + 2 > stTiffSize)
+    {
+        return 0;
+    }
+
+    uint32_t uEntries = fn_get16(uIfd);
+    for (uint32_t i = 0; i < uEntries; i++)
+    {
+        size_t stEntry = uIfd + 2 + i * 12;
+        if (stEntry + 12 > stTiffSize)
+        {
+            break;
+        }
+        if (fn_get16(stEntry) == 0x0112)
+        {
+            uint32_t uValue = fn_get16(stEntry + 8);
+            return (uValue >= 1 && uValue <= 8) ? static_cast<int>(uValue) : 0;
+        }
+    }
+
+    return 0;
+} // End Function fn_parseExifOrientation
+
+// Coded image item types counted as images
+bool fn_isImageType(const std::string& sType)
+{
+    return sType == "hvc1" || sType == "av01" || sType == "grid" || sType == "iovl" ||
+           sType == "iden" || sType == "jpeg" || sType == "j2k1" || sType == "unci" || sType == "vvc1";
+} // End Function fn_isImageType
+
+// Fill oProbe from a parsed meta box
+void fn_describePrimary(const sProbeSource& oSource, const sMetaInfo& oMeta, sHeifProbe& oProbe)
+{
+    uint32_t uPrimary = oMeta.uPrimary;
+    oProbe.sCodec = oMeta.mItems.at(uPrimary).sType;
+    fn_getSpatialExtent(oMeta, uPrimary, oProbe.iWidth, oProbe.iHeight);
+    fn_getPixelFormat(oMeta, uPrimary, oProbe);
+
+    // Colour description
+    if (const sBox* pColr = fn_findProperty(oMeta, uPrimary, "colr"))
+    {
+        sByteCursor oCursor(pColr->pBody, pColr->stBodySize);
+        oProbe.sColorType = oCursor.fn_fourcc();
+        if (oProbe.sColorType == "nclx")
+        {
+            oProbe.iColourPrimaries = oCursor.fn_u16();
+            oProbe.iTransferCharacteristics = oCursor.fn_u16();
+            oProbe.iMatrixCoefficients = oCursor.fn_u16();
+            oProbe.bFullRange = (oCursor.fn_u8() & 0x80) != 0;
+        }
+    }
+
+    // Display transforms
+    if (const sBox* pIrot = fn_findProperty(oMeta, uPrimary, "irot"))
+    {
+        if (pIrot->stBodySize > 0)
+        {
+            oProbe.iRotation = (pIrot->pBody[0] & 0x03) * 90;
+        }
+    }
+    if (const sBox* pImir = fn_findProperty(oMeta, uPrimary, "imir"))
+    {
+        if (pImir->stBodySize > 0)
+        {
+            oProbe.iMirrorAxis = pImir->pBody[0] & 0x01;
+        }
+    }
+
+    // Items that are parts of other images rather than images of their own
+    std::set<uint32_t> oDerived;
+    std::vector<uint32_t> vuTiles;
+    std::vector<uint32_t> vuMetadata;
+    for (const auto& oReference : oMeta.vReferences)
+    {
+        bool bToPrimary = std::find(oReference.vuTo.begin(), oReference.vuTo.end(), uPrimary) != oReference.vuTo.end();
+
+        if (oReference.sType == "dimg")
+        {
+            oDerived.insert(oReference.vuTo.begin(), oReference.vuTo.end());
+            if (oReference.uFrom == uPrimary)
+            {
+                vuTiles = oReference.vuTo;
+            }
+        }
+        else if (oReference.sType == "thmb" || oReference.sType == "auxl" || oReference.sType == "base")
+        {
+            oDerived.insert(oReference.uFrom);
+        }
+
+        if (!bToPrimary)
+        {
+            continue;
+        }
+
+        if (oReference.sType == "thmb")
+        {
+            int iThumbWidth = 0;
+            int iThumbHeight = 0;
+            oProbe.iThumbnailCount++;
+            if (fn_getSpatialExtent(oMeta, oReference.uFrom, iThumbWidth, iThumbHeight) &&
+                static_cast<int64_t>(iThumbWidth) * iThumbHeight >
+                static_cast<int64_t>(oProbe.iThumbnailWidth) * oProbe.iThumbnailHeight)
+            {
+                oProbe.iThumbnailWidth = iThumbWidth;
+                oProbe.iThumbnailHeight = iThumbHeight;
+            }
+        }
+        else if (oReference.sType == "auxl")
+        {
+            if (const sBox* pAuxc = fn_findProperty(oMeta, oReference.uFrom, "auxC"))
+            {
+                sByteCursor oCursor(pAuxc->pBody, pAuxc->stBodySize);
+                oCursor.fn_u32();
+                std::string sUrn = oCursor.fn_cstring();
+                if (sUrn == "urn:mpeg:hevc:2015:auxid:1" || sUrn == "urn:mpeg:mpegB:cicp:systems:auxiliary:alpha")
+                {
+                    oProbe.bHasAlpha = true;
+                }
+            }
+        }
+        else if (oReference.sType == "cdsc")
+        {
+            vuMetadata.push_back(oReference.uFrom);
+        }
+    }
+
+    // Grid layout from the descriptor payload, tile size from the first tile
+    if (oProbe.sCodec == "grid")
+    {
+        std::vector<unsigned char> vGrid;
+        if (fn_readItemData(oSource, oMeta, uPrimary, 16, vGrid) && vGrid.size() >= 8)
+        {
+            sByteCursor oCursor(vGrid.data(), vGrid.size());
+            oCursor.fn_u8();
+            int iFieldBytes = (oCursor.fn_u8() & 1) ? 4 : 2;
+            oProbe.iGridRows = oCursor.fn_u8() + 1;
+            oProbe.iGridColumns = oCursor.fn_u8() + 1;
+            int iOutputWidth = static_cast<int>(oCursor.fn_readN(iFieldBytes));
+            int iOutputHeight = static_cast<int>(oCursor.fn_readN(iFieldBytes));
+            if (oCursor.bOk)
+            {
+                oProbe.bIsGrid = true;
+                if (oProbe.iWidth == 0 || oProbe.iHeight == 0)
+                {
+                    oProbe.iWidth = iOutputWidth;
+                    oProbe.iHeight = iOutputHeight;
+                }
+            }
+        }
+
+        if (!vuTiles.empty())
+        {
+            fn_getSpatialExtent(oMeta, vuTiles[0], oProbe.iTileWidth, oProbe.iTileHeight);
+            fn_getPixelFormat(oMeta, vuTiles[0], oProbe);
+        }
+    }
+
+    // Metadata items: linked to the primary, or any at all for writers that skip cdsc
+    if (vuMetadata.empty())
+    {
+        for (const auto& oItem : oMeta.mItems)
+        {
+            vuMetadata.push_back(oItem.first);
+        }
+    }
+    for (uint32_t uId : vuMetadata)
+    {
+        auto itItem = oMeta.mItems.find(uId);
+        if (itItem == oMeta.mItems.end())
+        {
+            continue;
+        }
+
+        const sItemInfo& oItem = itItem->second;
+        if (oItem.sType == "Exif" && !oProbe.bHasExif)
+        {
+            oProbe.bHasExif = true;
+            std::vector<unsigned char> vExif;
+            if (fn_readItemData(oSource, oMeta, uId, stMAX_ITEM_BYTES, vExif))
+            {
+                oProbe.iExifOrientation = fn_parseExifOrientation(vExif);
+            }
+        }
+        else if (oItem.sType == "mime" && oItem.sContentType == "application/rdf+xml")
+        {
+            oProbe.bHasXmp = true;
+        }
+    }
+
+    for (const auto& oItem : oMeta.mItems)
+    {
+        if (fn_isImageType(oItem.second.sType) && !oItem.second.bHidden && !oDerived.count(oItem.first))
+        {
+            oProbe.iImageCount++;
+        }
+    }
+
+    bool bQuarterTurn = oProbe.iRotation == 90 || oProbe.iRotation == 270;
+    oProbe.iDisplayWidth = bQuarterTurn ? oProbe.iHeight : oProbe.iWidth;
+    oProbe.iDisplayHeight = bQuarterTurn ? oProbe.iWidth : oProbe.iHeight;
+} // End Function fn_describePrimary
+
+// Walk the top-level boxes, parse ftyp and meta, and describe the primary image
+bool fn_probeSource(const sProbeSource& oSource, sHeifProbe& oProbe, std::string& sError)
+{
+    oProbe = sHeifProbe();
+    oProbe.ullFileSize = oSource.ullSize;
+
+    std::vector<unsigned char> vHead;
+    size_t stHead = static_cast<size_t>(std::min<uint64_t>(oSource.ullSize, stHEAD_BYTES));
+    const unsigned char* pHead = fn_fetch(oSource, 0, stHead, vHead);
+    if (!pHead || stHead < 16)
+    {
+        sError = "File too small for a HEIF header";
+        return false;
+    }
+
+    uint64_t ullOffset = 0;
+    bool bFtyp = false;
+    std::vector<unsigned char> vHeader;
+    while (ullOffset + 8 <= oSource.ullSize)
+    {
+        // Box header, from the head block when it is there
+        size_t stPeek = static_cast<size_t>(std::min<uint64_t>(16, oSource.ullSize - ullOffset));
+        const unsigned char* pHeader = ullOffset + stPeek <= stHead ? pHead + ullOffset
+                                                                     : fn_fetch(oSource, ullOffset, stPeek, vHeader);
+        if (!pHeader)
+        {
+            break;
+        }
+
+        sByteCursor oCursor(pHeader, stPeek);
+        uint64_t ullBoxSize = oCursor.fn_u32();
+        std::string sType = oCursor.fn_fourcc();
+        if (ullBoxSize == 1)
+        {
+            ullBoxSize = oCursor.fn_readN(8);
+        }
+        else if (ullBoxSize == 0)
+        {
+            ullBoxSize = oSource.ullSize - ullOffset;
+        }
+        size_t stHeaderSize = oCursor.stPos;
+        if (!oCursor.bOk || ullBoxSize < stHeaderSize || ullBoxSize > oSource.ullSize - ullOffset)
+        {
+            sError = "Corrupt box header at offset " + std::to_string(ullOffset);
+            return false;
+        }
+
+        if (!bFtyp)
+        {
+            // ftyp must come first; its brands decide whether this is HEIF at all
+            if (sType != "ftyp" || ullBoxSize > stHead || ullBoxSize < 16)
+            {
+                sError = "Not a HEIF file (no ftyp box)";
+                return false;
+            }
+
+            static const char* apBrands[] = {"mif1", "msf1", "heic", "heix", "heim", "heis",
+                                             "hevc", "hevx", "avif", "avis"};
+            bool bKnown = false;
+            oProbe.sBrand.assign(reinterpret_cast<const char*>(pHead + stHeaderSize), 4);
+            for (size_t stAt = stHeaderSize; stAt + 4 <= ullBoxSize && !bKnown; stAt += 4)
+            {
+                if (stAt == stHeaderSize + 4)
+                {
+                    continue;  // minor_version
+                }
+                for (const char* pBrand : apBrands)
+                {
+                    bKnown = bKnown || memcmp(pHead + stAt, pBrand, 4) == 0;
+                }
+            }
+            if (!bKnown)
+            {
+                sError = "Unsupported brand: " + oProbe.sBrand;
+                return false;
+            }
+            bFtyp = true;
+        }
+        else if (sType == "meta")
+        {
+            if (ullBoxSize > stMAX_META_BYTES)
+            {
+                sError = "meta box too large: " + std::to_string(ullBoxSize) + " bytes";
+                return false;
+            }
+
+            std::vector<unsigned char> vMeta;
+            size_t stBody = static_cast<size_t>(ullBoxSize) - stHeaderSize;
+            const unsigned char* pMeta = ullOffset + ullBoxSize <= stHead
+                                             ? pHead + ullOffset + stHeaderSize
+                                             : fn_fetch(oSource, ullOffset + stHeaderSize, stBody, vMeta);
+            if (!pMeta)
+            {
+                sError = "Failed to read meta box";
+                return false;
+            }
+
+            sMetaInfo oMeta;
+            if (!fn_parseMeta(pMeta, stBody, oMeta, sError))
+            {
+                return false;
+            }
+
+            fn_describePrimary(oSource, oMeta, oProbe);
+            if (oProbe.iWidth <= 0 || oProbe.iHeight <= 0)
+            {
+                sError = "Primary image has no size";
+                return false;
+            }
+            return true;
+        }
+
+        ullOffset += ullBoxSize;
+    }
+
+    sError = bFtyp ? "No meta box found" : "Not a HEIF file (no ftyp box)";
+    return false;
+} // End Function fn_probeSource
+
+// Escape a string for a JSON value
+std::string fn_escapeJson(const std::string& sValue)
+{
+    std::string sOut;
+    sOut.reserve(sValue.size() + 2);
+    for (unsigned char c : sValue)
+    {
+        switch (c)
+        {
+            case '"':  sOut += "\\\""; break;
+            case '\\': sOut += "\\\\"; break;
+            case '\n': sOut += "\\n"; break;
+            case '\r': sOut += "\\r"; break;
+            case '\t': sOut += "\\t"; break;
+            default:
+                if (c < 0x20)
+                {
+                    char acHex[8];
+                    snprintf(acHex, sizeof(acHex), "\\u%04x", c);
+                    sOut += acHex;
+                }
+                else
+                {
+                    sOut += static_cast<char>(c);
+                }
+        }
+    }
+    return sOut;
+} // End Function fn_escapeJson
+} // namespace
+
+// Probe a file with a few positioned reads (no mapping, no readahead of pixel data)
+bool fn_probeHeifFile(const std::string& sFilePath, sHeifProbe& oProbe, std::string& sError)
+{
+    int iFd = open(sFilePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (iFd < 0)
+    {
+        sError = "Cannot open file: " + sFilePath + " (" + strerror(errno) + ")";
+        return false;
+    }
+
+    struct stat oStat;
+    if (fstat(iFd, &oStat) != 0 || !S_ISREG(oStat.st_mode))
+    {
+        sError = "Not a regular file: " + sFilePath;
+        close(iFd);
+        return false;
+    }
+
+    sProbeSource oSource;
+    oSource.iFd = iFd;
+    oSource.ullSize = static_cast<uint64_t>(oStat.st_size);
+    bool bResult = fn_probeSource(oSource, oProbe, sError);
+    close(iFd);
+    return bResult;
+} // End Function fn_probeHeifFile
+
+// Probe a HEIF file already in memory
+bool fn_probeHeifMemory(const unsigned char* pData, size_t stSize, sHeifProbe& oProbe, std::string& sError)
+{
+    if (!pData || stSize == 0)
+    {
+        sError = "Input data is empty";
+        return false;
+    }
+
+    sProbeSource oSource;
+    oSource.pData = pData;
+    oSource.ullSize = stSize;
+    return fn_probeSource(oSource, oProbe, sError);
+} // End Function fn_probeHeifMemory
+
+// Size of the interleaved frame a full decode produces
+uint64_t fn_getProbeDecodeBytes(const sHeifProbe& oProbe)
+{
+    uint64_t ullChannels = oProbe.bHasAlpha ? 4 : 3;
+    uint64_t ullBytes = oProbe.iBitDepth > 8 ? 2 : 1;
+    return static_cast<uint64_t>(oProbe.iWidth) * static_cast<uint64_t>(oProbe.iHeight) * ullChannels * ullBytes;
+} // End Function fn_getProbeDecodeBytes
+
+// Name the colour space described by colr
+std::string fn_getProbeColorSpace(const sHeifProbe& oProbe)
+{
+    if (oProbe.sColorType == "prof" || oProbe.sColorType == "rICC")
+    {
+        return "ICC";
+    }
+    if (oProbe.sColorType != "nclx")
+    {
+        return "sRGB";
+    }
+
+    switch (oProbe.iColourPrimaries)
+    {
+        case 1:  return oProbe.iTransferCharacteristics == 13 ? "sRGB" : "BT.709";
+        case 9:  return "BT.2020";
+        case 12: return "Display P3";
+        case 2:  return "sRGB";
+        default: return "nclx:" + std::to_string(oProbe.iColourPrimaries);
+    }
+} // End Function fn_getProbeColorSpace
+
+// One JSON line describing a successful probe
+std::string fn_probeToJson(const std::string& sFilePath, const sHeifProbe& oProbe)
+{
+    std::string sJson = "{\"file\":\"" + fn_escapeJson(sFilePath) + "\",\"ok\":true";
+    sJson += ",\"brand\":\"" + fn_escapeJson(oProbe.sBrand) + "\"";
+    sJson += ",\"codec\":\"" + fn_escapeJson(oProbe.sCodec) + "\"";
+    sJson += ",\"width\":" + std::to_string(oProbe.iWidth);
+    sJson += ",\"height\":" + std::to_string(oProbe.iHeight);
+    sJson += ",\"display_width\":" + std::to_string(oProbe.iDisplayWidth);
+    sJson += ",\"display_height\":" + std::to_string(oProbe.iDisplayHeight);
+    sJson += ",\"bit_depth\":" + std::to_string(oProbe.iBitDepth);
+    sJson += ",\"chroma\":" + std::to_string(oProbe.iChromaFormat);
+    sJson += std::string(",\"alpha\":") + (oProbe.bHasAlpha ? "true" : "false");
+    sJson += ",\"color_space\":\"" + fn_escapeJson(fn_getProbeColorSpace(oProbe)) + "\"";
+    if (oProbe.sColorType == "nclx")
+    {
+        sJson += ",\"nclx\":[" + std::to_string(oProbe.iColourPrimaries) + "," +
+                 std::to_string(oProbe.iTransferCharacteristics) + "," +
+                 std::to_string(oProbe.iMatrixCoefficients) + "," + (oProbe.bFullRange ? "1" : "0") + "]";
+    }
+    sJson += ",\"rotation\":" + std::to_string(oProbe.iRotation);
+    sJson += ",\"mirror\":" + std::to_string(oProbe.iMirrorAxis);
+    sJson += ",\"orientation\":" + std::to_string(oProbe.iExifOrientation);
+    if (oProbe.bIsGrid)
+    {
+        sJson += ",\"grid\":{\"rows\":" + std::to_string(oProbe.iGridRows) +
+                 ",\"columns\":" + std::to_string(oProbe.iGridColumns) +
+                 ",\"tile_width\":" + std::to_string(oProbe.iTileWidth) +
+                 ",\"tile_height\":" + std::to_string(oProbe.iTileHeight) + "}";
+    }
+    else
+    {
+        sJson += ",\"grid\":null";
+    }
+    sJson += ",\"images\":" + std::to_string(oProbe.iImageCount);
+    sJson += ",\"thumbnails\":" + std::to_string(oProbe.iThumbnailCount);
+    if (oProbe.iThumbnailCount > 0)
+    {
+        sJson += ",\"thumbnail_width\":" + std::to_string(oProbe.iThumbnailWidth);
+        sJson += ",\"thumbnail_height\":" + std::to_string(oProbe.iThumbnailHeight);
+    }
+    sJson += std::string(",\"exif\":") + (oProbe.bHasExif ? "true" : "false");
+    sJson += std::string(",\"xmp\":") + (oProbe.bHasXmp ? "true" : "false");
+    sJson += ",\"file_size\":" + std::to_string(oProbe.ullFileSize);
+    sJson += ",\"decode_bytes\":" + std::to_string(fn_getProbeDecodeBytes(oProbe));
+    sJson += "}";
+    return sJson;
+} // End Function fn_probeToJson
+
+// One JSON line describing a failed probe
+std::string fn_probeErrorToJson(const std::string& sFilePath, const std::string& sError)
+{
+    return "{\"file\":\"" + fn_escapeJson(sFilePath) + "\",\"ok\":false,\"error\":\"" + fn_escapeJson(sError) + "\"}";
+} // End Function fn_probeErrorToJson
@@ -0,0 +1,188 @@
+// image_buffer.cpp - Ref-counted, stride-aware pixel buffer
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "image_buffer.h"
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Constructor
+ImageBuffer::ImageBuffer()
+    : m_pData(nullptr),
+      m_iWidth(0),
+      m_iHeight(0),
+      m_iChannels(0),
+      m_iBitDepth(8),
+      m_stStride(0)
+{
+} // End Function ImageBuffer::ImageBuffer
+
+// Destructor
+ImageBuffer::~ImageBuffer()
+{
+} // End Function ImageBuffer::~ImageBuffer
+
+// Move constructor
+ImageBuffer::ImageBuffer(ImageBuffer&& oOther) noexcept
+    : m_pOwner(std::move(oOther.m_pOwner)),
+      m_pData(oOther.m_pData),
+      m_iWidth(oOther.m_iWidth),
+      m_iHeight(oOther.m_iHeight),
+      m_iChannels(oOther.m_iChannels),
+      m_iBitDepth(oOther.m_iBitDepth),
+      m_stStride(oOther.m_stStride)
+{
+    oOther.fn_reset();
+} // End Function ImageBuffer::ImageBuffer(ImageBuffer&&)
+
+// Move assignment
+ImageBuffer& ImageBuffer::operator=(ImageBuffer&& oOther) noexcept
+{
+    if (this != &oOther)
+    {
+        m_pOwner = std::move(oOther.m_pOwner);
+        m_pData = oOther.m_pData;
+        m_iWidth = oOther.m_iWidth;
+        m_iHeight = oOther.m_iHeight;
+        m_iChannels = oOther.m_iChannels;
+        m_iBitDepth = oOther.m_iBitDepth;
+        m_stStride = oOther.m_stStride;
+        oOther.fn_reset();
+    }
+
+    return *this;
+} // End Function ImageBuffer::operator=
+
+// Allocate an owned, tightly packed buffer
+ImageBuffer ImageBuffer::fn_allocate(int iWidth, int iHeight, int iChannels, int iBitDepth)
+{
+    if (iWidth <= 0 || iHeight <= 0 || iChannels <= 0)
+    {
+        return ImageBuffer();
+    }
+
+    size_t stStride = static_cast<size_t>(iWidth) * iChannels * ((iBitDepth + 7) / 8);
+
+    // No value-initialisation: every byte is written by the producer
+    unsigned char* pData = new (std::nothrow) unsigned char[stStride * iHeight];
+    if (!pData)
+    {
+        return ImageBuffer();
+    }
+
+    std::shared_ptr<void> pOwner(pData, [](void* p) { delete[] static_cast<unsigned char*>(p); });
+    return fn_wrap(pData, iWidth, iHeight, stStride, iChannels, iBitDepth, std::move(pOwner));
+} // End Function ImageBuffer::fn_allocate
+
+// Borrow externally owned memory
+ImageBuffer ImageBuffer::fn_wrap(unsigned char* pData, int iWidth, int iHeight, size_t stStride,
+                                 int iChannels, int iBitDepth, std::shared_ptr<void> pOwner)
+{
+    ImageBuffer oBuffer;
+
+    if (!pData || iWidth <= 0 || iHeight <= 0 || iChannels <= 0)
+    {
+        return oBuffer;
+    }
+
+    oBuffer.m_pOwner = std::move(pOwner);
+    oBuffer.m_pData = pData;
+    oBuffer.m_iWidth = iWidth;
+    oBuffer.m_iHeight = iHeight;
+    oBuffer.m_iChannels = iChannels;
+    oBuffer.m_iBitDepth = iBitDepth;
+    oBuffer.m_stStride = stStride;
+
+    return oBuffer;
+} // End Function ImageBuffer::fn_wrap
+
+// Drop this reference
+void ImageBuffer::fn_reset()
+{
+    m_pOwner.reset();
+    m_pData = nullptr;
+    m_iWidth = 0;
+    m_iHeight = 0;
+    m_iChannels = 0;
+    m_iBitDepth = 8;
+    m_stStride = 0;
+} // End Function ImageBuffer::fn_reset
+
+// Pixel bytes per row (without padding)
+size_t ImageBuffer::fn_getRowBytes() const
+{
+    return static_cast<size_t>(m_iWidth) * m_iChannels * ((m_iBitDepth + 7) / 8);
+} // End Function ImageBuffer::fn_getRowBytes
+
+// Area-average downscale to fit iMaxDimension
+ImageBuffer fn_shrinkToFit(const ImageBuffer& oSource, int iMaxDimension)
+{
+    int iSrcWidth = oSource.fn_getWidth();
+    int iSrcHeight = oSource.fn_getHeight();
+    if (iMaxDimension <= 0 || oSource.fn_isEmpty() || oSource.fn_getBitDepth() != 8 ||
+        std::max(iSrcWidth, iSrcHeight) <= iMaxDimension)
+    {
+        return oSource;
+    }
+
+    // Longer side becomes iMaxDimension, the other keeps the aspect ratio
+    int64_t llLonger = std::max(iSrcWidth, iSrcHeight);
+    int iDstWidth = std::max<int>(1, static_cast<int>((static_cast<int64_t>(iSrcWidth) * iMaxDimension + llLonger / 2) / llLonger));
+    int iDstHeight = std::max<int>(1, static_cast<int>((static_cast<int64_t>(iSrcHeight) * iMaxDimension + llLonger / 2) / llLonger));
+    int iChannels = oSource.fn_getChannels();
+
+    ImageBuffer oDest = ImageBuffer::fn_allocate(iDstWidth, iDstHeight, iChannels);
+    if (oDest.fn_isEmpty())
+    {
+        return oDest;
+    }
+
+    // Source column span of every output column (never empty: this only shrinks)
+    std::vector<int> viColumnEdge(iDstWidth + 1);
+    for (int x = 0; x <= iDstWidth; x++)
+    {
+        viColumnEdge[x] = static_cast<int>(static_cast<int64_t>(x) * iSrcWidth / iDstWidth);
+    }
+
+    std::vector<uint32_t> vuSum(static_cast<size_t>(iDstWidth) * iChannels);
+    for (int y = 0; y < iDstHeight; y++)
+    {
+        int iRowBegin = static_cast<int>(static_cast<int64_t>(y) * iSrcHeight / iDstHeight);
+        int iRowEnd = static_cast<int>(static_cast<int64_t>(y + 1) * iSrcHeight / iDstHeight);
+        std::fill(vuSum.begin(), vuSum.end(), 0u);
+
+        for (int iSrcRow = iRowBegin; iSrcRow < iRowEnd; iSrcRow++)
+        {
+            const unsigned char* pSrc = oSource.fn_getRow(iSrcRow);
+            uint32_t* pSum = vuSum.data();
+            for (int x = 0; x < iDstWidth; x++, pSum += iChannels)
+            {
+                const unsigned char* pPixel = pSrc + static_cast<size_t>(viColumnEdge[x]) * iChannels;
+                const unsigned char* pEnd = pSrc + static_cast<size_t>(viColumnEdge[x + 1]) * iChannels;
+                for (; pPixel < pEnd; pPixel += iChannels)
+                {
+                    for (int c = 0; c < iChannels; c++)
+                    {
+                        pSum[c] += pPixel[c];
+                    }
+                }
+            }
+        }
+
+        unsigned char* pDst = oDest.fn_getRow(y);
+        const uint32_t* pSum = vuSum.data();
+        for (int x = 0; x < iDstWidth; x++, pSum += iChannels, pDst += iChannels)
+        {
+            uint32_t uArea = static_cast<uint32_t>((viColumnEdge[x + 1] - viColumnEdge[x]) * (iRowEnd - iRowBegin));
+            for (int c = 0; c < iChannels; c++)
+            {
+                pDst[c] = static_cast<unsigned char>((pSum[c] + uArea / 2) / uArea);
+            }
+        }
+    }
+
+    return oDest;
+} // End Function fn_shrinkToFit
@@ -1,8 +1,10 @@
 // image_processor.cpp - Complete implementation for HEIC Converter v1.1
 #include "image_processor.h"
 #include "heic_decoder.h"
+#include "heif_container.h"
 #include "format_encoder.h"
 #include "file_utils.h"
+#include "thread_pool.h"
 #include <string>
 #include <vector>
 #include <algorithm>
@@ -17,6 +19,8 @@ ImageProcessor::ImageProcessor(oLogger* pLogger)
     m_pLogger = pLogger;
     m_sLastError = "";
     m_iOutputQuality = 85;
+    m_iTileThreads = 1;
+    m_iMaxDimension = 0;
     m_bCodecsInitialized = false;
     m_pHeifContext = nullptr;
     m_pHeifImage = nullptr;
@@ -66,6 +70,26 @@ bool ImageProcessor::fn_convertImage(
     const std::string& sOutputFormat,
     int iQuality
 ) 
+{
+    // Read and parse the input once
+    HeifContainer oContainer;
+    if (!sInputPath.empty() && !oContainer.fn_openFile(sInputPath) && oContainer.fn_getFileSize() == 0) {
+        m_sLastError = "Failed to read file: " + sInputPath;
+        if (m_pLogger) m_pLogger->fn_logError(m_sLastError);
+        return false;
+    }
+    
+    return fn_convertImage(oContainer, sInputPath, sOutputPath, sOutputFormat, iQuality);
+} // End Function fn_convertImage
+
+// Conversion from a parsed container
+bool ImageProcessor::fn_convertImage(
+    const HeifContainer& oContainer,
+    const std::string& sInputPath, 
+    const std::string& sOutputPath,
+    const std::string& sOutputFormat,
+    int iQuality
+) 
 {
     // Reset last error
     m_sLastError = "";
@@ -105,25 +129,76 @@ bool ImageProcessor::fn_convertImage(
         m_pLogger->fn_logInfo("Converting " + sInputPath + " to " + sFormat + " format");
     }
     
+    // Grid images go to scanline encoders one tile row at a time, so memory
+    // scales with the image width rather than the full frame (previews are
+    // small enough to decode whole)
+    if (m_iMaxDimension <= 0 && !fn_isResizeRequested(m_oResize)) {
+        FormatEncoder oEncoder;
+        HeicDecoder oDecoder;
+        oDecoder.fn_setTileThreads(fn_getWorkThreads());
+        sImageStream oStream;
+        
+        if (oEncoder.fn_supportsStreaming(sFormat) && oDecoder.fn_openTileRowStream(oContainer, oStream)) {
+            if (m_pLogger) {
+                m_pLogger->fn_logInfo("Streaming " + std::to_string(oStream.iWidth) + "x" + 
+                                     std::to_string(oStream.iHeight) + " grid image by tile rows");
+            }
+            
+            if (fn_encodeStream(oStream, sOutputPath, sFormat, m_iOutputQuality)) {
+                if (m_pLogger) {
+                    m_pLogger->fn_logSuccess("Successfully converted: " + sInputPath);
+                }
+                return true;
+            }
+            
+            // A partial output is rewritten by the full decode below
+            if (m_pLogger) m_pLogger->fn_logWarning("Streaming failed, retrying with full decode: " + sInputPath);
+        }
+        
+        // JPEG and lossy WebP take the decoder's 4:2:0 planes as they are,
+        // skipping the YCbCr -> RGB -> YCbCr round trip and chroma upsampling
+        sPlanarImage oPlanar;
+        if (oEncoder.fn_supportsPlanar(fn_makeEncodeOptions(sFormat, m_iOutputQuality)) &&
+            oDecoder.fn_decodePlanar(oContainer, oPlanar)) {
+            if (m_pLogger) {
+                m_pLogger->fn_logInfo("Encoding " + std::to_string(oPlanar.iWidth) + "x" + 
+                                     std::to_string(oPlanar.iHeight) + " YCbCr 4:2:0 planes directly");
+            }
+            
+            bool bEncoded = oEncoder.fn_encodePlanar(oPlanar, sOutputPath,
+                                                     fn_makeEncodeOptions(sFormat, m_iOutputQuality, oPlanar.iWidth, oPlanar.iHeight));
+            oPlanar = sPlanarImage();
+            if (bEncoded) {
+                if (m_pLogger) {
+                    m_pLogger->fn_logSuccess("Successfully converted: " + sInputPath);
+                }
+                return true;
+            }
+            
+            if (m_pLogger) m_pLogger->fn_logWarning("Planar encode failed, retrying from RGB: " + sInputPath);
+        }
+    }
+    
     // Decode HEIC/HEIF image
-    unsigned char* pImageData = nullptr;
-    int iWidth = 0, iHeight = 0, iChannels = 0;
+    ImageBuffer oPixels;
     
-    bool bDecoded = fn_decodeHEIC(sInputPath, &pImageData, iWidth, iHeight, iChannels);
+    bool bDecoded = fn_decodeHEIC(oContainer, oPixels, m_iMaxDimension);
     if (!bDecoded) {
         if (m_pLogger) m_pLogger->fn_logError("Failed to decode image: " + sInputPath);
         return false;
     }
     
+    // Resize between decode and encode (--scale / --fit)
+    if (!fn_applyResize(oPixels)) {
+        if (m_pLogger) m_pLogger->fn_logError("Failed to resize image: " + sInputPath);
+        return false;
+    }
+    
     // Encode to output format
-    bool bEncoded = fn_encodeImage(pImageData, iWidth, iHeight, iChannels, 
-                                   sOutputPath, sFormat, m_iOutputQuality);
+    bool bEncoded = fn_encodeImage(oPixels, sOutputPath, sFormat, m_iOutputQuality);
     
-    // Cleanup image data
-    if (pImageData) {
-        delete[] pImageData;
-        pImageData = nullptr;
-    }
+    // Release the decoded pixels
+    oPixels.fn_reset();
     
     if (!bEncoded) {
         if (m_pLogger) m_pLogger->fn_logError("Failed to encode image: " + sOutputPath);
@@ -137,6 +212,89 @@ bool ImageProcessor::fn_convertImage(
     return true;
 } // End Function fn_convertImage
 
+// Decode once, then resize and encode every rendition from that frame
+bool ImageProcessor::fn_convertRenditions(
+    const HeifContainer& oContainer,
+    const std::string& sInputPath,
+    const std::vector<sRendition>& vRenditions,
+    const std::vector<std::string>& vsOutputPaths,
+    int iQuality
+) 
+{
+    m_sLastError = "";
+    
+    if (vRenditions.empty() || vRenditions.size() != vsOutputPaths.size()) {
+        m_sLastError = "Rendition list and output paths do not match";
+        if (m_pLogger) m_pLogger->fn_logError(m_sLastError);
+        return false;
+    }
+    
+    for (const sRendition& oRendition : vRenditions) {
+        if (!fn_validateOutputFormat(oRendition.sFormat)) {
+            m_sLastError = "Unsupported output format: " + oRendition.sFormat;
+            if (m_pLogger) m_pLogger->fn_logError(m_sLastError);
+            return false;
+        }
+    }
+    
+    if (iQuality > 0) {
+        m_iOutputQuality = iQuality;
+    }
+    
+    // When every rendition is smaller than the image, the decoder may stop at
+    // the largest of them (or use a thumbnail that covers it)
+    int iDecodeLimit = m_iMaxDimension;
+    if (iDecodeLimit <= 0 && !fn_isResizeRequested(m_oResize)) {
+        for (const sRendition& oRendition : vRenditions) {
+            if (oRendition.iMaxDimension <= 0) {
+                iDecodeLimit = 0;
+                break;
+            }
+            iDecodeLimit = std::max(iDecodeLimit, oRendition.iMaxDimension);
+        }
+    }
+    
+    if (m_pLogger) {
+        m_pLogger->fn_logInfo("Converting " + sInputPath + " to " + std::to_string(vRenditions.size()) + " renditions");
+    }
+    
+    ImageBuffer oPixels;
+    if (!fn_decodeHEIC(oContainer, oPixels, iDecodeLimit)) {
+        if (m_pLogger) m_pLogger->fn_logError("Failed to decode image: " + sInputPath);
+        return false;
+    }
+    
+    // --scale / --fit shape the largest rendition; the rest cascade from it
+    if (!fn_applyResize(oPixels)) {
+        if (m_pLogger) m_pLogger->fn_logError("Failed to resize image: " + sInputPath);
+        return false;
+    }
+    
+    // Options are built on this thread; the encode workers only read them
+    std::vector<bool> vbWritten;
+    bool bAllWritten = fn_encodeRenditions(oPixels, vRenditions, vsOutputPaths,
+        [this](const sRendition& oRendition, int iWidth, int iHeight)
+        {
+            return fn_makeEncodeOptions(oRendition.sFormat, m_iOutputQuality, iWidth, iHeight);
+        },
+        m_oResize.eFilter, fn_getWorkThreads(), vbWritten);
+    oPixels.fn_reset();
+    
+    for (size_t i = 0; i < vbWritten.size(); i++) {
+        if (!vbWritten[i]) {
+            m_sLastError = "Failed to write rendition: " + vsOutputPaths[i];
+        } else if (m_pLogger) {
+            m_pLogger->fn_logInfo("Wrote rendition: " + vsOutputPaths[i]);
+        }
+    }
+    
+    if (bAllWritten && m_pLogger) {
+        m_pLogger->fn_logSuccess("Successfully converted: " + sInputPath);
+    }
+    
+    return bAllWritten;
+} // End Function fn_convertRenditions
+
 // NEW: Convert image with metadata
 bool ImageProcessor::fn_convertImageWithMetadata(
     const std::string& sInputPath, 
@@ -148,25 +306,27 @@ bool ImageProcessor::fn_convertImageWithMetadata(
     const std::vector<unsigned char>& vIptcData
 ) 
 {
-    // For now, just call the regular convert function
-    // Metadata will be handled separately in converter.cpp
-    return fn_convertImage(sInputPath, sOutputPath, sOutputFormat, iQuality);
+    // The encoder writes the metadata in the same pass as the pixels
+    fn_setMetadata(vExifData, vXmpData, {}, vIptcData);
+    bool bResult = fn_convertImage(sInputPath, sOutputPath, sOutputFormat, iQuality);
+    fn_setMetadata({}, {}, {});
+    return bResult;
 } // End Function fn_convertImageWithMetadata
 
 // Decode HEIC/HEIF file
 bool ImageProcessor::fn_decodeHEIC(
-    const std::string& sInputPath, 
-    unsigned char** ppImageData, 
-    int& iWidth, 
-    int& iHeight, 
-    int& iChannels
+    const HeifContainer& oContainer, 
+    ImageBuffer& oPixels,
+    int iMaxDimension
 ) 
 {
     // Create decoder instance
     HeicDecoder oDecoder;
+    oDecoder.fn_setTileThreads(fn_getWorkThreads());
+    oDecoder.fn_setMaxDimension(iMaxDimension);
     
     // Decode the image
-    oDecodedImage oResult = oDecoder.fn_decodeFile(sInputPath);
+    oDecodedImage oResult = oDecoder.fn_decodeContainer(oContainer);
     
     // Check for errors
     if (!oResult.sError.empty()) {
@@ -175,38 +335,54 @@ bool ImageProcessor::fn_decodeHEIC(
         return false;
     }
     
-    // Allocate memory for image data
-    size_t dataSize = oResult.vData.size();
-    *ppImageData = new unsigned char[dataSize];
-    if (!*ppImageData) {
-        m_sLastError = "Failed to allocate memory for image data";
+    if (oResult.oPixels.fn_isEmpty()) {
+        m_sLastError = "Decoder returned no pixel data";
         if (m_pLogger) m_pLogger->fn_logError(m_sLastError);
         return false;
     }
     
-    // Copy data
-    std::memcpy(*ppImageData, oResult.vData.data(), dataSize);
-    
-    // Set dimensions
-    iWidth = oResult.iWidth;
-    iHeight = oResult.iHeight;
-    iChannels = oResult.iChannels;
+    // Hand over the decoded pixels without copying them
+    oPixels = std::move(oResult.oPixels);
     
     if (m_pLogger) {
-        m_pLogger->fn_logInfo("Decoded image: " + std::to_string(iWidth) + "x" + 
-                             std::to_string(iHeight) + " with " + 
-                             std::to_string(iChannels) + " channels");
+        m_pLogger->fn_logInfo("Decoded image: " + std::to_string(oPixels.fn_getWidth()) + "x" + 
+                             std::to_string(oPixels.fn_getHeight()) + " with " + 
+                             std::to_string(oPixels.fn_getChannels()) + " channels");
     }
     
     return true;
 } // End Function fn_decodeHEIC
 
+// Resample the decoded pixels to the requested size
+bool ImageProcessor::fn_applyResize(ImageBuffer& oPixels) 
+{
+    int iDstWidth = 0;
+    int iDstHeight = 0;
+    if (!fn_getResizeTarget(oPixels.fn_getWidth(), oPixels.fn_getHeight(), m_oResize, iDstWidth, iDstHeight)) {
+        return true;
+    }
+    
+    // Rows are split across the same number of workers the tile decode uses
+    ImageBuffer oResized = fn_resizeImage(oPixels, iDstWidth, iDstHeight, m_oResize.eFilter, fn_getWorkThreads());
+    if (oResized.fn_isEmpty()) {
+        m_sLastError = "Failed to resize image to " + std::to_string(iDstWidth) + "x" + std::to_string(iDstHeight);
+        return false;
+    }
+    
+    if (m_pLogger) {
+        m_pLogger->fn_logInfo("Resized " + std::to_string(oPixels.fn_getWidth()) + "x" + 
+                             std::to_string(oPixels.fn_getHeight()) + " to " + 
+                             std::to_string(iDstWidth) + "x" + std::to_string(iDstHeight) + " (" + 
+                             fn_getResizeFilterName(m_oResize.eFilter) + ", " + fn_getResizeKernel() + ")");
+    }
+    
+    oPixels = std::move(oResized);
+    return true;
+} // End Function fn_applyResize
+
 // Encode image to output format
 bool ImageProcessor::fn_encodeImage(
-    const unsigned char* pImageData, 
-    int iWidth, 
-    int iHeight, 
-    int iChannels, 
+    const ImageBuffer& oPixels, 
     const std::string& sOutputPath, 
     const std::string& sOutputFormat, 
     int iQuality
@@ -215,36 +391,12 @@ bool ImageProcessor::fn_encodeImage(
     // Create encoder instance
     FormatEncoder oEncoder;
     
-    // Prepare image data structure
-    sImageData oImageData;
-    oImageData.pData = const_cast<unsigned char*>(pImageData);
-    oImageData.iWidth = iWidth;
-    oImageData.iHeight = iHeight;
-    oImageData.iChannels = iChannels;
-    oImageData.iBitDepth = 8; // Assuming 8-bit for now
-    
-    // Prepare encoding options
-    sEncodeOptions oOptions;
-    oOptions.sFormat = sOutputFormat;
-    oOptions.iQuality = iQuality;
-    
-    // Set format-specific options
-    std::string sLowerFormat = sOutputFormat;
-    std::transform(sLowerFormat.begin(), sLowerFormat.end(), sLowerFormat.begin(), ::tolower);
-    
-    if (sLowerFormat == "png") {
-        oOptions.iCompressionLevel = 6; // Default PNG compression
-        oOptions.bInterlace = false;
-    } else if (sLowerFormat == "jpg" || sLowerFormat == "jpeg") {
-        oOptions.bProgressive = false;
-    } else if (sLowerFormat == "webp") {
-        oOptions.bLossless = false; // Lossy by default
-    } else if (sLowerFormat == "tiff" || sLowerFormat == "tif") {
-        oOptions.iCompressionLevel = 0; // Default TIFF compression
-    }
+    // Describe the pixels (stride included) without copying them
+    sImageData oImageData = fn_makeImageData(oPixels);
     
     // Encode the image
-    bool bResult = oEncoder.fn_encodeImage(oImageData, sOutputPath, oOptions);
+    bool bResult = oEncoder.fn_encodeImage(oImageData, sOutputPath,
+                                           fn_makeEncodeOptions(sOutputFormat, iQuality, oImageData.iWidth, oImageData.iHeight));
     
     if (!bResult) {
         m_sLastError = "Failed to encode image to " + sOutputFormat;
@@ -253,6 +405,50 @@ bool ImageProcessor::fn_encodeImage(
     return bResult;
 } // End Function fn_encodeImage
 
+// Encode an image that arrives one band of rows at a time
+bool ImageProcessor::fn_encodeStream(
+    const sImageStream& oStream, 
+    const std::string& sOutputPath, 
+    const std::string& sOutputFormat, 
+    int iQuality
+) 
+{
+    FormatEncoder oEncoder;
+    bool bResult = oEncoder.fn_encodeStream(oStream, sOutputPath,
+                                            fn_makeEncodeOptions(sOutputFormat, iQuality, oStream.iWidth, oStream.iHeight));
+    
+    if (!bResult) {
+        m_sLastError = "Failed to stream image to " + sOutputFormat;
+    }
+    
+    return bResult;
+} // End Function fn_encodeStream
+
+// Build encoder options for an output format
+sEncodeOptions ImageProcessor::fn_makeEncodeOptions(const std::string& sOutputFormat, int iQuality,
+                                                    int iWidth, int iHeight) 
+{
+    sEncodeOptions oOptions = ::fn_makeEncodeOptions(sOutputFormat, iQuality, fn_getWorkThreads(), m_oOutput,
+                                                     m_oWebP, m_oPng, m_oJpeg, m_oTiff);
+    
+    if (fn_formatCarriesMetadata(sOutputFormat)) {
+        oOptions.vExifData = m_vExifData;
+        sExifEditOptions oExifEdit = m_oExifEdit;
+        oExifEdit.iPixelWidth = iWidth;
+        oExifEdit.iPixelHeight = iHeight;
+        if (!fn_editExif(oOptions.vExifData, oExifEdit) && m_pLogger) {
+            m_pLogger->fn_logWarning("Could not parse the EXIF block for editing");
+        }
+        oOptions.vXmpData = m_vXmpData;
+        oOptions.vIccProfile = m_vIccProfile;
+        oOptions.vIptcData = m_vIptcData;
+        oOptions.bPreserveMetadata = !m_vExifData.empty() || !m_vXmpData.empty() ||
+                                     !m_vIccProfile.empty() || !m_vIptcData.empty();
+    }
+    
+    return oOptions;
+} // End Function fn_makeEncodeOptions
+
 // Validate image file
 bool ImageProcessor::fn_validateImage(const std::string& sImagePath) 
 {
@@ -310,6 +506,89 @@ int ImageProcessor::fn_getOutputQuality()
     return m_iOutputQuality;
 } // End Function fn_getOutputQuality
 
+// Set grid tile decode workers per image
+void ImageProcessor::fn_setTileThreads(int iThreads) 
+{
+    m_iTileThreads = iThreads > 0 ? iThreads : 1;
+} // End Function fn_setTileThreads
+
+// Follow the batch's live thread share instead of a fixed count
+void ImageProcessor::fn_setThreadShare(const fnThreadShare& fnShare) 
+{
+    m_fnThreadShare = fnShare;
+} // End Function fn_setThreadShare
+
+// Threads for the next decode, resize or encode step
+int ImageProcessor::fn_getWorkThreads() const 
+{
+    if (m_fnThreadShare) {
+        return std::max(1, m_fnThreadShare());
+    }
+    return m_iTileThreads;
+} // End Function fn_getWorkThreads
+
+// Set the preview size limit
+void ImageProcessor::fn_setMaxDimension(int iMaxDimension) 
+{
+    m_iMaxDimension = iMaxDimension > 0 ? iMaxDimension : 0;
+} // End Function fn_setMaxDimension
+
+// Set the resize stage options
+void ImageProcessor::fn_setResizeOptions(const sResizeOptions& oOptions) 
+{
+    m_oResize = oOptions;
+} // End Function fn_setResizeOptions
+
+// Set metadata for the JPEG APP segments
+void ImageProcessor::fn_setMetadata(
+    const std::vector<unsigned char>& vExifData,
+    const std::vector<unsigned char>& vXmpData,
+    const std::vector<unsigned char>& vIccProfile,
+    const std::vector<unsigned char>& vIptcData
+) 
+{
+    m_vExifData = vExifData;
+    m_vXmpData = vXmpData;
+    m_vIccProfile = vIccProfile;
+    m_vIptcData = vIptcData;
+} // End Function fn_setMetadata
+
+// Set the EXIF edits applied for each output
+void ImageProcessor::fn_setExifEditOptions(const sExifEditOptions& oOptions) 
+{
+    m_oExifEdit = oOptions;
+} // End Function fn_setExifEditOptions
+
+// Set how output files are published
+void ImageProcessor::fn_setOutputOptions(const sOutputOptions& oOptions) 
+{
+    m_oOutput = oOptions;
+} // End Function fn_setOutputOptions
+
+// Set the WebP encoder settings
+void ImageProcessor::fn_setWebPOptions(const sWebPOptions& oOptions) 
+{
+    m_oWebP = oOptions;
+} // End Function fn_setWebPOptions
+
+// Set the PNG encoder settings
+void ImageProcessor::fn_setPngOptions(const sPngOptions& oOptions) 
+{
+    m_oPng = oOptions;
+} // End Function fn_setPngOptions
+
+// Set the JPEG encoder settings
+void ImageProcessor::fn_setJpegOptions(const sJpegOptions& oOptions) 
+{
+    m_oJpeg = oOptions;
+} // End Function fn_setJpegOptions
+
+// Set the TIFF encoder settings
+void ImageProcessor::fn_setTiffOptions(const sTiffOptions& oOptions) 
+{
+    m_oTiff = oOptions;
+} // End Function fn_setTiffOptions
+
 // Get last error
 std::string ImageProcessor::fn_getLastError() 
 {
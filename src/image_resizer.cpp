@@ -0,0 +1,785 @@
+// image_resizer.cpp - Separable box/bilinear/Lanczos-3 resampling
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "image_resizer.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define IMAGE_RESIZER_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define IMAGE_RESIZER_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+
+const int iWEIGHT_BITS = 14;                                // Fixed-point weight precision
+const int32_t iWEIGHT_ONE = 1 << iWEIGHT_BITS;
+const int32_t iWEIGHT_ROUND = 1 << (iWEIGHT_BITS - 1);
+const double dPI = 3.14159265358979323846;
+
+// Filter taps of every output sample along one axis
+struct sAxisWeights
+{
+    std::vector<int> viStart;          // First source sample per output sample
+    std::vector<int> viCount;          // Taps used per output sample
+    std::vector<int16_t> viWeights;    // iMaxTaps weights per output sample (sum = iWEIGHT_ONE)
+    int iMaxTaps = 0;
+}; // End struct sAxisWeights
+
+// Row kernels for 8-bit samples. Every implementation produces the same
+// bytes as the scalar one: integer sums, arithmetic shift, saturation.
+typedef void (*fnHorizontalKernel)(const uint8_t* pSrc, uint8_t* pDst, int iSrcWidth, int iChannels,
+                                   const sAxisWeights& oColumns);
+typedef void (*fnVerticalKernel)(const uint8_t* const* ppRows, const int16_t* pWeights, int iTaps,
+                                 uint8_t* pDst, int iSamples);
+
+struct sResizeKernel
+{
+    const char* pName;
+    fnHorizontalKernel fnHorizontal;
+    fnVerticalKernel fnVertical;
+}; // End struct sResizeKernel
+
+// Filter radius in source samples at 1:1
+double fn_filterSupport(eResizeFilter eFilter)
+{
+    switch (eFilter)
+    {
+        case eResizeFilter::Box:      return 0.5;
+        case eResizeFilter::Bilinear: return 1.0;
+        case eResizeFilter::Lanczos3: return 3.0;
+    }
+    return 3.0;
+} // End Function fn_filterSupport
+
+double fn_filterValue(eResizeFilter eFilter, double dX)
+{
+    switch (eFilter)
+    {
+        case eResizeFilter::Box:
+            return (dX > -0.5 && dX <= 0.5) ? 1.0 : 0.0;
+        case eResizeFilter::Bilinear:
+            dX = std::fabs(dX);
+            return dX < 1.0 ? 1.0 - dX : 0.0;
+        case eResizeFilter::Lanczos3:
+            if (dX == 0.0)
+            {
+                return 1.0;
+            }
+            if (dX <= -3.0 || dX >= 3.0)
+            {
+                return 0.0;
+            }
+            return 3.0 * std::sin(dPI * dX) * std::sin(dPI * dX / 3.0) / (dPI * dPI * dX * dX);
+    }
+    return 0.0;
+} // End Function fn_filterValue
+
+// Precompute the fixed-point taps for an axis (widened when shrinking so
+// every source sample contributes)
+void fn_buildAxisWeights(int iSrcSize, int iDstSize, eResizeFilter eFilter, sAxisWeights& oWeights)
+{
+    double dScale = static_cast<double>(iSrcSize) / iDstSize;
+    double dFilterScale = std::max(1.0, dScale);
+    double dSupport = fn_filterSupport(eFilter) * dFilterScale;
+
+    oWeights.iMaxTaps = static_cast<int>(std::ceil(dSupport)) * 2 + 1;
+    oWeights.viStart.assign(iDstSize, 0);
+    oWeights.viCount.assign(iDstSize, 0);
+    oWeights.viWeights.assign(static_cast<size_t>(iDstSize) * oWeights.iMaxTaps, 0);
+
+    std::vector<double> vdTaps(oWeights.iMaxTaps);
+    for (int i = 0; i < iDstSize; i++)
+    {
+        double dCenter = (i + 0.5) * dScale;
+        int iBegin = std::max(0, static_cast<int>(std::floor(dCenter - dSupport + 0.5)));
+        int iEnd = std::min(iSrcSize, static_cast<int>(std::floor(dCenter + dSupport + 0.5)));
+        iEnd = std::min(iEnd, iBegin + oWeights.iMaxTaps);
+
+        double dTotal = 0.0;
+        for (int x = iBegin; x < iEnd; x++)
+        {
+            vdTaps[x - iBegin] = fn_filterValue(eFilter, (x - dCenter + 0.5) / dFilterScale);
+            dTotal += vdTaps[x - iBegin];
+        }
+
+        int16_t* pWeights = &oWeights.viWeights[static_cast<size_t>(i) * oWeights.iMaxTaps];
+        if (iEnd <= iBegin || dTotal == 0.0)
+        {
+            // Degenerate window: take the nearest sample
+            iBegin = std::min(iSrcSize - 1, static_cast<int>(dCenter));
+            oWeights.viStart[i] = iBegin;
+            oWeights.viCount[i] = 1;
+            pWeights[0] = static_cast<int16_t>(iWEIGHT_ONE);
+            continue;
+        }
+
+        // Quantise, then give the rounding error to the largest tap so a
+        // flat image stays flat
+        int iCount = iEnd - iBegin;
+        int32_t iSum = 0;
+        int iLargest = 0;
+        for (int k = 0; k < iCount; k++)
+        {
+            long lWeight = std::lround(vdTaps[k] / dTotal * iWEIGHT_ONE);
+            lWeight = std::max<long>(std::numeric_limits<int16_t>::min(),
+                                     std::min<long>(std::numeric_limits<int16_t>::max(), lWeight));
+            pWeights[k] = static_cast<int16_t>(lWeight);
+            iSum += pWeights[k];
+            if (std::abs(pWeights[k]) > std::abs(pWeights[iLargest]))
+            {
+                iLargest = k;
+            }
+        }
+        pWeights[iLargest] = static_cast<int16_t>(pWeights[iLargest] + (iWEIGHT_ONE - iSum));
+
+        // Drop zero taps at both ends
+        int iLead = 0;
+        while (iLead < iCount - 1 && pWeights[iLead] == 0)
+        {
+            iLead++;
+        }
+        if (iLead > 0)
+        {
+            std::memmove(pWeights, pWeights + iLead, (iCount - iLead) * sizeof(int16_t));
+            std::fill(pWeights + iCount - iLead, pWeights + iCount, static_cast<int16_t>(0));
+            iCount -= iLead;
+        }
+        while (iCount > 1 && pWeights[iCount - 1] == 0)
+        {
+            iCount--;
+        }
+
+        oWeights.viStart[i] = iBegin + iLead;
+        oWeights.viCount[i] = iCount;
+    }
+} // End Function fn_buildAxisWeights
+
+template <typename T, typename Acc>
+inline T fn_clampSample(Acc aValue)
+{
+    if (aValue < 0)
+    {
+        return 0;
+    }
+    if (aValue > static_cast<Acc>(std::numeric_limits<T>::max()))
+    {
+        return std::numeric_limits<T>::max();
+    }
+    return static_cast<T>(aValue);
+} // End Function fn_clampSample
+
+// One output pixel of the horizontal pass
+template <typename T, typename Acc>
+inline void fn_horizontalPixel(const T* pSrc, T* pDst, int iChannels, int iCount, const int16_t* pWeights)
+{
+    Acc aSum[4] = {iWEIGHT_ROUND, iWEIGHT_ROUND, iWEIGHT_ROUND, iWEIGHT_ROUND};
+    for (int k = 0; k < iCount; k++, pSrc += iChannels)
+    {
+        for (int c = 0; c < iChannels; c++)
+        {
+            aSum[c] += static_cast<Acc>(pSrc[c]) * pWeights[k];
+        }
+    }
+    for (int c = 0; c < iChannels; c++)
+    {
+        pDst[c] = fn_clampSample<T, Acc>(aSum[c] >> iWEIGHT_BITS);
+    }
+} // End Function fn_horizontalPixel
+
+template <typename T, typename Acc>
+void fn_horizontalScalar(const T* pSrc, T* pDst, int iChannels, const sAxisWeights& oColumns)
+{
+    int iDstWidth = static_cast<int>(oColumns.viStart.size());
+    for (int x = 0; x < iDstWidth; x++)
+    {
+        fn_horizontalPixel<T, Acc>(pSrc + static_cast<size_t>(oColumns.viStart[x]) * iChannels,
+                                   pDst + static_cast<size_t>(x) * iChannels, iChannels, oColumns.viCount[x],
+                                   &oColumns.viWeights[static_cast<size_t>(x) * oColumns.iMaxTaps]);
+    }
+} // End Function fn_horizontalScalar
+
+template <typename T, typename Acc>
+void fn_verticalScalar(const uint8_t* const* ppRows, const int16_t* pWeights, int iTaps, uint8_t* pDst,
+                       int iFirst, int iSamples)
+{
+    T* pOut = reinterpret_cast<T*>(pDst);
+    for (int s = iFirst; s < iSamples; s++)
+    {
+        Acc aSum = iWEIGHT_ROUND;
+        for (int k = 0; k < iTaps; k++)
+        {
+            aSum += static_cast<Acc>(reinterpret_cast<const T*>(ppRows[k])[s]) * pWeights[k];
+        }
+        pOut[s] = fn_clampSample<T, Acc>(aSum >> iWEIGHT_BITS);
+    }
+} // End Function fn_verticalScalar
+
+void fn_horizontalScalar8(const uint8_t* pSrc, uint8_t* pDst, int /*iSrcWidth*/, int iChannels,
+                          const sAxisWeights& oColumns)
+{
+    fn_horizontalScalar<uint8_t, int32_t>(pSrc, pDst, iChannels, oColumns);
+} // End Function fn_horizontalScalar8
+
+void fn_verticalScalar8(const uint8_t* const* ppRows, const int16_t* pWeights, int iTaps, uint8_t* pDst,
+                        int iSamples)
+{
+    fn_verticalScalar<uint8_t, int32_t>(ppRows, pWeights, iTaps, pDst, 0, iSamples);
+} // End Function fn_verticalScalar8
+
+// 4-byte pixel load for the SIMD horizontal kernels. With 3 channels it
+// reads one byte of the next pixel, so the caller keeps it inside the row.
+inline int32_t fn_loadPixel(const uint8_t* pPixel)
+{
+    int32_t iPixel;
+    std::memcpy(&iPixel, pPixel, sizeof(iPixel));
+    return iPixel;
+} // End Function fn_loadPixel
+
+// True when every 4-byte load for this output pixel stays inside the row
+inline bool fn_canLoadPixels(int iStart, int iCount, int iSrcWidth, int iChannels)
+{
+    return iChannels == 4 || iStart + iCount < iSrcWidth;
+} // End Function fn_canLoadPixels
+
+#ifdef IMAGE_RESIZER_X86
+__attribute__((target("sse4.1")))
+void fn_horizontalSse41(const uint8_t* pSrc, uint8_t* pDst, int iSrcWidth, int iChannels,
+                        const sAxisWeights& oColumns)
+{
+    if (iChannels < 3)
+    {
+        fn_horizontalScalar8(pSrc, pDst, iSrcWidth, iChannels, oColumns);
+        return;
+    }
+
+    int iDstWidth = static_cast<int>(oColumns.viStart.size());
+    for (int x = 0; x < iDstWidth; x++, pDst += iChannels)
+    {
+        int iStart = oColumns.viStart[x];
+        int iCount = oColumns.viCount[x];
+        const int16_t* pWeights = &oColumns.viWeights[static_cast<size_t>(x) * oColumns.iMaxTaps];
+        const uint8_t* pPixel = pSrc + static_cast<size_t>(iStart) * iChannels;
+        if (!fn_canLoadPixels(iStart, iCount, iSrcWidth, iChannels))
+        {
+            fn_horizontalPixel<uint8_t, int32_t>(pPixel, pDst, iChannels, iCount, pWeights);
+            continue;
+        }
+
+        __m128i vSum = _mm_set1_epi32(iWEIGHT_ROUND);
+        for (int k = 0; k < iCount; k++, pPixel += iChannels)
+        {
+            __m128i vPixel = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(fn_loadPixel(pPixel)));
+            vSum = _mm_add_epi32(vSum, _mm_mullo_epi32(vPixel, _mm_set1_epi32(pWeights[k])));
+        }
+
+        vSum = _mm_srai_epi32(vSum, iWEIGHT_BITS);
+        __m128i vPacked = _mm_packus_epi16(_mm_packs_epi32(vSum, vSum), vSum);
+        int32_t iOut = _mm_cvtsi128_si32(vPacked);
+        std::memcpy(pDst, &iOut, iChannels);
+    }
+} // End Function fn_horizontalSse41
+
+__attribute__((target("sse4.1")))
+void fn_verticalSse41(const uint8_t* const* ppRows, const int16_t* pWeights, int iTaps, uint8_t* pDst,
+                      int iSamples)
+{
+    const __m128i vZero = _mm_setzero_si128();
+    int s = 0;
+    for (; s + 16 <= iSamples; s += 16)
+    {
+        __m128i vSum0 = _mm_set1_epi32(iWEIGHT_ROUND);
+        __m128i vSum1 = vSum0;
+        __m128i vSum2 = vSum0;
+        __m128i vSum3 = vSum0;
+
+        // Two rows per step: interleaved samples against (w0, w1) pairs
+        for (int k = 0; k < iTaps; k += 2)
+        {
+            bool bPair = k + 1 < iTaps;
+            int32_t iPair = static_cast<uint16_t>(pWeights[k]) |
+                            (bPair ? static_cast<int32_t>(static_cast<uint16_t>(pWeights[k + 1])) << 16 : 0);
+            __m128i vWeights = _mm_set1_epi32(iPair);
+            __m128i vRow0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ppRows[k] + s));
+            __m128i vRow1 = bPair ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(ppRows[k + 1] + s)) : vZero;
+            __m128i vLow = _mm_unpacklo_epi8(vRow0, vRow1);
+            __m128i vHigh = _mm_unpackhi_epi8(vRow0, vRow1);
+            vSum0 = _mm_add_epi32(vSum0, _mm_madd_epi16(_mm_unpacklo_epi8(vLow, vZero), vWeights));
+            vSum1 = _mm_add_epi32(vSum1, _mm_madd_epi16(_mm_unpackhi_epi8(vLow, vZero), vWeights));
+            vSum2 = _mm_add_epi32(vSum2, _mm_madd_epi16(_mm_unpacklo_epi8(vHigh, vZero), vWeights));
+            vSum3 = _mm_add_epi32(vSum3, _mm_madd_epi16(_mm_unpackhi_epi8(vHigh, vZero), vWeights));
+        }
+
+        __m128i vWords0 = _mm_packs_epi32(_mm_srai_epi32(vSum0, iWEIGHT_BITS), _mm_srai_epi32(vSum1, iWEIGHT_BITS));
+        __m128i vWords1 = _mm_packs_epi32(_mm_srai_epi32(vSum2, iWEIGHT_BITS), _mm_srai_epi32(vSum3, iWEIGHT_BITS));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + s), _mm_packus_epi16(vWords0, vWords1));
+    }
+
+    fn_verticalScalar<uint8_t, int32_t>(ppRows, pWeights, iTaps, pDst, s, iSamples);
+} // End Function fn_verticalSse41
+
+__attribute__((target("avx2")))
+void fn_horizontalAvx2(const uint8_t* pSrc, uint8_t* pDst, int iSrcWidth, int iChannels,
+                       const sAxisWeights& oColumns)
+{
+    if (iChannels < 3)
+    {
+        fn_horizontalScalar8(pSrc, pDst, iSrcWidth, iChannels, oColumns);
+        return;
+    }
+
+    int iDstWidth = static_cast<int>(oColumns.viStart.size());
+    for (int x = 0; x < iDstWidth; x++, pDst += iChannels)
+    {
+        int iStart = oColumns.viStart[x];
+        int iCount = oColumns.viCount[x];
+        const int16_t* pWeights = &oColumns.viWeights[static_cast<size_t>(x) * oColumns.iMaxTaps];
+        const uint8_t* pPixel = pSrc + static_cast<size_t>(iStart) * iChannels;
+        if (!fn_canLoadPixels(iStart, iCount, iSrcWidth, iChannels))
+        {
+            fn_horizontalPixel<uint8_t, int32_t>(pPixel, pDst, iChannels, iCount, pWeights);
+            continue;
+        }
+
+        // Two taps per step, one in each 128-bit lane
+        __m256i vSum = _mm256_setzero_si256();
+        int k = 0;
+        for (; k + 2 <= iCount; k += 2, pPixel += 2 * iChannels)
+        {
+            __m128i vPair = _mm_insert_epi32(_mm_cvtsi32_si128(fn_loadPixel(pPixel)),
+                                             fn_loadPixel(pPixel + iChannels), 1);
+            __m256i vWeights = _mm256_setr_epi32(pWeights[k], pWeights[k], pWeights[k], pWeights[k],
+                                                 pWeights[k + 1], pWeights[k + 1], pWeights[k + 1], pWeights[k + 1]);
+            vSum = _mm256_add_epi32(vSum, _mm256_mullo_epi32(_mm256_cvtepu8_epi32(vPair), vWeights));
+        }
+
+        __m128i vTotal = _mm_add_epi32(_mm256_castsi256_si128(vSum), _mm256_extracti128_si256(vSum, 1));
+        vTotal = _mm_add_epi32(vTotal, _mm_set1_epi32(iWEIGHT_ROUND));
+        if (k < iCount)
+        {
+            __m128i vPixel = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(fn_loadPixel(pPixel)));
+            vTotal = _mm_add_epi32(vTotal, _mm_mullo_epi32(vPixel, _mm_set1_epi32(pWeights[k])));
+        }
+
+        vTotal = _mm_srai_epi32(vTotal, iWEIGHT_BITS);
+        __m128i vPacked = _mm_packus_epi16(_mm_packs_epi32(vTotal, vTotal), vTotal);
+        int32_t iOut = _mm_cvtsi128_si32(vPacked);
+        std::memcpy(pDst, &iOut, iChannels);
+    }
+} // End Function fn_horizontalAvx2
+
+__attribute__((target("avx2")))
+void fn_verticalAvx2(const uint8_t* const* ppRows, const int16_t* pWeights, int iTaps, uint8_t* pDst,
+                     int iSamples)
+{
+    // Unpack and pack both work per 128-bit lane, so the byte order
+    // survives the round trip without a permute
+    const __m256i vZero = _mm256_setzero_si256();
+    int s = 0;
+    for (; s + 32 <= iSamples; s += 32)
+    {
+        __m256i vSum0 = _mm256_set1_epi32(iWEIGHT_ROUND);
+        __m256i vSum1 = vSum0;
+        __m256i vSum2 = vSum0;
+        __m256i vSum3 = vSum0;
+
+        for (int k = 0; k < iTaps; k += 2)
+        {
+            bool bPair = k + 1 < iTaps;
+            int32_t iPair = static_cast<uint16_t>(pWeights[k]) |
+                            (bPair ? static_cast<int32_t>(static_cast<uint16_t>(pWeights[k + 1])) << 16 : 0);
+            __m256i vWeights = _mm256_set1_epi32(iPair);
+            __m256i vRow0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ppRows[k] + s));
+            __m256i vRow1 = bPair ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ppRows[k + 1] + s)) : vZero;
+            __m256i vLow = _mm256_unpacklo_epi8(vRow0, vRow1);
+            __m256i vHigh = _mm256_unpackhi_epi8(vRow0, vRow1);
+            vSum0 = _mm256_add_epi32(vSum0, _mm256_madd_epi16(_mm256_unpacklo_epi8(vLow, vZero), vWeights));
+            vSum1 = _mm256_add_epi32(vSum1, _mm256_madd_epi16(_mm256_unpackhi_epi8(vLow, vZero), vWeights));
+            vSum2 = _mm256_add_epi32(vSum2, _mm256_madd_epi16(_mm256_unpacklo_epi8(vHigh, vZero), vWeights));
+            vSum3 = _mm256_add_epi32(vSum3, _mm256_madd_epi16(_mm256_unpackhi_epi8(vHigh, vZero), vWeights));
+        }
+
+        __m256i vWords0 = _mm256_packs_epi32(_mm256_srai_epi32(vSum0, iWEIGHT_BITS), _mm256_srai_epi32(vSum1, iWEIGHT_BITS));
+        __m256i vWords1 = _mm256_packs_epi32(_mm256_srai_epi32(vSum2, iWEIGHT_BITS), _mm256_srai_epi32(vSum3, iWEIGHT_BITS));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + s), _mm256_packus_epi16(vWords0, vWords1));
+    }
+
+    fn_verticalScalar<uint8_t, int32_t>(ppRows, pWeights, iTaps, pDst, s, iSamples);
+} // End Function fn_verticalAvx2
+#endif // IMAGE_RESIZER_X86
+
+#ifdef IMAGE_RESIZER_NEON
+void fn_horizontalNeon(const uint8_t* pSrc, uint8_t* pDst, int iSrcWidth, int iChannels,
+                       const sAxisWeights& oColumns)
+{
+    if (iChannels < 3)
+    {
+        fn_horizontalScalar8(pSrc, pDst, iSrcWidth, iChannels, oColumns);
+        return;
+    }
+
+    int iDstWidth = static_cast<int>(oColumns.viStart.size());
+    for (int x = 0; x < iDstWidth; x++, pDst += iChannels)
+    {
+        int iStart = oColumns.viStart[x];
+        int iCount = oColumns.viCount[x];
+        const int16_t* pWeights = &oColumns.viWeights[static_cast<size_t>(x) * oColumns.iMaxTaps];
+        const uint8_t* pPixel = pSrc + static_cast<size_t>(iStart) * iChannels;
+        if (!fn_canLoadPixels(iStart, iCount, iSrcWidth, iChannels))
+        {
+            fn_horizontalPixel<uint8_t, int32_t>(pPixel, pDst, iChannels, iCount, pWeights);
+            continue;
+        }
+
+        int32x4_t vSum = vdupq_n_s32(iWEIGHT_ROUND);
+        for (int k = 0; k < iCount; k++, pPixel += iChannels)
+        {
+            uint8x8_t vBytes = vreinterpret_u8_s32(vdup_n_s32(fn_loadPixel(pPixel)));
+            int32x4_t vPixel = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(vmovl_u8(vBytes))));
+            vSum = vmlaq_n_s32(vSum, vPixel, pWeights[k]);
+        }
+
+        int16x4_t vWords = vqmovn_s32(vshrq_n_s32(vSum, iWEIGHT_BITS));
+        uint8x8_t vOut = vqmovun_s16(vcombine_s16(vWords, vWords));
+        uint32_t uOut = vget_lane_u32(vreinterpret_u32_u8(vOut), 0);
+        std::memcpy(pDst, &uOut, iChannels);
+    }
+} // End Function fn_horizontalNeon
+
+void fn_verticalNeon(const uint8_t* const* ppRows, const int16_t* pWeights, int iTaps, uint8_t* pDst,
+                     int iSamples)
+{
+    int s = 0;
+    for (; s + 8 <= iSamples; s += 8)
+    {
+        int32x4_t vSumLow = vdupq_n_s32(iWEIGHT_ROUND);
+        int32x4_t vSumHigh = vSumLow;
+        for (int k = 0; k < iTaps; k++)
+        {
+            int16x8_t vRow = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(ppRows[k] + s)));
+            vSumLow = vmlal_n_s16(vSumLow, vget_low_s16(vRow), pWeights[k]);
+            vSumHigh = vmlal_n_s16(vSumHigh, vget_high_s16(vRow), pWeights[k]);
+        }
+
+        int16x8_t vWords = vcombine_s16(vqmovn_s32(vshrq_n_s32(vSumLow, iWEIGHT_BITS)),
+                                        vqmovn_s32(vshrq_n_s32(vSumHigh, iWEIGHT_BITS)));
+        vst1_u8(pDst + s, vqmovun_s16(vWords));
+    }
+
+    fn_verticalScalar<uint8_t, int32_t>(ppRows, pWeights, iTaps, pDst, s, iSamples);
+} // End Function fn_verticalNeon
+#endif // IMAGE_RESIZER_NEON
+
+// Fastest first; the scalar set always works
+const sResizeKernel aKERNELS[] = {
+#ifdef IMAGE_RESIZER_X86
+    {"avx2", fn_horizontalAvx2, fn_verticalAvx2},
+    {"sse4.1", fn_horizontalSse41, fn_verticalSse41},
+#endif
+#ifdef IMAGE_RESIZER_NEON
+    {"neon", fn_horizontalNeon, fn_verticalNeon},
+#endif
+    {"scalar", fn_horizontalScalar8, fn_verticalScalar8},
+};
+
+std::atomic<const sResizeKernel*> pActiveKernel(nullptr);
+
+bool fn_isKernelSupported(const sResizeKernel& oKernel)
+{
+#ifdef IMAGE_RESIZER_X86
+    __builtin_cpu_init();
+    if (std::strcmp(oKernel.pName, "avx2") == 0)
+    {
+        return __builtin_cpu_supports("avx2");
+    }
+    if (std::strcmp(oKernel.pName, "sse4.1") == 0)
+    {
+        return __builtin_cpu_supports("sse4.1");
+    }
+#endif
+    (void)oKernel;
+    return true;
+} // End Function fn_isKernelSupported
+
+const sResizeKernel* fn_getActiveKernel()
+{
+    const sResizeKernel* pKernel = pActiveKernel.load(std::memory_order_acquire);
+    if (pKernel == nullptr)
+    {
+        for (const sResizeKernel& oKernel : aKERNELS)
+        {
+            if (fn_isKernelSupported(oKernel))
+            {
+                pKernel = &oKernel;
+                break;
+            }
+        }
+        pActiveKernel.store(pKernel, std::memory_order_release);
+    }
+    return pKernel;
+} // End Function fn_getActiveKernel
+
+// Run fnBand over [0, iRows) in bands spread across iThreads threads
+template <typename Fn>
+void fn_runRowBands(int iRows, int iThreads, const Fn& fnBand)
+{
+    if (iThreads <= 1 || iRows < 2)
+    {
+        fnBand(0, iRows);
+        return;
+    }
+
+    // A few bands per worker so uneven rows still balance
+    int iBands = std::min(iRows, iThreads * 4);
+    TaskGroup oBands(iThreads);
+    for (int b = 0; b < iBands; b++)
+    {
+        int iBegin = static_cast<int>(static_cast<int64_t>(iRows) * b / iBands);
+        int iEnd = static_cast<int>(static_cast<int64_t>(iRows) * (b + 1) / iBands);
+        oBands.fn_submit([&fnBand, iBegin, iEnd]() { fnBand(iBegin, iEnd); });
+    }
+    oBands.fn_wait();
+} // End Function fn_runRowBands
+
+} // namespace
+
+// Output size for an image under the resize options
+bool fn_getResizeTarget(int iSrcWidth, int iSrcHeight, const sResizeOptions& oOptions,
+                        int& iDstWidth, int& iDstHeight)
+{
+    iDstWidth = iSrcWidth;
+    iDstHeight = iSrcHeight;
+    if (iSrcWidth <= 0 || iSrcHeight <= 0)
+    {
+        return false;
+    }
+
+    double dWidth = iSrcWidth;
+    double dHeight = iSrcHeight;
+    if (oOptions.fScale > 0.0f && oOptions.fScale != 1.0f)
+    {
+        dWidth *= oOptions.fScale;
+        dHeight *= oOptions.fScale;
+    }
+    if (oOptions.iFitWidth > 0 && dWidth > oOptions.iFitWidth)
+    {
+        dHeight *= oOptions.iFitWidth / dWidth;
+        dWidth = oOptions.iFitWidth;
+    }
+    if (oOptions.iFitHeight > 0 && dHeight > oOptions.iFitHeight)
+    {
+        dWidth *= oOptions.iFitHeight / dHeight;
+        dHeight = oOptions.iFitHeight;
+    }
+
+    iDstWidth = std::max(1, static_cast<int>(std::lround(dWidth)));
+    iDstHeight = std::max(1, static_cast<int>(std::lround(dHeight)));
+    return iDstWidth != iSrcWidth || iDstHeight != iSrcHeight;
+} // End Function fn_getResizeTarget
+
+// True when the options can change an image's size
+bool fn_isResizeRequested(const sResizeOptions& oOptions)
+{
+    return (oOptions.fScale > 0.0f && oOptions.fScale != 1.0f) || oOptions.iFitWidth > 0 || oOptions.iFitHeight > 0;
+} // End Function fn_isResizeRequested
+
+// Resample an image with separable passes
+ImageBuffer fn_resizeImage(const ImageBuffer& oSource, int iDstWidth, int iDstHeight,
+                           eResizeFilter eFilter, int iThreads)
+{
+    int iBitDepth = oSource.fn_getBitDepth();
+    if (oSource.fn_isEmpty() || iDstWidth <= 0 || iDstHeight <= 0 || (iBitDepth != 8 && iBitDepth != 16))
+    {
+        return ImageBuffer();
+    }
+
+    int iSrcWidth = oSource.fn_getWidth();
+    int iSrcHeight = oSource.fn_getHeight();
+    int iChannels = oSource.fn_getChannels();
+    bool bScaleX = iDstWidth != iSrcWidth;
+    bool bScaleY = iDstHeight != iSrcHeight;
+    if (!bScaleX && !bScaleY)
+    {
+        return oSource;
+    }
+
+    sAxisWeights oColumns;
+    sAxisWeights oRows;
+    if (bScaleX)
+    {
+        fn_buildAxisWeights(iSrcWidth, iDstWidth, eFilter, oColumns);
+    }
+    if (bScaleY)
+    {
+        fn_buildAxisWeights(iSrcHeight, iDstHeight, eFilter, oRows);
+    }
+
+    ImageBuffer oDest = ImageBuffer::fn_allocate(iDstWidth, iDstHeight, iChannels, iBitDepth);
+    if (oDest.fn_isEmpty())
+    {
+        return oDest;
+    }
+
+    const sResizeKernel* pKernel = fn_getActiveKernel();
+
+    // Horizontal pass, limited to the source rows the vertical taps read
+    ImageBuffer oWide = oSource;
+    int iFirstRow = 0;
+    if (bScaleX)
+    {
+        int iEndRow = iSrcHeight;
+        if (bScaleY)
+        {
+            iFirstRow = iSrcHeight;
+            iEndRow = 0;
+            for (int y = 0; y < iDstHeight; y++)
+            {
+                iFirstRow = std::min(iFirstRow, oRows.viStart[y]);
+                iEndRow = std::max(iEndRow, oRows.viStart[y] + oRows.viCount[y]);
+            }
+            oWide = ImageBuffer::fn_allocate(iDstWidth, iEndRow - iFirstRow, iChannels, iBitDepth);
+            if (oWide.fn_isEmpty())
+            {
+                return oWide;
+            }
+        }
+        else
+        {
+            oWide = oDest;
+        }
+
+        fn_runRowBands(oWide.fn_getHeight(), iThreads, [&](int iBegin, int iEnd)
+        {
+            for (int y = iBegin; y < iEnd; y++)
+            {
+                const unsigned char* pSrc = oSource.fn_getRow(iFirstRow + y);
+                if (iBitDepth == 8)
+                {
+                    pKernel->fnHorizontal(pSrc, oWide.fn_getRow(y), iSrcWidth, iChannels, oColumns);
+                }
+                else
+                {
+                    fn_horizontalScalar<uint16_t, int64_t>(reinterpret_cast<const uint16_t*>(pSrc),
+                                                           reinterpret_cast<uint16_t*>(oWide.fn_getRow(y)),
+                                                           iChannels, oColumns);
+                }
+            }
+        });
+    }
+
+    // Vertical pass
+    if (bScaleY)
+    {
+        int iSamples = iDstWidth * iChannels;
+        fn_runRowBands(iDstHeight, iThreads, [&](int iBegin, int iEnd)
+        {
+            std::vector<const uint8_t*> vpRows(oRows.iMaxTaps);
+            for (int y = iBegin; y < iEnd; y++)
+            {
+                int iCount = oRows.viCount[y];
+                for (int k = 0; k < iCount; k++)
+                {
+                    vpRows[k] = oWide.fn_getRow(oRows.viStart[y] - iFirstRow + k);
+                }
+
+                const int16_t* pWeights = &oRows.viWeights[static_cast<size_t>(y) * oRows.iMaxTaps];
+                if (iBitDepth == 8)
+                {
+                    pKernel->fnVertical(vpRows.data(), pWeights, iCount, oDest.fn_getRow(y), iSamples);
+                }
+                else
+                {
+                    fn_verticalScalar<uint16_t, int64_t>(vpRows.data(), pWeights, iCount, oDest.fn_getRow(y),
+                                                         0, iSamples);
+                }
+            }
+        });
+    }
+
+    return oDest;
+} // End Function fn_resizeImage
+
+// Resize to whatever the options ask for
+ImageBuffer fn_resizeForOptions(const ImageBuffer& oSource, const sResizeOptions& oOptions, int iThreads)
+{
+    int iDstWidth = 0;
+    int iDstHeight = 0;
+    if (!fn_getResizeTarget(oSource.fn_getWidth(), oSource.fn_getHeight(), oOptions, iDstWidth, iDstHeight))
+    {
+        return oSource;
+    }
+
+    return fn_resizeImage(oSource, iDstWidth, iDstHeight, oOptions.eFilter, iThreads);
+} // End Function fn_resizeForOptions
+
+// Parse a --filter name
+bool fn_parseResizeFilter(const std::string& sName, eResizeFilter& eFilter)
+{
+    std::string sLower = sName;
+    std::transform(sLower.begin(), sLower.end(), sLower.begin(), ::tolower);
+
+    if (sLower == "box")
+    {
+        eFilter = eResizeFilter::Box;
+    }
+    else if (sLower == "bilinear" || sLower == "linear" || sLower == "triangle")
+    {
+        eFilter = eResizeFilter::Bilinear;
+    }
+    else if (sLower == "lanczos" || sLower == "lanczos3")
+    {
+        eFilter = eResizeFilter::Lanczos3;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+} // End Function fn_parseResizeFilter
+
+// Name of a filter (as accepted by fn_parseResizeFilter)
+std::string fn_getResizeFilterName(eResizeFilter eFilter)
+{
+    switch (eFilter)
+    {
+        case eResizeFilter::Box:      return "box";
+        case eResizeFilter::Bilinear: return "bilinear";
+        case eResizeFilter::Lanczos3: return "lanczos";
+    }
+    return "lanczos";
+} // End Function fn_getResizeFilterName
+
+// Kernel set in use
+std::string fn_getResizeKernel()
+{
+    return fn_getActiveKernel()->pName;
+} // End Function fn_getResizeKernel
+
+// Select a kernel set by name
+bool fn_setResizeKernel(const std::string& sKernel)
+{
+    for (const sResizeKernel& oKernel : aKERNELS)
+    {
+        if (sKernel == oKernel.pName && fn_isKernelSupported(oKernel))
+        {
+            pActiveKernel.store(&oKernel, std::memory_order_release);
+            return true;
+        }
+    }
+
+    return false;
+} // End Function fn_setResizeKernel
@@ -8,22 +8,37 @@
 #include "logger.h"
 #include "file_utils.h"
 #include "heic_decoder.h"
+#include "image_resizer.h"
+#include "memory_budget.h"
+#include "dedup_index.h"
 #include <iostream>
 #include <vector>
 #include <string>
 #include <cstring>
+#include <stdexcept>
 
 // Function Declarations (Local Functions)
 void fn_showHelp(); // Local Function
 void fn_showVersion(); // Local Function
 int fn_parseArguments(int argc, char* argv[], oConfig& oCurrentConfig); // Local Function
 int fn_processConversion(const oConfig& oCurrentConfig); // Local Function
+int fn_processProbe(const oConfig& oCurrentConfig); // Local Function
 void fn_printWelcome(); // Local Function
 
 // Local Function
 int main(int argc, char* argv[]) 
 { // Begin main
-    fn_printWelcome(); // Local Function
+    // --probe writes JSON lines to stdout, so nothing else may go there
+    bool bProbeOnly = false; // Local Function
+    for (int i = 1; i < argc; i++) 
+    { // Begin for
+        bProbeOnly = bProbeOnly || strcmp(argv[i], "--probe") == 0; // In cstring
+    } // End for(int i = 1; i < argc; i++)
+    
+    if (!bProbeOnly) 
+    { // Begin if
+        fn_printWelcome(); // Local Function
+    } // End if(!bProbeOnly)
     
     oConfig oCurrentConfig = fn_getDefaultConfig(); // In config.cpp
     oLogger oMainLogger; // In logger.h
@@ -43,6 +58,11 @@ int main(int argc, char* argv[])
     // Setup logger based on verbose flag
     oMainLogger.fn_setVerbose(oCurrentConfig.bVerbose); // In logger.cpp
     
+    if (oCurrentConfig.bProbeOnly) 
+    { // Begin if
+        return fn_processProbe(oCurrentConfig); // Local Function
+    } // End if(oCurrentConfig.bProbeOnly)
+    
     // Log configuration if verbose
     if (oCurrentConfig.bVerbose) 
     { // Begin if
@@ -80,12 +100,43 @@ void fn_showHelp()
     std::cout << "                       Default: jpg" << std::endl; // In iostream
     std::cout << "  -q, --quality N      JPEG quality (1-100)" << std::endl; // In iostream
     std::cout << "                       Default: " << iDEFAULT_JPEG_QUALITY << std::endl; // In iostream
-    std::cout << "  -c, --compression N  PNG compression level (0-9)" << std::endl; // In iostream
+    std::cout << "  --parallel-jpeg      Encode a large JPEG as restart-marked strips on" << std::endl; // In iostream
+    std::cout << "                       all threads (baseline only)" << std::endl; // In iostream
+    std::cout << "  -c, --compression N  PNG / TIFF deflate level (0-9)" << std::endl; // In iostream
     std::cout << "                       Default: " << iDEFAULT_PNG_COMPRESSION << std::endl; // In iostream
+    std::cout << "  --png-fast           Fixed PNG row filter and quick deflate" << std::endl; // In iostream
+    std::cout << "  --tiff-compression M TIFF compression: none, lzw or deflate" << std::endl; // In iostream
+    std::cout << "                       Default: deflate" << std::endl; // In iostream
+    std::cout << "  --rendition SPEC     One of several outputs from a single decode:" << std::endl; // In iostream
+    std::cout << "                       FORMAT[:SIZE[:SUFFIX]], repeatable (jpg webp:2048 jpg:320:_thumb)" << std::endl; // In iostream
+    std::cout << "  --renditions FILE    Read rendition specs from FILE, one per line" << std::endl; // In iostream
     std::cout << "  -s, --scale FACTOR   Scale factor (0.1 to 10.0)" << std::endl; // In iostream
     std::cout << "                       Default: " << fDEFAULT_SCALE_FACTOR << std::endl; // In iostream
-    std::cout << "  -t, --threads N      Number of threads for batch processing" << std::endl; // In iostream
+    std::cout << "  --fit WxH            Shrink output to fit within W x H pixels" << std::endl; // In iostream
+    std::cout << "  --filter NAME        Resize filter (box, bilinear, lanczos)" << std::endl; // In iostream
+    std::cout << "                       Default: lanczos" << std::endl; // In iostream
+    std::cout << "  --max-dimension N    Fit output within N pixels, using the embedded" << std::endl; // In iostream
+    std::cout << "                       thumbnail when it is large enough" << std::endl; // In iostream
+    std::cout << "  --lossless           Lossless WebP output" << std::endl; // In iostream
+    std::cout << "  --near-lossless N    Lossless WebP preprocessing (0-100, 100 = off);" << std::endl; // In iostream
+    std::cout << "                       implies --lossless" << std::endl; // In iostream
+    std::cout << "  --webp-effort N      WebP effort, 0 (fastest) to 6 (smallest)" << std::endl; // In iostream
+    std::cout << "                       Default: " << iDEFAULT_WEBP_EFFORT << std::endl; // In iostream
+    std::cout << "  --alpha-quality N    Lossy WebP alpha quality (0-100). Default: 100" << std::endl; // In iostream
+    std::cout << "  -t, --threads N      Number of worker threads for batch processing" << std::endl; // In iostream
     std::cout << "                       Default: " << iDEFAULT_THREAD_COUNT << " (max: " << iMAX_THREAD_COUNT << ")" << std::endl; // In iostream
+    std::cout << "  --sync MODE          Make outputs durable: none, file (fsync each)," << std::endl; // In iostream
+    std::cout << "                       or batch (one syncfs at the end). Default: none" << std::endl; // In iostream
+    std::cout << "  --pipeline           Run batches as a read/decode/encode/write pipeline" << std::endl; // In iostream
+    std::cout << "  --stage-threads R,D,E,W  Threads per pipeline stage (0 = auto)" << std::endl; // In iostream
+    std::cout << "  --queue-depth N      Images buffered between pipeline stages" << std::endl; // In iostream
+    std::cout << "                       Default: " << iDEFAULT_QUEUE_DEPTH << std::endl; // In iostream
+    std::cout << "  --memory-limit SIZE  Decoded image memory for batches (512M, 4G, auto, off)" << std::endl; // In iostream
+    std::cout << "                       Default: auto (80% of the cgroup or RAM limit)" << std::endl; // In iostream
+    std::cout << "  --journal FILE       Record finished files; a rerun skips those still up to date" << std::endl; // In iostream
+    std::cout << "  --dedup MODE         Convert identical inputs once; other copies by link," << std::endl; // In iostream
+    std::cout << "                       clone (reflink) or copy. Default: off" << std::endl; // In iostream
+    std::cout << "  --probe              Print image facts as JSON lines without decoding" << std::endl; // In iostream
     std::cout << "  -r, --recursive      Process directories recursively" << std::endl; // In iostream
     std::cout << "  -o, --overwrite      Overwrite existing files" << std::endl; // In iostream
     std::cout << "  -v, --verbose        Enable verbose output" << std::endl; // In iostream
@@ -95,6 +146,7 @@ void fn_showHelp()
     std::cout << "  --no-xmp             Strip XMP metadata" << std::endl; // NEW
     std::cout << "  --no-iptc            Strip IPTC metadata" << std::endl; // NEW
     std::cout << "  --no-gps             Strip GPS location data" << std::endl; // NEW
+    std::cout << "  --no-makernote       Strip the camera maker's private EXIF data" << std::endl; // In iostream
     std::cout << "  --no-color-profile   Strip color profile from output" << std::endl; // In iostream
     std::cout << "  -h, --help           Show this help message" << std::endl; // In iostream
     std::cout << "  --version            Show version information" << std::endl; // In iostream
@@ -105,6 +157,9 @@ void fn_showHelp()
     std::cout << "  " << sPROGRAM_NAME << " -f png -q 90 image.heic" << std::endl; // In iostream
     std::cout << "  " << sPROGRAM_NAME << " -r -f jpg --no-gps ./input_dir ./output_dir" << std::endl; // NEW example
     std::cout << "  " << sPROGRAM_NAME << " -t 8 -o -v ./photos ./converted" << std::endl; // In iostream
+    std::cout << "  " << sPROGRAM_NAME << " --fit 1920x1080 --filter lanczos ./photos ./web" << std::endl; // In iostream
+    std::cout << "  " << sPROGRAM_NAME << " --max-dimension 320 -f webp ./photos ./previews" << std::endl; // In iostream
+    std::cout << "  " << sPROGRAM_NAME << " --probe -r ./photos > photos.jsonl" << std::endl; // In iostream
     std::cout << std::endl; // In iostream
     std::cout << "Supported input formats: .heic, .heif" << std::endl; // In iostream
     std::cout << "Supported output formats: .jpg, .jpeg, .png, .bmp, .tiff, .webp" << std::endl; // In iostream
@@ -151,14 +206,17 @@ int fn_parseArguments(int argc, char* argv[], oConfig& oCurrentConfig)
     bool bInputFound = false; // Local Function
     bool bOutputFound = false; // Local Function
     
+    // Defaults are set once, so a --no-* flag holds for the later arguments
+    oCurrentConfig.bPreserveTimestamps = true;  // Default
+    oCurrentConfig.bPreserveEXIF = true;        // Default  
+    oCurrentConfig.bPreserveXMP = true;         // Default
+    oCurrentConfig.bPreserveIPTC = true;        // Default
+    oCurrentConfig.bPreserveGPS = true;         // Default
+    oCurrentConfig.bPreserveMakerNote = true;   // Default
+    
     while (iCurrentIndex < vsArguments.size()) 
     { // Begin while
         std::string sCurrentArg = vsArguments[iCurrentIndex]; // Local Function
-        oCurrentConfig.bPreserveTimestamps = true;  // Default
-        oCurrentConfig.bPreserveEXIF = true;        // Default  
-        oCurrentConfig.bPreserveXMP = true;         // Default
-        oCurrentConfig.bPreserveIPTC = true;        // Default
-        oCurrentConfig.bPreserveGPS = true;         // Default
         
         // Check for help flag
         if (sCurrentArg == "-h" || sCurrentArg == "--help") 
@@ -259,6 +317,186 @@ int fn_parseArguments(int argc, char* argv[], oConfig& oCurrentConfig)
             continue; // Continue to next argument
         } // End if(sCurrentArg == "-c" || sCurrentArg == "--compression")
         
+        // Check for parallel JPEG flag
+        if (sCurrentArg == "--parallel-jpeg") 
+        { // Begin if
+            oCurrentConfig.bJpegParallel = true; // Local Function
+            iCurrentIndex++; // Skip flag
+            continue; // Continue to next argument
+        } // End if(sCurrentArg == "--parallel-jpeg")
+        
+        // Check for fast PNG flag
+        if (sCurrentArg == "--png-fast") 
+        { // Begin if
+            oCurrentConfig.bPngFast = true; // Local Function
+            iCurrentIndex++; // Skip flag
+            continue; // Continue to next argument
+        } // End if(sCurrentArg == "--png-fast")
+        
+        // Check for TIFF compression flag
+        if (sCurrentArg == "--tiff-compression") 
+        { // Begin if
+            if (iCurrentIndex + 1 >= vsArguments.size()) 
+            { // Begin if
+                std::cerr << "Error: Missing argument for TIFF compression" << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Missing argument
+            } // End if(iCurrentIndex + 1 >= vsArguments.size())
+            
+            eTiffCompression eCompression; // In format_encoder.h
+            if (!fn_parseTiffCompression(vsArguments[iCurrentIndex + 1], eCompression)) 
+            { // Begin if
+                std::cerr << "Error: Unknown TIFF compression: " << vsArguments[iCurrentIndex + 1] << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Invalid value
+            } // End if(!fn_parseTiffCompression(...))
+            
+            oCurrentConfig.sTiffCompression = fn_getTiffCompressionName(eCompression); // In format_encoder.cpp
+            iCurrentIndex += 2; // Skip TIFF compression and its argument
+            continue; // Continue to next argument
+        } // End if(sCurrentArg == "--tiff-compression")
+        
+        // Check for rendition flag (repeatable)
+        if (sCurrentArg == "--rendition") 
+        { // Begin if
+            if (iCurrentIndex + 1 >= vsArguments.size()) 
+            { // Begin if
+                std::cerr << "Error: Missing argument for rendition" << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Missing argument
+            } // End if(iCurrentIndex + 1 >= vsArguments.size())
+            
+            sRendition oRendition; // In rendition.h
+            if (!fn_parseRendition(vsArguments[iCurrentIndex + 1], oRendition)) 
+            { // Begin if
+                std::cerr << "Error: Invalid rendition: " << vsArguments[iCurrentIndex + 1] << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Invalid value
+            } // End if(!fn_parseRendition(...))
+            
+            oCurrentConfig.vsRenditions.push_back(vsArguments[iCurrentIndex + 1]); // Local Function
+            iCurrentIndex += 2; // Skip rendition and its argument
+            continue; // Continue to next argument
+        } // End if(sCurrentArg == "--rendition")
+        
+        // Check for rendition file flag
+        if (sCurrentArg == "--renditions") 
+        { // Begin if
+            if (iCurrentIndex + 1 >= vsArguments.size()) 
+            { // Begin if
+                std::cerr << "Error: Missing argument for renditions" << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Missing argument
+            } // End if(iCurrentIndex + 1 >= vsArguments.size())
+            
+            std::string sError; // Local Function
+            if (!fn_loadRenditionFile(vsArguments[iCurrentIndex + 1], oCurrentConfig.vsRenditions, sError)) // In rendition.cpp
+            { // Begin if
+                std::cerr << "Error: " << sError << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Unreadable or invalid file
+            } // End if(!fn_loadRenditionFile(...))
+            
+            iCurrentIndex += 2; // Skip renditions and its argument
+            continue; // Continue to next argument
+        } // End if(sCurrentArg == "--renditions")
+        
+        // Check for lossless WebP flag
+        if (sCurrentArg == "--lossless") 
+        { // Begin if
+            oCurrentConfig.bWebPLossless = true; // Local Function
+            iCurrentIndex++; // Skip flag
+            continue; // Continue to next argument
+        } // End if(sCurrentArg == "--lossless")
+        
+        // Check for near-lossless flag
+        if (sCurrentArg == "--near-lossless") 
+        { // Begin if
+            if (iCurrentIndex + 1 >= vsArguments.size()) 
+            { // Begin if
+                std::cerr << "Error: Missing argument for near-lossless" << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Missing argument
+            } // End if(iCurrentIndex + 1 >= vsArguments.size())
+            
+            std::string sNearLossless = vsArguments[iCurrentIndex + 1]; // Local Function
+            try 
+            { // Begin try
+                int iNearLossless = std::stoi(sNearLossless); // Local Function
+                if (iNearLossless < 0 || iNearLossless > 100) 
+                { // Begin if
+                    std::cerr << "Error: Near-lossless must be between 0 and 100" << std::endl; // In iostream
+                    return ERROR_INVALID_ARGUMENTS; // Invalid range
+                } // End if(iNearLossless < 0 || iNearLossless > 100)
+                
+                oCurrentConfig.iWebPNearLossless = iNearLossless; // Local Function
+                oCurrentConfig.bWebPLossless = true; // Near-lossless is a lossless mode
+            } 
+            catch (const std::exception& e) 
+            { // Begin catch
+                std::cerr << "Error: Invalid near-lossless value: " << sNearLossless << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Invalid value
+            } // End catch(const std::exception& e)
+            
+            iCurrentIndex += 2; // Skip near-lossless and its argument
+            continue; // Continue to next argument
+        } // End if(sCurrentArg == "--near-lossless")
+        
+        // Check for WebP effort flag
+        if (sCurrentArg == "--webp-effort") 
+        { // Begin if
+            if (iCurrentIndex + 1 >= vsArguments.size()) 
+            { // Begin if
+                std::cerr << "Error: Missing argument for WebP effort" << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Missing argument
+            } // End if(iCurrentIndex + 1 >= vsArguments.size())
+            
+            std::string sEffort = vsArguments[iCurrentIndex + 1]; // Local Function
+            try 
+            { // Begin try
+                int iEffort = std::stoi(sEffort); // Local Function
+                if (iEffort < 0 || iEffort > 6) 
+                { // Begin if
+                    std::cerr << "Error: WebP effort must be between 0 and 6" << std::endl; // In iostream
+                    return ERROR_INVALID_ARGUMENTS; // Invalid range
+                } // End if(iEffort < 0 || iEffort > 6)
+                
+                oCurrentConfig.iWebPEffort = iEffort; // Local Function
+            } 
+            catch (const std::exception& e) 
+            { // Begin catch
+                std::cerr << "Error: Invalid WebP effort value: " << sEffort << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Invalid value
+            } // End catch(const std::exception& e)
+            
+            iCurrentIndex += 2; // Skip WebP effort and its argument
+            continue; // Continue to next argument
+        } // End if(sCurrentArg == "--webp-effort")
+        
+        // Check for alpha quality flag
+        if (sCurrentArg == "--alpha-quality") 
+        { // Begin if
+            if (iCurrentIndex + 1 >= vsArguments.size()) 
+            { // Begin if
+                std::cerr << "Error: Missing argument for alpha quality" << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Missing argument
+            } // End if(iCurrentIndex + 1 >= vsArguments.size())
+            
+            std::string sAlphaQuality = vsArguments[iCurrentIndex + 1]; // Local Function
+            try 
+            { // Begin try
+                int iAlphaQuality = std::stoi(sAlphaQuality); // Local Function
+                if (iAlphaQuality < 0 || iAlphaQuality > 100) 
+                { // Begin if
+                    std::cerr << "Error: Alpha quality must be between 0 and 100" << std::endl; // In iostream
+                    return ERROR_INVALID_ARGUMENTS; // Invalid range
+                } // End if(iAlphaQuality < 0 || iAlphaQuality > 100)
+                
+                oCurrentConfig.iWebPAlphaQuality = iAlphaQuality; // Local Function
+            } 
+            catch (const std::exception& e) 
+            { // Begin catch
+                std::cerr << "Error: Invalid alpha quality value: " << sAlphaQuality << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Invalid value
+            } // End catch(const std::exception& e)
+            
+            iCurrentIndex += 2; // Skip alpha quality and its argument
+            continue; // Continue to next argument
+        } // End if(sCurrentArg == "--alpha-quality")
+        
         // Check for scale flag
         if (sCurrentArg == "-s" || sCurrentArg == "--scale") 
         { // Begin if
@@ -290,6 +528,118 @@ int fn_parseArguments(int argc, char* argv[], oConfig& oCurrentConfig)
             continue; // Continue to next argument
         } // End if(sCurrentArg == "-s" || sCurrentArg == "--scale")
         
+        // Check for fit-within box flag
+        if (sCurrentArg == "--fit") 
+        { // Begin if
+            if (iCurrentIndex + 1 >= vsArguments.size()) 
+            { // Begin if
+                std::cerr << "Error: Missing argument for fit" << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Missing argument
+            } // End if(iCurrentIndex + 1 >= vsArguments.size())
+            
+            std::string sBox = vsArguments[iCurrentIndex + 1]; // Local Function
+            size_t stSeparator = sBox.find_first_of("xX"); // Local Function
+            try 
+            { // Begin try
+                if (stSeparator == std::string::npos) 
+                { // Begin if
+                    throw std::invalid_argument("missing x");
+                } // End if(stSeparator == std::string::npos)
+                
+                int iFitWidth = std::stoi(sBox.substr(0, stSeparator)); // Local Function
+                int iFitHeight = std::stoi(sBox.substr(stSeparator + 1)); // Local Function
+                if (iFitWidth < 1 || iFitWidth > 65535 || iFitHeight < 1 || iFitHeight > 65535) 
+                { // Begin if
+                    std::cerr << "Error: Fit width and height must be between 1 and 65535" << std::endl; // In iostream
+                    return ERROR_INVALID_ARGUMENTS; // Invalid range
+                } // End if(out of range)
+                
+                oCurrentConfig.iFitWidth = iFitWidth; // Local Function
+                oCurrentConfig.iFitHeight = iFitHeight; // Local Function
+            } 
+            catch (const std::exception& e) 
+            { // Begin catch
+                std::cerr << "Error: Invalid fit box (expected WxH): " << sBox << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Invalid value
+            } // End catch(const std::exception& e)
+            
+            iCurrentIndex += 2; // Skip fit and its argument
+            continue; // Continue to next argument
+        } // End if(sCurrentArg == "--fit")
+        
+        // Check for resize filter flag
+        if (sCurrentArg == "--filter") 
+        { // Begin if
+            if (iCurrentIndex + 1 >= vsArguments.size()) 
+            { // Begin if
+                std::cerr << "Error: Missing argument for filter" << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Missing argument
+            } // End if(iCurrentIndex + 1 >= vsArguments.size())
+            
+            eResizeFilter eFilter; // In image_resizer.h
+            if (!fn_parseResizeFilter(vsArguments[iCurrentIndex + 1], eFilter)) 
+            { // Begin if
+                std::cerr << "Error: Unknown resize filter: " << vsArguments[iCurrentIndex + 1] << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Invalid value
+            } // End if(!fn_parseResizeFilter(...))
+            
+            oCurrentConfig.sResizeFilter = fn_getResizeFilterName(eFilter); // In image_resizer.cpp
+            iCurrentIndex += 2; // Skip filter and its argument
+            continue; // Continue to next argument
+        } // End if(sCurrentArg == "--filter")
+        
+        // Check for output sync flag
+        if (sCurrentArg == "--sync") 
+        { // Begin if
+            if (iCurrentIndex + 1 >= vsArguments.size()) 
+            { // Begin if
+                std::cerr << "Error: Missing argument for sync" << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Missing argument
+            } // End if(iCurrentIndex + 1 >= vsArguments.size())
+            
+            eSyncMode eMode; // In output_file.h
+            if (!fn_parseSyncMode(vsArguments[iCurrentIndex + 1], eMode)) 
+            { // Begin if
+                std::cerr << "Error: Unknown sync mode: " << vsArguments[iCurrentIndex + 1] << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Invalid value
+            } // End if(!fn_parseSyncMode(...))
+            
+            oCurrentConfig.sSyncMode = fn_getSyncModeName(eMode); // In output_file.cpp
+            iCurrentIndex += 2; // Skip sync and its argument
+            continue; // Continue to next argument
+        } // End if(sCurrentArg == "--sync")
+        
+        // Check for max dimension flag
+        if (sCurrentArg == "--max-dimension") 
+        { // Begin if
+            if (iCurrentIndex + 1 >= vsArguments.size()) 
+            { // Begin if
+                std::cerr << "Error: Missing argument for max dimension" << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Missing argument
+            } // End if(iCurrentIndex + 1 >= vsArguments.size())
+            
+            std::string sDimension = vsArguments[iCurrentIndex + 1]; // Local Function
+            try 
+            { // Begin try
+                int iDimension = std::stoi(sDimension); // Local Function
+                if (iDimension < 1 || iDimension > 65535) 
+                { // Begin if
+                    std::cerr << "Error: Max dimension must be between 1 and 65535" << std::endl; // In iostream
+                    return ERROR_INVALID_ARGUMENTS; // Invalid range
+                } // End if(iDimension < 1 || iDimension > 65535)
+                
+                oCurrentConfig.iMaxDimension = iDimension; // Local Function
+            } 
+            catch (const std::exception& e) 
+            { // Begin catch
+                std::cerr << "Error: Invalid max dimension: " << sDimension << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Invalid value
+            } // End catch(const std::exception& e)
+            
+            iCurrentIndex += 2; // Skip max dimension and its argument
+            continue; // Continue to next argument
+        } // End if(sCurrentArg == "--max-dimension")
+        
         // Check for threads flag
         if (sCurrentArg == "-t" || sCurrentArg == "--threads") 
         { // Begin if
@@ -321,7 +671,162 @@ int fn_parseArguments(int argc, char* argv[], oConfig& oCurrentConfig)
             continue; // Continue to next argument
         } // End if(sCurrentArg == "-t" || sCurrentArg == "--threads")
         
+        // Check for pipeline stage threads flag
+        if (sCurrentArg == "--stage-threads") 
+        { // Begin if
+            if (iCurrentIndex + 1 >= vsArguments.size()) 
+            { // Begin if
+                std::cerr << "Error: Missing argument for stage threads" << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Missing argument
+            } // End if(iCurrentIndex + 1 >= vsArguments.size())
+            
+            std::string sStages = vsArguments[iCurrentIndex + 1]; // Local Function
+            std::vector<int> viStages; // Local Function
+            try 
+            { // Begin try
+                size_t stStart = 0; // Local Function
+                while (stStart <= sStages.size()) 
+                { // Begin while
+                    size_t stComma = sStages.find(',', stStart); // In string
+                    if (stComma == std::string::npos) 
+                    { // Begin if
+                        stComma = sStages.size();
+                    } // End if(stComma == std::string::npos)
+                    viStages.push_back(std::stoi(sStages.substr(stStart, stComma - stStart))); // In string
+                    stStart = stComma + 1;
+                } // End while(stStart <= sStages.size())
+            } 
+            catch (const std::exception& e) 
+            { // Begin catch
+                viStages.clear();
+            } // End catch(const std::exception& e)
+            
+            if (viStages.size() != 4) 
+            { // Begin if
+                std::cerr << "Error: Stage threads must be R,D,E,W (e.g. 1,4,3,1): " << sStages << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Invalid value
+            } // End if(viStages.size() != 4)
+            
+            for (int iStage : viStages) 
+            { // Begin for
+                if (iStage < 0 || iStage > iMAX_THREAD_COUNT) 
+                { // Begin if
+                    std::cerr << "Error: Stage thread count must be between 0 and " << iMAX_THREAD_COUNT << std::endl; // In iostream
+                    return ERROR_INVALID_ARGUMENTS; // Invalid range
+                } // End if(iStage < 0 || iStage > iMAX_THREAD_COUNT)
+            } // End for(int iStage : viStages)
+            
+            oCurrentConfig.iReadThreads = viStages[0]; // Local Function
+            oCurrentConfig.iDecodeThreads = viStages[1]; // Local Function
+            oCurrentConfig.iEncodeThreads = viStages[2]; // Local Function
+            oCurrentConfig.iWriteThreads = viStages[3]; // Local Function
+            oCurrentConfig.bUsePipeline = true; // Implied by explicit stage counts
+            iCurrentIndex += 2; // Skip stage threads and its argument
+            continue; // Continue to next argument
+        } // End if(sCurrentArg == "--stage-threads")
+        
+        // Check for queue depth flag
+        if (sCurrentArg == "--queue-depth") 
+        { // Begin if
+            if (iCurrentIndex + 1 >= vsArguments.size()) 
+            { // Begin if
+                std::cerr << "Error: Missing argument for queue depth" << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Missing argument
+            } // End if(iCurrentIndex + 1 >= vsArguments.size())
+            
+            std::string sDepth = vsArguments[iCurrentIndex + 1]; // Local Function
+            try 
+            { // Begin try
+                int iDepth = std::stoi(sDepth); // Local Function
+                if (iDepth < 1 || iDepth > 256) 
+                { // Begin if
+                    std::cerr << "Error: Queue depth must be between 1 and 256" << std::endl; // In iostream
+                    return ERROR_INVALID_ARGUMENTS; // Invalid range
+                } // End if(iDepth < 1 || iDepth > 256)
+                
+                oCurrentConfig.iQueueDepth = iDepth; // Local Function
+            } 
+            catch (const std::exception& e) 
+            { // Begin catch
+                std::cerr << "Error: Invalid queue depth: " << sDepth << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Invalid value
+            } // End catch(const std::exception& e)
+            
+            iCurrentIndex += 2; // Skip queue depth and its argument
+            continue; // Continue to next argument
+        } // End if(sCurrentArg == "--queue-depth")
+        
+        // Check for memory limit flag
+        if (sCurrentArg == "--memory-limit") 
+        { // Begin if
+            if (iCurrentIndex + 1 >= vsArguments.size()) 
+            { // Begin if
+                std::cerr << "Error: Missing argument for memory limit" << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Missing argument
+            } // End if(iCurrentIndex + 1 >= vsArguments.size())
+            
+            uint64_t ullLimit = 0; // Local Function
+            if (!fn_resolveMemoryLimit(vsArguments[iCurrentIndex + 1], ullLimit)) 
+            { // Begin if
+                std::cerr << "Error: Invalid memory limit: " << vsArguments[iCurrentIndex + 1] << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Invalid value
+            } // End if(!fn_resolveMemoryLimit(...))
+            
+            oCurrentConfig.sMemoryLimit = vsArguments[iCurrentIndex + 1]; // Local Function
+            iCurrentIndex += 2; // Skip memory limit and its argument
+            continue; // Continue to next argument
+        } // End if(sCurrentArg == "--memory-limit")
+        
+        // Check for journal flag
+        if (sCurrentArg == "--journal") 
+        { // Begin if
+            if (iCurrentIndex + 1 >= vsArguments.size()) 
+            { // Begin if
+                std::cerr << "Error: Missing argument for journal" << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Missing argument
+            } // End if(iCurrentIndex + 1 >= vsArguments.size())
+            
+            oCurrentConfig.sJournalPath = vsArguments[iCurrentIndex + 1]; // Local Function
+            iCurrentIndex += 2; // Skip journal and its argument
+            continue; // Continue to next argument
+        } // End if(sCurrentArg == "--journal")
+        
+        // Check for dedup flag
+        if (sCurrentArg == "--dedup") 
+        { // Begin if
+            if (iCurrentIndex + 1 >= vsArguments.size()) 
+            { // Begin if
+                std::cerr << "Error: Missing argument for dedup" << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Missing argument
+            } // End if(iCurrentIndex + 1 >= vsArguments.size())
+            
+            eDedupMode eMode; // In dedup_index.h
+            if (!fn_parseDedupMode(vsArguments[iCurrentIndex + 1], eMode)) 
+            { // Begin if
+                std::cerr << "Error: Invalid dedup mode: " << vsArguments[iCurrentIndex + 1] << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Invalid value
+            } // End if(!fn_parseDedupMode(...))
+            
+            oCurrentConfig.sDedupMode = vsArguments[iCurrentIndex + 1]; // Local Function
+            iCurrentIndex += 2; // Skip dedup and its argument
+            continue; // Continue to next argument
+        } // End if(sCurrentArg == "--dedup")
+        
         // Check for boolean flags
+        if (sCurrentArg == "--probe") 
+        { // Begin if
+            oCurrentConfig.bProbeOnly = true; // Local Function
+            iCurrentIndex++; // Skip flag
+            continue; // Continue to next argument
+        } // End if(sCurrentArg == "--probe")
+        
+        if (sCurrentArg == "--pipeline") 
+        { // Begin if
+            oCurrentConfig.bUsePipeline = true; // Local Function
+            iCurrentIndex++; // Skip flag
+            continue; // Continue to next argument
+        } // End if(sCurrentArg == "--pipeline")
+        
         if (sCurrentArg == "-r" || sCurrentArg == "--recursive") 
         { // Begin if
             oCurrentConfig.bRecursive = true; // Local Function
@@ -351,6 +856,7 @@ int fn_parseArguments(int argc, char* argv[], oConfig& oCurrentConfig)
             oCurrentConfig.bPreserveXMP = false;  // Also disable XMP
             oCurrentConfig.bPreserveIPTC = false; // Also disable IPTC
             oCurrentConfig.bPreserveGPS = false;  // Also disable GPS
+            oCurrentConfig.bPreserveMakerNote = false; // Also disable MakerNote
             iCurrentIndex++; // Skip flag
             continue; // Continue to next argument
         } // End if(sCurrentArg == "--no-metadata")
@@ -390,6 +896,13 @@ int fn_parseArguments(int argc, char* argv[], oConfig& oCurrentConfig)
             continue; // Continue to next argument
         } // End if(sCurrentArg == "--no-gps")
         
+        if (sCurrentArg == "--no-makernote") 
+        { // Begin if
+            oCurrentConfig.bPreserveMakerNote = false; // Local Function
+            iCurrentIndex++; // Skip flag
+            continue; // Continue to next argument
+        } // End if(sCurrentArg == "--no-makernote")
+        
         if (sCurrentArg == "--no-color-profile") 
         { // Begin if
             oCurrentConfig.bStripColorProfile = true; // Local Function
@@ -417,6 +930,21 @@ int fn_parseArguments(int argc, char* argv[], oConfig& oCurrentConfig)
         iCurrentIndex++; // Move to next argument
     } // End while(iCurrentIndex < vsArguments.size())
     
+    // Two renditions must not write the same file
+    std::vector<sRendition> vRenditions = fn_makeRenditions(oCurrentConfig); // In converter.cpp
+    for (size_t i = 0; i < vRenditions.size(); ++i) 
+    { // Begin for
+        for (size_t j = 0; j < i; ++j) 
+        { // Begin for
+            if (vRenditions[i].sFormat == vRenditions[j].sFormat && vRenditions[i].sSuffix == vRenditions[j].sSuffix) 
+            { // Begin if
+                std::cerr << "Error: Renditions " << oCurrentConfig.vsRenditions[j] << " and " 
+                          << oCurrentConfig.vsRenditions[i] << " write the same file" << std::endl; // In iostream
+                return ERROR_INVALID_ARGUMENTS; // Output name clash
+            } // End if(same format and suffix)
+        } // End for(size_t j = 0; j < i; ++j)
+    } // End for(size_t i = 0; i < vRenditions.size(); ++i)
+    
     // Validate input path
     if (oCurrentConfig.sInputPath.empty()) 
     { // Begin if
@@ -463,6 +991,32 @@ int fn_processConversion(const oConfig& oCurrentConfig)
         
         // Create batch processor
         BatchProcessor oBatch; // Fixed: Use oBatch consistently
+        oBatch.fn_setThreadCount(oCurrentConfig.iThreadCount); // In batch_processor.cpp
+        oBatch.fn_setMaxDimension(oCurrentConfig.iMaxDimension); // In batch_processor.cpp
+        oBatch.fn_setResizeOptions(fn_makeResizeOptions(oCurrentConfig)); // In converter.cpp
+        oBatch.fn_setExifEditOptions(fn_makeExifEditOptions(oCurrentConfig)); // In converter.cpp
+        oBatch.fn_setOutputOptions(fn_makeOutputOptions(oCurrentConfig)); // In converter.cpp
+        oBatch.fn_setWebPOptions(fn_makeWebPOptions(oCurrentConfig)); // In converter.cpp
+        oBatch.fn_setPngOptions(fn_makePngOptions(oCurrentConfig)); // In converter.cpp
+        oBatch.fn_setJpegOptions(fn_makeJpegOptions(oCurrentConfig)); // In converter.cpp
+        oBatch.fn_setTiffOptions(fn_makeTiffOptions(oCurrentConfig)); // In converter.cpp
+        oBatch.fn_setRenditions(fn_makeRenditions(oCurrentConfig)); // In converter.cpp
+        oBatch.fn_setMemoryLimit(fn_makeMemoryLimit(oCurrentConfig)); // In converter.cpp
+        oBatch.fn_setJournalPath(oCurrentConfig.sJournalPath); // In batch_processor.cpp
+        oBatch.fn_setDedupMode(fn_makeDedupMode(oCurrentConfig)); // In converter.cpp
+        
+        if (oCurrentConfig.bUsePipeline) 
+        { // Begin if
+            sPipelineOptions oStages; // In conversion_pipeline.h
+            oStages.iReadThreads = oCurrentConfig.iReadThreads;
+            oStages.iDecodeThreads = oCurrentConfig.iDecodeThreads;
+            oStages.iEncodeThreads = oCurrentConfig.iEncodeThreads;
+            oStages.iWriteThreads = oCurrentConfig.iWriteThreads;
+            oStages.iQueueDepth = oCurrentConfig.iQueueDepth;
+            oBatch.fn_setPipelineOptions(oStages); // In batch_processor.cpp
+            oBatch.fn_setPipelineMode(true); // In batch_processor.cpp
+        } // End if(oCurrentConfig.bUsePipeline)
+        
         int iBatchResult = oBatch.fn_processDirectory(
            oCurrentConfig.sInputPath,
            oCurrentConfig.sOutputFormat.substr(1),  // Remove the dot from extension
@@ -494,10 +1048,39 @@ int fn_processConversion(const oConfig& oCurrentConfig)
             oCurrentConfig.sOutputPath // Local Function
         );
         
+        if (iConvertResult == ERROR_SUCCESS && fn_makeOutputOptions(oCurrentConfig).eSync == eSyncMode::Batch) 
+        { // Begin if
+            fn_syncOutputFilesystem(oCurrentConfig.sOutputPath); // In output_file.cpp
+        } // End if(batch sync)
+        
         return iConvertResult; // Return conversion result
     } // End else
 } // End Function fn_processConversion
 
+// Local Function
+int fn_processProbe(const oConfig& oCurrentConfig) 
+{ // Begin fn_processProbe
+    oLogger oProbeLogger; // In logger.h
+    
+    if (!fn_fileExists(oCurrentConfig.sInputPath)) 
+    { // Begin if
+        oProbeLogger.fn_logError("Input path does not exist: " + oCurrentConfig.sInputPath); // In logger.cpp
+        return ERROR_FILE_NOT_FOUND; // File not found
+    } // End if(!fn_fileExists(oCurrentConfig.sInputPath))
+    
+    BatchProcessor oBatch; // In batch_processor.h
+    oBatch.fn_setThreadCount(oCurrentConfig.iThreadCount); // In batch_processor.cpp
+    
+    if (fn_isDirectory(oCurrentConfig.sInputPath)) 
+    { // Begin if
+        bool bProbed = oBatch.fn_probeDirectory(oCurrentConfig.sInputPath, oCurrentConfig.bRecursive, std::cout); // In batch_processor.cpp
+        return bProbed ? ERROR_SUCCESS : ERROR_BATCH_PROCESSING;
+    } // End if(fn_isDirectory(oCurrentConfig.sInputPath))
+    
+    bool bProbed = oBatch.fn_probeFiles({oCurrentConfig.sInputPath}, std::cout); // In batch_processor.cpp
+    return bProbed ? ERROR_SUCCESS : ERROR_DECODING_FAILED;
+} // End Function fn_processProbe
+
 void fn_debugHeicFile(const std::string& sFilePath)
 {
     // Check if file exists first
@@ -0,0 +1,200 @@
+// mapped_file.cpp - Read-only memory-mapped input file with read() fallback
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "mapped_file.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Constructor
+MappedFile::MappedFile()
+    : m_pData(nullptr),
+      m_stSize(0),
+      m_bMapped(false)
+{
+} // End Function MappedFile::MappedFile
+
+// Destructor
+MappedFile::~MappedFile()
+{
+    fn_close();
+} // End Function MappedFile::~MappedFile
+
+// Move constructor
+MappedFile::MappedFile(MappedFile&& oOther) noexcept
+    : m_pData(oOther.m_pData),
+      m_stSize(oOther.m_stSize),
+      m_bMapped(oOther.m_bMapped),
+      m_pBuffer(std::move(oOther.m_pBuffer)),
+      m_sLastError(std::move(oOther.m_sLastError))
+{
+    oOther.m_pData = nullptr;
+    oOther.m_stSize = 0;
+    oOther.m_bMapped = false;
+} // End Function MappedFile::MappedFile(MappedFile&&)
+
+// Move assignment
+MappedFile& MappedFile::operator=(MappedFile&& oOther) noexcept
+{
+    if (this != &oOther)
+    {
+        fn_close();
+        m_pData = oOther.m_pData;
+        m_stSize = oOther.m_stSize;
+        m_bMapped = oOther.m_bMapped;
+        m_pBuffer = std::move(oOther.m_pBuffer);
+        m_sLastError = std::move(oOther.m_sLastError);
+        oOther.m_pData = nullptr;
+        oOther.m_stSize = 0;
+        oOther.m_bMapped = false;
+    }
+
+    return *this;
+} // End Function MappedFile::operator=
+
+// Unmap or free the file bytes
+void MappedFile::fn_close()
+{
+    if (m_bMapped && m_pData)
+    {
+        munmap(const_cast<unsigned char*>(m_pData), m_stSize);
+    }
+
+    m_pBuffer.reset();
+    m_pData = nullptr;
+    m_stSize = 0;
+    m_bMapped = false;
+} // End Function MappedFile::fn_close
+
+// Map a file read-only, falling back to read() when mapping is not possible
+bool MappedFile::fn_open(const std::string& sFilePath, eMapAccess eAccess)
+{
+    fn_close();
+
+    int iFd = open(sFilePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (iFd < 0)
+    {
+        m_sLastError = "Cannot open file: " + sFilePath + " (" + strerror(errno) + ")";
+        return false;
+    }
+
+    struct stat oStat;
+    if (fstat(iFd, &oStat) != 0)
+    {
+        m_sLastError = "Cannot stat file: " + sFilePath + " (" + strerror(errno) + ")";
+        close(iFd);
+        return false;
+    }
+
+    // Pipes, character devices and the like cannot be mapped
+    if (!S_ISREG(oStat.st_mode))
+    {
+        bool bRead = fn_readFallback(iFd, sFilePath, 0);
+        close(iFd);
+        return bRead;
+    }
+
+    if (oStat.st_size <= 0)
+    {
+        m_sLastError = "File is empty: " + sFilePath;
+        close(iFd);
+        return false;
+    }
+
+    size_t stSize = static_cast<size_t>(oStat.st_size);
+    int iFlags = MAP_PRIVATE;
+    #ifdef MAP_POPULATE
+    if (eAccess == eMapAccess::Prefault)
+    {
+        iFlags |= MAP_POPULATE;
+    }
+    #endif
+
+    void* pMap = mmap(nullptr, stSize, PROT_READ, iFlags, iFd, 0);
+    if (pMap == MAP_FAILED)
+    {
+        // Some filesystems (FUSE, certain network mounts) refuse mmap
+        bool bRead = fn_readFallback(iFd, sFilePath, stSize);
+        close(iFd);
+        return bRead;
+    }
+
+    // The mapping holds its own reference to the file
+    close(iFd);
+
+    // Start readahead now; the HEIF parser jumps between boxes, so the
+    // sequential hint is only given when the caller asks for it
+    madvise(pMap, stSize, MADV_WILLNEED);
+    if (eAccess == eMapAccess::Sequential)
+    {
+        madvise(pMap, stSize, MADV_SEQUENTIAL);
+    }
+
+    m_pData = static_cast<const unsigned char*>(pMap);
+    m_stSize = stSize;
+    m_bMapped = true;
+    m_sLastError = "";
+    return true;
+} // End Function MappedFile::fn_open
+
+// Read the whole descriptor into an owned buffer
+bool MappedFile::fn_readFallback(int iFd, const std::string& sFilePath, size_t stSizeHint)
+{
+    size_t stCapacity = stSizeHint > 0 ? stSizeHint : 1 << 20;
+    std::unique_ptr<unsigned char[]> pBuffer(new unsigned char[stCapacity]);
+    size_t stUsed = 0;
+
+    for (;;)
+    {
+        if (stUsed == stCapacity)
+        {
+            // Size unknown (or the file grew): double the buffer
+            std::unique_ptr<unsigned char[]> pLarger(new unsigned char[stCapacity * 2]);
+            memcpy(pLarger.get(), pBuffer.get(), stUsed);
+            pBuffer.swap(pLarger);
+            stCapacity *= 2;
+        }
+
+        ssize_t iRead = read(iFd, pBuffer.get() + stUsed, stCapacity - stUsed);
+        if (iRead < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            m_sLastError = "Failed to read file: " + sFilePath + " (" + strerror(errno) + ")";
+            return false;
+        }
+
+        if (iRead == 0)
+        {
+            break;
+        }
+
+        stUsed += static_cast<size_t>(iRead);
+
+        // A regular file is complete once the stat size is reached
+        if (stSizeHint > 0 && stUsed == stSizeHint)
+        {
+            break;
+        }
+    }
+
+    if (stUsed == 0)
+    {
+        m_sLastError = "File is empty: " + sFilePath;
+        return false;
+    }
+
+    m_pBuffer = std::move(pBuffer);
+    m_pData = m_pBuffer.get();
+    m_stSize = stUsed;
+    m_bMapped = false;
+    m_sLastError = "";
+    return true;
+} // End Function MappedFile::fn_readFallback
+
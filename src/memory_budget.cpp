@@ -0,0 +1,303 @@
+// memory_budget.cpp - Per-file cost estimates and memory admission control
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "memory_budget.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+
+const uint64_t ullCGROUP_V1_UNLIMITED = 1ull << 60;  // v1 reports "no limit" as a huge page-rounded number
+const uint64_t ullLIVE_FRAME_COPIES = 3;             // Decoder planes, RGB frame, resize / encoder copy
+const uint64_t ullUNPROBED_EXPANSION = 24;           // ~8x HEVC compression times the live copies
+const uint64_t ullPIXELS_PER_FILE_BYTE = 4;          // Typical HEVC stills: 0.2-0.3 bytes per pixel
+const int iAUTO_LIMIT_PERCENT = 80;                  // Headroom for code, libraries and page cache
+
+// First line of a small file ("" when it cannot be read)
+std::string fn_readFirstLine(const std::string& sPath)
+{
+    std::ifstream oFile(sPath);
+    std::string sLine;
+    std::getline(oFile, sLine);
+    return sLine;
+} // End Function fn_readFirstLine
+
+// This process's cgroup v2 path from /proc/self/cgroup ("0::/path")
+std::string fn_getOwnCgroupPath()
+{
+    std::ifstream oFile("/proc/self/cgroup");
+    std::string sLine;
+    while (std::getline(oFile, sLine))
+    {
+        if (sLine.compare(0, 3, "0::") == 0)
+        {
+            return sLine.substr(3);
+        }
+    }
+    return std::string();
+} // End Function fn_getOwnCgroupPath
+
+} // End anonymous namespace
+
+// Read a cgroup memory limit
+uint64_t fn_readCgroupMemoryLimit(const std::string& sCgroupDirectory)
+{
+    for (const char* pName : {"/memory.max", "/memory.limit_in_bytes"})
+    {
+        std::string sValue = fn_readFirstLine(sCgroupDirectory + pName);
+        if (sValue.empty())
+        {
+            continue;
+        }
+        if (sValue == "max")
+        {
+            return 0;
+        }
+        uint64_t ullBytes = 0;
+        if (!fn_parseMemorySize(sValue, ullBytes) || ullBytes >= ullCGROUP_V1_UNLIMITED)
+        {
+            return 0;
+        }
+        return ullBytes;
+    }
+    return 0;
+} // End Function fn_readCgroupMemoryLimit
+
+// Memory limit of this process
+uint64_t fn_getSystemMemoryLimit()
+{
+    uint64_t ullLimit = 0;
+
+    // Our own cgroup first (a container's root is usually the same
+    // directory), then the v1 memory controller
+    std::string sOwnPath = fn_getOwnCgroupPath();
+    if (!sOwnPath.empty() && sOwnPath != "/")
+    {
+        ullLimit = fn_readCgroupMemoryLimit("/sys/fs/cgroup" + sOwnPath);
+    }
+    if (ullLimit == 0)
+    {
+        ullLimit = fn_readCgroupMemoryLimit("/sys/fs/cgroup");
+    }
+    if (ullLimit == 0)
+    {
+        ullLimit = fn_readCgroupMemoryLimit("/sys/fs/cgroup/memory");
+    }
+
+    long lPages = sysconf(_SC_PHYS_PAGES);
+    long lPageSize = sysconf(_SC_PAGESIZE);
+    if (lPages > 0 && lPageSize > 0)
+    {
+        uint64_t ullPhysical = static_cast<uint64_t>(lPages) * static_cast<uint64_t>(lPageSize);
+        ullLimit = ullLimit == 0 ? ullPhysical : std::min(ullLimit, ullPhysical);
+    }
+    return ullLimit;
+} // End Function fn_getSystemMemoryLimit
+
+// Parse a byte count with an optional binary suffix
+bool fn_parseMemorySize(const std::string& sText, uint64_t& ullBytes)
+{
+    size_t stEnd = 0;
+    double dValue = 0.0;
+    try
+    {
+        dValue = std::stod(sText, &stEnd);
+    }
+    catch (...)
+    {
+        return false;
+    }
+    if (!(dValue >= 0.0) || sText.empty() || !std::isdigit(static_cast<unsigned char>(sText[0])))
+    {
+        return false;
+    }
+
+    std::string sSuffix = sText.substr(stEnd);
+    std::transform(sSuffix.begin(), sSuffix.end(), sSuffix.begin(), ::toupper);
+    if (sSuffix.size() > 1 && (sSuffix.substr(1) == "B" || sSuffix.substr(1) == "IB"))
+    {
+        sSuffix = sSuffix.substr(0, 1);
+    }
+
+    double dScale = 1.0;
+    if (sSuffix == "K")
+    {
+        dScale = 1024.0;
+    }
+    else if (sSuffix == "M")
+    {
+        dScale = 1024.0 * 1024.0;
+    }
+    else if (sSuffix == "G")
+    {
+        dScale = 1024.0 * 1024.0 * 1024.0;
+    }
+    else if (sSuffix == "T")
+    {
+        dScale = 1024.0 * 1024.0 * 1024.0 * 1024.0;
+    }
+    else if (!sSuffix.empty() && sSuffix != "B")
+    {
+        return false;
+    }
+
+    double dBytes = std::floor(dValue * dScale);
+    if (dBytes >= 18446744073709551615.0)
+    {
+        return false;
+    }
+    ullBytes = static_cast<uint64_t>(dBytes);
+    return true;
+} // End Function fn_parseMemorySize
+
+// Short human readable size
+std::string fn_formatMemorySize(uint64_t ullBytes)
+{
+    const char* aUNITS[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    double dValue = static_cast<double>(ullBytes);
+    int iUnit = 0;
+    while (dValue >= 1024.0 && iUnit < 4)
+    {
+        dValue /= 1024.0;
+        iUnit++;
+    }
+    char aText[32];
+    snprintf(aText, sizeof(aText), iUnit == 0 ? "%.0f %s" : "%.1f %s", dValue, aUNITS[iUnit]);
+    return aText;
+} // End Function fn_formatMemorySize
+
+// Resolve a --memory-limit setting
+bool fn_resolveMemoryLimit(const std::string& sSetting, uint64_t& ullBytes)
+{
+    if (sSetting == "auto")
+    {
+        ullBytes = fn_getSystemMemoryLimit() / 100 * iAUTO_LIMIT_PERCENT;
+        return true;
+    }
+    if (sSetting == "off")
+    {
+        ullBytes = 0;
+        return true;
+    }
+    return fn_parseMemorySize(sSetting, ullBytes);
+} // End Function fn_resolveMemoryLimit
+
+// Peak bytes for a probed file
+uint64_t fn_estimateConversionBytes(const sHeifProbe& oProbe)
+{
+    return fn_getProbeDecodeBytes(oProbe) * ullLIVE_FRAME_COPIES + oProbe.ullFileSize;
+} // End Function fn_estimateConversionBytes
+
+// Peak bytes for a file on disk
+uint64_t fn_estimateFileConversionBytes(const std::string& sFilePath)
+{
+    return fn_estimateFileCost(sFilePath).ullPeakBytes;
+} // End Function fn_estimateFileConversionBytes
+
+// Peak bytes for a file already in memory
+uint64_t fn_estimateMemoryConversionBytes(const unsigned char* pData, size_t stSize)
+{
+    sHeifProbe oProbe;
+    std::string sError;
+    if (fn_probeHeifMemory(pData, stSize, oProbe, sError) && oProbe.iWidth > 0 && oProbe.iHeight > 0)
+    {
+        return fn_estimateConversionBytes(oProbe);
+    }
+    return static_cast<uint64_t>(stSize) * ullUNPROBED_EXPANSION;
+} // End Function fn_estimateMemoryConversionBytes
+
+// Work and peak memory for a file on disk
+sConversionCost fn_estimateFileCost(const std::string& sFilePath)
+{
+    sConversionCost oCost;
+    sHeifProbe oProbe;
+    std::string sError;
+    if (fn_probeHeifFile(sFilePath, oProbe, sError) && oProbe.iWidth > 0 && oProbe.iHeight > 0)
+    {
+        oCost.ullWork = static_cast<uint64_t>(oProbe.iWidth) * static_cast<uint64_t>(oProbe.iHeight);
+        oCost.ullPeakBytes = fn_estimateConversionBytes(oProbe);
+        return oCost;
+    }
+
+    struct stat oStat;
+    if (stat(sFilePath.c_str(), &oStat) == 0)
+    {
+        oCost.ullWork = static_cast<uint64_t>(oStat.st_size) * ullPIXELS_PER_FILE_BYTE;
+        oCost.ullPeakBytes = static_cast<uint64_t>(oStat.st_size) * ullUNPROBED_EXPANSION;
+    }
+    return oCost;
+} // End Function fn_estimateFileCost
+
+// Largest work first
+std::vector<size_t> fn_orderByCost(const std::vector<sConversionCost>& vCosts)
+{
+    std::vector<size_t> vstOrder(vCosts.size());
+    std::iota(vstOrder.begin(), vstOrder.end(), 0);
+    std::stable_sort(vstOrder.begin(), vstOrder.end(), [&vCosts](size_t a, size_t b)
+    {
+        return vCosts[a].ullWork > vCosts[b].ullWork;
+    });
+    return vstOrder;
+} // End Function fn_orderByCost
+
+// Constructor
+MemoryBudget::MemoryBudget(uint64_t ullLimit)
+    : m_ullLimit(ullLimit), m_ullInFlight(0), m_iActive(0), m_ullNextTicket(0), m_ullServing(0)
+{
+} // End Constructor
+
+// Wait for room in the budget, in arrival order
+uint64_t MemoryBudget::fn_acquire(uint64_t ullBytes)
+{
+    if (m_ullLimit == 0 || ullBytes == 0)
+    {
+        return 0;
+    }
+
+    std::unique_lock<std::mutex> oLock(m_oMutex);
+    uint64_t ullTicket = m_ullNextTicket++;
+    m_oChanged.wait(oLock, [this, ullTicket, ullBytes]()
+    {
+        return ullTicket == m_ullServing && (m_iActive == 0 || m_ullInFlight + ullBytes <= m_ullLimit);
+    });
+
+    m_ullServing++;
+    m_ullInFlight += ullBytes;
+    m_iActive++;
+    oLock.unlock();
+
+    // The next ticket may fit as well
+    m_oChanged.notify_all();
+    return ullBytes;
+} // End Function fn_acquire
+
+// Return admitted bytes
+void MemoryBudget::fn_release(uint64_t ullBytes)
+{
+    if (m_ullLimit == 0 || ullBytes == 0)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> oLock(m_oMutex);
+        m_ullInFlight -= std::min(ullBytes, m_ullInFlight);
+        m_iActive = std::max(0, m_iActive - 1);
+    }
+    m_oChanged.notify_all();
+} // End Function fn_release
+
+// Bytes currently admitted
+uint64_t MemoryBudget::fn_getInFlight() const
+{
+    std::lock_guard<std::mutex> oLock(m_oMutex);
+    return m_ullInFlight;
+} // End Function fn_getInFlight
@@ -1,5 +1,6 @@
 #include "metadata_handler.h"
 #include "logger.h"
+#include "heif_container.h"
 #include <fstream>
 #include <vector>
 #include <cstring>
@@ -27,104 +28,84 @@ MetadataHandler::~MetadataHandler() {
 }
 
 std::vector<unsigned char> MetadataHandler::extractExifFromHeic(const std::string& filepath) {
-    std::vector<unsigned char> exifData;
-    
-    #ifdef HAVE_LIBHEIF
-    struct heif_error err;
-    
-    // Create context
-    struct heif_context* ctx = heif_context_alloc();
-    if (!ctx) {
-        fn_logError("Failed to allocate HEIF context");
-        return exifData;
+    HeifContainer container;
+    if (!container.fn_openFile(filepath)) {
+        fn_logError("Failed to read HEIF file: " + container.fn_getLastError());
+        return std::vector<unsigned char>();
     }
     
-    // Read file
-    err = heif_context_read_from_file(ctx, filepath.c_str(), nullptr);
-    if (err.code != heif_error_Ok) {
-        fn_logError(std::string("Failed to read HEIF file: ") + err.message);
-        heif_context_free(ctx);
-        return exifData;
+    return extractExif(container);
+}
+
+std::vector<unsigned char> MetadataHandler::extractExifFromHeicData(const std::vector<unsigned char>& data) {
+    HeifContainer container;
+    if (!container.fn_openMemory(data.data(), data.size())) {
+        fn_logError("Failed to read HEIF data: " + container.fn_getLastError());
+        return std::vector<unsigned char>();
     }
     
-    // Get primary image handle
-    struct heif_image_handle* handle = nullptr;
-    err = heif_context_get_primary_image_handle(ctx, &handle);
-    if (err.code != heif_error_Ok) {
-        fn_logError(std::string("Failed to get image handle: ") + err.message);
-        heif_context_free(ctx);
-        return exifData;
-    }
+    return extractExif(container);
+}
+
+std::vector<unsigned char> MetadataHandler::extractExif(const HeifContainer& container) {
+    std::vector<unsigned char> exifData;
     
-    // Get EXIF metadata
-    heif_item_id exif_id;
-    int count = heif_image_handle_get_list_of_metadata_block_IDs(handle, "Exif", &exif_id, 1);
+    #ifdef HAVE_LIBHEIF
+    exifData = container.fn_getExifBlock();
+    size_t exif_size = exifData.size();
     
-    if (count > 0) {
-        size_t exif_size = heif_image_handle_get_metadata_size(handle, exif_id);
-        exifData.resize(exif_size);
+    if (exif_size > 0) {
+        fn_logInfo("Raw EXIF size from libheif: " + std::to_string(exif_size));
         
-        err = heif_image_handle_get_metadata(handle, exif_id, exifData.data());
-        if (err.code != heif_error_Ok) {
-            fn_logError("Failed to read EXIF data");
-            exifData.clear();
-        } else {
-            fn_logInfo("Raw EXIF size from libheif: " + std::to_string(exif_size));
+        // Check the structure
+        if (exif_size >= 10) {
+            // HEIF stores EXIF with a 4-byte length prefix
+            // The format is: [4-byte length][6-byte "Exif\0\0"][TIFF data]
+            // We need to strip the 4-byte length for JPEG APP1 segment
             
-            // Check the structure
-            if (exif_size >= 10) {
-                // HEIF stores EXIF with a 4-byte length prefix
-                // The format is: [4-byte length][6-byte "Exif\0\0"][TIFF data]
-                // We need to strip the 4-byte length for JPEG APP1 segment
+            // Verify it has the expected structure
+            if (exifData[4] == 'E' && exifData[5] == 'x' && 
+                exifData[6] == 'i' && exifData[7] == 'f' &&
+                exifData[8] == 0 && exifData[9] == 0) {
+                
+                // Extract the length (big-endian)
+                uint32_t length_prefix = (exifData[0] << 24) | 
+                                        (exifData[1] << 16) | 
+                                        (exifData[2] << 8) | 
+                                        exifData[3];
+                
+                fn_logInfo("HEIF EXIF length prefix: " + std::to_string(length_prefix));
+                
+                // Remove the 4-byte length prefix
+                std::vector<unsigned char> cleanExifData;
+                cleanExifData.reserve(exif_size - 4);
+                
+                // Start from byte 4 (skip the length prefix)
+                cleanExifData.insert(cleanExifData.end(), 
+                                    exifData.begin() + 4, 
+                                    exifData.end());
                 
-                // Verify it has the expected structure
-                if (exifData[4] == 'E' && exifData[5] == 'x' && 
-                    exifData[6] == 'i' && exifData[7] == 'f' &&
-                    exifData[8] == 0 && exifData[9] == 0) {
-                    
-                    // Extract the length (big-endian)
-                    uint32_t length_prefix = (exifData[0] << 24) | 
-                                            (exifData[1] << 16) | 
-                                            (exifData[2] << 8) | 
-                                            exifData[3];
-                    
-                    fn_logInfo("HEIF EXIF length prefix: " + std::to_string(length_prefix));
-                    
-                    // Remove the 4-byte length prefix
-                    std::vector<unsigned char> cleanExifData;
-                    cleanExifData.reserve(exif_size - 4);
-                    
-                    // Start from byte 4 (skip the length prefix)
-                    cleanExifData.insert(cleanExifData.end(), 
-                                        exifData.begin() + 4, 
-                                        exifData.end());
-                    
-                    exifData = cleanExifData;
-                    fn_logInfo("Removed 4-byte length prefix, new size: " + std::to_string(exifData.size()));
-                    
-                    // Verify the TIFF header
-                    if (exifData.size() >= 8) {
-                        if (exifData[6] == 'I' && exifData[7] == 'I') {
-                            fn_logInfo("TIFF header: II (Intel, little-endian)");
-                        } else if (exifData[6] == 'M' && exifData[7] == 'M') {
-                            fn_logInfo("TIFF header: MM (Motorola, big-endian)");
-                        } else {
-                            fn_logWarning("Invalid TIFF header after cleanup");
-                        }
+                exifData = cleanExifData;
+                fn_logInfo("Removed 4-byte length prefix, new size: " + std::to_string(exifData.size()));
+                
+                // Verify the TIFF header
+                if (exifData.size() >= 8) {
+                    if (exifData[6] == 'I' && exifData[7] == 'I') {
+                        fn_logInfo("TIFF header: II (Intel, little-endian)");
+                    } else if (exifData[6] == 'M' && exifData[7] == 'M') {
+                        fn_logInfo("TIFF header: MM (Motorola, big-endian)");
+                    } else {
+                        fn_logWarning("Invalid TIFF header after cleanup");
                     }
-                } else {
-                    fn_logWarning("EXIF data doesn't have expected structure");
                 }
+            } else {
+                fn_logWarning("EXIF data doesn't have expected structure");
             }
         }
     } else {
         fn_logInfo("No EXIF metadata found in HEIC file");
     }
     
-    // Cleanup
-    heif_image_handle_release(handle);
-    heif_context_free(ctx);
-    
     #else
     fn_logWarning("libheif not available for metadata extraction");
     #endif
@@ -134,47 +115,20 @@ std::vector<unsigned char> MetadataHandler::extractExifFromHeic(const std::strin
 }
 
 std::vector<unsigned char> MetadataHandler::extractXmpFromHeic(const std::string& filepath) {
-    std::vector<unsigned char> xmpData;
-    
-    #ifdef HAVE_LIBHEIF
-    struct heif_error err;
-    struct heif_context* ctx = heif_context_alloc();
-    if (!ctx) return xmpData;
-    
-    err = heif_context_read_from_file(ctx, filepath.c_str(), nullptr);
-    if (err.code != heif_error_Ok) {
-        heif_context_free(ctx);
-        return xmpData;
+    HeifContainer container;
+    if (!container.fn_openFile(filepath)) {
+        return std::vector<unsigned char>();
     }
     
-    struct heif_image_handle* handle = nullptr;
-    err = heif_context_get_primary_image_handle(ctx, &handle);
-    if (err.code != heif_error_Ok) {
-        heif_context_free(ctx);
-        return xmpData;
-    }
-    
-    // Get XMP metadata
-    heif_item_id xmp_id;
-    int count = heif_image_handle_get_list_of_metadata_block_IDs(handle, "mime", &xmp_id, 1);
-    
-    if (count > 0) {
-        const char* mime_type = heif_image_handle_get_metadata_type(handle, xmp_id);
-        if (mime_type && strstr(mime_type, "application/rdf+xml")) {
-            size_t xmp_size = heif_image_handle_get_metadata_size(handle, xmp_id);
-            xmpData.resize(xmp_size);
-            err = heif_image_handle_get_metadata(handle, xmp_id, xmpData.data());
-            if (err.code != heif_error_Ok) {
-                xmpData.clear();
-            }
-        }
-    }
-    
-    heif_image_handle_release(handle);
-    heif_context_free(ctx);
-    #endif
-    
-    return xmpData;
+    return extractXmp(container);
+}
+
+std::vector<unsigned char> MetadataHandler::extractXmp(const HeifContainer& container) {
+    return container.fn_getXmpBlock();
+}
+
+std::vector<unsigned char> MetadataHandler::extractIccProfile(const HeifContainer& container) {
+    return container.fn_getIccProfile();
 }
 
 bool MetadataHandler::writeExifToJpeg(const std::string& jpegFile, const std::vector<unsigned char>& exifData) {
@@ -182,42 +136,8 @@ bool MetadataHandler::writeExifToJpeg(const std::string& jpegFile, const std::ve
         return true;
     }
     
-    // Use exiftool to do it correctly (if available)
-    // This is the most reliable approach
-    std::string tempFile = jpegFile + ".tmp";
-    
-    // First copy the JPEG without EXIF
-    std::ifstream in(jpegFile, std::ios::binary);
-    std::ofstream out(tempFile, std::ios::binary);
-    out << in.rdbuf();
-    in.close();
-    out.close();
-    
-    // Write EXIF to a temporary file
-    std::string exifFile = jpegFile + ".exif";
-    std::ofstream exifOut(exifFile, std::ios::binary);
-    exifOut.write(reinterpret_cast<const char*>(exifData.data()), exifData.size());
-    exifOut.close();
-    
-    // Try using exiftool if available
-    std::string command = "which exiftool > /dev/null 2>&1";
-    if (system(command.c_str()) == 0) {
-        command = "exiftool -overwrite_original -tagsFromFile \"\" -exif:all=\"\" \"" + tempFile + "\" > /dev/null 2>&1";
-        
-        command = "exiftool -overwrite_original -exif=\"<" + exifFile + "\" \"" + tempFile + "\" > /dev/null 2>&1";
-        if (system(command.c_str()) == 0) {
-            // Replace original with temp file
-            std::rename(tempFile.c_str(), jpegFile.c_str());
-            std::remove(exifFile.c_str());
-            fn_logInfo("Used exiftool to write EXIF metadata");
-            return true;
-        }
-    }
-    
-    // Fall back to our implementation
-    std::remove(tempFile.c_str());
-    std::remove(exifFile.c_str());
-    
+    // Files from our own encoder already carry their APP segments; this
+    // in-place rewrite is for JPEGs produced some other way
     // Read the entire JPEG file
     std::ifstream inputFile(jpegFile, std::ios::binary);
     if (!inputFile.is_open()) {
@@ -0,0 +1,404 @@
+// output_file.cpp - Atomic output file: temporary file, one buffered stream, link into place
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "output_file.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+const size_t stSTREAM_BUFFER_BYTES = 1024 * 1024;   // One write() per MiB of encoded output
+
+// Directory part of a path ("." when there is none)
+std::string fn_getDirectory(const std::string& sPath)
+{
+    size_t stSlash = sPath.find_last_of('/');
+    if (stSlash == std::string::npos)
+    {
+        return ".";
+    }
+    return stSlash == 0 ? "/" : sPath.substr(0, stSlash);
+} // End Function fn_getDirectory
+
+// Hidden name next to sPath, unique within this process
+std::string fn_makeTempPath(const std::string& sPath)
+{
+    static std::atomic<unsigned int> uCounter(0);
+    size_t stSlash = sPath.find_last_of('/');
+    std::string sName = stSlash == std::string::npos ? sPath : sPath.substr(stSlash + 1);
+    std::string sDirectory = stSlash == std::string::npos ? std::string() : sPath.substr(0, stSlash + 1);
+    return sDirectory + "." + sName + "." + std::to_string(getpid()) + "." + std::to_string(++uCounter) + ".tmp";
+} // End Function fn_makeTempPath
+} // namespace
+
+// Parse a --sync mode
+bool fn_parseSyncMode(const std::string& sName, eSyncMode& eMode)
+{
+    if (sName == "none")
+    {
+        eMode = eSyncMode::None;
+    }
+    else if (sName == "file")
+    {
+        eMode = eSyncMode::File;
+    }
+    else if (sName == "batch")
+    {
+        eMode = eSyncMode::Batch;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+} // End Function fn_parseSyncMode
+
+// Name of a sync mode
+std::string fn_getSyncModeName(eSyncMode eMode)
+{
+    switch (eMode)
+    {
+        case eSyncMode::File:
+            return "file";
+        case eSyncMode::Batch:
+            return "batch";
+        default:
+            return "none";
+    }
+} // End Function fn_getSyncModeName
+
+// Take the access and modification times of a source file
+bool fn_setOutputTimesFrom(const std::string& sSourcePath, sOutputOptions& oOptions)
+{
+    struct stat oStat;
+    if (stat(sSourcePath.c_str(), &oStat) != 0)
+    {
+        oOptions.bSetTimes = false;
+        return false;
+    }
+
+    oOptions.aTimes[0] = oStat.st_atim;
+    oOptions.aTimes[1] = oStat.st_mtim;
+    oOptions.bSetTimes = true;
+    return true;
+} // End Function fn_setOutputTimesFrom
+
+// Constructor
+OutputFile::OutputFile()
+    : m_iFd(-1),
+      m_pStream(nullptr),
+      m_ullReserved(0)
+{
+} // End Function OutputFile::OutputFile
+
+// Destructor
+OutputFile::~OutputFile()
+{
+    fn_discard();
+} // End Function OutputFile::~OutputFile
+
+// Record an error with the current errno
+bool OutputFile::fn_fail(const std::string& sWhat)
+{
+    int iError = errno;
+    m_sLastError = sWhat + ": " + std::strerror(iError);
+    return false;
+} // End Function OutputFile::fn_fail
+
+// Close the stream (which owns the descriptor) or the bare descriptor
+void OutputFile::fn_closeFd()
+{
+    if (m_pStream)
+    {
+        fclose(m_pStream);
+        m_pStream = nullptr;
+    }
+    else if (m_iFd >= 0)
+    {
+        close(m_iFd);
+    }
+
+    m_iFd = -1;
+    m_pBuffer.reset();
+} // End Function OutputFile::fn_closeFd
+
+// Drop the output
+void OutputFile::fn_discard()
+{
+    fn_closeFd();
+    if (!m_sTempPath.empty())
+    {
+        unlink(m_sTempPath.c_str());
+        m_sTempPath.clear();
+    }
+    m_ullReserved = 0;
+} // End Function OutputFile::fn_discard
+
+// Create the temporary file in the destination directory
+bool OutputFile::fn_open(const std::string& sFilePath, uint64_t ullSizeHint)
+{
+    fn_discard();
+    m_sFilePath = sFilePath;
+    m_sLastError.clear();
+
+    // An unnamed file never shows up in the directory, even after a crash;
+    // it is linked through /proc at commit time
+    #ifdef O_TMPFILE
+    if (access("/proc/self/fd", X_OK) == 0)
+    {
+        m_iFd = open(fn_getDirectory(sFilePath).c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0666);
+    }
+    #endif
+
+    // Filesystems without O_TMPFILE get a hidden name next to the output
+    for (int iTry = 0; m_iFd < 0 && iTry < 100; iTry++)
+    {
+        m_sTempPath = fn_makeTempPath(sFilePath);
+        m_iFd = open(m_sTempPath.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+        if (m_iFd < 0 && errno != EEXIST)
+        {
+            break;
+        }
+    }
+    if (m_iFd < 0)
+    {
+        m_sTempPath.clear();
+        return fn_fail("Cannot create output file for " + sFilePath);
+    }
+
+    // Reserve the expected size in one extent; the file size is unchanged,
+    // and any surplus is released at commit
+    #ifdef FALLOC_FL_KEEP_SIZE
+    if (ullSizeHint > 0 && fallocate(m_iFd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(ullSizeHint)) == 0)
+    {
+        m_ullReserved = ullSizeHint;
+    }
+    #else
+    (void)ullSizeHint;
+    #endif
+
+    return true;
+} // End Function OutputFile::fn_open
+
+// Buffered stream on the temporary file
+FILE* OutputFile::fn_getStream()
+{
+    if (!m_pStream && m_iFd >= 0)
+    {
+        m_pStream = fdopen(m_iFd, "wb");
+        if (!m_pStream)
+        {
+            fn_fail("Cannot open output stream for " + m_sFilePath);
+            return nullptr;
+        }
+        m_pBuffer.reset(new char[stSTREAM_BUFFER_BYTES]);
+        setvbuf(m_pStream, m_pBuffer.get(), _IOFBF, stSTREAM_BUFFER_BYTES);
+    }
+
+    return m_pStream;
+} // End Function OutputFile::fn_getStream
+
+// Append bytes through the stream
+bool OutputFile::fn_write(const void* pData, size_t stSize)
+{
+    FILE* pStream = fn_getStream();
+    if (!pStream || fwrite(pData, 1, stSize, pStream) != stSize)
+    {
+        return fn_fail("Failed to write " + m_sFilePath);
+    }
+    return true;
+} // End Function OutputFile::fn_write
+
+// Give the temporary file its final name
+bool OutputFile::fn_publish(bool bReplace)
+{
+    if (m_sTempPath.empty())
+    {
+        std::string sProcPath = "/proc/self/fd/" + std::to_string(m_iFd);
+        if (linkat(AT_FDCWD, sProcPath.c_str(), AT_FDCWD, m_sFilePath.c_str(), AT_SYMLINK_FOLLOW) == 0)
+        {
+            return true;
+        }
+        if (errno != EEXIST || !bReplace)
+        {
+            return fn_fail("Cannot create " + m_sFilePath);
+        }
+
+        // linkat() never replaces, so link under a temporary name and rename
+        // that over the existing file
+        for (int iTry = 0; iTry < 100; iTry++)
+        {
+            m_sTempPath = fn_makeTempPath(m_sFilePath);
+            if (linkat(AT_FDCWD, sProcPath.c_str(), AT_FDCWD, m_sTempPath.c_str(), AT_SYMLINK_FOLLOW) == 0)
+            {
+                break;
+            }
+            int iError = errno;
+            m_sTempPath.clear();
+            if (iError != EEXIST)
+            {
+                errno = iError;
+                return fn_fail("Cannot create " + m_sFilePath);
+            }
+        }
+        if (m_sTempPath.empty())
+        {
+            return fn_fail("Cannot create " + m_sFilePath);
+        }
+    }
+
+    if (bReplace)
+    {
+        if (rename(m_sTempPath.c_str(), m_sFilePath.c_str()) != 0)
+        {
+            return fn_fail("Cannot rename output to " + m_sFilePath);
+        }
+        m_sTempPath.clear();
+        return true;
+    }
+
+    // link() fails atomically when another writer already took the name
+    if (link(m_sTempPath.c_str(), m_sFilePath.c_str()) == 0)
+    {
+        unlink(m_sTempPath.c_str());
+        m_sTempPath.clear();
+        return true;
+    }
+    if (errno == EEXIST)
+    {
+        return fn_fail("Output already exists: " + m_sFilePath);
+    }
+
+    // Filesystems without hard links
+    if (access(m_sFilePath.c_str(), F_OK) != 0 && rename(m_sTempPath.c_str(), m_sFilePath.c_str()) == 0)
+    {
+        m_sTempPath.clear();
+        return true;
+    }
+    return fn_fail("Cannot create " + m_sFilePath);
+} // End Function OutputFile::fn_publish
+
+// Flush, apply times, sync and move into place
+bool OutputFile::fn_commit(const sOutputOptions& oOptions)
+{
+    if (m_iFd < 0)
+    {
+        m_sLastError = "Output is not open: " + m_sFilePath;
+        return false;
+    }
+
+    if (m_pStream && (fflush(m_pStream) != 0 || ferror(m_pStream)))
+    {
+        fn_fail("Failed to write " + m_sFilePath);
+        fn_discard();
+        return false;
+    }
+
+    // Release what the size hint reserved beyond the data
+    struct stat oStat;
+    if (m_ullReserved > 0 && fstat(m_iFd, &oStat) == 0 && static_cast<uint64_t>(oStat.st_size) < m_ullReserved &&
+        ftruncate(m_iFd, oStat.st_size) != 0)
+    {
+        fn_fail("Failed to trim " + m_sFilePath);
+        fn_discard();
+        return false;
+    }
+
+    // Times go on the descriptor, so the path is never reopened; a failure
+    // here leaves the current time, as before
+    if (oOptions.bSetTimes)
+    {
+        futimens(m_iFd, oOptions.aTimes);
+    }
+
+    if (oOptions.eSync == eSyncMode::File && fsync(m_iFd) != 0)
+    {
+        fn_fail("Failed to sync " + m_sFilePath);
+        fn_discard();
+        return false;
+    }
+
+    if (!fn_publish(oOptions.bReplace))
+    {
+        std::string sError = m_sLastError;
+        fn_discard();
+        m_sLastError = sError;
+        return false;
+    }
+
+    // The new directory entry must reach the disk too
+    if (oOptions.eSync == eSyncMode::File)
+    {
+        int iDirFd = open(fn_getDirectory(m_sFilePath).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (iDirFd >= 0)
+        {
+            fsync(iDirFd);
+            close(iDirFd);
+        }
+    }
+
+    fn_closeFd();
+    m_ullReserved = 0;
+    return true;
+} // End Function OutputFile::fn_commit
+
+// Write a whole encoded buffer as one atomic output
+bool fn_writeOutputFile(const std::string& sFilePath, const void* pData, size_t stSize,
+                        const sOutputOptions& oOptions, std::string& sError)
+{
+    OutputFile oFile;
+    if (!oFile.fn_open(sFilePath, stSize))
+    {
+        sError = oFile.fn_getLastError();
+        return false;
+    }
+
+    // The buffer is already complete, so it skips the stdio copy
+    const char* pBytes = static_cast<const char*>(pData);
+    size_t stDone = 0;
+    while (stDone < stSize)
+    {
+        ssize_t sstWritten = write(oFile.fn_getFd(), pBytes + stDone, stSize - stDone);
+        if (sstWritten < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (sstWritten <= 0)
+        {
+            sError = "Failed to write " + sFilePath + ": " + std::strerror(errno);
+            return false;
+        }
+        stDone += static_cast<size_t>(sstWritten);
+    }
+
+    if (!oFile.fn_commit(oOptions))
+    {
+        sError = oFile.fn_getLastError();
+        return false;
+    }
+    return true;
+} // End Function fn_writeOutputFile
+
+// One syncfs() for the filesystem holding sPath
+bool fn_syncOutputFilesystem(const std::string& sPath)
+{
+    int iFd = open(sPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (iFd < 0)
+    {
+        return false;
+    }
+
+    #ifdef __linux__
+    bool bSynced = syncfs(iFd) == 0;
+    #else
+    bool bSynced = fsync(iFd) == 0;
+    sync();
+    #endif
+    close(iFd);
+    return bSynced;
+} // End Function fn_syncOutputFilesystem
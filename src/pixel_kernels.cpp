@@ -0,0 +1,676 @@
+// pixel_kernels.cpp - Swizzle, alpha, narrowing and grey row kernels
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "pixel_kernels.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define PIXEL_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PIXEL_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+
+// Every kernel set handles a vector-sized prefix of the row and leaves the
+// rest to these scalar loops, so all sets share one rounding rule
+typedef void (*fnSwapKernel)(const uint8_t* pSrc, uint8_t* pDst, int iPixels, int iChannels);
+typedef void (*fnBlendKernel)(const uint8_t* pSrc, uint8_t* pDst, int iPixels, const uint8_t* pBackground);
+typedef void (*fnPremultiplyKernel)(const uint8_t* pSrc, uint8_t* pDst, int iPixels, int iChannels);
+typedef void (*fnNarrowKernel)(const uint16_t* pSrc, uint8_t* pDst, size_t stSamples, int iShift);
+typedef void (*fnGreyKernel)(const uint8_t* pSrc, uint8_t* pDst, int iPixels, int iChannels);
+
+struct sPixelKernel
+{
+    const char* pName;
+    fnSwapKernel fnSwap;
+    fnBlendKernel fnBlend;
+    fnPremultiplyKernel fnPremultiply;
+    fnNarrowKernel fnNarrow;
+    fnGreyKernel fnGrey;
+}; // End struct sPixelKernel
+
+// Grey weights (BT.601, sum 256)
+const int iGREY_RED = 77;
+const int iGREY_GREEN = 150;
+const int iGREY_BLUE = 29;
+
+// Exact round(uValue / 255) for uValue <= 255 * 255
+inline uint8_t fn_divide255(uint32_t uValue)
+{
+    uValue += 128;
+    return static_cast<uint8_t>((uValue + (uValue >> 8)) >> 8);
+} // End Function fn_divide255
+
+template <int C>
+void fn_swapRedBlueScalar(const uint8_t* pSrc, uint8_t* pDst, int iBegin, int iPixels)
+{
+    for (int x = iBegin; x < iPixels; x++)
+    {
+        const uint8_t* pIn = pSrc + static_cast<size_t>(x) * C;
+        uint8_t* pOut = pDst + static_cast<size_t>(x) * C;
+        uint8_t uRed = pIn[0];
+        uint8_t uBlue = pIn[2];
+        pOut[0] = uBlue;
+        pOut[1] = pIn[1];
+        pOut[2] = uRed;
+        if (C == 4)
+        {
+            pOut[3] = pIn[3];
+        }
+    }
+} // End Function fn_swapRedBlueScalar
+
+void fn_swapRedBlueTail(const uint8_t* pSrc, uint8_t* pDst, int iBegin, int iPixels, int iChannels)
+{
+    switch (iChannels)
+    {
+        case 3: fn_swapRedBlueScalar<3>(pSrc, pDst, iBegin, iPixels); break;
+        case 4: fn_swapRedBlueScalar<4>(pSrc, pDst, iBegin, iPixels); break;
+        default:
+            if (pSrc != pDst)
+            {
+                std::memmove(pDst + static_cast<size_t>(iBegin) * iChannels, pSrc + static_cast<size_t>(iBegin) * iChannels,
+                             static_cast<size_t>(iPixels - iBegin) * iChannels);
+            }
+            break;
+    }
+} // End Function fn_swapRedBlueTail
+
+void fn_swapRedBlueScalar8(const uint8_t* pSrc, uint8_t* pDst, int iPixels, int iChannels)
+{
+    fn_swapRedBlueTail(pSrc, pDst, 0, iPixels, iChannels);
+} // End Function fn_swapRedBlueScalar8
+
+void fn_blendTail(const uint8_t* pSrc, uint8_t* pDst, int iBegin, int iPixels, const uint8_t* pBackground)
+{
+    for (int x = iBegin; x < iPixels; x++)
+    {
+        const uint8_t* pIn = pSrc + static_cast<size_t>(x) * 4;
+        uint8_t* pOut = pDst + static_cast<size_t>(x) * 3;
+        uint32_t uAlpha = pIn[3];
+        for (int c = 0; c < 3; c++)
+        {
+            pOut[c] = fn_divide255(pIn[c] * uAlpha + pBackground[c] * (255 - uAlpha));
+        }
+    }
+} // End Function fn_blendTail
+
+void fn_blendScalar(const uint8_t* pSrc, uint8_t* pDst, int iPixels, const uint8_t* pBackground)
+{
+    fn_blendTail(pSrc, pDst, 0, iPixels, pBackground);
+} // End Function fn_blendScalar
+
+template <int C>
+void fn_premultiplyScalar(const uint8_t* pSrc, uint8_t* pDst, int iBegin, int iPixels)
+{
+    for (int x = iBegin; x < iPixels; x++)
+    {
+        const uint8_t* pIn = pSrc + static_cast<size_t>(x) * C;
+        uint8_t* pOut = pDst + static_cast<size_t>(x) * C;
+        uint32_t uAlpha = pIn[C - 1];
+        for (int c = 0; c < C - 1; c++)
+        {
+            pOut[c] = fn_divide255(pIn[c] * uAlpha);
+        }
+        pOut[C - 1] = static_cast<uint8_t>(uAlpha);
+    }
+} // End Function fn_premultiplyScalar
+
+void fn_premultiplyTail(const uint8_t* pSrc, uint8_t* pDst, int iBegin, int iPixels, int iChannels)
+{
+    if (iChannels == 2)
+    {
+        fn_premultiplyScalar<2>(pSrc, pDst, iBegin, iPixels);
+    }
+    else if (iChannels == 4)
+    {
+        fn_premultiplyScalar<4>(pSrc, pDst, iBegin, iPixels);
+    }
+    else if (pSrc != pDst)
+    {
+        std::memmove(pDst + static_cast<size_t>(iBegin) * iChannels, pSrc + static_cast<size_t>(iBegin) * iChannels,
+                     static_cast<size_t>(iPixels - iBegin) * iChannels);
+    }
+} // End Function fn_premultiplyTail
+
+void fn_premultiplyScalar8(const uint8_t* pSrc, uint8_t* pDst, int iPixels, int iChannels)
+{
+    fn_premultiplyTail(pSrc, pDst, 0, iPixels, iChannels);
+} // End Function fn_premultiplyScalar8
+
+void fn_narrowTail(const uint16_t* pSrc, uint8_t* pDst, size_t stBegin, size_t stSamples, int iShift)
+{
+    uint32_t uHalf = iShift > 0 ? 1u << (iShift - 1) : 0;
+    for (size_t i = stBegin; i < stSamples; i++)
+    {
+        pDst[i] = static_cast<uint8_t>(std::min<uint32_t>(255, (pSrc[i] + uHalf) >> iShift));
+    }
+} // End Function fn_narrowTail
+
+void fn_narrowScalar(const uint16_t* pSrc, uint8_t* pDst, size_t stSamples, int iShift)
+{
+    fn_narrowTail(pSrc, pDst, 0, stSamples, iShift);
+} // End Function fn_narrowScalar
+
+template <int C>
+void fn_greyScalar(const uint8_t* pSrc, uint8_t* pDst, int iBegin, int iPixels)
+{
+    for (int x = iBegin; x < iPixels; x++)
+    {
+        const uint8_t* pIn = pSrc + static_cast<size_t>(x) * C;
+        if (C >= 3)
+        {
+            pDst[x] = static_cast<uint8_t>((iGREY_RED * pIn[0] + iGREY_GREEN * pIn[1] + iGREY_BLUE * pIn[2] + 128) >> 8);
+        }
+        else
+        {
+            pDst[x] = pIn[0];
+        }
+    }
+} // End Function fn_greyScalar
+
+void fn_greyTail(const uint8_t* pSrc, uint8_t* pDst, int iBegin, int iPixels, int iChannels)
+{
+    switch (iChannels)
+    {
+        case 1: fn_greyScalar<1>(pSrc, pDst, iBegin, iPixels); break;
+        case 2: fn_greyScalar<2>(pSrc, pDst, iBegin, iPixels); break;
+        case 3: fn_greyScalar<3>(pSrc, pDst, iBegin, iPixels); break;
+        case 4: fn_greyScalar<4>(pSrc, pDst, iBegin, iPixels); break;
+        default: break;
+    }
+} // End Function fn_greyTail
+
+void fn_greyScalar8(const uint8_t* pSrc, uint8_t* pDst, int iPixels, int iChannels)
+{
+    fn_greyTail(pSrc, pDst, 0, iPixels, iChannels);
+} // End Function fn_greyScalar8
+
+#ifdef PIXEL_KERNELS_X86
+__attribute__((target("sse4.1")))
+void fn_swapRedBlueSse41(const uint8_t* pSrc, uint8_t* pDst, int iPixels, int iChannels)
+{
+    int x = 0;
+    if (iChannels == 4)
+    {
+        const __m128i vOrder = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+        for (; x + 4 <= iPixels; x += 4)
+        {
+            __m128i vPixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + x * 4));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + x * 4), _mm_shuffle_epi8(vPixels, vOrder));
+        }
+    }
+    else if (iChannels == 3)
+    {
+        // Five pixels per step; byte 15 is stored unchanged and then
+        // rewritten by the next step (or the tail), which keeps it in place
+        const __m128i vOrder = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+        for (; x * 3 + 16 <= iPixels * 3; x += 5)
+        {
+            __m128i vPixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + x * 3));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + x * 3), _mm_shuffle_epi8(vPixels, vOrder));
+        }
+    }
+    fn_swapRedBlueTail(pSrc, pDst, x, iPixels, iChannels);
+} // End Function fn_swapRedBlueSse41
+
+// (colour * factor + background * (255 - factor)) / 255 on 16-bit lanes;
+// every sum stays below 2^16, so wrapping 16-bit arithmetic is exact
+__attribute__((target("sse4.1")))
+inline __m128i fn_mixWords(__m128i vColour, __m128i vFactor, __m128i vBackground)
+{
+    const __m128i v255 = _mm_set1_epi16(255);
+    __m128i vSum = _mm_add_epi16(_mm_mullo_epi16(vColour, vFactor),
+                                 _mm_mullo_epi16(vBackground, _mm_sub_epi16(v255, vFactor)));
+    vSum = _mm_add_epi16(vSum, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(vSum, _mm_srli_epi16(vSum, 8)), 8);
+} // End Function fn_mixWords
+
+__attribute__((target("sse4.1")))
+void fn_blendSse41(const uint8_t* pSrc, uint8_t* pDst, int iPixels, const uint8_t* pBackground)
+{
+    const __m128i vAlpha = _mm_setr_epi8(6, 7, 6, 7, 6, 7, -1, -1, 14, 15, 14, 15, 14, 15, -1, -1);
+    const __m128i vPack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m128i vBackground = _mm_setr_epi16(pBackground[0], pBackground[1], pBackground[2], 0,
+                                               pBackground[0], pBackground[1], pBackground[2], 0);
+    int x = 0;
+    for (; x + 4 <= iPixels; x += 4)
+    {
+        __m128i vPixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + x * 4));
+        __m128i vLow = _mm_cvtepu8_epi16(vPixels);
+        __m128i vHigh = _mm_unpackhi_epi8(vPixels, _mm_setzero_si128());
+        vLow = fn_mixWords(vLow, _mm_shuffle_epi8(vLow, vAlpha), vBackground);
+        vHigh = fn_mixWords(vHigh, _mm_shuffle_epi8(vHigh, vAlpha), vBackground);
+        __m128i vOut = _mm_shuffle_epi8(_mm_packus_epi16(vLow, vHigh), vPack);
+
+        uint8_t* pOut = pDst + x * 3;
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(pOut), vOut);
+        int32_t iLast = _mm_extract_epi32(vOut, 2);
+        std::memcpy(pOut + 8, &iLast, 4);
+    }
+    fn_blendTail(pSrc, pDst, x, iPixels, pBackground);
+} // End Function fn_blendSse41
+
+__attribute__((target("sse4.1")))
+void fn_premultiplySse41(const uint8_t* pSrc, uint8_t* pDst, int iPixels, int iChannels)
+{
+    int x = 0;
+    if (iChannels == 4)
+    {
+        // Alpha scales the colour lanes and 255 keeps the alpha lane
+        const __m128i vAlpha = _mm_setr_epi8(6, 7, 6, 7, 6, 7, -1, -1, 14, 15, 14, 15, 14, 15, -1, -1);
+        const __m128i vKeep = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+        const __m128i vZero = _mm_setzero_si128();
+        for (; x + 4 <= iPixels; x += 4)
+        {
+            __m128i vPixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + x * 4));
+            __m128i vLow = _mm_cvtepu8_epi16(vPixels);
+            __m128i vHigh = _mm_unpackhi_epi8(vPixels, vZero);
+            vLow = fn_mixWords(vLow, _mm_or_si128(_mm_shuffle_epi8(vLow, vAlpha), vKeep), vZero);
+            vHigh = fn_mixWords(vHigh, _mm_or_si128(_mm_shuffle_epi8(vHigh, vAlpha), vKeep), vZero);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + x * 4), _mm_packus_epi16(vLow, vHigh));
+        }
+    }
+    fn_premultiplyTail(pSrc, pDst, x, iPixels, iChannels);
+} // End Function fn_premultiplySse41
+
+__attribute__((target("sse4.1")))
+void fn_narrowSse41(const uint16_t* pSrc, uint8_t* pDst, size_t stSamples, int iShift)
+{
+    const __m128i vHalf = _mm_set1_epi16(static_cast<short>(iShift > 0 ? 1 << (iShift - 1) : 0));
+    const __m128i vShift = _mm_cvtsi32_si128(iShift);
+    const __m128i vMax = _mm_set1_epi16(255);
+    size_t i = 0;
+    for (; i + 16 <= stSamples; i += 16)
+    {
+        __m128i vLow = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i));
+        __m128i vHigh = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i + 8));
+        vLow = _mm_min_epu16(_mm_srl_epi16(_mm_adds_epu16(vLow, vHalf), vShift), vMax);
+        vHigh = _mm_min_epu16(_mm_srl_epi16(_mm_adds_epu16(vHigh, vHalf), vShift), vMax);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i), _mm_packus_epi16(vLow, vHigh));
+    }
+    fn_narrowTail(pSrc, pDst, i, stSamples, iShift);
+} // End Function fn_narrowSse41
+
+__attribute__((target("sse4.1")))
+void fn_greySse41(const uint8_t* pSrc, uint8_t* pDst, int iPixels, int iChannels)
+{
+    int x = 0;
+    if (iChannels == 3 || iChannels == 4)
+    {
+        // Spread RGB to four-byte pixels; the fourth lane has weight 0
+        const __m128i vSpread = iChannels == 3
+            ? _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1)
+            : _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        const __m128i vWeights = _mm_setr_epi16(iGREY_RED, iGREY_GREEN, iGREY_BLUE, 0,
+                                                iGREY_RED, iGREY_GREEN, iGREY_BLUE, 0);
+        const __m128i vRound = _mm_set1_epi32(128);
+        for (; x * iChannels + 16 <= iPixels * iChannels; x += 4)
+        {
+            __m128i vPixels = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + x * iChannels)),
+                                               vSpread);
+            __m128i vLow = _mm_madd_epi16(_mm_cvtepu8_epi16(vPixels), vWeights);
+            __m128i vHigh = _mm_madd_epi16(_mm_unpackhi_epi8(vPixels, _mm_setzero_si128()), vWeights);
+            __m128i vGrey = _mm_srli_epi32(_mm_add_epi32(_mm_hadd_epi32(vLow, vHigh), vRound), 8);
+            vGrey = _mm_packus_epi16(_mm_packs_epi32(vGrey, vGrey), vGrey);
+            int32_t iOut = _mm_cvtsi128_si32(vGrey);
+            std::memcpy(pDst + x, &iOut, 4);
+        }
+    }
+    fn_greyTail(pSrc, pDst, x, iPixels, iChannels);
+} // End Function fn_greySse41
+
+__attribute__((target("avx2")))
+void fn_swapRedBlueAvx2(const uint8_t* pSrc, uint8_t* pDst, int iPixels, int iChannels)
+{
+    int x = 0;
+    if (iChannels == 4)
+    {
+        const __m256i vOrder = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                                2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+        for (; x + 8 <= iPixels; x += 8)
+        {
+            __m256i vPixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + x * 4));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + x * 4), _mm256_shuffle_epi8(vPixels, vOrder));
+        }
+    }
+    fn_swapRedBlueSse41(pSrc + static_cast<size_t>(x) * iChannels, pDst + static_cast<size_t>(x) * iChannels,
+                        iPixels - x, iChannels);
+} // End Function fn_swapRedBlueAvx2
+
+__attribute__((target("avx2")))
+inline __m256i fn_mixWordsAvx2(__m256i vColour, __m256i vFactor, __m256i vBackground)
+{
+    const __m256i v255 = _mm256_set1_epi16(255);
+    __m256i vSum = _mm256_add_epi16(_mm256_mullo_epi16(vColour, vFactor),
+                                    _mm256_mullo_epi16(vBackground, _mm256_sub_epi16(v255, vFactor)));
+    vSum = _mm256_add_epi16(vSum, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(vSum, _mm256_srli_epi16(vSum, 8)), 8);
+} // End Function fn_mixWordsAvx2
+
+__attribute__((target("avx2")))
+void fn_blendAvx2(const uint8_t* pSrc, uint8_t* pDst, int iPixels, const uint8_t* pBackground)
+{
+    const __m256i vAlpha = _mm256_setr_epi8(6, 7, 6, 7, 6, 7, -1, -1, 14, 15, 14, 15, 14, 15, -1, -1,
+                                            6, 7, 6, 7, 6, 7, -1, -1, 14, 15, 14, 15, 14, 15, -1, -1);
+    const __m256i vPack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                           0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m256i vCompact = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    const __m256i vBackground = _mm256_setr_epi16(pBackground[0], pBackground[1], pBackground[2], 0,
+                                                  pBackground[0], pBackground[1], pBackground[2], 0,
+                                                  pBackground[0], pBackground[1], pBackground[2], 0,
+                                                  pBackground[0], pBackground[1], pBackground[2], 0);
+    int x = 0;
+    for (; x + 8 <= iPixels; x += 8)
+    {
+        __m256i vPixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + x * 4));
+        __m256i vLow = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(vPixels));
+        __m256i vHigh = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(vPixels, 1));
+        vLow = fn_mixWordsAvx2(vLow, _mm256_shuffle_epi8(vLow, vAlpha), vBackground);
+        vHigh = fn_mixWordsAvx2(vHigh, _mm256_shuffle_epi8(vHigh, vAlpha), vBackground);
+
+        // Pack is per 128-bit lane: restore pixel order, drop alpha, then
+        // close the gap between the two 12-byte halves
+        __m256i vOut = _mm256_permute4x64_epi64(_mm256_packus_epi16(vLow, vHigh), 0xD8);
+        vOut = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(vOut, vPack), vCompact);
+
+        uint8_t* pOut = pDst + x * 3;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pOut), _mm256_castsi256_si128(vOut));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(pOut + 16), _mm256_extracti128_si256(vOut, 1));
+    }
+    fn_blendSse41(pSrc + static_cast<size_t>(x) * 4, pDst + static_cast<size_t>(x) * 3, iPixels - x, pBackground);
+} // End Function fn_blendAvx2
+
+__attribute__((target("avx2")))
+void fn_premultiplyAvx2(const uint8_t* pSrc, uint8_t* pDst, int iPixels, int iChannels)
+{
+    int x = 0;
+    if (iChannels == 4)
+    {
+        const __m256i vAlpha = _mm256_setr_epi8(6, 7, 6, 7, 6, 7, -1, -1, 14, 15, 14, 15, 14, 15, -1, -1,
+                                                6, 7, 6, 7, 6, 7, -1, -1, 14, 15, 14, 15, 14, 15, -1, -1);
+        const __m256i vKeep = _mm256_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255);
+        const __m256i vZero = _mm256_setzero_si256();
+        for (; x + 8 <= iPixels; x += 8)
+        {
+            __m256i vPixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + x * 4));
+            __m256i vLow = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(vPixels));
+            __m256i vHigh = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(vPixels, 1));
+            vLow = fn_mixWordsAvx2(vLow, _mm256_or_si256(_mm256_shuffle_epi8(vLow, vAlpha), vKeep), vZero);
+            vHigh = fn_mixWordsAvx2(vHigh, _mm256_or_si256(_mm256_shuffle_epi8(vHigh, vAlpha), vKeep), vZero);
+            __m256i vOut = _mm256_permute4x64_epi64(_mm256_packus_epi16(vLow, vHigh), 0xD8);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + x * 4), vOut);
+        }
+    }
+    fn_premultiplySse41(pSrc + static_cast<size_t>(x) * iChannels, pDst + static_cast<size_t>(x) * iChannels,
+                        iPixels - x, iChannels);
+} // End Function fn_premultiplyAvx2
+
+__attribute__((target("avx2")))
+void fn_narrowAvx2(const uint16_t* pSrc, uint8_t* pDst, size_t stSamples, int iShift)
+{
+    const __m256i vHalf = _mm256_set1_epi16(static_cast<short>(iShift > 0 ? 1 << (iShift - 1) : 0));
+    const __m128i vShift = _mm_cvtsi32_si128(iShift);
+    const __m256i vMax = _mm256_set1_epi16(255);
+    size_t i = 0;
+    for (; i + 32 <= stSamples; i += 32)
+    {
+        __m256i vLow = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i));
+        __m256i vHigh = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pSrc + i + 16));
+        vLow = _mm256_min_epu16(_mm256_srl_epi16(_mm256_adds_epu16(vLow, vHalf), vShift), vMax);
+        vHigh = _mm256_min_epu16(_mm256_srl_epi16(_mm256_adds_epu16(vHigh, vHalf), vShift), vMax);
+        __m256i vOut = _mm256_permute4x64_epi64(_mm256_packus_epi16(vLow, vHigh), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i), vOut);
+    }
+    fn_narrowSse41(pSrc + i, pDst + i, stSamples - i, iShift);
+} // End Function fn_narrowAvx2
+
+__attribute__((target("avx512f,avx512bw")))
+void fn_swapRedBlueAvx512(const uint8_t* pSrc, uint8_t* pDst, int iPixels, int iChannels)
+{
+    int x = 0;
+    if (iChannels == 4)
+    {
+        const __m512i vOrder = _mm512_maskz_broadcast_i32x4(
+            0xFFFF, _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15));
+        for (; x + 16 <= iPixels; x += 16)
+        {
+            __m512i vPixels = _mm512_loadu_si512(pSrc + x * 4);
+            _mm512_storeu_si512(pDst + x * 4, _mm512_shuffle_epi8(vPixels, vOrder));
+        }
+    }
+    fn_swapRedBlueAvx2(pSrc + static_cast<size_t>(x) * iChannels, pDst + static_cast<size_t>(x) * iChannels,
+                       iPixels - x, iChannels);
+} // End Function fn_swapRedBlueAvx512
+
+__attribute__((target("avx512f,avx512bw")))
+void fn_narrowAvx512(const uint16_t* pSrc, uint8_t* pDst, size_t stSamples, int iShift)
+{
+    const __m512i vHalf = _mm512_set1_epi16(static_cast<short>(iShift > 0 ? 1 << (iShift - 1) : 0));
+    const __m128i vShift = _mm_cvtsi32_si128(iShift);
+    size_t i = 0;
+    for (; i + 32 <= stSamples; i += 32)
+    {
+        __m512i vSamples = _mm512_loadu_si512(pSrc + i);
+        vSamples = _mm512_srl_epi16(_mm512_adds_epu16(vSamples, vHalf), vShift);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + i), _mm512_maskz_cvtusepi16_epi8(0xFFFFFFFF, vSamples));
+    }
+    fn_narrowAvx2(pSrc + i, pDst + i, stSamples - i, iShift);
+} // End Function fn_narrowAvx512
+#endif // PIXEL_KERNELS_X86
+
+#ifdef PIXEL_KERNELS_NEON
+void fn_swapRedBlueNeon(const uint8_t* pSrc, uint8_t* pDst, int iPixels, int iChannels)
+{
+    int x = 0;
+    if (iChannels == 4)
+    {
+        for (; x + 16 <= iPixels; x += 16)
+        {
+            uint8x16x4_t vPixels = vld4q_u8(pSrc + x * 4);
+            uint8x16_t vRed = vPixels.val[0];
+            vPixels.val[0] = vPixels.val[2];
+            vPixels.val[2] = vRed;
+            vst4q_u8(pDst + x * 4, vPixels);
+        }
+    }
+    else if (iChannels == 3)
+    {
+        for (; x + 16 <= iPixels; x += 16)
+        {
+            uint8x16x3_t vPixels = vld3q_u8(pSrc + x * 3);
+            uint8x16_t vRed = vPixels.val[0];
+            vPixels.val[0] = vPixels.val[2];
+            vPixels.val[2] = vRed;
+            vst3q_u8(pDst + x * 3, vPixels);
+        }
+    }
+    fn_swapRedBlueTail(pSrc, pDst, x, iPixels, iChannels);
+} // End Function fn_swapRedBlueNeon
+
+void fn_narrowNeon(const uint16_t* pSrc, uint8_t* pDst, size_t stSamples, int iShift)
+{
+    const uint16x8_t vHalf = vdupq_n_u16(static_cast<uint16_t>(iShift > 0 ? 1 << (iShift - 1) : 0));
+    const int16x8_t vShift = vdupq_n_s16(static_cast<int16_t>(-iShift));
+    size_t i = 0;
+    for (; i + 16 <= stSamples; i += 16)
+    {
+        uint16x8_t vLow = vshlq_u16(vqaddq_u16(vld1q_u16(pSrc + i), vHalf), vShift);
+        uint16x8_t vHigh = vshlq_u16(vqaddq_u16(vld1q_u16(pSrc + i + 8), vHalf), vShift);
+        vst1q_u8(pDst + i, vcombine_u8(vqmovn_u16(vLow), vqmovn_u16(vHigh)));
+    }
+    fn_narrowTail(pSrc, pDst, i, stSamples, iShift);
+} // End Function fn_narrowNeon
+#endif // PIXEL_KERNELS_NEON
+
+// Fastest first; the scalar set always works
+const sPixelKernel aKERNELS[] = {
+#ifdef PIXEL_KERNELS_X86
+    {"avx512", fn_swapRedBlueAvx512, fn_blendAvx2, fn_premultiplyAvx2, fn_narrowAvx512, fn_greySse41},
+    {"avx2", fn_swapRedBlueAvx2, fn_blendAvx2, fn_premultiplyAvx2, fn_narrowAvx2, fn_greySse41},
+    {"sse4.1", fn_swapRedBlueSse41, fn_blendSse41, fn_premultiplySse41, fn_narrowSse41, fn_greySse41},
+#endif
+#ifdef PIXEL_KERNELS_NEON
+    {"neon", fn_swapRedBlueNeon, fn_blendScalar, fn_premultiplyScalar8, fn_narrowNeon, fn_greyScalar8},
+#endif
+    {"scalar", fn_swapRedBlueScalar8, fn_blendScalar, fn_premultiplyScalar8, fn_narrowScalar, fn_greyScalar8},
+};
+
+std::atomic<const sPixelKernel*> pActiveKernel(nullptr);
+
+bool fn_isKernelSupported(const sPixelKernel& oKernel)
+{
+#ifdef PIXEL_KERNELS_X86
+    __builtin_cpu_init();
+    if (std::strcmp(oKernel.pName, "avx512") == 0)
+    {
+        return __builtin_cpu_supports("avx512bw");
+    }
+    if (std::strcmp(oKernel.pName, "avx2") == 0)
+    {
+        return __builtin_cpu_supports("avx2");
+    }
+    if (std::strcmp(oKernel.pName, "sse4.1") == 0)
+    {
+        return __builtin_cpu_supports("sse4.1");
+    }
+#endif
+    (void)oKernel;
+    return true;
+} // End Function fn_isKernelSupported
+
+const sPixelKernel* fn_getActiveKernel()
+{
+    const sPixelKernel* pKernel = pActiveKernel.load(std::memory_order_acquire);
+    if (pKernel == nullptr)
+    {
+        for (const sPixelKernel& oKernel : aKERNELS)
+        {
+            if (fn_isKernelSupported(oKernel))
+            {
+                pKernel = &oKernel;
+                break;
+            }
+        }
+        pActiveKernel.store(pKernel, std::memory_order_release);
+    }
+    return pKernel;
+} // End Function fn_getActiveKernel
+
+} // namespace
+
+// RGB <-> BGR
+void fn_swapRedBlue(const uint8_t* pSrc, uint8_t* pDst, int iPixels, int iChannels)
+{
+    if (iPixels > 0)
+    {
+        fn_getActiveKernel()->fnSwap(pSrc, pDst, iPixels, iChannels);
+    }
+} // End Function fn_swapRedBlue
+
+// RGBA over an opaque background
+void fn_blendOverBackground(const uint8_t* pSrc, uint8_t* pDst, int iPixels, const uint8_t aBackground[3])
+{
+    if (iPixels > 0)
+    {
+        fn_getActiveKernel()->fnBlend(pSrc, pDst, iPixels, aBackground);
+    }
+} // End Function fn_blendOverBackground
+
+// Associated alpha, 8-bit
+void fn_premultiplyAlpha(const uint8_t* pSrc, uint8_t* pDst, int iPixels, int iChannels)
+{
+    if (iPixels > 0)
+    {
+        fn_getActiveKernel()->fnPremultiply(pSrc, pDst, iPixels, iChannels);
+    }
+} // End Function fn_premultiplyAlpha
+
+// Associated alpha, 9-16 bit (rare enough to stay scalar)
+void fn_premultiplyAlpha16(const uint16_t* pSrc, uint16_t* pDst, int iPixels, int iChannels, int iBitDepth)
+{
+    if (iChannels != 2 && iChannels != 4)
+    {
+        if (pSrc != pDst)
+        {
+            std::memmove(pDst, pSrc, static_cast<size_t>(iPixels) * iChannels * sizeof(uint16_t));
+        }
+        return;
+    }
+
+    uint32_t uMax = (1u << std::min(16, std::max(9, iBitDepth))) - 1;
+    for (int x = 0; x < iPixels; x++)
+    {
+        const uint16_t* pIn = pSrc + static_cast<size_t>(x) * iChannels;
+        uint16_t* pOut = pDst + static_cast<size_t>(x) * iChannels;
+        uint32_t uAlpha = std::min<uint32_t>(pIn[iChannels - 1], uMax);
+        for (int c = 0; c < iChannels - 1; c++)
+        {
+            pOut[c] = static_cast<uint16_t>((pIn[c] * uAlpha + uMax / 2) / uMax);
+        }
+        pOut[iChannels - 1] = pIn[iChannels - 1];
+    }
+} // End Function fn_premultiplyAlpha16
+
+// High bit depth to 8-bit
+void fn_narrowTo8(const uint16_t* pSrc, uint8_t* pDst, size_t stSamples, int iBitDepth)
+{
+    if (stSamples > 0)
+    {
+        fn_getActiveKernel()->fnNarrow(pSrc, pDst, stSamples, std::min(8, std::max(0, iBitDepth - 8)));
+    }
+} // End Function fn_narrowTo8
+
+// Grey channel
+void fn_extractGrey(const uint8_t* pSrc, uint8_t* pDst, int iPixels, int iChannels)
+{
+    if (iPixels > 0)
+    {
+        fn_getActiveKernel()->fnGrey(pSrc, pDst, iPixels, iChannels);
+    }
+} // End Function fn_extractGrey
+
+// Bottom-up copy with padded destination rows
+void fn_copyRowsFlipped(const uint8_t* pSrc, size_t stSrcStride, uint8_t* pDst, size_t stDstStride,
+                        size_t stRowBytes, int iRows)
+{
+    for (int iRow = 0; iRow < iRows; iRow++)
+    {
+        uint8_t* pOut = pDst + static_cast<size_t>(iRow) * stDstStride;
+        std::memcpy(pOut, pSrc + static_cast<size_t>(iRows - 1 - iRow) * stSrcStride, stRowBytes);
+        if (stDstStride > stRowBytes)
+        {
+            std::memset(pOut + stRowBytes, 0, stDstStride - stRowBytes);
+        }
+    }
+} // End Function fn_copyRowsFlipped
+
+// Kernel set in use
+std::string fn_getPixelKernel()
+{
+    return fn_getActiveKernel()->pName;
+} // End Function fn_getPixelKernel
+
+// Select a kernel set by name
+bool fn_setPixelKernel(const std::string& sKernel)
+{
+    for (const sPixelKernel& oKernel : aKERNELS)
+    {
+        if (sKernel == oKernel.pName && fn_isKernelSupported(oKernel))
+        {
+            pActiveKernel.store(&oKernel, std::memory_order_release);
+            return true;
+        }
+    }
+
+    return false;
+} // End Function fn_setPixelKernel
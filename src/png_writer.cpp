@@ -0,0 +1,373 @@
+// png_writer.cpp - Direct PNG writer: row filtering and banded parallel deflate
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "png_writer.h"
+#include "exif_editor.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+#include <zlib.h>
+
+namespace
+{
+const size_t stDEFLATE_WINDOW = 32768;
+const unsigned char aPNG_SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+enum ePngFilter
+{
+    FILTER_NONE = 0,
+    FILTER_SUB = 1,
+    FILTER_UP = 2,
+    FILTER_AVERAGE = 3,
+    FILTER_PAETH = 4
+}; // End enum ePngFilter
+
+// The image being written and how
+struct sPngImage
+{
+    const unsigned char* pPixels;
+    size_t stStride;
+    size_t stRowBytes;
+    int iHeight;
+    int iBpp;                                // Bytes per pixel (filter distance)
+    const sPngWriterOptions* pOptions;
+    const unsigned char* pZeroRow;           // Prior row of the first row
+}; // End struct sPngImage
+
+// One band of rows and its deflated bytes
+struct sPngBand
+{
+    int iBegin = 0;
+    int iEnd = 0;
+    bool bLast = false;
+    std::vector<unsigned char> vDeflated;
+    uLong ulAdler = 1;                       // Adler-32 of the filtered bytes
+    size_t stFilteredBytes = 0;
+    bool bOk = false;
+}; // End struct sPngBand
+
+void fn_put32(unsigned char* pOut, uint32_t uValue)
+{
+    pOut[0] = static_cast<unsigned char>(uValue >> 24);
+    pOut[1] = static_cast<unsigned char>(uValue >> 16);
+    pOut[2] = static_cast<unsigned char>(uValue >> 8);
+    pOut[3] = static_cast<unsigned char>(uValue);
+} // End Function fn_put32
+
+inline unsigned char fn_paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc)
+    {
+        return static_cast<unsigned char>(a);
+    }
+    return static_cast<unsigned char>(pb <= pc ? b : c);
+} // End Function fn_paeth
+
+// Apply one filter; pOut receives the filter byte and stBytes filtered bytes
+void fn_filterRow(int iFilter, const unsigned char* pRow, const unsigned char* pPrior, size_t stBytes,
+                  int iBpp, unsigned char* pOut)
+{
+    *pOut++ = static_cast<unsigned char>(iFilter);
+    size_t stBpp = static_cast<size_t>(iBpp);
+    switch (iFilter)
+    {
+        case FILTER_SUB:
+            std::memcpy(pOut, pRow, std::min(stBpp, stBytes));
+            for (size_t i = stBpp; i < stBytes; i++)
+            {
+                pOut[i] = static_cast<unsigned char>(pRow[i] - pRow[i - stBpp]);
+            }
+            break;
+        case FILTER_UP:
+            for (size_t i = 0; i < stBytes; i++)
+            {
+                pOut[i] = static_cast<unsigned char>(pRow[i] - pPrior[i]);
+            }
+            break;
+        case FILTER_AVERAGE:
+            for (size_t i = 0; i < stBytes; i++)
+            {
+                int iLeft = i >= stBpp ? pRow[i - stBpp] : 0;
+                pOut[i] = static_cast<unsigned char>(pRow[i] - ((iLeft + pPrior[i]) >> 1));
+            }
+            break;
+        case FILTER_PAETH:
+            for (size_t i = 0; i < stBytes; i++)
+            {
+                int iLeft = i >= stBpp ? pRow[i - stBpp] : 0;
+                int iUpLeft = i >= stBpp ? pPrior[i - stBpp] : 0;
+                pOut[i] = static_cast<unsigned char>(pRow[i] - fn_paeth(iLeft, pPrior[i], iUpLeft));
+            }
+            break;
+        default:
+            std::memcpy(pOut, pRow, stBytes);
+            break;
+    }
+} // End Function fn_filterRow
+
+// Sum of the filtered bytes read as signed values (libpng's heuristic)
+size_t fn_getFilterCost(const unsigned char* pFiltered, size_t stBytes)
+{
+    size_t stCost = 0;
+    for (size_t i = 0; i < stBytes; i++)
+    {
+        stCost += pFiltered[i] < 128 ? pFiltered[i] : 256 - pFiltered[i];
+    }
+    return stCost;
+} // End Function fn_getFilterCost
+
+// Filter row iRow into pOut (stRowBytes + 1 bytes); pScratch holds as many
+const unsigned char* fn_filterImageRow(const sPngImage& oImage, int iRow, unsigned char* pOut, unsigned char* pScratch)
+{
+    const unsigned char* pRow = oImage.pPixels + static_cast<size_t>(iRow) * oImage.stStride;
+    const unsigned char* pPrior = iRow > 0 ? pRow - oImage.stStride : oImage.pZeroRow;
+    if (oImage.pOptions->bFastFilter)
+    {
+        fn_filterRow(FILTER_UP, pRow, pPrior, oImage.stRowBytes, oImage.iBpp, pOut);
+        return pOut;
+    }
+
+    // Try every filter and keep the cheapest, swapping buffers as it improves
+    unsigned char* pBest = pOut;
+    unsigned char* pTry = pScratch;
+    size_t stBest = SIZE_MAX;
+    for (int iFilter = FILTER_NONE; iFilter <= FILTER_PAETH; iFilter++)
+    {
+        fn_filterRow(iFilter, pRow, pPrior, oImage.stRowBytes, oImage.iBpp, pTry);
+        size_t stCost = fn_getFilterCost(pTry + 1, oImage.stRowBytes);
+        if (stCost < stBest)
+        {
+            stBest = stCost;
+            std::swap(pBest, pTry);
+        }
+    }
+    return pBest;
+} // End Function fn_filterImageRow
+
+// Run deflate until the input is consumed (and the flush is complete)
+bool fn_deflateInto(z_stream& oStream, std::vector<unsigned char>& vOut, size_t& stUsed, int iFlush)
+{
+    while (true)
+    {
+        if (stUsed == vOut.size())
+        {
+            vOut.resize(vOut.size() + vOut.size() / 2 + 4096);
+        }
+        oStream.next_out = vOut.data() + stUsed;
+        oStream.avail_out = static_cast<uInt>(std::min<size_t>(vOut.size() - stUsed, 1u << 30));
+        uInt uAvailable = oStream.avail_out;
+        int iResult = deflate(&oStream, iFlush);
+        stUsed += uAvailable - oStream.avail_out;
+
+        if (iResult == Z_STREAM_END)
+        {
+            return true;
+        }
+        if (iResult != Z_OK && iResult != Z_BUF_ERROR)
+        {
+            return false;
+        }
+        // Done once all input is taken and deflate had room to spare
+        if (oStream.avail_in == 0 && oStream.avail_out != 0 && iFlush != Z_FINISH)
+        {
+            return true;
+        }
+    }
+} // End Function fn_deflateInto
+
+// Filter and deflate one band. Every band but the last ends with a sync
+// flush, so the raw deflate pieces join into one stream; later bands are
+// primed with the filtered bytes before them to keep the compression ratio.
+void fn_deflateBand(const sPngImage& oImage, sPngBand& oBand)
+{
+    const sPngWriterOptions& oOptions = *oImage.pOptions;
+    size_t stFilteredRow = oImage.stRowBytes + 1;
+    std::vector<unsigned char> vRows(stFilteredRow * 2);
+
+    int iLevel = std::min(9, std::max(0, oOptions.iCompressionLevel));
+    int iStrategy = Z_FILTERED;
+    if (oOptions.bFastFilter)
+    {
+        iLevel = std::min(iLevel, 1);
+        iStrategy = Z_RLE;
+    }
+
+    z_stream oStream;
+    std::memset(&oStream, 0, sizeof(oStream));
+    if (deflateInit2(&oStream, iLevel, Z_DEFLATED, -15, 9, iStrategy) != Z_OK)
+    {
+        return;
+    }
+
+    if (oBand.iBegin > 0)
+    {
+        int iRows = static_cast<int>((stDEFLATE_WINDOW + stFilteredRow - 1) / stFilteredRow);
+        int iFirst = std::max(0, oBand.iBegin - iRows);
+        std::vector<unsigned char> vWindow(stFilteredRow * (oBand.iBegin - iFirst));
+        std::vector<unsigned char> vScratch(stFilteredRow);
+        for (int y = iFirst; y < oBand.iBegin; y++)
+        {
+            unsigned char* pOut = vWindow.data() + (y - iFirst) * stFilteredRow;
+            const unsigned char* pFiltered = fn_filterImageRow(oImage, y, pOut, vScratch.data());
+            if (pFiltered != pOut)
+            {
+                std::memcpy(pOut, pFiltered, stFilteredRow);
+            }
+        }
+        size_t stDictionary = std::min(vWindow.size(), stDEFLATE_WINDOW);
+        deflateSetDictionary(&oStream, vWindow.data() + vWindow.size() - stDictionary, static_cast<uInt>(stDictionary));
+    }
+
+    size_t stRawBytes = stFilteredRow * (oBand.iEnd - oBand.iBegin);
+    oBand.vDeflated.resize(deflateBound(&oStream, static_cast<uLong>(stRawBytes)) + 64);
+    size_t stUsed = 0;
+    bool bOk = true;
+    uLong ulAdler = adler32(0, nullptr, 0);
+    for (int y = oBand.iBegin; y < oBand.iEnd && bOk; y++)
+    {
+        const unsigned char* pFiltered = fn_filterImageRow(oImage, y, vRows.data(), vRows.data() + stFilteredRow);
+        ulAdler = adler32(ulAdler, pFiltered, static_cast<uInt>(stFilteredRow));
+        oStream.next_in = const_cast<Bytef*>(pFiltered);
+        oStream.avail_in = static_cast<uInt>(stFilteredRow);
+        int iFlush = y + 1 < oBand.iEnd ? Z_NO_FLUSH : (oBand.bLast ? Z_FINISH : Z_SYNC_FLUSH);
+        bOk = fn_deflateInto(oStream, oBand.vDeflated, stUsed, iFlush);
+    }
+    deflateEnd(&oStream);
+
+    oBand.vDeflated.resize(stUsed);
+    oBand.ulAdler = ulAdler;
+    oBand.stFilteredBytes = stRawBytes;
+    oBand.bOk = bOk;
+} // End Function fn_deflateBand
+
+// Write a chunk whose data is the concatenation of the given spans
+bool fn_writeChunk(FILE* fp, const char* pType, std::initializer_list<std::pair<const unsigned char*, size_t>> lSpans)
+{
+    size_t stLength = 0;
+    for (const auto& oSpan : lSpans)
+    {
+        stLength += oSpan.second;
+    }
+    if (stLength > 0x7FFFFFFFu)
+    {
+        return false;
+    }
+
+    unsigned char aHeader[8];
+    fn_put32(aHeader, static_cast<uint32_t>(stLength));
+    std::memcpy(aHeader + 4, pType, 4);
+    uLong ulCrc = crc32(crc32(0, nullptr, 0), aHeader + 4, 4);
+    bool bOk = fwrite(aHeader, 1, 8, fp) == 8;
+    for (const auto& oSpan : lSpans)
+    {
+        if (oSpan.second > 0)
+        {
+            ulCrc = crc32(ulCrc, oSpan.first, static_cast<uInt>(oSpan.second));
+            bOk = bOk && fwrite(oSpan.first, 1, oSpan.second, fp) == oSpan.second;
+        }
+    }
+
+    unsigned char aCrc[4];
+    fn_put32(aCrc, static_cast<uint32_t>(ulCrc));
+    return bOk && fwrite(aCrc, 1, 4, fp) == 4;
+} // End Function fn_writeChunk
+} // namespace
+
+// Write an 8-bit PNG through banded deflate
+bool fn_writePng(FILE* fp, const unsigned char* pPixels, size_t stStride, int iWidth, int iHeight,
+                 int iChannels, const sPngWriterOptions& oOptions, int iThreads, std::string& sError)
+{
+    static const unsigned char aCOLOR_TYPES[5] = {0, 0, 4, 2, 6};
+    if (!fp || !pPixels || iWidth <= 0 || iHeight <= 0 || iChannels < 1 || iChannels > 4)
+    {
+        sError = "Invalid image for PNG writer";
+        return false;
+    }
+
+    std::vector<unsigned char> vZeroRow(static_cast<size_t>(iWidth) * iChannels, 0);
+    sPngImage oImage;
+    oImage.pPixels = pPixels;
+    oImage.stStride = stStride;
+    oImage.stRowBytes = vZeroRow.size();
+    oImage.iHeight = iHeight;
+    oImage.iBpp = iChannels;
+    oImage.pOptions = &oOptions;
+    oImage.pZeroRow = vZeroRow.data();
+
+    // Signature, header and the EXIF block (eXIf holds it from the TIFF header)
+    unsigned char aIhdr[13];
+    fn_put32(aIhdr, static_cast<uint32_t>(iWidth));
+    fn_put32(aIhdr + 4, static_cast<uint32_t>(iHeight));
+    aIhdr[8] = 8;
+    aIhdr[9] = aCOLOR_TYPES[iChannels];
+    aIhdr[10] = aIhdr[11] = aIhdr[12] = 0;
+    bool bOk = fwrite(aPNG_SIGNATURE, 1, sizeof(aPNG_SIGNATURE), fp) == sizeof(aPNG_SIGNATURE) &&
+               fn_writeChunk(fp, "IHDR", {{aIhdr, sizeof(aIhdr)}});
+    size_t stTiff = 0;
+    if (bOk && oOptions.pExif && fn_findTiffHeader(oOptions.pExif, oOptions.stExifSize, stTiff))
+    {
+        bOk = fn_writeChunk(fp, "eXIf", {{oOptions.pExif + stTiff, oOptions.stExifSize - stTiff}});
+    }
+
+    // Bands in waves of two per worker, written in order as each wave ends
+    int iRowsPerBand = static_cast<int>(std::max<size_t>(1, stPNG_BAND_BYTES / (oImage.stRowBytes + 1)));
+    int iBands = (iHeight + iRowsPerBand - 1) / iRowsPerBand;
+    int iWave = iThreads > 1 ? iThreads * 2 : 1;
+    TaskGroup oDeflate(iThreads);
+    int iLevel = oOptions.bFastFilter ? std::min(1, oOptions.iCompressionLevel) : oOptions.iCompressionLevel;
+    const unsigned char aZlibHeader[2] = {0x78, static_cast<unsigned char>(iLevel <= 1 ? 0x01 : iLevel <= 5 ? 0x5E :
+                                                                           iLevel == 6 ? 0x9C : 0xDA)};
+    uLong ulAdler = adler32(0, nullptr, 0);
+    std::vector<sPngBand> vBands;
+
+    for (int iFirst = 0; bOk && iFirst < iBands; iFirst += iWave)
+    {
+        int iCount = std::min(iWave, iBands - iFirst);
+        vBands.assign(iCount, sPngBand());
+        for (int b = 0; b < iCount; b++)
+        {
+            sPngBand& oBand = vBands[b];
+            oBand.iBegin = (iFirst + b) * iRowsPerBand;
+            oBand.iEnd = std::min(iHeight, oBand.iBegin + iRowsPerBand);
+            oBand.bLast = iFirst + b == iBands - 1;
+            oDeflate.fn_submit([&oImage, &oBand]() { fn_deflateBand(oImage, oBand); });
+        }
+        oDeflate.fn_wait();
+
+        for (int b = 0; b < iCount && bOk; b++)
+        {
+            sPngBand& oBand = vBands[b];
+            if (!oBand.bOk)
+            {
+                sError = "Deflate failed for PNG rows " + std::to_string(oBand.iBegin) + "-" + std::to_string(oBand.iEnd);
+                return false;
+            }
+
+            ulAdler = adler32_combine(ulAdler, oBand.ulAdler, static_cast<z_off_t>(oBand.stFilteredBytes));
+            unsigned char aAdler[4];
+            fn_put32(aAdler, static_cast<uint32_t>(ulAdler));
+            bool bFirst = oBand.iBegin == 0;
+            bOk = fn_writeChunk(fp, "IDAT", {{aZlibHeader, bFirst ? sizeof(aZlibHeader) : 0},
+                                             {oBand.vDeflated.data(), oBand.vDeflated.size()},
+                                             {aAdler, oBand.bLast ? sizeof(aAdler) : 0}});
+            std::vector<unsigned char>().swap(oBand.vDeflated);
+        }
+    }
+
+    bOk = bOk && fn_writeChunk(fp, "IEND", {});
+    if (!bOk)
+    {
+        sError = "Failed to write PNG data";
+    }
+    return bOk;
+} // End Function fn_writePng
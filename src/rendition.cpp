@@ -0,0 +1,206 @@
+// rendition.cpp - Several output formats and sizes from one decoded image
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "rendition.h"
+#include "thread_pool.h"
+#include "logger.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+
+namespace
+{
+
+const char* const aRENDITION_FORMATS[] = {"jpg", "jpeg", "png", "webp", "tiff", "tif", "bmp"};
+
+std::string fn_trim(const std::string& sText)
+{
+    size_t stStart = sText.find_first_not_of(" \t\r\n");
+    if (stStart == std::string::npos)
+    {
+        return std::string();
+    }
+    size_t stEnd = sText.find_last_not_of(" \t\r\n");
+    return sText.substr(stStart, stEnd - stStart + 1);
+} // End Function fn_trim
+
+} // End anonymous namespace
+
+// Parse FORMAT[:SIZE[:SUFFIX]]
+bool fn_parseRendition(const std::string& sSpec, sRendition& oRendition)
+{
+    sRendition oParsed;
+    std::string sRest = fn_trim(sSpec);
+    size_t stColon = sRest.find(':');
+    oParsed.sFormat = sRest.substr(0, stColon);
+    std::transform(oParsed.sFormat.begin(), oParsed.sFormat.end(), oParsed.sFormat.begin(), ::tolower);
+    if (std::find(std::begin(aRENDITION_FORMATS), std::end(aRENDITION_FORMATS), oParsed.sFormat) == std::end(aRENDITION_FORMATS))
+    {
+        return false;
+    }
+
+    bool bHasSuffix = false;
+    if (stColon != std::string::npos)
+    {
+        sRest = sRest.substr(stColon + 1);
+        stColon = sRest.find(':');
+        std::string sSize = sRest.substr(0, stColon);
+        if (!sSize.empty())
+        {
+            if (sSize.size() > 6 || !std::all_of(sSize.begin(), sSize.end(), ::isdigit))
+            {
+                return false;
+            }
+            oParsed.iMaxDimension = std::stoi(sSize);
+        }
+        if (stColon != std::string::npos)
+        {
+            oParsed.sSuffix = sRest.substr(stColon + 1);
+            bHasSuffix = true;
+        }
+    }
+
+    // The suffix stays inside the output directory
+    if (oParsed.sSuffix.find('/') != std::string::npos || oParsed.sSuffix.find('\\') != std::string::npos)
+    {
+        return false;
+    }
+    if (!bHasSuffix && oParsed.iMaxDimension > 0)
+    {
+        oParsed.sSuffix = "_" + std::to_string(oParsed.iMaxDimension);
+    }
+
+    oRendition = oParsed;
+    return true;
+} // End Function fn_parseRendition
+
+// Read a rendition spec file
+bool fn_loadRenditionFile(const std::string& sPath, std::vector<std::string>& vsSpecs, std::string& sError)
+{
+    std::ifstream oFile(sPath);
+    if (!oFile.is_open())
+    {
+        sError = "Cannot open rendition file: " + sPath;
+        return false;
+    }
+
+    std::string sLine;
+    int iLine = 0;
+    while (std::getline(oFile, sLine))
+    {
+        iLine++;
+        sLine = fn_trim(sLine);
+        if (sLine.empty() || sLine[0] == '#')
+        {
+            continue;
+        }
+        sRendition oRendition;
+        if (!fn_parseRendition(sLine, oRendition))
+        {
+            sError = sPath + ":" + std::to_string(iLine) + ": invalid rendition '" + sLine + "'";
+            return false;
+        }
+        vsSpecs.push_back(sLine);
+    }
+    return true;
+} // End Function fn_loadRenditionFile
+
+// Output path of one rendition
+std::string fn_getRenditionPath(const std::string& sOutputPath, const sRendition& oRendition)
+{
+    std::filesystem::path oPath(sOutputPath);
+    std::string sName = oPath.stem().string() + oRendition.sSuffix + "." + oRendition.sFormat;
+    return (oPath.parent_path() / sName).string();
+} // End Function fn_getRenditionPath
+
+// Cascade resize and parallel encode of every rendition
+bool fn_encodeRenditions(const ImageBuffer& oSource, const std::vector<sRendition>& vRenditions,
+                         const std::vector<std::string>& vsOutputPaths, const fnRenditionOptions& fnMakeOptions,
+                         eResizeFilter eFilter, int iThreads, std::vector<bool>& vbWritten)
+{
+    size_t stCount = vRenditions.size();
+    vbWritten.assign(stCount, false);
+    if (oSource.fn_isEmpty() || vsOutputPaths.size() != stCount)
+    {
+        return false;
+    }
+
+    // Final size of each rendition; the box keeps the aspect ratio and never enlarges
+    std::vector<int> viWidth(stCount), viHeight(stCount);
+    for (size_t i = 0; i < stCount; i++)
+    {
+        sResizeOptions oFit;
+        oFit.iFitWidth = vRenditions[i].iMaxDimension;
+        oFit.iFitHeight = vRenditions[i].iMaxDimension;
+        fn_getResizeTarget(oSource.fn_getWidth(), oSource.fn_getHeight(), oFit, viWidth[i], viHeight[i]);
+    }
+
+    // Largest first, so each size is resampled from the next larger one
+    std::vector<size_t> vstOrder(stCount);
+    std::iota(vstOrder.begin(), vstOrder.end(), 0);
+    std::stable_sort(vstOrder.begin(), vstOrder.end(), [&viWidth, &viHeight](size_t a, size_t b)
+    {
+        return static_cast<long long>(viWidth[a]) * viHeight[a] > static_cast<long long>(viWidth[b]) * viHeight[b];
+    });
+
+    // Concurrent encodes share the threads; each resize runs its own group
+    // from the caller, which works through it rather than waiting behind a
+    // queued encode
+    int iEncodeWorkers = std::min<int>(std::max(1, iThreads), static_cast<int>(stCount));
+    int iThreadsPerEncode = std::max(1, iThreads / iEncodeWorkers);
+    TaskGroup oEncodes(iEncodeWorkers);
+
+    std::vector<char> vcWritten(stCount, 0);
+    ImageBuffer oCurrent = oSource;
+    for (size_t stIdx : vstOrder)
+    {
+        if (oCurrent.fn_getWidth() != viWidth[stIdx] || oCurrent.fn_getHeight() != viHeight[stIdx])
+        {
+            ImageBuffer oResized = fn_resizeImage(oCurrent, viWidth[stIdx], viHeight[stIdx], eFilter, iThreads);
+            if (oResized.fn_isEmpty())
+            {
+                fn_logError("Failed to resize rendition to " + std::to_string(viWidth[stIdx]) + "x" +
+                            std::to_string(viHeight[stIdx]) + ": " + vsOutputPaths[stIdx]);
+                continue;
+            }
+            oCurrent = std::move(oResized);
+        }
+
+        sEncodeOptions oOptions = fnMakeOptions(vRenditions[stIdx], viWidth[stIdx], viHeight[stIdx]);
+        oOptions.iThreads = iThreadsPerEncode;
+        const std::string& sOutputPath = vsOutputPaths[stIdx];
+        char* pcWritten = &vcWritten[stIdx];
+        ImageBuffer oPixels = oCurrent;  // Shared; released when this encode finishes
+        auto fnEncode = [oPixels, oOptions, &sOutputPath, pcWritten]()
+        {
+            FormatEncoder oEncoder;
+            *pcWritten = oEncoder.fn_encodeImage(fn_makeImageData(oPixels), sOutputPath, oOptions) ? 1 : 0;
+            if (!*pcWritten)
+            {
+                fn_logError("Failed to encode rendition: " + sOutputPath);
+            }
+        };
+
+        if (iEncodeWorkers > 1)
+        {
+            oEncodes.fn_submit(fnEncode);
+        }
+        else
+        {
+            fnEncode();
+        }
+    }
+
+    oEncodes.fn_wait();
+
+    bool bAllWritten = true;
+    for (size_t i = 0; i < stCount; i++)
+    {
+        vbWritten[i] = vcWritten[i] != 0;
+        bAllWritten = bAllWritten && vbWritten[i];
+    }
+    return bAllWritten;
+} // End Function fn_encodeRenditions
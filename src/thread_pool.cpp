@@ -0,0 +1,307 @@
+// thread_pool.cpp - Work-stealing thread pool implementation
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "thread_pool.h"
+#include "config.h"
+#include "logger.h"
+#include <algorithm>
+#include <exception>
+
+namespace
+{
+    // Identifies the pool and deque owned by the current thread (if any)
+    thread_local ThreadPool* tl_pCurrentPool = nullptr;
+    thread_local int tl_iWorkerIndex = -1;
+}
+
+// Constructor
+ThreadPool::ThreadPool(int iThreadCount)
+    : m_stQueuedTasks(0),
+      m_stUnfinishedTasks(0),
+      m_uNextQueue(0),
+      m_bStopping(false)
+{
+    int iWorkers = fn_resolveThreadCount(iThreadCount);
+
+    for (int i = 0; i < iWorkers; i++)
+    {
+        m_vpQueues.push_back(std::make_unique<oWorkerQueue>());
+    }
+
+    for (int i = 0; i < iWorkers; i++)
+    {
+        m_vWorkers.emplace_back(&ThreadPool::fn_workerLoop, this, i);
+    }
+}  // End Constructor
+
+// Destructor
+ThreadPool::~ThreadPool()
+{
+    fn_waitIdle();
+
+    {
+        std::lock_guard<std::mutex> oLock(m_oSleepMutex);
+        m_bStopping = true;
+    }
+    m_oWakeCondition.notify_all();
+
+    for (auto& oWorker : m_vWorkers)
+    {
+        if (oWorker.joinable())
+        {
+            oWorker.join();
+        }
+    }
+}  // End Destructor
+
+// Resolve thread count against configured and hardware limits
+int ThreadPool::fn_resolveThreadCount(int iRequested)
+{
+    int iCores = static_cast<int>(std::thread::hardware_concurrency());
+    int iLimit = (iCores > 0) ? std::min(iMAX_THREAD_COUNT, iCores) : iMAX_THREAD_COUNT;
+
+    if (iRequested <= 0)
+    {
+        return iLimit;
+    }
+
+    return std::max(1, std::min(iRequested, iLimit));
+}  // End Function fn_resolveThreadCount
+
+// Get worker count
+int ThreadPool::fn_getThreadCount() const
+{
+    return static_cast<int>(m_vWorkers.size());
+}  // End Function fn_getThreadCount
+
+// Pool of the calling worker thread
+ThreadPool* ThreadPool::fn_getCurrent()
+{
+    return tl_pCurrentPool;
+}  // End Function fn_getCurrent
+
+// Submit a task
+void ThreadPool::fn_submit(std::function<void()> fnTask)
+{
+    size_t stQueue;
+
+    if (tl_pCurrentPool == this && tl_iWorkerIndex >= 0)
+    {
+        stQueue = static_cast<size_t>(tl_iWorkerIndex);
+    }
+    else
+    {
+        stQueue = m_uNextQueue.fetch_add(1, std::memory_order_relaxed) % m_vpQueues.size();
+    }
+
+    m_stUnfinishedTasks.fetch_add(1);
+
+    {
+        std::lock_guard<std::mutex> oLock(m_vpQueues[stQueue]->oMutex);
+        m_vpQueues[stQueue]->dqTasks.push_back(std::move(fnTask));
+    }
+
+    {
+        // Taking the sleep mutex orders the counter update against a worker
+        // that is about to wait, so the wake-up cannot be lost
+        std::lock_guard<std::mutex> oLock(m_oSleepMutex);
+        m_stQueuedTasks.fetch_add(1);
+    }
+    m_oWakeCondition.notify_one();
+}  // End Function fn_submit
+
+// Wait until all tasks have completed
+void ThreadPool::fn_waitIdle()
+{
+    std::unique_lock<std::mutex> oLock(m_oSleepMutex);
+    m_oIdleCondition.wait(oLock, [this]() { return m_stUnfinishedTasks.load() == 0; });
+}  // End Function fn_waitIdle
+
+// Pop oldest task from the worker's own deque
+bool ThreadPool::fn_popLocal(int iWorkerIndex, std::function<void()>& fnTask)
+{
+    oWorkerQueue& oQueue = *m_vpQueues[iWorkerIndex];
+    std::lock_guard<std::mutex> oLock(oQueue.oMutex);
+
+    if (oQueue.dqTasks.empty())
+    {
+        return false;
+    }
+
+    fnTask = std::move(oQueue.dqTasks.front());
+    oQueue.dqTasks.pop_front();
+    return true;
+}  // End Function fn_popLocal
+
+// Steal newest task from another worker's deque
+bool ThreadPool::fn_stealTask(int iWorkerIndex, std::function<void()>& fnTask)
+{
+    size_t stQueues = m_vpQueues.size();
+
+    for (size_t stOffset = 1; stOffset < stQueues; stOffset++)
+    {
+        oWorkerQueue& oVictim = *m_vpQueues[(iWorkerIndex + stOffset) % stQueues];
+        std::unique_lock<std::mutex> oLock(oVictim.oMutex, std::try_to_lock);
+
+        if (!oLock.owns_lock() || oVictim.dqTasks.empty())
+        {
+            continue;
+        }
+
+        fnTask = std::move(oVictim.dqTasks.back());
+        oVictim.dqTasks.pop_back();
+        return true;
+    }
+
+    return false;
+}  // End Function fn_stealTask
+
+// Run a task and update bookkeeping
+void ThreadPool::fn_runTask(std::function<void()>& fnTask)
+{
+    m_stQueuedTasks.fetch_sub(1);
+
+    try
+    {
+        fnTask();
+    }
+    catch (const std::exception& e)
+    {
+        fn_logError(std::string("Unhandled exception in worker task: ") + e.what());
+    }
+    catch (...)
+    {
+        fn_logError("Unknown exception in worker task");
+    }
+
+    fnTask = nullptr;
+
+    if (m_stUnfinishedTasks.fetch_sub(1) == 1)
+    {
+        std::lock_guard<std::mutex> oLock(m_oSleepMutex);
+        m_oIdleCondition.notify_all();
+    }
+}  // End Function fn_runTask
+
+// Worker main loop
+void ThreadPool::fn_workerLoop(int iWorkerIndex)
+{
+    tl_pCurrentPool = this;
+    tl_iWorkerIndex = iWorkerIndex;
+
+    std::function<void()> fnTask;
+
+    while (true)
+    {
+        if (fn_popLocal(iWorkerIndex, fnTask) || fn_stealTask(iWorkerIndex, fnTask))
+        {
+            fn_runTask(fnTask);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> oLock(m_oSleepMutex);
+
+        if (m_bStopping && m_stQueuedTasks.load() == 0)
+        {
+            break;
+        }
+
+        // A steal can miss a deque that was locked at the time, so only sleep
+        // while nothing is queued anywhere
+        m_oWakeCondition.wait(oLock, [this]()
+        {
+            return m_bStopping || m_stQueuedTasks.load() > 0;
+        });
+    }
+
+    tl_pCurrentPool = nullptr;
+    tl_iWorkerIndex = -1;
+}  // End Function fn_workerLoop
+
+// Constructor
+TaskGroup::TaskGroup(int iThreads)
+    : m_pState(std::make_shared<sState>()),
+      m_pPool(nullptr),
+      m_iThreads(std::max(1, iThreads)),
+      m_iHelpers(0)
+{
+    if (m_iThreads > 1)
+    {
+        m_pPool = ThreadPool::fn_getCurrent();
+        if (!m_pPool)
+        {
+            m_pOwnedPool.reset(new ThreadPool(m_iThreads - 1));
+            m_pPool = m_pOwnedPool.get();
+        }
+    }
+}  // End Constructor
+
+// Destructor
+TaskGroup::~TaskGroup()
+{
+    fn_wait();
+}  // End Destructor
+
+// Queue a task and, while under the thread limit, a helper to run it
+void TaskGroup::fn_submit(std::function<void()> fnTask)
+{
+    {
+        std::lock_guard<std::mutex> oLock(m_pState->oMutex);
+        m_pState->dqTasks.push_back(std::move(fnTask));
+    }
+
+    if (m_pPool && m_iHelpers < m_iThreads - 1)
+    {
+        m_iHelpers++;
+        std::shared_ptr<sState> pState = m_pState;
+        m_pPool->fn_submit([pState]() { fn_drain(pState); });
+    }
+}  // End Function fn_submit
+
+// Run the group's queued tasks until none are left
+void TaskGroup::fn_drain(const std::shared_ptr<sState>& pState)
+{
+    std::unique_lock<std::mutex> oLock(pState->oMutex);
+    while (!pState->dqTasks.empty())
+    {
+        std::function<void()> fnTask = std::move(pState->dqTasks.front());
+        pState->dqTasks.pop_front();
+        pState->iRunning++;
+        oLock.unlock();
+
+        try
+        {
+            fnTask();
+        }
+        catch (const std::exception& e)
+        {
+            fn_logError(std::string("Unhandled exception in group task: ") + e.what());
+        }
+        catch (...)
+        {
+            fn_logError("Unknown exception in group task");
+        }
+        fnTask = nullptr;
+
+        oLock.lock();
+        pState->iRunning--;
+    }
+    pState->oDone.notify_all();
+}  // End Function fn_drain
+
+// Help with the remaining tasks, then wait for those running elsewhere
+void TaskGroup::fn_wait()
+{
+    fn_drain(m_pState);
+
+    std::unique_lock<std::mutex> oLock(m_pState->oMutex);
+    m_pState->oDone.wait(oLock, [this]() { return m_pState->dqTasks.empty() && m_pState->iRunning == 0; });
+    m_iHelpers = 0;
+}  // End Function fn_wait
+
+// Threads working on the group
+int TaskGroup::fn_getThreadCount() const
+{
+    return m_iThreads;
+}  // End Function fn_getThreadCount
@@ -0,0 +1,163 @@
+// test_batch_journal.cpp - Unit tests for the resumable batch journal
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "batch_journal.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+// Test Fixture: a scratch directory with one input and one output file
+class BatchJournalTest : public ::testing::Test
+{ // Begin class BatchJournalTest
+protected:
+    void SetUp() override
+    { // Begin SetUp
+        char aDirectory[] = "/tmp/journal_test.XXXXXX"; // Local Function
+        ASSERT_NE(mkdtemp(aDirectory), nullptr); // In cstdlib
+        sRoot = aDirectory;
+        sJournal = sRoot + "/batch.journal";
+        sInput = sRoot + "/IMG_0001.heic";
+        sOutput = sRoot + "/IMG_0001.jpg";
+        std::ofstream(sInput) << std::string(1000, 'h');
+        std::ofstream(sOutput) << std::string(300, 'j');
+    } // End SetUp
+
+    void TearDown() override
+    { // Begin TearDown
+        std::filesystem::remove_all(sRoot); // In filesystem
+    } // End TearDown
+
+    uintmax_t fn_journalSize() const
+    { // Begin fn_journalSize
+        return std::filesystem::file_size(sJournal); // In filesystem
+    } // End Function fn_journalSize
+
+    std::string sRoot;
+    std::string sJournal;
+    std::string sInput;
+    std::string sOutput;
+}; // End class BatchJournalTest
+
+// Test Case: A recorded success survives reopening and is matched on size, mtime and options
+TEST_F(BatchJournalTest, SkipsOnlyUnchangedWork)
+{ // Begin TEST
+    const uint64_t ullOptions = fn_hashJournalOptions("format=jpg;quality=90"); // In batch_journal.cpp
+    EXPECT_NE(ullOptions, fn_hashJournalOptions("format=jpg;quality=91")); // In gtest
+    {
+        BatchJournal oJournal; // In batch_journal.h
+        std::string sError; // Local Function
+        ASSERT_TRUE(oJournal.fn_open(sJournal, sError)) << sError; // In batch_journal.cpp
+        EXPECT_FALSE(oJournal.fn_isUpToDate(sInput, ullOptions)); // Nothing recorded yet
+        ASSERT_TRUE(oJournal.fn_record(sInput, sOutput, ullOptions, true)); // In batch_journal.cpp
+    }
+
+    BatchJournal oJournal; // In batch_journal.h
+    std::string sError; // Local Function
+    ASSERT_TRUE(oJournal.fn_open(sJournal, sError)) << sError; // In batch_journal.cpp
+    EXPECT_EQ(oJournal.fn_getEntryCount(), 1u); // In gtest
+    EXPECT_TRUE(oJournal.fn_isUpToDate(sInput, ullOptions)); // In gtest
+    EXPECT_TRUE(oJournal.fn_isUpToDate(sRoot + "/./IMG_0001.heic", ullOptions)); // Same file, other spelling
+    EXPECT_FALSE(oJournal.fn_isUpToDate(sInput, ullOptions + 1)); // Different options
+
+    std::string sRecorded; // Local Function
+    ASSERT_TRUE(oJournal.fn_findOutput(sInput, sRecorded)); // In batch_journal.cpp
+    EXPECT_EQ(sRecorded, fn_normalizeJournalPath(sOutput)); // In gtest
+
+    // A replaced output, or an edited input, is converted again
+    std::ofstream(sOutput) << std::string(10, 'x');
+    EXPECT_FALSE(oJournal.fn_isUpToDate(sInput, ullOptions)); // In gtest
+    std::ofstream(sOutput) << std::string(300, 'j');
+    EXPECT_TRUE(oJournal.fn_isUpToDate(sInput, ullOptions)); // In gtest
+    std::ofstream(sInput, std::ios::app) << "more";
+    EXPECT_FALSE(oJournal.fn_isUpToDate(sInput, ullOptions)); // In gtest
+
+    // The latest record wins: a failure is never skipped
+    ASSERT_TRUE(oJournal.fn_record(sInput, sOutput, ullOptions, false)); // In batch_journal.cpp
+    EXPECT_FALSE(oJournal.fn_isUpToDate(sInput, ullOptions)); // In gtest
+} // End TEST(SkipsOnlyUnchangedWork)
+
+// Test Case: A torn or corrupted tail is cut off and the records before it are kept
+TEST_F(BatchJournalTest, RecoversFromTornTail)
+{ // Begin TEST
+    const uint64_t ullOptions = fn_hashJournalOptions("format=png"); // In batch_journal.cpp
+    std::string sSecond = sRoot + "/IMG_0002.heic"; // Local Function
+    std::ofstream(sSecond) << "second";
+    uintmax_t ullAfterFirst = 0; // Local Function
+    {
+        BatchJournal oJournal; // In batch_journal.h
+        std::string sError; // Local Function
+        ASSERT_TRUE(oJournal.fn_open(sJournal, sError)) << sError; // In batch_journal.cpp
+        ASSERT_TRUE(oJournal.fn_record(sInput, sOutput, ullOptions, true)); // In batch_journal.cpp
+        oJournal.fn_checkpoint(); // In batch_journal.cpp
+        ullAfterFirst = fn_journalSize();
+        ASSERT_TRUE(oJournal.fn_record(sSecond, sOutput, ullOptions, true)); // In batch_journal.cpp
+    }
+
+    // Crash in the middle of the second append
+    std::filesystem::resize_file(sJournal, fn_journalSize() - 5); // In filesystem
+    {
+        BatchJournal oJournal; // In batch_journal.h
+        std::string sError; // Local Function
+        ASSERT_TRUE(oJournal.fn_open(sJournal, sError)) << sError; // In batch_journal.cpp
+        EXPECT_EQ(oJournal.fn_getEntryCount(), 1u); // In gtest
+        EXPECT_TRUE(oJournal.fn_isUpToDate(sInput, ullOptions)); // In gtest
+        EXPECT_EQ(fn_journalSize(), ullAfterFirst); // In gtest
+
+        // Appends continue after the good prefix
+        ASSERT_TRUE(oJournal.fn_record(sSecond, sOutput, ullOptions, true)); // In batch_journal.cpp
+    }
+
+    // A flipped byte fails the CRC of the last record
+    {
+        std::fstream oFile(sJournal, std::ios::in | std::ios::out | std::ios::binary); // In fstream
+        oFile.seekp(-3, std::ios::end);
+        oFile.put('#');
+    }
+    BatchJournal oJournal; // In batch_journal.h
+    std::string sError; // Local Function
+    ASSERT_TRUE(oJournal.fn_open(sJournal, sError)) << sError; // In batch_journal.cpp
+    EXPECT_EQ(oJournal.fn_getEntryCount(), 1u); // In gtest
+    EXPECT_FALSE(oJournal.fn_isUpToDate(sSecond, ullOptions)); // In gtest
+} // End TEST(RecoversFromTornTail)
+
+// Test Case: Files that are not journals are refused, never overwritten
+TEST_F(BatchJournalTest, RejectsForeignFiles)
+{ // Begin TEST
+    std::ofstream(sJournal) << "not a journal at all";
+    BatchJournal oJournal; // In batch_journal.h
+    std::string sError; // Local Function
+    EXPECT_FALSE(oJournal.fn_open(sJournal, sError)); // In batch_journal.cpp
+    EXPECT_FALSE(sError.empty()); // In gtest
+    EXPECT_EQ(fn_journalSize(), 20u); // Left as it was
+} // End TEST(RejectsForeignFiles)
+
+// Test Case: Superseded records are compacted away and nothing live is lost
+TEST_F(BatchJournalTest, CompactsRepeatedRecords)
+{ // Begin TEST
+    const uint64_t ullOptions = fn_hashJournalOptions("format=webp"); // In batch_journal.cpp
+    BatchJournal oJournal; // In batch_journal.h
+    std::string sError; // Local Function
+    ASSERT_TRUE(oJournal.fn_open(sJournal, sError)) << sError; // In batch_journal.cpp
+
+    for (int i = 0; i < 3000; ++i)
+    { // Begin for
+        ASSERT_TRUE(oJournal.fn_record(sInput, sOutput, ullOptions, i % 2 == 0)); // In batch_journal.cpp
+    } // End for(int i = 0; i < 3000; ++i)
+    EXPECT_EQ(oJournal.fn_getEntryCount(), 1u); // In gtest
+    EXPECT_LT(oJournal.fn_getRecordCount(), 1100u); // Rewritten at least once
+    EXPECT_FALSE(oJournal.fn_isUpToDate(sInput, ullOptions)); // Last record (2999) failed
+    oJournal.fn_close(); // In batch_journal.cpp
+
+    BatchJournal oReopened; // In batch_journal.h
+    ASSERT_TRUE(oReopened.fn_open(sJournal, sError)) << sError; // In batch_journal.cpp
+    EXPECT_EQ(oReopened.fn_getEntryCount(), 1u); // In gtest
+    EXPECT_LT(oReopened.fn_getRecordCount(), 1100u); // In gtest
+    ASSERT_TRUE(oReopened.fn_record(sInput, sOutput, ullOptions, true)); // In batch_journal.cpp
+    EXPECT_TRUE(oReopened.fn_isUpToDate(sInput, ullOptions)); // In gtest
+    EXPECT_FALSE(std::filesystem::exists(sJournal + ".compact")); // In filesystem
+} // End TEST(CompactsRepeatedRecords)
@@ -0,0 +1,71 @@
+// test_bounded_queue.cpp - Unit tests for the bounded pipeline queue
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "bounded_queue.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Test Case: Capacity is rounded up and a full queue rejects pushes
+TEST(BoundedQueueTest, CapacityAndFull)
+{ // Begin TEST
+    BoundedQueue<int> oQueue(3); // In bounded_queue.h
+    EXPECT_EQ(oQueue.fn_getCapacity(), 4u); // In gtest
+
+    for (int i = 0; i < 4; i++)
+    { // Begin for
+        int iValue = i; // Local Function
+        EXPECT_TRUE(oQueue.fn_tryPush(iValue)); // In bounded_queue.h
+    } // End for(int i = 0; i < 4; i++)
+
+    int iExtra = 99; // Local Function
+    EXPECT_FALSE(oQueue.fn_tryPush(iExtra)); // In bounded_queue.h
+
+    int iOut = -1; // Local Function
+    EXPECT_TRUE(oQueue.fn_tryPop(iOut)); // In bounded_queue.h
+    EXPECT_EQ(iOut, 0); // In gtest
+} // End TEST(CapacityAndFull)
+
+// Test Case: Several producers and consumers see every item exactly once
+TEST(BoundedQueueTest, MultiProducerMultiConsumer)
+{ // Begin TEST
+    BoundedQueue<int> oQueue(8); // In bounded_queue.h
+    const int iPerProducer = 5000; // Local Function
+    std::atomic<long long> llSum(0); // Local Function
+    std::atomic<int> iCount(0); // Local Function
+
+    std::vector<std::thread> vConsumers; // Local Function
+    for (int c = 0; c < 3; c++)
+    { // Begin for
+        vConsumers.emplace_back([&]()
+        { // Begin lambda
+            int iValue; // Local Function
+            while (oQueue.fn_pop(iValue))
+            { // Begin while
+                llSum += iValue;
+                iCount++;
+            } // End while
+        }); // End lambda
+    } // End for(int c = 0; c < 3; c++)
+
+    std::vector<std::thread> vProducers; // Local Function
+    for (int p = 0; p < 3; p++)
+    { // Begin for
+        vProducers.emplace_back([&oQueue, iPerProducer]()
+        { // Begin lambda
+            for (int i = 1; i <= iPerProducer; i++)
+            { // Begin for
+                oQueue.fn_push(i); // In bounded_queue.h
+            } // End for(int i = 1; i <= iPerProducer; i++)
+        }); // End lambda
+    } // End for(int p = 0; p < 3; p++)
+
+    for (auto& oThread : vProducers) oThread.join();
+    oQueue.fn_close(); // In bounded_queue.h
+    for (auto& oThread : vConsumers) oThread.join();
+
+    EXPECT_EQ(iCount.load(), 3 * iPerProducer); // In gtest
+    EXPECT_EQ(llSum.load(), 3LL * iPerProducer * (iPerProducer + 1) / 2); // In gtest
+} // End TEST(MultiProducerMultiConsumer)
@@ -0,0 +1,162 @@
+// test_dedup_index.cpp - Unit tests for content hashing and duplicate tracking
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "dedup_index.h"
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+// Test Fixture: scratch inputs whose bytes the index compares
+class DedupIndexTest : public ::testing::Test
+{ // Begin class DedupIndexTest
+protected:
+    void SetUp() override
+    { // Begin SetUp
+        char aDirectory[] = "/tmp/dedup_test.XXXXXX"; // Local Function
+        ASSERT_NE(mkdtemp(aDirectory), nullptr); // In cstdlib
+        sRoot = aDirectory;
+    } // End SetUp
+
+    void TearDown() override
+    { // Begin TearDown
+        std::filesystem::remove_all(sRoot); // In filesystem
+    } // End TearDown
+
+    // Write an input and return its path
+    std::string fn_writeInput(const std::string& sName, const std::string& sBytes)
+    { // Begin fn_writeInput
+        std::string sPath = sRoot + "/" + sName; // Local Function
+        std::ofstream(sPath) << sBytes;
+        return sPath;
+    } // End Function fn_writeInput
+
+    // Claim with a fixed hash so that collisions can be forced
+    eDedupRole fn_claim(DedupIndex& oIndex, uint64_t ullHash, const std::string& sInput,
+                        const std::string& sBytes, const std::string& sOutput, std::string& sLeader)
+    { // Begin fn_claim
+        return oIndex.fn_claim(ullHash, reinterpret_cast<const unsigned char*>(sBytes.data()), sBytes.size(),
+                               sInput, sOutput, sLeader); // In dedup_index.cpp
+    } // End Function fn_claim
+
+    std::string sRoot;
+}; // End class DedupIndexTest
+
+// Test Case: The hash matches the reference XXH64 on short and striped inputs
+TEST_F(DedupIndexTest, HashMatchesReference)
+{ // Begin TEST
+    EXPECT_EQ(fn_hashContent("", 0), 0xEF46DB3751D8E999ull); // In dedup_index.cpp
+    EXPECT_EQ(fn_hashContent("a", 1), 0xD24EC4F1A98C6E5Bull); // In dedup_index.cpp
+    EXPECT_EQ(fn_hashContent("abc", 3), 0x44BC2CF5AD770999ull); // In dedup_index.cpp
+    const std::string sText = "Nobody inspects the spammish repetition"; // Local Function
+    EXPECT_EQ(fn_hashContent(sText.data(), sText.size()), 0xFBCEA83C8A378BF1ull); // 32-byte stripes
+
+    std::string sChanged = sText; // Local Function
+    sChanged[20] ^= 1;
+    EXPECT_NE(fn_hashContent(sChanged.data(), sChanged.size()), fn_hashContent(sText.data(), sText.size())); // In gtest
+
+    eDedupMode eMode = eDedupMode::Off; // In dedup_index.h
+    ASSERT_TRUE(fn_parseDedupMode("clone", eMode)); // In dedup_index.cpp
+    EXPECT_EQ(eMode, eDedupMode::Clone); // In gtest
+    EXPECT_EQ(fn_getDedupModeName(eDedupMode::Link), "link"); // In gtest
+    EXPECT_FALSE(fn_parseDedupMode("symlink", eMode)); // In dedup_index.cpp
+} // End TEST(HashMatchesReference)
+
+// Test Case: First content converts; later copies wait or follow; failures are not followed
+TEST_F(DedupIndexTest, ClaimsByContent)
+{ // Begin TEST
+    const std::string sOne(100, '1'); // Local Function
+    const std::string sTwo(101, '2'); // Local Function
+    std::string sA1 = fn_writeInput("a1.heic", sOne); // Local Function
+    std::string sA2 = fn_writeInput("a2.heic", sTwo); // Local Function
+    std::string sB1 = fn_writeInput("b1.heic", sOne); // Local Function
+    std::string sB2 = fn_writeInput("b2.heic", sTwo); // Local Function
+    std::string sC1 = fn_writeInput("c1.heic", sOne); // Local Function
+    std::string sC2 = fn_writeInput("c2.heic", sTwo); // Local Function
+
+    DedupIndex oIndex; // In dedup_index.h
+    std::string sLeader; // Local Function
+    EXPECT_EQ(fn_claim(oIndex, 7, sA1, sOne, "out/1.jpg", sLeader), eDedupRole::Convert); // In dedup_index.cpp
+    EXPECT_EQ(fn_claim(oIndex, 7, sA2, sTwo, "out/2.jpg", sLeader), eDedupRole::Convert); // Same hash, other size
+    EXPECT_EQ(fn_claim(oIndex, 7, sB1, sOne, "out/1_1.jpg", sLeader), eDedupRole::Wait); // In dedup_index.cpp
+
+    std::vector<sDedupFollower> vWaiting = oIndex.fn_finish(sA1, true); // In dedup_index.cpp
+    ASSERT_EQ(vWaiting.size(), 1u); // In gtest
+    EXPECT_EQ(vWaiting[0].sInputFile, sB1); // In gtest
+    EXPECT_EQ(vWaiting[0].sOutputFile, "out/1_1.jpg"); // In gtest
+    EXPECT_TRUE(oIndex.fn_finish(sB1, true).empty()); // Not a converting file
+
+    EXPECT_EQ(fn_claim(oIndex, 7, sC1, sOne, "out/1_2.jpg", sLeader), eDedupRole::Follow); // In dedup_index.cpp
+    EXPECT_EQ(sLeader, "out/1.jpg"); // In gtest
+
+    // A failed conversion hands back its waiters and lets the next copy try again
+    EXPECT_EQ(fn_claim(oIndex, 7, sB2, sTwo, "out/2_1.jpg", sLeader), eDedupRole::Wait); // In dedup_index.cpp
+    EXPECT_EQ(oIndex.fn_finish(sA2, false).size(), 1u); // In gtest
+    EXPECT_EQ(fn_claim(oIndex, 7, sC2, sTwo, "out/2_2.jpg", sLeader), eDedupRole::Convert); // In dedup_index.cpp
+
+    oIndex.fn_noteDuplicate(100, eDedupMode::Link); // In dedup_index.cpp
+    oIndex.fn_noteDuplicate(50, eDedupMode::Copy); // In dedup_index.cpp
+    sDedupSummary oSummary = oIndex.fn_getSummary(); // In dedup_index.cpp
+    EXPECT_EQ(oSummary.iFiles, 2); // In gtest
+    EXPECT_EQ(oSummary.ullBytes, 150u); // In gtest
+    EXPECT_EQ(oSummary.iLinked, 1); // In gtest
+    EXPECT_EQ(oSummary.iCopied, 1); // In gtest
+    EXPECT_EQ(oSummary.iCollisions, 0); // In gtest
+} // End TEST(ClaimsByContent)
+
+// Test Case: Same size and hash but different bytes is converted, never shared
+TEST_F(DedupIndexTest, HashCollisionIsConverted)
+{ // Begin TEST
+    const std::string sFirst(64, 'x'); // Local Function
+    std::string sSecond = sFirst; // Local Function
+    sSecond[40] = 'y';
+    std::string sInputA = fn_writeInput("a.heic", sFirst); // Local Function
+    std::string sInputB = fn_writeInput("b.heic", sSecond); // Local Function
+
+    DedupIndex oIndex; // In dedup_index.h
+    std::string sLeader; // Local Function
+    EXPECT_EQ(fn_claim(oIndex, 42, sInputA, sFirst, "out/a.jpg", sLeader), eDedupRole::Convert); // In dedup_index.cpp
+    EXPECT_EQ(fn_claim(oIndex, 42, sInputB, sSecond, "out/b.jpg", sLeader), eDedupRole::Convert); // Forced collision
+    EXPECT_TRUE(oIndex.fn_finish(sInputA, true).empty()); // Nothing waited on the other content
+    EXPECT_EQ(fn_claim(oIndex, 42, sInputB, sSecond, "out/b_1.jpg", sLeader), eDedupRole::Convert); // Still not a/out
+    EXPECT_TRUE(sLeader.empty()); // In gtest
+    EXPECT_EQ(oIndex.fn_getSummary().iCollisions, 2); // In dedup_index.cpp
+
+    // A leader input that is gone can no longer vouch for its content
+    std::filesystem::remove(sInputA); // In filesystem
+    EXPECT_EQ(fn_claim(oIndex, 42, sInputB, sFirst, "out/c.jpg", sLeader), eDedupRole::Convert); // In dedup_index.cpp
+} // End TEST(HashCollisionIsConverted)
+
+// Test Case: Outputs are linked or copied, never clobbered unless replacing
+TEST_F(DedupIndexTest, MaterializesOutputs)
+{ // Begin TEST
+    std::string sSource = fn_writeInput("photo.jpg", std::string(5000, 'p')); // Local Function
+
+    sOutputOptions oOptions; // In output_file.h
+    oOptions.bReplace = false;
+    eDedupMode eUsed = eDedupMode::Off; // In dedup_index.h
+    std::string sError; // Local Function
+
+    ASSERT_TRUE(fn_materializeDuplicate(sSource, sRoot + "/linked.jpg", eDedupMode::Link, oOptions, eUsed, sError)) << sError; // In dedup_index.cpp
+    EXPECT_EQ(eUsed, eDedupMode::Link); // In gtest
+    EXPECT_EQ(std::filesystem::hard_link_count(sSource), 2u); // In filesystem
+
+    ASSERT_TRUE(fn_materializeDuplicate(sSource, sRoot + "/copied.jpg", eDedupMode::Clone, oOptions, eUsed, sError)) << sError; // In dedup_index.cpp
+    EXPECT_NE(eUsed, eDedupMode::Link); // Cloned or copied, depending on the filesystem
+    std::ifstream oCopy(sRoot + "/copied.jpg"); // In fstream
+    std::string sCopied((std::istreambuf_iterator<char>(oCopy)), std::istreambuf_iterator<char>()); // Local Function
+    EXPECT_EQ(sCopied, std::string(5000, 'p')); // In gtest
+    EXPECT_EQ(std::filesystem::hard_link_count(sRoot + "/copied.jpg"), 1u); // In filesystem
+
+    // An existing file is only replaced when asked to
+    std::ofstream(sRoot + "/taken.jpg") << "other";
+    EXPECT_FALSE(fn_materializeDuplicate(sSource, sRoot + "/taken.jpg", eDedupMode::Link, oOptions, eUsed, sError)); // In dedup_index.cpp
+    EXPECT_EQ(std::filesystem::file_size(sRoot + "/taken.jpg"), 5u); // In filesystem
+    oOptions.bReplace = true;
+    EXPECT_TRUE(fn_materializeDuplicate(sSource, sRoot + "/taken.jpg", eDedupMode::Copy, oOptions, eUsed, sError)) << sError; // In dedup_index.cpp
+    EXPECT_EQ(eUsed, eDedupMode::Copy); // In gtest
+    EXPECT_EQ(std::filesystem::file_size(sRoot + "/taken.jpg"), 5000u); // In filesystem
+} // End TEST(MaterializesOutputs)
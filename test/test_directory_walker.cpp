@@ -0,0 +1,110 @@
+// test_directory_walker.cpp - Unit tests for the parallel directory walker
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "directory_walker.h"
+#include "file_utils.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// Test Fixture: a small tree with nested folders, links and a symlink loop
+class DirectoryWalkerTest : public ::testing::Test
+{ // Begin class DirectoryWalkerTest
+protected:
+    void SetUp() override
+    { // Begin SetUp
+        char aDirectory[] = "/tmp/walker_test.XXXXXX"; // Local Function
+        ASSERT_NE(mkdtemp(aDirectory), nullptr); // In cstdlib
+        sRoot = aDirectory;
+
+        std::filesystem::create_directories(sRoot + "/2023/01"); // In filesystem
+        std::filesystem::create_directories(sRoot + "/2024"); // In filesystem
+        for (const char* pFile : {"/top.heic", "/notes.txt", "/2023/01/a.HEIC", "/2023/01/b.heif",
+                                  "/2023/c.jpg", "/2024/d.heic"})
+        { // Begin for
+            std::ofstream(sRoot + pFile) << "x";
+        } // End for(const char* pFile : ...)
+
+        // Loops back to the root, a second path to 2023 and a link to a file
+        ASSERT_EQ(symlink("..", (sRoot + "/2024/up").c_str()), 0); // In unistd.h
+        ASSERT_EQ(symlink("2023", (sRoot + "/again").c_str()), 0); // In unistd.h
+        ASSERT_EQ(symlink("2024/d.heic", (sRoot + "/linked.heic").c_str()), 0); // In unistd.h
+        ASSERT_EQ(symlink("missing.heic", (sRoot + "/dangling.heic").c_str()), 0); // In unistd.h
+    } // End SetUp
+
+    void TearDown() override
+    { // Begin TearDown
+        std::filesystem::remove_all(sRoot); // In filesystem
+    } // End TearDown
+
+    // Sorted paths relative to sRoot
+    std::vector<std::string> fn_walk(bool bRecursive, int iThreads, const fnWalkFilter& fnFilter)
+    { // Begin fn_walk
+        std::vector<std::string> vsFiles; // Local Function
+        std::mutex oMutex; // Local Function
+        EXPECT_TRUE(fn_walkDirectory(sRoot + "/", bRecursive, iThreads, fnFilter,
+            [this, &vsFiles, &oMutex](const std::string& sPath)
+            { // Begin lambda
+                std::lock_guard<std::mutex> oLock(oMutex);
+                vsFiles.push_back(sPath.substr(sRoot.size()));
+            })); // In directory_walker.cpp
+        std::sort(vsFiles.begin(), vsFiles.end());
+        return vsFiles;
+    } // End Function fn_walk
+
+    std::string sRoot;
+}; // End class DirectoryWalkerTest
+
+// Test Case: Every regular file is found once; loops and repeat paths are not re-entered
+TEST_F(DirectoryWalkerTest, RecursiveVisitsEachDirectoryOnce)
+{ // Begin TEST
+    std::vector<std::string> vsExpected = {"/2023/01/a.HEIC", "/2023/01/b.heif", "/2023/c.jpg",
+                                           "/2024/d.heic", "/linked.heic", "/notes.txt", "/top.heic"}; // Local Function
+    std::vector<std::string> vsSerial = fn_walk(true, 1, fnWalkFilter()); // Local Function
+    ASSERT_EQ(vsSerial.size(), vsExpected.size()); // In gtest
+
+    // 2023 is reached either directly or through "again", never both
+    for (std::string& sPath : vsSerial)
+    { // Begin for
+        if (sPath.compare(0, 7, "/again/") == 0)
+        { // Begin if
+            sPath = "/2023/" + sPath.substr(7);
+        } // End if(reached through the link)
+    } // End for(std::string& sPath : vsSerial)
+    std::sort(vsSerial.begin(), vsSerial.end());
+    EXPECT_EQ(vsSerial, vsExpected); // In gtest
+
+    EXPECT_EQ(fn_walk(true, 4, fnWalkFilter()).size(), vsExpected.size()); // In gtest
+} // End TEST(RecursiveVisitsEachDirectoryOnce)
+
+// Test Case: Names are filtered before paths are built; non-recursive stays at the top
+TEST_F(DirectoryWalkerTest, FilterAndDepth)
+{ // Begin TEST
+    fnWalkFilter fnHeic = [](const char* pName) { return fn_isHeicFile(pName); }; // Local Function
+    std::vector<std::string> vsTop = fn_walk(false, 4, fnHeic); // Local Function
+    EXPECT_EQ(vsTop, (std::vector<std::string>{"/linked.heic", "/top.heic"})); // In gtest
+
+    std::vector<std::string> vsAll = fn_walk(true, 4, fnHeic); // Local Function
+    EXPECT_EQ(vsAll.size(), 5u); // In gtest
+    EXPECT_EQ(std::count(vsAll.begin(), vsAll.end(), "/2023/c.jpg"), 0); // In gtest
+
+    EXPECT_FALSE(fn_walkDirectory(sRoot + "/absent", true, 1, fnWalkFilter(),
+                                  [](const std::string&) {})); // In directory_walker.cpp
+} // End TEST(FilterAndDepth)
+
+// Test Case: The collected list is sorted whatever order the threads finish in
+TEST_F(DirectoryWalkerTest, CollectIsSorted)
+{ // Begin TEST
+    std::vector<std::string> vsFiles = fn_collectDirectoryFiles(sRoot, true, 4); // In file_utils.cpp
+    EXPECT_EQ(vsFiles.size(), 7u); // In gtest
+    EXPECT_TRUE(std::is_sorted(vsFiles.begin(), vsFiles.end())); // In gtest
+    EXPECT_EQ(fn_collectDirectoryFiles(sRoot, false).size(), 3u); // top, notes, linked
+} // End TEST(CollectIsSorted)
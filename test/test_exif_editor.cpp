@@ -0,0 +1,204 @@
+// test_exif_editor.cpp - Unit tests for in-place EXIF editing
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "exif_editor.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Writes TIFF fields in either byte order at fixed offsets
+struct sTiffBuilder
+{
+    std::vector<unsigned char> vTiff;
+    bool bLittle;
+
+    sTiffBuilder(size_t stSize, bool bLittleEndian) : vTiff(stSize, 0), bLittle(bLittleEndian) {}
+
+    void fn_put16(size_t stAt, uint32_t uValue)
+    { // Begin fn_put16
+        vTiff[stAt + (bLittle ? 0 : 1)] = static_cast<unsigned char>(uValue);
+        vTiff[stAt + (bLittle ? 1 : 0)] = static_cast<unsigned char>(uValue >> 8);
+    } // End Function fn_put16
+
+    void fn_put32(size_t stAt, uint32_t uValue)
+    { // Begin fn_put32
+        fn_put16(stAt + (bLittle ? 0 : 2), uValue & 0xFFFF);
+        fn_put16(stAt + (bLittle ? 2 : 0), uValue >> 16);
+    } // End Function fn_put32
+
+    uint32_t fn_get16(size_t stAt) const
+    { // Begin fn_get16
+        return bLittle ? (vTiff[stAt] | (vTiff[stAt + 1] << 8)) : ((vTiff[stAt] << 8) | vTiff[stAt + 1]);
+    } // End Function fn_get16
+
+    uint32_t fn_get32(size_t stAt) const
+    { // Begin fn_get32
+        return bLittle ? (fn_get16(stAt) | (fn_get16(stAt + 2) << 16)) : ((fn_get16(stAt) << 16) | fn_get16(stAt + 2));
+    } // End Function fn_get32
+
+    void fn_entry(size_t stAt, uint16_t uTag, uint16_t uType, uint32_t uCount, uint32_t uValue)
+    { // Begin fn_entry
+        fn_put16(stAt, uTag);
+        fn_put16(stAt + 2, uType);
+        fn_put32(stAt + 4, uCount);
+        if (uType == 3 && uCount == 1)
+        { // Begin if
+            fn_put16(stAt + 8, uValue);
+        } // End if(inline SHORT)
+        else
+        { // Begin else
+            fn_put32(stAt + 8, uValue);
+        } // End else
+    } // End Function fn_entry
+}; // End struct sTiffBuilder
+
+// IFD0 (Make, Orientation 6, Exif and GPS pointers) at 8, Exif IFD
+// (MakerNote, PixelX SHORT 4032, PixelY LONG 3024) at 68, MakerNote bytes at
+// 110, GPS IFD (LatitudeRef, Latitude) at 126 and the latitude at 156
+static sTiffBuilder fn_buildTiff(bool bLittle)
+{ // Begin fn_buildTiff
+    sTiffBuilder oTiff(180, bLittle); // Local Function
+    oTiff.vTiff[0] = oTiff.vTiff[1] = bLittle ? 'I' : 'M';
+    oTiff.fn_put16(2, 42);
+    oTiff.fn_put32(4, 8);
+
+    oTiff.fn_put16(8, 4);
+    oTiff.fn_entry(10, 0x010F, 2, 6, 62);
+    oTiff.fn_entry(22, 0x0112, 3, 1, 6);
+    oTiff.fn_entry(34, 0x8769, 4, 1, 68);
+    oTiff.fn_entry(46, 0x8825, 4, 1, 126);
+    std::copy_n("Apple", 6, oTiff.vTiff.begin() + 62);
+
+    oTiff.fn_put16(68, 3);
+    oTiff.fn_entry(70, 0x927C, 7, 16, 110);
+    oTiff.fn_entry(82, 0xA002, 3, 1, 4032);
+    oTiff.fn_entry(94, 0xA003, 4, 1, 3024);
+    std::fill_n(oTiff.vTiff.begin() + 110, 16, 0x5A);
+
+    oTiff.fn_put16(126, 2);
+    oTiff.fn_entry(128, 0x0001, 2, 2, 0);
+    oTiff.vTiff[136] = 'N';
+    oTiff.fn_entry(140, 0x0002, 5, 3, 156);
+    const uint32_t aLatitude[6] = {37, 1, 46, 1, 3000, 100}; // Local Function
+    for (int i = 0; i < 6; ++i)
+    { // Begin for
+        oTiff.fn_put32(156 + i * 4, aLatitude[i]);
+    } // End for(int i = 0; i < 6; ++i)
+    return oTiff;
+} // End Function fn_buildTiff
+
+// Test Case: GPS, MakerNote, orientation and size edits in both byte orders
+TEST(ExifEditorTest, EditsInPlace)
+{ // Begin TEST
+    for (bool bLittle : {true, false})
+    { // Begin for
+        sTiffBuilder oTiff = fn_buildTiff(bLittle); // Local Function
+        const std::vector<unsigned char> vOriginal = oTiff.vTiff; // Local Function
+
+        // The block arrives with the "Exif\0\0" prefix from the container
+        std::vector<unsigned char> vExif = {'E', 'x', 'i', 'f', 0, 0}; // Local Function
+        vExif.insert(vExif.end(), oTiff.vTiff.begin(), oTiff.vTiff.end());
+
+        sExifEditOptions oOptions; // In exif_editor.h
+        oOptions.bStripGps = true;
+        oOptions.bStripMakerNote = true;
+        oOptions.iPixelWidth = 1008;
+        oOptions.iPixelHeight = 70000;
+        ASSERT_TRUE(fn_editExif(vExif, oOptions)); // In exif_editor.cpp
+        ASSERT_EQ(vExif.size(), vOriginal.size() + 6); // In gtest
+        oTiff.vTiff.assign(vExif.begin() + 6, vExif.end());
+
+        // IFD0: GPS pointer gone, orientation reset, Make untouched
+        EXPECT_EQ(oTiff.fn_get16(8), 3u) << bLittle; // In gtest
+        EXPECT_EQ(oTiff.fn_get16(22 + 8), 1u); // In gtest
+        EXPECT_EQ(oTiff.fn_get16(34), 0x8769u); // In gtest
+        EXPECT_EQ(oTiff.fn_get32(46), 0u); // In gtest
+        EXPECT_TRUE(std::equal(vOriginal.begin() + 62, vOriginal.begin() + 68, oTiff.vTiff.begin() + 62)); // In gtest
+
+        // Exif IFD: MakerNote gone, dimensions rewritten (Y widened to LONG)
+        EXPECT_EQ(oTiff.fn_get16(68), 2u); // In gtest
+        EXPECT_EQ(oTiff.fn_get16(70), 0xA002u); // In gtest
+        EXPECT_EQ(oTiff.fn_get16(70 + 8), 1008u); // In gtest
+        EXPECT_EQ(oTiff.fn_get16(82), 0xA003u); // In gtest
+        EXPECT_EQ(oTiff.fn_get16(82 + 2), 4u); // In gtest
+        EXPECT_EQ(oTiff.fn_get32(82 + 8), 70000u); // In gtest
+
+        // MakerNote, GPS IFD and latitude bytes are wiped
+        EXPECT_TRUE(std::all_of(oTiff.vTiff.begin() + 110, oTiff.vTiff.end(),
+                                [](unsigned char uByte) { return uByte == 0; })); // In gtest
+    } // End for(bool bLittle : {true, false})
+} // End TEST(EditsInPlace)
+
+// Test Case: Options off leave the block byte for byte
+TEST(ExifEditorTest, NoEditsKeepBytes)
+{ // Begin TEST
+    sTiffBuilder oTiff = fn_buildTiff(true); // Local Function
+    std::vector<unsigned char> vExif = oTiff.vTiff; // Local Function
+    sExifEditOptions oOptions; // In exif_editor.h
+    oOptions.bResetOrientation = false;
+    EXPECT_FALSE(fn_isExifEditRequested(oOptions)); // In exif_editor.cpp
+    ASSERT_TRUE(fn_editExif(vExif, oOptions)); // In exif_editor.cpp
+    EXPECT_EQ(vExif, oTiff.vTiff); // In gtest
+} // End TEST(NoEditsKeepBytes)
+
+// Test Case: A broken block is untouched, or dropped when GPS must go
+TEST(ExifEditorTest, MalformedBlock)
+{ // Begin TEST
+    sTiffBuilder oTiff = fn_buildTiff(false); // Local Function
+    oTiff.fn_put32(4, 4000); // IFD0 past the end
+    std::vector<unsigned char> vExif = oTiff.vTiff; // Local Function
+
+    sExifEditOptions oOptions; // In exif_editor.h
+    EXPECT_FALSE(fn_editExif(vExif, oOptions)); // In exif_editor.cpp
+    EXPECT_EQ(vExif, oTiff.vTiff); // In gtest
+
+    oOptions.bStripGps = true;
+    EXPECT_FALSE(fn_editExif(vExif, oOptions)); // In exif_editor.cpp
+    EXPECT_TRUE(vExif.empty()); // In gtest
+} // End TEST(MalformedBlock)
+
+// Test Case: Directories come back as host-order entries without sub-IFD pointers
+TEST(ExifEditorTest, ReadsDirectories)
+{ // Begin TEST
+    for (bool bLittle : {true, false})
+    { // Begin for
+        sTiffBuilder oTiff = fn_buildTiff(bLittle); // Local Function
+        std::vector<unsigned char> vExif = {'E', 'x', 'i', 'f', 0, 0}; // Local Function
+        vExif.insert(vExif.end(), oTiff.vTiff.begin(), oTiff.vTiff.end());
+
+        sExifDirectories oDirectories; // In exif_editor.h
+        ASSERT_TRUE(fn_readExifDirectories(vExif.data(), vExif.size(), oDirectories)) << bLittle; // In exif_editor.cpp
+        ASSERT_EQ(oDirectories.vIfd0.size(), 2u); // Make and Orientation
+        EXPECT_EQ(oDirectories.vIfd0[0].uTag, 0x010F); // In gtest
+        EXPECT_EQ(std::string(oDirectories.vIfd0[0].vValue.begin(), oDirectories.vIfd0[0].vValue.end()), std::string("Apple", 6));
+        uint16_t uOrientation = 0; // Local Function
+        std::memcpy(&uOrientation, oDirectories.vIfd0[1].vValue.data(), 2);
+        EXPECT_EQ(uOrientation, 6); // In gtest
+
+        ASSERT_EQ(oDirectories.vExif.size(), 3u); // In gtest
+        EXPECT_EQ(oDirectories.vExif[0].uCount, 16u); // MakerNote bytes copied as-is
+        EXPECT_EQ(oDirectories.vExif[0].vValue, std::vector<unsigned char>(16, 0x5A)); // In gtest
+        uint16_t uPixelX = 0; // Local Function
+        uint32_t uPixelY = 0; // Local Function
+        std::memcpy(&uPixelX, oDirectories.vExif[1].vValue.data(), 2);
+        std::memcpy(&uPixelY, oDirectories.vExif[2].vValue.data(), 4);
+        EXPECT_EQ(uPixelX, 4032); // In gtest
+        EXPECT_EQ(uPixelY, 3024u); // In gtest
+
+        ASSERT_EQ(oDirectories.vGps.size(), 2u); // In gtest
+        ASSERT_EQ(oDirectories.vGps[1].vValue.size(), 24u); // Three RATIONALs
+        uint32_t aLatitude[6]; // Local Function
+        std::memcpy(aLatitude, oDirectories.vGps[1].vValue.data(), sizeof(aLatitude));
+        EXPECT_EQ(aLatitude[0], 37u); // In gtest
+        EXPECT_EQ(aLatitude[4], 3000u); // In gtest
+        EXPECT_EQ(aLatitude[5], 100u); // In gtest
+    } // End for(bool bLittle : {true, false})
+
+    sExifDirectories oDirectories; // In exif_editor.h
+    const unsigned char aShort[] = {'I', 'I', 42, 0}; // Local Function
+    EXPECT_FALSE(fn_readExifDirectories(aShort, sizeof(aShort), oDirectories)); // In exif_editor.cpp
+} // End TEST(ReadsDirectories)
@@ -0,0 +1,150 @@
+// test_heif_container.cpp - Unit tests for the shared HEIF container
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "heif_container.h"
+#include "heic_decoder.h"
+#include "metadata_handler.h"
+#include "file_utils.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const std::string sSAMPLE_HEIF = "test_data/heif-apple-circles.heif";
+
+// Test Case: A missing file reports an error and stays closed
+TEST(HeifContainerTest, MissingFileFails)
+{ // Begin TEST
+    HeifContainer oContainer; // In heif_container.h
+    EXPECT_FALSE(oContainer.fn_openFile("test_data/does_not_exist.heic")); // In heif_container.cpp
+    EXPECT_FALSE(oContainer.fn_isOpen()); // In heif_container.cpp
+    EXPECT_FALSE(oContainer.fn_getLastError().empty()); // In heif_container.cpp
+} // End TEST(MissingFileFails)
+
+#ifdef HAVE_LIBHEIF
+#include <libheif/heif.h>
+
+// Local Function: encode a flat 64x64 8-bit YCbCr image with the given chroma
+// layout to HEIC in memory (empty when no HEVC encoder is available)
+static std::vector<unsigned char> fn_encodeYCbCrHeic(enum heif_chroma eChroma, const char* pszChroma)
+{ // Begin fn_encodeYCbCrHeic
+    std::vector<unsigned char> vOut; // Local Function
+    struct heif_encoder* pEncoder = nullptr; // In heif.h
+    struct heif_context* pContext = heif_context_alloc(); // In heif.h
+    if (heif_context_get_encoder_for_format(pContext, heif_compression_HEVC, &pEncoder).code != heif_error_Ok)
+    { // Begin if
+        heif_context_free(pContext); // In heif.h
+        return vOut;
+    } // End if(no HEVC encoder)
+    heif_encoder_set_parameter_string(pEncoder, "chroma", pszChroma); // In heif.h
+
+    const int iSize = 64; // Local Function
+    struct heif_image* pImage = nullptr; // In heif.h
+    heif_image_create(iSize, iSize, heif_colorspace_YCbCr, eChroma, &pImage); // In heif.h
+    const enum heif_channel aeChannels[3] = {heif_channel_Y, heif_channel_Cb, heif_channel_Cr}; // Local Function
+    for (int c = 0; c < 3; c++)
+    { // Begin for
+        const int iPlaneWidth = (c == 0 || eChroma == heif_chroma_444) ? iSize : iSize / 2; // Local Function
+        const int iPlaneHeight = (c == 0 || eChroma != heif_chroma_420) ? iSize : iSize / 2; // Local Function
+        heif_image_add_plane(pImage, aeChannels[c], iPlaneWidth, iPlaneHeight, 8); // In heif.h
+        int iStride = 0; // Local Function
+        uint8_t* pPlane = heif_image_get_plane(pImage, aeChannels[c], &iStride); // In heif.h
+        for (int y = 0; y < iPlaneHeight; y++)
+        { // Begin for
+            std::memset(pPlane + y * iStride, c == 0 ? 128 : 96 + 32 * c, iPlaneWidth); // In cstring
+        } // End for(int y = 0; y < iPlaneHeight; y++)
+    } // End for(int c = 0; c < 3; c++)
+
+    struct heif_image_handle* pHandle = nullptr; // In heif.h
+    if (heif_context_encode_image(pContext, pImage, pEncoder, nullptr, &pHandle).code == heif_error_Ok)
+    { // Begin if
+        struct heif_writer oWriter = {}; // In heif.h
+        oWriter.writer_api_version = 1;
+        oWriter.write = [](struct heif_context*, const void* pData, size_t stSize, void* pUser) -> struct heif_error
+        {
+            std::vector<unsigned char>* pOut = static_cast<std::vector<unsigned char>*>(pUser); // Local Function
+            const unsigned char* pBytes = static_cast<const unsigned char*>(pData); // Local Function
+            pOut->insert(pOut->end(), pBytes, pBytes + stSize);
+            return heif_error{heif_error_Ok, heif_suberror_Unspecified, ""};
+        };
+        heif_context_write(pContext, &oWriter, &vOut); // In heif.h
+        heif_image_handle_release(pHandle); // In heif.h
+    } // End if(encoded)
+
+    heif_image_release(pImage); // In heif.h
+    heif_encoder_release(pEncoder); // In heif.h
+    heif_context_free(pContext); // In heif.h
+    return vOut;
+} // End Function fn_encodeYCbCrHeic
+
+// Test Case: Only 4:2:0 sources take the planar path; 4:4:4 keeps full chroma via RGB
+TEST(HeifContainerTest, PlanarDecodeOnlyFor420)
+{ // Begin TEST
+    std::vector<unsigned char> v420 = fn_encodeYCbCrHeic(heif_chroma_420, "420"); // Local Function
+    std::vector<unsigned char> v444 = fn_encodeYCbCrHeic(heif_chroma_444, "444"); // Local Function
+    if (v420.empty() || v444.empty())
+    { // Begin if
+        GTEST_SKIP() << "No HEVC encoder available to build test images"; // In gtest
+    } // End if(v420.empty() || v444.empty())
+
+    HeicDecoder oDecoder; // In heic_decoder.h
+    HeifContainer o420; // In heif_container.h
+    ASSERT_TRUE(o420.fn_openMemory(v420.data(), v420.size())); // In heif_container.cpp
+    sPlanarImage oPlanar; // In image_buffer.h
+    EXPECT_TRUE(oDecoder.fn_decodePlanar(o420, oPlanar)); // In heic_decoder.cpp
+    EXPECT_EQ(oPlanar.iWidth, 64); // In gtest
+
+    HeifContainer o444; // In heif_container.h
+    ASSERT_TRUE(o444.fn_openMemory(v444.data(), v444.size())); // In heif_container.cpp
+    sPlanarImage oRejected; // In image_buffer.h
+    EXPECT_FALSE(oDecoder.fn_decodePlanar(o444, oRejected)); // In heic_decoder.cpp
+    EXPECT_TRUE(oRejected.fn_isEmpty()); // In gtest
+
+    oDecodedImage oImage = oDecoder.fn_decodeContainer(o444); // In heic_decoder.cpp
+    EXPECT_TRUE(oImage.sError.empty()); // In gtest
+    EXPECT_EQ(oImage.iWidth, 64); // In gtest
+} // End TEST(PlanarDecodeOnlyFor420)
+
+// Test Case: One parse serves both decoding and metadata extraction
+TEST(HeifContainerTest, DecodeAndMetadataShareOneParse)
+{ // Begin TEST
+    if (!fn_fileExists(sSAMPLE_HEIF))
+    { // Begin if
+        GTEST_SKIP() << "Sample file missing: " << sSAMPLE_HEIF; // In gtest
+    } // End if(!fn_fileExists(sSAMPLE_HEIF))
+
+    HeifContainer oContainer; // In heif_container.h
+    ASSERT_TRUE(oContainer.fn_openFile(sSAMPLE_HEIF)); // In heif_container.cpp
+    EXPECT_GT(oContainer.fn_getWidth(), 0); // In heif_container.cpp
+    EXPECT_GT(oContainer.fn_getHeight(), 0); // In heif_container.cpp
+
+    HeicDecoder oDecoder; // In heic_decoder.h
+    oDecodedImage oImage = oDecoder.fn_decodeContainer(oContainer); // In heic_decoder.cpp
+    EXPECT_TRUE(oImage.sError.empty()); // In gtest
+    EXPECT_EQ(oImage.iWidth, oContainer.fn_getWidth()); // In gtest
+    EXPECT_EQ(oImage.iHeight, oContainer.fn_getHeight()); // In gtest
+
+    // Metadata calls reuse the same context and must not disturb it
+    MetadataHandler oMetadata; // In metadata_handler.h
+    oMetadata.extractExif(oContainer); // In metadata_handler.cpp
+    oMetadata.extractXmp(oContainer); // In metadata_handler.cpp
+    oMetadata.extractIccProfile(oContainer); // In metadata_handler.cpp
+    EXPECT_TRUE(oContainer.fn_isOpen()); // In heif_container.cpp
+} // End TEST(DecodeAndMetadataShareOneParse)
+
+// Test Case: Memory open parses the caller's buffer in place
+TEST(HeifContainerTest, OpenMemoryWithoutCopy)
+{ // Begin TEST
+    std::vector<unsigned char> vData = fn_readBinaryFile(sSAMPLE_HEIF); // In file_utils.cpp
+    if (vData.empty())
+    { // Begin if
+        GTEST_SKIP() << "Sample file missing: " << sSAMPLE_HEIF; // In gtest
+    } // End if(vData.empty())
+
+    HeifContainer oContainer; // In heif_container.h
+    ASSERT_TRUE(oContainer.fn_openMemory(vData.data(), vData.size())); // In heif_container.cpp
+    EXPECT_EQ(oContainer.fn_getFileData(), vData.data()); // In gtest
+    EXPECT_GT(oContainer.fn_getWidth(), 0); // In heif_container.cpp
+} // End TEST(OpenMemoryWithoutCopy)
+#endif
@@ -0,0 +1,211 @@
+// test_heif_probe.cpp - Unit tests for the header-only HEIF probe
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "heif_probe.h"
+#include "file_utils.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+static const std::string sSAMPLE_HEIF = "test_data/heif-apple-circles.heif";
+
+typedef std::vector<unsigned char> tBytes;
+
+// Append a big-endian value of iBytes bytes
+static void fn_put(tBytes& vOut, uint64_t ullValue, int iBytes)
+{ // Begin fn_put
+    for (int i = iBytes - 1; i >= 0; i--)
+    { // Begin for
+        vOut.push_back(static_cast<unsigned char>(ullValue >> (i * 8)));
+    } // End for(int i = iBytes - 1; i >= 0; i--)
+} // End Function fn_put
+
+// Wrap a body in a box (bFull adds a zero version/flags word)
+static tBytes fn_box(const char* pType, const tBytes& vBody, bool bFull = false)
+{ // Begin fn_box
+    tBytes vBox; // Local Function
+    fn_put(vBox, 8 + (bFull ? 4 : 0) + vBody.size(), 4);
+    vBox.insert(vBox.end(), pType, pType + 4);
+    if (bFull)
+    { // Begin if
+        fn_put(vBox, 0, 4);
+    } // End if(bFull)
+    vBox.insert(vBox.end(), vBody.begin(), vBody.end());
+    return vBox;
+} // End Function fn_box
+
+static tBytes fn_join(std::initializer_list<tBytes> lParts)
+{ // Begin fn_join
+    tBytes vOut; // Local Function
+    for (const tBytes& vPart : lParts)
+    { // Begin for
+        vOut.insert(vOut.end(), vPart.begin(), vPart.end());
+    } // End for(const tBytes& vPart : lParts)
+    return vOut;
+} // End Function fn_join
+
+static tBytes fn_infe(uint16_t uId, const char* pType)
+{ // Begin fn_infe
+    tBytes vBody = {0x02, 0, 0, 0}; // Local Function, version 2
+    fn_put(vBody, uId, 2);
+    fn_put(vBody, 0, 2);
+    vBody.insert(vBody.end(), pType, pType + 4);
+    vBody.push_back(0);
+    return fn_box("infe", vBody);
+} // End Function fn_infe
+
+static tBytes fn_ispe(uint32_t uWidth, uint32_t uHeight)
+{ // Begin fn_ispe
+    tBytes vBody; // Local Function
+    fn_put(vBody, uWidth, 4);
+    fn_put(vBody, uHeight, 4);
+    return fn_box("ispe", vBody, true);
+} // End Function fn_ispe
+
+static tBytes fn_ref(const char* pType, uint16_t uFrom, std::vector<uint16_t> vuTo)
+{ // Begin fn_ref
+    tBytes vBody; // Local Function
+    fn_put(vBody, uFrom, 2);
+    fn_put(vBody, vuTo.size(), 2);
+    for (uint16_t uTo : vuTo)
+    { // Begin for
+        fn_put(vBody, uTo, 2);
+    } // End for(uint16_t uTo : vuTo)
+    return fn_box(pType, vBody);
+} // End Function fn_ref
+
+// Build a 2x2 grid (500x400 from 256x256 tiles) rotated 90 degrees, with a
+// thumbnail, an alpha plane and EXIF orientation 6 stored in mdat
+static tBytes fn_buildGridHeif()
+{ // Begin fn_buildGridHeif
+    // Items: 1 grid, 2-5 tiles, 6 thumbnail, 7 alpha, 8 Exif
+    tBytes vIinf = {0, 8}; // Local Function, entry count
+    vIinf = fn_join({vIinf, fn_infe(1, "grid"), fn_infe(2, "hvc1"), fn_infe(3, "hvc1"), fn_infe(4, "hvc1"),
+                     fn_infe(5, "hvc1"), fn_infe(6, "hvc1"), fn_infe(7, "hvc1"), fn_infe(8, "Exif")});
+
+    tBytes vAuxc = fn_box("auxC", tBytes({'u', 'r', 'n', ':', 'm', 'p', 'e', 'g', ':', 'h', 'e', 'v', 'c', ':',
+                                          '2', '0', '1', '5', ':', 'a', 'u', 'x', 'i', 'd', ':', '1', 0}), true);
+    tBytes vHvcc(23, 0); // Local Function
+    vHvcc[16] = 0xFD;   // chroma_format_idc 1
+    vHvcc[17] = 0xFA;   // bit_depth_luma_minus8 2
+    tBytes vIpco = fn_join({fn_ispe(500, 400),                 // 1
+                            fn_ispe(256, 256),                 // 2
+                            fn_box("hvcC", vHvcc),             // 3
+                            fn_box("irot", tBytes({1})),       // 4
+                            fn_ispe(160, 128),                 // 5
+                            vAuxc});                           // 6
+
+    tBytes vIpma; // Local Function
+    fn_put(vIpma, 5, 4);
+    vIpma = fn_join({vIpma, tBytes({0, 1, 2, 0x81, 0x84}), tBytes({0, 2, 2, 0x82, 0x83}),
+                     tBytes({0, 6, 2, 0x85, 0x83}), tBytes({0, 7, 2, 0x82, 0x86}), tBytes({0, 3, 1, 0x82})});
+
+    tBytes vIref = fn_join({fn_ref("dimg", 1, {2, 3, 4, 5}), fn_ref("thmb", 6, {1}),
+                            fn_ref("auxl", 7, {1}), fn_ref("cdsc", 8, {1})});
+
+    tBytes vGrid = {0, 0, 1, 1, 0x01, 0xF4, 0x01, 0x90}; // Local Function
+    tBytes vExif = {0, 0, 0, 6, 'E', 'x', 'i', 'f', 0, 0,
+                    'M', 'M', 0, 42, 0, 0, 0, 8,
+                    0, 1, 0x01, 0x12, 0, 3, 0, 0, 0, 1, 0, 6, 0, 0,
+                    0, 0, 0, 0}; // Local Function
+
+    // iloc v1: grid in idat, Exif at an absolute file offset patched below
+    tBytes vIloc = {0x44, 0x00}; // Local Function, 4-byte offset/length
+    fn_put(vIloc, 2, 2);
+    fn_put(vIloc, 1, 2); fn_put(vIloc, 1, 2); fn_put(vIloc, 0, 2); fn_put(vIloc, 1, 2);
+    fn_put(vIloc, 0, 4); fn_put(vIloc, vGrid.size(), 4);
+    fn_put(vIloc, 8, 2); fn_put(vIloc, 0, 2); fn_put(vIloc, 0, 2); fn_put(vIloc, 1, 2);
+    size_t stExifOffsetAt = vIloc.size(); // Local Function
+    fn_put(vIloc, 0, 4); fn_put(vIloc, vExif.size(), 4);
+    tBytes vIlocBox = fn_box("iloc", fn_join({tBytes({1, 0, 0, 0}), vIloc})); // Local Function
+
+    tBytes vHdlr(4, 0); // Local Function
+    vHdlr.insert(vHdlr.end(), {'p', 'i', 'c', 't', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0});
+    tBytes vPitm; // Local Function
+    fn_put(vPitm, 1, 2);
+
+    tBytes vMeta = fn_box("meta", fn_join({fn_box("hdlr", vHdlr, true), fn_box("pitm", vPitm, true),
+                                           vIlocBox, fn_box("iinf", vIinf, true), fn_box("iref", vIref, true),
+                                           fn_box("iprp", fn_join({fn_box("ipco", vIpco), fn_box("ipma", vIpma, true)})),
+                                           fn_box("idat", vGrid)}), true);
+    tBytes vFtyp = fn_box("ftyp", tBytes({'h', 'e', 'i', 'c', 0, 0, 0, 0, 'm', 'i', 'f', '1', 'h', 'e', 'i', 'c'}));
+
+    tBytes vFile = fn_join({vFtyp, vMeta, fn_box("mdat", vExif)}); // Local Function
+
+    // Patch the Exif extent offset (iloc body sits after the meta and iloc headers)
+    size_t stIlocBody = vFtyp.size() + 12 + fn_box("hdlr", vHdlr, true).size() + fn_box("pitm", vPitm, true).size() + 8 + 4;
+    size_t stExifData = vFile.size() - vExif.size(); // Local Function
+    for (int i = 0; i < 4; i++)
+    { // Begin for
+        vFile[stIlocBody + stExifOffsetAt + i] = static_cast<unsigned char>(stExifData >> ((3 - i) * 8));
+    } // End for(int i = 0; i < 4; i++)
+    return vFile;
+} // End Function fn_buildGridHeif
+
+// Test Case: The sample file's size and codec come from ispe and hvcC
+TEST(HeifProbeTest, ProbesSampleFile)
+{ // Begin TEST
+    if (!fn_fileExists(sSAMPLE_HEIF))
+    { // Begin if
+        GTEST_SKIP() << "Sample file missing: " << sSAMPLE_HEIF; // In gtest
+    } // End if(!fn_fileExists(sSAMPLE_HEIF))
+
+    sHeifProbe oProbe; // In heif_probe.h
+    std::string sError; // Local Function
+    ASSERT_TRUE(fn_probeHeifFile(sSAMPLE_HEIF, oProbe, sError)) << sError; // In heif_probe.cpp
+    EXPECT_EQ(oProbe.sBrand, "heic"); // In gtest
+    EXPECT_EQ(oProbe.sCodec, "hvc1"); // In gtest
+    EXPECT_EQ(oProbe.iWidth, 2800); // In gtest
+    EXPECT_EQ(oProbe.iHeight, 1800); // In gtest
+    EXPECT_EQ(oProbe.iBitDepth, 8); // In gtest
+    EXPECT_EQ(oProbe.iImageCount, 1); // In gtest
+    EXPECT_FALSE(oProbe.bIsGrid); // In gtest
+    EXPECT_EQ(fn_getProbeDecodeBytes(oProbe), 2800ull * 1800 * 3); // In heif_probe.cpp
+} // End TEST(ProbesSampleFile)
+
+// Test Case: Grid layout, rotation, thumbnail, alpha and EXIF orientation
+TEST(HeifProbeTest, ProbesGridLayout)
+{ // Begin TEST
+    tBytes vFile = fn_buildGridHeif(); // Local Function
+    sHeifProbe oProbe; // In heif_probe.h
+    std::string sError; // Local Function
+    ASSERT_TRUE(fn_probeHeifMemory(vFile.data(), vFile.size(), oProbe, sError)) << sError; // In heif_probe.cpp
+
+    EXPECT_EQ(oProbe.sCodec, "grid"); // In gtest
+    EXPECT_TRUE(oProbe.bIsGrid); // In gtest
+    EXPECT_EQ(oProbe.iGridRows, 2); // In gtest
+    EXPECT_EQ(oProbe.iGridColumns, 2); // In gtest
+    EXPECT_EQ(oProbe.iTileWidth, 256); // In gtest
+    EXPECT_EQ(oProbe.iWidth, 500); // In gtest
+    EXPECT_EQ(oProbe.iDisplayWidth, 400); // In gtest
+    EXPECT_EQ(oProbe.iRotation, 90); // In gtest
+    EXPECT_EQ(oProbe.iBitDepth, 10); // In gtest
+    EXPECT_TRUE(oProbe.bHasAlpha); // In gtest
+    EXPECT_EQ(oProbe.iThumbnailCount, 1); // In gtest
+    EXPECT_EQ(oProbe.iThumbnailWidth, 160); // In gtest
+    EXPECT_EQ(oProbe.iImageCount, 1); // In gtest
+    EXPECT_TRUE(oProbe.bHasExif); // In gtest
+    EXPECT_EQ(oProbe.iExifOrientation, 6); // In gtest
+
+    std::string sJson = fn_probeToJson("a\"b.heic", oProbe); // In heif_probe.cpp
+    EXPECT_NE(sJson.find("\"file\":\"a\\\"b.heic\""), std::string::npos); // In gtest
+    EXPECT_NE(sJson.find("\"grid\":{\"rows\":2"), std::string::npos); // In gtest
+} // End TEST(ProbesGridLayout)
+
+// Test Case: Non-HEIF and truncated input fail without crashing
+TEST(HeifProbeTest, RejectsBadInput)
+{ // Begin TEST
+    sHeifProbe oProbe; // In heif_probe.h
+    std::string sError; // Local Function
+    tBytes vJunk(64, 0x41); // Local Function
+    EXPECT_FALSE(fn_probeHeifMemory(vJunk.data(), vJunk.size(), oProbe, sError)); // In heif_probe.cpp
+    EXPECT_FALSE(sError.empty()); // In gtest
+
+    tBytes vFile = fn_buildGridHeif(); // Local Function
+    for (size_t stCut = 16; stCut < vFile.size(); stCut += 7)
+    { // Begin for
+        fn_probeHeifMemory(vFile.data(), stCut, oProbe, sError); // In heif_probe.cpp
+    } // End for(size_t stCut = 16; stCut < vFile.size(); stCut += 7)
+} // End TEST(RejectsBadInput)
@@ -0,0 +1,268 @@
+// test_image_buffer.cpp - Unit tests for the shared pixel buffer
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "image_buffer.h"
+#include "format_encoder.h"
+#include "file_utils.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#ifdef HAVE_JPEG
+#include <jpeglib.h>
+#endif
+
+// Test Case: Allocated buffers are tightly packed
+TEST(ImageBufferTest, AllocatePacked)
+{ // Begin TEST
+    ImageBuffer oBuffer = ImageBuffer::fn_allocate(7, 5, 3); // In image_buffer.cpp
+    ASSERT_FALSE(oBuffer.fn_isEmpty()); // In gtest
+    EXPECT_EQ(oBuffer.fn_getStride(), 21u); // In gtest
+    EXPECT_TRUE(oBuffer.fn_isContiguous()); // In gtest
+    EXPECT_EQ(oBuffer.fn_getRow(2), oBuffer.fn_getData() + 42); // In gtest
+
+    EXPECT_TRUE(ImageBuffer::fn_allocate(0, 5, 3).fn_isEmpty()); // In image_buffer.cpp
+} // End TEST(AllocatePacked)
+
+// Test Case: Wrapped memory is released only after the last reference
+TEST(ImageBufferTest, WrapKeepsOwnerAlive)
+{ // Begin TEST
+    auto pStorage = std::make_shared<std::vector<unsigned char>>(4 * 32, 0); // Local Function
+    std::weak_ptr<std::vector<unsigned char>> pWatch = pStorage; // Local Function
+
+    ImageBuffer oCopy; // In image_buffer.h
+    {
+        ImageBuffer oBuffer = ImageBuffer::fn_wrap(pStorage->data(), 8, 4, 32, 3, 8, pStorage); // In image_buffer.cpp
+        pStorage.reset();
+        EXPECT_FALSE(oBuffer.fn_isContiguous()); // In gtest
+        oCopy = oBuffer;
+    }
+    EXPECT_FALSE(pWatch.expired()); // In gtest
+
+    ImageBuffer oMoved = std::move(oCopy); // In image_buffer.cpp
+    EXPECT_TRUE(oCopy.fn_isEmpty()); // In gtest
+    EXPECT_EQ(oMoved.fn_getStride(), 32u); // In gtest
+
+    oMoved.fn_reset(); // In image_buffer.cpp
+    EXPECT_TRUE(pWatch.expired()); // In gtest
+} // End TEST(WrapKeepsOwnerAlive)
+
+// Test Case: Encoders honour a padded row stride
+TEST(ImageBufferTest, EncodeWithPaddedStride)
+{ // Begin TEST
+    std::vector<unsigned char> vStorage(16 * 8, 200); // Local Function
+    auto pOwner = std::shared_ptr<void>(); // Local Function
+    ImageBuffer oBuffer = ImageBuffer::fn_wrap(vStorage.data(), 4, 8, 16, 3, 8, pOwner); // In image_buffer.cpp
+
+    sImageData oImageData = fn_makeImageData(oBuffer); // In format_encoder.cpp
+    EXPECT_EQ(fn_getImageStride(oImageData), 16u); // In format_encoder.cpp
+
+    FormatEncoder oEncoder; // In format_encoder.h
+    sEncodeOptions oOptions; // In format_encoder.h
+    oOptions.sFormat = "bmp";
+    std::vector<unsigned char> vOutput; // Local Function
+    ASSERT_TRUE(oEncoder.fn_encodeToMemory(oImageData, oOptions, vOutput)); // In format_encoder.cpp
+    ASSERT_GT(vOutput.size(), 54u); // In gtest
+    EXPECT_EQ(vOutput[0], 'B'); // In gtest
+    EXPECT_EQ(vOutput[54], 200); // In gtest
+} // End TEST(EncodeWithPaddedStride)
+
+// Test Case: Encoding a frame band by band gives the same file as one shot
+TEST(ImageBufferTest, StreamMatchesFullFrame)
+{ // Begin TEST
+    ImageBuffer oFrame = ImageBuffer::fn_allocate(40, 30, 3); // In image_buffer.cpp
+    ASSERT_FALSE(oFrame.fn_isEmpty()); // In gtest
+    for (int y = 0; y < 30; y++)
+    { // Begin for
+        for (int x = 0; x < 120; x++)
+        { // Begin for
+            oFrame.fn_getRow(y)[x] = static_cast<unsigned char>(x * 2 + y * 3);
+        } // End for(int x = 0; x < 120; x++)
+    } // End for(int y = 0; y < 30; y++)
+
+    sImageStream oStream; // In image_buffer.h
+    oStream.iWidth = 40;
+    oStream.iHeight = 30;
+    oStream.iChannels = 3;
+    int iNextRow = 0; // Local Function
+    oStream.fnNextBand = [&](ImageBuffer& oBand)
+    { // Begin lambda
+        // 8-row bands; the last one overhangs the image like an edge tile
+        oBand = ImageBuffer::fn_wrap(oFrame.fn_getRow(iNextRow), 40, 8, oFrame.fn_getStride(), 3, 8, nullptr);
+        iNextRow += 8;
+        return true;
+    }; // End lambda
+
+    const char* apFormats[] = {"png", "jpg"}; // Local Function
+    for (const char* pFormat : apFormats)
+    { // Begin for
+        std::string sWhole = std::string("stream_whole.") + pFormat; // Local Function
+        std::string sBands = std::string("stream_bands.") + pFormat; // Local Function
+        FormatEncoder oEncoder; // In format_encoder.h
+        sEncodeOptions oOptions; // In format_encoder.h
+        oOptions.sFormat = pFormat;
+        iNextRow = 0;
+
+        ASSERT_TRUE(oEncoder.fn_encodeImage(fn_makeImageData(oFrame), sWhole, oOptions)); // In format_encoder.cpp
+        ASSERT_TRUE(oEncoder.fn_encodeStream(oStream, sBands, oOptions)); // In format_encoder.cpp
+        EXPECT_EQ(fn_readBinaryFile(sWhole), fn_readBinaryFile(sBands)); // In file_utils.cpp
+
+        remove(sWhole.c_str()); // In cstdio
+        remove(sBands.c_str()); // In cstdio
+    } // End for(const char* pFormat : apFormats)
+} // End TEST(StreamMatchesFullFrame)
+
+// Test Case: Preview shrink averages source boxes and shares fitting images
+TEST(ImageBufferTest, ShrinkToFit)
+{ // Begin TEST
+    ImageBuffer oSource = ImageBuffer::fn_allocate(8, 4, 1); // In image_buffer.cpp
+    for (int iRow = 0; iRow < 4; ++iRow)
+    { // Begin for
+        for (int iCol = 0; iCol < 8; ++iCol)
+        { // Begin for
+            oSource.fn_getRow(iRow)[iCol] = static_cast<unsigned char>(iRow * 8 + iCol);
+        } // End for(int iCol = 0; iCol < 8; ++iCol)
+    } // End for(int iRow = 0; iRow < 4; ++iRow)
+
+    ImageBuffer oSmall = fn_shrinkToFit(oSource, 4); // In image_buffer.cpp
+    ASSERT_EQ(oSmall.fn_getWidth(), 4); // In gtest
+    ASSERT_EQ(oSmall.fn_getHeight(), 2); // In gtest
+    // Box (0,0): 0, 1, 8, 9 -> 4.5 rounds to 5
+    EXPECT_EQ(oSmall.fn_getRow(0)[0], 5); // In gtest
+    // Box (1,3): 22, 23, 30, 31 -> 26.5 rounds to 27
+    EXPECT_EQ(oSmall.fn_getRow(1)[3], 27); // In gtest
+
+    ImageBuffer oSame = fn_shrinkToFit(oSource, 8); // In image_buffer.cpp
+    EXPECT_EQ(oSame.fn_getData(), oSource.fn_getData()); // In gtest
+} // End TEST(ShrinkToFit)
+
+#ifdef HAVE_JPEG
+// Decode a JPEG file to interleaved RGB
+static std::vector<unsigned char> fn_decodeJpegFile(const std::string& sPath, int& iWidth, int& iHeight)
+{ // Begin fn_decodeJpegFile
+    std::vector<unsigned char> vPixels; // Local Function
+    FILE* fp = fopen(sPath.c_str(), "rb"); // In cstdio
+    if (!fp)
+    { // Begin if
+        return vPixels;
+    } // End if(!fp)
+
+    struct jpeg_decompress_struct sDInfo; // In jpeglib.h
+    struct jpeg_error_mgr sJErr; // In jpeglib.h
+    sDInfo.err = jpeg_std_error(&sJErr);
+    jpeg_create_decompress(&sDInfo);
+    jpeg_stdio_src(&sDInfo, fp);
+    jpeg_read_header(&sDInfo, TRUE);
+    sDInfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&sDInfo);
+
+    iWidth = static_cast<int>(sDInfo.output_width);
+    iHeight = static_cast<int>(sDInfo.output_height);
+    vPixels.resize(static_cast<size_t>(iWidth) * iHeight * 3);
+    while (sDInfo.output_scanline < sDInfo.output_height)
+    { // Begin while
+        JSAMPROW pRow = &vPixels[static_cast<size_t>(sDInfo.output_scanline) * iWidth * 3]; // Local Function
+        jpeg_read_scanlines(&sDInfo, &pRow, 1);
+    } // End while(rows remain)
+
+    jpeg_finish_decompress(&sDInfo);
+    jpeg_destroy_decompress(&sDInfo);
+    fclose(fp); // In cstdio
+    return vPixels;
+} // End Function fn_decodeJpegFile
+
+// Test Case: JPEG from YCbCr planes looks like JPEG from RGB, in both ranges
+TEST(ImageBufferTest, PlanarJpegMatchesRgb)
+{ // Begin TEST
+    const int iWidth = 45; // Odd sizes exercise the padded edge blocks
+    const int iHeight = 29;
+    ImageBuffer oRgb = ImageBuffer::fn_allocate(iWidth, iHeight, 3); // In image_buffer.cpp
+    std::vector<unsigned char> vLuma(iWidth * iHeight); // Local Function
+    for (int y = 0; y < iHeight; ++y)
+    { // Begin for
+        for (int x = 0; x < iWidth; ++x)
+        { // Begin for
+            unsigned char* pPixel = oRgb.fn_getRow(y) + x * 3; // Local Function
+            pPixel[0] = static_cast<unsigned char>(x * 5);
+            pPixel[1] = static_cast<unsigned char>(y * 8);
+            pPixel[2] = 90;
+            vLuma[y * iWidth + x] = static_cast<unsigned char>(std::lround(0.299 * pPixel[0] + 0.587 * pPixel[1] + 0.114 * pPixel[2]));
+        } // End for(int x = 0; x < iWidth; ++x)
+    } // End for(int y = 0; y < iHeight; ++y)
+
+    // JFIF chroma from 2x2 averages of RGB
+    const int iChromaWidth = (iWidth + 1) / 2; // Local Function
+    const int iChromaHeight = (iHeight + 1) / 2; // Local Function
+    std::vector<unsigned char> vCb(iChromaWidth * iChromaHeight); // Local Function
+    std::vector<unsigned char> vCr(iChromaWidth * iChromaHeight); // Local Function
+    for (int y = 0; y < iChromaHeight; ++y)
+    { // Begin for
+        for (int x = 0; x < iChromaWidth; ++x)
+        { // Begin for
+            double adSum[3] = {0, 0, 0}; // Local Function
+            int iCount = 0; // Local Function
+            for (int dy = 0; dy < 2 && y * 2 + dy < iHeight; ++dy)
+            { // Begin for
+                for (int dx = 0; dx < 2 && x * 2 + dx < iWidth; ++dx)
+                { // Begin for
+                    const unsigned char* pPixel = oRgb.fn_getRow(y * 2 + dy) + (x * 2 + dx) * 3; // Local Function
+                    for (int c = 0; c < 3; ++c) adSum[c] += pPixel[c];
+                    ++iCount;
+                } // End for(dx)
+            } // End for(dy)
+            double dR = adSum[0] / iCount, dG = adSum[1] / iCount, dB = adSum[2] / iCount; // Local Function
+            vCb[y * iChromaWidth + x] = static_cast<unsigned char>(std::lround(128 - 0.168736 * dR - 0.331264 * dG + 0.5 * dB));
+            vCr[y * iChromaWidth + x] = static_cast<unsigned char>(std::lround(128 + 0.5 * dR - 0.418688 * dG - 0.081312 * dB));
+        } // End for(int x = 0; x < iChromaWidth; ++x)
+    } // End for(int y = 0; y < iChromaHeight; ++y)
+
+    FormatEncoder oEncoder; // In format_encoder.h
+    sEncodeOptions oOptions; // In format_encoder.h
+    oOptions.sFormat = "jpg";
+    oOptions.iQuality = 95;
+    ASSERT_TRUE(oEncoder.fn_supportsPlanar(oOptions)); // In format_encoder.cpp
+    ASSERT_TRUE(oEncoder.fn_encodeImage(fn_makeImageData(oRgb), "planar_rgb.jpg", oOptions)); // In format_encoder.cpp
+    int iRefWidth = 0, iRefHeight = 0; // Local Function
+    std::vector<unsigned char> vReference = fn_decodeJpegFile("planar_rgb.jpg", iRefWidth, iRefHeight); // Local Function
+
+    for (bool bFullRange : {true, false})
+    { // Begin for
+        std::vector<unsigned char> avPlanes[3] = {vLuma, vCb, vCr}; // Local Function
+        if (!bFullRange)
+        { // Begin if
+            // Squeeze into video range as a limited-range HEVC stream would be
+            for (unsigned char& uSample : avPlanes[0]) uSample = static_cast<unsigned char>(std::lround(16 + uSample * 219.0 / 255.0));
+            for (int c = 1; c < 3; ++c)
+                for (unsigned char& uSample : avPlanes[c]) uSample = static_cast<unsigned char>(std::lround(128 + (uSample - 128) * 224.0 / 255.0));
+        } // End if(!bFullRange)
+
+        sPlanarImage oPlanar; // In image_buffer.h
+        oPlanar.iWidth = iWidth;
+        oPlanar.iHeight = iHeight;
+        oPlanar.bFullRange = bFullRange;
+        for (int c = 0; c < 3; ++c)
+        { // Begin for
+            oPlanar.apPlane[c] = avPlanes[c].data();
+            oPlanar.astStride[c] = c == 0 ? iWidth : iChromaWidth;
+        } // End for(int c = 0; c < 3; ++c)
+
+        ASSERT_TRUE(oEncoder.fn_encodePlanar(oPlanar, "planar_yuv.jpg", oOptions)); // In format_encoder.cpp
+        int iOutWidth = 0, iOutHeight = 0; // Local Function
+        std::vector<unsigned char> vDecoded = fn_decodeJpegFile("planar_yuv.jpg", iOutWidth, iOutHeight); // Local Function
+        ASSERT_EQ(iOutWidth, iWidth); // In gtest
+        ASSERT_EQ(iOutHeight, iHeight); // In gtest
+        ASSERT_EQ(vDecoded.size(), vReference.size()); // In gtest
+
+        double dError = 0; // Local Function
+        for (size_t i = 0; i < vDecoded.size(); ++i) dError += std::abs(vDecoded[i] - vReference[i]);
+        EXPECT_LT(dError / vDecoded.size(), 3.0) << (bFullRange ? "full range" : "limited range"); // In gtest
+    } // End for(bool bFullRange : {true, false})
+
+    remove("planar_rgb.jpg"); // In cstdio
+    remove("planar_yuv.jpg"); // In cstdio
+} // End TEST(PlanarJpegMatchesRgb)
+#endif
@@ -0,0 +1,126 @@
+// test_image_resizer.cpp - Unit tests for the separable resampler
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "image_resizer.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+
+// Fill an 8-bit image with a repeatable pattern
+static ImageBuffer fn_makePattern(int iWidth, int iHeight, int iChannels)
+{ // Begin fn_makePattern
+    ImageBuffer oImage = ImageBuffer::fn_allocate(iWidth, iHeight, iChannels); // In image_buffer.cpp
+    unsigned int uState = 12345u; // Local Function
+    for (int iRow = 0; iRow < iHeight; ++iRow)
+    { // Begin for
+        unsigned char* pRow = oImage.fn_getRow(iRow); // In image_buffer.h
+        for (size_t i = 0; i < oImage.fn_getRowBytes(); ++i)
+        { // Begin for
+            uState = uState * 1103515245u + 12345u;
+            pRow[i] = static_cast<unsigned char>(uState >> 16);
+        } // End for(size_t i = 0; i < oImage.fn_getRowBytes(); ++i)
+    } // End for(int iRow = 0; iRow < iHeight; ++iRow)
+    return oImage;
+} // End Function fn_makePattern
+
+static bool fn_samePixels(const ImageBuffer& oLeft, const ImageBuffer& oRight)
+{ // Begin fn_samePixels
+    if (oLeft.fn_getWidth() != oRight.fn_getWidth() || oLeft.fn_getHeight() != oRight.fn_getHeight())
+    { // Begin if
+        return false;
+    } // End if(size differs)
+    for (int iRow = 0; iRow < oLeft.fn_getHeight(); ++iRow)
+    { // Begin for
+        if (std::memcmp(oLeft.fn_getRow(iRow), oRight.fn_getRow(iRow), oLeft.fn_getRowBytes()) != 0)
+        { // Begin if
+            return false;
+        } // End if(row differs)
+    } // End for(int iRow = 0; iRow < oLeft.fn_getHeight(); ++iRow)
+    return true;
+} // End Function fn_samePixels
+
+// Test Case: Scale is applied first, then the fit-within box
+TEST(ImageResizerTest, TargetSize)
+{ // Begin TEST
+    sResizeOptions oOptions; // In image_resizer.h
+    int iWidth = 0; // Local Function
+    int iHeight = 0; // Local Function
+    EXPECT_FALSE(fn_getResizeTarget(4000, 3000, oOptions, iWidth, iHeight)); // In image_resizer.cpp
+
+    oOptions.fScale = 0.5f;
+    ASSERT_TRUE(fn_getResizeTarget(4000, 3000, oOptions, iWidth, iHeight)); // In image_resizer.cpp
+    EXPECT_EQ(iWidth, 2000); // In gtest
+    EXPECT_EQ(iHeight, 1500); // In gtest
+
+    oOptions.iFitWidth = 800;
+    oOptions.iFitHeight = 800;
+    ASSERT_TRUE(fn_getResizeTarget(4000, 3000, oOptions, iWidth, iHeight)); // In image_resizer.cpp
+    EXPECT_EQ(iWidth, 800); // In gtest
+    EXPECT_EQ(iHeight, 600); // In gtest
+
+    // The box only shrinks
+    oOptions.fScale = 1.0f;
+    EXPECT_FALSE(fn_getResizeTarget(640, 480, oOptions, iWidth, iHeight)); // In image_resizer.cpp
+} // End TEST(TargetSize)
+
+// Test Case: Normalised weights keep a flat image flat
+TEST(ImageResizerTest, FlatImageStaysFlat)
+{ // Begin TEST
+    ImageBuffer oFlat = ImageBuffer::fn_allocate(53, 31, 3); // In image_buffer.cpp
+    for (int iRow = 0; iRow < 31; ++iRow)
+    { // Begin for
+        std::memset(oFlat.fn_getRow(iRow), 200, oFlat.fn_getRowBytes()); // In cstring
+    } // End for(int iRow = 0; iRow < 31; ++iRow)
+
+    const eResizeFilter aFilters[] = {eResizeFilter::Box, eResizeFilter::Bilinear, eResizeFilter::Lanczos3}; // Local Function
+    for (eResizeFilter eFilter : aFilters)
+    { // Begin for
+        for (int iSize : {7, 120})
+        { // Begin for
+            ImageBuffer oOut = fn_resizeImage(oFlat, iSize, iSize, eFilter); // In image_resizer.cpp
+            ASSERT_FALSE(oOut.fn_isEmpty()); // In gtest
+            for (int iRow = 0; iRow < iSize; ++iRow)
+            { // Begin for
+                for (size_t i = 0; i < oOut.fn_getRowBytes(); ++i)
+                { // Begin for
+                    ASSERT_EQ(oOut.fn_getRow(iRow)[i], 200) << fn_getResizeFilterName(eFilter) << " " << iSize; // In gtest
+                } // End for(size_t i = 0; i < oOut.fn_getRowBytes(); ++i)
+            } // End for(int iRow = 0; iRow < iSize; ++iRow)
+        } // End for(int iSize : {7, 120})
+    } // End for(eResizeFilter eFilter : aFilters)
+} // End TEST(FlatImageStaysFlat)
+
+// Test Case: SIMD kernels and threaded bands match the scalar result exactly
+TEST(ImageResizerTest, KernelsMatchScalar)
+{ // Begin TEST
+    std::string sDefault = fn_getResizeKernel(); // In image_resizer.cpp
+    const char* apKernels[] = {"avx2", "sse4.1", "neon"}; // Local Function
+
+    for (int iChannels = 1; iChannels <= 4; ++iChannels)
+    { // Begin for
+        ImageBuffer oSource = fn_makePattern(97, 61, iChannels); // Local Function
+        for (int iSize : {23, 150})
+        { // Begin for
+            ASSERT_TRUE(fn_setResizeKernel("scalar")); // In image_resizer.cpp
+            ImageBuffer oExpected = fn_resizeImage(oSource, iSize, iSize / 2, eResizeFilter::Lanczos3); // In image_resizer.cpp
+            ASSERT_FALSE(oExpected.fn_isEmpty()); // In gtest
+
+            ImageBuffer oThreaded = fn_resizeImage(oSource, iSize, iSize / 2, eResizeFilter::Lanczos3, 4); // In image_resizer.cpp
+            EXPECT_TRUE(fn_samePixels(oExpected, oThreaded)) << "threads, channels " << iChannels; // In gtest
+
+            for (const char* pKernel : apKernels)
+            { // Begin for
+                if (!fn_setResizeKernel(pKernel))
+                { // Begin if
+                    continue; // Not available on this machine
+                } // End if(!fn_setResizeKernel(pKernel))
+                ImageBuffer oActual = fn_resizeImage(oSource, iSize, iSize / 2, eResizeFilter::Lanczos3); // In image_resizer.cpp
+                EXPECT_TRUE(fn_samePixels(oExpected, oActual)) << pKernel << ", channels " << iChannels; // In gtest
+            } // End for(const char* pKernel : apKernels)
+        } // End for(int iSize : {23, 150})
+    } // End for(int iChannels = 1; iChannels <= 4; ++iChannels)
+
+    EXPECT_TRUE(fn_setResizeKernel(sDefault)); // In image_resizer.cpp
+    EXPECT_FALSE(fn_setResizeKernel("mmx")); // In image_resizer.cpp
+} // End TEST(KernelsMatchScalar)
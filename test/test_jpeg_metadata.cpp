@@ -0,0 +1,131 @@
+// test_jpeg_metadata.cpp - Unit tests for metadata written by the JPEG encoder
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "format_encoder.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_JPEG
+#include <jpeglib.h>
+
+// One APPn segment found before the first scan
+struct sMarker
+{
+    int iMarker;
+    std::vector<unsigned char> vPayload;
+};
+
+// Collect the marker segments between SOI and SOS
+static std::vector<sMarker> fn_readMarkers(const std::vector<unsigned char>& vJpeg)
+{ // Begin fn_readMarkers
+    std::vector<sMarker> vMarkers; // Local Function
+    size_t stPos = 2; // Local Function
+    while (stPos + 4 <= vJpeg.size() && vJpeg[stPos] == 0xFF)
+    { // Begin while
+        int iMarker = vJpeg[stPos + 1]; // Local Function
+        size_t stLength = (static_cast<size_t>(vJpeg[stPos + 2]) << 8) | vJpeg[stPos + 3]; // Local Function
+        if (iMarker == 0xDA || stLength < 2 || stPos + 2 + stLength > vJpeg.size())
+        { // Begin if
+            break;
+        } // End if(start of scan or bad length)
+        sMarker oMarker; // Local Function
+        oMarker.iMarker = iMarker;
+        oMarker.vPayload.assign(vJpeg.begin() + stPos + 4, vJpeg.begin() + stPos + 2 + stLength);
+        vMarkers.push_back(oMarker);
+        stPos += 2 + stLength;
+    } // End while(stPos + 4 <= vJpeg.size())
+    return vMarkers;
+} // End Function fn_readMarkers
+
+static bool fn_hasPrefix(const std::vector<unsigned char>& vData, const char* pPrefix, size_t stLength)
+{ // Begin fn_hasPrefix
+    return vData.size() >= stLength && std::memcmp(vData.data(), pPrefix, stLength) == 0;
+} // End Function fn_hasPrefix
+
+// Test Case: EXIF, XMP, multi-segment ICC and IPTC land in one encode
+TEST(JpegMetadataTest, SegmentsWrittenInline)
+{ // Begin TEST
+    const int iWidth = 24; // Local Function
+    const int iHeight = 16; // Local Function
+    std::vector<unsigned char> vPixels(static_cast<size_t>(iWidth) * iHeight * 3); // Local Function
+    for (size_t i = 0; i < vPixels.size(); ++i)
+    { // Begin for
+        vPixels[i] = static_cast<unsigned char>(i * 7);
+    } // End for(size_t i = 0; i < vPixels.size(); ++i)
+    sImageData oImageData = {vPixels.data(), iWidth, iHeight, 3, 8}; // In format_encoder.h
+
+    sEncodeOptions oOptions; // In format_encoder.h
+    oOptions.sFormat = "jpg";
+    oOptions.bPreserveMetadata = true;
+    const unsigned char aTiff[] = {'M', 'M', 0, 42, 0, 0, 0, 8, 0, 0}; // Empty big-endian IFD
+    oOptions.vExifData.assign(aTiff, aTiff + sizeof(aTiff));
+    std::string sXmp = "<x:xmpmeta xmlns:x=\"adobe:ns:meta/\"></x:xmpmeta>"; // Local Function
+    oOptions.vXmpData.assign(sXmp.begin(), sXmp.end());
+    oOptions.vIccProfile.resize(70000);
+    for (size_t i = 0; i < oOptions.vIccProfile.size(); ++i)
+    { // Begin for
+        oOptions.vIccProfile[i] = static_cast<unsigned char>(i % 251);
+    } // End for(size_t i = 0; i < oOptions.vIccProfile.size(); ++i)
+    const unsigned char aIptc[] = {0x1C, 0x02, 0x78, 0x00, 0x03, 'a', 'b', 'c'}; // Caption record
+    oOptions.vIptcData.assign(aIptc, aIptc + sizeof(aIptc));
+
+    FormatEncoder oEncoder; // In format_encoder.cpp
+    std::vector<unsigned char> vJpeg; // Local Function
+    ASSERT_TRUE(oEncoder.fn_encodeToMemory(oImageData, oOptions, vJpeg)); // In format_encoder.cpp
+    ASSERT_GT(vJpeg.size(), 4u); // In gtest
+
+    std::vector<sMarker> vMarkers = fn_readMarkers(vJpeg); // Local Function
+    ASSERT_FALSE(vMarkers.empty()); // In gtest
+
+    // EXIF comes first and replaces the JFIF header
+    EXPECT_EQ(vMarkers[0].iMarker, 0xE1); // In gtest
+    ASSERT_TRUE(fn_hasPrefix(vMarkers[0].vPayload, "Exif\0\0", 6)); // In gtest
+    EXPECT_EQ(std::vector<unsigned char>(vMarkers[0].vPayload.begin() + 6, vMarkers[0].vPayload.end()),
+              oOptions.vExifData); // In gtest
+
+    bool bXmp = false; // Local Function
+    bool bIptc = false; // Local Function
+    std::vector<unsigned char> vIcc; // Local Function
+    int iIccChunks = 0; // Local Function
+    const char aXmpHeader[] = "http://ns.adobe.com/xap/1.0/"; // Local Function
+    for (const sMarker& oMarker : vMarkers)
+    { // Begin for
+        EXPECT_NE(oMarker.iMarker, 0xE0); // No JFIF APP0
+        if (oMarker.iMarker == 0xE1 && fn_hasPrefix(oMarker.vPayload, aXmpHeader, sizeof(aXmpHeader)))
+        { // Begin if
+            bXmp = std::string(oMarker.vPayload.begin() + sizeof(aXmpHeader), oMarker.vPayload.end()) == sXmp;
+        } // End if(XMP)
+        else if (oMarker.iMarker == 0xE2 && fn_hasPrefix(oMarker.vPayload, "ICC_PROFILE\0", 12))
+        { // Begin else if
+            ++iIccChunks;
+            EXPECT_EQ(oMarker.vPayload[12], iIccChunks); // In gtest
+            EXPECT_EQ(oMarker.vPayload[13], 2); // In gtest
+            vIcc.insert(vIcc.end(), oMarker.vPayload.begin() + 14, oMarker.vPayload.end());
+        } // End else if(ICC)
+        else if (oMarker.iMarker == 0xED && fn_hasPrefix(oMarker.vPayload, "Photoshop 3.0\0", 14))
+        { // Begin else if
+            bIptc = fn_hasPrefix(std::vector<unsigned char>(oMarker.vPayload.begin() + 14, oMarker.vPayload.end()),
+                                 "8BIM\x04\x04", 6);
+        } // End else if(IPTC)
+    } // End for(const sMarker& oMarker : vMarkers)
+    EXPECT_TRUE(bXmp); // In gtest
+    EXPECT_TRUE(bIptc); // In gtest
+    EXPECT_EQ(iIccChunks, 2); // In gtest
+    EXPECT_EQ(vIcc, oOptions.vIccProfile); // In gtest
+
+    // The image itself still decodes
+    struct jpeg_decompress_struct sDInfo; // In jpeglib.h
+    struct jpeg_error_mgr sJErr; // In jpeglib.h
+    sDInfo.err = jpeg_std_error(&sJErr);
+    jpeg_create_decompress(&sDInfo);
+    jpeg_mem_src(&sDInfo, vJpeg.data(), static_cast<unsigned long>(vJpeg.size()));
+    ASSERT_EQ(jpeg_read_header(&sDInfo, TRUE), JPEG_HEADER_OK); // In jpeglib.h
+    EXPECT_EQ(static_cast<int>(sDInfo.image_width), iWidth); // In gtest
+    EXPECT_EQ(static_cast<int>(sDInfo.image_height), iHeight); // In gtest
+    jpeg_destroy_decompress(&sDInfo);
+} // End TEST(SegmentsWrittenInline)
+#endif
@@ -0,0 +1,143 @@
+// test_jpeg_strips.cpp - Unit tests for strip-parallel JPEG encoding
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "format_encoder.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <vector>
+
+#ifdef HAVE_JPEG
+#include <jpeglib.h>
+
+// Gradient with some texture so every block has AC coefficients
+static std::vector<unsigned char> fn_makePixels(int iWidth, int iHeight, int iChannels)
+{ // Begin fn_makePixels
+    std::vector<unsigned char> vPixels(static_cast<size_t>(iWidth) * iHeight * iChannels); // Local Function
+    for (int y = 0; y < iHeight; ++y)
+    { // Begin for
+        for (int x = 0; x < iWidth * iChannels; ++x)
+        { // Begin for
+            vPixels[static_cast<size_t>(y) * iWidth * iChannels + x] = static_cast<unsigned char>((x * 3 + y * 5) ^ (x * y / 7));
+        } // End for(int x = 0; x < iWidth * iChannels; ++x)
+    } // End for(int y = 0; y < iHeight; ++y)
+    return vPixels;
+} // End Function fn_makePixels
+
+// Decode with libjpeg; false on any error, dimensions returned
+static bool fn_decodeJpeg(const std::vector<unsigned char>& vJpeg, int& iWidth, int& iHeight)
+{ // Begin fn_decodeJpeg
+    struct jpeg_decompress_struct sDInfo; // In jpeglib.h
+    struct jpeg_error_mgr sJErr; // In jpeglib.h
+    sDInfo.err = jpeg_std_error(&sJErr);
+    jpeg_create_decompress(&sDInfo);
+    jpeg_mem_src(&sDInfo, vJpeg.data(), static_cast<unsigned long>(vJpeg.size()));
+    jpeg_read_header(&sDInfo, TRUE);
+    jpeg_start_decompress(&sDInfo);
+    std::vector<unsigned char> vRow(static_cast<size_t>(sDInfo.output_width) * sDInfo.output_components); // Local Function
+    JSAMPROW pRow = vRow.data(); // Local Function
+    while (sDInfo.output_scanline < sDInfo.output_height)
+    { // Begin while
+        jpeg_read_scanlines(&sDInfo, &pRow, 1);
+    } // End while(rows left)
+    iWidth = static_cast<int>(sDInfo.output_width);
+    iHeight = static_cast<int>(sDInfo.output_height);
+    bool bClean = sJErr.num_warnings == 0; // Corrupt data is reported as a warning
+    jpeg_finish_decompress(&sDInfo);
+    jpeg_destroy_decompress(&sDInfo);
+    return bClean;
+} // End Function fn_decodeJpeg
+
+// Test Case: Spliced strips equal a one-pass encode with the same restart markers
+TEST(JpegStripsTest, RowsMatchRestartEncode)
+{ // Begin TEST
+    FormatEncoder oEncoder; // In format_encoder.cpp
+    const unsigned char aExif[] = {'E', 'x', 'i', 'f', 0, 0, 'I', 'I', 42, 0, 8, 0, 0, 0, 0, 0}; // Empty IFD
+
+    for (int iChannels : {1, 3, 4})
+    { // Begin for
+        const int iWidth = 203, iHeight = 517; // Local Function
+        std::vector<unsigned char> vPixels = fn_makePixels(iWidth, iHeight, iChannels); // Local Function
+        sImageData oImageData = {vPixels.data(), iWidth, iHeight, iChannels, 8}; // In format_encoder.h
+
+        sEncodeOptions oOptions; // In format_encoder.h
+        oOptions.sFormat = "jpg";
+        oOptions.bPreserveMetadata = true;
+        oOptions.vExifData.assign(aExif, aExif + sizeof(aExif));
+        oOptions.oJpeg.iRestartRows = 1;
+        std::vector<unsigned char> vReference, vStrips; // Local Function
+        ASSERT_TRUE(oEncoder.fn_encodeToMemory(oImageData, oOptions, vReference)) << iChannels; // In format_encoder.cpp
+
+        oOptions.oJpeg.iRestartRows = 0;
+        oOptions.oJpeg.bParallelStrips = true;
+        oOptions.iThreads = 5;
+        ASSERT_TRUE(oEncoder.fn_encodeToMemory(oImageData, oOptions, vStrips)) << iChannels; // In format_encoder.cpp
+        EXPECT_TRUE(vStrips == vReference) << iChannels; // Byte for byte
+
+        int iDecodedWidth = 0, iDecodedHeight = 0; // Local Function
+        EXPECT_TRUE(fn_decodeJpeg(vStrips, iDecodedWidth, iDecodedHeight)) << iChannels; // Local Function
+        EXPECT_EQ(iDecodedWidth, iWidth); // In gtest
+        EXPECT_EQ(iDecodedHeight, iHeight); // In gtest
+    } // End for(int iChannels : {1, 3, 4})
+} // End TEST(RowsMatchRestartEncode)
+
+// Test Case: The YCbCr plane path splits at even luma rows the same way
+TEST(JpegStripsTest, PlanarMatchesRestartEncode)
+{ // Begin TEST
+    const int iWidth = 150, iHeight = 331; // Local Function
+    std::vector<unsigned char> vLuma = fn_makePixels(iWidth, iHeight, 1); // Local Function
+    std::vector<unsigned char> vCb = fn_makePixels((iWidth + 1) / 2, (iHeight + 1) / 2, 1); // Local Function
+    std::vector<unsigned char> vCr(vCb.rbegin(), vCb.rend()); // Local Function
+
+    sPlanarImage oPlanar; // In image_buffer.h
+    oPlanar.iWidth = iWidth;
+    oPlanar.iHeight = iHeight;
+    oPlanar.apPlane[0] = vLuma.data();
+    oPlanar.apPlane[1] = vCb.data();
+    oPlanar.apPlane[2] = vCr.data();
+    oPlanar.astStride[0] = iWidth;
+    oPlanar.astStride[1] = oPlanar.astStride[2] = (iWidth + 1) / 2;
+    oPlanar.bFullRange = false;
+
+    FormatEncoder oEncoder; // In format_encoder.cpp
+    sEncodeOptions oOptions; // In format_encoder.h
+    oOptions.sFormat = "jpg";
+    oOptions.oJpeg.iRestartRows = 1;
+    std::vector<unsigned char> vReference, vStrips; // Local Function
+    ASSERT_TRUE(oEncoder.fn_encodePlanarToMemory(oPlanar, oOptions, vReference)); // In format_encoder.cpp
+
+    oOptions.oJpeg.iRestartRows = 0;
+    oOptions.oJpeg.bParallelStrips = true;
+    oOptions.iThreads = 3;
+    ASSERT_TRUE(oEncoder.fn_encodePlanarToMemory(oPlanar, oOptions, vStrips)); // In format_encoder.cpp
+    EXPECT_TRUE(vStrips == vReference); // Byte for byte
+
+    int iDecodedWidth = 0, iDecodedHeight = 0; // Local Function
+    EXPECT_TRUE(fn_decodeJpeg(vStrips, iDecodedWidth, iDecodedHeight)); // Local Function
+    EXPECT_EQ(iDecodedHeight, iHeight); // In gtest
+} // End TEST(PlanarMatchesRestartEncode)
+
+// Test Case: Progressive output and single-threaded runs keep the one-pass encoder
+TEST(JpegStripsTest, FallsBackWhenNotApplicable)
+{ // Begin TEST
+    std::vector<unsigned char> vPixels = fn_makePixels(64, 64, 3); // Local Function
+    sImageData oImageData = {vPixels.data(), 64, 64, 3, 8}; // In format_encoder.h
+    FormatEncoder oEncoder; // In format_encoder.cpp
+
+    sEncodeOptions oOptions; // In format_encoder.h
+    oOptions.sFormat = "jpg";
+    std::vector<unsigned char> vPlain, vOutput; // Local Function
+    ASSERT_TRUE(oEncoder.fn_encodeToMemory(oImageData, oOptions, vPlain)); // In format_encoder.cpp
+
+    oOptions.oJpeg.bParallelStrips = true;
+    ASSERT_TRUE(oEncoder.fn_encodeToMemory(oImageData, oOptions, vOutput)); // One thread
+    EXPECT_TRUE(vOutput == vPlain); // No restart markers added
+
+    oOptions.iThreads = 4;
+    oOptions.bProgressive = true;
+    ASSERT_TRUE(oEncoder.fn_encodeToMemory(oImageData, oOptions, vOutput)); // In format_encoder.cpp
+    int iWidth = 0, iHeight = 0; // Local Function
+    EXPECT_TRUE(fn_decodeJpeg(vOutput, iWidth, iHeight)); // Local Function
+    EXPECT_EQ(iHeight, 64); // In gtest
+} // End TEST(FallsBackWhenNotApplicable)
+#endif
@@ -0,0 +1,65 @@
+// test_mapped_file.cpp - Unit tests for memory-mapped input files
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "mapped_file.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+// Test Case: A regular file is mapped and its bytes are visible
+TEST(MappedFileTest, MapsRegularFile)
+{ // Begin TEST
+    std::string sPath = "mapped_file_test.bin"; // Local Function
+    FILE* pFile = fopen(sPath.c_str(), "wb"); // In cstdio
+    ASSERT_NE(pFile, nullptr); // In gtest
+    fputs("ftypheic", pFile); // In cstdio
+    fclose(pFile); // In cstdio
+
+    MappedFile oFile; // In mapped_file.h
+    ASSERT_TRUE(oFile.fn_open(sPath, eMapAccess::Sequential)); // In mapped_file.cpp
+    EXPECT_TRUE(oFile.fn_isMapped()); // In gtest
+    ASSERT_EQ(oFile.fn_getSize(), 8u); // In gtest
+    EXPECT_EQ(memcmp(oFile.fn_getData(), "ftypheic", 8), 0); // In gtest
+
+    MappedFile oMoved(std::move(oFile)); // In mapped_file.cpp
+    EXPECT_FALSE(oFile.fn_isOpen()); // In gtest
+    EXPECT_EQ(oMoved.fn_getSize(), 8u); // In gtest
+
+    remove(sPath.c_str()); // In cstdio
+} // End TEST(MapsRegularFile)
+
+// Test Case: Missing and empty files fail with an error message
+TEST(MappedFileTest, MissingAndEmptyFail)
+{ // Begin TEST
+    MappedFile oFile; // In mapped_file.h
+    EXPECT_FALSE(oFile.fn_open("does_not_exist.heic")); // In mapped_file.cpp
+    EXPECT_FALSE(oFile.fn_getLastError().empty()); // In gtest
+
+    std::string sPath = "mapped_file_empty.bin"; // Local Function
+    FILE* pFile = fopen(sPath.c_str(), "wb"); // In cstdio
+    ASSERT_NE(pFile, nullptr); // In gtest
+    fclose(pFile); // In cstdio
+
+    EXPECT_FALSE(oFile.fn_open(sPath)); // In mapped_file.cpp
+    remove(sPath.c_str()); // In cstdio
+} // End TEST(MissingAndEmptyFail)
+
+// Test Case: A pipe cannot be mapped and is read into a buffer instead
+TEST(MappedFileTest, PipeFallsBackToRead)
+{ // Begin TEST
+    int aiPipe[2]; // Local Function
+    ASSERT_EQ(pipe(aiPipe), 0); // In unistd.h
+    ASSERT_EQ(write(aiPipe[1], "heif", 4), 4); // In unistd.h
+    close(aiPipe[1]); // In unistd.h
+
+    MappedFile oFile; // In mapped_file.h
+    ASSERT_TRUE(oFile.fn_open("/dev/fd/" + std::to_string(aiPipe[0]))); // In mapped_file.cpp
+    EXPECT_FALSE(oFile.fn_isMapped()); // In gtest
+    ASSERT_EQ(oFile.fn_getSize(), 4u); // In gtest
+    EXPECT_EQ(memcmp(oFile.fn_getData(), "heif", 4), 0); // In gtest
+
+    close(aiPipe[0]); // In unistd.h
+} // End TEST(PipeFallsBackToRead)
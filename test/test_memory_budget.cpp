@@ -0,0 +1,188 @@
+// test_memory_budget.cpp - Unit tests for batch cost estimates and memory admission
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "memory_budget.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Test Case: Sizes take binary suffixes and reject junk
+TEST(MemoryBudgetTest, ParseSizes)
+{ // Begin TEST
+    uint64_t ullBytes = 0; // Local Function
+    ASSERT_TRUE(fn_parseMemorySize("1073741824", ullBytes)); // In memory_budget.cpp
+    EXPECT_EQ(ullBytes, 1073741824ull); // In gtest
+    ASSERT_TRUE(fn_parseMemorySize("512M", ullBytes)); // In memory_budget.cpp
+    EXPECT_EQ(ullBytes, 512ull << 20); // In gtest
+    ASSERT_TRUE(fn_parseMemorySize("1.5g", ullBytes)); // In memory_budget.cpp
+    EXPECT_EQ(ullBytes, 3ull << 29); // In gtest
+    ASSERT_TRUE(fn_parseMemorySize("8GiB", ullBytes)); // In memory_budget.cpp
+    EXPECT_EQ(ullBytes, 8ull << 30); // In gtest
+    ASSERT_TRUE(fn_parseMemorySize("64KB", ullBytes)); // In memory_budget.cpp
+    EXPECT_EQ(ullBytes, 64ull << 10); // In gtest
+
+    for (const char* pText : {"", "M", "-1G", "12X", "4 G", "abc"})
+    { // Begin for
+        EXPECT_FALSE(fn_parseMemorySize(pText, ullBytes)) << pText; // In memory_budget.cpp
+    } // End for(const char* pText : ...)
+
+    ASSERT_TRUE(fn_resolveMemoryLimit("off", ullBytes)); // In memory_budget.cpp
+    EXPECT_EQ(ullBytes, 0u); // In gtest
+    ASSERT_TRUE(fn_resolveMemoryLimit("auto", ullBytes)); // In memory_budget.cpp
+    EXPECT_LE(ullBytes, fn_getSystemMemoryLimit()); // In gtest
+    EXPECT_EQ(fn_formatMemorySize(3ull << 29), "1.5 GiB"); // In gtest
+} // End TEST(ParseSizes)
+
+// Test Case: cgroup v2 and v1 limit files, including their "unlimited" forms
+TEST(MemoryBudgetTest, ReadsCgroupLimit)
+{ // Begin TEST
+    char aDirectory[] = "/tmp/memory_budget_test.XXXXXX"; // Local Function
+    ASSERT_NE(mkdtemp(aDirectory), nullptr); // In cstdlib
+    std::string sDirectory(aDirectory); // Local Function
+
+    EXPECT_EQ(fn_readCgroupMemoryLimit(sDirectory), 0u); // No files
+    std::ofstream(sDirectory + "/memory.max") << "max\n";
+    EXPECT_EQ(fn_readCgroupMemoryLimit(sDirectory), 0u); // In gtest
+    std::ofstream(sDirectory + "/memory.max") << "2147483648\n";
+    EXPECT_EQ(fn_readCgroupMemoryLimit(sDirectory), 2147483648ull); // In gtest
+    remove((sDirectory + "/memory.max").c_str()); // In cstdio
+
+    std::ofstream(sDirectory + "/memory.limit_in_bytes") << "9223372036854771712\n";
+    EXPECT_EQ(fn_readCgroupMemoryLimit(sDirectory), 0u); // v1 "unlimited"
+    std::ofstream(sDirectory + "/memory.limit_in_bytes") << "536870912\n";
+    EXPECT_EQ(fn_readCgroupMemoryLimit(sDirectory), 536870912ull); // In gtest
+    remove((sDirectory + "/memory.limit_in_bytes").c_str()); // In cstdio
+    rmdir(aDirectory); // In unistd.h
+} // End TEST(ReadsCgroupLimit)
+
+// Test Case: The estimate scales with pixels, channels and bit depth
+TEST(MemoryBudgetTest, EstimatesFromProbe)
+{ // Begin TEST
+    sHeifProbe oProbe; // In heif_probe.h
+    oProbe.iWidth = 8000;
+    oProbe.iHeight = 6000;
+    oProbe.iBitDepth = 8;
+    oProbe.ullFileSize = 10000000;
+    uint64_t ullOpaque = fn_estimateConversionBytes(oProbe); // In memory_budget.cpp
+    EXPECT_GE(ullOpaque, 8000ull * 6000 * 3 * 2); // In gtest
+    EXPECT_LE(ullOpaque, 8000ull * 6000 * 3 * 4 + oProbe.ullFileSize); // In gtest
+
+    oProbe.bHasAlpha = true;
+    oProbe.iBitDepth = 10;
+    EXPECT_GT(fn_estimateConversionBytes(oProbe), ullOpaque * 2); // In gtest
+
+    // Not a HEIF: falls back to a multiple of the size
+    const unsigned char aJunk[100] = {}; // Local Function
+    EXPECT_GE(fn_estimateMemoryConversionBytes(aJunk, sizeof(aJunk)), sizeof(aJunk)); // In gtest
+} // End TEST(EstimatesFromProbe)
+
+// Test Case: Requests wait until the in-flight total fits the limit
+TEST(MemoryBudgetTest, BlocksUntilReleased)
+{ // Begin TEST
+    MemoryBudget oBudget(100); // In memory_budget.h
+    uint64_t ullFirst = oBudget.fn_acquire(60); // In memory_budget.cpp
+    EXPECT_EQ(ullFirst, 60u); // In gtest
+
+    std::atomic<bool> bAdmitted(false); // Local Function
+    std::thread oWaiter([&oBudget, &bAdmitted]()
+    { // Begin lambda
+        uint64_t ullBytes = oBudget.fn_acquire(50); // In memory_budget.cpp
+        bAdmitted = true;
+        oBudget.fn_release(ullBytes); // In memory_budget.cpp
+    }); // End lambda
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(bAdmitted.load()); // 60 + 50 > 100
+    EXPECT_EQ(oBudget.fn_getInFlight(), 60u); // In gtest
+
+    oBudget.fn_release(ullFirst); // In memory_budget.cpp
+    oWaiter.join();
+    EXPECT_TRUE(bAdmitted.load()); // In gtest
+    EXPECT_EQ(oBudget.fn_getInFlight(), 0u); // In gtest
+
+    // No limit admits everything
+    MemoryBudget oUnlimited; // In memory_budget.h
+    EXPECT_EQ(oUnlimited.fn_acquire(1ull << 40), 0u); // In gtest
+    EXPECT_EQ(oUnlimited.fn_getInFlight(), 0u); // In gtest
+} // End TEST(BlocksUntilReleased)
+
+// Test Case: A request above the limit runs alone and later ones keep their order
+TEST(MemoryBudgetTest, OversizedRunsAloneInOrder)
+{ // Begin TEST
+    MemoryBudget oBudget(100); // In memory_budget.h
+    uint64_t ullSmall = oBudget.fn_acquire(10); // In memory_budget.cpp
+
+    std::mutex oOrderMutex; // Local Function
+    std::vector<int> viOrder; // Local Function
+    std::atomic<int> iRunning(0); // Local Function
+    std::atomic<int> iMaxRunning(0); // Local Function
+    auto fnWorker = [&](int iId, uint64_t ullBytes)
+    { // Begin lambda
+        uint64_t ullHeld = oBudget.fn_acquire(ullBytes); // In memory_budget.cpp
+        {
+            std::lock_guard<std::mutex> oLock(oOrderMutex);
+            viOrder.push_back(iId);
+        }
+        int iNow = ++iRunning; // Local Function
+        int iSeen = iMaxRunning.load(); // Local Function
+        while (iNow > iSeen && !iMaxRunning.compare_exchange_weak(iSeen, iNow))
+        {
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        --iRunning;
+        oBudget.fn_release(ullHeld); // In memory_budget.cpp
+    }; // End lambda
+
+    // The oversized request queues first; the small one behind it must not overtake
+    std::thread oHuge(fnWorker, 1, 500); // In thread
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    std::thread oTiny(fnWorker, 2, 5); // In thread
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    {
+        std::lock_guard<std::mutex> oLock(oOrderMutex);
+        EXPECT_TRUE(viOrder.empty()); // Both wait for the first small request
+    }
+
+    oBudget.fn_release(ullSmall); // In memory_budget.cpp
+    oHuge.join();
+    oTiny.join();
+    ASSERT_EQ(viOrder, (std::vector<int>{1, 2})); // In gtest
+    EXPECT_EQ(iMaxRunning.load(), 1); // The huge one ran alone
+    EXPECT_EQ(oBudget.fn_getInFlight(), 0u); // In gtest
+} // End TEST(OversizedRunsAloneInOrder)
+
+// Test Case: Files are scheduled by pixel count, or by size when they do not probe
+TEST(MemoryBudgetTest, OrdersLargestFirst)
+{ // Begin TEST
+    std::vector<sConversionCost> vCosts(5); // Local Function
+    const uint64_t aWork[5] = {12000000, 48000000, 0, 12000000, 200000000}; // Local Function
+    for (size_t i = 0; i < vCosts.size(); ++i)
+    { // Begin for
+        vCosts[i].ullWork = aWork[i];
+    } // End for(size_t i = 0; i < vCosts.size(); ++i)
+    EXPECT_EQ(fn_orderByCost(vCosts), (std::vector<size_t>{4, 1, 0, 3, 2})); // Ties keep input order
+
+    char aPath[] = "/tmp/memory_budget_test.XXXXXX"; // Local Function
+    int iFd = mkstemp(aPath); // In cstdlib
+    ASSERT_GE(iFd, 0); // In gtest
+    close(iFd); // In unistd.h
+    std::ofstream(aPath) << std::string(1000, 'x');
+    sConversionCost oSmall = fn_estimateFileCost(aPath); // In memory_budget.cpp
+    std::ofstream(aPath) << std::string(100000, 'x');
+    sConversionCost oLarge = fn_estimateFileCost(aPath); // In memory_budget.cpp
+    remove(aPath); // In cstdio
+
+    EXPECT_GT(oSmall.ullWork, 0u); // In gtest
+    EXPECT_EQ(oLarge.ullWork, oSmall.ullWork * 100); // In gtest
+    EXPECT_GT(oLarge.ullPeakBytes, 100000u); // More than the compressed bytes
+    EXPECT_EQ(fn_estimateFileCost(aPath).ullWork, 0u); // Missing file
+} // End TEST(OrdersLargestFirst)
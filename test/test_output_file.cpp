@@ -0,0 +1,144 @@
+// test_output_file.cpp - Unit tests for atomic output files
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "output_file.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Fresh empty directory for one test
+static std::string fn_makeTempDirectory()
+{ // Begin fn_makeTempDirectory
+    char aTemplate[] = "/tmp/output_file_test.XXXXXX"; // Local Function
+    const char* pDirectory = mkdtemp(aTemplate); // In cstdlib
+    return pDirectory ? std::string(pDirectory) : std::string();
+} // End Function fn_makeTempDirectory
+
+// Names in a directory, "." and ".." excluded
+static int fn_countEntries(const std::string& sDirectory)
+{ // Begin fn_countEntries
+    int iCount = 0; // Local Function
+    DIR* pDir = opendir(sDirectory.c_str()); // In dirent.h
+    if (!pDir)
+    { // Begin if
+        return -1;
+    } // End if(!pDir)
+    while (struct dirent* pEntry = readdir(pDir))
+    { // Begin while
+        std::string sName = pEntry->d_name; // Local Function
+        iCount += (sName != "." && sName != "..") ? 1 : 0;
+    } // End while(readdir)
+    closedir(pDir); // In dirent.h
+    return iCount;
+} // End Function fn_countEntries
+
+static std::string fn_readFile(const std::string& sPath)
+{ // Begin fn_readFile
+    std::ifstream oFile(sPath, std::ios::binary); // In fstream
+    std::stringstream oContents; // In sstream
+    oContents << oFile.rdbuf();
+    return oContents.str();
+} // End Function fn_readFile
+
+static void fn_writeFile(const std::string& sPath, const std::string& sContents)
+{ // Begin fn_writeFile
+    std::ofstream oFile(sPath, std::ios::binary); // In fstream
+    oFile << sContents;
+} // End Function fn_writeFile
+
+// Test Case: The file appears only at commit, with the requested times
+TEST(OutputFileTest, CommitPublishesWithTimes)
+{ // Begin TEST
+    std::string sDirectory = fn_makeTempDirectory(); // Local Function
+    ASSERT_FALSE(sDirectory.empty()); // In gtest
+    std::string sPath = sDirectory + "/image.jpg"; // Local Function
+
+    OutputFile oFile; // In output_file.h
+    ASSERT_TRUE(oFile.fn_open(sPath, 4096)) << oFile.fn_getLastError(); // In output_file.cpp
+    ASSERT_TRUE(oFile.fn_write("jpegdata", 8)); // In output_file.cpp
+    EXPECT_NE(access(sPath.c_str(), F_OK), 0); // Not visible yet
+
+    sOutputOptions oOptions; // In output_file.h
+    oOptions.eSync = eSyncMode::File;
+    oOptions.bSetTimes = true;
+    oOptions.aTimes[0].tv_sec = 1000000000;
+    oOptions.aTimes[1].tv_sec = 1234567890;
+    oOptions.aTimes[1].tv_nsec = 500;
+    ASSERT_TRUE(oFile.fn_commit(oOptions)) << oFile.fn_getLastError(); // In output_file.cpp
+
+    EXPECT_EQ(fn_readFile(sPath), "jpegdata"); // In gtest
+    EXPECT_EQ(fn_countEntries(sDirectory), 1); // No temporary left behind
+    struct stat oStat; // In sys/stat.h
+    ASSERT_EQ(stat(sPath.c_str(), &oStat), 0); // In sys/stat.h
+    EXPECT_EQ(oStat.st_size, 8); // Preallocation trimmed
+    EXPECT_EQ(oStat.st_mtim.tv_sec, 1234567890); // In gtest
+
+    remove(sPath.c_str()); // In cstdio
+    rmdir(sDirectory.c_str()); // In unistd.h
+} // End TEST(CommitPublishesWithTimes)
+
+// Test Case: An output that is never committed leaves no trace
+TEST(OutputFileTest, DiscardLeavesNothing)
+{ // Begin TEST
+    std::string sDirectory = fn_makeTempDirectory(); // Local Function
+    ASSERT_FALSE(sDirectory.empty()); // In gtest
+    std::string sPath = sDirectory + "/image.png"; // Local Function
+    fn_writeFile(sPath, "previous"); // Local Function
+
+    { // Begin scope
+        OutputFile oFile; // In output_file.h
+        ASSERT_TRUE(oFile.fn_open(sPath)); // In output_file.cpp
+        ASSERT_TRUE(oFile.fn_write("half", 4)); // In output_file.cpp
+    } // End scope (encoder failed)
+
+    EXPECT_EQ(fn_readFile(sPath), "previous"); // In gtest
+    EXPECT_EQ(fn_countEntries(sDirectory), 1); // In gtest
+
+    remove(sPath.c_str()); // In cstdio
+    rmdir(sDirectory.c_str()); // In unistd.h
+} // End TEST(DiscardLeavesNothing)
+
+// Test Case: Existing files are replaced only when asked
+TEST(OutputFileTest, ReplaceOrKeepExisting)
+{ // Begin TEST
+    std::string sDirectory = fn_makeTempDirectory(); // Local Function
+    ASSERT_FALSE(sDirectory.empty()); // In gtest
+    std::string sPath = sDirectory + "/image.webp"; // Local Function
+    fn_writeFile(sPath, "previous"); // Local Function
+
+    sOutputOptions oOptions; // In output_file.h
+    oOptions.bReplace = false;
+    std::string sError; // Local Function
+    EXPECT_FALSE(fn_writeOutputFile(sPath, "new", 3, oOptions, sError)); // In output_file.cpp
+    EXPECT_FALSE(sError.empty()); // In gtest
+    EXPECT_EQ(fn_readFile(sPath), "previous"); // In gtest
+    EXPECT_EQ(fn_countEntries(sDirectory), 1); // In gtest
+
+    oOptions.bReplace = true;
+    EXPECT_TRUE(fn_writeOutputFile(sPath, "new", 3, oOptions, sError)) << sError; // In output_file.cpp
+    EXPECT_EQ(fn_readFile(sPath), "new"); // In gtest
+    EXPECT_EQ(fn_countEntries(sDirectory), 1); // In gtest
+
+    remove(sPath.c_str()); // In cstdio
+    rmdir(sDirectory.c_str()); // In unistd.h
+} // End TEST(ReplaceOrKeepExisting)
+
+// Test Case: Sync mode names round-trip
+TEST(OutputFileTest, SyncModeNames)
+{ // Begin TEST
+    eSyncMode eMode = eSyncMode::None; // In output_file.h
+    for (const char* pName : {"none", "file", "batch"})
+    { // Begin for
+        ASSERT_TRUE(fn_parseSyncMode(pName, eMode)); // In output_file.cpp
+        EXPECT_EQ(fn_getSyncModeName(eMode), pName); // In gtest
+    } // End for(const char* pName : {"none", "file", "batch"})
+    EXPECT_FALSE(fn_parseSyncMode("always", eMode)); // In output_file.cpp
+    EXPECT_TRUE(fn_syncOutputFilesystem("/tmp")); // In output_file.cpp
+} // End TEST(SyncModeNames)
@@ -42,13 +42,13 @@ void testPanoramaDecoding(const std::string& filename)
         std::cout << "Decoded successfully!" << std::endl;
         std::cout << "  Actual dimensions: " << decoded.iWidth << "x" << decoded.iHeight << std::endl;
         std::cout << "  Channels: " << decoded.iChannels << std::endl;
-        std::cout << "  Data size: " << decoded.vData.size() << " bytes" << std::endl;
+        std::cout << "  Data size: " << decoded.oPixels.fn_getStride() * decoded.oPixels.fn_getHeight() << " bytes" << std::endl;
         
         // Save a preview (first 1KB)
         std::string preview_name = filename + ".preview.raw";
         std::ofstream out(preview_name, std::ios::binary);
-        size_t preview_size = std::min((size_t)1024, decoded.vData.size());
-        out.write(reinterpret_cast<const char*>(decoded.vData.data()), preview_size);
+        size_t preview_size = std::min((size_t)1024, decoded.oPixels.fn_getStride() * decoded.oPixels.fn_getHeight());
+        out.write(reinterpret_cast<const char*>(decoded.oPixels.fn_getData()), preview_size);
         out.close();
         
         std::cout << "First " << preview_size << " bytes saved to: " << preview_name << std::endl;
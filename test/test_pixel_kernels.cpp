@@ -0,0 +1,144 @@
+// test_pixel_kernels.cpp - Unit tests for the pixel row kernels
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "pixel_kernels.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+// Repeatable bytes for kernel inputs
+static std::vector<uint8_t> fn_makeBytes(size_t stCount)
+{ // Begin fn_makeBytes
+    std::vector<uint8_t> vBytes(stCount); // Local Function
+    unsigned int uState = 54321u; // Local Function
+    for (uint8_t& uByte : vBytes)
+    { // Begin for
+        uState = uState * 1103515245u + 12345u;
+        uByte = static_cast<uint8_t>(uState >> 16);
+    } // End for(uint8_t& uByte : vBytes)
+    return vBytes;
+} // End Function fn_makeBytes
+
+// Run every kernel on one input and collect the outputs
+static std::vector<uint8_t> fn_runAll(const std::vector<uint8_t>& vInput, int iPixels)
+{ // Begin fn_runAll
+    std::vector<uint8_t> vOutput; // Local Function
+    const uint8_t aBackground[3] = {255, 128, 0}; // Local Function
+    for (int iChannels = 1; iChannels <= 4; ++iChannels)
+    { // Begin for
+        std::vector<uint8_t> vRow(vInput.begin(), vInput.begin() + iPixels * iChannels); // Local Function
+        std::vector<uint8_t> vOut(static_cast<size_t>(iPixels) * iChannels); // Local Function
+        fn_swapRedBlue(vRow.data(), vOut.data(), iPixels, iChannels); // In pixel_kernels.cpp
+        vOutput.insert(vOutput.end(), vOut.begin(), vOut.end());
+        fn_swapRedBlue(vRow.data(), vRow.data(), iPixels, iChannels); // In place
+        vOutput.insert(vOutput.end(), vRow.begin(), vRow.end());
+        fn_premultiplyAlpha(vRow.data(), vOut.data(), iPixels, iChannels); // In pixel_kernels.cpp
+        vOutput.insert(vOutput.end(), vOut.begin(), vOut.end());
+        fn_extractGrey(vRow.data(), vOut.data(), iPixels, iChannels); // In pixel_kernels.cpp
+        vOutput.insert(vOutput.end(), vOut.begin(), vOut.begin() + iPixels);
+    } // End for(int iChannels = 1; iChannels <= 4; ++iChannels)
+
+    std::vector<uint8_t> vRgb(static_cast<size_t>(iPixels) * 3); // Local Function
+    fn_blendOverBackground(vInput.data(), vRgb.data(), iPixels, aBackground); // In pixel_kernels.cpp
+    vOutput.insert(vOutput.end(), vRgb.begin(), vRgb.end());
+
+    std::vector<uint16_t> vWide(static_cast<size_t>(iPixels) * 2); // Local Function
+    for (size_t i = 0; i < vWide.size(); ++i)
+    { // Begin for
+        vWide[i] = static_cast<uint16_t>(vInput[i * 2] << 8 | vInput[i * 2 + 1]);
+    } // End for(size_t i = 0; i < vWide.size(); ++i)
+    std::vector<uint8_t> vNarrow(vWide.size()); // Local Function
+    for (int iBitDepth : {10, 12, 16})
+    { // Begin for
+        fn_narrowTo8(vWide.data(), vNarrow.data(), vWide.size(), iBitDepth); // In pixel_kernels.cpp
+        vOutput.insert(vOutput.end(), vNarrow.begin(), vNarrow.end());
+    } // End for(int iBitDepth : {10, 12, 16})
+    return vOutput;
+} // End Function fn_runAll
+
+// Test Case: Scalar results follow the documented rounding
+TEST(PixelKernelsTest, ScalarValues)
+{ // Begin TEST
+    ASSERT_TRUE(fn_setPixelKernel("scalar")); // In pixel_kernels.cpp
+
+    const uint8_t aBgra[4] = {10, 20, 30, 40}; // Local Function
+    uint8_t aSwapped[4] = {0, 0, 0, 0}; // Local Function
+    fn_swapRedBlue(aBgra, aSwapped, 1, 4); // In pixel_kernels.cpp
+    EXPECT_EQ(aSwapped[0], 30); // In gtest
+    EXPECT_EQ(aSwapped[2], 10); // In gtest
+    EXPECT_EQ(aSwapped[3], 40); // In gtest
+
+    // Premultiply is round(c * a / 255) for every pair
+    for (int iAlpha = 0; iAlpha < 256; ++iAlpha)
+    { // Begin for
+        for (int iColour = 0; iColour < 256; ++iColour)
+        { // Begin for
+            const uint8_t aPixel[2] = {static_cast<uint8_t>(iColour), static_cast<uint8_t>(iAlpha)}; // Local Function
+            uint8_t aOut[2] = {0, 0}; // Local Function
+            fn_premultiplyAlpha(aPixel, aOut, 1, 2); // In pixel_kernels.cpp
+            ASSERT_EQ(aOut[0], static_cast<int>(std::lround(iColour * iAlpha / 255.0))) << iColour << " " << iAlpha; // In gtest
+            ASSERT_EQ(aOut[1], iAlpha); // In gtest
+        } // End for(int iColour = 0; iColour < 256; ++iColour)
+    } // End for(int iAlpha = 0; iAlpha < 256; ++iAlpha)
+
+    // Transparent pixels become the background, opaque ones stay
+    const uint8_t aRgba[8] = {200, 100, 50, 0, 200, 100, 50, 255}; // Local Function
+    const uint8_t aWhite[3] = {255, 255, 255}; // Local Function
+    uint8_t aRgb[6] = {0, 0, 0, 0, 0, 0}; // Local Function
+    fn_blendOverBackground(aRgba, aRgb, 2, aWhite); // In pixel_kernels.cpp
+    EXPECT_EQ(aRgb[0], 255); // In gtest
+    EXPECT_EQ(aRgb[2], 255); // In gtest
+    EXPECT_EQ(aRgb[3], 200); // In gtest
+    EXPECT_EQ(aRgb[5], 50); // In gtest
+
+    const uint16_t aTenBit[3] = {0, 514, 1023}; // Local Function
+    uint8_t aEight[3] = {1, 1, 1}; // Local Function
+    fn_narrowTo8(aTenBit, aEight, 3, 10); // In pixel_kernels.cpp
+    EXPECT_EQ(aEight[0], 0); // In gtest
+    EXPECT_EQ(aEight[1], 129); // In gtest
+    EXPECT_EQ(aEight[2], 255); // In gtest
+
+    const uint8_t aWhitePixel[3] = {255, 255, 255}; // Local Function
+    uint8_t uGrey = 0; // Local Function
+    fn_extractGrey(aWhitePixel, &uGrey, 1, 3); // In pixel_kernels.cpp
+    EXPECT_EQ(uGrey, 255); // In gtest
+} // End TEST(ScalarValues)
+
+// Test Case: Every SIMD kernel set matches scalar, including odd tails
+TEST(PixelKernelsTest, KernelsMatchScalar)
+{ // Begin TEST
+    std::string sDefault = fn_getPixelKernel(); // In pixel_kernels.cpp
+    std::vector<uint8_t> vInput = fn_makeBytes(4 * 203); // Local Function
+    const char* apKernels[] = {"avx512", "avx2", "sse4.1", "neon"}; // Local Function
+
+    for (int iPixels : {1, 7, 16, 37, 203})
+    { // Begin for
+        ASSERT_TRUE(fn_setPixelKernel("scalar")); // In pixel_kernels.cpp
+        std::vector<uint8_t> vExpected = fn_runAll(vInput, iPixels); // Local Function
+        for (const char* pKernel : apKernels)
+        { // Begin for
+            if (!fn_setPixelKernel(pKernel))
+            { // Begin if
+                continue; // Not available on this machine
+            } // End if(!fn_setPixelKernel(pKernel))
+            EXPECT_EQ(fn_runAll(vInput, iPixels), vExpected) << pKernel << ", pixels " << iPixels; // In gtest
+        } // End for(const char* pKernel : apKernels)
+    } // End for(int iPixels : {1, 7, 16, 37, 203})
+
+    EXPECT_TRUE(fn_setPixelKernel(sDefault)); // In pixel_kernels.cpp
+    EXPECT_FALSE(fn_setPixelKernel("mmx")); // In pixel_kernels.cpp
+} // End TEST(KernelsMatchScalar)
+
+// Test Case: Flipped copy reverses rows and zeroes the padding
+TEST(PixelKernelsTest, FlipPadsRows)
+{ // Begin TEST
+    const uint8_t aSource[6] = {1, 2, 3, 4, 5, 6}; // Three rows of two bytes
+    uint8_t aFlipped[12]; // Local Function
+    std::fill(aFlipped, aFlipped + 12, 0xAA);
+    fn_copyRowsFlipped(aSource, 2, aFlipped, 4, 2, 3); // In pixel_kernels.cpp
+    const uint8_t aExpected[12] = {5, 6, 0, 0, 3, 4, 0, 0, 1, 2, 0, 0}; // Local Function
+    EXPECT_TRUE(std::equal(aFlipped, aFlipped + 12, aExpected)); // In gtest
+} // End TEST(FlipPadsRows)
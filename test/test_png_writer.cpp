@@ -0,0 +1,193 @@
+// test_png_writer.cpp - Unit tests for the banded PNG writer
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "png_writer.h"
+#include "format_encoder.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_PNG
+#include <png.h>
+
+// One chunk of a PNG file
+struct sPngChunk
+{
+    std::string sType;
+    std::vector<unsigned char> vData;
+};
+
+// Chunks after the signature (empty when the signature is wrong)
+static std::vector<sPngChunk> fn_readPngChunks(const std::vector<unsigned char>& vPng)
+{ // Begin fn_readPngChunks
+    std::vector<sPngChunk> vChunks; // Local Function
+    if (vPng.size() < 8 || png_sig_cmp(vPng.data(), 0, 8) != 0)
+    { // Begin if
+        return vChunks;
+    } // End if(not a PNG file)
+
+    size_t stPos = 8; // Local Function
+    while (stPos + 12 <= vPng.size())
+    { // Begin while
+        const unsigned char* pHeader = vPng.data() + stPos; // Local Function
+        size_t stLength = (static_cast<size_t>(pHeader[0]) << 24) | (pHeader[1] << 16) | (pHeader[2] << 8) | pHeader[3];
+        if (stPos + 12 + stLength > vPng.size())
+        { // Begin if
+            break;
+        } // End if(truncated chunk)
+        sPngChunk oChunk; // Local Function
+        oChunk.sType.assign(reinterpret_cast<const char*>(pHeader + 4), 4);
+        oChunk.vData.assign(pHeader + 8, pHeader + 8 + stLength);
+        vChunks.push_back(oChunk);
+        stPos += 12 + stLength;
+    } // End while(stPos + 12 <= vPng.size())
+    return vChunks;
+} // End Function fn_readPngChunks
+
+static int fn_countChunks(const std::vector<sPngChunk>& vChunks, const std::string& sType)
+{ // Begin fn_countChunks
+    int iCount = 0; // Local Function
+    for (const sPngChunk& oChunk : vChunks)
+    { // Begin for
+        iCount += oChunk.sType == sType ? 1 : 0;
+    } // End for(const sPngChunk& oChunk : vChunks)
+    return iCount;
+} // End Function fn_countChunks
+
+// Decode with libpng into tightly packed 8-bit pixels of the same layout
+static bool fn_decodePng(const std::vector<unsigned char>& vPng, int iChannels, std::vector<unsigned char>& vPixels)
+{ // Begin fn_decodePng
+    static const png_uint_32 aFORMATS[5] = {0, PNG_FORMAT_GRAY, PNG_FORMAT_GA, PNG_FORMAT_RGB, PNG_FORMAT_RGBA};
+    png_image oImage; // In png.h
+    std::memset(&oImage, 0, sizeof(oImage));
+    oImage.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_memory(&oImage, vPng.data(), vPng.size()))
+    { // Begin if
+        return false;
+    } // End if(bad header)
+    oImage.format = aFORMATS[iChannels];
+    vPixels.resize(PNG_IMAGE_SIZE(oImage));
+    return png_image_finish_read(&oImage, nullptr, vPixels.data(), 0, nullptr) != 0;
+} // End Function fn_decodePng
+
+// Run the writer into a temporary file and return its bytes
+static bool fn_writeToMemory(const std::vector<unsigned char>& vPixels, int iWidth, int iHeight, int iChannels,
+                             const sPngWriterOptions& oOptions, int iThreads, std::vector<unsigned char>& vPng)
+{ // Begin fn_writeToMemory
+    FILE* fp = tmpfile(); // In cstdio
+    if (!fp)
+    { // Begin if
+        return false;
+    } // End if(!fp)
+    std::string sError; // Local Function
+    bool bOk = fn_writePng(fp, vPixels.data(), static_cast<size_t>(iWidth) * iChannels, iWidth, iHeight, iChannels,
+                           oOptions, iThreads, sError); // In png_writer.cpp
+    long lSize = ftell(fp); // In cstdio
+    vPng.resize(lSize > 0 ? lSize : 0);
+    rewind(fp); // In cstdio
+    bOk = bOk && fread(vPng.data(), 1, vPng.size(), fp) == vPng.size();
+    fclose(fp); // In cstdio
+    return bOk;
+} // End Function fn_writeToMemory
+
+// Smooth gradients with some noise, so every filter gets picked somewhere
+static std::vector<unsigned char> fn_makePixels(int iWidth, int iHeight, int iChannels)
+{ // Begin fn_makePixels
+    std::vector<unsigned char> vPixels(static_cast<size_t>(iWidth) * iHeight * iChannels); // Local Function
+    unsigned int uNoise = 12345; // Local Function
+    for (int y = 0; y < iHeight; ++y)
+    { // Begin for
+        for (int x = 0; x < iWidth; ++x)
+        { // Begin for
+            for (int c = 0; c < iChannels; ++c)
+            { // Begin for
+                uNoise = uNoise * 1103515245u + 12345u;
+                int iValue = (x * (c + 1) + y * (3 - c)) / 4 + static_cast<int>((uNoise >> 16) & 7); // Local Function
+                vPixels[(static_cast<size_t>(y) * iWidth + x) * iChannels + c] = static_cast<unsigned char>(iValue);
+            } // End for(int c = 0; c < iChannels; ++c)
+        } // End for(int x = 0; x < iWidth; ++x)
+    } // End for(int y = 0; y < iHeight; ++y)
+    return vPixels;
+} // End Function fn_makePixels
+
+// Test Case: Serial, parallel and fast output all decode to the source pixels
+TEST(PngWriterTest, BandsDecodeIdentically)
+{ // Begin TEST
+    const int iWidth = 1000, iHeight = 800, iChannels = 3; // 2.4 MB: three bands
+    std::vector<unsigned char> vPixels = fn_makePixels(iWidth, iHeight, iChannels); // Local Function
+    sPngWriterOptions oOptions; // In png_writer.h
+
+    std::vector<unsigned char> vSerial, vParallel, vFast, vDecoded; // Local Function
+    ASSERT_TRUE(fn_writeToMemory(vPixels, iWidth, iHeight, iChannels, oOptions, 1, vSerial)); // Local Function
+    ASSERT_TRUE(fn_writeToMemory(vPixels, iWidth, iHeight, iChannels, oOptions, 4, vParallel)); // Local Function
+    EXPECT_EQ(vSerial, vParallel); // Bands do not depend on who deflates them
+    EXPECT_EQ(fn_countChunks(fn_readPngChunks(vParallel), "IDAT"), 3); // In gtest
+
+    ASSERT_TRUE(fn_decodePng(vParallel, iChannels, vDecoded)); // Local Function
+    EXPECT_TRUE(vDecoded == vPixels); // In gtest
+
+    oOptions.bFastFilter = true;
+    ASSERT_TRUE(fn_writeToMemory(vPixels, iWidth, iHeight, iChannels, oOptions, 4, vFast)); // Local Function
+    ASSERT_TRUE(fn_decodePng(vFast, iChannels, vDecoded)); // Local Function
+    EXPECT_TRUE(vDecoded == vPixels); // In gtest
+} // End TEST(BandsDecodeIdentically)
+
+// Test Case: Every channel layout and a row wider than a band
+TEST(PngWriterTest, ChannelLayouts)
+{ // Begin TEST
+    for (int iChannels = 1; iChannels <= 4; ++iChannels)
+    { // Begin for
+        std::vector<unsigned char> vPixels = fn_makePixels(37, 11, iChannels); // Local Function
+        std::vector<unsigned char> vPng, vDecoded; // Local Function
+        ASSERT_TRUE(fn_writeToMemory(vPixels, 37, 11, iChannels, sPngWriterOptions(), 1, vPng)) << iChannels;
+        ASSERT_TRUE(fn_decodePng(vPng, iChannels, vDecoded)) << iChannels; // Local Function
+        EXPECT_TRUE(vDecoded == vPixels) << iChannels; // In gtest
+    } // End for(int iChannels = 1; iChannels <= 4; ++iChannels)
+
+    const int iWide = static_cast<int>(stPNG_BAND_BYTES / 4) + 5; // Local Function
+    std::vector<unsigned char> vPixels = fn_makePixels(iWide, 3, 4); // Local Function
+    std::vector<unsigned char> vPng, vDecoded; // Local Function
+    ASSERT_TRUE(fn_writeToMemory(vPixels, iWide, 3, 4, sPngWriterOptions(), 2, vPng)); // Local Function
+    EXPECT_EQ(fn_countChunks(fn_readPngChunks(vPng), "IDAT"), 3); // One row per band
+    ASSERT_TRUE(fn_decodePng(vPng, 4, vDecoded)); // Local Function
+    EXPECT_TRUE(vDecoded == vPixels); // In gtest
+} // End TEST(ChannelLayouts)
+
+// Test Case: The encoder writes EXIF as an eXIf chunk on both PNG paths
+TEST(PngWriterTest, ExifChunk)
+{ // Begin TEST
+    const unsigned char aExif[] = {'E', 'x', 'i', 'f', 0, 0, 'I', 'I', 42, 0, 8, 0, 0, 0, 0, 0}; // Empty IFD
+    const std::vector<unsigned char> vTiff(aExif + 6, aExif + sizeof(aExif)); // Local Function
+    std::vector<unsigned char> vPixels = fn_makePixels(1024, 1024, 3); // Local Function
+    FormatEncoder oEncoder; // In format_encoder.cpp
+
+    for (int iThreads : {1, 3})
+    { // Begin for
+        sImageData oImageData = {vPixels.data(), 1024, 1024, 3, 8}; // In format_encoder.h
+        sEncodeOptions oOptions; // In format_encoder.h
+        oOptions.sFormat = "png";
+        oOptions.iThreads = iThreads; // 3 takes the banded writer
+        oOptions.bPreserveMetadata = true;
+        oOptions.vExifData.assign(aExif, aExif + sizeof(aExif));
+
+        std::vector<unsigned char> vPng, vDecoded; // Local Function
+        ASSERT_TRUE(oEncoder.fn_encodeToMemory(oImageData, oOptions, vPng)) << iThreads; // In format_encoder.cpp
+        std::vector<sPngChunk> vChunks = fn_readPngChunks(vPng); // Local Function
+        ASSERT_GE(vChunks.size(), 4u) << iThreads; // In gtest
+        EXPECT_EQ(fn_countChunks(vChunks, "tEXt"), 0) << iThreads; // In gtest
+        ASSERT_EQ(fn_countChunks(vChunks, "eXIf"), 1) << iThreads; // In gtest
+        for (const sPngChunk& oChunk : vChunks)
+        { // Begin for
+            if (oChunk.sType == "eXIf")
+            { // Begin if
+                EXPECT_EQ(oChunk.vData, vTiff) << iThreads; // No "Exif" prefix
+            } // End if(oChunk.sType == "eXIf")
+        } // End for(const sPngChunk& oChunk : vChunks)
+        ASSERT_TRUE(fn_decodePng(vPng, 3, vDecoded)) << iThreads; // Local Function
+        EXPECT_TRUE(vDecoded == vPixels) << iThreads; // In gtest
+    } // End for(int iThreads : {1, 3})
+} // End TEST(ExifChunk)
+#endif
@@ -0,0 +1,192 @@
+// test_rendition.cpp - Unit tests for decode-once multi-rendition output
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "rendition.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#if defined(HAVE_PNG) && defined(HAVE_JPEG)
+#include <png.h>
+#include <jpeglib.h>
+#endif
+
+// Test Case: Specs parse to format, size and default suffix
+TEST(RenditionTest, ParseSpecs)
+{ // Begin TEST
+    sRendition oRendition; // In rendition.h
+    ASSERT_TRUE(fn_parseRendition("jpg", oRendition)); // In rendition.cpp
+    EXPECT_EQ(oRendition.sFormat, "jpg"); // In gtest
+    EXPECT_EQ(oRendition.iMaxDimension, 0); // In gtest
+    EXPECT_EQ(oRendition.sSuffix, ""); // In gtest
+
+    ASSERT_TRUE(fn_parseRendition(" WebP:2048 ", oRendition)); // In rendition.cpp
+    EXPECT_EQ(oRendition.sFormat, "webp"); // In gtest
+    EXPECT_EQ(oRendition.iMaxDimension, 2048); // In gtest
+    EXPECT_EQ(oRendition.sSuffix, "_2048"); // In gtest
+
+    ASSERT_TRUE(fn_parseRendition("jpg:320:_thumb", oRendition)); // In rendition.cpp
+    EXPECT_EQ(oRendition.iMaxDimension, 320); // In gtest
+    EXPECT_EQ(oRendition.sSuffix, "_thumb"); // In gtest
+
+    ASSERT_TRUE(fn_parseRendition("png::-full", oRendition)); // In rendition.cpp
+    EXPECT_EQ(oRendition.iMaxDimension, 0); // In gtest
+    EXPECT_EQ(oRendition.sSuffix, "-full"); // In gtest
+
+    for (const char* pSpec : {"", "gif", "jpg:-5", "jpg:big", "jpg:320:../x", "jpg:9999999"})
+    { // Begin for
+        EXPECT_FALSE(fn_parseRendition(pSpec, oRendition)) << pSpec; // In rendition.cpp
+    } // End for(const char* pSpec : ...)
+} // End TEST(ParseSpecs)
+
+// Test Case: Rendition files sit next to the output path
+TEST(RenditionTest, OutputPaths)
+{ // Begin TEST
+    sRendition oRendition; // In rendition.h
+    ASSERT_TRUE(fn_parseRendition("webp:2048", oRendition)); // In rendition.cpp
+    EXPECT_EQ(fn_getRenditionPath("/out/IMG_0001.jpg", oRendition), "/out/IMG_0001_2048.webp"); // In gtest
+    ASSERT_TRUE(fn_parseRendition("jpg", oRendition)); // In rendition.cpp
+    EXPECT_EQ(fn_getRenditionPath("IMG_0001.png", oRendition), "IMG_0001.jpg"); // In gtest
+} // End TEST(OutputPaths)
+
+// Test Case: Spec files skip comments and report the bad line
+TEST(RenditionTest, LoadsSpecFile)
+{ // Begin TEST
+    char aPath[] = "/tmp/rendition_test.XXXXXX"; // Local Function
+    int iFd = mkstemp(aPath); // In cstdlib
+    ASSERT_GE(iFd, 0); // In gtest
+    close(iFd); // In unistd.h
+
+    std::ofstream(aPath) << "# ingest\njpg\n\n  webp:2048\njpg:320:_thumb\n";
+    std::vector<std::string> vsSpecs; // Local Function
+    std::string sError; // Local Function
+    ASSERT_TRUE(fn_loadRenditionFile(aPath, vsSpecs, sError)) << sError; // In rendition.cpp
+    ASSERT_EQ(vsSpecs.size(), 3u); // In gtest
+    EXPECT_EQ(vsSpecs[1], "webp:2048"); // In gtest
+
+    std::ofstream(aPath) << "jpg\nraw:100\n";
+    vsSpecs.clear();
+    EXPECT_FALSE(fn_loadRenditionFile(aPath, vsSpecs, sError)); // In rendition.cpp
+    EXPECT_NE(sError.find(":2:"), std::string::npos) << sError; // In gtest
+    remove(aPath); // In cstdio
+} // End TEST(LoadsSpecFile)
+
+#if defined(HAVE_PNG) && defined(HAVE_JPEG)
+static std::vector<unsigned char> fn_readFile(const std::string& sPath)
+{ // Begin fn_readFile
+    std::ifstream oFile(sPath, std::ios::binary); // Local Function
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(oFile), std::istreambuf_iterator<char>());
+} // End Function fn_readFile
+
+// Width and height of a written PNG or JPEG (0 x 0 when unreadable)
+static void fn_readSize(const std::string& sPath, int& iWidth, int& iHeight)
+{ // Begin fn_readSize
+    iWidth = iHeight = 0;
+    std::vector<unsigned char> vFile = fn_readFile(sPath); // Local Function
+    if (vFile.size() > 8 && png_sig_cmp(vFile.data(), 0, 8) == 0)
+    { // Begin if
+        png_image oImage; // In png.h
+        std::memset(&oImage, 0, sizeof(oImage));
+        oImage.version = PNG_IMAGE_VERSION;
+        if (png_image_begin_read_from_memory(&oImage, vFile.data(), vFile.size()))
+        { // Begin if
+            iWidth = static_cast<int>(oImage.width);
+            iHeight = static_cast<int>(oImage.height);
+            png_image_free(&oImage);
+        } // End if(header read)
+        return;
+    } // End if(PNG signature)
+    if (vFile.size() > 2 && vFile[0] == 0xFF && vFile[1] == 0xD8)
+    { // Begin if
+        struct jpeg_decompress_struct sDInfo; // In jpeglib.h
+        struct jpeg_error_mgr sJErr; // In jpeglib.h
+        sDInfo.err = jpeg_std_error(&sJErr);
+        jpeg_create_decompress(&sDInfo);
+        jpeg_mem_src(&sDInfo, vFile.data(), static_cast<unsigned long>(vFile.size()));
+        jpeg_read_header(&sDInfo, TRUE);
+        iWidth = static_cast<int>(sDInfo.image_width);
+        iHeight = static_cast<int>(sDInfo.image_height);
+        jpeg_destroy_decompress(&sDInfo);
+    } // End if(JPEG SOI)
+} // End Function fn_readSize
+
+// Test Case: Every size is written from one source, serially or in parallel
+TEST(RenditionTest, CascadeEncodes)
+{ // Begin TEST
+    ImageBuffer oSource = ImageBuffer::fn_allocate(640, 480, 3); // In image_buffer.cpp
+    for (int y = 0; y < 480; ++y)
+    { // Begin for
+        for (size_t x = 0; x < oSource.fn_getRowBytes(); ++x)
+        { // Begin for
+            oSource.fn_getRow(y)[x] = static_cast<unsigned char>((x / 3 + y) ^ (x % 3 * 40));
+        } // End for(size_t x = 0; x < oSource.fn_getRowBytes(); ++x)
+    } // End for(int y = 0; y < 480; ++y)
+
+    std::vector<sRendition> vRenditions(4); // Local Function
+    ASSERT_TRUE(fn_parseRendition("jpg:100:_small", vRenditions[0])); // Smallest listed first
+    ASSERT_TRUE(fn_parseRendition("png", vRenditions[1])); // In rendition.cpp
+    ASSERT_TRUE(fn_parseRendition("jpg:320", vRenditions[2])); // In rendition.cpp
+    ASSERT_TRUE(fn_parseRendition("png:4000", vRenditions[3])); // Never enlarged
+
+    char aDirectory[] = "/tmp/rendition_test.XXXXXX"; // Local Function
+    ASSERT_NE(mkdtemp(aDirectory), nullptr); // In cstdlib
+    std::vector<std::vector<unsigned char>> vvSerial; // Local Function
+    for (int iThreads : {1, 4})
+    { // Begin for
+        std::vector<std::string> vsPaths; // Local Function
+        for (const sRendition& oRendition : vRenditions)
+        { // Begin for
+            vsPaths.push_back(fn_getRenditionPath(std::string(aDirectory) + "/photo.jpg", oRendition)); // In rendition.cpp
+        } // End for(const sRendition& oRendition : vRenditions)
+
+        std::vector<std::pair<int, int>> vSizesAsked; // Local Function
+        std::vector<bool> vbWritten; // Local Function
+        ASSERT_TRUE(fn_encodeRenditions(oSource, vRenditions, vsPaths,
+            [&vSizesAsked](const sRendition& oRendition, int iWidth, int iHeight)
+            { // Begin lambda
+                vSizesAsked.push_back(std::make_pair(iWidth, iHeight));
+                sEncodeOptions oOptions; // In format_encoder.h
+                oOptions.sFormat = oRendition.sFormat;
+                return oOptions;
+            }, // End lambda
+            eResizeFilter::Lanczos3, iThreads, vbWritten)) << iThreads; // In rendition.cpp
+        ASSERT_EQ(vbWritten, std::vector<bool>(4, true)); // In gtest
+
+        // Options are requested largest first
+        ASSERT_EQ(vSizesAsked.size(), 4u); // In gtest
+        EXPECT_EQ(vSizesAsked[0], std::make_pair(640, 480)); // In gtest
+        EXPECT_EQ(vSizesAsked[3], std::make_pair(100, 75)); // In gtest
+
+        const int aExpected[4][2] = {{100, 75}, {640, 480}, {320, 240}, {640, 480}}; // Local Function
+        std::vector<std::vector<unsigned char>> vvFiles; // Local Function
+        for (size_t i = 0; i < vsPaths.size(); ++i)
+        { // Begin for
+            int iWidth = 0, iHeight = 0; // Local Function
+            fn_readSize(vsPaths[i], iWidth, iHeight); // Local Function
+            EXPECT_EQ(iWidth, aExpected[i][0]) << vsPaths[i]; // In gtest
+            EXPECT_EQ(iHeight, aExpected[i][1]) << vsPaths[i]; // In gtest
+            vvFiles.push_back(fn_readFile(vsPaths[i])); // Local Function
+            remove(vsPaths[i].c_str()); // In cstdio
+        } // End for(size_t i = 0; i < vsPaths.size(); ++i)
+        EXPECT_EQ(vsPaths[0], std::string(aDirectory) + "/photo_small.jpg"); // In gtest
+
+        // Worker count does not change a single byte
+        if (vvSerial.empty())
+        { // Begin if
+            vvSerial = vvFiles;
+        } // End if(vvSerial.empty())
+        else
+        { // Begin else
+            EXPECT_TRUE(vvFiles == vvSerial); // In gtest
+        } // End else
+    } // End for(int iThreads : {1, 4})
+    rmdir(aDirectory); // In unistd.h
+} // End TEST(CascadeEncodes)
+#endif
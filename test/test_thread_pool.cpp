@@ -0,0 +1,124 @@
+// test_thread_pool.cpp - Unit tests for the work-stealing thread pool
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "thread_pool.h"
+#include "config.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// Test Case: Every submitted task runs exactly once
+TEST(ThreadPoolTest, RunsAllTasks)
+{ // Begin TEST
+    ThreadPool oPool(4); // In thread_pool.h
+    std::atomic<int> iCounter(0); // Local Function
+
+    for (int i = 0; i < 1000; i++)
+    { // Begin for
+        oPool.fn_submit([&iCounter]() { iCounter++; }); // In thread_pool.cpp
+    } // End for(int i = 0; i < 1000; i++)
+
+    oPool.fn_waitIdle(); // In thread_pool.cpp
+    EXPECT_EQ(iCounter.load(), 1000); // In gtest
+} // End TEST(RunsAllTasks)
+
+// Test Case: A slow task does not hold back the remaining work
+TEST(ThreadPoolTest, SlowTaskDoesNotBlockOthers)
+{ // Begin TEST
+    if (ThreadPool::fn_resolveThreadCount(2) < 2)
+    { // Begin if
+        GTEST_SKIP() << "Needs at least two cores"; // In gtest
+    } // End if(ThreadPool::fn_resolveThreadCount(2) < 2)
+    
+    ThreadPool oPool(2); // In thread_pool.h
+    std::atomic<int> iFastDone(0); // Local Function
+    std::atomic<bool> bSlowDone(false); // Local Function
+
+    oPool.fn_submit([&bSlowDone]()
+    { // Begin lambda
+        std::this_thread::sleep_for(std::chrono::milliseconds(300)); // In thread
+        bSlowDone = true; // Local Function
+    }); // End lambda
+
+    for (int i = 0; i < 20; i++)
+    { // Begin for
+        oPool.fn_submit([&iFastDone]() { iFastDone++; }); // In thread_pool.cpp
+    } // End for(int i = 0; i < 20; i++)
+
+    // The second worker steals the fast tasks while the first is busy
+    auto tDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(200); // Local Function
+    while (iFastDone.load() < 20 && std::chrono::steady_clock::now() < tDeadline)
+    { // Begin while
+        std::this_thread::sleep_for(std::chrono::milliseconds(1)); // In thread
+    } // End while
+
+    EXPECT_EQ(iFastDone.load(), 20); // In gtest
+    EXPECT_FALSE(bSlowDone.load()); // In gtest
+
+    oPool.fn_waitIdle(); // In thread_pool.cpp
+    EXPECT_TRUE(bSlowDone.load()); // In gtest
+} // End TEST(SlowTaskDoesNotBlockOthers)
+
+// Test Case: Tasks may submit further tasks
+TEST(ThreadPoolTest, NestedSubmit)
+{ // Begin TEST
+    ThreadPool oPool(3); // In thread_pool.h
+    std::atomic<int> iCounter(0); // Local Function
+
+    for (int i = 0; i < 10; i++)
+    { // Begin for
+        oPool.fn_submit([&oPool, &iCounter]()
+        { // Begin lambda
+            for (int j = 0; j < 10; j++)
+            { // Begin for
+                oPool.fn_submit([&iCounter]() { iCounter++; }); // In thread_pool.cpp
+            } // End for(int j = 0; j < 10; j++)
+        }); // End lambda
+    } // End for(int i = 0; i < 10; i++)
+
+    oPool.fn_waitIdle(); // In thread_pool.cpp
+    EXPECT_EQ(iCounter.load(), 100); // In gtest
+} // End TEST(NestedSubmit)
+
+// Test Case: Groups waited on from every worker of a full pool still finish
+TEST(ThreadPoolTest, TaskGroupOnBusyPool)
+{ // Begin TEST
+    ThreadPool oPool(2); // In thread_pool.h
+    std::atomic<int> iCounter(0); // Local Function
+
+    for (int i = 0; i < 6; i++)
+    { // Begin for
+        oPool.fn_submit([&iCounter]()
+        { // Begin lambda
+            EXPECT_NE(ThreadPool::fn_getCurrent(), nullptr); // In thread_pool.cpp
+            TaskGroup oGroup(4); // In thread_pool.h
+            for (int j = 0; j < 10; j++)
+            { // Begin for
+                oGroup.fn_submit([&iCounter]() { iCounter++; }); // In thread_pool.cpp
+            } // End for(int j = 0; j < 10; j++)
+            oGroup.fn_wait(); // Runs what no idle worker took
+        }); // End lambda
+    } // End for(int i = 0; i < 6; i++)
+
+    oPool.fn_waitIdle(); // In thread_pool.cpp
+    EXPECT_EQ(iCounter.load(), 60); // In gtest
+
+    TaskGroup oOwnPool(3); // Off the pool: a private pool serves the group
+    for (int j = 0; j < 10; j++)
+    { // Begin for
+        oOwnPool.fn_submit([&iCounter]() { iCounter++; }); // In thread_pool.cpp
+    } // End for(int j = 0; j < 10; j++)
+    oOwnPool.fn_wait(); // In thread_pool.cpp
+    EXPECT_EQ(iCounter.load(), 70); // In gtest
+    EXPECT_EQ(ThreadPool::fn_getCurrent(), nullptr); // In thread_pool.cpp
+} // End TEST(TaskGroupOnBusyPool)
+
+// Test Case: Thread count is clamped to the configured maximum
+TEST(ThreadPoolTest, ResolveThreadCount)
+{ // Begin TEST
+    EXPECT_EQ(ThreadPool::fn_resolveThreadCount(1), 1); // In thread_pool.cpp
+    EXPECT_GE(ThreadPool::fn_resolveThreadCount(0), 1); // In thread_pool.cpp
+    EXPECT_LE(ThreadPool::fn_resolveThreadCount(1000), iMAX_THREAD_COUNT); // In thread_pool.cpp
+} // End TEST(ResolveThreadCount)
@@ -0,0 +1,243 @@
+// test_tiff_writer.cpp - Unit tests for strip-parallel TIFF output and its EXIF IFD
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "format_encoder.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#ifdef HAVE_TIFF
+#include <tiffio.h>
+
+// Little-endian EXIF block: IFD0 (Make, Exif and GPS pointers), an Exif IFD
+// (ExposureTime, ISO, ExifVersion, DateTimeOriginal, SubjectArea, PixelX)
+// and a GPS IFD (LatitudeRef, Latitude), behind the "Exif\0\0" prefix
+static std::vector<unsigned char> fn_buildExif()
+{ // Begin fn_buildExif
+    std::vector<unsigned char> vTiff(224, 0); // Local Function
+    auto fnPut16 = [&vTiff](size_t stAt, uint32_t uValue) { vTiff[stAt] = uValue & 0xFF; vTiff[stAt + 1] = (uValue >> 8) & 0xFF; };
+    auto fnPut32 = [&fnPut16](size_t stAt, uint32_t uValue) { fnPut16(stAt, uValue & 0xFFFF); fnPut16(stAt + 2, uValue >> 16); };
+    auto fnEntry = [&](size_t stAt, uint16_t uTag, uint16_t uType, uint32_t uCount, uint32_t uValue)
+    { // Begin fnEntry
+        fnPut16(stAt, uTag);
+        fnPut16(stAt + 2, uType);
+        fnPut32(stAt + 4, uCount);
+        if (uType == 3 && uCount == 1)
+        { // Begin if
+            fnPut16(stAt + 8, uValue);
+        } // End if(inline SHORT)
+        else
+        { // Begin else
+            fnPut32(stAt + 8, uValue);
+        } // End else
+    }; // End fnEntry
+
+    vTiff[0] = vTiff[1] = 'I';
+    fnPut16(2, 42);
+    fnPut32(4, 8);
+    fnPut16(8, 3);
+    fnEntry(10, 271, 2, 6, 50);
+    fnEntry(22, 34665, 4, 1, 56);
+    fnEntry(34, 34853, 4, 1, 170);
+    std::memcpy(&vTiff[50], "Apple", 6);
+
+    fnPut16(56, 6);
+    fnEntry(58, 33434, 5, 1, 134);
+    fnEntry(70, 34855, 3, 1, 100);
+    fnEntry(82, 36864, 7, 4, 0);
+    std::memcpy(&vTiff[90], "0232", 4);
+    fnEntry(94, 36867, 2, 20, 142);
+    fnEntry(106, 37396, 3, 4, 162);
+    fnEntry(118, 40962, 4, 1, 4032);
+    fnPut32(134, 1);
+    fnPut32(138, 120);
+    std::memcpy(&vTiff[142], "2024:05:01 12:00:00", 20);
+    const uint32_t aSubject[4] = {100, 200, 50, 60}; // Local Function
+    for (int i = 0; i < 4; ++i)
+    { // Begin for
+        fnPut16(162 + i * 2, aSubject[i]);
+    } // End for(int i = 0; i < 4; ++i)
+
+    fnPut16(170, 2);
+    fnEntry(172, 1, 2, 2, 'N');
+    fnEntry(184, 2, 5, 3, 200);
+    const uint32_t aLatitude[6] = {37, 1, 46, 1, 3000, 100}; // Local Function
+    for (int i = 0; i < 6; ++i)
+    { // Begin for
+        fnPut32(200 + i * 4, aLatitude[i]);
+    } // End for(int i = 0; i < 6; ++i)
+
+    std::vector<unsigned char> vExif = {'E', 'x', 'i', 'f', 0, 0}; // Local Function
+    vExif.insert(vExif.end(), vTiff.begin(), vTiff.end());
+    return vExif;
+} // End Function fn_buildExif
+
+// Fresh path in a new temporary directory
+static std::string fn_makeTempPath(const std::string& sName)
+{ // Begin fn_makeTempPath
+    char aTemplate[] = "/tmp/tiff_writer_test.XXXXXX"; // Local Function
+    const char* pDirectory = mkdtemp(aTemplate); // In cstdlib
+    return pDirectory ? std::string(pDirectory) + "/" + sName : std::string();
+} // End Function fn_makeTempPath
+
+static void fn_removeTempPath(const std::string& sPath)
+{ // Begin fn_removeTempPath
+    remove(sPath.c_str()); // In cstdio
+    rmdir(sPath.substr(0, sPath.rfind('/')).c_str()); // In unistd.h
+} // End Function fn_removeTempPath
+
+// Decoded pixels of every strip, in order
+static std::vector<unsigned char> fn_readPixels(TIFF* pTiff)
+{ // Begin fn_readPixels
+    std::vector<unsigned char> vPixels; // Local Function
+    std::vector<unsigned char> vStrip(static_cast<size_t>(TIFFStripSize(pTiff))); // Local Function
+    for (uint32_t uStrip = 0; uStrip < TIFFNumberOfStrips(pTiff); ++uStrip)
+    { // Begin for
+        tmsize_t iBytes = TIFFReadEncodedStrip(pTiff, uStrip, vStrip.data(), static_cast<tmsize_t>(vStrip.size())); // In tiffio.h
+        if (iBytes < 0)
+        { // Begin if
+            return std::vector<unsigned char>();
+        } // End if(decode error)
+        vPixels.insert(vPixels.end(), vStrip.begin(), vStrip.begin() + iBytes);
+    } // End for(strips)
+    return vPixels;
+} // End Function fn_readPixels
+
+// Test Case: Every compression, threaded or not, reads back the same pixels
+TEST(TiffWriterTest, StripsRoundTrip)
+{ // Begin TEST
+    const int iWidth = 700, iHeight = 451; // About 4 strips of RGB
+    std::vector<unsigned char> vPixels(static_cast<size_t>(iWidth) * iHeight * 3); // Local Function
+    for (size_t i = 0; i < vPixels.size(); ++i)
+    { // Begin for
+        vPixels[i] = static_cast<unsigned char>((i % 2100) / 9 + (i / 2100) % 13);
+    } // End for(size_t i = 0; i < vPixels.size(); ++i)
+    sImageData oImageData = {vPixels.data(), iWidth, iHeight, 3, 8}; // In format_encoder.h
+    FormatEncoder oEncoder; // In format_encoder.cpp
+
+    const eTiffCompression aCompressions[] = {eTiffCompression::Deflate, eTiffCompression::Lzw, eTiffCompression::None};
+    const int aExpected[] = {8, 5, 1}; // Adobe Deflate, LZW, none
+    for (int c = 0; c < 3; ++c)
+    { // Begin for
+        for (int iThreads : {1, 3})
+        { // Begin for
+            std::string sPath = fn_makeTempPath("out.tiff"); // Local Function
+            sEncodeOptions oOptions; // In format_encoder.h
+            oOptions.sFormat = "tiff";
+            oOptions.iThreads = iThreads;
+            oOptions.oTiff.eCompression = aCompressions[c];
+            ASSERT_TRUE(oEncoder.fn_encodeImage(oImageData, sPath, oOptions)) << c; // In format_encoder.cpp
+
+            TIFF* pTiff = TIFFOpen(sPath.c_str(), "r"); // In tiffio.h
+            ASSERT_NE(pTiff, nullptr); // In gtest
+            uint16_t uCompression = 0, uPredictor = 1; // Local Function
+            TIFFGetField(pTiff, TIFFTAG_COMPRESSION, &uCompression); // In tiffio.h
+            TIFFGetField(pTiff, TIFFTAG_PREDICTOR, &uPredictor); // In tiffio.h
+            EXPECT_EQ(uCompression, aExpected[c]); // In gtest
+            EXPECT_EQ(uPredictor, c == 2 ? 1 : 2); // In gtest
+            EXPECT_GT(TIFFNumberOfStrips(pTiff), 2u); // In gtest
+            EXPECT_FALSE(TIFFIsBigTIFF(pTiff)); // In gtest
+            EXPECT_TRUE(fn_readPixels(pTiff) == vPixels) << c << " " << iThreads; // In gtest
+            TIFFClose(pTiff); // In tiffio.h
+            fn_removeTempPath(sPath); // Local Function
+        } // End for(int iThreads : {1, 3})
+    } // End for(int c = 0; c < 3; ++c)
+} // End TEST(StripsRoundTrip)
+
+// Test Case: 10-bit samples fill the 16-bit range the tag declares
+TEST(TiffWriterTest, HighBitDepthWidened)
+{ // Begin TEST
+    std::vector<uint16_t> vSamples = {0, 1023, 512, 1, 700, 300}; // Local Function
+    sImageData oImageData = {reinterpret_cast<unsigned char*>(vSamples.data()), 2, 1, 3, 10}; // In format_encoder.h
+    std::string sPath = fn_makeTempPath("deep.tiff"); // Local Function
+    sEncodeOptions oOptions; // In format_encoder.h
+    oOptions.sFormat = "tiff";
+    FormatEncoder oEncoder; // In format_encoder.cpp
+    ASSERT_TRUE(oEncoder.fn_encodeImage(oImageData, sPath, oOptions)); // In format_encoder.cpp
+
+    TIFF* pTiff = TIFFOpen(sPath.c_str(), "r"); // In tiffio.h
+    ASSERT_NE(pTiff, nullptr); // In gtest
+    uint16_t uBits = 0; // Local Function
+    TIFFGetField(pTiff, TIFFTAG_BITSPERSAMPLE, &uBits); // In tiffio.h
+    EXPECT_EQ(uBits, 16); // In gtest
+    std::vector<unsigned char> vRead = fn_readPixels(pTiff); // Local Function
+    ASSERT_EQ(vRead.size(), 12u); // In gtest
+    const uint16_t* pRead = reinterpret_cast<const uint16_t*>(vRead.data()); // Local Function
+    EXPECT_EQ(pRead[0], 0); // In gtest
+    EXPECT_EQ(pRead[1], 65535); // In gtest
+    EXPECT_EQ(pRead[2], (512 << 6) | (512 >> 4)); // In gtest
+    TIFFClose(pTiff); // In tiffio.h
+    fn_removeTempPath(sPath); // Local Function
+} // End TEST(HighBitDepthWidened)
+
+// Test Case: EXIF lands in real Exif and GPS IFDs, with Make in IFD0
+TEST(TiffWriterTest, ExifDirectories)
+{ // Begin TEST
+    std::vector<unsigned char> vPixels(64 * 48 * 4, 0x80); // Local Function
+    sImageData oImageData = {vPixels.data(), 64, 48, 4, 8}; // In format_encoder.h
+    std::string sPath = fn_makeTempPath("exif.tiff"); // Local Function
+    sEncodeOptions oOptions; // In format_encoder.h
+    oOptions.sFormat = "tiff";
+    oOptions.bPreserveMetadata = true;
+    oOptions.vExifData = fn_buildExif();
+    oOptions.vIccProfile.assign(300, 0x42);
+    FormatEncoder oEncoder; // In format_encoder.cpp
+    ASSERT_TRUE(oEncoder.fn_encodeImage(oImageData, sPath, oOptions)); // In format_encoder.cpp
+
+    TIFF* pTiff = TIFFOpen(sPath.c_str(), "r"); // In tiffio.h
+    ASSERT_NE(pTiff, nullptr); // In gtest
+    char* pMake = nullptr; // Local Function
+    ASSERT_TRUE(TIFFGetField(pTiff, TIFFTAG_MAKE, &pMake)); // In tiffio.h
+    EXPECT_STREQ(pMake, "Apple"); // In gtest
+    uint32_t uIccSize = 0; // Local Function
+    void* pIcc = nullptr; // Local Function
+    ASSERT_TRUE(TIFFGetField(pTiff, TIFFTAG_ICCPROFILE, &uIccSize, &pIcc)); // In tiffio.h
+    EXPECT_EQ(uIccSize, 300u); // In gtest
+    EXPECT_EQ(fn_readPixels(pTiff).size(), vPixels.size()); // Image directory intact
+
+    uint64_t ullExifIfd = 0, ullGpsIfd = 0; // Local Function
+    ASSERT_TRUE(TIFFGetField(pTiff, TIFFTAG_EXIFIFD, &ullExifIfd)); // In tiffio.h
+    ASSERT_TRUE(TIFFGetField(pTiff, TIFFTAG_GPSIFD, &ullGpsIfd)); // In tiffio.h
+
+    ASSERT_TRUE(TIFFReadEXIFDirectory(pTiff, ullExifIfd)); // In tiffio.h
+    char* pDate = nullptr; // Local Function
+    ASSERT_TRUE(TIFFGetField(pTiff, EXIFTAG_DATETIMEORIGINAL, &pDate)); // In tiffio.h
+    EXPECT_STREQ(pDate, "2024:05:01 12:00:00"); // In gtest
+    uint32_t uPixelX = 0; // Local Function
+    ASSERT_TRUE(TIFFGetField(pTiff, EXIFTAG_PIXELXDIMENSION, &uPixelX)); // In tiffio.h
+    EXPECT_EQ(uPixelX, 4032u); // In gtest
+    float fExposure = 0.0f; // libtiff keeps single-value EXIF rationals as float
+    ASSERT_TRUE(TIFFGetField(pTiff, EXIFTAG_EXPOSURETIME, &fExposure)); // In tiffio.h
+    EXPECT_NEAR(fExposure, 1.0 / 120.0, 1e-6); // In gtest
+    uint16_t uIsoCount = 0; // Local Function
+    uint16_t* pIso = nullptr; // Local Function
+    ASSERT_TRUE(TIFFGetField(pTiff, EXIFTAG_ISOSPEEDRATINGS, &uIsoCount, &pIso)); // In tiffio.h
+    ASSERT_EQ(uIsoCount, 1); // In gtest
+    EXPECT_EQ(pIso[0], 100); // In gtest
+
+    ASSERT_TRUE(TIFFReadGPSDirectory(pTiff, ullGpsIfd)); // In tiffio.h
+    char* pLatitudeRef = nullptr; // Local Function
+    ASSERT_TRUE(TIFFGetField(pTiff, GPSTAG_LATITUDEREF, &pLatitudeRef)); // In tiffio.h
+    EXPECT_STREQ(pLatitudeRef, "N"); // In gtest
+    TIFFClose(pTiff); // In tiffio.h
+    fn_removeTempPath(sPath); // Local Function
+} // End TEST(ExifDirectories)
+
+// Test Case: Compression names round-trip
+TEST(TiffWriterTest, CompressionNames)
+{ // Begin TEST
+    eTiffCompression eCompression = eTiffCompression::None; // In format_encoder.h
+    for (const char* pName : {"none", "lzw", "deflate"})
+    { // Begin for
+        ASSERT_TRUE(fn_parseTiffCompression(pName, eCompression)); // In format_encoder.cpp
+        EXPECT_EQ(fn_getTiffCompressionName(eCompression), pName); // In gtest
+    } // End for(const char* pName : {"none", "lzw", "deflate"})
+    EXPECT_FALSE(fn_parseTiffCompression("jpeg", eCompression)); // In format_encoder.cpp
+} // End TEST(CompressionNames)
+#endif
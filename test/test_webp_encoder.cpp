@@ -0,0 +1,128 @@
+// test_webp_encoder.cpp - Unit tests for the WebP encoder settings and metadata chunks
+// Author: R Square Innovation Software
+// Version: v1.0
+
+#include "format_encoder.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_WEBP
+
+// One chunk of a RIFF/WEBP file
+struct sChunk
+{
+    std::string sFourCC;
+    std::vector<unsigned char> vPayload;
+};
+
+static uint32_t fn_readLE32(const unsigned char* pData)
+{ // Begin fn_readLE32
+    return pData[0] | (pData[1] << 8) | (pData[2] << 16) | (static_cast<uint32_t>(pData[3]) << 24);
+} // End Function fn_readLE32
+
+// Top-level chunks after the RIFF header (empty when the header is wrong)
+static std::vector<sChunk> fn_readChunks(const std::vector<unsigned char>& vWebP)
+{ // Begin fn_readChunks
+    std::vector<sChunk> vChunks; // Local Function
+    if (vWebP.size() < 12 || std::memcmp(vWebP.data(), "RIFF", 4) != 0 ||
+        std::memcmp(vWebP.data() + 8, "WEBP", 4) != 0 || fn_readLE32(vWebP.data() + 4) + 8 != vWebP.size())
+    { // Begin if
+        return vChunks;
+    } // End if(not a RIFF/WEBP file)
+
+    size_t stPos = 12; // Local Function
+    while (stPos + 8 <= vWebP.size())
+    { // Begin while
+        size_t stSize = fn_readLE32(vWebP.data() + stPos + 4); // Local Function
+        if (stPos + 8 + stSize > vWebP.size())
+        { // Begin if
+            break;
+        } // End if(truncated chunk)
+        sChunk oChunk; // Local Function
+        oChunk.sFourCC.assign(reinterpret_cast<const char*>(vWebP.data() + stPos), 4);
+        oChunk.vPayload.assign(vWebP.begin() + stPos + 8, vWebP.begin() + stPos + 8 + stSize);
+        vChunks.push_back(oChunk);
+        stPos += 8 + stSize + (stSize & 1);
+    } // End while(stPos + 8 <= vWebP.size())
+    return vChunks;
+} // End Function fn_readChunks
+
+// A small gradient with an alpha ramp
+static std::vector<unsigned char> fn_makePixels(int iWidth, int iHeight, int iChannels)
+{ // Begin fn_makePixels
+    std::vector<unsigned char> vPixels(static_cast<size_t>(iWidth) * iHeight * iChannels); // Local Function
+    for (size_t i = 0; i < vPixels.size(); ++i)
+    { // Begin for
+        vPixels[i] = static_cast<unsigned char>((i * 5) ^ (i / 97));
+    } // End for(size_t i = 0; i < vPixels.size(); ++i)
+    return vPixels;
+} // End Function fn_makePixels
+
+// Test Case: Lossless and every effort level produce valid files
+TEST(WebPEncoderTest, LosslessAndEffort)
+{ // Begin TEST
+    std::vector<unsigned char> vPixels = fn_makePixels(40, 24, 4); // Local Function
+    sImageData oImageData = {vPixels.data(), 40, 24, 4, 8}; // In format_encoder.h
+    FormatEncoder oEncoder; // In format_encoder.cpp
+
+    sEncodeOptions oOptions; // In format_encoder.h
+    oOptions.sFormat = "webp";
+    oOptions.oWebP.bLossless = true;
+    std::vector<unsigned char> vWebP; // Local Function
+    ASSERT_TRUE(oEncoder.fn_encodeToMemory(oImageData, oOptions, vWebP)); // In format_encoder.cpp
+    std::vector<sChunk> vChunks = fn_readChunks(vWebP); // Local Function
+    ASSERT_EQ(vChunks.size(), 1u); // No metadata, simple layout
+    EXPECT_EQ(vChunks[0].sFourCC, "VP8L"); // In gtest
+    EXPECT_FALSE(oEncoder.fn_supportsPlanar(oOptions)); // Lossless needs RGB
+
+    oOptions.oWebP.bLossless = false;
+    oOptions.oWebP.iAlphaQuality = 50;
+    for (int iEffort = 0; iEffort <= 6; iEffort += 3)
+    { // Begin for
+        oOptions.oWebP.iEffort = iEffort;
+        oOptions.oWebP.bMultithread = iEffort != 3;
+        vWebP.clear();
+        ASSERT_TRUE(oEncoder.fn_encodeToMemory(oImageData, oOptions, vWebP)) << iEffort; // In format_encoder.cpp
+        vChunks = fn_readChunks(vWebP);
+        ASSERT_FALSE(vChunks.empty()) << iEffort; // In gtest
+        EXPECT_EQ(vChunks.back().sFourCC, "VP8 "); // Lossy, after VP8X / ALPH
+    } // End for(int iEffort = 0; iEffort <= 6; iEffort += 3)
+} // End TEST(LosslessAndEffort)
+
+#ifdef HAVE_WEBPMUX
+// Test Case: ICC, EXIF and XMP are attached as chunks in one encode
+TEST(WebPEncoderTest, MetadataChunks)
+{ // Begin TEST
+    std::vector<unsigned char> vPixels = fn_makePixels(32, 16, 3); // Local Function
+    sImageData oImageData = {vPixels.data(), 32, 16, 3, 8}; // In format_encoder.h
+
+    sEncodeOptions oOptions; // In format_encoder.h
+    oOptions.sFormat = "webp";
+    oOptions.bPreserveMetadata = true;
+    const unsigned char aExif[] = {'E', 'x', 'i', 'f', 0, 0, 'I', 'I', 42, 0, 8, 0, 0, 0, 0, 0}; // Empty IFD
+    oOptions.vExifData.assign(aExif, aExif + sizeof(aExif));
+    std::string sXmp = "<x:xmpmeta xmlns:x=\"adobe:ns:meta/\"></x:xmpmeta>"; // Local Function
+    oOptions.vXmpData.assign(sXmp.begin(), sXmp.end());
+    oOptions.vIccProfile.assign(301, 0x42);
+
+    FormatEncoder oEncoder; // In format_encoder.cpp
+    std::vector<unsigned char> vWebP; // Local Function
+    ASSERT_TRUE(oEncoder.fn_encodeToMemory(oImageData, oOptions, vWebP)); // In format_encoder.cpp
+    std::vector<sChunk> vChunks = fn_readChunks(vWebP); // Local Function
+    ASSERT_EQ(vChunks.size(), 5u); // In gtest
+
+    // VP8X flags: ICC (0x20), EXIF (0x08), XMP (0x04)
+    EXPECT_EQ(vChunks[0].sFourCC, "VP8X"); // In gtest
+    EXPECT_EQ(vChunks[0].vPayload[0] & 0x2C, 0x2C); // In gtest
+    EXPECT_EQ(vChunks[1].sFourCC, "ICCP"); // In gtest
+    EXPECT_EQ(vChunks[1].vPayload, oOptions.vIccProfile); // In gtest
+    EXPECT_EQ(vChunks[2].sFourCC, "VP8 "); // In gtest
+    EXPECT_EQ(vChunks[3].sFourCC, "EXIF"); // In gtest
+    EXPECT_EQ(vChunks[3].vPayload, std::vector<unsigned char>(aExif + 6, aExif + sizeof(aExif))); // No "Exif" prefix
+    EXPECT_EQ(vChunks[4].sFourCC, "XMP "); // In gtest
+    EXPECT_EQ(std::string(vChunks[4].vPayload.begin(), vChunks[4].vPayload.end()), sXmp); // In gtest
+} // End TEST(MetadataChunks)
+#endif
+#endif